@@ -0,0 +1,280 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Parsing and interning of account names; see AccountName.h.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <mutex>
+#include <new>
+#include <string.h>
+#include <wchar.h>
+#include "AccountName.h"
+
+// The interned identities: open addressing with linear probing over a power-of-two table
+// that is never more than half full.  Each identity is one block, the canonical name
+// straight after the struct.
+static std::mutex s_mutexIdentities;
+static ACCOUNT_IDENTITY** s_rgpSlots = nullptr;
+static size_t s_cSlots = 0;
+static unsigned long s_cIdentities = 0;
+static unsigned long long s_cbIdentities = 0;
+
+#define ACCOUNT_NAME_MIN_SLOTS 64
+
+static size_t _Find(const wchar_t* pwz, size_t cch, wchar_t ch)
+{
+  size_t i = 0;
+  while (i < cch && pwz[i] != ch)
+  {
+    i++;
+  }
+  return i;
+}
+
+// Copies cch characters at pwz to pwzOut, folding ASCII letters to upper case.  Returns
+// false if any character was not ASCII, in which case the copy still has to go through
+// PlatformUpcase.
+static bool _CopyFoldedAscii(const wchar_t* pwz, size_t cch, wchar_t* pwzOut)
+{
+  unsigned long ulAll = 0;
+  for (size_t i = 0; i < cch; i++)
+  {
+    wchar_t ch = pwz[i];
+    ulAll |= ch;
+    pwzOut[i] = (ch >= L'a' && ch <= L'z') ? (wchar_t)(ch - L'a' + L'A') : ch;
+  }
+  return ulAll < 0x80;
+}
+
+static void _CopyFolded(const wchar_t* pwz, size_t cch, wchar_t* pwzOut)
+{
+  if (!_CopyFoldedAscii(pwz, cch, pwzOut))
+  {
+    PlatformUpcase(pwzOut, cch);
+  }
+}
+
+static unsigned long _Hash(const wchar_t* pwz, size_t cch)
+{
+  // 32-bit FNV-1a over the UTF-16LE bytes, as CredentialStoreMachineHash.
+  unsigned long ulHash = 2166136261UL;
+  for (size_t i = 0; i < cch; i++)
+  {
+    unsigned long ulUnit = (unsigned long)pwz[i] & 0xFFFF;
+    ulHash = ((ulHash ^ (ulUnit & 0xFF)) * 16777619UL) & 0xFFFFFFFFUL;
+    ulHash = ((ulHash ^ (ulUnit >> 8)) * 16777619UL) & 0xFFFFFFFFUL;
+  }
+  return ulHash;
+}
+
+// The slot holding the identity for the canonical name, or the empty slot it would go in.
+// The canonical name is cchDomain + 1 + cchUsername long whichever way round it is.
+// Called with s_mutexIdentities held and s_cSlots non-zero.
+static ACCOUNT_IDENTITY** _Probe(
+  unsigned long ulHash,
+  ACCOUNT_NAME_FORM anf,
+  const wchar_t* pwzCanonical,
+  size_t cchDomain,
+  size_t cchUsername
+)
+{
+  size_t cchCanonical = cchDomain + 1 + cchUsername;
+  for (size_t i = ulHash & (s_cSlots - 1); ; i = (i + 1) & (s_cSlots - 1))
+  {
+    ACCOUNT_IDENTITY* pIdentity = s_rgpSlots[i];
+    if (!pIdentity ||
+      (pIdentity->ulHash == ulHash && pIdentity->anf == anf && pIdentity->cchDomain == cchDomain &&
+        pIdentity->cchUsername == cchUsername && 0 == wmemcmp(pIdentity->pwzCanonical, pwzCanonical, cchCanonical)))
+    {
+      return &s_rgpSlots[i];
+    }
+  }
+}
+
+// Doubles the table.  Called with s_mutexIdentities held.
+static bool _Grow()
+{
+  size_t cSlots = s_cSlots ? s_cSlots * 2 : ACCOUNT_NAME_MIN_SLOTS;
+  ACCOUNT_IDENTITY** rgpSlots = new (std::nothrow) ACCOUNT_IDENTITY*[cSlots];
+  if (!rgpSlots)
+  {
+    return false;
+  }
+  memset(rgpSlots, 0, cSlots * sizeof(*rgpSlots));
+
+  for (size_t i = 0; i < s_cSlots; i++)
+  {
+    ACCOUNT_IDENTITY* pIdentity = s_rgpSlots[i];
+    if (pIdentity)
+    {
+      size_t j = pIdentity->ulHash & (cSlots - 1);
+      while (rgpSlots[j])
+      {
+        j = (j + 1) & (cSlots - 1);
+      }
+      rgpSlots[j] = pIdentity;
+    }
+  }
+
+  delete[] s_rgpSlots;
+  s_rgpSlots = rgpSlots;
+  s_cSlots = cSlots;
+  return true;
+}
+
+static CREDENTIAL_STORE_RESULT _Intern(
+  ACCOUNT_NAME_FORM anf,
+  const wchar_t* pwzCanonical,
+  size_t cchDomain,
+  size_t cchUsername,
+  const ACCOUNT_IDENTITY** ppIdentity
+)
+{
+  size_t cchCanonical = cchDomain + 1 + cchUsername;
+  unsigned long ulHash = _Hash(pwzCanonical, cchCanonical);
+
+  std::lock_guard<std::mutex> lock(s_mutexIdentities);
+  if (!s_cSlots && !_Grow())
+  {
+    return CSR_OUT_OF_MEMORY;
+  }
+
+  ACCOUNT_IDENTITY** ppSlot = _Probe(ulHash, anf, pwzCanonical, cchDomain, cchUsername);
+  if (!*ppSlot)
+  {
+    if (s_cIdentities >= ACCOUNT_NAME_MAX_IDENTITIES)
+    {
+      return CSR_OUT_OF_MEMORY;
+    }
+    if ((s_cIdentities + 1) * 2 > s_cSlots)
+    {
+      if (!_Grow())
+      {
+        return CSR_OUT_OF_MEMORY;
+      }
+      ppSlot = _Probe(ulHash, anf, pwzCanonical, cchDomain, cchUsername);
+    }
+
+    size_t cb = sizeof(ACCOUNT_IDENTITY) + (cchCanonical + 1) * sizeof(wchar_t);
+    unsigned char* pb = new (std::nothrow) unsigned char[cb];
+    if (!pb)
+    {
+      return CSR_OUT_OF_MEMORY;
+    }
+    ACCOUNT_IDENTITY* pIdentity = reinterpret_cast<ACCOUNT_IDENTITY*>(pb);
+    wchar_t* pwz = reinterpret_cast<wchar_t*>(pIdentity + 1);
+    wmemcpy(pwz, pwzCanonical, cchCanonical);
+    pwz[cchCanonical] = L'\0';
+
+    pIdentity->ulHash = ulHash;
+    pIdentity->anf = anf;
+    pIdentity->cchDomain = static_cast<unsigned short>(cchDomain);
+    pIdentity->cchUsername = static_cast<unsigned short>(cchUsername);
+    pIdentity->pwzCanonical = pwz;
+
+    *ppSlot = pIdentity;
+    s_cIdentities++;
+    s_cbIdentities += cb;
+  }
+  *ppIdentity = *ppSlot;
+  return CSR_OK;
+}
+
+CREDENTIAL_STORE_RESULT AccountNameIntern(
+  const wchar_t* pwzDomain,
+  size_t cchDomain,
+  const wchar_t* pwzUsername,
+  size_t cchUsername,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  const ACCOUNT_IDENTITY** ppIdentity
+)
+{
+  *ppIdentity = nullptr;
+
+  // A domain in the user name wins over the one given apart, as it does for LSA.  An @ only
+  // makes a UPN when there is no domain, since it is otherwise allowed in a user name.
+  ACCOUNT_NAME_FORM anf = ANF_DOWN_LEVEL;
+  size_t ich = _Find(pwzUsername, cchUsername, L'\\');
+  if (ich < cchUsername)
+  {
+    pwzDomain = pwzUsername;
+    cchDomain = ich;
+    pwzUsername += ich + 1;
+    cchUsername -= ich + 1;
+  }
+  else if (!cchDomain)
+  {
+    ich = _Find(pwzUsername, cchUsername, L'@');
+    if (ich < cchUsername)
+    {
+      anf = ANF_UPN;
+      pwzDomain = pwzUsername + ich + 1;
+      cchDomain = cchUsername - ich - 1;
+      cchUsername = ich;
+      if (!cchDomain || _Find(pwzDomain, cchDomain, L'@') < cchDomain)
+      {
+        return CSR_BAD_FORMAT;
+      }
+    }
+  }
+
+  if (!cchUsername || cchUsername > ACCOUNT_NAME_MAX_CCH || cchDomain > ACCOUNT_NAME_MAX_CCH || cchMachine > ACCOUNT_NAME_MAX_CCH ||
+    _Find(pwzUsername, cchUsername, L'\\') < cchUsername)
+  {
+    return CSR_BAD_FORMAT;
+  }
+
+  // The canonical name, built in place: DOMAIN\USER, or USER@DOMAIN for a UPN.
+  wchar_t wzCanonical[ACCOUNT_NAME_MAX_CCH * 2 + 1];
+  if (ANF_UPN == anf)
+  {
+    _CopyFolded(pwzUsername, cchUsername, wzCanonical);
+    wzCanonical[cchUsername] = L'@';
+    _CopyFolded(pwzDomain, cchDomain, wzCanonical + cchUsername + 1);
+  }
+  else
+  {
+    wchar_t wzMachine[ACCOUNT_NAME_MAX_CCH];
+    _CopyFolded(pwzMachine, cchMachine, wzMachine);
+    _CopyFolded(pwzDomain, cchDomain, wzCanonical);
+    if (!cchDomain || (1 == cchDomain && L'.' == pwzDomain[0]) ||
+      (cchDomain == cchMachine && 0 == wmemcmp(wzCanonical, wzMachine, cchDomain)))
+    {
+      anf = ANF_LOCAL;
+      wmemcpy(wzCanonical, wzMachine, cchMachine);
+      cchDomain = cchMachine;
+    }
+    wzCanonical[cchDomain] = L'\\';
+    _CopyFolded(pwzUsername, cchUsername, wzCanonical + cchDomain + 1);
+  }
+
+  return _Intern(anf, wzCanonical, cchDomain, cchUsername, ppIdentity);
+}
+
+void AccountNameShutdown()
+{
+  std::lock_guard<std::mutex> lock(s_mutexIdentities);
+  for (size_t i = 0; i < s_cSlots; i++)
+  {
+    delete[] reinterpret_cast<unsigned char*>(s_rgpSlots[i]);
+  }
+  delete[] s_rgpSlots;
+  s_rgpSlots = nullptr;
+  s_cSlots = 0;
+  s_cIdentities = 0;
+  s_cbIdentities = 0;
+}
+
+void AccountNameGetStats(ACCOUNT_NAME_STATS* pStats)
+{
+  std::lock_guard<std::mutex> lock(s_mutexIdentities);
+  pStats->cIdentities = s_cIdentities;
+  pStats->cbIdentities = s_cbIdentities;
+}
@@ -0,0 +1,78 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Account names, parsed into canonical identities that can be compared with ==.
+//
+// One account can be named many ways: "CONTOSO\alice" in the user name, "alice" with a
+// domain of "contoso", ".\alice" or "MACHINE\alice" for a local account, and so on, in any
+// case.  AccountNameIntern parses each of them into the same ACCOUNT_IDENTITY: the domain
+// and user name split apart, "." and the machine's own name taken to mean the machine,
+// and both folded to upper case.  The identities are interned, so there is only ever one
+// per account in the process, and matching an account is a pointer comparison.
+//
+// A UPN ("alice@contoso.com") is an identity of its own.  Which domain a UPN suffix belongs
+// to is for a domain controller to say, so a UPN only matches the same UPN.
+//
+// Names made of ASCII, which is nearly all of them, are folded here; anything else is
+// folded by PlatformUpcase.  The identities live until AccountNameShutdown.
+//
+// Platform-neutral: it depends only on the C++ standard library and Platform.h.
+
+#pragma once
+
+#include "CredentialStore.h"
+
+// Longer than any domain (DNS names stop at 255) and user name Windows accepts.
+#define ACCOUNT_NAME_MAX_CCH 1024
+
+// How many identities a process will hold.  SetSerialization can hand us a name from the
+// network, so the table has to stop somewhere.
+#define ACCOUNT_NAME_MAX_IDENTITIES 65536
+
+enum ACCOUNT_NAME_FORM
+{
+  ANF_LOCAL,        // an account on this machine; the canonical domain is the machine name
+  ANF_DOWN_LEVEL,   // DOMAIN\user
+  ANF_UPN,          // user@dns.domain
+};
+
+struct ACCOUNT_IDENTITY
+{
+  unsigned long ulHash;           // 32-bit FNV-1a of pwzCanonical
+  ACCOUNT_NAME_FORM anf;
+  unsigned short cchDomain;       // of the domain part of pwzCanonical
+  unsigned short cchUsername;     // and of the user part
+  const wchar_t* pwzCanonical;    // "DOMAIN\USER", or "USER@DOMAIN" for a UPN, in upper case
+};
+
+struct ACCOUNT_NAME_STATS
+{
+  unsigned long cIdentities;      // interned so far
+  unsigned long long cbIdentities;  // the blocks they take, not counting the table
+};
+
+// Parses the account named by pwzUsername and pwzDomain (either of which may also be given
+// whole in pwzUsername, as DOMAIN\user or user@domain) and returns its identity.  A domain
+// that is empty, "." or pwzMachine names a local account.  Returns CSR_BAD_FORMAT for a
+// name with no user, with more than one separator or longer than ACCOUNT_NAME_MAX_CCH, and
+// CSR_OUT_OF_MEMORY if a new identity can't be allocated or the table is full.
+CREDENTIAL_STORE_RESULT AccountNameIntern(
+  const wchar_t* pwzDomain,
+  size_t cchDomain,
+  const wchar_t* pwzUsername,
+  size_t cchUsername,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  const ACCOUNT_IDENTITY** ppIdentity
+);
+
+// Frees every identity.  Only for when nothing can hold one any more: the DLL calls it as it
+// is unloaded, after AccountSnapshotShutdown.
+void AccountNameShutdown();
+
+void AccountNameGetStats(ACCOUNT_NAME_STATS* pStats);
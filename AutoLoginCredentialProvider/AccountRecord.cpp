@@ -0,0 +1,69 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <new>
+#include <string.h>
+#include "AccountRecord.h"
+
+CAccountRecord::CAccountRecord() :
+  _pwzBlock(NULL),
+  _cchDomain(0),
+  _cchUsername(0),
+  _cchPassword(0)
+{
+}
+
+CAccountRecord::~CAccountRecord()
+{
+  Clear();
+}
+
+void CAccountRecord::Clear()
+{
+  if (_pwzBlock)
+  {
+    PlatformSecureZero(_pwzBlock, HeapBytes());
+    delete[] _pwzBlock;
+    _pwzBlock = NULL;
+  }
+  _cchDomain = _cchUsername = _cchPassword = 0;
+}
+
+CREDENTIAL_STORE_RESULT CAccountRecord::Assign(const UserCredentials& uc)
+{
+  Clear();
+
+  if (uc.domain.size() > CREDENTIAL_ACCOUNT_MAX_CCH ||
+    uc.username.size() > CREDENTIAL_ACCOUNT_MAX_CCH ||
+    uc.password.size() > CREDENTIAL_ACCOUNT_MAX_CCH)
+  {
+    return CSR_BAD_FORMAT;
+  }
+
+  size_t cch = uc.domain.size() + uc.username.size() + uc.password.size() + 3;
+  _pwzBlock = new (std::nothrow) wchar_t[cch];
+  if (!_pwzBlock)
+  {
+    return CSR_OUT_OF_MEMORY;
+  }
+
+  // c_str() rather than data() so each copy picks up its terminator.
+  wchar_t* pwz = _pwzBlock;
+  memcpy(pwz, uc.domain.c_str(), (uc.domain.size() + 1) * sizeof(wchar_t));
+  pwz += uc.domain.size() + 1;
+  memcpy(pwz, uc.username.c_str(), (uc.username.size() + 1) * sizeof(wchar_t));
+  pwz += uc.username.size() + 1;
+  memcpy(pwz, uc.password.c_str(), (uc.password.size() + 1) * sizeof(wchar_t));
+
+  _cchDomain = static_cast<unsigned short>(uc.domain.size());
+  _cchUsername = static_cast<unsigned short>(uc.username.size());
+  _cchPassword = static_cast<unsigned short>(uc.password.size());
+  return CSR_OK;
+}
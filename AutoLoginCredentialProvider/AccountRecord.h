@@ -0,0 +1,86 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The account a credential logs on as, in the form it is kept for the life of the tile.
+//
+// UserCredentials is what the stores parse into: three std::wstring, each with its own
+// buffer once it outgrows the small-string space.  A tile only ever reads the account, so
+// CAccountRecord copies it into a single block instead: the domain, the user name and the
+// password, each NULL-terminated, back to back.  The record itself is the pointer and the
+// three lengths, from which the offsets of the strings follow.  The block is wiped before it
+// is freed.
+//
+// Platform-neutral: it depends only on the C++ standard library and Platform.h.
+
+#pragma once
+
+#include <stddef.h>
+#include "CredentialStore.h"
+
+// The most a UNICODE_STRING can hold, and so the longest string a logon can carry.
+#define CREDENTIAL_ACCOUNT_MAX_CCH 32767
+
+class CAccountRecord
+{
+public:
+  CAccountRecord();
+  ~CAccountRecord();
+
+  // Replaces the record with a copy of uc.  Returns CSR_BAD_FORMAT if a string is longer
+  // than CREDENTIAL_ACCOUNT_MAX_CCH and CSR_OUT_OF_MEMORY if the block can't be allocated,
+  // leaving the record empty either way.
+  CREDENTIAL_STORE_RESULT Assign(const UserCredentials& uc);
+
+  // Wipes and frees the block.
+  void Clear();
+
+  const wchar_t* Domain() const
+  {
+    return _pwzBlock ? _pwzBlock : L"";
+  }
+
+  const wchar_t* Username() const
+  {
+    return _pwzBlock ? _pwzBlock + _cchDomain + 1 : L"";
+  }
+
+  const wchar_t* Password() const
+  {
+    return _pwzBlock ? _pwzBlock + _cchDomain + 1 + _cchUsername + 1 : L"";
+  }
+
+  size_t DomainLength() const
+  {
+    return _cchDomain;
+  }
+
+  size_t UsernameLength() const
+  {
+    return _cchUsername;
+  }
+
+  size_t PasswordLength() const
+  {
+    return _cchPassword;
+  }
+
+  // The size of the block, which is all the record allocates.
+  size_t HeapBytes() const
+  {
+    return _pwzBlock ? (_cchDomain + _cchUsername + _cchPassword + 3) * sizeof(wchar_t) : 0;
+  }
+
+private:
+  CAccountRecord(const CAccountRecord&);
+  CAccountRecord& operator=(const CAccountRecord&);
+
+  wchar_t*        _pwzBlock;      // NULL while the record is empty
+  unsigned short  _cchDomain;     // lengths in characters, not counting the NULL terminators
+  unsigned short  _cchUsername;
+  unsigned short  _cchPassword;
+};
@@ -0,0 +1,218 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The current account snapshot and the reclamation of replaced ones; see AccountSnapshot.h.
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include "AccountSnapshot.h"
+
+// A thread's announcement.  Only the thread writes it; writers read it while they scan.
+struct SNAPSHOT_READER_SLOT
+{
+  SNAPSHOT_READER_SLOT* pNext;                // fixed once the record is on the list
+  std::atomic<unsigned long long> ullEpoch;   // when the outermost open section started, or 0
+  unsigned long cDepth;                       // sections open on the thread
+};
+
+// A snapshot and what the writers keep with it once it has been replaced.
+struct SNAPSHOT_NODE : ACCOUNT_SNAPSHOT
+{
+  SNAPSHOT_NODE* pNextRetired;
+  unsigned long long ullRetiredEpoch;
+};
+
+static std::atomic<SNAPSHOT_NODE*> s_pCurrent(nullptr);
+static std::atomic<unsigned long long> s_ullEpoch(1);
+
+// Every reader record ever handed out, newest first.  Records are only pushed, never
+// unlinked, until AccountSnapshotShutdown.
+static std::atomic<SNAPSHOT_READER_SLOT*> s_pSlots(nullptr);
+static std::atomic<unsigned long> s_cSlots(0);
+
+static thread_local SNAPSHOT_READER_SLOT* t_pSlot = nullptr;
+
+// Rotations are rare, so writers simply take turns.  The retired list and the counts are
+// theirs alone.
+static std::mutex s_mutexWriters;
+static SNAPSHOT_NODE* s_pRetired = nullptr;
+static unsigned long s_cRetired = 0;
+static unsigned long long s_cPublished = 0;
+static unsigned long long s_cReclaimed = 0;
+
+static SNAPSHOT_READER_SLOT* _AllocReaderSlot()
+{
+  SNAPSHOT_READER_SLOT* pSlot = new (std::nothrow) SNAPSHOT_READER_SLOT;
+  if (pSlot)
+  {
+    pSlot->ullEpoch.store(0, std::memory_order_relaxed);
+    pSlot->cDepth = 0;
+
+    SNAPSHOT_READER_SLOT* pHead = s_pSlots.load(std::memory_order_relaxed);
+    do
+    {
+      pSlot->pNext = pHead;
+    }
+    while (!s_pSlots.compare_exchange_weak(pHead, pSlot, std::memory_order_release, std::memory_order_relaxed));
+    s_cSlots.fetch_add(1, std::memory_order_relaxed);
+
+    t_pSlot = pSlot;
+  }
+  return pSlot;
+}
+
+bool AccountSnapshotReserveReader()
+{
+  return t_pSlot || _AllocReaderSlot();
+}
+
+CAccountSnapshotReader::CAccountSnapshotReader() :
+  _pSlot(t_pSlot ? t_pSlot : _AllocReaderSlot()),
+  _pSnapshot(nullptr)
+{
+  if (_pSlot)
+  {
+    // The announcement has to be visible before the pointer is read (both are sequentially
+    // consistent), or a writer could retire and free the snapshot in between without ever
+    // seeing this reader.  Inner sections keep the outer announcement, which is older and so
+    // protects at least as much.
+    if (0 == _pSlot->cDepth++)
+    {
+      _pSlot->ullEpoch.store(s_ullEpoch.load());
+    }
+    _pSnapshot = s_pCurrent.load();
+  }
+}
+
+CAccountSnapshotReader::~CAccountSnapshotReader()
+{
+  if (_pSlot && 0 == --_pSlot->cDepth)
+  {
+    _pSlot->ullEpoch.store(0, std::memory_order_release);
+  }
+}
+
+static void _FreeSnapshot(SNAPSHOT_NODE* pNode)
+{
+  pNode->account.Clear();
+  delete pNode;
+}
+
+// Frees the retired snapshots no reader can still hold.  A reader that started in epoch e
+// may hold anything current at e or later, which is every snapshot retired in e or later;
+// those retired before the oldest announced epoch are unreachable.  Called with
+// s_mutexWriters held.
+static void _Reclaim()
+{
+  unsigned long long ullOldest = ~0ULL;
+  for (SNAPSHOT_READER_SLOT* pSlot = s_pSlots.load(std::memory_order_acquire); pSlot; pSlot = pSlot->pNext)
+  {
+    unsigned long long ullEpoch = pSlot->ullEpoch.load();
+    if (ullEpoch && ullEpoch < ullOldest)
+    {
+      ullOldest = ullEpoch;
+    }
+  }
+
+  SNAPSHOT_NODE** ppNode = &s_pRetired;
+  while (*ppNode)
+  {
+    SNAPSHOT_NODE* pNode = *ppNode;
+    if (pNode->ullRetiredEpoch < ullOldest)
+    {
+      *ppNode = pNode->pNextRetired;
+      _FreeSnapshot(pNode);
+      s_cRetired--;
+      s_cReclaimed++;
+    }
+    else
+    {
+      ppNode = &pNode->pNextRetired;
+    }
+  }
+}
+
+CREDENTIAL_STORE_RESULT AccountSnapshotPublish(
+  const UserCredentials& uc,
+  const ACCOUNT_IDENTITY* pIdentity,
+  unsigned long long* pullVersion
+)
+{
+  // The copy is made before taking the lock, so writers only wait on each other for the
+  // swap and the scan.
+  SNAPSHOT_NODE* pNode = new (std::nothrow) SNAPSHOT_NODE;
+  CREDENTIAL_STORE_RESULT csr = pNode ? pNode->account.Assign(uc) : CSR_OUT_OF_MEMORY;
+  if (CSR_OK == csr)
+  {
+    std::lock_guard<std::mutex> lock(s_mutexWriters);
+    pNode->ullVersion = ++s_cPublished;
+    pNode->pIdentity = pIdentity;
+    pNode->pNextRetired = nullptr;
+    pNode->ullRetiredEpoch = 0;
+
+    SNAPSHOT_NODE* pOld = s_pCurrent.exchange(pNode);
+    if (pOld)
+    {
+      // Readers that announce this epoch or later may still load pOld, so it is retired in
+      // this epoch, and the epoch moves on for the readers that can no longer see it.
+      pOld->ullRetiredEpoch = s_ullEpoch.fetch_add(1);
+      pOld->pNextRetired = s_pRetired;
+      s_pRetired = pOld;
+      s_cRetired++;
+    }
+    _Reclaim();
+
+    if (pullVersion)
+    {
+      *pullVersion = pNode->ullVersion;
+    }
+  }
+  else
+  {
+    delete pNode;
+  }
+  return csr;
+}
+
+void AccountSnapshotShutdown()
+{
+  std::lock_guard<std::mutex> lock(s_mutexWriters);
+
+  SNAPSHOT_NODE* pNode = s_pCurrent.exchange(nullptr);
+  if (pNode)
+  {
+    _FreeSnapshot(pNode);
+  }
+  while (s_pRetired)
+  {
+    pNode = s_pRetired;
+    s_pRetired = pNode->pNextRetired;
+    _FreeSnapshot(pNode);
+  }
+  s_cRetired = 0;
+
+  SNAPSHOT_READER_SLOT* pSlot = s_pSlots.exchange(nullptr);
+  while (pSlot)
+  {
+    SNAPSHOT_READER_SLOT* pNext = pSlot->pNext;
+    delete pSlot;
+    pSlot = pNext;
+  }
+  s_cSlots.store(0);
+  t_pSlot = nullptr;
+}
+
+void AccountSnapshotGetStats(ACCOUNT_SNAPSHOT_STATS* pStats)
+{
+  std::lock_guard<std::mutex> lock(s_mutexWriters);
+  pStats->cPublished = s_cPublished;
+  pStats->cReclaimed = s_cReclaimed;
+  pStats->cRetired = s_cRetired;
+  pStats->cReaderSlots = s_cSlots.load();
+}
@@ -0,0 +1,90 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The process's current account, as a versioned snapshot that can be replaced at any time.
+//
+// Every tile logs on as the same account, and LogonUI reads it from several threads while a
+// rotation may be loading a new one.  So there is one current ACCOUNT_SNAPSHOT, which is never
+// changed once published.  A writer builds a new snapshot off to the side and swaps it in
+// with one atomic exchange.  Readers take no lock: a CAccountSnapshotReader announces which
+// epoch it started in and then loads the current pointer, and the snapshot it got stays valid
+// until it is destroyed, however many rotations land in the meantime.
+//
+// A replaced snapshot is retired with the epoch it was replaced in, and the epoch moves on.
+// Each publish then frees the retired snapshots that no reader can still hold: those retired
+// before the oldest epoch any reader announced.  Readers only ever pay for their own
+// announcement, which lives in a record of their thread's own; writers serialize among
+// themselves and do the scanning.  A read section that never ends keeps every snapshot
+// retired after it started, so keep them to the few calls that need the account.
+//
+// Platform-neutral: it depends only on the C++ standard library, AccountRecord.h and
+// AccountName.h.
+
+#pragma once
+
+#include "AccountRecord.h"
+#include "AccountName.h"
+
+struct ACCOUNT_SNAPSHOT
+{
+  unsigned long long ullVersion;    // 1 for the first published, counting up
+  CAccountRecord account;
+  const ACCOUNT_IDENTITY* pIdentity;  // the account's name, or NULL if it could not be parsed
+};
+
+struct ACCOUNT_SNAPSHOT_STATS
+{
+  unsigned long long cPublished;    // snapshots ever published in this process
+  unsigned long long cReclaimed;    // retired snapshots freed so far
+  unsigned long cRetired;           // retired snapshots still waiting on readers
+  unsigned long cReaderSlots;       // threads that have ever read, each with its own record
+};
+
+// Copies uc into a new snapshot, with pIdentity as its name, and makes it the current one.
+// *pullVersion, if given, receives its version.  Fails with what CAccountRecord::Assign
+// returns, or CSR_OUT_OF_MEMORY, leaving the current snapshot as it was.
+CREDENTIAL_STORE_RESULT AccountSnapshotPublish(
+  const UserCredentials& uc,
+  const ACCOUNT_IDENTITY* pIdentity,
+  unsigned long long* pullVersion
+);
+
+// Wipes and frees every snapshot, current and retired, and the reader records.  Only for
+// when nothing can be reading any more: the DLL calls it as it is unloaded.
+void AccountSnapshotShutdown();
+
+void AccountSnapshotGetStats(ACCOUNT_SNAPSHOT_STATS* pStats);
+
+// Gives the calling thread its reader record now, if it has none yet, so that its first
+// section does not allocate.  False if it could not.
+bool AccountSnapshotReserveReader();
+
+struct SNAPSHOT_READER_SLOT;
+
+// A read section.  Sections nest on a thread, and an inner one can see a newer snapshot than
+// the outer one, but never an older one.
+class CAccountSnapshotReader
+{
+public:
+  CAccountSnapshotReader();
+  ~CAccountSnapshotReader();
+
+  // The snapshot that was current when the section started, or NULL if none has been
+  // published (or, out of memory, the thread could not get a reader record).
+  const ACCOUNT_SNAPSHOT* Get() const
+  {
+    return _pSnapshot;
+  }
+
+private:
+  CAccountSnapshotReader(const CAccountSnapshotReader&);
+  CAccountSnapshotReader& operator=(const CAccountSnapshotReader&);
+
+  SNAPSHOT_READER_SLOT*   _pSlot;
+  const ACCOUNT_SNAPSHOT* _pSnapshot;
+};
@@ -5,257 +5,464 @@
 #endif
 #include <unknwn.h>
 #include "AutoLoginCredential.h"
+#include "TileStatus.h"
 #include "guid.h"
+#include "DpapiKeyProvider.h"
+#include "ReportResultMessage.h"
 
-// AutoLoginCredential ////////////////////////////////////////////////////////
+// AutoLoginCredentialBase ////////////////////////////////////////////////////////
 
-AutoLoginCredential::AutoLoginCredential() :
-  _cRef(1),
-  _pCredProvCredentialEvents(NULL)
+AutoLoginCredentialBase::AutoLoginCredentialBase() :
+  _pCredProvCredentialEvents(NULL),
+  _pStatusChannel(NULL),
+  _cRef(1)
 {
   DllAddRef();
-
-  ZeroMemory(_rgCredProvFieldDescriptors, sizeof(_rgCredProvFieldDescriptors));
-  ZeroMemory(_rgFieldStatePairs, sizeof(_rgFieldStatePairs));
-  ZeroMemory(_rgFieldStrings, sizeof(_rgFieldStrings));
 }
 
-AutoLoginCredential::~AutoLoginCredential()
+AutoLoginCredentialBase::~AutoLoginCredentialBase()
 {
-  for (int i = 0; i < ARRAYSIZE(_rgFieldStrings); i++)
+  if (_pStatusChannel)
   {
-    CoTaskMemFree(_rgFieldStrings[i]);
-    CoTaskMemFree(_rgCredProvFieldDescriptors[i].pszLabel);
+    _pStatusChannel->RemoveTile(this);
+    _pStatusChannel->Release();
   }
-
   DllRelease();
 }
 
-// Initializes one credential with the field information passed in.
-// Set the value of the SFI_USERNAME field to pwzUsername.
-// Optionally takes a password for the SetSerialization case.
-HRESULT AutoLoginCredential::Initialize(
-  __in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus,
-  __in const CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR* rgcpfd,
-  __in const FIELD_STATE_PAIR* rgfsp
-)
+void AutoLoginCredentialBase::AttachStatusChannel(__in CTileStatusChannel* pChannel)
 {
-  //UNREFERENCED_PARAMETER(pwzPassword);
+  pChannel->AddRef();
+  pChannel->AddTile(this);
+  if (_pStatusChannel)
+  {
+    _pStatusChannel->RemoveTile(this);
+    _pStatusChannel->Release();
+  }
+  _pStatusChannel = pChannel;
+}
 
- // pswd = pwzPassword;
-  HRESULT hr = S_OK;
+// Maps the platform-neutral result of loading the credential store onto an HRESULT.  A
+// missing or unreadable store fails Initialize, which keeps the tile from being shown
+// rather than taking LogonUI down with it.
+static HRESULT _HResultFromCredentialStoreResult(CREDENTIAL_STORE_RESULT csr)
+{
+  switch (csr)
+  {
+  case CSR_OK:
+    return S_OK;
 
-  _cpus = cpus;
+  case CSR_NOT_FOUND:
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
 
-  _sUserCredentials = getCredentialsFromFile("C:\\password.txt");
+  case CSR_ACCESS_DENIED:
+    return E_ACCESSDENIED;
 
-  // Copy the field descriptors for each field. This is useful if you want to vary the 
-  // field descriptors based on what Usage scenario the credential was created for.
-  for (DWORD i = 0; SUCCEEDED(hr) && i < ARRAYSIZE(_rgCredProvFieldDescriptors); i++)
-  {
-    _rgFieldStatePairs[i] = rgfsp[i];
-    hr = FieldDescriptorCopy(rgcpfd[i], &_rgCredProvFieldDescriptors[i]);
-  }
+  case CSR_BAD_FORMAT:
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
 
-  // Initialize the String values of all the fields.
-  if (SUCCEEDED(hr))
-  {
-    //LPCWSTR usercredentials;
-    hr = SHStrDupW(_sUserCredentials.username.c_str(), &_rgFieldStrings[SFI_USERNAME]);
-  }
-  if (SUCCEEDED(hr))
-  {
-    hr = SHStrDupW(L"Submit", &_rgFieldStrings[SFI_SUBMIT_BUTTON]);
-  }
+  case CSR_OUT_OF_MEMORY:
+    return E_OUTOFMEMORY;
 
-  return S_OK;
+  default:
+    return E_FAIL;
+  }
 }
 
-// LogonUI calls this in order to give us a callback in case we need to notify it of anything.
-HRESULT AutoLoginCredential::Advise(
-  __in ICredentialProviderCredentialEvents* pcpce
+// Builds the path of the shard (see CredentialStore.h) that should hold this machine's
+// record, from the ShardDirectory and ShardCount settings and pwzFormat, the shard file
+// name format.  Returns false when no sharded store is configured.
+static bool _GetShardPath(
+  __in PCWSTR pwzMachine,
+  __in size_t cchMachine,
+  __in PCWSTR pwzFormat,
+  __out_ecount(cchPath) PWSTR pwzPath,
+  __in size_t cchPath
 )
 {
-  if (_pCredProvCredentialEvents != NULL)
+  WCHAR wszDirectory[MAX_PATH];
+  DWORD cbDirectory = sizeof(wszDirectory);
+  DWORD dwShardCount = 0;
+  DWORD cbShardCount = sizeof(dwShardCount);
+  if (ERROR_SUCCESS != RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_SHARD_DIRECTORY, RRF_RT_REG_SZ, NULL, wszDirectory, &cbDirectory) ||
+    ERROR_SUCCESS != RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_SHARD_COUNT, RRF_RT_REG_DWORD, NULL, &dwShardCount, &cbShardCount) ||
+    0 == dwShardCount)
   {
-    _pCredProvCredentialEvents->Release();
+    return false;
   }
-  _pCredProvCredentialEvents = pcpce;
-  _pCredProvCredentialEvents->AddRef();
-  return S_OK;
+
+  WCHAR wszFile[MAX_PATH];
+  return SUCCEEDED(StringCchPrintfW(wszFile, ARRAYSIZE(wszFile), pwzFormat, CredentialStoreShardOf(pwzMachine, cchMachine, dwShardCount))) &&
+    SUCCEEDED(StringCchPrintfW(pwzPath, cchPath, L"%s\\%s", wszDirectory, wszFile));
 }
 
-// LogonUI calls this to tell us to release the callback.
-HRESULT AutoLoginCredential::UnAdvise()
+// Once a key file is configured, only sealed stores (see SealedStore.h) are read: the
+// machine's own CREDENTIAL_SEALED_STORE_PATH or else its sealed shard.  Falling back to a
+// plaintext store would let anyone who can drop one there choose the account.
+static CREDENTIAL_STORE_RESULT _LoadSealedStore(
+  __in PCWSTR pwzKeyFile,
+  __in PCWSTR pwzMachine,
+  __in size_t cchMachine,
+  __out UserCredentials* puc
+)
 {
-  if (_pCredProvCredentialEvents)
+  TRACE_SCOPE("SealedStoreLoad");
+  LATENCY_SCOPE(LP_STORE_DECRYPT);
+
+  DpapiKeyProvider keys(pwzKeyFile);
+  CREDENTIAL_STORE_RESULT csr = SealedStoreLoad(CREDENTIAL_SEALED_STORE_PATH, &keys, pwzMachine, cchMachine, puc);
+  if (CSR_NOT_FOUND == csr)
   {
-    _pCredProvCredentialEvents->Release();
+    WCHAR wszShard[MAX_PATH];
+    if (_GetShardPath(pwzMachine, cchMachine, SEALED_SHARD_FILE_FORMAT, wszShard, ARRAYSIZE(wszShard)))
+    {
+      csr = SealedStoreLoad(wszShard, &keys, pwzMachine, cchMachine, puc);
+    }
   }
-  _pCredProvCredentialEvents = NULL;
-  return S_OK;
+  return csr;
 }
 
-// LogonUI calls this function when our tile is selected (zoomed).
-// If you simply want fields to show/hide based on the selected state,
-// there's no need to do anything here - you can set that up in the 
-// field definitions.  But if you want to do something
-// more complicated, like change the contents of a field when the tile is
-// selected, you would do it here.
-HRESULT AutoLoginCredential::SetSelected(__out BOOL* pbAutoLogon)
+// Evaluates the compiled host rules (see HostRules.h) for this machine, its Tags and the
+// local time.  With a key file the rules must be sealed, for the same reason the stores
+// must be.
+static CREDENTIAL_STORE_RESULT _LoadHostRules(
+  __in PCWSTR pwzRulesFile,
+  __in_opt PCWSTR pwzKeyFile,
+  __in PCWSTR pwzMachine,
+  __in size_t cchMachine,
+  __out UserCredentials* puc
+)
 {
-  *pbAutoLogon = FALSE;
+  TRACE_SCOPE("HostRulesLoad");
+  LATENCY_SCOPE(LP_HOST_RULES);
 
-  return S_OK;
+  // A missing Tags value just means no tags.
+  WCHAR wszTags[1024];
+  DWORD cbTags = sizeof(wszTags);
+  PCWSTR rgpwzTags[64];
+  size_t cTags = 0;
+  if (ERROR_SUCCESS == RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_TAGS, RRF_RT_REG_MULTI_SZ, NULL, wszTags, &cbTags))
+  {
+    for (PCWSTR pwz = wszTags; *pwz && cTags < ARRAYSIZE(rgpwzTags); pwz += wcslen(pwz) + 1)
+    {
+      rgpwzTags[cTags++] = pwz;
+    }
+  }
+
+  SYSTEMTIME st;
+  GetLocalTime(&st);
+  HOST_RULES_QUERY query = { pwzMachine, cchMachine, rgpwzTags, cTags, st.wDayOfWeek, st.wHour * 60UL + st.wMinute };
+  if (pwzKeyFile)
+  {
+    DpapiKeyProvider keys(pwzKeyFile);
+    return HostRulesLoad(pwzRulesFile, &keys, query, puc, NULL);
+  }
+  return HostRulesLoad(pwzRulesFile, NULL, query, puc, NULL);
 }
 
-// Similarly to SetSelected, LogonUI calls this when your tile was selected
-// and now no longer is. The most common thing to do here (which we do below)
-// is to clear out the password field.
-HRESULT AutoLoginCredential::SetDeselected()
+// What loading the account depends on, apart from the files it reads.  Zero-filled, so it
+// can be hashed as it is.
+struct ACCOUNT_SOURCE
 {
-  HRESULT hr = S_OK;
-
-  return hr;
-}
+  WCHAR wszMachine[MAX_COMPUTERNAME_LENGTH + 1];
+  DWORD cchMachine;
+  WCHAR wszKeyFile[MAX_PATH];     // empty without a key file
+  WCHAR wszRulesFile[MAX_PATH];   // empty without a rules file
+};
 
-// Gets info for a particular field of a tile. Called by logonUI to get information to 
-// display the tile.
-HRESULT AutoLoginCredential::GetFieldState(
-  __in DWORD dwFieldID,
-  __out CREDENTIAL_PROVIDER_FIELD_STATE* pcpfs,
-  __out CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE* pcpfis
-)
+static void _GetAccountSource(__out ACCOUNT_SOURCE* pas)
 {
-  HRESULT hr;
+  ZeroMemory(pas, sizeof(*pas));
+  pas->cchMachine = ARRAYSIZE(pas->wszMachine);
+  if (!GetComputerNameW(pas->wszMachine, &pas->cchMachine))
+  {
+    pas->cchMachine = 0;
+  }
 
-  // Validate paramters.
-  if ((dwFieldID < ARRAYSIZE(_rgFieldStatePairs)) && pcpfs && pcpfis)
+  DWORD cbKeyFile = sizeof(pas->wszKeyFile);
+  if (ERROR_SUCCESS != RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_STORE_KEY_FILE, RRF_RT_REG_SZ, NULL, pas->wszKeyFile, &cbKeyFile))
   {
-    *pcpfs = _rgFieldStatePairs[dwFieldID].cpfs;
-    *pcpfis = _rgFieldStatePairs[dwFieldID].cpfis;
+    ZeroMemory(pas->wszKeyFile, sizeof(pas->wszKeyFile));
+  }
 
-    hr = S_OK;
+  DWORD cbRulesFile = sizeof(pas->wszRulesFile);
+  if (ERROR_SUCCESS != RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_RULES_FILE, RRF_RT_REG_SZ, NULL, pas->wszRulesFile, &cbRulesFile))
+  {
+    ZeroMemory(pas->wszRulesFile, sizeof(pas->wszRulesFile));
   }
-  else
+}
+
+// Adds pwzPath, and the size and last write time of the file there, to ullKey.  A missing
+// file adds zeroes, so creating it changes the key too.
+static ULONGLONG _AddFileStamp(__in ULONGLONG ullKey, __in PCWSTR pwzPath)
+{
+  WIN32_FILE_ATTRIBUTE_DATA fad;
+  if (!GetFileAttributesExW(pwzPath, GetFileExInfoStandard, &fad))
   {
-    hr = E_INVALIDARG;
+    ZeroMemory(&fad, sizeof(fad));
   }
-  return hr;
+  ullKey = SharedAccountKeyAdd(ullKey, pwzPath, wcslen(pwzPath) * sizeof(WCHAR));
+  ullKey = SharedAccountKeyAdd(ullKey, &fad.ftLastWriteTime, sizeof(fad.ftLastWriteTime));
+  ullKey = SharedAccountKeyAdd(ullKey, &fad.nFileSizeHigh, sizeof(fad.nFileSizeHigh));
+  return SharedAccountKeyAdd(ullKey, &fad.nFileSizeLow, sizeof(fad.nFileSizeLow));
 }
 
-// Sets ppwsz to the string value of the field at the index dwFieldID.
-HRESULT AutoLoginCredential::GetStringValue(
-  __in DWORD dwFieldID,
-  __deref_out PWSTR* ppwsz
-)
+// The key the account loaded from ras is shared under (see SharedAccountCache.h): the
+// settings, the stamps of every file _LoadUserCredentials might read and, when host rules
+// decide, everything they are evaluated against.  Costs a few registry reads and file
+// attribute lookups, and nothing is opened or decrypted.
+static ULONGLONG _GetAccountSourceKey(__in const ACCOUNT_SOURCE& ras)
 {
-  HRESULT hr;
+  ULONGLONG ullKey = SharedAccountKeyAdd(SHARED_ACCOUNT_KEY_EMPTY, &ras, sizeof(ras));
+  ullKey = _AddFileStamp(ullKey, CREDENTIAL_STORE_PATH);
+  ullKey = _AddFileStamp(ullKey, CREDENTIAL_SEALED_STORE_PATH);
 
-  // Check to make sure dwFieldID is a legitimate index.
-  if (dwFieldID < ARRAYSIZE(_rgCredProvFieldDescriptors) && ppwsz)
+  WCHAR wszShard[MAX_PATH];
+  if (_GetShardPath(ras.wszMachine, ras.cchMachine, CREDENTIAL_SHARD_FILE_FORMAT, wszShard, ARRAYSIZE(wszShard)))
   {
-    // Make a copy of the string and return that. The caller
-    // is responsible for freeing it.
-    hr = SHStrDupW(_rgFieldStrings[dwFieldID], ppwsz);
+    ullKey = _AddFileStamp(ullKey, wszShard);
   }
-  else
+  if (_GetShardPath(ras.wszMachine, ras.cchMachine, SEALED_SHARD_FILE_FORMAT, wszShard, ARRAYSIZE(wszShard)))
   {
-    hr = E_INVALIDARG;
+    ullKey = _AddFileStamp(ullKey, wszShard);
+  }
+  if (ras.wszKeyFile[0])
+  {
+    ullKey = _AddFileStamp(ullKey, ras.wszKeyFile);
   }
 
-  return hr;
+  if (ras.wszRulesFile[0])
+  {
+    ullKey = _AddFileStamp(ullKey, ras.wszRulesFile);
+
+    // The same Tags and minute _LoadHostRules evaluates the rules for, so an account chosen
+    // by a rule for 08:00-17:00 is not shared past 17:00.
+    WCHAR wszTags[1024] = {};
+    DWORD cbTags = sizeof(wszTags);
+    RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_TAGS, RRF_RT_REG_MULTI_SZ, NULL, wszTags, &cbTags);
+    ullKey = SharedAccountKeyAdd(ullKey, wszTags, sizeof(wszTags));
+
+    SYSTEMTIME st;
+    GetLocalTime(&st);
+    ullKey = SharedAccountKeyAdd(ullKey, &st.wDayOfWeek, sizeof(st.wDayOfWeek));
+    ullKey = SharedAccountKeyAdd(ullKey, &st.wHour, sizeof(st.wHour));
+    ullKey = SharedAccountKeyAdd(ullKey, &st.wMinute, sizeof(st.wMinute));
+  }
+  return ullKey;
 }
 
-// Gets the image to show in the user tile.
-HRESULT AutoLoginCredential::GetBitmapValue(
-  __in DWORD dwFieldID,
-  __out HBITMAP* phbmp
-)
+// Loads the account this tile logs on as: that of the first host rule that applies, if
+// a rules file is configured, and otherwise this machine's store.  Without a key file
+// that is the plaintext store at CREDENTIAL_STORE_PATH or, failing that, the machine's
+// plaintext shard.
+static CREDENTIAL_STORE_RESULT _LoadUserCredentials(__in const ACCOUNT_SOURCE& ras, __out UserCredentials* puc)
 {
-  HRESULT hr;
-  if ((SFI_TILEIMAGE == dwFieldID) && phbmp)
+  CREDENTIAL_STORE_RESULT csr;
+  PCWSTR pwzMachine = ras.wszMachine;
+  DWORD cchMachine = ras.cchMachine;
+  PCWSTR pwzKeyFile = ras.wszKeyFile[0] ? ras.wszKeyFile : NULL;
+
+  if (ras.wszRulesFile[0])
   {
-    HBITMAP hbmp = LoadBitmap(HINST_THISDLL, MAKEINTRESOURCE(IDB_TILE_IMAGE));
-    if (hbmp != NULL)
+    csr = _LoadHostRules(ras.wszRulesFile, pwzKeyFile, pwzMachine, cchMachine, puc);
+    if (CSR_NOT_FOUND != csr)
     {
-      hr = S_OK;
-      *phbmp = hbmp;
+      return csr;
+    }
+  }
+
+  if (pwzKeyFile)
+  {
+    return _LoadSealedStore(pwzKeyFile, pwzMachine, cchMachine, puc);
+  }
+
+  // Read and parse separately (rather than CredentialStoreLoad) so each is measured on its own.
+  std::vector<unsigned char> rgbStore;
+  bool fShard = false;
+  {
+    TRACE_SCOPE("CredentialStoreRead");
+    LATENCY_SCOPE(LP_CREDENTIAL_LOAD);
+    csr = CredentialStoreRead(CREDENTIAL_STORE_PATH, &rgbStore);
+    if (CSR_NOT_FOUND == csr)
+    {
+      WCHAR wszShard[MAX_PATH];
+      fShard = _GetShardPath(pwzMachine, cchMachine, CREDENTIAL_SHARD_FILE_FORMAT, wszShard, ARRAYSIZE(wszShard));
+      if (fShard)
+      {
+        csr = CredentialStoreRead(wszShard, &rgbStore);
+      }
+    }
+  }
+  if (CSR_OK == csr)
+  {
+    TRACE_SCOPE("CredentialStoreParse");
+    LATENCY_SCOPE(LP_UTF_CONVERSION);
+    if (fShard)
+    {
+      csr = CredentialStoreParseShard(rgbStore.empty() ? NULL : &rgbStore[0], rgbStore.size(), pwzMachine, cchMachine, puc);
     }
     else
     {
-      hr = HRESULT_FROM_WIN32(GetLastError());
+      csr = CredentialStoreParse(rgbStore.empty() ? NULL : &rgbStore[0], rgbStore.size(), puc);
     }
   }
-  else
+  if (!rgbStore.empty())
   {
-    hr = E_INVALIDARG;
+    SecureZeroMemory(&rgbStore[0], rgbStore.size());
   }
+  return csr;
+}
 
-  return hr;
+// Loads the account for a credential enumerated for cpus and makes it the current snapshot,
+// for this tile and every other.  A missing or unreadable store fails this, and with it the
+// tile, and leaves the current snapshot alone.
+HRESULT AutoLoginCredentialBase::_LoadAccount(
+  __in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus
+)
+{
+  _cpus = cpus;
+
+  BOOL fShared;
+  ULONGLONG ullVersion;
+  return LoadAccount(TRUE, &fShared, &ullVersion);
 }
 
-// Sets pdwAdjacentTo to the index of the field the submit button should be 
-// adjacent to. We recommend that the submit button is placed next to the last
-// field which the user is required to enter information in. Optional fields
-// should be below the submit button.
-HRESULT AutoLoginCredential::GetSubmitButtonValue(
-  __in DWORD dwFieldID,
-  __out DWORD* pdwAdjacentTo
+// The key of the account last loaded through the shared segment, or 0.  The status channel
+// compares it with the key as it is now to decide whether to load the account again.
+static volatile LONG64 s_llLoadedKey = 0;
+
+// The stores parse into a UserCredentials, which only lives long enough to be copied into
+// the snapshot and, the first time, into the shared segment.  The segment is only ever a
+// shortcut: if it can't be opened, holds another key or is being written, the account is
+// loaded as if it weren't there, and failing to publish to it fails nothing.
+HRESULT AutoLoginCredentialBase::LoadAccount(
+  __in BOOL fUseSharedCache,
+  __out BOOL* pfShared,
+  __out ULONGLONG* pullVersion
 )
 {
-  HRESULT hr;
+  TRACE_SCOPE("LoadAccount");
 
-  // Validate parameters.
-  if ((SFI_SUBMIT_BUTTON == dwFieldID) && pdwAdjacentTo)
+  *pfShared = FALSE;
+  *pullVersion = 0;
+
+  ACCOUNT_SOURCE as;
+  _GetAccountSource(&as);
+
+  UserCredentials uc;
+  ULONGLONG ullKey = 0;
+  CREDENTIAL_STORE_RESULT csr = CSR_NOT_FOUND;
+  if (fUseSharedCache)
   {
-    // pdwAdjacentTo is a pointer to the fieldID you want the submit button to appear next to.
-    *pdwAdjacentTo = SFI_USERNAME;
-    hr = S_OK;
+    TRACE_SCOPE("SharedAccountCacheRead");
+    ullKey = _GetAccountSourceKey(as);
+    csr = SharedAccountCacheRead(ullKey, &uc, pullVersion);
+    *pfShared = (CSR_OK == csr);
   }
-  else
+  if (CSR_OK != csr)
   {
-    hr = E_INVALIDARG;
+    csr = _LoadUserCredentials(as, &uc);
+    if (CSR_OK == csr && fUseSharedCache)
+    {
+      TRACE_SCOPE("SharedAccountCacheWrite");
+      SharedAccountCacheWrite(ullKey, uc);
+    }
+  }
+  if (CSR_OK == csr)
+  {
+    // An account whose name doesn't parse can still log on; it just never matches a
+    // SetSerialization.
+    const ACCOUNT_IDENTITY* pIdentity;
+    AccountNameIntern(uc.domain.c_str(), uc.domain.size(), uc.username.c_str(), uc.username.size(),
+      as.wszMachine, as.cchMachine, &pIdentity);
+    csr = AccountSnapshotPublish(uc, pIdentity, NULL);
+    if (CSR_OK == csr && fUseSharedCache)
+    {
+      InterlockedExchange64(&s_llLoadedKey, static_cast<LONG64>(ullKey));
+    }
   }
+  if (!uc.password.empty())
+  {
+    SecureZeroMemory(&uc.password[0], uc.password.size() * sizeof(WCHAR));
+  }
+
+  HRESULT hr = _HResultFromCredentialStoreResult(csr);
+  FlightRecordResult("LoadUserCredentials", hr);
   return hr;
 }
 
-// Sets the value of a field which can accept a string as a value.
-// This is called on each keystroke when a user types into an edit field.
-HRESULT AutoLoginCredential::SetStringValue(
-  __in DWORD dwFieldID,
-  __in PCWSTR pwz
+BOOL AutoLoginCredentialBase::HasAccountChanged()
+{
+  TRACE_FUNCTION();
+  ACCOUNT_SOURCE as;
+  _GetAccountSource(&as);
+  return static_cast<LONG64>(_GetAccountSourceKey(as)) != InterlockedCompareExchange64(&s_llLoadedKey, 0, 0);
+}
+
+// LogonUI calls this in order to give us a callback in case we need to notify it of anything.
+HRESULT AutoLoginCredentialBase::Advise(
+  __in ICredentialProviderCredentialEvents* pcpce
 )
 {
-  HRESULT hr;
+  TRACE_FUNCTION();
+  if (_pCredProvCredentialEvents != NULL)
+  {
+    _pCredProvCredentialEvents->Release();
+  }
+  _pCredProvCredentialEvents = pcpce;
+  _pCredProvCredentialEvents->AddRef();
+  return S_OK;
+}
 
-  // Validate parameters.
-  if (dwFieldID < ARRAYSIZE(_rgCredProvFieldDescriptors) &&
-    (CPFT_EDIT_TEXT == _rgCredProvFieldDescriptors[dwFieldID].cpft ||
-      CPFT_PASSWORD_TEXT == _rgCredProvFieldDescriptors[dwFieldID].cpft))
+// LogonUI calls this to tell us to release the callback.
+HRESULT AutoLoginCredentialBase::UnAdvise()
+{
+  TRACE_FUNCTION();
+  if (_pCredProvCredentialEvents)
   {
-    PWSTR* ppwszStored = &_rgFieldStrings[dwFieldID];
-    CoTaskMemFree(*ppwszStored);
-    hr = SHStrDupW(pwz, ppwszStored);
+    _pCredProvCredentialEvents->Release();
   }
-  else
+  _pCredProvCredentialEvents = NULL;
+  return S_OK;
+}
+
+// LogonUI calls this function when our tile is selected (zoomed).
+// If you simply want fields to show/hide based on the selected state,
+// there's no need to do anything here - you can set that up in the 
+// field definitions.  But if you want to do something
+// more complicated, like change the contents of a field when the tile is
+// selected, you would do it here.
+//
+// We check on the pool whether the account has changed since it was loaded, so that a
+// rotation since the tile was made is the account it logs on with; only if it has does the
+// status field say so, while it is loaded again.  The one allocation is the check's work
+// item, which the pool frees when it has run.
+HRESULT AutoLoginCredentialBase::SetSelected(__out BOOL* pbAutoLogon)
+{
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(1, 1);
+  _attempt.Stamp(LAM_SET_SELECTED);
+  *pbAutoLogon = FALSE;
+
+  if (_pStatusChannel)
   {
-    hr = E_INVALIDARG;
+    _pStatusChannel->StartAccountCheck();
   }
 
-  return hr;
+  return S_OK;
 }
 
 //------------- 
 // The following methods are for logonUI to get the values of various UI elements and then communicate
 // to the credential about what the user did in that field.  However, these methods are not implemented
 // because our tile doesn't contain these types of UI elements
-HRESULT AutoLoginCredential::GetCheckboxValue(
+HRESULT AutoLoginCredentialBase::GetCheckboxValue(
   __in DWORD dwFieldID,
   __out BOOL* pbChecked,
   __deref_out PWSTR* ppwszLabel
 )
 {
+  TRACE_FUNCTION();
   UNREFERENCED_PARAMETER(dwFieldID);
   UNREFERENCED_PARAMETER(pbChecked);
   UNREFERENCED_PARAMETER(ppwszLabel);
@@ -263,195 +470,595 @@ HRESULT AutoLoginCredential::GetCheckboxValue(
   return E_NOTIMPL;
 }
 
-HRESULT AutoLoginCredential::GetComboBoxValueCount(
+HRESULT AutoLoginCredentialBase::GetComboBoxValueCount(
   __in DWORD dwFieldID,
   __out DWORD* pcItems,
   __out_range(< , *pcItems) DWORD* pdwSelectedItem
 )
 {
+  TRACE_FUNCTION();
   UNREFERENCED_PARAMETER(dwFieldID);
   UNREFERENCED_PARAMETER(pcItems);
   UNREFERENCED_PARAMETER(pdwSelectedItem);
   return E_NOTIMPL;
 }
 
-HRESULT AutoLoginCredential::GetComboBoxValueAt(
+HRESULT AutoLoginCredentialBase::GetComboBoxValueAt(
   __in DWORD dwFieldID,
   __in DWORD dwItem,
   __deref_out PWSTR* ppwszItem
 )
 {
+  TRACE_FUNCTION();
   UNREFERENCED_PARAMETER(dwFieldID);
   UNREFERENCED_PARAMETER(dwItem);
   UNREFERENCED_PARAMETER(ppwszItem);
   return E_NOTIMPL;
 }
 
-HRESULT AutoLoginCredential::SetCheckboxValue(
+HRESULT AutoLoginCredentialBase::SetCheckboxValue(
   __in DWORD dwFieldID,
   __in BOOL bChecked
 )
 {
+  TRACE_FUNCTION();
   UNREFERENCED_PARAMETER(dwFieldID);
   UNREFERENCED_PARAMETER(bChecked);
 
   return E_NOTIMPL;
 }
 
-HRESULT AutoLoginCredential::SetComboBoxSelectedValue(
+HRESULT AutoLoginCredentialBase::SetComboBoxSelectedValue(
   __in DWORD dwFieldId,
   __in DWORD dwSelectedItem
 )
 {
+  TRACE_FUNCTION();
   UNREFERENCED_PARAMETER(dwFieldId);
   UNREFERENCED_PARAMETER(dwSelectedItem);
   return E_NOTIMPL;
 }
 
-HRESULT AutoLoginCredential::CommandLinkClicked(__in DWORD dwFieldID)
+HRESULT AutoLoginCredentialBase::CommandLinkClicked(__in DWORD dwFieldID)
 {
+  TRACE_FUNCTION();
   UNREFERENCED_PARAMETER(dwFieldID);
   return E_NOTIMPL;
 }
 //------ end of methods for controls we don't have in our tile ----//
 
-// Collect the username and password into a serialized credential for the correct usage scenario 
+// Packs the username and password into a serialized credential for the correct usage scenario 
 // (logon/unlock is what's demonstrated in this sample).  LogonUI then passes these credentials 
 // back to the system to log on.
-HRESULT AutoLoginCredential::GetSerialization(
+HRESULT AutoLoginCredentialBase::_Serialize(
+  __in const CAccountRecord& rar,
+  __in PCWSTR pwzPassword,
   __out CREDENTIAL_PROVIDER_GET_SERIALIZATION_RESPONSE* pcpgsr,
-  __out CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs,
-  __deref_out_opt PWSTR* ppwszOptionalStatusText,
-  __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsiOptionalStatusIcon
+  __out CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs
 )
 {
-  UNREFERENCED_PARAMETER(ppwszOptionalStatusText);
-  UNREFERENCED_PARAMETER(pcpsiOptionalStatusIcon);
+  PWSTR domain2 = const_cast<PWSTR>(rar.Domain());
 
-  HRESULT hr;
-
-  //WCHAR wsz[MAX_COMPUTERNAME_LENGTH + 1]; // NMEA our computer name
-  //DWORD cch = ARRAYSIZE(wsz);
+  // Protecting into the stack leaves the packed credential as GetSerialization's only
+  // allocation.  Only a password of some hundreds of characters needs more room than this;
+  // it takes the copies ProtectIfNecessaryAndCopyPassword allocates, and the budget reports
+  // them.
+  WCHAR wszProtectedPassword[PROTECTED_PASSWORD_STACK_CCH];
+  DWORD cchProtectedPassword = ARRAYSIZE(wszProtectedPassword);
+  PWSTR pwzProtectedPassword = wszProtectedPassword;
+  PWSTR pwzAllocatedPassword = NULL;
 
-  std::wstring domain = _sUserCredentials.domain;
- // LPCWSTR d2 = domain.c_str();
-  PWSTR domain2 = (PWSTR)domain.c_str();
-  //if (GetComputerNameW(wsz, &cch))
-  //{
+  HRESULT hr = ProtectIfNecessaryIntoBuffer(pwzPassword, _cpus, wszProtectedPassword, &cchProtectedPassword);
+  if (HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER) == hr)
+  {
+    hr = ProtectIfNecessaryAndCopyPassword(pwzPassword, _cpus, &pwzAllocatedPassword);
+    pwzProtectedPassword = pwzAllocatedPassword;
+  }
 
-    PWSTR pwzProtectedPassword;
+  if (SUCCEEDED(hr))
+  {
+    KERB_INTERACTIVE_UNLOCK_LOGON kiul;
 
-    hr = ProtectIfNecessaryAndCopyPassword(_sUserCredentials.password.c_str(), _cpus, &pwzProtectedPassword);
+    // Initialize kiul with weak references to our credential.
+    hr = KerbInteractiveUnlockLogonInit(domain2, const_cast<PWSTR>(rar.Username()), pwzProtectedPassword, _cpus, &kiul);
 
     if (SUCCEEDED(hr))
     {
-      KERB_INTERACTIVE_UNLOCK_LOGON kiul;
-
-      // Initialize kiul with weak references to our credential.
-      hr = KerbInteractiveUnlockLogonInit(domain2, _rgFieldStrings[SFI_USERNAME], pwzProtectedPassword, _cpus, &kiul);
+      // We use KERB_INTERACTIVE_UNLOCK_LOGON in both unlock and logon scenarios.  It contains a
+      // KERB_INTERACTIVE_LOGON to hold the creds plus a LUID that is filled in for us by Winlogon
+      // as necessary.
+      hr = KerbInteractiveUnlockLogonPack(kiul, &pcpcs->rgbSerialization, &pcpcs->cbSerialization);
 
       if (SUCCEEDED(hr))
       {
-        // We use KERB_INTERACTIVE_UNLOCK_LOGON in both unlock and logon scenarios.  It contains a
-        // KERB_INTERACTIVE_LOGON to hold the creds plus a LUID that is filled in for us by Winlogon
-        // as necessary.
-        hr = KerbInteractiveUnlockLogonPack(kiul, &pcpcs->rgbSerialization, &pcpcs->cbSerialization);
-
+        ULONG ulAuthPackage;
+        hr = RetrieveNegotiateAuthPackage(&ulAuthPackage);
         if (SUCCEEDED(hr))
         {
-          ULONG ulAuthPackage;
-          hr = RetrieveNegotiateAuthPackage(&ulAuthPackage);
-          if (SUCCEEDED(hr))
-          {
-            pcpcs->ulAuthenticationPackage = ulAuthPackage;
-            pcpcs->clsidCredentialProvider = CLSID_CSample;
-
-            // At this point the credential has created the serialized credential used for logon
-            // By setting this to CPGSR_RETURN_CREDENTIAL_FINISHED we are letting logonUI know
-            // that we have all the information we need and it should attempt to submit the 
-            // serialized credential.
-            *pcpgsr = CPGSR_RETURN_CREDENTIAL_FINISHED;
-          }
+          pcpcs->ulAuthenticationPackage = ulAuthPackage;
+          pcpcs->clsidCredentialProvider = CLSID_CSample;
+
+          // At this point the credential has created the serialized credential used for logon
+          // By setting this to CPGSR_RETURN_CREDENTIAL_FINISHED we are letting logonUI know
+          // that we have all the information we need and it should attempt to submit the 
+          // serialized credential.
+          *pcpgsr = CPGSR_RETURN_CREDENTIAL_FINISHED;
+          _attempt.Stamp(LAM_GET_SERIALIZATION);
         }
       }
-
-      CoTaskMemFree(pwzProtectedPassword);
     }
-  //}
-  //else
-  //{
-  //  DWORD dwErr = GetLastError();
-  //  hr = HRESULT_FROM_WIN32(dwErr);
-  //}
+
+    // In the CPUS_CREDUI scenario this is the password itself.
+    SecureZeroMemory(wszProtectedPassword, sizeof(wszProtectedPassword));
+    TrackedCoTaskMemFree(pwzAllocatedPassword);
+  }
 
   return hr;
 }
-struct REPORT_RESULT_STATUS_INFO
-{
-  NTSTATUS ntsStatus;
-  NTSTATUS ntsSubstatus;
-  PWSTR     pwzMessage;
-  CREDENTIAL_PROVIDER_STATUS_ICON cpsi;
-};
-
-static const REPORT_RESULT_STATUS_INFO s_rgLogonStatusInfo[] =
-{
-    { STATUS_LOGON_FAILURE, STATUS_SUCCESS, L"Incorrect password or username.", CPSI_ERROR, },
-    { STATUS_ACCOUNT_RESTRICTION, STATUS_ACCOUNT_DISABLED, L"The account is disabled.", CPSI_WARNING },
-};
 
 // ReportResult is completely optional.  Its purpose is to allow a credential to customize the string
 // and the icon displayed in the case of a logon failure.  For example, we have chosen to 
 // customize the error shown in the case of bad username/password and in the case of the account
 // being disabled.
-HRESULT AutoLoginCredential::ReportResult(
+HRESULT AutoLoginCredentialBase::ReportResult(
   __in NTSTATUS ntsStatus,
   __in NTSTATUS ntsSubstatus,
   __deref_out_opt PWSTR* ppwszOptionalStatusText,
   __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsiOptionalStatusIcon
 )
 {
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(1, 1);
   *ppwszOptionalStatusText = NULL;
   *pcpsiOptionalStatusIcon = CPSI_NONE;
 
-  DWORD dwStatusInfo = (DWORD)-1;
+  ULONGLONG ullSubmitNs;
+  ULONGLONG ullResultNs;
+  _attempt.Complete(&ullSubmitNs, &ullResultNs);
+  if (g_fLatencyEnabled)
+  {
+    if (LOGON_ATTEMPT_NOT_REACHED != ullSubmitNs)
+    {
+      LatencyRecordNanoseconds(LP_TIME_TO_SUBMIT, ullSubmitNs);
+    }
+    LatencyRecordNanoseconds(LP_TIME_TO_RESULT, ullResultNs);
+  }
+
+  // The audit log times the logon itself, from the serialized credential to its result.  It
+  // names the account current now, which a rotation since GetSerialization may have replaced.
+  ULONGLONG ullLatencyNs = (LOGON_ATTEMPT_NOT_REACHED != ullSubmitNs) ? ullResultNs - ullSubmitNs : 0;
+  {
+    CAccountSnapshotReader reader;
+    const ACCOUNT_SNAPSHOT* pSnapshot = reader.Get();
+    AuditLogRecord(_cpus, pSnapshot ? pSnapshot->account.Domain() : L"", pSnapshot ? pSnapshot->account.Username() : L"",
+      ntsStatus, ntsSubstatus, ullLatencyNs);
+  }
+  FlightRecordResult("ReportResult status", ntsStatus);
+  FlightRecordResult("ReportResult substatus", ntsSubstatus);
+
+  ReportResultMessageLoad(ReportResultMessageCatalog(HINST_THISDLL), GetThreadUILanguage(), ntsStatus, ntsSubstatus,
+    ppwszOptionalStatusText, pcpsiOptionalStatusIcon);
+
+  // Since NULL is a valid value for *ppwszOptionalStatusText and *pcpsiOptionalStatusIcon
+  // this function can't fail.
+  return S_OK;
+}
+
+// AutoLoginCredential ////////////////////////////////////////////////////////
+
+template <class TSchema>
+constexpr std::array<FIELD_SCHEMA_ENTRY, AutoLoginCredential<TSchema>::c_cFields> AutoLoginCredential<TSchema>::s_rgFieldSchema;
+
+template <class TSchema>
+constexpr std::array<FIELD_STATE_PAIR, AutoLoginCredential<TSchema>::c_cFields> AutoLoginCredential<TSchema>::s_rgFieldStatePairs;
+
+template <class TSchema>
+constexpr std::array<CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR, AutoLoginCredential<TSchema>::c_cFields> AutoLoginCredential<TSchema>::s_rgCredProvFieldDescriptors;
+
+template <class TSchema>
+constexpr std::array<DWORD, AutoLoginCredential<TSchema>::c_cFields> AutoLoginCredential<TSchema>::s_rgiEditSlots;
+
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::GetFieldDescriptorAt(
+  __in DWORD dwIndex,
+  __deref_out CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR** ppcpfd
+)
+{
+  HRESULT hr;
+
+  // Verify dwIndex is a valid field.
+  if ((dwIndex < c_cFields) && ppcpfd)
+  {
+    hr = FieldDescriptorCoAllocCopyN(s_rgCredProvFieldDescriptors[dwIndex], s_rgFieldSchema[dwIndex].cchLabel, ppcpfd);
+  }
+  else
+  {
+    hr = E_INVALIDARG;
+  }
+
+  return hr;
+}
+
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::CreateInstance(
+  __in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus,
+  __deref_out AutoLoginCredentialBase** ppcred
+)
+{
+  HRESULT hr;
+  *ppcred = NULL;
+
+  AutoLoginCredential* pcred = new AutoLoginCredential();
+  if (pcred)
+  {
+    hr = pcred->_Initialize(cpus);
+    if (SUCCEEDED(hr))
+    {
+      *ppcred = pcred;
+    }
+    else
+    {
+      // Release the pointer to account for the local reference.
+      pcred->Release();
+    }
+  }
+  else
+  {
+    hr = E_OUTOFMEMORY;
+  }
+
+  return hr;
+}
+
+template <class TSchema>
+size_t AutoLoginCredential<TSchema>::GetBytes() const
+{
+  return sizeof(*this) + _editBuffers.HeapBytes();
+}
+
+// Loads the account and points every field not taken from it at where the schema says its
+// value comes from.  Nothing is copied but what is typed into the edit fields.
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::_Initialize(
+  __in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus
+)
+{
+  TRACE_FUNCTION();
+  HRESULT hr = _LoadAccount(cpus);
+
+  for (DWORD i = 0; SUCCEEDED(hr) && i < c_cFields; i++)
+  {
+    switch (s_rgFieldSchema[i].fv)
+    {
+    case FV_USERNAME:
+    case FV_DOMAIN:
+      // Read from the current snapshot each time; see _GetFieldString.
+      break;
+
+    case FV_PASSWORD:
+      // Edit fields start out empty rather than without a value.
+      hr = _SetEditString(i, L"", 0);
+      break;
+
+    case FV_STATUS:
+      // Empty until the provider attaches a channel; see _GetFieldString.
+      _rgFieldStrings[i].pwz = L"";
+      _rgFieldStrings[i].cch = 0;
+      break;
+
+    default:
+      _rgFieldStrings[i] = s_rgFieldSchema[i].fsStatic;
+      break;
+    }
+  }
+
+  return hr;
+}
 
-  // Look for a match on status and substatus.
-  for (DWORD i = 0; i < ARRAYSIZE(s_rgLogonStatusInfo); i++)
+template <class TSchema>
+FIELD_STRING AutoLoginCredential<TSchema>::_GetFieldString(
+  __in DWORD dwFieldID,
+  __in_opt const ACCOUNT_SNAPSHOT* pSnapshot
+) const
+{
+  FIELD_STRING fs = _rgFieldStrings[dwFieldID];
+  if (FV_STATUS == s_rgFieldSchema[dwFieldID].fv && _pStatusChannel)
+  {
+    fs.pwz = _pStatusChannel->Status().wz;
+    fs.cch = _pStatusChannel->Status().cch;
+  }
+  else if (pSnapshot)
   {
-    if (s_rgLogonStatusInfo[i].ntsStatus == ntsStatus && s_rgLogonStatusInfo[i].ntsSubstatus == ntsSubstatus)
+    switch (s_rgFieldSchema[dwFieldID].fv)
     {
-      dwStatusInfo = i;
+    case FV_USERNAME:
+      fs.pwz = pSnapshot->account.Username();
+      fs.cch = pSnapshot->account.UsernameLength();
+      break;
+
+    case FV_DOMAIN:
+      fs.pwz = pSnapshot->account.Domain();
+      fs.cch = pSnapshot->account.DomainLength();
+      break;
+
+    default:
       break;
     }
   }
+  return fs;
+}
+
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::_SetEditString(
+  __in DWORD dwFieldID,
+  __in_ecount(cch) PCWSTR pwz,
+  __in size_t cch
+)
+{
+  FieldStringBuffer* pfsb = _editBuffers.At(s_rgiEditSlots[dwFieldID]);
+  HRESULT hr = E_INVALIDARG;
+  if (pfsb)
+  {
+    hr = _HResultFromCredentialStoreResult(CredentialStoreResultFromPlatform(pfsb->Assign(pwz, cch)));
+  }
+  if (SUCCEEDED(hr))
+  {
+    // The buffer may have moved to the heap.
+    _rgFieldStrings[dwFieldID].pwz = pfsb->Get();
+    _rgFieldStrings[dwFieldID].cch = pfsb->Length();
+  }
+  return hr;
+}
+
+// The status field shows the channel's status, which has just become update, so all there is
+// to do is tell LogonUI.  The channel calls this on LogonUI's thread.
+template <class TSchema>
+void AutoLoginCredential<TSchema>::OnStatusChanged(const STATUS_UPDATE& update)
+{
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(0, 0);
+  if (_pCredProvCredentialEvents)
+  {
+    _pCredProvCredentialEvents->SetFieldString(this, c_iStatus, update.wz);
+  }
+}
+
+// Similarly to SetSelected, LogonUI calls this when your tile was selected
+// and now no longer is. The most common thing to do here (which we do below)
+// is to clear out the password field.
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::SetDeselected()
+{
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(0, 0);
+  HRESULT hr = S_OK;
 
-  if ((DWORD)-1 != dwStatusInfo)
+  for (DWORD i = 0; SUCCEEDED(hr) && i < c_cFields; i++)
   {
-    if (SUCCEEDED(SHStrDupW(s_rgLogonStatusInfo[dwStatusInfo].pwzMessage, ppwszOptionalStatusText)))
+    if (c_dwEditableFields & (1UL << i))
     {
-      *pcpsiOptionalStatusIcon = s_rgLogonStatusInfo[dwStatusInfo].cpsi;
+      hr = _SetEditString(i, L"", 0);
+      if (SUCCEEDED(hr) && _pCredProvCredentialEvents)
+      {
+        _pCredProvCredentialEvents->SetFieldString(this, i, L"");
+      }
     }
   }
 
+  return hr;
+}
 
-  // Since NULL is a valid value for *ppwszOptionalStatusText and *pcpsiOptionalStatusIcon
-  // this function can't fail.
-  return S_OK;
+// Gets info for a particular field of a tile. Called by logonUI to get information to 
+// display the tile.
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::GetFieldState(
+  __in DWORD dwFieldID,
+  __out CREDENTIAL_PROVIDER_FIELD_STATE* pcpfs,
+  __out CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE* pcpfis
+)
+{
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(0, 0);
+  HRESULT hr;
+
+  // Validate paramters.
+  if ((dwFieldID < c_cFields) && pcpfs && pcpfis)
+  {
+    *pcpfs = s_rgFieldStatePairs[dwFieldID].cpfs;
+    *pcpfis = s_rgFieldStatePairs[dwFieldID].cpfis;
+
+    hr = S_OK;
+  }
+  else
+  {
+    hr = E_INVALIDARG;
+  }
+  return hr;
+}
+
+// Sets ppwsz to the string value of the field at the index dwFieldID.
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::GetStringValue(
+  __in DWORD dwFieldID,
+  __deref_out PWSTR* ppwsz
+)
+{
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(1, 1);
+  HRESULT hr;
+
+  // Check to make sure dwFieldID is a legitimate index.
+  if (dwFieldID < c_cFields && ppwsz)
+  {
+    // Make a copy of the string and return that. The caller
+    // is responsible for freeing it. LogonUI polls this while it paints
+    // the tile, so the length is stored rather than recomputed.  The
+    // account's fields show whichever snapshot is current, so the next
+    // repaint after a rotation picks it up.
+    CAccountSnapshotReader reader;
+    FIELD_STRING fs = _GetFieldString(dwFieldID, reader.Get());
+    hr = fs.pwz ? StringCoAllocCopy(fs.pwz, fs.cch, ppwsz) : E_INVALIDARG;
+  }
+  else
+  {
+    hr = E_INVALIDARG;
+  }
+
+  return hr;
+}
+
+// Gets the image to show in the user tile.
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::GetBitmapValue(
+  __in DWORD dwFieldID,
+  __out HBITMAP* phbmp
+)
+{
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(0, 0);
+  HRESULT hr;
+  if ((c_iTileImage == dwFieldID) && phbmp)
+  {
+    HBITMAP hbmp = LoadBitmap(HINST_THISDLL, MAKEINTRESOURCE(IDB_TILE_IMAGE));
+    if (hbmp != NULL)
+    {
+      hr = S_OK;
+      *phbmp = hbmp;
+    }
+    else
+    {
+      hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+  }
+  else
+  {
+    hr = E_INVALIDARG;
+  }
+
+  return hr;
+}
+
+// Sets pdwAdjacentTo to the index of the field the submit button should be 
+// adjacent to. We recommend that the submit button is placed next to the last
+// field which the user is required to enter information in. Optional fields
+// should be below the submit button.
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::GetSubmitButtonValue(
+  __in DWORD dwFieldID,
+  __out DWORD* pdwAdjacentTo
+)
+{
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(0, 0);
+  HRESULT hr;
+
+  // Validate parameters.
+  if ((c_iSubmitButton == dwFieldID) && pdwAdjacentTo)
+  {
+    // pdwAdjacentTo is a pointer to the fieldID you want the submit button to appear next to.
+    *pdwAdjacentTo = c_iSubmitAdjacentTo;
+    hr = S_OK;
+  }
+  else
+  {
+    hr = E_INVALIDARG;
+  }
+  return hr;
+}
+
+// Sets the value of a field which can accept a string as a value.
+// This is called on each keystroke when a user types into an edit field.
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::SetStringValue(
+  __in DWORD dwFieldID,
+  __in PCWSTR pwz
+)
+{
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(1, 1);
+  HRESULT hr;
+
+  // Validate parameters.
+  if (dwFieldID < c_cFields && (c_dwEditableFields & (1UL << dwFieldID)) && pwz)
+  {
+    // This runs on every keystroke; the field's buffer absorbs it without allocating
+    // unless the value has outgrown everything it held before.
+    hr = _SetEditString(dwFieldID, pwz, wcslen(pwz));
+  }
+  else
+  {
+    hr = E_INVALIDARG;
+  }
+
+  return hr;
 }
 
+// The password a tile without a password field logs on with: the stored one.
+static PCWSTR _GetPassword(__in std::false_type fHasPasswordField, __in const CAccountRecord& rar, __in const FIELD_STRING& rfsTyped)
+{
+  UNREFERENCED_PARAMETER(fHasPasswordField);
+  UNREFERENCED_PARAMETER(rfsTyped);
+  return rar.Password();
+}
+
+// The password a tile with a password field logs on with: what was typed into it, or NULL
+// until something has been.  Submitting an empty password would only count against the
+// account's lockout threshold.
+static PCWSTR _GetPassword(__in std::true_type fHasPasswordField, __in const CAccountRecord& rar, __in const FIELD_STRING& rfsTyped)
+{
+  UNREFERENCED_PARAMETER(fHasPasswordField);
+  UNREFERENCED_PARAMETER(rar);
+  return rfsTyped.cch ? rfsTyped.pwz : NULL;
+}
 
-UserCredentials AutoLoginCredential::getCredentialsFromFile(std::string fileName) {
-  //std::string filename = "password.txt";
-  std::wifstream  fin(fileName.c_str());
-  if (!fin) {
-    std::cerr << "Error. Could not open file" << std::endl;
-    abort();
+// Logs on as the stored account, with the stored password or, on a tile with a password
+// field, with what was typed into it.
+template <class TSchema>
+HRESULT AutoLoginCredential<TSchema>::GetSerialization(
+  __out CREDENTIAL_PROVIDER_GET_SERIALIZATION_RESPONSE* pcpgsr,
+  __out CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs,
+  __deref_out_opt PWSTR* ppwszOptionalStatusText,
+  __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsiOptionalStatusIcon
+)
+{
+  TRACE_FUNCTION();
+  LATENCY_SCOPE(LP_GET_SERIALIZATION);
+  ALLOC_BUDGET(1, 1);
+  UNREFERENCED_PARAMETER(ppwszOptionalStatusText);
+  UNREFERENCED_PARAMETER(pcpsiOptionalStatusIcon);
+
+  HRESULT hr;
+
+  // The user name, domain and stored password all come from one snapshot, even if a
+  // rotation lands while this runs.  Once a tile exists there always is one, unless this
+  // thread could not get a reader record.
+  CAccountSnapshotReader reader;
+  const ACCOUNT_SNAPSHOT* pSnapshot = reader.Get();
+  if (pSnapshot)
+  {
+    // Which of the two is chosen at compile time; without a password field the index only
+    // has to stay in range.
+    PCWSTR pwzPassword = _GetPassword(std::integral_constant<bool, c_fHasPasswordField>(), pSnapshot->account,
+      _rgFieldStrings[c_fHasPasswordField ? c_iPassword : 0]);
+    if (pwzPassword)
+    {
+      hr = _Serialize(pSnapshot->account, pwzPassword, pcpgsr, pcpcs);
+    }
+    else
+    {
+      *pcpgsr = CPGSR_NO_CREDENTIAL_NOT_FINISHED;
+      hr = S_OK;
+    }
+  }
+  else
+  {
+    hr = E_OUTOFMEMORY;
   }
-  UserCredentials result;
-  getline(fin, result.domain);
-  getline(fin, result.username);
-  getline(fin, result.password);
-  fin.close();
-  return result;
+
+  FlightRecordResult(__FUNCTION__, hr);
+  return hr;
 }
+
+template class AutoLoginCredential<USERNAME_TILE_SCHEMA>;
+template class AutoLoginCredential<USERNAME_DOMAIN_TILE_SCHEMA>;
+template class AutoLoginCredential<PASSWORD_TILE_SCHEMA>;
@@ -12,14 +12,33 @@
 // user has entered into the tile.  ICredentialProviderCredential is also
 // responsible for packaging up the users credentials into a buffer that
 // LogonUI then sends on to LSA.
+//
+// AutoLoginCredentialBase does everything that does not depend on the layout of the tile:
+// loading the account, packing it up and reporting the result.  AutoLoginCredential<TSchema>
+// adds the fields of one of the layouts in TileSchema.h.
+//
+// A tile is kept small, since LogonUI may hold many of them.  Everything that is the same
+// for every tile of a layout (descriptors, labels, field states, static values) lives in
+// tables shared by the layout.  The account is not the tile's at all: every tile reads the
+// current snapshot (see AccountSnapshot.h), so a rotation reaches tiles LogonUI already
+// holds.  Nor is the status field's text: every tile of the provider shows the status of the
+// one CTileStatusChannel (see TileStatus.h).  Each other field's value is a FIELD_STRING that
+// points into the schema or, for the fields LogonUI edits, the field's FieldStringBuffer;
+// fields it doesn't edit have no buffer.
 
 #pragma once
 
 #include "common.h"
-#include "dll.h"
+#include "FieldStringBuffer.h"
+#include "AccountSnapshot.h"
+#include "SharedAccountCache.h"
+#include "StatusQueue.h"
+#include "Dll.h"
 #include "resource.h"
 
-class AutoLoginCredential : public ICredentialProviderCredential
+class CTileStatusChannel;
+
+class AutoLoginCredentialBase : public ICredentialProviderCredential, public IStatusSink
 {
 public:
   // IUnknown
@@ -42,7 +61,7 @@ public:
   {
     static const QITAB qit[] =
     {
-        QITABENT(AutoLoginCredential, ICredentialProviderCredential), // IID_ICredentialProviderCredential
+        QITABENT(AutoLoginCredentialBase, ICredentialProviderCredential), // IID_ICredentialProviderCredential
         {0},
     };
     return QISearch(this, qit, riid, ppv);
@@ -53,6 +72,119 @@ public:
   IFACEMETHODIMP UnAdvise();
 
   IFACEMETHODIMP SetSelected(__out BOOL* pbAutoLogon);
+
+  IFACEMETHODIMP GetCheckboxValue(__in DWORD dwFieldID, __out BOOL* pbChecked, __deref_out PWSTR* ppwszLabel);
+  IFACEMETHODIMP GetComboBoxValueCount(__in DWORD dwFieldID, __out DWORD* pcItems, __out_range(< , *pcItems) DWORD* pdwSelectedItem);
+  IFACEMETHODIMP GetComboBoxValueAt(__in DWORD dwFieldID, __in DWORD dwItem, __deref_out PWSTR* ppwszItem);
+
+  IFACEMETHODIMP SetCheckboxValue(__in DWORD dwFieldID, __in BOOL bChecked);
+  IFACEMETHODIMP SetComboBoxSelectedValue(__in DWORD dwFieldID, __in DWORD dwSelectedItem);
+  IFACEMETHODIMP CommandLinkClicked(__in DWORD dwFieldID);
+
+  IFACEMETHODIMP ReportResult(__in NTSTATUS ntsStatus,
+    __in NTSTATUS ntsSubstatus,
+    __deref_out_opt PWSTR* ppwszOptionalStatusText,
+    __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsiOptionalStatusIcon);
+
+public:
+  // For the provider's calls on the way to a logon; see LogonAttempt.h.
+  void StampAttempt(__in LOGON_ATTEMPT_MILESTONE lam, __in ULONGLONG ullNs)
+  {
+    _attempt.Stamp(lam, ullNs);
+  }
+
+  // What the tile has allocated: the object and every heap block it owns.  For
+  // DllGetTileFootprint.
+  virtual size_t GetBytes() const = 0;
+
+  // Shows pChannel's status in the status field from now on, and checks the account through
+  // it whenever the tile is selected.  From the provider, as it makes the tile.
+  void AttachStatusChannel(__in CTileStatusChannel* pChannel);
+
+  // Loads the account and publishes it as the current snapshot, through the segment shared
+  // between sessions (see SharedAccountCache.h) if fUseSharedCache.  *pfShared says whether
+  // the account came out of the segment, and *pullVersion is the segment's version if so.
+  // For _LoadAccount and DllMeasureAccountLoad.
+  static HRESULT LoadAccount(__in BOOL fUseSharedCache, __out BOOL* pfShared, __out ULONGLONG* pullVersion);
+
+  // Whether anything the account is loaded from (the same stamps the shared segment is keyed
+  // on) has changed since LoadAccount last loaded it through the segment.  Much cheaper than
+  // loading it.  For the status channel's check.
+  static BOOL HasAccountChanged();
+
+protected:
+  AutoLoginCredentialBase();
+
+  virtual ~AutoLoginCredentialBase();
+
+  // Loads the account this tile logs on as and publishes it as the current snapshot.
+  HRESULT _LoadAccount(__in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus);
+
+  // Packs rar's domain and user name, with pwzPassword, into a serialized credential.
+  HRESULT _Serialize(__in const CAccountRecord& rar,
+    __in PCWSTR pwzPassword,
+    __out CREDENTIAL_PROVIDER_GET_SERIALIZATION_RESPONSE* pcpgsr,
+    __out CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs);
+
+  CREDENTIAL_PROVIDER_USAGE_SCENARIO    _cpus; // The usage scenario for which we were enumerated.
+
+  ICredentialProviderCredentialEvents* _pCredProvCredentialEvents;
+
+  CTileStatusChannel*                   _pStatusChannel;  // NULL until the provider attaches one
+
+private:
+  LONG                                  _cRef;
+
+  CLogonAttempt                         _attempt;   // the logon attempt on this tile so far
+};
+
+// The FieldStringBuffers of a layout's cEdit edit fields.  A layout without any has none,
+// rather than an unused one to satisfy the language.
+template <size_t cEdit>
+struct FIELD_EDIT_BUFFERS
+{
+  FieldStringBuffer* At(__in DWORD iSlot)
+  {
+    return &rgfsb[iSlot];
+  }
+
+  size_t HeapBytes() const
+  {
+    size_t cb = 0;
+    for (size_t i = 0; i < cEdit; i++)
+    {
+      cb += rgfsb[i].HeapBytes();
+    }
+    return cb;
+  }
+
+  FieldStringBuffer rgfsb[cEdit];
+};
+
+template <>
+struct FIELD_EDIT_BUFFERS<0>
+{
+  FieldStringBuffer* At(__in DWORD iSlot)
+  {
+    UNREFERENCED_PARAMETER(iSlot);
+    return NULL;
+  }
+
+  size_t HeapBytes() const
+  {
+    return 0;
+  }
+};
+
+// The credential for a tile laid out by TSchema (see TileSchema.h).  Everything about the
+// layout is a compile-time constant here: LogonUI's repeated GetFieldState and
+// GetStringValue calls index tables shared by every tile of the layout, and nothing looks
+// at the type of a field to decide what to do with it.
+template <class TSchema>
+class AutoLoginCredential : public AutoLoginCredentialBase
+{
+public:
+  // ICredentialProviderCredential
   IFACEMETHODIMP SetDeselected();
 
   IFACEMETHODIMP GetFieldState(__in DWORD dwFieldID,
@@ -61,53 +193,98 @@ public:
 
   IFACEMETHODIMP GetStringValue(__in DWORD dwFieldID, __deref_out PWSTR* ppwsz);
   IFACEMETHODIMP GetBitmapValue(__in DWORD dwFieldID, __out HBITMAP* phbmp);
-  IFACEMETHODIMP GetCheckboxValue(__in DWORD dwFieldID, __out BOOL* pbChecked, __deref_out PWSTR* ppwszLabel);
-  IFACEMETHODIMP GetComboBoxValueCount(__in DWORD dwFieldID, __out DWORD* pcItems, __out_range(< , *pcItems) DWORD* pdwSelectedItem);
-  IFACEMETHODIMP GetComboBoxValueAt(__in DWORD dwFieldID, __in DWORD dwItem, __deref_out PWSTR* ppwszItem);
   IFACEMETHODIMP GetSubmitButtonValue(__in DWORD dwFieldID, __out DWORD* pdwAdjacentTo);
 
   IFACEMETHODIMP SetStringValue(__in DWORD dwFieldID, __in PCWSTR pwz);
-  IFACEMETHODIMP SetCheckboxValue(__in DWORD dwFieldID, __in BOOL bChecked);
-  IFACEMETHODIMP SetComboBoxSelectedValue(__in DWORD dwFieldID, __in DWORD dwSelectedItem);
-  IFACEMETHODIMP CommandLinkClicked(__in DWORD dwFieldID);
 
   IFACEMETHODIMP GetSerialization(__out CREDENTIAL_PROVIDER_GET_SERIALIZATION_RESPONSE* pcpgsr,
     __out CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs,
     __deref_out_opt PWSTR* ppwszOptionalStatusText,
     __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsiOptionalStatusIcon);
-  IFACEMETHODIMP ReportResult(__in NTSTATUS ntsStatus,
-    __in NTSTATUS ntsSubstatus,
-    __deref_out_opt PWSTR* ppwszOptionalStatusText,
-    __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsiOptionalStatusIcon);
 
 public:
-  HRESULT Initialize(__in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus,
-    __in const CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR* rgcpfd,
-    __in const FIELD_STATE_PAIR* rgfsp);
+  static constexpr size_t c_cFields = TSchema::Fields().size();
+
+  // For the provider's GetFieldDescriptorAt.
+  static HRESULT GetFieldDescriptorAt(__in DWORD dwIndex, __deref_out CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR** ppcpfd);
+
+  // Makes a credential for cpus and loads its account.
+  static HRESULT CreateInstance(__in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus, __deref_out AutoLoginCredentialBase** ppcred);
 
-  AutoLoginCredential();
+  size_t GetBytes() const;
 
-  virtual ~AutoLoginCredential();
+  // IStatusSink: passes the status the channel has just drained on to LogonUI.
+  void OnStatusChanged(const STATUS_UPDATE& update);
 
 private:
-  UserCredentials getCredentialsFromFile(std::string fileName);
-  UserCredentials                       _sUserCredentials;                          // struct to hold user credentials
-  std::wstring s2ws(const std::string& s);                                          // string to wstring converter
-  LONG                                  _cRef;
+  AutoLoginCredential() :
+    _rgFieldStrings()
+  {
+  }
 
-  CREDENTIAL_PROVIDER_USAGE_SCENARIO    _cpus; // The usage scenario for which we were enumerated.
+  HRESULT _Initialize(__in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus);
 
-  CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR  _rgCredProvFieldDescriptors[SFI_NUM_FIELDS]; // An array holding the type and 
-                                                                                     // name of each field in the tile.
+  // The value of field dwFieldID, with the account's fields taken from pSnapshot and the
+  // status from the channel.  Without a snapshot the account's fields have no value.
+  FIELD_STRING _GetFieldString(__in DWORD dwFieldID, __in_opt const ACCOUNT_SNAPSHOT* pSnapshot) const;
 
-  FIELD_STATE_PAIR                      _rgFieldStatePairs[SFI_NUM_FIELDS];          // An array holding the state of 
-                                                                                     // each field in the tile.
+  // Copies cch characters at pwz into the buffer of edit field dwFieldID and points the
+  // field's value at it.
+  HRESULT _SetEditString(__in DWORD dwFieldID, __in_ecount(cch) PCWSTR pwz, __in size_t cch);
 
-  PWSTR                                 _rgFieldStrings[SFI_NUM_FIELDS];             // An array holding the string 
-                                                                                     // value of each field. This is 
-                                                                                     // different from the name of 
-                                                                                     // the field held in 
-                                                                                     // _rgCredProvFieldDescriptors.
-  ICredentialProviderCredentialEvents* _pCredProvCredentialEvents;
+  static_assert(c_cFields > 0 && c_cFields <= 32, "a tile must have between 1 and 32 fields");
+  static_assert(FieldSchemaIsInOrder(TSchema::Fields()), "schema entries must be in field ID order");
+  static_assert(1 == FieldSchemaCountType(TSchema::Fields(), CPFT_TILE_IMAGE), "a tile must have exactly one image");
+  static_assert(1 == FieldSchemaCountType(TSchema::Fields(), CPFT_SUBMIT_BUTTON), "a tile must have exactly one submit button");
+  static_assert(1 == FieldSchemaCountValue(TSchema::Fields(), FV_USERNAME), "a tile must show the account name exactly once");
+  static_assert(1 >= FieldSchemaCountValue(TSchema::Fields(), FV_PASSWORD), "a tile can have at most one password field");
+  static_assert(1 == FieldSchemaCountValue(TSchema::Fields(), FV_STATUS), "a tile must have exactly one status field");
+  static_assert(FieldSchemaValuesFitTypes(TSchema::Fields()), "every field's value must suit its type");
 
+  static constexpr DWORD c_iTileImage = FieldSchemaFindType(TSchema::Fields(), CPFT_TILE_IMAGE);
+  static constexpr DWORD c_iSubmitButton = FieldSchemaFindType(TSchema::Fields(), CPFT_SUBMIT_BUTTON);
+  static constexpr DWORD c_iUsername = FieldSchemaFindValue(TSchema::Fields(), FV_USERNAME);
+  static constexpr DWORD c_iPassword = FieldSchemaFindValue(TSchema::Fields(), FV_PASSWORD);
+  static constexpr DWORD c_iStatus = FieldSchemaFindValue(TSchema::Fields(), FV_STATUS);
+
+  // The submit button goes next to the last field the user has to fill in, if any.
+  static constexpr DWORD c_iSubmitAdjacentTo = (FIELD_NOT_PRESENT != c_iPassword) ? c_iPassword : c_iUsername;
+  static constexpr DWORD c_dwEditableFields = FieldSchemaEditableMask(TSchema::Fields());
+
+  static constexpr bool c_fHasPasswordField = FIELD_NOT_PRESENT != c_iPassword;
+
+  static constexpr size_t c_cEditFields = FieldSchemaCountEditable(TSchema::Fields());
+
+  static constexpr std::array<FIELD_SCHEMA_ENTRY, c_cFields> s_rgFieldSchema = TSchema::Fields();
+
+  // These two arrays are seperate because LogonUI asks for the states of every field each
+  // time it paints the tile, and only for the descriptors when it sets the tile up.
+  static constexpr std::array<FIELD_STATE_PAIR, c_cFields> s_rgFieldStatePairs =
+    MakeFieldStatePairs(TSchema::Fields(), std::make_index_sequence<c_cFields>());
+
+  // Field descriptors for unlock and logon.
+  static constexpr std::array<CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR, c_cFields> s_rgCredProvFieldDescriptors =
+    MakeFieldDescriptors(TSchema::Fields(), std::make_index_sequence<c_cFields>());
+
+  // Which of _editBuffers holds each field, or FIELD_NOT_PRESENT.
+  static constexpr std::array<DWORD, c_cFields> s_rgiEditSlots =
+    MakeFieldEditSlots(TSchema::Fields(), std::make_index_sequence<c_cFields>());
+
+  FIELD_STRING                          _rgFieldStrings[c_cFields];   // The string value of each field and its
+                                                                      // length. This is different from the name
+                                                                      // of the field held in
+                                                                      // s_rgCredProvFieldDescriptors. The
+                                                                      // account's fields are left empty.
+
+  FIELD_EDIT_BUFFERS<c_cEditFields>     _editBuffers;
 };
+
+// The layouts the provider can give its tiles, by TILE_LAYOUT.  The member definitions of
+// AutoLoginCredential, and its instantiations for these, are in AutoLoginCredential.cpp.
+typedef AutoLoginCredential<USERNAME_TILE_SCHEMA> UsernameCredential;
+typedef AutoLoginCredential<USERNAME_DOMAIN_TILE_SCHEMA> UsernameDomainCredential;
+typedef AutoLoginCredential<PASSWORD_TILE_SCHEMA> PasswordCredential;
+
+extern template class AutoLoginCredential<USERNAME_TILE_SCHEMA>;
+extern template class AutoLoginCredential<USERNAME_DOMAIN_TILE_SCHEMA>;
+extern template class AutoLoginCredential<PASSWORD_TILE_SCHEMA>;
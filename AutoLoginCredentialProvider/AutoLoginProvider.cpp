@@ -1,21 +1,86 @@
 
 #include <credentialprovider.h>
+#include <windows.h>
+#include <psapi.h>
+#include <vector>
 #include "AutoLoginProvider.h"
 #include "AutoLoginCredential.h"
 #include "guid.h"
 
 // AutoLoginProvider ////////////////////////////////////////////////////////
 
+// By TILE_LAYOUT.
+static const TILE_LAYOUT_INFO s_rgTileLayouts[] =
+{
+  { UsernameCredential::c_cFields, UsernameCredential::GetFieldDescriptorAt, UsernameCredential::CreateInstance },
+  { UsernameDomainCredential::c_cFields, UsernameDomainCredential::GetFieldDescriptorAt, UsernameDomainCredential::CreateInstance },
+  { PasswordCredential::c_cFields, PasswordCredential::GetFieldDescriptorAt, PasswordCredential::CreateInstance },
+};
+
+static_assert(ARRAYSIZE(s_rgTileLayouts) == TL_NUM_LAYOUTS, "s_rgTileLayouts must have an entry for every TILE_LAYOUT");
+static_assert(MAX_CREDENTIALS <= STATUS_MAX_SINKS, "the status channel must reach every tile");
+
 AutoLoginProvider::AutoLoginProvider() :
   _cRef(1),
   _pkiulSetSerialization(NULL),
   _dwNumCreds(0),
   _bAutoSubmitSetSerializationCred(false),
-  _dwSetSerializationCred(CREDENTIAL_PROVIDER_NO_DEFAULT)
+  _cbSetSerialization(0),
+  _ulSetSerializationAuthPackage(0),
+  _bCredsEnumerated(false),
+  _dwSetSerializationCred(CREDENTIAL_PROVIDER_NO_DEFAULT),
+  _pStatusChannel(NULL)
 {
   DllAddRef();
 
   ZeroMemory(_rgpCredentials, sizeof(_rgpCredentials));
+  ZeroMemory(_rgbSetSerializationDigest, sizeof(_rgbSetSerializationDigest));
+
+  // An unknown layout gets the default rather than no tile at all.
+  DWORD dwTileLayout = TL_USERNAME;
+  DWORD cbTileLayout = sizeof(dwTileLayout);
+  if (ERROR_SUCCESS != RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_TILE_LAYOUT, RRF_RT_REG_DWORD, NULL, &dwTileLayout, &cbTileLayout) ||
+    dwTileLayout >= TL_NUM_LAYOUTS)
+  {
+    dwTileLayout = TL_USERNAME;
+  }
+  _pLayout = &s_rgTileLayouts[dwTileLayout];
+
+  DWORD cbTraceFile = sizeof(_wszTraceFile);
+  if (ERROR_SUCCESS == RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_TRACE_FILE, RRF_RT_REG_SZ, NULL, _wszTraceFile, &cbTraceFile))
+  {
+    TraceEnable(true);
+  }
+  else
+  {
+    _wszTraceFile[0] = L'\0';
+  }
+
+  DWORD cbHistogramFile = sizeof(_wszHistogramFile);
+  if (ERROR_SUCCESS == RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_HISTOGRAM_FILE, RRF_RT_REG_SZ, NULL, _wszHistogramFile, &cbHistogramFile))
+  {
+    LatencyEnable(true);
+  }
+  else
+  {
+    _wszHistogramFile[0] = L'\0';
+  }
+
+  WCHAR wszAuditFile[MAX_PATH];
+  DWORD cbAuditFile = sizeof(wszAuditFile);
+  _fAuditLogOpen = (ERROR_SUCCESS == RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_AUDIT_FILE, RRF_RT_REG_SZ, NULL, wszAuditFile, &cbAuditFile)) &&
+    PR_OK == AuditLogOpen(wszAuditFile);
+
+  // The ring stays mapped until the DLL is unloaded, so there is nothing to close.
+  WCHAR wszFlightRecorderFile[MAX_PATH];
+  DWORD cbFlightRecorderFile = sizeof(wszFlightRecorderFile);
+  if (ERROR_SUCCESS == RegGetValueW(HKEY_LOCAL_MACHINE, SETTINGS_KEY, SETTINGS_FLIGHT_RECORDER_FILE, RRF_RT_REG_SZ, NULL, wszFlightRecorderFile, &cbFlightRecorderFile))
+  {
+    FlightRecorderOpen(wszFlightRecorderFile, FLIGHT_RECORDER_DEFAULT_EVENTS);
+  }
+
+  // Without a channel the tiles just never show a status.
+  CTileStatusChannel::CreateInstance(&_pStatusChannel);
 }
 
 AutoLoginProvider::~AutoLoginProvider()
@@ -28,6 +93,40 @@ AutoLoginProvider::~AutoLoginProvider()
     }
   }
 
+  // A check still running holds the channel until it is done, but posts to no window.
+  if (_pStatusChannel)
+  {
+    _pStatusChannel->Close();
+    _pStatusChannel->Release();
+  }
+
+  // Each provider instance lives for one LogonUI session, so this leaves the most recent
+  // session (and whatever older spans still fit in the buffers) on disk.
+  if (_wszTraceFile[0] != L'\0')
+  {
+    TraceWriteChromeJson(_wszTraceFile);
+  }
+
+  // Fold what this session recorded into the running totals on disk.
+  if (_wszHistogramFile[0] != L'\0')
+  {
+    LATENCY_PHASE_HISTOGRAMS* plph = new (std::nothrow) LATENCY_PHASE_HISTOGRAMS();
+    if (plph)
+    {
+      LatencyTake(plph);
+      HistogramFileAccumulate(_wszHistogramFile, *plph);
+      delete plph;
+    }
+  }
+
+  _CleanupSetSerialization();
+
+  // Writes out whatever our credentials reported before letting the writer go.
+  if (_fAuditLogOpen)
+  {
+    AuditLogClose();
+  }
+
   DllRelease();
 }
 
@@ -41,8 +140,39 @@ void AutoLoginProvider::_CleanupSetSerialization()
       pkil->LogonDomainName.MaximumLength +
       pkil->UserName.MaximumLength +
       pkil->Password.MaximumLength);
-    HeapFree(GetProcessHeap(), 0, _pkiulSetSerialization);
+    TrackedHeapFree(GetProcessHeap(), 0, _pkiulSetSerialization);
+    _pkiulSetSerialization = NULL;
   }
+  SecureZeroMemory(_rgbSetSerializationDigest, sizeof(_rgbSetSerializationDigest));
+  _cbSetSerialization = 0;
+  _ulSetSerializationAuthPackage = 0;
+}
+
+// Whether pcpcs is the serialization we already hold, byte for byte.  Remote Desktop hands
+// the same one over again and again while a client reconnects, and each would otherwise be
+// copied, unpacked and given a new tile.  The blob we hold has been unpacked in place, so
+// what we compare against is its SHA-256, in time that doesn't depend on where the digests
+// differ.  *pbDigest receives the digest of pcpcs either way.  The budget covers our own
+// allocations; whatever BCrypt needs for the hash is its own and isn't counted (see
+// AllocTrack.h).  LogonUISimulator -replay checks that a repeat keeps its tile.
+bool AutoLoginProvider::_IsSetSerializationRepeat(
+  __in const CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs,
+  __out_bcount(PLATFORM_SHA256_SIZE) BYTE* pbDigest
+)
+{
+  ALLOC_BUDGET(0, 0);
+  if (PR_OK != PlatformSha256(pcpcs->rgbSerialization, pcpcs->cbSerialization, pbDigest))
+  {
+    return false;
+  }
+
+  DWORD dwDiffer = 0;
+  for (DWORD i = 0; i < PLATFORM_SHA256_SIZE; i++)
+  {
+    dwDiffer |= pbDigest[i] ^ _rgbSetSerializationDigest[i];
+  }
+  return _pkiulSetSerialization && 0 == dwDiffer &&
+    pcpcs->cbSerialization == _cbSetSerialization && pcpcs->ulAuthenticationPackage == _ulSetSerializationAuthPackage;
 }
 
 
@@ -56,10 +186,13 @@ HRESULT AutoLoginProvider::SetUsageScenario(
   __in DWORD dwFlags
 )
 {
+  TRACE_FUNCTION();
+  LATENCY_SCOPE(LP_SET_USAGE_SCENARIO);
   UNREFERENCED_PARAMETER(dwFlags);
   HRESULT hr;
 
-  static bool s_bCredsEnumerated = false;
+  // A logon attempt starts when LogonUI asks, not when our credential exists.
+  ULONGLONG ullStartNs = PlatformMonotonicNanoseconds();
 
   // Decide which scenarios to support here. Returning E_NOTIMPL simply tells the caller
   // that we're not designed for that scenario.
@@ -69,12 +202,19 @@ HRESULT AutoLoginProvider::SetUsageScenario(
   case CPUS_UNLOCK_WORKSTATION:
     // A more advanced credprov might only enumerate tiles for the user whose owns the locked
     // session, since those are the only creds that wil work
-    if (!s_bCredsEnumerated)
+    // Both the tile's GetSerialization and a SetSerialization will need the auth package,
+    // so look it up while LogonUI is still drawing.
+    PrefetchNegotiateAuthPackage();
+
+    // The tiles read the account on this thread inside their allocation budgets, so its
+    // reader record is made here, once, rather than by whichever of them reads first.
+    AccountSnapshotReserveReader();
+    if (!_bCredsEnumerated)
     {
       _cpus = cpus;
      // UserCredentials credentials = getCredentialsFromFile("C:\\password.txt");
       hr = this->_MakeAutoLoginCredential(0);
-      s_bCredsEnumerated = true;
+      _bCredsEnumerated = true;
     }
     else
     {
@@ -92,6 +232,12 @@ HRESULT AutoLoginProvider::SetUsageScenario(
     break;
   }
 
+  for (DWORD i = 0; SUCCEEDED(hr) && i < _dwNumCreds; i++)
+  {
+    _rgpCredentials[i]->StampAttempt(LAM_SET_USAGE_SCENARIO, ullStartNs);
+  }
+
+  FlightRecordResult(__FUNCTION__, hr);
   return hr;
 }
 
@@ -112,9 +258,19 @@ HRESULT AutoLoginProvider::SetSerialization(
   __in const CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs
 )
 {
+  TRACE_FUNCTION();
   HRESULT hr = E_INVALIDARG;
 
-  if ((CLSID_CSample == pcpcs->clsidCredentialProvider))
+  // The one we hold passed every check below, and its tile (if GetCredentialCount has made
+  // it) stays as it is.  Coming again, it is submitted again if it was the first time.
+  BYTE rgbDigest[PLATFORM_SHA256_SIZE] = {};
+  if (CLSID_CSample == pcpcs->clsidCredentialProvider && 0 < pcpcs->cbSerialization && pcpcs->rgbSerialization &&
+    _IsSetSerializationRepeat(pcpcs, rgbDigest))
+  {
+    _bAutoSubmitSetSerializationCred = (_dwSetSerializationCred != CREDENTIAL_PROVIDER_NO_DEFAULT) && _pkiulSetSerialization->Logon.Password.Length;
+    hr = S_OK;
+  }
+  else if ((CLSID_CSample == pcpcs->clsidCredentialProvider))
   {
     // Get the current AuthenticationPackageID that we are supporting
     ULONG ulAuthPackage;
@@ -129,7 +285,7 @@ HRESULT AutoLoginProvider::SetSerialization(
         if (KerbInteractiveLogon == pkil->Logon.MessageType)
         {
           BYTE* rgbSerialization;
-          rgbSerialization = (BYTE*)HeapAlloc(GetProcessHeap(), 0, pcpcs->cbSerialization);
+          rgbSerialization = (BYTE*)TrackedHeapAlloc(GetProcessHeap(), 0, pcpcs->cbSerialization);
           hr = rgbSerialization ? S_OK : E_OUTOFMEMORY;
 
           if (SUCCEEDED(hr))
@@ -139,7 +295,7 @@ HRESULT AutoLoginProvider::SetSerialization(
 
             if (_pkiulSetSerialization)
             {
-              HeapFree(GetProcessHeap(), 0, _pkiulSetSerialization);
+              _CleanupSetSerialization();
 
               // For this sample, we know that _dwSetSerializationCred is always in the last slot
               if (_dwSetSerializationCred != CREDENTIAL_PROVIDER_NO_DEFAULT && _dwSetSerializationCred == _dwNumCreds - 1)
@@ -151,6 +307,9 @@ HRESULT AutoLoginProvider::SetSerialization(
               }
             }
             _pkiulSetSerialization = (KERB_INTERACTIVE_UNLOCK_LOGON*)rgbSerialization;
+            CopyMemory(_rgbSetSerializationDigest, rgbDigest, sizeof(rgbDigest));
+            _cbSetSerialization = pcpcs->cbSerialization;
+            _ulSetSerializationAuthPackage = ulAuthPackage;
             hr = S_OK;
           }
         }
@@ -166,11 +325,15 @@ HRESULT AutoLoginProvider::SetSerialization(
 
 // Called by LogonUI to give you a callback.  Providers often use the callback if they
 // some event would cause them to need to change the set of tiles that they enumerated
+//
+// Ours never changes its tiles.  The status channel reaches the tiles through their own
+// events and its own window, since CredentialsChanged would have LogonUI enumerate them again.
 HRESULT AutoLoginProvider::Advise(
   __in ICredentialProviderEvents* pcpe,
   __in UINT_PTR upAdviseContext
 )
 {
+  TRACE_FUNCTION();
   UNREFERENCED_PARAMETER(pcpe);
   UNREFERENCED_PARAMETER(upAdviseContext);
 
@@ -180,6 +343,7 @@ HRESULT AutoLoginProvider::Advise(
 // Called by LogonUI when the ICredentialProviderEvents callback is no longer valid.
 HRESULT AutoLoginProvider::UnAdvise()
 {
+  TRACE_FUNCTION();
   return E_NOTIMPL;
 }
 
@@ -193,7 +357,9 @@ HRESULT AutoLoginProvider::GetFieldDescriptorCount(
   __out DWORD* pdwCount
 )
 {
-  *pdwCount = SFI_NUM_FIELDS;
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(0, 0);
+  *pdwCount = _pLayout->cFields;
 
   return S_OK;
 }
@@ -204,19 +370,10 @@ HRESULT AutoLoginProvider::GetFieldDescriptorAt(
   __deref_out CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR** ppcpfd
 )
 {
-  HRESULT hr;
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(2, 2);
 
-  // Verify dwIndex is a valid field.
-  if ((dwIndex < SFI_NUM_FIELDS) && ppcpfd)
-  {
-    hr = FieldDescriptorCoAllocCopy(s_rgCredProvFieldDescriptors[dwIndex], ppcpfd);
-  }
-  else
-  {
-    hr = E_INVALIDARG;
-  }
-
-  return hr;
+  return _pLayout->pfnGetFieldDescriptorAt(dwIndex, ppcpfd);
 }
 
 // Sets pdwCount to the number of tiles that we wish to show at this time.
@@ -235,6 +392,7 @@ HRESULT AutoLoginProvider::GetCredentialCount(
   __out BOOL* pbAutoLogonWithDefault
 )
 {
+  TRACE_FUNCTION();
   HRESULT hr = S_OK;
 
   if (_pkiulSetSerialization && _dwSetSerializationCred == CREDENTIAL_PROVIDER_NO_DEFAULT)
@@ -259,6 +417,10 @@ HRESULT AutoLoginProvider::GetCredentialCount(
       *pdwDefault = CREDENTIAL_PROVIDER_NO_DEFAULT;
     }
     *pbAutoLogonWithDefault = _bAutoSubmitSetSerializationCred;
+
+    // Submitted once.  Should LogonUI ask again, it gets the tile to show, not to submit
+    // again; only another SetSerialization asks for that.
+    _bAutoSubmitSetSerializationCred = false;
   }
   else
   {
@@ -278,12 +440,15 @@ HRESULT AutoLoginProvider::GetCredentialAt(
   __deref_out ICredentialProviderCredential** ppcpc
 )
 {
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(0, 0);
   HRESULT hr;
 
   // Validate parameters.
   if ((dwIndex < _dwNumCreds) && ppcpc)
   {
     hr = _rgpCredentials[dwIndex]->QueryInterface(IID_ICredentialProviderCredential, reinterpret_cast<void**>(ppcpc));
+    _rgpCredentials[dwIndex]->StampAttempt(LAM_GET_CREDENTIAL_AT, PlatformMonotonicNanoseconds());
   }
   else
   {
@@ -293,42 +458,128 @@ HRESULT AutoLoginProvider::GetCredentialAt(
   return hr;
 }
 
-// Creates a Credential with the SFI_USERNAME field's value set to pwzUsername.
+// Creates a Credential with our tile layout, for the account in the credential store.
 HRESULT AutoLoginProvider::_MakeAutoLoginCredential(
   __in DWORD dwCredentialIndex
 )
 {
-  HRESULT hr;
+  TRACE_FUNCTION();
+  AutoLoginCredentialBase* ppc;
+
+  HRESULT hr = _pLayout->pfnCreateInstance(_cpus, &ppc);
+
+  if (SUCCEEDED(hr))
+  {
+    _AttachStatusChannel(ppc);
+    _rgpCredentials[dwCredentialIndex] = ppc;
+    _dwNumCreds++;
+  }
 
-  // Allocate memory for the new credential.
-  AutoLoginCredential* ppc = new AutoLoginCredential();
+  return hr;
+}
 
-  if (ppc)
+void AutoLoginProvider::_AttachStatusChannel(__in AutoLoginCredentialBase* pCred)
+{
+  if (_pStatusChannel)
   {
-    // Set the Field State Pair and Field Descriptors for ppc's fields
-    // to the defaults (s_rgCredProvFieldDescriptors, and s_rgFieldStatePairs) and the value of SFI_USERNAME
-    // to pwzUsername.
-    hr = ppc->Initialize(_cpus, s_rgCredProvFieldDescriptors, s_rgFieldStatePairs);
+    pCred->AttachStatusChannel(_pStatusChannel);
+  }
+}
+
+// The private exports of AutoLoginCredentialProvider.def that LogonUISimulator calls.  They
+// are kept together here, after the provider's methods and before the class factory
+// boilerplate, and in the order the .def file lists them.
+
+// Hands the logon attempt percentiles of this process to LogonUISimulator, which loads us
+// in-process like LogonUI does.
+STDAPI DllGetLogonAttemptStats(__out LOGON_ATTEMPT_STATS* pStats)
+{
+  LogonAttemptGetStats(pStats);
+  return S_OK;
+}
+
+// Makes cTiles credentials with the TILE_LAYOUT dwLayout, as many tiles or sessions would,
+// and measures them while they are all alive, for LogonUISimulator -footprint.  Each loads
+// the account from the store just as a real tile does.
+STDAPI DllGetTileFootprint(__in DWORD dwLayout, __in DWORD cTiles, __out TILE_FOOTPRINT* ptf)
+{
+  ZeroMemory(ptf, sizeof(*ptf));
+  if (dwLayout >= ARRAYSIZE(s_rgTileLayouts) || !cTiles)
+  {
+    return E_INVALIDARG;
+  }
+
+  std::vector<AutoLoginCredentialBase*> rgpcred;
+  rgpcred.reserve(cTiles);
+
+  // Taken after the vector has its memory, so only the tiles are counted.
+  PROCESS_MEMORY_COUNTERS_EX pmcBefore;
+  HRESULT hr = GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmcBefore), sizeof(pmcBefore)) ?
+    S_OK : HRESULT_FROM_WIN32(GetLastError());
 
+  for (DWORD i = 0; SUCCEEDED(hr) && i < cTiles; i++)
+  {
+    AutoLoginCredentialBase* pcred;
+    hr = s_rgTileLayouts[dwLayout].pfnCreateInstance(CPUS_LOGON, &pcred);
     if (SUCCEEDED(hr))
     {
-      _rgpCredentials[dwCredentialIndex] = ppc;
-      _dwNumCreds++;
-    }
-    else
-    {
-      // Release the pointer to account for the local reference.
-      ppc->Release();
+      rgpcred.push_back(pcred);
+      ptf->cbTiles += pcred->GetBytes();
     }
   }
-  else
+
+  PROCESS_MEMORY_COUNTERS_EX pmcAfter;
+  if (SUCCEEDED(hr))
   {
-    hr = E_OUTOFMEMORY;
+    hr = GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmcAfter), sizeof(pmcAfter)) ?
+      S_OK : HRESULT_FROM_WIN32(GetLastError());
+  }
+  if (SUCCEEDED(hr))
+  {
+    // The heap may hand out memory it already had committed, so this can come in under
+    // cbTiles; it is the figure to watch at large counts.
+    ptf->cbCommitted = (pmcAfter.PrivateUsage > pmcBefore.PrivateUsage) ? pmcAfter.PrivateUsage - pmcBefore.PrivateUsage : 0;
   }
 
+  for (size_t i = 0; i < rgpcred.size(); i++)
+  {
+    rgpcred[i]->Release();
+  }
   return hr;
 }
 
+// Loads the account once, through the shared segment or not, and measures it, for
+// LogonUISimulator -sessions: each session's LogonUI is a process of its own, so the
+// simulator runs one child process per session and each calls this once.
+STDAPI DllMeasureAccountLoad(__in BOOL fUseSharedCache, __out ACCOUNT_LOAD_SAMPLE* pSample)
+{
+  ZeroMemory(pSample, sizeof(*pSample));
+
+  PROCESS_MEMORY_COUNTERS_EX pmcBefore;
+  HRESULT hr = GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmcBefore), sizeof(pmcBefore)) ?
+    S_OK : HRESULT_FROM_WIN32(GetLastError());
+
+  if (SUCCEEDED(hr))
+  {
+    BOOL fShared;
+    ULONGLONG ullStart = PlatformMonotonicNanoseconds();
+    hr = AutoLoginCredentialBase::LoadAccount(fUseSharedCache, &fShared, &pSample->ullVersion);
+    pSample->ullNs = PlatformMonotonicNanoseconds() - ullStart;
+    pSample->fShared = fShared;
+  }
+
+  PROCESS_MEMORY_COUNTERS_EX pmcAfter;
+  if (SUCCEEDED(hr))
+  {
+    hr = GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmcAfter), sizeof(pmcAfter)) ?
+      S_OK : HRESULT_FROM_WIN32(GetLastError());
+  }
+  if (SUCCEEDED(hr))
+  {
+    pSample->cbCommitted = (pmcAfter.PrivateUsage > pmcBefore.PrivateUsage) ? pmcAfter.PrivateUsage - pmcBefore.PrivateUsage : 0;
+  }
+  return hr;
+}
 
 // Boilerplate code to create our provider.
 HRESULT CSample_CreateInstance(__in REFIID riid, __deref_out void** ppv)
@@ -354,59 +605,66 @@ HRESULT CSample_CreateInstance(__in REFIID riid, __deref_out void** ppv)
 // more information.
 HRESULT AutoLoginProvider::_EnumerateSetSerialization()
 {
+  TRACE_FUNCTION();
   KERB_INTERACTIVE_LOGON* pkil = &_pkiulSetSerialization->Logon;
 
   _bAutoSubmitSetSerializationCred = false;
 
-  // Since this provider only enumerates local users (not domain users) we are ignoring the domain passed in.
-  // However, please note that if you receive a serialized cred of just a domain name, that domain name is meant 
-  // to be the default domain for the tiles (or for the empty tile if you have one).  Also, depending on your scenario,
-  // the presence of a domain other than what you're expecting might be a clue that you shouldn't handle
-  // the SetSerialization.  For example, in this sample, we could choose to not accept a serialization for a cred
-  // that had something other than the local machine name as the domain.
+  // Our tiles all log on as the account in the store, so a serialization only gets a tile if
+  // it names that account, however it spells it (see AccountName.h): DOMAIN\user, a UPN, or
+  // a local account as ".", the machine name or no domain at all.  One naming anyone else is
+  // dropped, so it can't get the store's account submitted for it.  A serialization of just
+  // a domain name is meant to be the default domain for the tiles, and gets one that waits
+  // for the user.
+  HRESULT hr = S_OK;
+  bool fOurAccount = false;
+  if (pkil->UserName.Length)
+  {
+    WCHAR wszMachine[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD cchMachine = ARRAYSIZE(wszMachine);
+    if (!GetComputerNameW(wszMachine, &cchMachine))
+    {
+      cchMachine = 0;
+    }
 
-  // Use a "long" (MAX_PATH is arbitrary) buffer because it's hard to predict what will be
-  // in the incoming values.  A DNS-format domain name, for instance, can be longer than DNLEN.
-  WCHAR wszUsername[MAX_PATH] = { 0 };
-  WCHAR wszPassword[MAX_PATH] = { 0 };
+    const ACCOUNT_IDENTITY* pIdentity;
+    CREDENTIAL_STORE_RESULT csr = AccountNameIntern(
+      pkil->LogonDomainName.Buffer, pkil->LogonDomainName.Length / sizeof(WCHAR),
+      pkil->UserName.Buffer, pkil->UserName.Length / sizeof(WCHAR),
+      wszMachine, cchMachine, &pIdentity);
 
-  // since this sample assumes local users, we'll ignore domain.  If you wanted to handle the domain
-  // case, you'd have to update AutoLoginCredential::Initialize to take a domain.
-  HRESULT hr = StringCbCopyNW(wszUsername, sizeof(wszUsername), pkil->UserName.Buffer, pkil->UserName.Length);
+    CAccountSnapshotReader reader;
+    const ACCOUNT_SNAPSHOT* pSnapshot = reader.Get();
+    fOurAccount = CSR_OK == csr && pSnapshot && pSnapshot->pIdentity == pIdentity;
+    if (!fOurAccount)
+    {
+      _CleanupSetSerialization();
+      hr = HRESULT_FROM_WIN32(ERROR_NO_SUCH_USER);
+    }
+  }
 
   if (SUCCEEDED(hr))
   {
-    hr = StringCbCopyNW(wszPassword, sizeof(wszPassword), pkil->Password.Buffer, pkil->Password.Length);
+    AutoLoginCredentialBase* pCred;
+
+    hr = _pLayout->pfnCreateInstance(_cpus, &pCred);
 
     if (SUCCEEDED(hr))
     {
-      AutoLoginCredential* pCred = new AutoLoginCredential();
-
-      if (pCred)
-      {
-        hr = pCred->Initialize(_cpus, s_rgCredProvFieldDescriptors, s_rgFieldStatePairs);
-
-        if (SUCCEEDED(hr))
-        {
-          _rgpCredentials[_dwNumCreds] = pCred;  //array takes ref
-          _dwSetSerializationCred = _dwNumCreds;
-          _dwNumCreds++;
-        }
-      }
-      else
-      {
-        hr = E_OUTOFMEMORY;
-      }
+      _AttachStatusChannel(pCred);
+      _rgpCredentials[_dwNumCreds] = pCred;  //array takes ref
+      _dwSetSerializationCred = _dwNumCreds;
+      _dwNumCreds++;
+    }
 
-      // If we were passed all the info we need (in this case username & password), we're going to automatically submit this credential.
-      if (SUCCEEDED(hr) && (0 < wcslen(wszPassword)))
-      {
-        _bAutoSubmitSetSerializationCred = true;
-      }
+    // If we were passed all the info we need (in this case username & password), we're going to automatically submit this credential.
+    if (SUCCEEDED(hr) && fOurAccount && pkil->Password.Length)
+    {
+      _bAutoSubmitSetSerializationCred = true;
     }
   }
 
-
+  FlightRecordResult(__FUNCTION__, hr);
   return hr;
 }
 
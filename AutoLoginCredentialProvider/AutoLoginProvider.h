@@ -12,11 +12,21 @@
 #include <strsafe.h>
 
 #include "AutoLoginCredential.h"
+#include "TileStatus.h"
 #include <helpers.h>
 
 #define MAX_CREDENTIALS 3
 #define MAX_DWORD   0xffffffff        // maximum DWORD
 
+// What the provider needs to know about a tile layout (see TileSchema.h) to describe its
+// fields to LogonUI and make credentials with them.
+struct TILE_LAYOUT_INFO
+{
+  DWORD cFields;
+  HRESULT (*pfnGetFieldDescriptorAt)(__in DWORD dwIndex, __deref_out CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR** ppcpfd);
+  HRESULT (*pfnCreateInstance)(__in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus, __deref_out AutoLoginCredentialBase** ppcred);
+};
+
 class AutoLoginProvider : public ICredentialProvider
 {
 public:
@@ -72,22 +82,33 @@ private:
 
   HRESULT _MakeAutoLoginCredential(__in DWORD dwCredientialIndex);
   HRESULT _EnumerateSetSerialization();
+  void _AttachStatusChannel(__in AutoLoginCredentialBase* pCred);
 
   // Create/free enumerated credentials.
   //HRESULT _EnumerateCredentials();
   void _ReleaseEnumeratedCredentials();
   void _CleanupSetSerialization();
+  bool _IsSetSerializationRepeat(__in const CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs, __out_bcount(PLATFORM_SHA256_SIZE) BYTE* pbDigest);
 
 
 private:
   LONG              _cRef;
-  AutoLoginCredential *_rgpCredentials[MAX_CREDENTIALS];  // Pointers to the credentials which will be enumerated by 
-                                                        // this Provider.
+  AutoLoginCredentialBase *_rgpCredentials[MAX_CREDENTIALS];  // Pointers to the credentials which will be enumerated by 
+                                                            // this Provider.
+  const TILE_LAYOUT_INFO*                 _pLayout;                 // the layout of our tiles, from SETTINGS_TILE_LAYOUT
   DWORD                                   _dwNumCreds;
   KERB_INTERACTIVE_UNLOCK_LOGON*          _pkiulSetSerialization;
   DWORD                                   _dwSetSerializationCred; //index into rgpCredentials for the SetSerializationCred
   bool                                    _bAutoSubmitSetSerializationCred;
+  BYTE                                    _rgbSetSerializationDigest[PLATFORM_SHA256_SIZE];  // of the blob _pkiulSetSerialization was unpacked from
+  ULONG                                   _cbSetSerialization;                  // and its size
+  ULONG                                   _ulSetSerializationAuthPackage;       // and its package
+  bool                                    _bCredsEnumerated;        // SetUsageScenario has made our tile
   CREDENTIAL_PROVIDER_USAGE_SCENARIO      _cpus;
+  WCHAR                                   _wszTraceFile[MAX_PATH];  // empty unless SETTINGS_TRACE_FILE is set
+  WCHAR                                   _wszHistogramFile[MAX_PATH];  // empty unless SETTINGS_HISTOGRAM_FILE is set
+  bool                                    _fAuditLogOpen;               // SETTINGS_AUDIT_FILE is set and AuditLogOpen succeeded
+  CTileStatusChannel*                     _pStatusChannel;              // what our tiles' status fields show; NULL if it couldn't be made
 
   //UserCredentials getCredentialsFromFile(std::string fileName);
 
@@ -0,0 +1,456 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <new>
+#include "CredentialStore.h"
+
+// Appends one Unicode code point to s as UTF-16 (where wchar_t is 16 bits) or as a
+// single UTF-32 unit (where it is 32 bits).
+static void _AppendCodePoint(std::wstring& s, unsigned long ulCodePoint)
+{
+  if (sizeof(wchar_t) == 2 && ulCodePoint >= 0x10000)
+  {
+    ulCodePoint -= 0x10000;
+    s.push_back((wchar_t)(0xD800 + (ulCodePoint >> 10)));
+    s.push_back((wchar_t)(0xDC00 + (ulCodePoint & 0x3FF)));
+  }
+  else
+  {
+    s.push_back((wchar_t)ulCodePoint);
+  }
+}
+
+// Decodes UTF-8.  Returns false (leaving *ps in an unspecified state) if pb is not
+// well-formed UTF-8: overlong forms, surrogates and values past U+10FFFF are rejected.
+static bool _DecodeUtf8(const unsigned char* pb, size_t cb, std::wstring* ps)
+{
+  size_t i = 0;
+  while (i < cb)
+  {
+    unsigned char b = pb[i];
+
+    // ASCII is by far the common case; take it a byte at a time without the table below.
+    if (b < 0x80)
+    {
+      ps->push_back((wchar_t)b);
+      i++;
+      continue;
+    }
+
+    size_t cbSequence;
+    unsigned long ulCodePoint;
+    unsigned long ulMin;
+    if ((b & 0xE0) == 0xC0)
+    {
+      cbSequence = 2;
+      ulCodePoint = b & 0x1F;
+      ulMin = 0x80;
+    }
+    else if ((b & 0xF0) == 0xE0)
+    {
+      cbSequence = 3;
+      ulCodePoint = b & 0x0F;
+      ulMin = 0x800;
+    }
+    else if ((b & 0xF8) == 0xF0)
+    {
+      cbSequence = 4;
+      ulCodePoint = b & 0x07;
+      ulMin = 0x10000;
+    }
+    else
+    {
+      return false;
+    }
+
+    if (cb - i < cbSequence)
+    {
+      return false;
+    }
+    for (size_t j = 1; j < cbSequence; j++)
+    {
+      if ((pb[i + j] & 0xC0) != 0x80)
+      {
+        return false;
+      }
+      ulCodePoint = (ulCodePoint << 6) | (pb[i + j] & 0x3F);
+    }
+    if (ulCodePoint < ulMin || ulCodePoint > 0x10FFFF || (ulCodePoint >= 0xD800 && ulCodePoint <= 0xDFFF))
+    {
+      return false;
+    }
+
+    _AppendCodePoint(*ps, ulCodePoint);
+    i += cbSequence;
+  }
+  return true;
+}
+
+// Decodes UTF-16LE (without its byte order mark).
+static bool _DecodeUtf16LE(const unsigned char* pb, size_t cb, std::wstring* ps)
+{
+  if (cb % 2 != 0)
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < cb; i += 2)
+  {
+    unsigned long ulUnit = pb[i] | (pb[i + 1] << 8);
+    if (sizeof(wchar_t) == 2)
+    {
+      ps->push_back((wchar_t)ulUnit);
+    }
+    else if (ulUnit >= 0xD800 && ulUnit <= 0xDBFF && i + 3 < cb)
+    {
+      unsigned long ulLow = pb[i + 2] | (pb[i + 3] << 8);
+      if (ulLow < 0xDC00 || ulLow > 0xDFFF)
+      {
+        return false;
+      }
+      _AppendCodePoint(*ps, 0x10000 + ((ulUnit - 0xD800) << 10) + (ulLow - 0xDC00));
+      i += 2;
+    }
+    else
+    {
+      ps->push_back((wchar_t)ulUnit);
+    }
+  }
+  return true;
+}
+
+// Splits off the next line of s starting at *pich, without its line ending.
+static void _NextLine(const std::wstring& s, size_t* pich, std::wstring* pLine)
+{
+  pLine->clear();
+  if (*pich >= s.size())
+  {
+    return;
+  }
+
+  size_t ichEnd = s.find(L'\n', *pich);
+  size_t ichNext = (ichEnd == std::wstring::npos) ? s.size() : ichEnd + 1;
+  if (ichEnd == std::wstring::npos)
+  {
+    ichEnd = s.size();
+  }
+  if (ichEnd > *pich && s[ichEnd - 1] == L'\r')
+  {
+    ichEnd--;
+  }
+
+  pLine->assign(s, *pich, ichEnd - *pich);
+  *pich = ichNext;
+}
+
+// Decodes the text of a store into *pText (see CredentialStoreParse for the encodings).
+// On failure *pText is wiped and emptied.
+static CREDENTIAL_STORE_RESULT _DecodeStoreText(
+  const unsigned char* pb,
+  size_t cb,
+  std::wstring* pText
+)
+{
+  CREDENTIAL_STORE_RESULT csr = CSR_OK;
+
+  pText->reserve(cb);
+
+  if (cb >= 2 && pb[0] == 0xFF && pb[1] == 0xFE)
+  {
+    if (!_DecodeUtf16LE(pb + 2, cb - 2, pText))
+    {
+      csr = CSR_BAD_FORMAT;
+    }
+  }
+  else
+  {
+    size_t cbBom = (cb >= 3 && pb[0] == 0xEF && pb[1] == 0xBB && pb[2] == 0xBF) ? 3 : 0;
+    if (!_DecodeUtf8(pb + cbBom, cb - cbBom, pText))
+    {
+      // Not UTF-8.  With a byte order mark that is an error; without one, fall back to
+      // one character per byte.
+      if (!pText->empty())
+      {
+        PlatformSecureZero(&(*pText)[0], pText->size() * sizeof(wchar_t));
+      }
+      if (cbBom != 0)
+      {
+        csr = CSR_BAD_FORMAT;
+      }
+      else
+      {
+        pText->assign(pb, pb + cb);
+      }
+    }
+  }
+
+  if (CSR_OK != csr)
+  {
+    if (!pText->empty())
+    {
+      PlatformSecureZero(&(*pText)[0], pText->size() * sizeof(wchar_t));
+    }
+    pText->clear();
+  }
+  return csr;
+}
+
+// Folds ASCII letters to upper case.  Machine names are compared and hashed this way so
+// that the provider and the provisioning tool agree without a locale.
+static wchar_t _FoldAscii(wchar_t ch)
+{
+  return (ch >= L'a' && ch <= L'z') ? (wchar_t)(ch - L'a' + L'A') : ch;
+}
+
+static bool _MachineNamesEqual(const std::wstring& s, const wchar_t* pwzMachine, size_t cchMachine)
+{
+  if (s.size() != cchMachine)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < cchMachine; i++)
+  {
+    if (_FoldAscii(s[i]) != _FoldAscii(pwzMachine[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+CREDENTIAL_STORE_RESULT CredentialStoreParse(
+  const unsigned char* pb,
+  size_t cb,
+  UserCredentials* puc
+)
+{
+  CREDENTIAL_STORE_RESULT csr = CSR_OK;
+  std::wstring text;
+
+  try
+  {
+    csr = _DecodeStoreText(pb, cb, &text);
+    if (CSR_OK == csr)
+    {
+      size_t ich = 0;
+      _NextLine(text, &ich, &puc->domain);
+      _NextLine(text, &ich, &puc->username);
+      _NextLine(text, &ich, &puc->password);
+    }
+  }
+  catch (const std::bad_alloc&)
+  {
+    csr = CSR_OUT_OF_MEMORY;
+  }
+
+  if (!text.empty())
+  {
+    PlatformSecureZero(&text[0], text.size() * sizeof(wchar_t));
+  }
+  return csr;
+}
+
+// Reads the record at *pich of a decoded sharded store or sealed record: the machine name
+// and, if it is pwzMachine, the three lines of credentials after it.  Otherwise skips them
+// and returns CSR_NOT_FOUND.
+static CREDENTIAL_STORE_RESULT _ParseRecord(
+  const std::wstring& text,
+  size_t* pich,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  std::wstring* pLine,
+  UserCredentials* puc
+)
+{
+  _NextLine(text, pich, pLine);
+  if (!_MachineNamesEqual(*pLine, pwzMachine, cchMachine))
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      _NextLine(text, pich, pLine);
+    }
+    return CSR_NOT_FOUND;
+  }
+
+  _NextLine(text, pich, &puc->domain);
+  _NextLine(text, pich, &puc->username);
+  _NextLine(text, pich, &puc->password);
+  return CSR_OK;
+}
+
+CREDENTIAL_STORE_RESULT CredentialStoreParseShard(
+  const unsigned char* pb,
+  size_t cb,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  UserCredentials* puc
+)
+{
+  CREDENTIAL_STORE_RESULT csr = CSR_OK;
+  std::wstring text;
+  std::wstring line;
+
+  try
+  {
+    csr = _DecodeStoreText(pb, cb, &text);
+    if (CSR_OK == csr)
+    {
+      size_t ich = 0;
+      _NextLine(text, &ich, &line);
+      if (line != CREDENTIAL_SHARD_HEADER)
+      {
+        csr = CSR_BAD_FORMAT;
+      }
+      else
+      {
+        csr = CSR_NOT_FOUND;
+        while (CSR_NOT_FOUND == csr && ich < text.size())
+        {
+          csr = _ParseRecord(text, &ich, pwzMachine, cchMachine, &line, puc);
+        }
+      }
+    }
+  }
+  catch (const std::bad_alloc&)
+  {
+    csr = CSR_OUT_OF_MEMORY;
+  }
+
+  if (!line.empty())
+  {
+    PlatformSecureZero(&line[0], line.size() * sizeof(wchar_t));
+  }
+  if (!text.empty())
+  {
+    PlatformSecureZero(&text[0], text.size() * sizeof(wchar_t));
+  }
+  return csr;
+}
+
+CREDENTIAL_STORE_RESULT CredentialStoreParseRecord(
+  const unsigned char* pb,
+  size_t cb,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  UserCredentials* puc
+)
+{
+  CREDENTIAL_STORE_RESULT csr = CSR_OK;
+  std::wstring text;
+  std::wstring line;
+
+  try
+  {
+    // Records are written by CredentialTool, always as UTF-8.
+    text.reserve(cb);
+    if (!_DecodeUtf8(pb, cb, &text))
+    {
+      csr = CSR_BAD_FORMAT;
+    }
+    else
+    {
+      size_t ich = 0;
+      csr = _ParseRecord(text, &ich, pwzMachine, cchMachine, &line, puc);
+    }
+  }
+  catch (const std::bad_alloc&)
+  {
+    csr = CSR_OUT_OF_MEMORY;
+  }
+
+  if (!line.empty())
+  {
+    PlatformSecureZero(&line[0], line.size() * sizeof(wchar_t));
+  }
+  if (!text.empty())
+  {
+    PlatformSecureZero(&text[0], text.size() * sizeof(wchar_t));
+  }
+  return csr;
+}
+
+unsigned long CredentialStoreMachineHash(
+  const wchar_t* pwzMachine,
+  size_t cchMachine
+)
+{
+  // 32-bit FNV-1a over the UTF-16LE bytes of the folded name.
+  unsigned long ulHash = 2166136261UL;
+  for (size_t i = 0; i < cchMachine; i++)
+  {
+    unsigned long ulUnit = (unsigned long)_FoldAscii(pwzMachine[i]) & 0xFFFF;
+    ulHash = ((ulHash ^ (ulUnit & 0xFF)) * 16777619UL) & 0xFFFFFFFFUL;
+    ulHash = ((ulHash ^ (ulUnit >> 8)) * 16777619UL) & 0xFFFFFFFFUL;
+  }
+  return ulHash;
+}
+
+unsigned long CredentialStoreShardOf(
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  unsigned long cShards
+)
+{
+  return (cShards > 1) ? CredentialStoreMachineHash(pwzMachine, cchMachine) % cShards : 0;
+}
+
+CREDENTIAL_STORE_RESULT CredentialStoreResultFromPlatform(PLATFORM_RESULT pr)
+{
+  switch (pr)
+  {
+  case PR_OK:
+    return CSR_OK;
+
+  case PR_NOT_FOUND:
+    return CSR_NOT_FOUND;
+
+  case PR_ACCESS_DENIED:
+    return CSR_ACCESS_DENIED;
+
+  case PR_TOO_LARGE:
+  case PR_END_OF_FILE:
+  case PR_BAD_DATA:
+    return CSR_BAD_FORMAT;
+
+  case PR_OUT_OF_MEMORY:
+    return CSR_OUT_OF_MEMORY;
+
+  default:
+    return CSR_IO_ERROR;
+  }
+}
+
+CREDENTIAL_STORE_RESULT CredentialStoreRead(
+  const wchar_t* pwzPath,
+  std::vector<unsigned char>* prgbContents
+)
+{
+  return CredentialStoreResultFromPlatform(PlatformReadFile(pwzPath, CREDENTIAL_STORE_MAX_SIZE, prgbContents));
+}
+
+CREDENTIAL_STORE_RESULT CredentialStoreLoad(
+  const wchar_t* pwzPath,
+  UserCredentials* puc
+)
+{
+  std::vector<unsigned char> rgbContents;
+
+  CREDENTIAL_STORE_RESULT csr = CredentialStoreRead(pwzPath, &rgbContents);
+  if (CSR_OK == csr)
+  {
+    csr = CredentialStoreParse(rgbContents.empty() ? NULL : &rgbContents[0], rgbContents.size(), puc);
+  }
+
+  if (!rgbContents.empty())
+  {
+    PlatformSecureZero(&rgbContents[0], rgbContents.size());
+  }
+  return csr;
+}
@@ -0,0 +1,112 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Loading of the credential store the tile logs on with.  This is platform-neutral code:
+// it depends only on the C++ standard library and Platform.h.
+
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include "Platform.h"
+
+struct UserCredentials
+{
+  std::wstring domain;
+  std::wstring username;
+  std::wstring password;
+};
+
+enum CREDENTIAL_STORE_RESULT
+{
+  CSR_OK,
+  CSR_NOT_FOUND,
+  CSR_ACCESS_DENIED,
+  CSR_BAD_FORMAT,
+  CSR_OUT_OF_MEMORY,
+  CSR_IO_ERROR,
+};
+
+// No legitimate store comes anywhere near this; anything bigger is not ours.
+#define CREDENTIAL_STORE_MAX_SIZE (64 * 1024)
+
+// Parses the text of a credential store: the domain, the user name and the password, one
+// per line and in that order.  Missing lines leave the corresponding values empty.
+//
+// The text may be UTF-16LE with a byte order mark, or UTF-8 with or without one.  Text that
+// is not valid UTF-8 is taken to be Latin-1, which is how the store used to be read.  Lines
+// may end in LF or CRLF.
+CREDENTIAL_STORE_RESULT CredentialStoreParse(
+  const unsigned char* pb,
+  size_t cb,
+  UserCredentials* puc
+);
+
+// A sharded store holds the records of many machines, so that one file can be pushed to a
+// whole group of them.  Its first line is CREDENTIAL_SHARD_HEADER; after that come four
+// lines per machine: the machine name, the domain, the user name and the password.  A
+// machine's record lives in the shard named by CREDENTIAL_SHARD_FILE_FORMAT for the index
+// CredentialStoreShardOf returns.
+#define CREDENTIAL_SHARD_HEADER L"#credential-shard 1"
+#define CREDENTIAL_SHARD_FILE_FORMAT L"shard-%05lu.txt"
+
+// Finds the record for pwzMachine (compared case-insensitively) in the text of a sharded
+// store.  Returns CSR_NOT_FOUND if the shard has no record for it, and CSR_BAD_FORMAT if
+// the text is not a sharded store.
+CREDENTIAL_STORE_RESULT CredentialStoreParseShard(
+  const unsigned char* pb,
+  size_t cb,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  UserCredentials* puc
+);
+
+// Parses one record of a sealed store (see SealedStore.h), which has the same four lines
+// as a record in a sharded store, in UTF-8.  Returns CSR_NOT_FOUND if the record is for a
+// machine other than pwzMachine.
+CREDENTIAL_STORE_RESULT CredentialStoreParseRecord(
+  const unsigned char* pb,
+  size_t cb,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  UserCredentials* puc
+);
+
+// A 32-bit hash of a machine name that ignores ASCII case.  Shards and the index of a
+// sealed store are both keyed on it.
+unsigned long CredentialStoreMachineHash(
+  const wchar_t* pwzMachine,
+  size_t cchMachine
+);
+
+// Returns the shard, in [0, cShards), that holds the record for pwzMachine.  The result
+// depends only on the name, ignoring ASCII case, so the provisioning tool and the provider
+// always agree on it.
+unsigned long CredentialStoreShardOf(
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  unsigned long cShards
+);
+
+// Maps what the platform layer reported onto a store result.  A file that is too large,
+// too short or fails authentication is not a store we can use: CSR_BAD_FORMAT.
+CREDENTIAL_STORE_RESULT CredentialStoreResultFromPlatform(PLATFORM_RESULT pr);
+
+// Reads the raw contents of the credential store at pwzPath.  The caller wipes
+// *prgbContents (PlatformSecureZero) once it has parsed them.
+CREDENTIAL_STORE_RESULT CredentialStoreRead(
+  const wchar_t* pwzPath,
+  std::vector<unsigned char>* prgbContents
+);
+
+// Reads the credential store at pwzPath and parses it.  The raw file contents are wiped
+// before this returns.
+CREDENTIAL_STORE_RESULT CredentialStoreLoad(
+  const wchar_t* pwzPath,
+  UserCredentials* puc
+);
@@ -0,0 +1,49 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+
+#include <windows.h>
+#include <dpapi.h>
+#include "DpapiKeyProvider.h"
+
+// Wrapped keys are a few hundred bytes; anything much bigger is not one.
+#define DPAPI_KEY_FILE_MAX_SIZE 4096
+
+CREDENTIAL_STORE_RESULT DpapiKeyProvider::GetKey(__in const unsigned char* pbKeyId, __out unsigned char* pbKey)
+{
+  std::vector<unsigned char> rgbWrapped;
+  CREDENTIAL_STORE_RESULT csr = CredentialStoreResultFromPlatform(PlatformReadFile(_pwzKeyFile, DPAPI_KEY_FILE_MAX_SIZE, &rgbWrapped));
+  if (CSR_OK == csr)
+  {
+    DATA_BLOB dbIn = { (DWORD)rgbWrapped.size(), rgbWrapped.empty() ? NULL : &rgbWrapped[0] };
+    DATA_BLOB dbOut = { 0, NULL };
+    if (CryptUnprotectData(&dbIn, NULL, NULL, NULL, NULL, CRYPTPROTECT_UI_FORBIDDEN, &dbOut))
+    {
+      if (dbOut.cbData != SEALED_STORE_KEY_FILE_SIZE)
+      {
+        csr = CSR_BAD_FORMAT;
+      }
+      else if (0 != memcmp(dbOut.pbData, pbKeyId, SEALED_STORE_KEY_ID_SIZE))
+      {
+        // The store was sealed with a different key than this machine was given.
+        csr = CSR_NOT_FOUND;
+      }
+      else
+      {
+        CopyMemory(pbKey, dbOut.pbData + SEALED_STORE_KEY_ID_SIZE, SEALED_STORE_KEY_SIZE);
+      }
+      SecureZeroMemory(dbOut.pbData, dbOut.cbData);
+      LocalFree(dbOut.pbData);
+    }
+    else
+    {
+      csr = (ERROR_ACCESS_DENIED == GetLastError()) ? CSR_ACCESS_DENIED : CSR_BAD_FORMAT;
+    }
+  }
+  return csr;
+}
@@ -0,0 +1,30 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// DpapiKeyProvider supplies the sealed store key from a file protected with machine-scope
+// DPAPI, as CredentialTool protect-key writes it on each machine.  Only that machine can
+// unwrap the file, so a copy of the sealed store and the key file taken elsewhere is no
+// use; restrict the key file's ACL to SYSTEM and administrators as well.
+
+#pragma once
+
+#include <windows.h>
+#include "SealedStore.h"
+
+class DpapiKeyProvider : public ISealedStoreKeyProvider
+{
+public:
+  DpapiKeyProvider(__in PCWSTR pwzKeyFile) : _pwzKeyFile(pwzKeyFile)
+  {
+  }
+
+  CREDENTIAL_STORE_RESULT GetKey(__in const unsigned char* pbKeyId, __out unsigned char* pbKey);
+
+private:
+  PCWSTR _pwzKeyFile;
+};
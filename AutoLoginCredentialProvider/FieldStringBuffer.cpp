@@ -0,0 +1,109 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#include "FieldStringBuffer.h"
+
+// FieldStringBuffer ////////////////////////////////////////////////////////
+
+FieldStringBuffer::FieldStringBuffer() :
+  _pwz(NULL),
+  _cch(0),
+  _pwzHeap(NULL),
+  _cchCapacity(c_cchInline),
+  _cchHighWater(0)
+{
+  _rgchInline[0] = L'\0';
+}
+
+FieldStringBuffer::~FieldStringBuffer()
+{
+  Clear();
+  delete[] _pwzHeap;
+}
+
+// Makes sure the buffer has room for cch characters plus a NULL terminator.  When the
+// value outgrows the current storage the capacity at least doubles, so a field that is
+// typed into one character at a time reallocates O(log n) times in total.
+PLATFORM_RESULT FieldStringBuffer::_Reserve(size_t cch)
+{
+  if (cch < _cchCapacity)
+  {
+    return PR_OK;
+  }
+
+  size_t cchNew = _cchCapacity * 2;
+  if (cchNew < cch + 1)
+  {
+    cchNew = cch + 1;
+  }
+  if (cch >= SIZE_MAX / sizeof(wchar_t) || cchNew > SIZE_MAX / sizeof(wchar_t))
+  {
+    return PR_TOO_LARGE;
+  }
+
+  wchar_t* pwzNew = new (std::nothrow) wchar_t[cchNew];
+  if (!pwzNew)
+  {
+    return PR_OUT_OF_MEMORY;
+  }
+
+  // Nothing in the old storage needs to survive the move: Assign is about to overwrite it,
+  // and LogonUI always hands us the complete value.
+  wchar_t* pwzOld = _Storage();
+  PlatformSecureZero(pwzOld, _cchHighWater * sizeof(wchar_t));
+  delete[] _pwzHeap;
+
+  _pwzHeap = pwzNew;
+  _cchCapacity = cchNew;
+  _cchHighWater = 0;
+  if (_pwz == pwzOld)
+  {
+    _pwz = NULL;
+    _cch = 0;
+  }
+  return PR_OK;
+}
+
+PLATFORM_RESULT FieldStringBuffer::Assign(const wchar_t* pwz, size_t cch)
+{
+  PLATFORM_RESULT pr = _Reserve(cch);
+
+  if (PR_OK == pr)
+  {
+    wchar_t* pwzStorage = _Storage();
+
+    // memmove rather than memcpy in case pwz came from Get().
+    memmove(pwzStorage, pwz, cch * sizeof(wchar_t));
+    pwzStorage[cch] = L'\0';
+
+    // If the value got shorter (a backspace, say), wipe what used to follow it.
+    if (_cchHighWater > cch + 1)
+    {
+      PlatformSecureZero(pwzStorage + cch + 1, (_cchHighWater - (cch + 1)) * sizeof(wchar_t));
+    }
+    _cchHighWater = cch + 1;
+
+    _pwz = pwzStorage;
+    _cch = cch;
+  }
+
+  return pr;
+}
+
+void FieldStringBuffer::Clear()
+{
+  PlatformSecureZero(_Storage(), _cchHighWater * sizeof(wchar_t));
+  _cchHighWater = 0;
+  _pwz = NULL;
+  _cch = 0;
+}
@@ -0,0 +1,78 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// FieldStringBuffer holds the string value of one edit field in a tile.  LogonUI calls
+// SetStringValue with the whole contents of an edit field on every keystroke, so the
+// buffer keeps short values inline, grows geometrically when it has to go to the heap,
+// and never gives memory back until it is destroyed.  Typing into a field therefore
+// costs a copy but no allocation.  Whatever the buffer stops using (the tail after a
+// backspace, the inline storage after a move to the heap, the heap block on
+// destruction) is wiped, since these fields may hold a password.
+//
+// Fields LogonUI can't edit have no buffer: their values point straight at the tile schema
+// (see TileSchema.h) or the current account snapshot (see AccountSnapshot.h).
+//
+// Platform-neutral: it depends only on the C++ standard library and Platform.h.
+
+#pragma once
+
+#include <stddef.h>
+#include "Platform.h"
+
+class FieldStringBuffer
+{
+public:
+  FieldStringBuffer();
+  ~FieldStringBuffer();
+
+  // Copies the cch characters at pwz into the buffer.  Returns PR_OUT_OF_MEMORY if the
+  // buffer can't grow to hold them, PR_TOO_LARGE if no buffer could, leaving the value as
+  // it was either way.
+  PLATFORM_RESULT Assign(const wchar_t* pwz, size_t cch);
+
+  // Empties the buffer and wipes whatever it was holding.
+  void Clear();
+
+  const wchar_t* Get() const
+  {
+    return _pwz;
+  }
+
+  size_t Length() const
+  {
+    return _cch;
+  }
+
+  // What the buffer has taken from the heap, beyond the object itself.
+  size_t HeapBytes() const
+  {
+    return _pwzHeap ? _cchCapacity * sizeof(wchar_t) : 0;
+  }
+
+private:
+  FieldStringBuffer(const FieldStringBuffer&);
+  FieldStringBuffer& operator=(const FieldStringBuffer&);
+
+  wchar_t* _Storage()
+  {
+    return _pwzHeap ? _pwzHeap : _rgchInline;
+  }
+
+  PLATFORM_RESULT _Reserve(size_t cch);
+
+  // Characters that fit without touching the heap, including the NULL terminator.
+  // Long enough for any SAM account name and most passwords.
+  static const size_t c_cchInline = 32;
+
+  const wchar_t* _pwz;    // the current value, in _Storage(), or NULL
+  size_t _cch;            // length of _pwz in characters, not counting the NULL terminator
+  wchar_t* _pwzHeap;      // heap storage once a value outgrows _rgchInline, else NULL
+  size_t _cchCapacity;    // characters available in _Storage(), including the NULL terminator
+  size_t _cchHighWater;   // characters of _Storage() that may hold something worth wiping
+  wchar_t _rgchInline[c_cchInline];
+};
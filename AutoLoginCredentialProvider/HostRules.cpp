@@ -0,0 +1,458 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <new>
+#include <string.h>
+#include <vector>
+#include "HostRules.h"
+
+// No state can have more edges than there are character classes.
+#define HOST_RULES_MAX_CLASSES HOST_RULES_CLASS_MAP_SIZE
+
+static void _PutU32(unsigned char* pb, unsigned long ul)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    pb[i] = (unsigned char)(ul >> (8 * i));
+  }
+}
+
+static void _PutU64(unsigned char* pb, unsigned long long ull)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    pb[i] = (unsigned char)(ull >> (8 * i));
+  }
+}
+
+static unsigned long _GetU32(const unsigned char* pb)
+{
+  unsigned long ul = 0;
+  for (int i = 3; i >= 0; i--)
+  {
+    ul = (ul << 8) | pb[i];
+  }
+  return ul;
+}
+
+static unsigned long long _GetU64(const unsigned char* pb)
+{
+  unsigned long long ull = 0;
+  for (int i = 7; i >= 0; i--)
+  {
+    ull = (ull << 8) | pb[i];
+  }
+  return ull;
+}
+
+void HostRulesEncodeHeader(const HOST_RULES_HEADER& hdr, unsigned char* pb)
+{
+  _PutU32(pb, hdr.ulMagic);
+  _PutU32(pb + 4, hdr.ulVersion);
+  _PutU32(pb + 8, hdr.ulFlags);
+  _PutU32(pb + 12, hdr.cClasses);
+  _PutU32(pb + 16, hdr.cStates);
+  _PutU32(pb + 20, hdr.iStartState);
+  _PutU32(pb + 24, hdr.cRules);
+  _PutU32(pb + 28, hdr.cAccounts);
+  memcpy(pb + 32, hdr.rgbKeyId, SEALED_STORE_KEY_ID_SIZE);
+  for (int i = 0; i < HRS_NUM_SECTIONS; i++)
+  {
+    _PutU64(pb + 48 + 8 * i, hdr.rgullSections[i]);
+  }
+}
+
+static void _DecodeHeader(const unsigned char* pb, HOST_RULES_HEADER* phdr)
+{
+  phdr->ulMagic = _GetU32(pb);
+  phdr->ulVersion = _GetU32(pb + 4);
+  phdr->ulFlags = _GetU32(pb + 8);
+  phdr->cClasses = _GetU32(pb + 12);
+  phdr->cStates = _GetU32(pb + 16);
+  phdr->iStartState = _GetU32(pb + 20);
+  phdr->cRules = _GetU32(pb + 24);
+  phdr->cAccounts = _GetU32(pb + 28);
+  memcpy(phdr->rgbKeyId, pb + 32, SEALED_STORE_KEY_ID_SIZE);
+  for (int i = 0; i < HRS_NUM_SECTIONS; i++)
+  {
+    phdr->rgullSections[i] = _GetU64(pb + 48 + 8 * i);
+  }
+}
+
+void HostRulesEncodeRule(const HOST_RULES_RULE& rule, unsigned char* pb)
+{
+  _PutU32(pb, rule.iAccount);
+  _PutU32(pb + 4, rule.ulLine);
+  _PutU32(pb + 8, rule.ulDays);
+  _PutU32(pb + 12, rule.ulMinuteStart);
+  _PutU32(pb + 16, rule.ulMinuteEnd);
+  _PutU32(pb + 20, rule.iFirstTagRef);
+  _PutU32(pb + 24, rule.cTags);
+}
+
+void HostRulesAccountAad(const unsigned char* pbKeyId, unsigned long iAccount, unsigned char* pbAad)
+{
+  _PutU32(pbAad, HOST_RULES_MAGIC);
+  _PutU32(pbAad + 4, HOST_RULES_VERSION);
+  memcpy(pbAad + 8, pbKeyId, SEALED_STORE_KEY_ID_SIZE);
+  _PutU32(pbAad + 24, iAccount);
+}
+
+// Reads from a section of the rules file.
+static CREDENTIAL_STORE_RESULT _ReadAt(
+  PLATFORM_FILE* pFile,
+  const HOST_RULES_HEADER& hdr,
+  HOST_RULES_SECTION section,
+  unsigned long long ullOffset,
+  void* pv,
+  size_t cb
+)
+{
+  return CredentialStoreResultFromPlatform(PlatformReadFileAt(pFile, hdr.rgullSections[section] + ullOffset, pv, cb));
+}
+
+// Runs the automaton over the machine name.  *poAccept receives the offset of the accept
+// list of the state the name ends in, or HOST_RULES_NONE if no pattern matches it.
+static CREDENTIAL_STORE_RESULT _Match(
+  PLATFORM_FILE* pFile,
+  const HOST_RULES_HEADER& hdr,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  unsigned long* poAccept
+)
+{
+  unsigned char rgbClassMap[HOST_RULES_CLASS_MAP_SIZE];
+  CREDENTIAL_STORE_RESULT csr = _ReadAt(pFile, hdr, HRS_CLASS_MAP, 0, rgbClassMap, sizeof(rgbClassMap));
+
+  unsigned long iState = hdr.iStartState;
+  unsigned char rgbState[HOST_RULES_STATE_SIZE];
+  for (size_t i = 0; CSR_OK == csr; i++)
+  {
+    if (iState >= hdr.cStates)
+    {
+      csr = CSR_BAD_FORMAT;
+      break;
+    }
+    csr = _ReadAt(pFile, hdr, HRS_STATES, (unsigned long long)iState * HOST_RULES_STATE_SIZE, rgbState, sizeof(rgbState));
+    if (CSR_OK != csr || i == cchMachine)
+    {
+      break;
+    }
+
+    unsigned long iFirstEdge = _GetU32(rgbState + 4);
+    unsigned long cEdges = _GetU32(rgbState + 8);
+    if (cEdges > HOST_RULES_MAX_CLASSES)
+    {
+      csr = CSR_BAD_FORMAT;
+      break;
+    }
+
+    wchar_t ch = HostRulesFold(pwzMachine[i]);
+    unsigned long ulClass = rgbClassMap[(ch < 0x80) ? ch : 0x80];
+    unsigned long iNext = _GetU32(rgbState);
+
+    // Most states have only a handful of edges; read them all at once and look for ours.
+    unsigned char rgbEdges[HOST_RULES_MAX_CLASSES * HOST_RULES_EDGE_SIZE];
+    if (cEdges)
+    {
+      csr = _ReadAt(pFile, hdr, HRS_EDGES, (unsigned long long)iFirstEdge * HOST_RULES_EDGE_SIZE, rgbEdges, cEdges * HOST_RULES_EDGE_SIZE);
+    }
+    unsigned long iLow = 0;
+    unsigned long iHigh = cEdges;
+    while (CSR_OK == csr && iLow < iHigh)
+    {
+      unsigned long iMiddle = iLow + (iHigh - iLow) / 2;
+      unsigned long ulEdgeClass = _GetU32(rgbEdges + iMiddle * HOST_RULES_EDGE_SIZE);
+      if (ulEdgeClass == ulClass)
+      {
+        iNext = _GetU32(rgbEdges + iMiddle * HOST_RULES_EDGE_SIZE + 4);
+        break;
+      }
+      else if (ulEdgeClass < ulClass)
+      {
+        iLow = iMiddle + 1;
+      }
+      else
+      {
+        iHigh = iMiddle;
+      }
+    }
+
+    if (HOST_RULES_NONE == iNext)
+    {
+      // No pattern can match from here on.
+      *poAccept = HOST_RULES_NONE;
+      return csr;
+    }
+    iState = iNext;
+  }
+
+  if (CSR_OK == csr)
+  {
+    *poAccept = _GetU32(rgbState + 12);
+  }
+  return csr;
+}
+
+static bool _InTimeWindow(const HOST_RULES_RULE& rule, unsigned long ulMinute)
+{
+  if (rule.ulMinuteStart == rule.ulMinuteEnd)
+  {
+    return true;
+  }
+  if (rule.ulMinuteStart < rule.ulMinuteEnd)
+  {
+    return ulMinute >= rule.ulMinuteStart && ulMinute < rule.ulMinuteEnd;
+  }
+  return ulMinute >= rule.ulMinuteStart || ulMinute < rule.ulMinuteEnd;
+}
+
+static bool _HasTag(const HOST_RULES_QUERY& query, const char* pszTag, size_t cchTag)
+{
+  for (size_t i = 0; i < query.cTags; i++)
+  {
+    const wchar_t* pwzTag = query.rgpwzTags[i];
+    size_t j = 0;
+    while (j < cchTag && pwzTag[j] && HostRulesFold(pwzTag[j]) == HostRulesFold((wchar_t)(unsigned char)pszTag[j]))
+    {
+      j++;
+    }
+    if (j == cchTag && !pwzTag[j])
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Checks the conditions of a rule whose pattern matched.
+static CREDENTIAL_STORE_RESULT _RuleApplies(
+  PLATFORM_FILE* pFile,
+  const HOST_RULES_HEADER& hdr,
+  const HOST_RULES_RULE& rule,
+  const HOST_RULES_QUERY& query,
+  bool* pfApplies
+)
+{
+  *pfApplies = (rule.ulDays & (1UL << (query.ulDayOfWeek % 7))) && _InTimeWindow(rule, query.ulMinuteOfDay);
+
+  CREDENTIAL_STORE_RESULT csr = CSR_OK;
+  for (unsigned long i = 0; CSR_OK == csr && *pfApplies && i < rule.cTags; i++)
+  {
+    unsigned char rgbRef[HOST_RULES_TAG_REF_SIZE];
+    csr = _ReadAt(pFile, hdr, HRS_TAG_REFS, ((unsigned long long)rule.iFirstTagRef + i) * HOST_RULES_TAG_REF_SIZE, rgbRef, sizeof(rgbRef));
+    if (CSR_OK == csr)
+    {
+      unsigned long cchTag = _GetU32(rgbRef + 4);
+      char szTag[HOST_RULES_MAX_TAG];
+      if (cchTag == 0 || cchTag > sizeof(szTag))
+      {
+        csr = CSR_BAD_FORMAT;
+      }
+      else
+      {
+        csr = _ReadAt(pFile, hdr, HRS_STRINGS, _GetU32(rgbRef), szTag, cchTag);
+      }
+      if (CSR_OK == csr)
+      {
+        *pfApplies = _HasTag(query, szTag, cchTag);
+      }
+    }
+  }
+  return csr;
+}
+
+// Reads, and in a sealed file decrypts, the record of an account and parses it.
+static CREDENTIAL_STORE_RESULT _LoadAccount(
+  PLATFORM_FILE* pFile,
+  const HOST_RULES_HEADER& hdr,
+  unsigned long iAccount,
+  const unsigned char* pbKey,
+  UserCredentials* puc
+)
+{
+  if (iAccount >= hdr.cAccounts)
+  {
+    return CSR_BAD_FORMAT;
+  }
+
+  unsigned char rgbAccount[HOST_RULES_ACCOUNT_SIZE];
+  CREDENTIAL_STORE_RESULT csr = _ReadAt(pFile, hdr, HRS_ACCOUNTS, (unsigned long long)iAccount * HOST_RULES_ACCOUNT_SIZE, rgbAccount, sizeof(rgbAccount));
+  if (CSR_OK != csr)
+  {
+    return csr;
+  }
+
+  unsigned long long ullOffset = _GetU64(rgbAccount);
+  unsigned long cbRecord = _GetU32(rgbAccount + 8);
+  size_t cbOverhead = pbKey ? SEALED_STORE_NONCE_SIZE + SEALED_STORE_TAG_SIZE : 0;
+  if (cbRecord <= cbOverhead || cbRecord > cbOverhead + CREDENTIAL_STORE_MAX_SIZE)
+  {
+    return CSR_BAD_FORMAT;
+  }
+
+  std::vector<unsigned char> rgbRecord;
+  std::vector<unsigned char> rgbPlaintext;
+  try
+  {
+    rgbRecord.resize(cbRecord);
+    if (pbKey)
+    {
+      rgbPlaintext.resize(cbRecord - cbOverhead);
+    }
+  }
+  catch (const std::bad_alloc&)
+  {
+    csr = CSR_OUT_OF_MEMORY;
+  }
+
+  if (CSR_OK == csr)
+  {
+    csr = CredentialStoreResultFromPlatform(PlatformReadFileAt(pFile, ullOffset, &rgbRecord[0], rgbRecord.size()));
+  }
+  if (CSR_OK == csr)
+  {
+    if (pbKey)
+    {
+      unsigned char rgbAad[SEALED_STORE_AAD_SIZE];
+      HostRulesAccountAad(hdr.rgbKeyId, iAccount, rgbAad);
+      csr = CredentialStoreResultFromPlatform(PlatformAesGcmDecrypt(
+        pbKey, SEALED_STORE_KEY_SIZE,
+        &rgbRecord[0], SEALED_STORE_NONCE_SIZE,
+        rgbAad, sizeof(rgbAad),
+        &rgbRecord[SEALED_STORE_NONCE_SIZE], rgbPlaintext.size(),
+        &rgbRecord[SEALED_STORE_NONCE_SIZE + rgbPlaintext.size()], SEALED_STORE_TAG_SIZE,
+        &rgbPlaintext[0]));
+      if (CSR_OK == csr)
+      {
+        csr = CredentialStoreParse(&rgbPlaintext[0], rgbPlaintext.size(), puc);
+      }
+    }
+    else
+    {
+      csr = CredentialStoreParse(&rgbRecord[0], rgbRecord.size(), puc);
+    }
+  }
+
+  if (!rgbPlaintext.empty())
+  {
+    PlatformSecureZero(&rgbPlaintext[0], rgbPlaintext.size());
+  }
+  if (!rgbRecord.empty())
+  {
+    PlatformSecureZero(&rgbRecord[0], rgbRecord.size());
+  }
+  return csr;
+}
+
+CREDENTIAL_STORE_RESULT HostRulesLoad(
+  const wchar_t* pwzPath,
+  ISealedStoreKeyProvider* pKeys,
+  const HOST_RULES_QUERY& query,
+  UserCredentials* puc,
+  unsigned long* pulLine
+)
+{
+  PLATFORM_FILE* pFile;
+  CREDENTIAL_STORE_RESULT csr = CredentialStoreResultFromPlatform(PlatformOpenFile(pwzPath, &pFile));
+  if (CSR_OK != csr)
+  {
+    return csr;
+  }
+
+  HOST_RULES_HEADER hdr;
+  unsigned char rgbHeader[HOST_RULES_HEADER_SIZE];
+  csr = CredentialStoreResultFromPlatform(PlatformReadFileAt(pFile, 0, rgbHeader, sizeof(rgbHeader)));
+  if (CSR_OK == csr)
+  {
+    _DecodeHeader(rgbHeader, &hdr);
+    bool fSealed = 0 != (hdr.ulFlags & HOST_RULES_FLAG_SEALED);
+    if (hdr.ulMagic != HOST_RULES_MAGIC || hdr.ulVersion != HOST_RULES_VERSION || fSealed != (NULL != pKeys))
+    {
+      csr = CSR_BAD_FORMAT;
+    }
+  }
+
+  unsigned long oAccept = HOST_RULES_NONE;
+  if (CSR_OK == csr)
+  {
+    csr = _Match(pFile, hdr, query.pwzMachine, query.cchMachine, &oAccept);
+  }
+  if (CSR_OK == csr && HOST_RULES_NONE == oAccept)
+  {
+    csr = CSR_NOT_FOUND;
+  }
+
+  // Take the first matching rule, in the order of the rules text, whose conditions hold.
+  unsigned long cAccepted = 0;
+  if (CSR_OK == csr)
+  {
+    unsigned char rgbCount[4];
+    csr = _ReadAt(pFile, hdr, HRS_ACCEPTS, oAccept, rgbCount, sizeof(rgbCount));
+    if (CSR_OK == csr)
+    {
+      cAccepted = _GetU32(rgbCount);
+      if (cAccepted > hdr.cRules)
+      {
+        csr = CSR_BAD_FORMAT;
+      }
+    }
+  }
+
+  HOST_RULES_RULE rule = {};
+  bool fApplies = false;
+  for (unsigned long i = 0; CSR_OK == csr && !fApplies && i < cAccepted; i++)
+  {
+    unsigned char rgb[HOST_RULES_RULE_SIZE];
+    csr = _ReadAt(pFile, hdr, HRS_ACCEPTS, oAccept + 4 + 4ULL * i, rgb, 4);
+    if (CSR_OK == csr)
+    {
+      unsigned long iRule = _GetU32(rgb);
+      csr = (iRule < hdr.cRules)
+        ? _ReadAt(pFile, hdr, HRS_RULES, (unsigned long long)iRule * HOST_RULES_RULE_SIZE, rgb, sizeof(rgb))
+        : CSR_BAD_FORMAT;
+    }
+    if (CSR_OK == csr)
+    {
+      rule.iAccount = _GetU32(rgb);
+      rule.ulLine = _GetU32(rgb + 4);
+      rule.ulDays = _GetU32(rgb + 8);
+      rule.ulMinuteStart = _GetU32(rgb + 12);
+      rule.ulMinuteEnd = _GetU32(rgb + 16);
+      rule.iFirstTagRef = _GetU32(rgb + 20);
+      rule.cTags = _GetU32(rgb + 24);
+      csr = _RuleApplies(pFile, hdr, rule, query, &fApplies);
+    }
+  }
+  if (CSR_OK == csr && !fApplies)
+  {
+    csr = CSR_NOT_FOUND;
+  }
+
+  unsigned char rgbKey[SEALED_STORE_KEY_SIZE];
+  bool fHaveKey = false;
+  if (CSR_OK == csr && pKeys)
+  {
+    csr = pKeys->GetKey(hdr.rgbKeyId, rgbKey);
+    fHaveKey = (CSR_OK == csr);
+  }
+  if (CSR_OK == csr)
+  {
+    csr = _LoadAccount(pFile, hdr, rule.iAccount, fHaveKey ? rgbKey : NULL, puc);
+  }
+  if (CSR_OK == csr && pulLine)
+  {
+    *pulLine = rule.ulLine;
+  }
+
+  PlatformSecureZero(rgbKey, sizeof(rgbKey));
+  PlatformCloseFile(pFile);
+  return csr;
+}
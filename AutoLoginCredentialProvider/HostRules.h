@@ -0,0 +1,136 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Host rules: which account a machine logs on as, chosen by rules on its name, its tags
+// and the time of day rather than by a store written for each machine.  CredentialTool
+// compile-rules turns the rules text into the file described here; this is the
+// platform-neutral code that evaluates it.
+//
+// Every rule's name pattern is compiled into one deterministic automaton over the
+// (upper-cased) machine name, so finding the rules whose patterns match takes a single
+// pass over the name however many rules there are.  The state the name ends in lists the
+// matching rules in priority order (their order in the rules text); the first of those
+// whose tag and time conditions also hold picks the account.
+//
+// The file is read with small positioned reads: one state, and its edges, per character
+// of the name, then the few rules and the one account that are needed.
+//
+// Layout, integers little-endian:
+//
+//   header        HOST_RULES_HEADER_SIZE bytes: magic, version, flags, counts, key id and
+//                 the offset of each section below
+//   class map     129 bytes: the character class of each ASCII character, then the class
+//                 of every other character
+//   states        16 bytes each: default next state, first edge, edge count, and the
+//                 offset of its accept list in the accept section (or HOST_RULES_NONE)
+//   edges         8 bytes each, sorted by class within a state: class, next state
+//   accepts       lists of rule indexes: a count, then that many indexes
+//   rules         HOST_RULES_RULE_SIZE bytes each: account, source line, days, time
+//                 window, first tag reference and tag count
+//   tag refs      8 bytes each, for a tag a rule needs: its offset in the strings section
+//                 and its length
+//   strings       the tags, ASCII
+//   accounts      16 bytes each: the file offset and size of the account's record
+//   records       each the three lines of a credential store in UTF-8 or, in a sealed
+//                 rules file, those lines sealed as in SealedStore.h with
+//                 HostRulesAccountAad
+
+#pragma once
+
+#include "CredentialStore.h"
+#include "SealedStore.h"
+
+#define HOST_RULES_MAGIC 0x53524C41UL            // 'ALRS'
+#define HOST_RULES_VERSION 1
+#define HOST_RULES_FLAG_SEALED 0x1
+#define HOST_RULES_NONE 0xFFFFFFFFUL             // no such state, no accept list
+#define HOST_RULES_CLASS_MAP_SIZE 129
+#define HOST_RULES_STATE_SIZE 16
+#define HOST_RULES_EDGE_SIZE 8
+#define HOST_RULES_RULE_SIZE 28
+#define HOST_RULES_TAG_REF_SIZE 8
+#define HOST_RULES_ACCOUNT_SIZE 16
+#define HOST_RULES_ALL_DAYS 0x7F                 // bit 0 is Sunday
+#define HOST_RULES_MAX_TAG 64
+
+enum HOST_RULES_SECTION
+{
+  HRS_CLASS_MAP,
+  HRS_STATES,
+  HRS_EDGES,
+  HRS_ACCEPTS,
+  HRS_RULES,
+  HRS_TAG_REFS,
+  HRS_STRINGS,
+  HRS_ACCOUNTS,
+  HRS_NUM_SECTIONS,
+};
+
+#define HOST_RULES_HEADER_SIZE (48 + 8 * HRS_NUM_SECTIONS)
+
+struct HOST_RULES_HEADER
+{
+  unsigned long ulMagic;
+  unsigned long ulVersion;
+  unsigned long ulFlags;
+  unsigned long cClasses;
+  unsigned long cStates;
+  unsigned long iStartState;
+  unsigned long cRules;
+  unsigned long cAccounts;
+  unsigned char rgbKeyId[SEALED_STORE_KEY_ID_SIZE];   // sealed files only
+  unsigned long long rgullSections[HRS_NUM_SECTIONS];
+};
+
+struct HOST_RULES_RULE
+{
+  unsigned long iAccount;
+  unsigned long ulLine;             // in the rules text, for diagnostics
+  unsigned long ulDays;             // HOST_RULES_ALL_DAYS for any day
+  unsigned long ulMinuteStart;      // local time window [start, end); equal means all day,
+  unsigned long ulMinuteEnd;        // and start > end wraps past midnight
+  unsigned long iFirstTagRef;
+  unsigned long cTags;              // all of which the machine must have
+};
+
+// What the rules are evaluated against.
+struct HOST_RULES_QUERY
+{
+  const wchar_t* pwzMachine;
+  size_t cchMachine;
+  const wchar_t* const* rgpwzTags;
+  size_t cTags;
+  unsigned long ulDayOfWeek;        // 0 is Sunday
+  unsigned long ulMinuteOfDay;      // local time
+};
+
+// Serialize for writers (see the layout above).
+void HostRulesEncodeHeader(const HOST_RULES_HEADER& hdr, unsigned char* pb);
+void HostRulesEncodeRule(const HOST_RULES_RULE& rule, unsigned char* pb);
+
+// Builds the SEALED_STORE_AAD_SIZE bytes of additional authenticated data for the record
+// of account iAccount in a sealed rules file.
+void HostRulesAccountAad(const unsigned char* pbKeyId, unsigned long iAccount, unsigned char* pbAad);
+
+// Folds a character of a machine name or pattern the way the automaton expects.
+inline wchar_t HostRulesFold(wchar_t ch)
+{
+  return (ch >= L'a' && ch <= L'z') ? (wchar_t)(ch - L'a' + L'A') : ch;
+}
+
+// Evaluates the rules file at pwzPath and loads the account of the first rule that applies.
+// Returns CSR_NOT_FOUND if none does.  pKeys is required for a sealed rules file and must be
+// NULL otherwise: a plaintext file is refused where sealed ones are expected, and the other
+// way around.  *pulLine, if given, receives the rules text line of the rule that applied.
+CREDENTIAL_STORE_RESULT HostRulesLoad(
+  const wchar_t* pwzPath,
+  ISealedStoreKeyProvider* pKeys,
+  const HOST_RULES_QUERY& query,
+  UserCredentials* puc,
+  unsigned long* pulLine
+);
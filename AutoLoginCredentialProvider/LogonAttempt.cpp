@@ -0,0 +1,108 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Logon attempt tracking and the window of recent attempts; see LogonAttempt.h.
+
+#include <algorithm>
+#include <mutex>
+#include "LogonAttempt.h"
+
+struct LOGON_ATTEMPT_SAMPLE
+{
+  unsigned long long rgullNs[LAM_NUM_MILESTONES];   // from the start, or LOGON_ATTEMPT_NOT_REACHED
+};
+
+// Attempts end at most a few times a second, so a lock costs nothing worth avoiding.
+static std::mutex s_mutexWindow;
+static LOGON_ATTEMPT_SAMPLE s_rgWindow[LOGON_ATTEMPT_WINDOW];
+static unsigned long long s_cCompleted = 0;
+
+CLogonAttempt::CLogonAttempt()
+{
+  std::fill(_rgullNs, _rgullNs + LAM_NUM_MILESTONES, LOGON_ATTEMPT_NOT_REACHED);
+}
+
+void CLogonAttempt::Stamp(LOGON_ATTEMPT_MILESTONE lam, unsigned long long ullNs)
+{
+  if (LOGON_ATTEMPT_NOT_REACHED == _rgullNs[lam])
+  {
+    _rgullNs[lam] = ullNs;
+  }
+}
+
+void CLogonAttempt::Complete(unsigned long long* pullSubmitNs, unsigned long long* pullResultNs)
+{
+  Stamp(LAM_REPORT_RESULT);
+
+  // Without SetUsageScenario (a retry on the same tile) the attempt starts at the first
+  // milestone it did reach.
+  unsigned long long ullStart = *std::min_element(_rgullNs, _rgullNs + LAM_NUM_MILESTONES);
+
+  LOGON_ATTEMPT_SAMPLE sample;
+  for (int lam = 0; lam < LAM_NUM_MILESTONES; lam++)
+  {
+    sample.rgullNs[lam] = (LOGON_ATTEMPT_NOT_REACHED == _rgullNs[lam]) ? LOGON_ATTEMPT_NOT_REACHED : _rgullNs[lam] - ullStart;
+    _rgullNs[lam] = LOGON_ATTEMPT_NOT_REACHED;
+  }
+
+  if (pullSubmitNs)
+  {
+    *pullSubmitNs = sample.rgullNs[LAM_GET_SERIALIZATION];
+  }
+  if (pullResultNs)
+  {
+    *pullResultNs = sample.rgullNs[LAM_REPORT_RESULT];
+  }
+
+  std::lock_guard<std::mutex> lock(s_mutexWindow);
+  s_rgWindow[s_cCompleted % LOGON_ATTEMPT_WINDOW] = sample;
+  s_cCompleted++;
+}
+
+// The nearest-rank percentile of the sorted rgull[0..c).
+static unsigned long long _Percentile(const unsigned long long* rgull, unsigned long c, unsigned long ulPercent)
+{
+  unsigned long iRank = (c * ulPercent + 99) / 100;
+  return rgull[iRank ? iRank - 1 : 0];
+}
+
+void LogonAttemptGetStats(LOGON_ATTEMPT_STATS* pStats)
+{
+  unsigned long long rgull[LOGON_ATTEMPT_WINDOW];
+
+  std::lock_guard<std::mutex> lock(s_mutexWindow);
+  pStats->cCompleted = s_cCompleted;
+  pStats->cWindow = (unsigned long)std::min<unsigned long long>(s_cCompleted, LOGON_ATTEMPT_WINDOW);
+
+  for (int lam = 0; lam < LAM_NUM_MILESTONES; lam++)
+  {
+    unsigned long c = 0;
+    for (unsigned long i = 0; i < pStats->cWindow; i++)
+    {
+      if (LOGON_ATTEMPT_NOT_REACHED != s_rgWindow[i].rgullNs[lam])
+      {
+        rgull[c++] = s_rgWindow[i].rgullNs[lam];
+      }
+    }
+
+    LOGON_ATTEMPT_PERCENTILES& lap = pStats->rgMilestones[lam];
+    lap.cSamples = c;
+    if (c)
+    {
+      std::sort(rgull, rgull + c);
+      lap.ullP50Ns = _Percentile(rgull, c, 50);
+      lap.ullP90Ns = _Percentile(rgull, c, 90);
+      lap.ullP99Ns = _Percentile(rgull, c, 99);
+      lap.ullMaxNs = rgull[c - 1];
+    }
+    else
+    {
+      lap.ullP50Ns = lap.ullP90Ns = lap.ullP99Ns = lap.ullMaxNs = 0;
+    }
+  }
+}
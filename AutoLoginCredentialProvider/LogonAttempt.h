@@ -0,0 +1,78 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Logon attempts: how long LogonUI takes to get from asking for our tile to the result of
+// submitting it, across the separate calls it makes on the way.
+//
+// Each credential tracks its own attempt.  It notes the monotonic time at which the
+// attempt reaches each milestone and keeps the first time for each.  When ReportResult
+// ends the attempt, the time from its start to every milestone it reached joins a
+// process-wide window of the last LOGON_ATTEMPT_WINDOW attempts, from which
+// LogonAttemptGetStats computes percentiles.  The next attempt on the same tile (a retry
+// after a failure) starts at its first milestone, since LogonUI does not ask for tiles
+// again.
+//
+// Platform-neutral: time comes from PlatformMonotonicNanoseconds.
+
+#pragma once
+
+#include "Platform.h"
+
+enum LOGON_ATTEMPT_MILESTONE
+{
+  LAM_SET_USAGE_SCENARIO,   // LogonUI asked for tiles; the attempt starts here
+  LAM_GET_CREDENTIAL_AT,    // the tile was handed to LogonUI
+  LAM_SET_SELECTED,         // the tile was selected
+  LAM_GET_SERIALIZATION,    // GetSerialization returned a credential
+  LAM_REPORT_RESULT,        // LogonUI reported the result; the attempt ends here
+  LAM_NUM_MILESTONES,
+};
+
+#define LOGON_ATTEMPT_WINDOW 256
+#define LOGON_ATTEMPT_NOT_REACHED 0xFFFFFFFFFFFFFFFFULL
+
+struct LOGON_ATTEMPT_PERCENTILES
+{
+  unsigned long cSamples;           // attempts in the window that reached the milestone
+  unsigned long long ullP50Ns;      // from the start of the attempt
+  unsigned long long ullP90Ns;
+  unsigned long long ullP99Ns;
+  unsigned long long ullMaxNs;
+};
+
+struct LOGON_ATTEMPT_STATS
+{
+  unsigned long long cCompleted;    // attempts ever completed in this process
+  unsigned long cWindow;            // of which the window holds the last cWindow
+  LOGON_ATTEMPT_PERCENTILES rgMilestones[LAM_NUM_MILESTONES];
+};
+
+class CLogonAttempt
+{
+public:
+  CLogonAttempt();
+
+  // Notes that the attempt reached lam at ullNs, unless it already had.
+  void Stamp(LOGON_ATTEMPT_MILESTONE lam, unsigned long long ullNs);
+
+  void Stamp(LOGON_ATTEMPT_MILESTONE lam)
+  {
+    Stamp(lam, PlatformMonotonicNanoseconds());
+  }
+
+  // Stamps LAM_REPORT_RESULT, adds the attempt to the window and starts the next one.
+  // *pullSubmitNs and *pullResultNs, if given, receive the time from the start of the
+  // attempt to LAM_GET_SERIALIZATION and to LAM_REPORT_RESULT, or
+  // LOGON_ATTEMPT_NOT_REACHED.
+  void Complete(unsigned long long* pullSubmitNs, unsigned long long* pullResultNs);
+
+private:
+  unsigned long long _rgullNs[LAM_NUM_MILESTONES];  // LOGON_ATTEMPT_NOT_REACHED until stamped
+};
+
+void LogonAttemptGetStats(LOGON_ATTEMPT_STATS* pStats);
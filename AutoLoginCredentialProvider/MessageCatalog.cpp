@@ -0,0 +1,275 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <string.h>
+#include "MessageCatalog.h"
+
+static void _PutU16(unsigned char* pb, unsigned short us)
+{
+  pb[0] = (unsigned char)us;
+  pb[1] = (unsigned char)(us >> 8);
+}
+
+static void _PutU32(unsigned char* pb, unsigned long ul)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    pb[i] = (unsigned char)(ul >> (8 * i));
+  }
+}
+
+static unsigned short _GetU16(const unsigned char* pb)
+{
+  return (unsigned short)(pb[0] | (pb[1] << 8));
+}
+
+static unsigned long _GetU32(const unsigned char* pb)
+{
+  unsigned long ul = 0;
+  for (int i = 3; i >= 0; i--)
+  {
+    ul = (ul << 8) | pb[i];
+  }
+  return ul;
+}
+
+void MessageCatalogEncodeHeader(const MESSAGE_CATALOG_HEADER& hdr, unsigned char* pb)
+{
+  _PutU32(pb, hdr.ulMagic);
+  _PutU32(pb + 4, hdr.ulVersion);
+  _PutU32(pb + 8, hdr.ulDefaultLangId);
+  _PutU32(pb + 12, hdr.cSlots);
+  _PutU32(pb + 16, hdr.cMessages);
+  _PutU32(pb + 20, hdr.ulSlotsOffset);
+  _PutU32(pb + 24, hdr.ulTextOffset);
+  _PutU32(pb + 28, hdr.cbText);
+}
+
+static void _DecodeHeader(const unsigned char* pb, MESSAGE_CATALOG_HEADER* phdr)
+{
+  phdr->ulMagic = _GetU32(pb);
+  phdr->ulVersion = _GetU32(pb + 4);
+  phdr->ulDefaultLangId = _GetU32(pb + 8);
+  phdr->cSlots = _GetU32(pb + 12);
+  phdr->cMessages = _GetU32(pb + 16);
+  phdr->ulSlotsOffset = _GetU32(pb + 20);
+  phdr->ulTextOffset = _GetU32(pb + 24);
+  phdr->cbText = _GetU32(pb + 28);
+}
+
+void MessageCatalogEncodeSlot(const MESSAGE_CATALOG_SLOT& slot, unsigned char* pb)
+{
+  _PutU32(pb, slot.ulStatus);
+  _PutU32(pb + 4, slot.ulSubstatus);
+  _PutU16(pb + 8, slot.usLangId);
+  pb[10] = slot.bFlags;
+  pb[11] = slot.bIcon;
+  _PutU32(pb + 12, slot.ulText);
+}
+
+// The murmur3 finalizer over the three parts of the key, each mixed in with its own odd
+// multiplier so that swapping status and substatus lands elsewhere.
+unsigned long MessageCatalogHash(unsigned long ulStatus, unsigned long ulSubstatus, unsigned short usLangId, bool fAnySubstatus)
+{
+  unsigned long ulHash = (ulStatus * 0x9E3779B1UL) & 0xFFFFFFFFUL;
+  ulHash ^= (ulSubstatus * 0x85EBCA77UL) & 0xFFFFFFFFUL;
+  ulHash ^= ((usLangId | (fAnySubstatus ? 0x10000UL : 0)) * 0xC2B2AE3DUL) & 0xFFFFFFFFUL;
+  ulHash ^= ulHash >> 16;
+  ulHash = (ulHash * 0x85EBCA6BUL) & 0xFFFFFFFFUL;
+  ulHash ^= ulHash >> 13;
+  ulHash = (ulHash * 0xC2B2AE35UL) & 0xFFFFFFFFUL;
+  ulHash ^= ulHash >> 16;
+  return ulHash;
+}
+
+PLATFORM_RESULT MessageCatalogAttach(const void* pv, size_t cb, MESSAGE_CATALOG* pCatalog)
+{
+  memset(pCatalog, 0, sizeof(*pCatalog));
+  const unsigned char* pb = static_cast<const unsigned char*>(pv);
+  if (cb < MESSAGE_CATALOG_HEADER_SIZE || cb > MESSAGE_CATALOG_MAX_SIZE)
+  {
+    return PR_BAD_DATA;
+  }
+
+  MESSAGE_CATALOG_HEADER hdr;
+  _DecodeHeader(pb, &hdr);
+  if (MESSAGE_CATALOG_MAGIC != hdr.ulMagic || MESSAGE_CATALOG_VERSION != hdr.ulVersion)
+  {
+    return PR_BAD_DATA;
+  }
+
+  // A power of two, so that masking finds the first slot, with one empty at least, so that
+  // a probe for a key that is not there ends.  cb bounds both sections, so none of this
+  // overflows.
+  if (0 == hdr.cSlots || 0 != (hdr.cSlots & (hdr.cSlots - 1)) || hdr.cMessages >= hdr.cSlots ||
+    hdr.ulSlotsOffset < MESSAGE_CATALOG_HEADER_SIZE || hdr.ulSlotsOffset > cb ||
+    hdr.cSlots > (cb - hdr.ulSlotsOffset) / MESSAGE_CATALOG_SLOT_SIZE ||
+    hdr.ulTextOffset > cb || hdr.cbText > cb - hdr.ulTextOffset)
+  {
+    return PR_BAD_DATA;
+  }
+
+  // Every message a used slot points at lies inside the text section.
+  unsigned long cUsed = 0;
+  const unsigned char* pbText = pb + hdr.ulTextOffset;
+  for (unsigned long i = 0; i < hdr.cSlots; i++)
+  {
+    const unsigned char* pbSlot = pb + hdr.ulSlotsOffset + (size_t)i * MESSAGE_CATALOG_SLOT_SIZE;
+    if (0 == (pbSlot[10] & MESSAGE_CATALOG_SLOT_USED))
+    {
+      continue;
+    }
+    cUsed++;
+    unsigned long ulText = _GetU32(pbSlot + 12);
+    if (pbSlot[11] > MCI_SUCCESS || ulText > hdr.cbText || hdr.cbText - ulText < 2 ||
+      (size_t)_GetU16(pbText + ulText) * 2 > hdr.cbText - ulText - 2)
+    {
+      return PR_BAD_DATA;
+    }
+  }
+  if (cUsed != hdr.cMessages)
+  {
+    return PR_BAD_DATA;
+  }
+
+  pCatalog->pb = pb;
+  pCatalog->cb = cb;
+  pCatalog->hdr = hdr;
+  return PR_OK;
+}
+
+PLATFORM_RESULT MessageCatalogOpen(const wchar_t* pwzPath, MESSAGE_CATALOG* pCatalog)
+{
+  memset(pCatalog, 0, sizeof(*pCatalog));
+
+  PLATFORM_FILE_VIEW* pView;
+  const void* pv;
+  size_t cb;
+  PLATFORM_RESULT pr = PlatformMapFile(pwzPath, MESSAGE_CATALOG_MAX_SIZE, &pView, &pv, &cb);
+  if (PR_TOO_LARGE == pr || PR_END_OF_FILE == pr)
+  {
+    pr = PR_BAD_DATA;
+  }
+  if (PR_OK == pr)
+  {
+    pr = MessageCatalogAttach(pv, cb, pCatalog);
+    if (PR_OK == pr)
+    {
+      pCatalog->pView = pView;
+    }
+    else
+    {
+      PlatformUnmapFile(pView);
+    }
+  }
+  return pr;
+}
+
+void MessageCatalogClose(MESSAGE_CATALOG* pCatalog)
+{
+  PlatformUnmapFile(pCatalog->pView);
+  memset(pCatalog, 0, sizeof(*pCatalog));
+}
+
+// Probes for one key.  Returns the slot that holds it, or NULL.
+static const unsigned char* _FindSlot(
+  const MESSAGE_CATALOG& catalog,
+  unsigned long ulStatus,
+  unsigned long ulSubstatus,
+  unsigned short usLangId,
+  bool fAnySubstatus
+)
+{
+  const unsigned char* pbSlots = catalog.pb + catalog.hdr.ulSlotsOffset;
+  unsigned long ulMask = catalog.hdr.cSlots - 1;
+  unsigned char bFlags = MESSAGE_CATALOG_SLOT_USED | (fAnySubstatus ? MESSAGE_CATALOG_SLOT_ANY_SUBSTATUS : 0);
+  if (fAnySubstatus)
+  {
+    ulSubstatus = 0;
+  }
+
+  for (unsigned long i = MessageCatalogHash(ulStatus, ulSubstatus, usLangId, fAnySubstatus) & ulMask; ; i = (i + 1) & ulMask)
+  {
+    const unsigned char* pbSlot = pbSlots + (size_t)i * MESSAGE_CATALOG_SLOT_SIZE;
+    if (0 == (pbSlot[10] & MESSAGE_CATALOG_SLOT_USED))
+    {
+      return NULL;
+    }
+    if (bFlags == pbSlot[10] && ulStatus == _GetU32(pbSlot) && ulSubstatus == _GetU32(pbSlot + 4) &&
+      usLangId == _GetU16(pbSlot + 8))
+    {
+      return pbSlot;
+    }
+  }
+}
+
+bool MessageCatalogLookup(
+  const MESSAGE_CATALOG& catalog,
+  unsigned long ulStatus,
+  unsigned long ulSubstatus,
+  unsigned short usLangId,
+  MESSAGE_CATALOG_ENTRY* pEntry
+)
+{
+  if (!catalog.pb)
+  {
+    return false;
+  }
+
+  // Statuses are 32 bits, however wide the caller's long is.
+  ulStatus &= 0xFFFFFFFFUL;
+  ulSubstatus &= 0xFFFFFFFFUL;
+
+  unsigned short rgusLangIds[3] = { usLangId, MESSAGE_CATALOG_PRIMARY_LANGID(usLangId), (unsigned short)catalog.hdr.ulDefaultLangId };
+  const unsigned char* pbSlot = NULL;
+  for (int i = 0; !pbSlot && i < 3; i++)
+  {
+    if (i > 0 && rgusLangIds[i] == rgusLangIds[i - 1])
+    {
+      continue;
+    }
+    pbSlot = _FindSlot(catalog, ulStatus, ulSubstatus, rgusLangIds[i], false);
+    if (!pbSlot)
+    {
+      pbSlot = _FindSlot(catalog, ulStatus, ulSubstatus, rgusLangIds[i], true);
+    }
+  }
+  if (!pbSlot)
+  {
+    return false;
+  }
+
+  const unsigned char* pbText = catalog.pb + catalog.hdr.ulTextOffset + _GetU32(pbSlot + 12);
+  pEntry->cchText = _GetU16(pbText);
+  pEntry->pbText = pbText + 2;
+  pEntry->mci = (MESSAGE_CATALOG_ICON)pbSlot[11];
+  return true;
+}
+
+size_t MessageCatalogCopyText(const MESSAGE_CATALOG_ENTRY& entry, wchar_t* pwz)
+{
+  size_t cch = 0;
+  for (size_t i = 0; i < entry.cchText; i++)
+  {
+    unsigned long ulUnit = _GetU16(entry.pbText + 2 * i);
+    if (sizeof(wchar_t) > 2 && ulUnit >= 0xD800 && ulUnit < 0xDC00 && i + 1 < entry.cchText)
+    {
+      unsigned long ulLow = _GetU16(entry.pbText + 2 * (i + 1));
+      if (ulLow >= 0xDC00 && ulLow < 0xE000)
+      {
+        ulUnit = 0x10000 + ((ulUnit - 0xD800) << 10) + (ulLow - 0xDC00);
+        i++;
+      }
+    }
+    pwz[cch++] = (wchar_t)ulUnit;
+  }
+  pwz[cch] = L'\0';
+  return cch;
+}
@@ -0,0 +1,133 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The message catalog: what ReportResult tells the user about a logon that failed, for each
+// status and substatus, in each language.  CredentialTool compile-messages turns the
+// message text (messages.txt) into the file described here, and the build puts it next to
+// the DLL; this is the platform-neutral code that looks messages up in it.
+//
+// The file is mapped, not read, and a lookup is a few probes of an open-addressed hash
+// table keyed on status, substatus and LANGID, each a 16-byte slot.  The text is stored as
+// the UTF-16 LogonUI is handed, so nothing is parsed or converted at logon beyond the copy
+// into the string ReportResult returns.
+//
+// A lookup tries the LANGID it is given, then its primary language (SUBLANG_NEUTRAL), then
+// the catalog's default language, and in each the status with its substatus before the
+// status with any substatus.  The compiler files each message under its primary language
+// too, unless a message for that language says otherwise, so that en-GB finds en-US's.
+//
+// Layout, integers little-endian:
+//
+//   header        MESSAGE_CATALOG_HEADER_SIZE bytes: magic, version, default LANGID, slot
+//                 and message counts, and the offset and size of each section below
+//   slots         MESSAGE_CATALOG_SLOT_SIZE bytes each, a power of two of them and at
+//                 least one empty: status, substatus, LANGID, flags, icon, and the offset of
+//                 the message in the text section.  A key lives in the first slot from
+//                 MessageCatalogHash(key) & (slots - 1) onward that is empty or holds it.
+//   text          the messages, each a 16-bit count of UTF-16 code units and then the units
+
+#pragma once
+
+#include "Platform.h"
+
+#define MESSAGE_CATALOG_MAGIC 0x434D4C41UL       // 'ALMC'
+#define MESSAGE_CATALOG_VERSION 1
+#define MESSAGE_CATALOG_HEADER_SIZE 32
+#define MESSAGE_CATALOG_SLOT_SIZE 16
+#define MESSAGE_CATALOG_MAX_TEXT 0xFFFF          // UTF-16 code units in one message
+#define MESSAGE_CATALOG_MAX_SIZE (16 * 1024 * 1024)
+
+// Slot flags.
+#define MESSAGE_CATALOG_SLOT_USED 0x1
+#define MESSAGE_CATALOG_SLOT_ANY_SUBSTATUS 0x2   // the substatus is not part of the key
+
+// The file name, next to the DLL.
+#define MESSAGE_CATALOG_FILE_NAME L"AutoLoginCredentialProvider.messages"
+
+// LANGID arithmetic, as winnt.h does it.
+#define MESSAGE_CATALOG_PRIMARY_LANGID(langid) ((unsigned short)((langid) & 0x3FF))
+
+// The icon shown with a message, in the order of CREDENTIAL_PROVIDER_STATUS_ICON.
+enum MESSAGE_CATALOG_ICON
+{
+  MCI_NONE,
+  MCI_ERROR,
+  MCI_WARNING,
+  MCI_SUCCESS,
+};
+
+struct MESSAGE_CATALOG_HEADER
+{
+  unsigned long ulMagic;
+  unsigned long ulVersion;
+  unsigned long ulDefaultLangId;
+  unsigned long cSlots;
+  unsigned long cMessages;          // used slots
+  unsigned long ulSlotsOffset;
+  unsigned long ulTextOffset;
+  unsigned long cbText;
+};
+
+struct MESSAGE_CATALOG_SLOT
+{
+  unsigned long ulStatus;
+  unsigned long ulSubstatus;        // 0 with MESSAGE_CATALOG_SLOT_ANY_SUBSTATUS
+  unsigned short usLangId;
+  unsigned char bFlags;
+  unsigned char bIcon;              // a MESSAGE_CATALOG_ICON
+  unsigned long ulText;             // offset in the text section
+};
+
+// A catalog that has been checked and can be looked up in.
+struct MESSAGE_CATALOG
+{
+  const unsigned char* pb;
+  size_t cb;
+  MESSAGE_CATALOG_HEADER hdr;
+  PLATFORM_FILE_VIEW* pView;        // NULL if the caller owns the memory
+};
+
+// A message found in a catalog.  pbText points into the catalog.
+struct MESSAGE_CATALOG_ENTRY
+{
+  const unsigned char* pbText;      // cchText UTF-16LE code units
+  size_t cchText;
+  MESSAGE_CATALOG_ICON mci;
+};
+
+// Serialize for writers (see the layout above).
+void MessageCatalogEncodeHeader(const MESSAGE_CATALOG_HEADER& hdr, unsigned char* pb);
+void MessageCatalogEncodeSlot(const MESSAGE_CATALOG_SLOT& slot, unsigned char* pb);
+
+// Where a key's probe sequence starts, before it is masked to the slot count.
+unsigned long MessageCatalogHash(unsigned long ulStatus, unsigned long ulSubstatus, unsigned short usLangId, bool fAnySubstatus);
+
+// Checks the cb bytes at pv, which must outlive the catalog, and fills in *pCatalog.
+// Everything a lookup reads is checked here, once, so lookups check nothing.  Returns
+// PR_BAD_DATA if the bytes are not a catalog.
+PLATFORM_RESULT MessageCatalogAttach(const void* pv, size_t cb, MESSAGE_CATALOG* pCatalog);
+
+// Maps the catalog file at pwzPath and attaches to it.  MessageCatalogClose unmaps it.
+PLATFORM_RESULT MessageCatalogOpen(const wchar_t* pwzPath, MESSAGE_CATALOG* pCatalog);
+
+void MessageCatalogClose(MESSAGE_CATALOG* pCatalog);
+
+// Finds the message for ulStatus and ulSubstatus in usLangId, or in the languages it falls
+// back to.  Returns false if there is none.  Allocates nothing.
+bool MessageCatalogLookup(
+  const MESSAGE_CATALOG& catalog,
+  unsigned long ulStatus,
+  unsigned long ulSubstatus,
+  unsigned short usLangId,
+  MESSAGE_CATALOG_ENTRY* pEntry
+);
+
+// Copies the message's text to pwz, which has room for entry.cchText + 1 characters, and
+// terminates it.  Returns the number of characters copied, which is fewer than cchText
+// where wchar_t holds a whole surrogate pair.
+size_t MessageCatalogCopyText(const MESSAGE_CATALOG_ENTRY& entry, wchar_t* pwz);
@@ -0,0 +1,203 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The operating system services used by the platform-neutral parts of the provider
+// (CredentialStore.cpp, SealedStore.cpp, SharedAccountCache.cpp, AccountName.cpp) and of
+// the helpers library (Trace.cpp, Histogram.cpp, AuditLog.cpp, AllocTrack.cpp,
+// ThreadPool.cpp).  Those files include only this header and the C++ standard library;
+// PlatformWin32.cpp is the implementation the provider ships with, and PlatformPosix.cpp
+// the one the CMake build uses to build and test them off Windows.  Anything that needs
+// more of Windows than this (COM, LSA, CredProtect, the tile itself) stays in the COM
+// wrappers.
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+enum PLATFORM_RESULT
+{
+  PR_OK,
+  PR_NOT_FOUND,       // the file does not exist
+  PR_ACCESS_DENIED,
+  PR_TOO_LARGE,
+  PR_OUT_OF_MEMORY,
+  PR_END_OF_FILE,     // a read ran past the end of the file
+  PR_BAD_DATA,        // authenticated decryption found the data or its tag altered, or a file is
+                      // not in the format it should be
+  PR_IO_ERROR,        // anything else the platform reported
+  PR_INVALID_ARGUMENT,  // the caller passed a value out of range
+};
+
+struct PLATFORM_FILE;
+struct PLATFORM_FILE_VIEW;
+struct PLATFORM_SHARED_SEGMENT;
+
+// PlatformProtectMemory works in blocks of this many bytes.
+#define PLATFORM_PROTECT_BLOCK_SIZE 16
+
+// The size of a PlatformSha256 digest.
+#define PLATFORM_SHA256_SIZE 32
+
+// Reads the whole file at pwzPath into *prgbContents.  Files larger than cbMax are refused.
+PLATFORM_RESULT PlatformReadFile(
+  const wchar_t* pwzPath,
+  size_t cbMax,
+  std::vector<unsigned char>* prgbContents
+);
+
+// Zeroes cb bytes at pv in a way the compiler will not optimize away.
+void PlatformSecureZero(void* pv, size_t cb);
+
+// Folds the cch characters at pwz to upper case in place, the way account names are
+// compared: by character, without a locale.
+void PlatformUpcase(wchar_t* pwz, size_t cch);
+
+// Nanoseconds on a clock that never goes backwards, from an arbitrary origin.
+unsigned long long PlatformMonotonicNanoseconds();
+
+// Opens the file at pwzPath for reading with PlatformReadFileAt.  *ppFile is closed with
+// PlatformCloseFile.
+PLATFORM_RESULT PlatformOpenFile(
+  const wchar_t* pwzPath,
+  PLATFORM_FILE** ppFile
+);
+
+// Reads exactly cb bytes at ullOffset.  Returns PR_END_OF_FILE if the file is shorter.
+PLATFORM_RESULT PlatformReadFileAt(
+  PLATFORM_FILE* pFile,
+  unsigned long long ullOffset,
+  void* pv,
+  size_t cb
+);
+
+void PlatformCloseFile(PLATFORM_FILE* pFile);
+
+enum PLATFORM_CREATE
+{
+  PC_TRUNCATE,        // the file starts out empty
+  PC_KEEP,            // whatever the file already holds is kept
+};
+
+// Opens the file at pwzPath for writing with PlatformWriteFileAt, and reading with
+// PlatformReadFileAt, creating it if it does not exist.  Other processes can read the file
+// while it is open.  *ppFile is closed with PlatformCloseFile.
+PLATFORM_RESULT PlatformCreateFile(
+  const wchar_t* pwzPath,
+  PLATFORM_CREATE pc,
+  PLATFORM_FILE** ppFile
+);
+
+// Writes cb bytes at ullOffset, extending the file if that is past its end.
+PLATFORM_RESULT PlatformWriteFileAt(
+  PLATFORM_FILE* pFile,
+  unsigned long long ullOffset,
+  const void* pv,
+  size_t cb
+);
+
+PLATFORM_RESULT PlatformGetFileSize(PLATFORM_FILE* pFile, unsigned long long* pcb);
+
+// Returns once everything written to the file is on disk.
+PLATFORM_RESULT PlatformFlushFile(PLATFORM_FILE* pFile);
+
+// Renames the file at pwzFrom to pwzTo, replacing any file already there.
+PLATFORM_RESULT PlatformRenameFile(const wchar_t* pwzFrom, const wchar_t* pwzTo);
+
+// Maps the whole file at pwzPath into memory, read-only.  *ppv receives the view and *pcb
+// its size, valid until PlatformUnmapFile; pages are read in as they are touched.  Files
+// larger than cbMax are refused, and so are empty ones, with PR_END_OF_FILE.
+PLATFORM_RESULT PlatformMapFile(
+  const wchar_t* pwzPath,
+  size_t cbMax,
+  PLATFORM_FILE_VIEW** ppView,
+  const void** ppv,
+  size_t* pcb
+);
+
+void PlatformUnmapFile(PLATFORM_FILE_VIEW* pView);
+
+// The time of day, UTC, as a FILETIME: 100-nanosecond intervals since January 1, 1601.
+unsigned long long PlatformSystemTime();
+
+// The ids of the calling process and thread, as the system's own tools show them.
+unsigned long PlatformCurrentProcessId();
+unsigned long PlatformCurrentThreadId();
+
+// Writes psz where a developer will see it: the debugger on Windows, stderr elsewhere.
+void PlatformDebugOutput(const char* psz);
+
+// Decrypts cb bytes of AES-GCM ciphertext into pbPlaintext (which has room for cb bytes),
+// checking the tag over the ciphertext and the additional authenticated data.  Returns
+// PR_BAD_DATA if the tag does not match.  The platform is expected to use the processor's
+// AES and carry-less multiply instructions where it has them.
+PLATFORM_RESULT PlatformAesGcmDecrypt(
+  const unsigned char* pbKey,
+  size_t cbKey,
+  const unsigned char* pbNonce,
+  size_t cbNonce,
+  const unsigned char* pbAad,
+  size_t cbAad,
+  const unsigned char* pbCiphertext,
+  size_t cb,
+  const unsigned char* pbTag,
+  size_t cbTag,
+  unsigned char* pbPlaintext
+);
+
+// The other way round, for writers: encrypts cb bytes of pbPlaintext into pbCiphertext
+// (which has room for cb bytes) and writes a cbTag-byte tag to pbTag.  The provider itself
+// only ever decrypts.
+PLATFORM_RESULT PlatformAesGcmEncrypt(
+  const unsigned char* pbKey,
+  size_t cbKey,
+  const unsigned char* pbNonce,
+  size_t cbNonce,
+  const unsigned char* pbAad,
+  size_t cbAad,
+  const unsigned char* pbPlaintext,
+  size_t cb,
+  unsigned char* pbCiphertext,
+  unsigned char* pbTag,
+  size_t cbTag
+);
+
+// Opens the cb-byte segment of memory named pwzName that every session on the machine
+// shares, creating it zero-filled if no process has it open.  Only the account the provider
+// runs as and administrators can open it, and one created by anyone else is refused with
+// PR_ACCESS_DENIED.  *ppvRead receives a read-only view of the whole segment, valid until
+// PlatformCloseSharedSegment.
+PLATFORM_RESULT PlatformOpenSharedSegment(
+  const wchar_t* pwzName,
+  size_t cb,
+  PLATFORM_SHARED_SEGMENT** ppSegment,
+  const void** ppvRead
+);
+
+// Maps a writable view of the whole segment, which PlatformUnmapSharedSegment releases.
+PLATFORM_RESULT PlatformMapSharedSegmentForWrite(
+  PLATFORM_SHARED_SEGMENT* pSegment,
+  void** ppvWrite
+);
+
+void PlatformUnmapSharedSegment(PLATFORM_SHARED_SEGMENT* pSegment, void* pvWrite);
+
+// Unmaps the read-only view and closes the segment, which goes away once no process has it
+// open.
+void PlatformCloseSharedSegment(PLATFORM_SHARED_SEGMENT* pSegment);
+
+// Encrypts cb bytes at pv in place, cb being a multiple of PLATFORM_PROTECT_BLOCK_SIZE, so
+// that only processes running as the same account on this machine can decrypt them with
+// PlatformUnprotectMemory, and only until it restarts.  Decrypting with the wrong account
+// succeeds but yields garbage, so the caller has to check what it gets back.
+PLATFORM_RESULT PlatformProtectMemory(void* pv, size_t cb);
+PLATFORM_RESULT PlatformUnprotectMemory(void* pv, size_t cb);
+
+// Writes the SHA-256 of cb bytes at pv to pbDigest, which has room for PLATFORM_SHA256_SIZE
+// bytes.  Allocates nothing.
+PLATFORM_RESULT PlatformSha256(const void* pv, size_t cb, unsigned char* pbDigest);
@@ -0,0 +1,809 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// POSIX implementation of Platform.h, with OpenSSL for the cryptography.  The provider never
+// runs on it; it is what the CMake build links the platform-neutral files against so that
+// they can be built and tested off Windows.
+
+// SHA256_Init and friends are deprecated in OpenSSL 3, but they keep the context on the
+// stack, where EVP would allocate one.
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <wctype.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <string>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include "Platform.h"
+
+// The key PlatformProtectMemory uses, one per account, kept in /dev/shm so that it is gone
+// when the machine restarts.
+#define PROTECT_KEY_NAME_FORMAT "/AutoLoginCredentialProvider.MemoryKey.%lu"
+#define PROTECT_KEY_SIZE 32
+
+struct PLATFORM_FILE
+{
+  int fd;
+};
+
+struct PLATFORM_FILE_VIEW
+{
+  void* pv;
+  size_t cb;
+};
+
+struct PLATFORM_SHARED_SEGMENT
+{
+  int fd;
+  size_t cb;
+  const void* pvRead;
+};
+
+static PLATFORM_RESULT _PlatformResultFromErrno(int err)
+{
+  switch (err)
+  {
+  case ENOENT:
+  case ENOTDIR:
+    return PR_NOT_FOUND;
+
+  case EACCES:
+  case EPERM:
+    return PR_ACCESS_DENIED;
+
+  case ENOMEM:
+    return PR_OUT_OF_MEMORY;
+
+  default:
+    return PR_IO_ERROR;
+  }
+}
+
+// File and object names are UTF-8 here.  Appends pwz to *pstr.
+static bool _Utf8FromWide(const wchar_t* pwz, std::string* pstr)
+{
+  try
+  {
+    for (; *pwz; pwz++)
+    {
+      unsigned long ulCode = (unsigned long)*pwz;
+      if (ulCode < 0x80)
+      {
+        *pstr += (char)ulCode;
+      }
+      else if (ulCode < 0x800)
+      {
+        *pstr += (char)(0xC0 | (ulCode >> 6));
+        *pstr += (char)(0x80 | (ulCode & 0x3F));
+      }
+      else if (ulCode < 0x10000)
+      {
+        *pstr += (char)(0xE0 | (ulCode >> 12));
+        *pstr += (char)(0x80 | ((ulCode >> 6) & 0x3F));
+        *pstr += (char)(0x80 | (ulCode & 0x3F));
+      }
+      else
+      {
+        *pstr += (char)(0xF0 | (ulCode >> 18));
+        *pstr += (char)(0x80 | ((ulCode >> 12) & 0x3F));
+        *pstr += (char)(0x80 | ((ulCode >> 6) & 0x3F));
+        *pstr += (char)(0x80 | (ulCode & 0x3F));
+      }
+    }
+    return true;
+  }
+  catch (const std::bad_alloc&)
+  {
+    return false;
+  }
+}
+
+static PLATFORM_RESULT _Open(const wchar_t* pwzPath, int* pfd)
+{
+  std::string path;
+  if (!_Utf8FromWide(pwzPath, &path))
+  {
+    return PR_OUT_OF_MEMORY;
+  }
+  *pfd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  return (*pfd >= 0) ? PR_OK : _PlatformResultFromErrno(errno);
+}
+
+// Reads cb bytes at ullOffset, or as many as there are before the end of the file.
+static PLATFORM_RESULT _ReadAt(int fd, unsigned long long ullOffset, void* pv, size_t cb, size_t* pcbRead)
+{
+  *pcbRead = 0;
+  while (*pcbRead < cb)
+  {
+    ssize_t cbChunk = pread(fd, static_cast<unsigned char*>(pv) + *pcbRead, cb - *pcbRead, (off_t)(ullOffset + *pcbRead));
+    if (cbChunk < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      return _PlatformResultFromErrno(errno);
+    }
+    if (0 == cbChunk)
+    {
+      break;
+    }
+    *pcbRead += (size_t)cbChunk;
+  }
+  return PR_OK;
+}
+
+PLATFORM_RESULT PlatformReadFile(
+  const wchar_t* pwzPath,
+  size_t cbMax,
+  std::vector<unsigned char>* prgbContents
+)
+{
+  prgbContents->clear();
+
+  int fd;
+  PLATFORM_RESULT pr = _Open(pwzPath, &fd);
+  if (PR_OK != pr)
+  {
+    return pr;
+  }
+
+  struct stat st;
+  if (0 != fstat(fd, &st))
+  {
+    pr = _PlatformResultFromErrno(errno);
+  }
+  else if ((unsigned long long)st.st_size > cbMax)
+  {
+    pr = PR_TOO_LARGE;
+  }
+  else
+  {
+    try
+    {
+      prgbContents->resize((size_t)st.st_size);
+
+      // The file may have shrunk between the size check and the read.
+      size_t cbRead = 0;
+      if (!prgbContents->empty())
+      {
+        pr = _ReadAt(fd, 0, &(*prgbContents)[0], prgbContents->size(), &cbRead);
+      }
+      prgbContents->resize(cbRead);
+    }
+    catch (const std::bad_alloc&)
+    {
+      pr = PR_OUT_OF_MEMORY;
+    }
+  }
+
+  close(fd);
+  return pr;
+}
+
+void PlatformSecureZero(void* pv, size_t cb)
+{
+  explicit_bzero(pv, cb);
+}
+
+void PlatformUpcase(wchar_t* pwz, size_t cch)
+{
+  // C.UTF-8 has the invariant case mappings LCMapStringEx uses; without it only ASCII is
+  // folded.
+  static locale_t s_locale = newlocale(LC_CTYPE_MASK, "C.UTF-8", (locale_t)0);
+  for (size_t i = 0; i < cch; i++)
+  {
+    pwz[i] = (wchar_t)(s_locale ? towupper_l((wint_t)pwz[i], s_locale) : towupper((wint_t)pwz[i]));
+  }
+}
+
+unsigned long long PlatformMonotonicNanoseconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+PLATFORM_RESULT PlatformOpenFile(
+  const wchar_t* pwzPath,
+  PLATFORM_FILE** ppFile
+)
+{
+  *ppFile = NULL;
+
+  int fd;
+  PLATFORM_RESULT pr = _Open(pwzPath, &fd);
+  if (PR_OK != pr)
+  {
+    return pr;
+  }
+
+  PLATFORM_FILE* pFile = new (std::nothrow) PLATFORM_FILE;
+  if (!pFile)
+  {
+    close(fd);
+    return PR_OUT_OF_MEMORY;
+  }
+
+  pFile->fd = fd;
+  *ppFile = pFile;
+  return PR_OK;
+}
+
+PLATFORM_RESULT PlatformReadFileAt(
+  PLATFORM_FILE* pFile,
+  unsigned long long ullOffset,
+  void* pv,
+  size_t cb
+)
+{
+  size_t cbRead;
+  PLATFORM_RESULT pr = _ReadAt(pFile->fd, ullOffset, pv, cb, &cbRead);
+  if (PR_OK == pr && cbRead != cb)
+  {
+    pr = PR_END_OF_FILE;
+  }
+  return pr;
+}
+
+void PlatformCloseFile(PLATFORM_FILE* pFile)
+{
+  if (pFile)
+  {
+    close(pFile->fd);
+    delete pFile;
+  }
+}
+
+PLATFORM_RESULT PlatformCreateFile(
+  const wchar_t* pwzPath,
+  PLATFORM_CREATE pc,
+  PLATFORM_FILE** ppFile
+)
+{
+  *ppFile = NULL;
+
+  std::string path;
+  if (!_Utf8FromWide(pwzPath, &path))
+  {
+    return PR_OUT_OF_MEMORY;
+  }
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | ((PC_TRUNCATE == pc) ? O_TRUNC : 0), 0644);
+  if (fd < 0)
+  {
+    return _PlatformResultFromErrno(errno);
+  }
+
+  PLATFORM_FILE* pFile = new (std::nothrow) PLATFORM_FILE;
+  if (!pFile)
+  {
+    close(fd);
+    return PR_OUT_OF_MEMORY;
+  }
+
+  pFile->fd = fd;
+  *ppFile = pFile;
+  return PR_OK;
+}
+
+PLATFORM_RESULT PlatformWriteFileAt(
+  PLATFORM_FILE* pFile,
+  unsigned long long ullOffset,
+  const void* pv,
+  size_t cb
+)
+{
+  size_t cbWritten = 0;
+  while (cbWritten < cb)
+  {
+    ssize_t cbChunk = pwrite(pFile->fd, static_cast<const unsigned char*>(pv) + cbWritten, cb - cbWritten, (off_t)(ullOffset + cbWritten));
+    if (cbChunk < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      return (ENOSPC == errno || EFBIG == errno) ? PR_TOO_LARGE : _PlatformResultFromErrno(errno);
+    }
+    cbWritten += (size_t)cbChunk;
+  }
+  return PR_OK;
+}
+
+PLATFORM_RESULT PlatformGetFileSize(PLATFORM_FILE* pFile, unsigned long long* pcb)
+{
+  struct stat st;
+  if (0 != fstat(pFile->fd, &st))
+  {
+    return _PlatformResultFromErrno(errno);
+  }
+  *pcb = (unsigned long long)st.st_size;
+  return PR_OK;
+}
+
+PLATFORM_RESULT PlatformFlushFile(PLATFORM_FILE* pFile)
+{
+  return (0 == fsync(pFile->fd)) ? PR_OK : _PlatformResultFromErrno(errno);
+}
+
+PLATFORM_RESULT PlatformRenameFile(const wchar_t* pwzFrom, const wchar_t* pwzTo)
+{
+  std::string from;
+  std::string to;
+  if (!_Utf8FromWide(pwzFrom, &from) || !_Utf8FromWide(pwzTo, &to))
+  {
+    return PR_OUT_OF_MEMORY;
+  }
+  return (0 == rename(from.c_str(), to.c_str())) ? PR_OK : _PlatformResultFromErrno(errno);
+}
+
+PLATFORM_RESULT PlatformMapFile(
+  const wchar_t* pwzPath,
+  size_t cbMax,
+  PLATFORM_FILE_VIEW** ppView,
+  const void** ppv,
+  size_t* pcb
+)
+{
+  *ppView = NULL;
+  *ppv = NULL;
+  *pcb = 0;
+
+  int fd;
+  PLATFORM_RESULT pr = _Open(pwzPath, &fd);
+  if (PR_OK != pr)
+  {
+    return pr;
+  }
+
+  struct stat st;
+  if (0 != fstat(fd, &st))
+  {
+    pr = _PlatformResultFromErrno(errno);
+  }
+  else if ((unsigned long long)st.st_size > cbMax)
+  {
+    pr = PR_TOO_LARGE;
+  }
+  else if (0 == st.st_size)
+  {
+    pr = PR_END_OF_FILE;
+  }
+
+  PLATFORM_FILE_VIEW* pView = NULL;
+  if (PR_OK == pr)
+  {
+    pView = new (std::nothrow) PLATFORM_FILE_VIEW;
+    pr = pView ? PR_OK : PR_OUT_OF_MEMORY;
+  }
+  if (PR_OK == pr)
+  {
+    // The mapping keeps the file open; the descriptor is not needed past this.
+    pView->cb = (size_t)st.st_size;
+    pView->pv = mmap(NULL, pView->cb, PROT_READ, MAP_PRIVATE, fd, 0);
+    pr = (MAP_FAILED != pView->pv) ? PR_OK : _PlatformResultFromErrno(errno);
+  }
+  close(fd);
+
+  if (PR_OK == pr)
+  {
+    *ppView = pView;
+    *ppv = pView->pv;
+    *pcb = pView->cb;
+  }
+  else
+  {
+    delete pView;
+  }
+  return pr;
+}
+
+void PlatformUnmapFile(PLATFORM_FILE_VIEW* pView)
+{
+  if (pView)
+  {
+    munmap(pView->pv, pView->cb);
+    delete pView;
+  }
+}
+
+unsigned long long PlatformSystemTime()
+{
+  // From the Unix epoch to the FILETIME one, 369 years earlier.
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ((unsigned long long)ts.tv_sec + 11644473600ULL) * 10000000ULL + (unsigned long long)ts.tv_nsec / 100;
+}
+
+unsigned long PlatformCurrentProcessId()
+{
+  return (unsigned long)getpid();
+}
+
+unsigned long PlatformCurrentThreadId()
+{
+  return (unsigned long)syscall(SYS_gettid);
+}
+
+void PlatformDebugOutput(const char* psz)
+{
+  fputs(psz, stderr);
+}
+
+static const EVP_CIPHER* _AesGcmCipher(size_t cbKey)
+{
+  switch (cbKey)
+  {
+  case 16:
+    return EVP_aes_128_gcm();
+
+  case 24:
+    return EVP_aes_192_gcm();
+
+  case 32:
+    return EVP_aes_256_gcm();
+
+  default:
+    return NULL;
+  }
+}
+
+// OpenSSL picks the AES-NI and PCLMULQDQ code paths itself when the processor has them.
+static PLATFORM_RESULT _AesGcm(
+  bool fEncrypt,
+  const unsigned char* pbKey,
+  size_t cbKey,
+  const unsigned char* pbNonce,
+  size_t cbNonce,
+  const unsigned char* pbAad,
+  size_t cbAad,
+  const unsigned char* pbIn,
+  size_t cb,
+  unsigned char* pbTag,
+  size_t cbTag,
+  unsigned char* pbOut
+)
+{
+  if (cb > INT_MAX || cbNonce > INT_MAX || cbAad > INT_MAX || cbTag > INT_MAX)
+  {
+    return PR_TOO_LARGE;
+  }
+  const EVP_CIPHER* pCipher = _AesGcmCipher(cbKey);
+  if (!pCipher)
+  {
+    return PR_IO_ERROR;
+  }
+
+  EVP_CIPHER_CTX* pctx = EVP_CIPHER_CTX_new();
+  if (!pctx)
+  {
+    return PR_OUT_OF_MEMORY;
+  }
+
+  int cbOut = 0;
+  bool fOk = 1 == EVP_CipherInit_ex(pctx, pCipher, NULL, NULL, NULL, fEncrypt ? 1 : 0) &&
+    1 == EVP_CIPHER_CTX_ctrl(pctx, EVP_CTRL_GCM_SET_IVLEN, (int)cbNonce, NULL) &&
+    1 == EVP_CipherInit_ex(pctx, NULL, NULL, pbKey, pbNonce, -1) &&
+    (0 == cbAad || 1 == EVP_CipherUpdate(pctx, NULL, &cbOut, pbAad, (int)cbAad)) &&
+    (0 == cb || 1 == EVP_CipherUpdate(pctx, pbOut, &cbOut, pbIn, (int)cb)) &&
+    (fEncrypt || 1 == EVP_CIPHER_CTX_ctrl(pctx, EVP_CTRL_GCM_SET_TAG, (int)cbTag, pbTag));
+
+  PLATFORM_RESULT pr = fOk ? PR_OK : PR_IO_ERROR;
+  if (fOk)
+  {
+    unsigned char rgbFinal[16];
+    if (1 != EVP_CipherFinal_ex(pctx, rgbFinal, &cbOut))
+    {
+      // Only the tag check can fail here.
+      pr = fEncrypt ? PR_IO_ERROR : PR_BAD_DATA;
+    }
+    else if (fEncrypt && 1 != EVP_CIPHER_CTX_ctrl(pctx, EVP_CTRL_GCM_GET_TAG, (int)cbTag, pbTag))
+    {
+      pr = PR_IO_ERROR;
+    }
+  }
+  EVP_CIPHER_CTX_free(pctx);
+
+  if (PR_OK != pr && cb)
+  {
+    PlatformSecureZero(pbOut, cb);
+  }
+  return pr;
+}
+
+PLATFORM_RESULT PlatformAesGcmDecrypt(
+  const unsigned char* pbKey,
+  size_t cbKey,
+  const unsigned char* pbNonce,
+  size_t cbNonce,
+  const unsigned char* pbAad,
+  size_t cbAad,
+  const unsigned char* pbCiphertext,
+  size_t cb,
+  const unsigned char* pbTag,
+  size_t cbTag,
+  unsigned char* pbPlaintext
+)
+{
+  return _AesGcm(false, pbKey, cbKey, pbNonce, cbNonce, pbAad, cbAad, pbCiphertext, cb,
+    const_cast<unsigned char*>(pbTag), cbTag, pbPlaintext);
+}
+
+PLATFORM_RESULT PlatformAesGcmEncrypt(
+  const unsigned char* pbKey,
+  size_t cbKey,
+  const unsigned char* pbNonce,
+  size_t cbNonce,
+  const unsigned char* pbAad,
+  size_t cbAad,
+  const unsigned char* pbPlaintext,
+  size_t cb,
+  unsigned char* pbCiphertext,
+  unsigned char* pbTag,
+  size_t cbTag
+)
+{
+  return _AesGcm(true, pbKey, cbKey, pbNonce, cbNonce, pbAad, cbAad, pbPlaintext, cb, pbTag, cbTag, pbCiphertext);
+}
+
+// Whether a shared memory object someone else created is one we would have created: owned
+// by this account or by root, and open to nobody else.  One squatted on the name by anyone
+// else would hand us their account.
+static bool _IsObjectTrusted(int fd, struct stat* pst)
+{
+  if (0 != fstat(fd, pst))
+  {
+    return false;
+  }
+  return (pst->st_uid == geteuid() || 0 == pst->st_uid) && 0 == (pst->st_mode & 077);
+}
+
+PLATFORM_RESULT PlatformOpenSharedSegment(
+  const wchar_t* pwzName,
+  size_t cb,
+  PLATFORM_SHARED_SEGMENT** ppSegment,
+  const void** ppvRead
+)
+{
+  *ppSegment = NULL;
+  *ppvRead = NULL;
+
+  std::string name;
+  if (!_Utf8FromWide(L"/", &name) || !_Utf8FromWide(pwzName, &name))
+  {
+    return PR_OUT_OF_MEMORY;
+  }
+
+  // /dev/shm is emptied when the machine restarts, but an object outlives the processes
+  // that had it open until then.  The next one to come along finds it again, which is what
+  // a cache wants anyway.
+  bool fCreated = true;
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd < 0 && EEXIST == errno)
+  {
+    fCreated = false;
+    fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+  }
+  if (fd < 0)
+  {
+    return _PlatformResultFromErrno(errno);
+  }
+
+  struct stat st;
+  PLATFORM_RESULT pr = PR_OK;
+  if (fCreated)
+  {
+    // The umask may have taken bits away from 0600, but the owner needs both.
+    if (0 != fchmod(fd, 0600) || 0 != fstat(fd, &st))
+    {
+      pr = _PlatformResultFromErrno(errno);
+    }
+  }
+  else if (!_IsObjectTrusted(fd, &st))
+  {
+    pr = PR_ACCESS_DENIED;
+  }
+
+  // Sizing is left to whoever gets there first; until then a mapping would fault past the
+  // end, so a second process that beats the creator to it sizes it too.
+  if (PR_OK == pr && (unsigned long long)st.st_size < cb && 0 != ftruncate(fd, (off_t)cb))
+  {
+    pr = _PlatformResultFromErrno(errno);
+  }
+
+  PLATFORM_SHARED_SEGMENT* pSegment = NULL;
+  void* pvRead = MAP_FAILED;
+  if (PR_OK == pr)
+  {
+    pSegment = new (std::nothrow) PLATFORM_SHARED_SEGMENT;
+    pr = pSegment ? PR_OK : PR_OUT_OF_MEMORY;
+  }
+  if (PR_OK == pr)
+  {
+    pvRead = mmap(NULL, cb, PROT_READ, MAP_SHARED, fd, 0);
+    pr = (MAP_FAILED != pvRead) ? PR_OK : _PlatformResultFromErrno(errno);
+  }
+
+  if (PR_OK == pr)
+  {
+    pSegment->fd = fd;
+    pSegment->cb = cb;
+    pSegment->pvRead = pvRead;
+    *ppSegment = pSegment;
+    *ppvRead = pvRead;
+  }
+  else
+  {
+    delete pSegment;
+    close(fd);
+  }
+  return pr;
+}
+
+PLATFORM_RESULT PlatformMapSharedSegmentForWrite(
+  PLATFORM_SHARED_SEGMENT* pSegment,
+  void** ppvWrite
+)
+{
+  void* pv = mmap(NULL, pSegment->cb, PROT_READ | PROT_WRITE, MAP_SHARED, pSegment->fd, 0);
+  *ppvWrite = (MAP_FAILED != pv) ? pv : NULL;
+  return *ppvWrite ? PR_OK : _PlatformResultFromErrno(errno);
+}
+
+void PlatformUnmapSharedSegment(PLATFORM_SHARED_SEGMENT* pSegment, void* pvWrite)
+{
+  munmap(pvWrite, pSegment->cb);
+}
+
+void PlatformCloseSharedSegment(PLATFORM_SHARED_SEGMENT* pSegment)
+{
+  munmap(const_cast<void*>(pSegment->pvRead), pSegment->cb);
+  close(pSegment->fd);
+  delete pSegment;
+}
+
+// Creates this account's key, or reads the one another process created.  Whoever opens the
+// object holds its lock until done with it, so nobody reads a key half written.  An object
+// that is empty or short was left by a process that died writing it, so nobody has used the
+// key in it, and it is written afresh; one that is too long is not ours.
+static PLATFORM_RESULT _LoadProtectKey(unsigned char* pbKey)
+{
+  char szName[64];
+  snprintf(szName, sizeof(szName), PROTECT_KEY_NAME_FORMAT, (unsigned long)geteuid());
+
+  bool fCreated = true;
+  int fd = shm_open(szName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd < 0 && EEXIST == errno)
+  {
+    fCreated = false;
+    fd = shm_open(szName, O_RDWR | O_CLOEXEC, 0);
+  }
+  if (fd < 0)
+  {
+    return _PlatformResultFromErrno(errno);
+  }
+
+  // The umask may have taken bits away from 0600, as in PlatformOpenSharedSegment.
+  struct stat st;
+  PLATFORM_RESULT pr = PR_OK;
+  if (0 != flock(fd, LOCK_EX) || (fCreated && 0 != fchmod(fd, 0600)))
+  {
+    pr = _PlatformResultFromErrno(errno);
+  }
+  else if (!_IsObjectTrusted(fd, &st) || st.st_uid != geteuid() || (unsigned long long)st.st_size > PROTECT_KEY_SIZE)
+  {
+    pr = PR_ACCESS_DENIED;
+  }
+  else if (PROTECT_KEY_SIZE == st.st_size)
+  {
+    size_t cbRead;
+    pr = _ReadAt(fd, 0, pbKey, PROTECT_KEY_SIZE, &cbRead);
+    if (PR_OK == pr && PROTECT_KEY_SIZE != cbRead)
+    {
+      pr = PR_END_OF_FILE;
+    }
+  }
+  else if (1 != RAND_bytes(pbKey, PROTECT_KEY_SIZE))
+  {
+    pr = PR_IO_ERROR;
+  }
+  else
+  {
+    // Written over whatever was there, so if this process dies part way the object is still
+    // short for the next one.
+    ssize_t cbWritten = pwrite(fd, pbKey, PROTECT_KEY_SIZE, 0);
+    if (PROTECT_KEY_SIZE != cbWritten)
+    {
+      pr = (cbWritten < 0) ? _PlatformResultFromErrno(errno) : PR_IO_ERROR;
+    }
+  }
+  close(fd);
+
+  if (PR_OK != pr)
+  {
+    PlatformSecureZero(pbKey, PROTECT_KEY_SIZE);
+  }
+  return pr;
+}
+
+// Like CryptProtectMemory, there is no nonce: the same bytes protect to the same bytes until
+// the machine restarts.
+static PLATFORM_RESULT _ProtectBlocks(bool fProtect, void* pv, size_t cb)
+{
+  // Only a key that loaded is kept.  A failure, say /dev/shm out of reach for a moment, is
+  // tried again on the next call rather than turning protection off for good.
+  static unsigned char s_rgbKey[PROTECT_KEY_SIZE];
+  static std::atomic<bool> s_fKey(false);
+  static std::mutex s_lockKey;
+  if (!s_fKey.load(std::memory_order_acquire))
+  {
+    std::lock_guard<std::mutex> lock(s_lockKey);
+    if (!s_fKey.load(std::memory_order_relaxed))
+    {
+      PLATFORM_RESULT pr = _LoadProtectKey(s_rgbKey);
+      if (PR_OK != pr)
+      {
+        return pr;
+      }
+      s_fKey.store(true, std::memory_order_release);
+    }
+  }
+  if (0 != cb % PLATFORM_PROTECT_BLOCK_SIZE || cb > INT_MAX)
+  {
+    return PR_BAD_DATA;
+  }
+
+  EVP_CIPHER_CTX* pctx = EVP_CIPHER_CTX_new();
+  if (!pctx)
+  {
+    return PR_OUT_OF_MEMORY;
+  }
+
+  static const unsigned char s_rgbIv[PLATFORM_PROTECT_BLOCK_SIZE] = {};
+  unsigned char* pb = static_cast<unsigned char*>(pv);
+  int cbOut = 0;
+  bool fOk = 1 == EVP_CipherInit_ex(pctx, EVP_aes_256_cbc(), NULL, s_rgbKey, s_rgbIv, fProtect ? 1 : 0) &&
+    1 == EVP_CIPHER_CTX_set_padding(pctx, 0) &&
+    (0 == cb || 1 == EVP_CipherUpdate(pctx, pb, &cbOut, pb, (int)cb)) &&
+    1 == EVP_CipherFinal_ex(pctx, pb + cbOut, &cbOut);
+  EVP_CIPHER_CTX_free(pctx);
+  return fOk ? PR_OK : PR_IO_ERROR;
+}
+
+PLATFORM_RESULT PlatformProtectMemory(void* pv, size_t cb)
+{
+  return _ProtectBlocks(true, pv, cb);
+}
+
+PLATFORM_RESULT PlatformUnprotectMemory(void* pv, size_t cb)
+{
+  return _ProtectBlocks(false, pv, cb);
+}
+
+PLATFORM_RESULT PlatformSha256(const void* pv, size_t cb, unsigned char* pbDigest)
+{
+  SHA256_CTX ctx;
+  bool fOk = 1 == SHA256_Init(&ctx) && 1 == SHA256_Update(&ctx, pv, cb) && 1 == SHA256_Final(pbDigest, &ctx);
+  PlatformSecureZero(&ctx, sizeof(ctx));
+  return fOk ? PR_OK : PR_IO_ERROR;
+}
@@ -0,0 +1,613 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Win32 implementation of Platform.h.
+
+#ifndef WIN32_NO_STATUS
+#include <ntstatus.h>
+#define WIN32_NO_STATUS
+#endif
+#include <windows.h>
+#include <bcrypt.h>
+#include <dpapi.h>
+#include <sddl.h>
+#include <aclapi.h>
+#include <strsafe.h>
+#include <new>
+#include "Platform.h"
+
+// SYSTEM, which LogonUI runs as in every session, and administrators, who can read the
+// stores anyway.
+#define SHARED_SEGMENT_SDDL L"D:P(A;;GA;;;SY)(A;;GA;;;BA)"
+
+struct PLATFORM_FILE
+{
+  HANDLE hFile;
+};
+
+struct PLATFORM_FILE_VIEW
+{
+  const void* pv;
+};
+
+struct PLATFORM_SHARED_SEGMENT
+{
+  HANDLE hSection;
+  size_t cb;
+  const void* pvRead;
+};
+
+static PLATFORM_RESULT _PlatformResultFromWin32(DWORD dwErr)
+{
+  switch (dwErr)
+  {
+  case ERROR_FILE_NOT_FOUND:
+  case ERROR_PATH_NOT_FOUND:
+    return PR_NOT_FOUND;
+
+  case ERROR_ACCESS_DENIED:
+    return PR_ACCESS_DENIED;
+
+  case ERROR_NOT_ENOUGH_MEMORY:
+  case ERROR_OUTOFMEMORY:
+    return PR_OUT_OF_MEMORY;
+
+  case ERROR_HANDLE_EOF:
+    return PR_END_OF_FILE;
+
+  default:
+    return PR_IO_ERROR;
+  }
+}
+
+PLATFORM_RESULT PlatformReadFile(
+  const wchar_t* pwzPath,
+  size_t cbMax,
+  std::vector<unsigned char>* prgbContents
+)
+{
+  PLATFORM_RESULT pr;
+
+  prgbContents->clear();
+
+  HANDLE hFile = CreateFileW(pwzPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (hFile != INVALID_HANDLE_VALUE)
+  {
+    LARGE_INTEGER liSize;
+    if (GetFileSizeEx(hFile, &liSize))
+    {
+      if ((ULONGLONG)liSize.QuadPart <= cbMax)
+      {
+        try
+        {
+          prgbContents->resize((size_t)liSize.QuadPart);
+
+          DWORD cbRead = 0;
+          if (prgbContents->empty() ||
+            ReadFile(hFile, &(*prgbContents)[0], (DWORD)prgbContents->size(), &cbRead, NULL))
+          {
+            // The file may have shrunk between the size check and the read.
+            prgbContents->resize(cbRead);
+            pr = PR_OK;
+          }
+          else
+          {
+            pr = _PlatformResultFromWin32(GetLastError());
+          }
+        }
+        catch (const std::bad_alloc&)
+        {
+          pr = PR_OUT_OF_MEMORY;
+        }
+      }
+      else
+      {
+        pr = PR_TOO_LARGE;
+      }
+    }
+    else
+    {
+      pr = _PlatformResultFromWin32(GetLastError());
+    }
+    CloseHandle(hFile);
+  }
+  else
+  {
+    pr = _PlatformResultFromWin32(GetLastError());
+  }
+
+  return pr;
+}
+
+void PlatformSecureZero(void* pv, size_t cb)
+{
+  SecureZeroMemory(pv, cb);
+}
+
+void PlatformUpcase(wchar_t* pwz, size_t cch)
+{
+  // Upper-casing maps each character to one character, so it can be done in place.  On
+  // failure the name is left as it is, and only matches names spelled the same.
+  LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, pwz, static_cast<int>(cch), pwz, static_cast<int>(cch), NULL, NULL, 0);
+}
+
+unsigned long long PlatformMonotonicNanoseconds()
+{
+  LARGE_INTEGER liFrequency;
+  LARGE_INTEGER liNow;
+  QueryPerformanceFrequency(&liFrequency);
+  QueryPerformanceCounter(&liNow);
+
+  // Split the division so the multiply cannot overflow however long the machine has been up.
+  ULONGLONG ullTicks = (ULONGLONG)liNow.QuadPart;
+  ULONGLONG ullFrequency = (ULONGLONG)liFrequency.QuadPart;
+  return (ullTicks / ullFrequency) * 1000000000ULL + (ullTicks % ullFrequency) * 1000000000ULL / ullFrequency;
+}
+
+PLATFORM_RESULT PlatformOpenFile(
+  const wchar_t* pwzPath,
+  PLATFORM_FILE** ppFile
+)
+{
+  *ppFile = NULL;
+
+  HANDLE hFile = CreateFileW(pwzPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    return _PlatformResultFromWin32(GetLastError());
+  }
+
+  PLATFORM_FILE* pFile = new (std::nothrow) PLATFORM_FILE;
+  if (!pFile)
+  {
+    CloseHandle(hFile);
+    return PR_OUT_OF_MEMORY;
+  }
+
+  pFile->hFile = hFile;
+  *ppFile = pFile;
+  return PR_OK;
+}
+
+PLATFORM_RESULT PlatformReadFileAt(
+  PLATFORM_FILE* pFile,
+  unsigned long long ullOffset,
+  void* pv,
+  size_t cb
+)
+{
+  if (cb > MAXDWORD)
+  {
+    return PR_TOO_LARGE;
+  }
+
+  OVERLAPPED ov = {};
+  ov.Offset = (DWORD)ullOffset;
+  ov.OffsetHigh = (DWORD)(ullOffset >> 32);
+
+  DWORD cbRead = 0;
+  if (!ReadFile(pFile->hFile, pv, (DWORD)cb, &cbRead, &ov))
+  {
+    return _PlatformResultFromWin32(GetLastError());
+  }
+  return (cbRead == cb) ? PR_OK : PR_END_OF_FILE;
+}
+
+void PlatformCloseFile(PLATFORM_FILE* pFile)
+{
+  if (pFile)
+  {
+    CloseHandle(pFile->hFile);
+    delete pFile;
+  }
+}
+
+PLATFORM_RESULT PlatformCreateFile(
+  const wchar_t* pwzPath,
+  PLATFORM_CREATE pc,
+  PLATFORM_FILE** ppFile
+)
+{
+  *ppFile = NULL;
+
+  HANDLE hFile = CreateFileW(pwzPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+    (PC_TRUNCATE == pc) ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    return _PlatformResultFromWin32(GetLastError());
+  }
+
+  PLATFORM_FILE* pFile = new (std::nothrow) PLATFORM_FILE;
+  if (!pFile)
+  {
+    CloseHandle(hFile);
+    return PR_OUT_OF_MEMORY;
+  }
+
+  pFile->hFile = hFile;
+  *ppFile = pFile;
+  return PR_OK;
+}
+
+PLATFORM_RESULT PlatformWriteFileAt(
+  PLATFORM_FILE* pFile,
+  unsigned long long ullOffset,
+  const void* pv,
+  size_t cb
+)
+{
+  if (cb > MAXDWORD)
+  {
+    return PR_TOO_LARGE;
+  }
+
+  OVERLAPPED ov = {};
+  ov.Offset = (DWORD)ullOffset;
+  ov.OffsetHigh = (DWORD)(ullOffset >> 32);
+
+  DWORD cbWritten = 0;
+  if (!WriteFile(pFile->hFile, pv, (DWORD)cb, &cbWritten, &ov))
+  {
+    DWORD dwErr = GetLastError();
+    return (ERROR_DISK_FULL == dwErr) ? PR_TOO_LARGE : _PlatformResultFromWin32(dwErr);
+  }
+  return (cbWritten == cb) ? PR_OK : PR_IO_ERROR;
+}
+
+PLATFORM_RESULT PlatformGetFileSize(PLATFORM_FILE* pFile, unsigned long long* pcb)
+{
+  LARGE_INTEGER liSize;
+  if (!GetFileSizeEx(pFile->hFile, &liSize))
+  {
+    return _PlatformResultFromWin32(GetLastError());
+  }
+  *pcb = (ULONGLONG)liSize.QuadPart;
+  return PR_OK;
+}
+
+PLATFORM_RESULT PlatformFlushFile(PLATFORM_FILE* pFile)
+{
+  return FlushFileBuffers(pFile->hFile) ? PR_OK : _PlatformResultFromWin32(GetLastError());
+}
+
+PLATFORM_RESULT PlatformRenameFile(const wchar_t* pwzFrom, const wchar_t* pwzTo)
+{
+  return MoveFileExW(pwzFrom, pwzTo, MOVEFILE_REPLACE_EXISTING) ? PR_OK : _PlatformResultFromWin32(GetLastError());
+}
+
+PLATFORM_RESULT PlatformMapFile(
+  const wchar_t* pwzPath,
+  size_t cbMax,
+  PLATFORM_FILE_VIEW** ppView,
+  const void** ppv,
+  size_t* pcb
+)
+{
+  *ppView = NULL;
+  *ppv = NULL;
+  *pcb = 0;
+
+  HANDLE hFile = CreateFileW(pwzPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL, NULL);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    return _PlatformResultFromWin32(GetLastError());
+  }
+
+  PLATFORM_RESULT pr = PR_OK;
+  LARGE_INTEGER liSize;
+  if (!GetFileSizeEx(hFile, &liSize))
+  {
+    pr = _PlatformResultFromWin32(GetLastError());
+  }
+  else if ((ULONGLONG)liSize.QuadPart > cbMax)
+  {
+    pr = PR_TOO_LARGE;
+  }
+  else if (0 == liSize.QuadPart)
+  {
+    pr = PR_END_OF_FILE;
+  }
+
+  // The view keeps the file and the section open; neither handle is needed past this.
+  HANDLE hSection = NULL;
+  if (PR_OK == pr)
+  {
+    hSection = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    pr = hSection ? PR_OK : _PlatformResultFromWin32(GetLastError());
+  }
+  PLATFORM_FILE_VIEW* pView = NULL;
+  if (PR_OK == pr)
+  {
+    pView = new (std::nothrow) PLATFORM_FILE_VIEW;
+    pr = pView ? PR_OK : PR_OUT_OF_MEMORY;
+  }
+  if (PR_OK == pr)
+  {
+    pView->pv = MapViewOfFile(hSection, FILE_MAP_READ, 0, 0, 0);
+    pr = pView->pv ? PR_OK : _PlatformResultFromWin32(GetLastError());
+  }
+  if (hSection)
+  {
+    CloseHandle(hSection);
+  }
+  CloseHandle(hFile);
+
+  if (PR_OK == pr)
+  {
+    *ppView = pView;
+    *ppv = pView->pv;
+    *pcb = (size_t)liSize.QuadPart;
+  }
+  else
+  {
+    delete pView;
+  }
+  return pr;
+}
+
+void PlatformUnmapFile(PLATFORM_FILE_VIEW* pView)
+{
+  if (pView)
+  {
+    UnmapViewOfFile(pView->pv);
+    delete pView;
+  }
+}
+
+unsigned long long PlatformSystemTime()
+{
+  FILETIME ft;
+  GetSystemTimeAsFileTime(&ft);
+  return ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+unsigned long PlatformCurrentProcessId()
+{
+  return GetCurrentProcessId();
+}
+
+unsigned long PlatformCurrentThreadId()
+{
+  return GetCurrentThreadId();
+}
+
+void PlatformDebugOutput(const char* psz)
+{
+  OutputDebugStringA(psz);
+}
+
+// CNG picks the AES-NI and PCLMULQDQ code paths itself when the processor has them, and
+// falls back to its portable implementation when it does not.
+static PLATFORM_RESULT _AesGcm(
+  BOOL fEncrypt,
+  const unsigned char* pbKey,
+  size_t cbKey,
+  const unsigned char* pbNonce,
+  size_t cbNonce,
+  const unsigned char* pbAad,
+  size_t cbAad,
+  const unsigned char* pbIn,
+  size_t cb,
+  unsigned char* pbTag,
+  size_t cbTag,
+  unsigned char* pbOut
+)
+{
+  if (cb > MAXULONG || cbKey > MAXULONG || cbNonce > MAXULONG || cbAad > MAXULONG || cbTag > MAXULONG)
+  {
+    return PR_TOO_LARGE;
+  }
+
+  BCRYPT_ALG_HANDLE hAlg;
+  NTSTATUS status = BCryptOpenAlgorithmProvider(&hAlg, BCRYPT_AES_ALGORITHM, NULL, 0);
+  if (!BCRYPT_SUCCESS(status))
+  {
+    return PR_IO_ERROR;
+  }
+
+  status = BCryptSetProperty(hAlg, BCRYPT_CHAINING_MODE, (PUCHAR)BCRYPT_CHAIN_MODE_GCM, sizeof(BCRYPT_CHAIN_MODE_GCM), 0);
+
+  BCRYPT_KEY_HANDLE hKey = NULL;
+  if (BCRYPT_SUCCESS(status))
+  {
+    status = BCryptGenerateSymmetricKey(hAlg, &hKey, NULL, 0, const_cast<PUCHAR>(pbKey), (ULONG)cbKey, 0);
+  }
+
+  if (BCRYPT_SUCCESS(status))
+  {
+    BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO acmi;
+    BCRYPT_INIT_AUTH_MODE_INFO(acmi);
+    acmi.pbNonce = const_cast<PUCHAR>(pbNonce);
+    acmi.cbNonce = (ULONG)cbNonce;
+    acmi.pbAuthData = const_cast<PUCHAR>(pbAad);
+    acmi.cbAuthData = (ULONG)cbAad;
+    acmi.pbTag = pbTag;
+    acmi.cbTag = (ULONG)cbTag;
+
+    ULONG cbOut = 0;
+    status = fEncrypt ?
+      BCryptEncrypt(hKey, const_cast<PUCHAR>(pbIn), (ULONG)cb, &acmi, NULL, 0, pbOut, (ULONG)cb, &cbOut, 0) :
+      BCryptDecrypt(hKey, const_cast<PUCHAR>(pbIn), (ULONG)cb, &acmi, NULL, 0, pbOut, (ULONG)cb, &cbOut, 0);
+    BCryptDestroyKey(hKey);
+  }
+  BCryptCloseAlgorithmProvider(hAlg, 0);
+
+  if (STATUS_AUTH_TAG_MISMATCH == status)
+  {
+    return PR_BAD_DATA;
+  }
+  return BCRYPT_SUCCESS(status) ? PR_OK : PR_IO_ERROR;
+}
+
+PLATFORM_RESULT PlatformAesGcmDecrypt(
+  const unsigned char* pbKey,
+  size_t cbKey,
+  const unsigned char* pbNonce,
+  size_t cbNonce,
+  const unsigned char* pbAad,
+  size_t cbAad,
+  const unsigned char* pbCiphertext,
+  size_t cb,
+  const unsigned char* pbTag,
+  size_t cbTag,
+  unsigned char* pbPlaintext
+)
+{
+  return _AesGcm(FALSE, pbKey, cbKey, pbNonce, cbNonce, pbAad, cbAad, pbCiphertext, cb,
+    const_cast<unsigned char*>(pbTag), cbTag, pbPlaintext);
+}
+
+PLATFORM_RESULT PlatformAesGcmEncrypt(
+  const unsigned char* pbKey,
+  size_t cbKey,
+  const unsigned char* pbNonce,
+  size_t cbNonce,
+  const unsigned char* pbAad,
+  size_t cbAad,
+  const unsigned char* pbPlaintext,
+  size_t cb,
+  unsigned char* pbCiphertext,
+  unsigned char* pbTag,
+  size_t cbTag
+)
+{
+  return _AesGcm(TRUE, pbKey, cbKey, pbNonce, cbNonce, pbAad, cbAad, pbPlaintext, cb, pbTag, cbTag, pbCiphertext);
+}
+
+// Whether the section someone else created belongs to SYSTEM or the administrators.
+// Creating a Global\ object takes SeCreateGlobalPrivilege, but a section squatted on the
+// name by anyone else would hand LogonUI their account.
+static bool _IsSectionOwnerTrusted(HANDLE hSection)
+{
+  PSID psidOwner;
+  PSECURITY_DESCRIPTOR psd;
+  if (ERROR_SUCCESS != GetSecurityInfo(hSection, SE_KERNEL_OBJECT, OWNER_SECURITY_INFORMATION, &psidOwner, NULL, NULL, NULL, &psd))
+  {
+    return false;
+  }
+  bool fTrusted = IsWellKnownSid(psidOwner, WinLocalSystemSid) || IsWellKnownSid(psidOwner, WinBuiltinAdministratorsSid);
+  LocalFree(psd);
+  return fTrusted;
+}
+
+PLATFORM_RESULT PlatformOpenSharedSegment(
+  const wchar_t* pwzName,
+  size_t cb,
+  PLATFORM_SHARED_SEGMENT** ppSegment,
+  const void** ppvRead
+)
+{
+  *ppSegment = NULL;
+  *ppvRead = NULL;
+
+  // Global\ so that LogonUI in every session finds the same one.
+  WCHAR wszName[MAX_PATH];
+  if (FAILED(StringCchPrintfW(wszName, ARRAYSIZE(wszName), L"Global\\%s", pwzName)))
+  {
+    return PR_TOO_LARGE;
+  }
+
+  PSECURITY_DESCRIPTOR psd;
+  if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(SHARED_SEGMENT_SDDL, SDDL_REVISION_1, &psd, NULL))
+  {
+    return _PlatformResultFromWin32(GetLastError());
+  }
+  SECURITY_ATTRIBUTES sa = { sizeof(sa), psd, FALSE };
+  ULONGLONG ullSize = cb;
+  HANDLE hSection = CreateFileMappingW(INVALID_HANDLE_VALUE, &sa, PAGE_READWRITE,
+    static_cast<DWORD>(ullSize >> 32), static_cast<DWORD>(ullSize), wszName);
+  DWORD dwErr = GetLastError();
+  LocalFree(psd);
+  if (!hSection)
+  {
+    return _PlatformResultFromWin32(dwErr);
+  }
+  if (ERROR_ALREADY_EXISTS == dwErr && !_IsSectionOwnerTrusted(hSection))
+  {
+    CloseHandle(hSection);
+    return PR_ACCESS_DENIED;
+  }
+
+  PLATFORM_RESULT pr = PR_OK;
+  PLATFORM_SHARED_SEGMENT* pSegment = new (std::nothrow) PLATFORM_SHARED_SEGMENT;
+  const void* pvRead = pSegment ? MapViewOfFile(hSection, FILE_MAP_READ, 0, 0, cb) : NULL;
+  if (!pSegment)
+  {
+    pr = PR_OUT_OF_MEMORY;
+  }
+  else if (!pvRead)
+  {
+    pr = _PlatformResultFromWin32(GetLastError());
+  }
+
+  if (PR_OK == pr)
+  {
+    pSegment->hSection = hSection;
+    pSegment->cb = cb;
+    pSegment->pvRead = pvRead;
+    *ppSegment = pSegment;
+    *ppvRead = pvRead;
+  }
+  else
+  {
+    delete pSegment;
+    CloseHandle(hSection);
+  }
+  return pr;
+}
+
+PLATFORM_RESULT PlatformMapSharedSegmentForWrite(
+  PLATFORM_SHARED_SEGMENT* pSegment,
+  void** ppvWrite
+)
+{
+  *ppvWrite = MapViewOfFile(pSegment->hSection, FILE_MAP_WRITE, 0, 0, pSegment->cb);
+  return *ppvWrite ? PR_OK : _PlatformResultFromWin32(GetLastError());
+}
+
+void PlatformUnmapSharedSegment(PLATFORM_SHARED_SEGMENT* pSegment, void* pvWrite)
+{
+  UNREFERENCED_PARAMETER(pSegment);
+  UnmapViewOfFile(pvWrite);
+}
+
+void PlatformCloseSharedSegment(PLATFORM_SHARED_SEGMENT* pSegment)
+{
+  UnmapViewOfFile(pSegment->pvRead);
+  CloseHandle(pSegment->hSection);
+  delete pSegment;
+}
+
+// LogonUI is SYSTEM in every session, which is one logon as far as CryptProtectMemory is
+// concerned.
+PLATFORM_RESULT PlatformProtectMemory(void* pv, size_t cb)
+{
+  return CryptProtectMemory(pv, static_cast<DWORD>(cb), CRYPTPROTECTMEMORY_SAME_LOGON) ? PR_OK : _PlatformResultFromWin32(GetLastError());
+}
+
+PLATFORM_RESULT PlatformUnprotectMemory(void* pv, size_t cb)
+{
+  return CryptUnprotectMemory(pv, static_cast<DWORD>(cb), CRYPTPROTECTMEMORY_SAME_LOGON) ? PR_OK : _PlatformResultFromWin32(GetLastError());
+}
+
+PLATFORM_RESULT PlatformSha256(const void* pv, size_t cb, unsigned char* pbDigest)
+{
+  if (cb > MAXULONG)
+  {
+    return PR_TOO_LARGE;
+  }
+
+  // The pseudo-handle needs no provider opened, and BCryptHash no hash object, so nothing of
+  // ours is allocated on the way.  What BCrypt allocates for itself is its own business.
+  NTSTATUS status = BCryptHash(BCRYPT_SHA256_ALG_HANDLE, NULL, 0, static_cast<PUCHAR>(const_cast<void*>(pv)), (ULONG)cb,
+    pbDigest, PLATFORM_SHA256_SIZE);
+  return BCRYPT_SUCCESS(status) ? PR_OK : PR_IO_ERROR;
+}
@@ -0,0 +1,94 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+
+#include <atomic>
+#include <mutex>
+#include "ReportResultMessage.h"
+
+// Set once the catalog has been looked for; s_pCatalog is then &s_catalog, or NULL if it
+// could not be opened.  Lookups after the first read only s_fCatalogOpened and s_pCatalog.
+static std::mutex s_mutexCatalog;
+static std::atomic<bool> s_fCatalogOpened(false);
+static const MESSAGE_CATALOG* s_pCatalog = NULL;
+static MESSAGE_CATALOG s_catalog;
+
+const MESSAGE_CATALOG* ReportResultMessageCatalog(__in_opt HINSTANCE hinst)
+{
+  if (!s_fCatalogOpened.load(std::memory_order_acquire))
+  {
+    std::lock_guard<std::mutex> lock(s_mutexCatalog);
+    if (!s_fCatalogOpened.load(std::memory_order_relaxed))
+    {
+      // The mapping belongs to the module, not to the ReportResult that happens to open it.
+      ALLOC_UNCHARGED();
+      WCHAR wszPath[MAX_PATH];
+      DWORD cch = GetModuleFileNameW(hinst, wszPath, ARRAYSIZE(wszPath));
+      if (cch > 0 && cch < ARRAYSIZE(wszPath))
+      {
+        // Replace the module's file name with the catalog's.
+        DWORD ichName = cch;
+        while (ichName > 0 && wszPath[ichName - 1] != L'\\' && wszPath[ichName - 1] != L'/')
+        {
+          ichName--;
+        }
+        if (SUCCEEDED(StringCchCopyW(wszPath + ichName, ARRAYSIZE(wszPath) - ichName, MESSAGE_CATALOG_FILE_NAME)) &&
+          PR_OK == MessageCatalogOpen(wszPath, &s_catalog))
+        {
+          s_pCatalog = &s_catalog;
+        }
+      }
+      s_fCatalogOpened.store(true, std::memory_order_release);
+    }
+  }
+  return s_pCatalog;
+}
+
+void ReportResultMessageShutdown()
+{
+  std::lock_guard<std::mutex> lock(s_mutexCatalog);
+  if (s_pCatalog)
+  {
+    MessageCatalogClose(&s_catalog);
+    s_pCatalog = NULL;
+  }
+}
+
+HRESULT ReportResultMessageLoad(
+  __in_opt const MESSAGE_CATALOG* pCatalog,
+  __in LANGID langid,
+  __in NTSTATUS ntsStatus,
+  __in NTSTATUS ntsSubstatus,
+  __deref_out_opt PWSTR* ppwzMessage,
+  __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsi
+)
+{
+  *ppwzMessage = NULL;
+  *pcpsi = CPSI_NONE;
+
+  // The entry points straight into the mapped catalog; the only copy is the one LogonUI
+  // is handed.
+  MESSAGE_CATALOG_ENTRY entry;
+  HRESULT hr = S_FALSE;
+  if (pCatalog && MessageCatalogLookup(*pCatalog, (unsigned long)ntsStatus, (unsigned long)ntsSubstatus, langid, &entry))
+  {
+    PWSTR pwzMessage = (PWSTR)TrackedCoTaskMemAlloc((entry.cchText + 1) * sizeof(WCHAR));
+    if (pwzMessage)
+    {
+      MessageCatalogCopyText(entry, pwzMessage);
+      *ppwzMessage = pwzMessage;
+      *pcpsi = (CREDENTIAL_PROVIDER_STATUS_ICON)entry.mci;
+      hr = S_OK;
+    }
+    else
+    {
+      hr = E_OUTOFMEMORY;
+    }
+  }
+  return hr;
+}
@@ -0,0 +1,37 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// What ReportResult tells the user about a failed logon.  The messages, and which status
+// and substatus each is for, are in messages.txt, which the build compiles into the message
+// catalog next to the DLL (see MessageCatalog.h).  The catalog is mapped the first time a
+// logon fails and stays mapped until the DLL unloads.
+
+#pragma once
+
+#include <helpers.h>
+#include "MessageCatalog.h"
+
+// The catalog next to hinst's module (the executable's, for NULL), opened the first time
+// this is called.  Returns NULL if it is missing or damaged; it is not looked for again.
+const MESSAGE_CATALOG* ReportResultMessageCatalog(__in_opt HINSTANCE hinst);
+
+// Closes the catalog ReportResultMessageCatalog opened, when the DLL unloads.
+void ReportResultMessageShutdown();
+
+// Copies the message for ntsStatus and ntsSubstatus in langid (see MessageCatalogLookup
+// for the languages it falls back to) into a CoTaskMemAlloc'd string for LogonUI, and gives
+// the icon to show with it.  Returns S_FALSE if there is no message for the status or no
+// catalog; then, or on failure, *ppwzMessage is NULL and *pcpsi is CPSI_NONE.
+HRESULT ReportResultMessageLoad(
+  __in_opt const MESSAGE_CATALOG* pCatalog,
+  __in LANGID langid,
+  __in NTSTATUS ntsStatus,
+  __in NTSTATUS ntsSubstatus,
+  __deref_out_opt PWSTR* ppwzMessage,
+  __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsi
+);
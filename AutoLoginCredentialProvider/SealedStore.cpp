@@ -0,0 +1,240 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <new>
+#include <string.h>
+#include "SealedStore.h"
+
+static void _PutU32(unsigned char* pb, unsigned long ul)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    pb[i] = (unsigned char)(ul >> (8 * i));
+  }
+}
+
+static void _PutU64(unsigned char* pb, unsigned long long ull)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    pb[i] = (unsigned char)(ull >> (8 * i));
+  }
+}
+
+static unsigned long _GetU32(const unsigned char* pb)
+{
+  unsigned long ul = 0;
+  for (int i = 3; i >= 0; i--)
+  {
+    ul = (ul << 8) | pb[i];
+  }
+  return ul;
+}
+
+static unsigned long long _GetU64(const unsigned char* pb)
+{
+  unsigned long long ull = 0;
+  for (int i = 7; i >= 0; i--)
+  {
+    ull = (ull << 8) | pb[i];
+  }
+  return ull;
+}
+
+void SealedStoreEncodeHeader(const SEALED_STORE_HEADER& hdr, unsigned char* pb)
+{
+  _PutU32(pb, hdr.ulMagic);
+  _PutU32(pb + 4, hdr.ulVersion);
+  memcpy(pb + 8, hdr.rgbKeyId, SEALED_STORE_KEY_ID_SIZE);
+  _PutU32(pb + 24, hdr.cRecords);
+  _PutU32(pb + 28, 0);
+  _PutU64(pb + 32, hdr.ullIndexOffset);
+}
+
+void SealedStoreEncodeIndexEntry(const SEALED_STORE_INDEX_ENTRY& entry, unsigned char* pb)
+{
+  _PutU32(pb, entry.ulMachineHash);
+  _PutU32(pb + 4, entry.cbRecord);
+  _PutU64(pb + 8, entry.ullOffset);
+}
+
+void SealedStoreRecordAad(const unsigned char* pbKeyId, unsigned long ulMachineHash, unsigned char* pbAad)
+{
+  _PutU32(pbAad, SEALED_STORE_MAGIC);
+  _PutU32(pbAad + 4, SEALED_STORE_VERSION);
+  memcpy(pbAad + 8, pbKeyId, SEALED_STORE_KEY_ID_SIZE);
+  _PutU32(pbAad + 24, ulMachineHash);
+}
+
+static CREDENTIAL_STORE_RESULT _ReadIndexEntry(
+  PLATFORM_FILE* pFile,
+  const SEALED_STORE_HEADER& hdr,
+  unsigned long iEntry,
+  SEALED_STORE_INDEX_ENTRY* pEntry
+)
+{
+  unsigned char rgb[SEALED_STORE_INDEX_ENTRY_SIZE];
+  CREDENTIAL_STORE_RESULT csr = CredentialStoreResultFromPlatform(PlatformReadFileAt(pFile,
+    hdr.ullIndexOffset + (unsigned long long)iEntry * SEALED_STORE_INDEX_ENTRY_SIZE, rgb, sizeof(rgb)));
+  if (CSR_OK == csr)
+  {
+    pEntry->ulMachineHash = _GetU32(rgb);
+    pEntry->cbRecord = _GetU32(rgb + 4);
+    pEntry->ullOffset = _GetU64(rgb + 8);
+  }
+  return csr;
+}
+
+// Reads and decrypts one record, then parses it if it is for pwzMachine.
+static CREDENTIAL_STORE_RESULT _OpenRecord(
+  PLATFORM_FILE* pFile,
+  const SEALED_STORE_HEADER& hdr,
+  const SEALED_STORE_INDEX_ENTRY& entry,
+  const unsigned char* pbKey,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  UserCredentials* puc
+)
+{
+  if (entry.cbRecord <= SEALED_STORE_NONCE_SIZE + SEALED_STORE_TAG_SIZE || entry.cbRecord > SEALED_STORE_MAX_RECORD_SIZE)
+  {
+    return CSR_BAD_FORMAT;
+  }
+
+  CREDENTIAL_STORE_RESULT csr = CSR_OK;
+  std::vector<unsigned char> rgbRecord;
+  std::vector<unsigned char> rgbPlaintext;
+  try
+  {
+    rgbRecord.resize(entry.cbRecord);
+    rgbPlaintext.resize(entry.cbRecord - SEALED_STORE_NONCE_SIZE - SEALED_STORE_TAG_SIZE);
+  }
+  catch (const std::bad_alloc&)
+  {
+    csr = CSR_OUT_OF_MEMORY;
+  }
+
+  if (CSR_OK == csr)
+  {
+    csr = CredentialStoreResultFromPlatform(PlatformReadFileAt(pFile, entry.ullOffset, &rgbRecord[0], rgbRecord.size()));
+  }
+  if (CSR_OK == csr)
+  {
+    unsigned char rgbAad[SEALED_STORE_AAD_SIZE];
+    SealedStoreRecordAad(hdr.rgbKeyId, entry.ulMachineHash, rgbAad);
+    csr = CredentialStoreResultFromPlatform(PlatformAesGcmDecrypt(
+      pbKey, SEALED_STORE_KEY_SIZE,
+      &rgbRecord[0], SEALED_STORE_NONCE_SIZE,
+      rgbAad, sizeof(rgbAad),
+      &rgbRecord[SEALED_STORE_NONCE_SIZE], rgbPlaintext.size(),
+      &rgbRecord[SEALED_STORE_NONCE_SIZE + rgbPlaintext.size()], SEALED_STORE_TAG_SIZE,
+      &rgbPlaintext[0]));
+  }
+  if (CSR_OK == csr)
+  {
+    csr = CredentialStoreParseRecord(&rgbPlaintext[0], rgbPlaintext.size(), pwzMachine, cchMachine, puc);
+  }
+
+  if (!rgbPlaintext.empty())
+  {
+    PlatformSecureZero(&rgbPlaintext[0], rgbPlaintext.size());
+  }
+  return csr;
+}
+
+CREDENTIAL_STORE_RESULT SealedStoreLoad(
+  const wchar_t* pwzPath,
+  ISealedStoreKeyProvider* pKeys,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  UserCredentials* puc
+)
+{
+  PLATFORM_FILE* pFile;
+  CREDENTIAL_STORE_RESULT csr = CredentialStoreResultFromPlatform(PlatformOpenFile(pwzPath, &pFile));
+  if (CSR_OK != csr)
+  {
+    return csr;
+  }
+
+  SEALED_STORE_HEADER hdr;
+  unsigned char rgbHeader[SEALED_STORE_HEADER_SIZE];
+  csr = CredentialStoreResultFromPlatform(PlatformReadFileAt(pFile, 0, rgbHeader, sizeof(rgbHeader)));
+  if (CSR_OK == csr)
+  {
+    hdr.ulMagic = _GetU32(rgbHeader);
+    hdr.ulVersion = _GetU32(rgbHeader + 4);
+    memcpy(hdr.rgbKeyId, rgbHeader + 8, SEALED_STORE_KEY_ID_SIZE);
+    hdr.cRecords = _GetU32(rgbHeader + 24);
+    hdr.ullIndexOffset = _GetU64(rgbHeader + 32);
+    if (hdr.ulMagic != SEALED_STORE_MAGIC || hdr.ulVersion != SEALED_STORE_VERSION)
+    {
+      csr = CSR_BAD_FORMAT;
+    }
+  }
+
+  unsigned char rgbKey[SEALED_STORE_KEY_SIZE];
+  if (CSR_OK == csr)
+  {
+    csr = pKeys->GetKey(hdr.rgbKeyId, rgbKey);
+  }
+
+  if (CSR_OK == csr)
+  {
+    // Find the first index entry with our hash...
+    unsigned long ulHash = CredentialStoreMachineHash(pwzMachine, cchMachine);
+    unsigned long iLow = 0;
+    unsigned long iHigh = hdr.cRecords;
+    SEALED_STORE_INDEX_ENTRY entry;
+    while (CSR_OK == csr && iLow < iHigh)
+    {
+      unsigned long iMiddle = iLow + (iHigh - iLow) / 2;
+      csr = _ReadIndexEntry(pFile, hdr, iMiddle, &entry);
+      if (CSR_OK == csr && entry.ulMachineHash < ulHash)
+      {
+        iLow = iMiddle + 1;
+      }
+      else
+      {
+        iHigh = iMiddle;
+      }
+    }
+
+    // ...then try the records with that hash until one turns out to be ours.  There is
+    // almost always exactly one.
+    bool fFound = false;
+    for (unsigned long i = iLow; CSR_OK == csr && !fFound && i < hdr.cRecords; i++)
+    {
+      csr = _ReadIndexEntry(pFile, hdr, i, &entry);
+      if (CSR_OK == csr)
+      {
+        if (entry.ulMachineHash != ulHash)
+        {
+          break;
+        }
+
+        csr = _OpenRecord(pFile, hdr, entry, rgbKey, pwzMachine, cchMachine, puc);
+        fFound = (CSR_OK == csr);
+        if (CSR_NOT_FOUND == csr)
+        {
+          csr = CSR_OK;
+        }
+      }
+    }
+    if (CSR_OK == csr && !fFound)
+    {
+      csr = CSR_NOT_FOUND;
+    }
+  }
+
+  PlatformSecureZero(rgbKey, sizeof(rgbKey));
+  PlatformCloseFile(pFile);
+  return csr;
+}
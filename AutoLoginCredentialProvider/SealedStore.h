@@ -0,0 +1,97 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Sealed stores: credential stores encrypted at rest.  Like CredentialStore.cpp this is
+// platform-neutral code; the cipher comes from Platform.h and the key from whatever
+// ISealedStoreKeyProvider the caller passes in.
+//
+// A sealed store holds one or more records.  Each is the four UTF-8 lines of a sharded
+// store record (machine, domain, user, password) encrypted with AES-256-GCM under a key
+// the file names only by a 16-byte id.  The layout, with integers little-endian, is
+//
+//   header    SEALED_STORE_HEADER_SIZE bytes: magic, version, key id, record count, and
+//             the offset of the index
+//   records   each a nonce, the ciphertext and the tag
+//   index     one SEALED_STORE_INDEX_ENTRY_SIZE entry per record, sorted by machine hash:
+//             the hash, the record's size and the record's offset
+//
+// The index comes last so that a writer can stream the records out and sort the index once
+// it has them all.  A reader binary-searches the index a few bytes at a time and decrypts
+// only the record for its own machine, so logon does not get slower as the store grows.
+//
+// Each record is authenticated together with the magic, the version, the key id and its
+// machine hash (SealedStoreRecordAad), so it cannot be moved into another store or under
+// another hash unnoticed; the machine name inside it is checked as well.
+
+#pragma once
+
+#include "CredentialStore.h"
+
+#define SEALED_STORE_MAGIC 0x53534C41UL          // 'ALSS'
+#define SEALED_STORE_VERSION 1
+#define SEALED_STORE_KEY_ID_SIZE 16
+#define SEALED_STORE_KEY_SIZE 32                 // AES-256
+#define SEALED_STORE_NONCE_SIZE 12
+#define SEALED_STORE_TAG_SIZE 16
+#define SEALED_STORE_HEADER_SIZE 40
+#define SEALED_STORE_INDEX_ENTRY_SIZE 16
+#define SEALED_STORE_AAD_SIZE 28
+#define SEALED_STORE_MAX_RECORD_SIZE (SEALED_STORE_NONCE_SIZE + CREDENTIAL_STORE_MAX_SIZE + SEALED_STORE_TAG_SIZE)
+
+// A key as CredentialTool new-key writes it: the key id followed by the key.  Machines keep
+// it wrapped (see DpapiKeyProvider.h).
+#define SEALED_STORE_KEY_FILE_SIZE (SEALED_STORE_KEY_ID_SIZE + SEALED_STORE_KEY_SIZE)
+
+// The sealed counterpart of CREDENTIAL_SHARD_FILE_FORMAT.
+#define SEALED_SHARD_FILE_FORMAT L"shard-%05lu.sealed"
+
+struct SEALED_STORE_HEADER
+{
+  unsigned long ulMagic;
+  unsigned long ulVersion;
+  unsigned char rgbKeyId[SEALED_STORE_KEY_ID_SIZE];
+  unsigned long cRecords;
+  unsigned long long ullIndexOffset;
+};
+
+struct SEALED_STORE_INDEX_ENTRY
+{
+  unsigned long ulMachineHash;      // CredentialStoreMachineHash of the record's machine
+  unsigned long cbRecord;           // nonce, ciphertext and tag
+  unsigned long long ullOffset;
+};
+
+// Supplies the keys sealed stores are encrypted with, so that where keys are kept (DPAPI,
+// a TPM, a key service) is up to the caller.
+class ISealedStoreKeyProvider
+{
+public:
+  virtual ~ISealedStoreKeyProvider() {}
+
+  // Copies the SEALED_STORE_KEY_SIZE-byte key named by the SEALED_STORE_KEY_ID_SIZE-byte
+  // id at pbKeyId to pbKey.  Returns CSR_NOT_FOUND if the provider has no such key.
+  virtual CREDENTIAL_STORE_RESULT GetKey(const unsigned char* pbKeyId, unsigned char* pbKey) = 0;
+};
+
+// Serialize the header and index entries to the layout above, for writers.
+void SealedStoreEncodeHeader(const SEALED_STORE_HEADER& hdr, unsigned char* pb);
+void SealedStoreEncodeIndexEntry(const SEALED_STORE_INDEX_ENTRY& entry, unsigned char* pb);
+
+// Builds the SEALED_STORE_AAD_SIZE bytes of additional authenticated data for a record.
+void SealedStoreRecordAad(const unsigned char* pbKeyId, unsigned long ulMachineHash, unsigned char* pbAad);
+
+// Finds and decrypts the record for pwzMachine in the sealed store at pwzPath.  Returns
+// CSR_NOT_FOUND if the store has no record for it, and CSR_BAD_FORMAT if the file is not
+// a sealed store or the record fails authentication.
+CREDENTIAL_STORE_RESULT SealedStoreLoad(
+  const wchar_t* pwzPath,
+  ISealedStoreKeyProvider* pKeys,
+  const wchar_t* pwzMachine,
+  size_t cchMachine,
+  UserCredentials* puc
+);
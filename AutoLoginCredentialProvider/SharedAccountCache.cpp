@@ -0,0 +1,270 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The account segment shared between sessions; see SharedAccountCache.h.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <string.h>
+#include <vector>
+#include "SharedAccountCache.h"
+
+// The sequence is shared with other processes, and is only ever loaded through the
+// read-only view, so it has to be a plain lock-free word.
+static_assert(ATOMIC_LONG_LOCK_FREE == 2, "the sequence lock needs a lock-free unsigned long");
+
+// What the header says about the account.  Only worth anything between two equal, even
+// reads of the sequence.
+struct SHARED_ACCOUNT_FIELDS
+{
+  unsigned long cchDomain;
+  unsigned long cchUsername;
+  unsigned long cbProtected;                // 0 while nothing has been published
+  unsigned long ulReserved;
+  unsigned long long ullKey;
+  unsigned long long ullVersion;
+};
+
+// The start of the segment.  The domain and the user name follow, each NULL-terminated, and
+// then the cbProtected bytes of the protected block.
+struct SHARED_ACCOUNT_HEADER
+{
+  std::atomic<unsigned long> ulSequence;    // odd while a writer is part way through
+  unsigned long ulReserved;
+  SHARED_ACCOUNT_FIELDS fields;
+};
+
+// The start of the protected block, ahead of the password and its NULL.  Unprotecting with
+// another account's key yields garbage, which this catches.
+struct SHARED_ACCOUNT_SECRET
+{
+  unsigned long long ullKey;                // the header's, once unprotected
+  unsigned long cchPassword;
+  unsigned long ulReserved;
+};
+
+static_assert((CREDENTIAL_ACCOUNT_MAX_CCH + 1) * sizeof(wchar_t) * 3 + sizeof(SHARED_ACCOUNT_SECRET) + PLATFORM_PROTECT_BLOCK_SIZE +
+  sizeof(SHARED_ACCOUNT_HEADER) <= SHARED_ACCOUNT_SEGMENT_SIZE, "the segment must hold the longest account");
+
+// Opened by the first read or write and kept until SharedAccountCacheShutdown.  A segment
+// that could not be opened is not tried again.
+static std::mutex s_mutexSegment;
+static PLATFORM_SHARED_SEGMENT* s_pSegment = nullptr;
+static const unsigned char* s_pbRead = nullptr;
+static PLATFORM_RESULT s_prOpen = PR_OK;
+
+static PLATFORM_RESULT _OpenSegment(const unsigned char** ppbRead)
+{
+  std::lock_guard<std::mutex> lock(s_mutexSegment);
+  if (!s_pSegment && PR_OK == s_prOpen)
+  {
+    const void* pvRead;
+    s_prOpen = PlatformOpenSharedSegment(SHARED_ACCOUNT_SEGMENT_NAME, SHARED_ACCOUNT_SEGMENT_SIZE, &s_pSegment, &pvRead);
+    s_pbRead = static_cast<const unsigned char*>(pvRead);
+  }
+  *ppbRead = s_pbRead;
+  return s_prOpen;
+}
+
+static size_t _ProtectedSize(size_t cchPassword)
+{
+  size_t cb = sizeof(SHARED_ACCOUNT_SECRET) + (cchPassword + 1) * sizeof(wchar_t);
+  return (cb + PLATFORM_PROTECT_BLOCK_SIZE - 1) / PLATFORM_PROTECT_BLOCK_SIZE * PLATFORM_PROTECT_BLOCK_SIZE;
+}
+
+unsigned long long SharedAccountKeyAdd(unsigned long long ullKey, const void* pv, size_t cb)
+{
+  const unsigned char* pb = static_cast<const unsigned char*>(pv);
+  for (size_t i = 0; i < cb; i++)
+  {
+    ullKey = (ullKey ^ pb[i]) * 1099511628211ULL;
+  }
+  return ullKey;
+}
+
+// Copies the header's fields and everything they say follows into *prgb.  Returns false if
+// no copy came out consistent.
+static bool _ReadConsistent(const unsigned char* pbSegment, std::vector<unsigned char>* prgb)
+{
+  const SHARED_ACCOUNT_HEADER* pHeader = reinterpret_cast<const SHARED_ACCOUNT_HEADER*>(pbSegment);
+  for (int i = 0; i < SHARED_ACCOUNT_READ_TRIES; i++)
+  {
+    unsigned long ulBefore = pHeader->ulSequence.load(std::memory_order_acquire);
+    if (ulBefore & 1)
+    {
+      continue;
+    }
+
+    // A torn header can claim anything, so the sizes are checked before they are used.
+    SHARED_ACCOUNT_FIELDS fields;
+    memcpy(&fields, &pHeader->fields, sizeof(fields));
+    bool fSane = fields.cchDomain <= CREDENTIAL_ACCOUNT_MAX_CCH && fields.cchUsername <= CREDENTIAL_ACCOUNT_MAX_CCH &&
+      fields.cbProtected <= _ProtectedSize(CREDENTIAL_ACCOUNT_MAX_CCH);
+    if (fSane)
+    {
+      size_t cbData = (fields.cchDomain + 1 + fields.cchUsername + 1) * sizeof(wchar_t) + fields.cbProtected;
+      prgb->resize(sizeof(fields) + cbData);
+      memcpy(&(*prgb)[0], &fields, sizeof(fields));
+      memcpy(&(*prgb)[sizeof(fields)], pHeader + 1, cbData);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (fSane && pHeader->ulSequence.load(std::memory_order_relaxed) == ulBefore)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+CREDENTIAL_STORE_RESULT SharedAccountCacheRead(unsigned long long ullKey, UserCredentials* puc, unsigned long long* pullVersion)
+{
+  const unsigned char* pbSegment;
+  CREDENTIAL_STORE_RESULT csr = CredentialStoreResultFromPlatform(_OpenSegment(&pbSegment));
+  if (CSR_OK != csr)
+  {
+    return csr;
+  }
+
+  std::vector<unsigned char> rgb;
+  try
+  {
+    rgb.reserve(4096);
+    csr = _ReadConsistent(pbSegment, &rgb) ? CSR_OK : CSR_NOT_FOUND;
+  }
+  catch (const std::bad_alloc&)
+  {
+    csr = CSR_OUT_OF_MEMORY;
+  }
+
+  SHARED_ACCOUNT_FIELDS fields;
+  if (CSR_OK == csr)
+  {
+    memcpy(&fields, &rgb[0], sizeof(fields));
+    if (!fields.cbProtected || fields.ullKey != ullKey || fields.cbProtected % PLATFORM_PROTECT_BLOCK_SIZE)
+    {
+      csr = CSR_NOT_FOUND;
+    }
+  }
+
+  if (CSR_OK == csr)
+  {
+    const wchar_t* pwzDomain = reinterpret_cast<const wchar_t*>(&rgb[sizeof(fields)]);
+    const wchar_t* pwzUsername = pwzDomain + fields.cchDomain + 1;
+    unsigned char* pbProtected = &rgb[rgb.size() - fields.cbProtected];
+
+    SHARED_ACCOUNT_SECRET secret;
+    csr = CredentialStoreResultFromPlatform(PlatformUnprotectMemory(pbProtected, fields.cbProtected));
+    if (CSR_OK == csr)
+    {
+      memcpy(&secret, pbProtected, sizeof(secret));
+      if (secret.ullKey != ullKey || secret.cchPassword > CREDENTIAL_ACCOUNT_MAX_CCH ||
+        _ProtectedSize(secret.cchPassword) != fields.cbProtected)
+      {
+        csr = CSR_NOT_FOUND;
+      }
+    }
+
+    if (CSR_OK == csr)
+    {
+      try
+      {
+        puc->domain.assign(pwzDomain, fields.cchDomain);
+        puc->username.assign(pwzUsername, fields.cchUsername);
+        puc->password.assign(reinterpret_cast<const wchar_t*>(pbProtected + sizeof(secret)), secret.cchPassword);
+        if (pullVersion)
+        {
+          *pullVersion = fields.ullVersion;
+        }
+      }
+      catch (const std::bad_alloc&)
+      {
+        csr = CSR_OUT_OF_MEMORY;
+      }
+    }
+    PlatformSecureZero(pbProtected, fields.cbProtected);
+  }
+  return csr;
+}
+
+CREDENTIAL_STORE_RESULT SharedAccountCacheWrite(unsigned long long ullKey, const UserCredentials& uc)
+{
+  if (uc.domain.size() > CREDENTIAL_ACCOUNT_MAX_CCH || uc.username.size() > CREDENTIAL_ACCOUNT_MAX_CCH ||
+    uc.password.size() > CREDENTIAL_ACCOUNT_MAX_CCH)
+  {
+    return CSR_BAD_FORMAT;
+  }
+
+  // Protected before anything is mapped for writing, so the password is never in the
+  // segment in the clear.
+  size_t cbProtected = _ProtectedSize(uc.password.size());
+  unsigned char* pbProtected = new (std::nothrow) unsigned char[cbProtected];
+  if (!pbProtected)
+  {
+    return CSR_OUT_OF_MEMORY;
+  }
+  memset(pbProtected, 0, cbProtected);
+  SHARED_ACCOUNT_SECRET secret = { ullKey, static_cast<unsigned long>(uc.password.size()), 0 };
+  memcpy(pbProtected, &secret, sizeof(secret));
+  memcpy(pbProtected + sizeof(secret), uc.password.c_str(), uc.password.size() * sizeof(wchar_t));
+  CREDENTIAL_STORE_RESULT csr = CredentialStoreResultFromPlatform(PlatformProtectMemory(pbProtected, cbProtected));
+
+  const unsigned char* pbRead;
+  if (CSR_OK == csr)
+  {
+    csr = CredentialStoreResultFromPlatform(_OpenSegment(&pbRead));
+  }
+
+  void* pvWrite = nullptr;
+  if (CSR_OK == csr)
+  {
+    csr = CredentialStoreResultFromPlatform(PlatformMapSharedSegmentForWrite(s_pSegment, &pvWrite));
+  }
+
+  if (CSR_OK == csr)
+  {
+    SHARED_ACCOUNT_HEADER* pHeader = static_cast<SHARED_ACCOUNT_HEADER*>(pvWrite);
+    unsigned long ulSequence = pHeader->ulSequence.load();
+    if (!(ulSequence & 1) && pHeader->ulSequence.compare_exchange_strong(ulSequence, ulSequence + 1))
+    {
+      pHeader->fields.cchDomain = static_cast<unsigned long>(uc.domain.size());
+      pHeader->fields.cchUsername = static_cast<unsigned long>(uc.username.size());
+      pHeader->fields.cbProtected = static_cast<unsigned long>(cbProtected);
+      pHeader->fields.ullKey = ullKey;
+      pHeader->fields.ullVersion++;
+
+      wchar_t* pwzDomain = reinterpret_cast<wchar_t*>(pHeader + 1);
+      wchar_t* pwzUsername = pwzDomain + uc.domain.size() + 1;
+      memcpy(pwzDomain, uc.domain.c_str(), (uc.domain.size() + 1) * sizeof(wchar_t));
+      memcpy(pwzUsername, uc.username.c_str(), (uc.username.size() + 1) * sizeof(wchar_t));
+      memcpy(pwzUsername + uc.username.size() + 1, pbProtected, cbProtected);
+
+      pHeader->ulSequence.store(ulSequence + 2, std::memory_order_release);
+    }
+    PlatformUnmapSharedSegment(s_pSegment, pvWrite);
+  }
+
+  PlatformSecureZero(pbProtected, cbProtected);
+  delete[] pbProtected;
+  return csr;
+}
+
+void SharedAccountCacheShutdown()
+{
+  std::lock_guard<std::mutex> lock(s_mutexSegment);
+  if (s_pSegment)
+  {
+    PlatformCloseSharedSegment(s_pSegment);
+  }
+  s_pSegment = nullptr;
+  s_pbRead = nullptr;
+  s_prOpen = PR_OK;
+}
@@ -0,0 +1,73 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The account, loaded once and shared by every LogonUI on the machine.
+//
+// On a Remote Desktop host each session has its own LogonUI, and each would otherwise read,
+// decrypt and parse the store for itself.  Instead the first to load the account copies it
+// into a segment of shared memory (see PlatformOpenSharedSegment), with the password
+// protected by PlatformProtectMemory, and the others copy it out of their read-only views.
+//
+// The account is published under a key: a hash of everything loading it depends on, which
+// the caller works out without reading any of it (see SharedAccountKeyAdd).  A process
+// whose key differs, because a store or a setting changed, loads the account itself and
+// publishes it again.
+//
+// Updates are guarded by a sequence lock.  A writer makes the sequence odd, writes and makes
+// it even again; a reader copies everything out and keeps the copy only if the sequence was
+// even and unchanged throughout.  Readers never write to the segment and never wait on a
+// writer.  Two processes that try to publish at once do not wait on each other either: the
+// second simply doesn't, since the first is putting the same account there.  A writer that
+// dies part way leaves the sequence odd, after which every process loads the account itself
+// until the last one closes the segment.
+//
+// Platform-neutral: it depends only on the C++ standard library and Platform.h.
+
+#pragma once
+
+#include "AccountRecord.h"
+
+// The layout version is in the name, so processes loaded from different builds of the DLL
+// never read each other's segments.
+#define SHARED_ACCOUNT_SEGMENT_NAME L"AutoLoginCredentialProvider.Account.1"
+
+// Room for the longest account AccountRecord.h allows: 256 KB where wchar_t is UTF-16, as
+// on Windows, and twice that where it is UTF-32.
+#define SHARED_ACCOUNT_SEGMENT_SIZE (128 * 1024 * sizeof(wchar_t))
+
+// How many times a reader tries for a consistent copy before it loads the account itself.
+#define SHARED_ACCOUNT_READ_TRIES 16
+
+// The key before anything is added to it.
+#define SHARED_ACCOUNT_KEY_EMPTY 14695981039346656037ULL
+
+// What DllMeasureAccountLoad reports of one load, for LogonUISimulator -sessions.
+struct ACCOUNT_LOAD_SAMPLE
+{
+  unsigned long fShared;            // the account came out of the shared segment
+  unsigned long long ullVersion;    // of the segment then, or 0
+  unsigned long long ullNs;         // to load the account and publish its snapshot
+  unsigned long long cbCommitted;   // growth in the process's private commit meanwhile
+};
+
+// Adds cb bytes at pv to ullKey (64-bit FNV-1a).
+unsigned long long SharedAccountKeyAdd(unsigned long long ullKey, const void* pv, size_t cb);
+
+// Copies the account in the segment into *puc if it was published under ullKey, along with
+// the segment's version (how many times any process has published to it).  Returns
+// CSR_NOT_FOUND if the segment is empty, holds another key or another account's protection,
+// or was being written every time it was read, and CSR_ACCESS_DENIED or CSR_IO_ERROR if it
+// could not be opened.
+CREDENTIAL_STORE_RESULT SharedAccountCacheRead(unsigned long long ullKey, UserCredentials* puc, unsigned long long* pullVersion);
+
+// Publishes uc under ullKey, unless another process is publishing at the same moment.
+// Returns CSR_BAD_FORMAT if a string is longer than CREDENTIAL_ACCOUNT_MAX_CCH.
+CREDENTIAL_STORE_RESULT SharedAccountCacheWrite(unsigned long long ullKey, const UserCredentials& uc);
+
+// Closes this process's views of the segment; the DLL calls it as it is unloaded.
+void SharedAccountCacheShutdown();
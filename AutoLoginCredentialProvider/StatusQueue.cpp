@@ -0,0 +1,121 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The queue of status updates and their delivery; see StatusQueue.h.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <string.h>
+#include <wchar.h>
+#include "StatusQueue.h"
+
+static_assert(0 == (STATUS_QUEUE_CAPACITY & (STATUS_QUEUE_CAPACITY - 1)), "the capacity must be a power of two");
+
+CStatusQueue::CStatusQueue() :
+  _cTaken(0),
+  _cPosted(0),
+  _cDropped(0),
+  _fWakePending(false)
+{
+  memset(_rgbPad, 0, sizeof(_rgbPad));
+  memset(_rgUpdates, 0, sizeof(_rgUpdates));
+}
+
+bool CStatusQueue::Post(const wchar_t* pwz, size_t cch, bool* pfWake)
+{
+  *pfWake = false;
+
+  // Only this end writes _cPosted, and the consumer only ever moves _cTaken towards it.
+  unsigned long long cPosted = _cPosted.load(std::memory_order_relaxed);
+  if (cPosted - _cTaken.load(std::memory_order_acquire) >= STATUS_QUEUE_CAPACITY)
+  {
+    _cDropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  STATUS_UPDATE& update = _rgUpdates[cPosted & (STATUS_QUEUE_CAPACITY - 1)];
+  update.cch = static_cast<unsigned long>((cch < STATUS_TEXT_MAX_CCH) ? cch : STATUS_TEXT_MAX_CCH);
+  wmemcpy(update.wz, pwz, update.cch);
+  update.wz[update.cch] = L'\0';
+  update.ullSequence = cPosted + 1;
+  update.ullPostedNs = PlatformMonotonicNanoseconds();
+
+  _cPosted.store(cPosted + 1, std::memory_order_release);
+
+  // After the update is published, so the drain that clears the flag is sure to take it.
+  *pfWake = !_fWakePending.exchange(true);
+  return true;
+}
+
+unsigned long CStatusQueue::Drain(STATUS_UPDATE* pUpdate)
+{
+  // Cleared first, so a post that lands during the drain wakes the consumer again rather
+  // than waiting for the next one.  An exchange rather than a store: if it takes the flag a
+  // post set, it also sees that post's update below.
+  _fWakePending.exchange(false);
+
+  unsigned long long cTaken = _cTaken.load(std::memory_order_relaxed);
+  unsigned long long cPosted = _cPosted.load(std::memory_order_acquire);
+  if (cPosted == cTaken)
+  {
+    return 0;
+  }
+
+  // Only the latest is copied out; the slots before it are simply handed back.
+  const STATUS_UPDATE& update = _rgUpdates[(cPosted - 1) & (STATUS_QUEUE_CAPACITY - 1)];
+  pUpdate->ullSequence = update.ullSequence;
+  pUpdate->ullPostedNs = update.ullPostedNs;
+  pUpdate->cch = update.cch;
+  wmemcpy(pUpdate->wz, update.wz, update.cch + 1);
+
+  _cTaken.store(cPosted, std::memory_order_release);
+  return static_cast<unsigned long>(cPosted - cTaken);
+}
+
+CStatusDelivery::CStatusDelivery() :
+  _cSinks(0)
+{
+  memset(_rgpSinks, 0, sizeof(_rgpSinks));
+  memset(&_status, 0, sizeof(_status));
+}
+
+bool CStatusDelivery::AddSink(IStatusSink* pSink)
+{
+  if (_cSinks == STATUS_MAX_SINKS)
+  {
+    return false;
+  }
+  _rgpSinks[_cSinks++] = pSink;
+  return true;
+}
+
+void CStatusDelivery::RemoveSink(IStatusSink* pSink)
+{
+  for (size_t i = 0; i < _cSinks; i++)
+  {
+    if (_rgpSinks[i] == pSink)
+    {
+      _rgpSinks[i] = _rgpSinks[--_cSinks];
+      _rgpSinks[_cSinks] = nullptr;
+      break;
+    }
+  }
+}
+
+unsigned long CStatusDelivery::Deliver(CStatusQueue* pQueue)
+{
+  unsigned long cTaken = pQueue->Drain(&_status);
+  if (cTaken)
+  {
+    for (size_t i = 0; i < _cSinks; i++)
+    {
+      _rgpSinks[i]->OnStatusChanged(_status);
+    }
+  }
+  return cTaken;
+}
@@ -0,0 +1,125 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Status text for the tile, posted by background work and taken by LogonUI's thread.
+//
+// LogonUI only lets a tile change its fields from the thread it calls the provider on, so
+// work running on the pool can't update the status field itself.  It posts the text here
+// instead and, when Post says to, wakes LogonUI's thread, which drains the queue and hands
+// the latest update to every tile (see CStatusDelivery and CTileStatusChannel).  The status
+// field only ever shows one line, so a drain keeps just the latest update and skips the rest;
+// nothing is lost that the user would have had time to read.  Only the first post after a
+// drain asks for a wake-up, so however many updates are posted before LogonUI's thread gets
+// round to it, it is woken once.
+//
+// There is exactly one producer and one consumer.  Each owns its end of a fixed ring and
+// publishes it with a release store, so neither ever waits on the other or takes a lock, and
+// posting allocates nothing.  A full ring refuses the post: the consumer drains it on every
+// wake-up, so a full ring means LogonUI isn't listening.
+//
+// Platform-neutral: it depends only on the C++ standard library and Platform.h.
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include "Platform.h"
+
+// Updates the ring holds between drains; a power of two.
+#define STATUS_QUEUE_CAPACITY 16
+
+// Longer text is cut short.  The status is one line under the user name.
+#define STATUS_TEXT_MAX_CCH 127
+
+// The most sinks a CStatusDelivery hands updates to: one per tile.
+#define STATUS_MAX_SINKS 4
+
+struct STATUS_UPDATE
+{
+  unsigned long long ullSequence;   // 1 for the first posted, counting up
+  unsigned long long ullPostedNs;   // PlatformMonotonicNanoseconds when it was posted
+  unsigned long cch;
+  wchar_t wz[STATUS_TEXT_MAX_CCH + 1];
+};
+
+class CStatusQueue
+{
+public:
+  CStatusQueue();
+
+  // From the producer only.  Copies the cch characters at pwz, or the first
+  // STATUS_TEXT_MAX_CCH of them, into the ring.  Returns false if it was full.  *pfWake is
+  // set if the producer is to wake the consumer: the update was taken and no wake-up is
+  // pending since the last drain.
+  bool Post(const wchar_t* pwz, size_t cch, bool* pfWake);
+
+  // From the consumer only.  Takes everything posted so far and copies the latest into
+  // *pUpdate.  Returns how many it took, 0 leaving *pUpdate as it was.
+  unsigned long Drain(STATUS_UPDATE* pUpdate);
+
+  // Posts refused because the ring was full.  Either end may ask.
+  unsigned long long DroppedCount() const
+  {
+    return _cDropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  CStatusQueue(const CStatusQueue&);
+  CStatusQueue& operator=(const CStatusQueue&);
+
+  // Counts of updates ever taken and ever posted; the slot of each is its count modulo the
+  // capacity.  Kept a cache line apart, so the two ends don't slow each other down.  (Not
+  // with alignas, which heap allocations don't honour before C++17.)
+  std::atomic<unsigned long long> _cTaken;
+  unsigned char _rgbPad[64];
+  std::atomic<unsigned long long> _cPosted;
+  std::atomic<unsigned long long> _cDropped;
+  std::atomic<bool> _fWakePending;
+  STATUS_UPDATE _rgUpdates[STATUS_QUEUE_CAPACITY];
+};
+
+// Where the consumer delivers updates to: a tile, which passes it on to LogonUI.
+class IStatusSink
+{
+public:
+  virtual ~IStatusSink() {}
+
+  // On the consumer's thread.  update is the delivery's, and only valid for the call.
+  virtual void OnStatusChanged(const STATUS_UPDATE& update) = 0;
+};
+
+// The consumer's end: the sinks that show the status, and the status they show.  Used only on
+// the consumer's thread, so it takes no locks.  Sinks are not held; each removes itself
+// before it goes away.
+class CStatusDelivery
+{
+public:
+  CStatusDelivery();
+
+  // Returns false if there are STATUS_MAX_SINKS already.
+  bool AddSink(IStatusSink* pSink);
+  void RemoveSink(IStatusSink* pSink);
+
+  // Drains pQueue and, if anything had been posted, makes the latest the status and hands it
+  // to every sink.  Returns how many updates it took.
+  unsigned long Deliver(CStatusQueue* pQueue);
+
+  // The status as of the last delivery; empty before the first.
+  const STATUS_UPDATE& Status() const
+  {
+    return _status;
+  }
+
+private:
+  CStatusDelivery(const CStatusDelivery&);
+  CStatusDelivery& operator=(const CStatusDelivery&);
+
+  IStatusSink*  _rgpSinks[STATUS_MAX_SINKS];
+  size_t        _cSinks;
+  STATUS_UPDATE _status;
+};
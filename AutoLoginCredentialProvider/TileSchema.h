@@ -0,0 +1,311 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The layouts a tile can have.  Each is a schema: a struct whose Fields() lists every field
+// of the tile, in field ID order, with its type, label, states and where its value comes
+// from.  AutoLoginCredential is instantiated once per schema, so the tables LogonUI reads
+// while it paints a tile, and the indexes of the fields the credential treats specially,
+// are all worked out at compile time, and a schema that breaks one of the rules the
+// credential relies on fails to compile.
+//
+// To add a layout, add a schema here, a TILE_LAYOUT value for it, and its entry in the
+// provider's s_rgTileLayouts.
+
+#pragma once
+#include <helpers.h>
+#include <array>
+#include <utility>
+
+// The values of the TileLayout setting.
+enum TILE_LAYOUT
+{
+  TL_USERNAME = 0,          // USERNAME_TILE_SCHEMA; the default
+  TL_USERNAME_DOMAIN = 1,   // USERNAME_DOMAIN_TILE_SCHEMA
+  TL_PASSWORD = 2,          // PASSWORD_TILE_SCHEMA
+  TL_NUM_LAYOUTS = 3,
+};
+
+// What cTiles credentials of one layout cost while they are alive; see
+// DllGetTileFootprint.
+struct TILE_FOOTPRINT
+{
+  ULONGLONG cbTiles;        // what the credentials own: the objects and their heap blocks
+  ULONGLONG cbCommitted;    // how much the process's private commit grew
+};
+
+// Where the string value of a field comes from.
+enum FIELD_VALUE
+{
+  FV_NONE,        // the field has no string (the tile image)
+  FV_STATIC,      // the fsStatic of its schema entry
+  FV_USERNAME,    // the account name from the credential store
+  FV_DOMAIN,      // the account's domain from the credential store
+  FV_PASSWORD,    // typed into the tile, and logged on with in place of the stored password
+  FV_STATUS,      // what background work has to say; see TileStatus.h
+};
+
+// A string value for a field along with its length in characters (not counting the NULL
+// terminator), so that it never has to be re-measured when LogonUI asks for it.
+struct FIELD_STRING
+{
+  PCWSTR pwz;
+  size_t cch;
+};
+
+#define FIELD_STRING_LITERAL(s) { s, ARRAYSIZE(s) - 1 }
+#define FIELD_STRING_NONE { NULL, 0 }
+
+// The first value indicates when the tile is displayed (selected, not selected)
+// the second indicates things like whether the field is enabled, whether it has key focus, etc.
+struct FIELD_STATE_PAIR
+{
+  CREDENTIAL_PROVIDER_FIELD_STATE cpfs;
+  CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE cpfis;
+};
+
+// Everything we know about one field of the tile, in one place.
+// The first member is the index of the field.
+// The second is the type of the field.
+// The third is the name of the field (and its length), NOT the value which will appear in the field.
+// The next two are the field state pair: whether the field is displayed in the selected
+// tile, the deselected tile, or both, and its interactive state.
+// The last two say where the value of the field comes from, and hold it if it never changes.
+struct FIELD_SCHEMA_ENTRY
+{
+  DWORD                                       dwFieldID;
+  CREDENTIAL_PROVIDER_FIELD_TYPE              cpft;
+  PCWSTR                                      pwzLabel;
+  size_t                                      cchLabel;
+  CREDENTIAL_PROVIDER_FIELD_STATE             cpfs;
+  CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE cpfis;
+  FIELD_VALUE                                 fv;
+  FIELD_STRING                                fsStatic;
+};
+
+#define FIELD_LABEL(s) s, ARRAYSIZE(s) - 1
+
+// Image, account name, status and a submit button: the tile logs straight on with the
+// stored password.
+struct USERNAME_TILE_SCHEMA
+{
+  enum FIELD_ID
+  {
+    FI_TILEIMAGE = 0,
+    FI_USERNAME = 1,
+    FI_STATUS = 2,
+    FI_SUBMIT_BUTTON = 3,
+    FI_NUM_FIELDS = 4,  // Note: if new fields are added, keep NUM_FIELDS last.  This is used as a count of the number of fields
+  };
+
+  static constexpr std::array<FIELD_SCHEMA_ENTRY, FI_NUM_FIELDS> Fields()
+  {
+    return {{
+        { FI_TILEIMAGE, CPFT_TILE_IMAGE, FIELD_LABEL(L"Image"), CPFS_DISPLAY_IN_BOTH, CPFIS_NONE, FV_NONE, FIELD_STRING_NONE },
+        { FI_USERNAME, CPFT_LARGE_TEXT, FIELD_LABEL(L"Username"), CPFS_DISPLAY_IN_BOTH, CPFIS_NONE, FV_USERNAME, FIELD_STRING_NONE },
+        { FI_STATUS, CPFT_SMALL_TEXT, FIELD_LABEL(L"Status"), CPFS_DISPLAY_IN_SELECTED_TILE, CPFIS_NONE, FV_STATUS, FIELD_STRING_NONE },
+        { FI_SUBMIT_BUTTON, CPFT_SUBMIT_BUTTON, FIELD_LABEL(L"Submit"), CPFS_DISPLAY_IN_SELECTED_TILE, CPFIS_NONE, FV_STATIC, FIELD_STRING_LITERAL(L"Submit") },
+    }};
+  }
+};
+
+// As USERNAME_TILE_SCHEMA, with the account's domain under its name, for machines whose
+// accounts are not all in one domain.
+struct USERNAME_DOMAIN_TILE_SCHEMA
+{
+  enum FIELD_ID
+  {
+    FI_TILEIMAGE = 0,
+    FI_USERNAME = 1,
+    FI_DOMAIN = 2,
+    FI_STATUS = 3,
+    FI_SUBMIT_BUTTON = 4,
+    FI_NUM_FIELDS = 5,
+  };
+
+  static constexpr std::array<FIELD_SCHEMA_ENTRY, FI_NUM_FIELDS> Fields()
+  {
+    return {{
+        { FI_TILEIMAGE, CPFT_TILE_IMAGE, FIELD_LABEL(L"Image"), CPFS_DISPLAY_IN_BOTH, CPFIS_NONE, FV_NONE, FIELD_STRING_NONE },
+        { FI_USERNAME, CPFT_LARGE_TEXT, FIELD_LABEL(L"Username"), CPFS_DISPLAY_IN_BOTH, CPFIS_NONE, FV_USERNAME, FIELD_STRING_NONE },
+        { FI_DOMAIN, CPFT_SMALL_TEXT, FIELD_LABEL(L"Domain"), CPFS_DISPLAY_IN_BOTH, CPFIS_NONE, FV_DOMAIN, FIELD_STRING_NONE },
+        { FI_STATUS, CPFT_SMALL_TEXT, FIELD_LABEL(L"Status"), CPFS_DISPLAY_IN_SELECTED_TILE, CPFIS_NONE, FV_STATUS, FIELD_STRING_NONE },
+        { FI_SUBMIT_BUTTON, CPFT_SUBMIT_BUTTON, FIELD_LABEL(L"Submit"), CPFS_DISPLAY_IN_SELECTED_TILE, CPFIS_NONE, FV_STATIC, FIELD_STRING_LITERAL(L"Submit") },
+    }};
+  }
+};
+
+// The stored account, but the password is typed: the store names the account and the user
+// proves they may use it.
+struct PASSWORD_TILE_SCHEMA
+{
+  enum FIELD_ID
+  {
+    FI_TILEIMAGE = 0,
+    FI_USERNAME = 1,
+    FI_PASSWORD = 2,
+    FI_STATUS = 3,
+    FI_SUBMIT_BUTTON = 4,
+    FI_NUM_FIELDS = 5,
+  };
+
+  static constexpr std::array<FIELD_SCHEMA_ENTRY, FI_NUM_FIELDS> Fields()
+  {
+    return {{
+        { FI_TILEIMAGE, CPFT_TILE_IMAGE, FIELD_LABEL(L"Image"), CPFS_DISPLAY_IN_BOTH, CPFIS_NONE, FV_NONE, FIELD_STRING_NONE },
+        { FI_USERNAME, CPFT_LARGE_TEXT, FIELD_LABEL(L"Username"), CPFS_DISPLAY_IN_BOTH, CPFIS_NONE, FV_USERNAME, FIELD_STRING_NONE },
+        { FI_PASSWORD, CPFT_PASSWORD_TEXT, FIELD_LABEL(L"Password"), CPFS_DISPLAY_IN_SELECTED_TILE, CPFIS_FOCUSED, FV_PASSWORD, FIELD_STRING_NONE },
+        { FI_STATUS, CPFT_SMALL_TEXT, FIELD_LABEL(L"Status"), CPFS_DISPLAY_IN_SELECTED_TILE, CPFIS_NONE, FV_STATUS, FIELD_STRING_NONE },
+        { FI_SUBMIT_BUTTON, CPFT_SUBMIT_BUTTON, FIELD_LABEL(L"Submit"), CPFS_DISPLAY_IN_SELECTED_TILE, CPFIS_NONE, FV_STATIC, FIELD_STRING_LITERAL(L"Submit") },
+    }};
+  }
+};
+
+#define FIELD_NOT_PRESENT ((DWORD)-1)
+
+// Returns the index of the first field of rgfse of type cpft, or FIELD_NOT_PRESENT.
+template <size_t cFields>
+constexpr DWORD FieldSchemaFindType(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse, CREDENTIAL_PROVIDER_FIELD_TYPE cpft)
+{
+  for (size_t i = 0; i < cFields; i++)
+  {
+    if (rgfse[i].cpft == cpft)
+    {
+      return static_cast<DWORD>(i);
+    }
+  }
+  return FIELD_NOT_PRESENT;
+}
+
+// Returns the index of the first field of rgfse whose value comes from fv, or FIELD_NOT_PRESENT.
+template <size_t cFields>
+constexpr DWORD FieldSchemaFindValue(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse, FIELD_VALUE fv)
+{
+  for (size_t i = 0; i < cFields; i++)
+  {
+    if (rgfse[i].fv == fv)
+    {
+      return static_cast<DWORD>(i);
+    }
+  }
+  return FIELD_NOT_PRESENT;
+}
+
+template <size_t cFields>
+constexpr size_t FieldSchemaCountType(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse, CREDENTIAL_PROVIDER_FIELD_TYPE cpft)
+{
+  size_t c = 0;
+  for (size_t i = 0; i < cFields; i++)
+  {
+    c += (rgfse[i].cpft == cpft) ? 1 : 0;
+  }
+  return c;
+}
+
+template <size_t cFields>
+constexpr size_t FieldSchemaCountValue(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse, FIELD_VALUE fv)
+{
+  size_t c = 0;
+  for (size_t i = 0; i < cFields; i++)
+  {
+    c += (rgfse[i].fv == fv) ? 1 : 0;
+  }
+  return c;
+}
+
+// Returns true if every entry of the schema sits at the index named by its field ID.
+template <size_t cFields>
+constexpr bool FieldSchemaIsInOrder(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse)
+{
+  for (size_t i = 0; i < cFields; i++)
+  {
+    if (rgfse[i].dwFieldID != i)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if the value of every field suits its type: strings from the store or the
+// status only in text fields, a typed password only in a password field, a static string in
+// every field that has one and in no other.
+template <size_t cFields>
+constexpr bool FieldSchemaValuesFitTypes(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse)
+{
+  for (size_t i = 0; i < cFields; i++)
+  {
+    const FIELD_SCHEMA_ENTRY& fse = rgfse[i];
+    bool fText = CPFT_LARGE_TEXT == fse.cpft || CPFT_SMALL_TEXT == fse.cpft;
+    bool fFits =
+      (FV_NONE == fse.fv) ? CPFT_TILE_IMAGE == fse.cpft :
+      (FV_STATIC == fse.fv) ? NULL != fse.fsStatic.pwz :
+      (FV_PASSWORD == fse.fv) ? CPFT_PASSWORD_TEXT == fse.cpft :
+      fText;
+    if (!fFits || (FV_STATIC != fse.fv && NULL != fse.fsStatic.pwz))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns a bit for each field LogonUI may set the value of.
+template <size_t cFields>
+constexpr DWORD FieldSchemaEditableMask(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse)
+{
+  DWORD dwMask = 0;
+  for (size_t i = 0; i < cFields; i++)
+  {
+    if (CPFT_EDIT_TEXT == rgfse[i].cpft || CPFT_PASSWORD_TEXT == rgfse[i].cpft)
+    {
+      dwMask |= 1UL << i;
+    }
+  }
+  return dwMask;
+}
+
+// The number of fields LogonUI may set the value of.
+template <size_t cFields>
+constexpr size_t FieldSchemaCountEditable(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse)
+{
+  return FieldSchemaCountType(rgfse, CPFT_EDIT_TEXT) + FieldSchemaCountType(rgfse, CPFT_PASSWORD_TEXT);
+}
+
+// The index of field iField among the editable fields, or FIELD_NOT_PRESENT if it is not one.
+template <size_t cFields>
+constexpr DWORD FieldSchemaEditSlot(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse, size_t iField)
+{
+  DWORD dwMask = FieldSchemaEditableMask(rgfse);
+  DWORD iSlot = 0;
+  for (size_t i = 0; i < iField; i++)
+  {
+    if (dwMask & (1UL << i))
+    {
+      iSlot++;
+    }
+  }
+  return (dwMask & (1UL << iField)) ? iSlot : FIELD_NOT_PRESENT;
+}
+
+template <size_t cFields, size_t... i>
+constexpr std::array<DWORD, cFields> MakeFieldEditSlots(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse, std::index_sequence<i...>)
+{
+  return {{ FieldSchemaEditSlot(rgfse, i)... }};
+}
+
+template <size_t cFields, size_t... i>
+constexpr std::array<FIELD_STATE_PAIR, cFields> MakeFieldStatePairs(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse, std::index_sequence<i...>)
+{
+  return {{ { rgfse[i].cpfs, rgfse[i].cpfis }... }};
+}
+
+template <size_t cFields, size_t... i>
+constexpr std::array<CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR, cFields> MakeFieldDescriptors(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse, std::index_sequence<i...>)
+{
+  return {{ { rgfse[i].dwFieldID, rgfse[i].cpft, const_cast<PWSTR>(rgfse[i].pwzLabel) }... }};
+}
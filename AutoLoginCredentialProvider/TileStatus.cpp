@@ -0,0 +1,199 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+
+#include "TileStatus.h"
+#include "AutoLoginCredential.h"
+
+#define TILE_STATUS_WINDOW_CLASS L"AutoLoginCredentialProvider.TileStatus"
+#define WM_TILE_STATUS (WM_APP + 1)
+
+CTileStatusChannel::CTileStatusChannel() :
+  _cRef(1),
+  _hwnd(NULL),
+  _fChecking(FALSE)
+{
+  InitializeSRWLock(&_srwlWindow);
+}
+
+// The provider closes the channel before it lets it go, and a window can only be destroyed
+// on its own thread, so there is none left to destroy here.
+CTileStatusChannel::~CTileStatusChannel()
+{
+}
+
+// The class is registered by whichever provider gets here first and stays registered until
+// the last one closes.  Without a window the tiles just never show a status.
+HRESULT CTileStatusChannel::CreateInstance(__deref_out CTileStatusChannel** ppChannel)
+{
+  CTileStatusChannel* pChannel = new CTileStatusChannel();
+  HRESULT hr = pChannel ? S_OK : E_OUTOFMEMORY;
+  if (SUCCEEDED(hr))
+  {
+    WNDCLASSEXW wc = { sizeof(wc) };
+    wc.lpfnWndProc = _WndProc;
+    wc.hInstance = HINST_THISDLL;
+    wc.lpszClassName = TILE_STATUS_WINDOW_CLASS;
+    if (!RegisterClassExW(&wc) && ERROR_CLASS_ALREADY_EXISTS != GetLastError())
+    {
+      hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+  }
+  if (SUCCEEDED(hr))
+  {
+    pChannel->_hwnd = CreateWindowExW(0, TILE_STATUS_WINDOW_CLASS, NULL, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, HINST_THISDLL, NULL);
+    hr = pChannel->_hwnd ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  }
+  if (SUCCEEDED(hr))
+  {
+    SetWindowLongPtrW(pChannel->_hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(pChannel));
+  }
+  else if (pChannel)
+  {
+    pChannel->Release();
+    pChannel = NULL;
+  }
+
+  *ppChannel = pChannel;
+  return hr;
+}
+
+// Once this returns, the pool never posts to the window again.
+void CTileStatusChannel::Close()
+{
+  AcquireSRWLockExclusive(&_srwlWindow);
+  HWND hwnd = _hwnd;
+  _hwnd = NULL;
+  ReleaseSRWLockExclusive(&_srwlWindow);
+
+  if (hwnd)
+  {
+    SetWindowLongPtrW(hwnd, GWLP_USERDATA, 0);
+    DestroyWindow(hwnd);
+
+    // Fails while another provider's window is still open, which is what is wanted.
+    UnregisterClassW(TILE_STATUS_WINDOW_CLASS, HINST_THISDLL);
+  }
+}
+
+void CTileStatusChannel::AddTile(__in IStatusSink* pTile)
+{
+  _delivery.AddSink(pTile);
+}
+
+void CTileStatusChannel::RemoveTile(__in IStatusSink* pTile)
+{
+  _delivery.RemoveSink(pTile);
+}
+
+// The item holds a reference on the channel until it has run.  One canceled before it
+// started would leak it, but nothing cancels these: the pool is only ever closed once it is
+// idle (see DllCanUnloadNow).
+HRESULT CTileStatusChannel::StartAccountCheck()
+{
+  if (InterlockedCompareExchange(&_fChecking, TRUE, FALSE))
+  {
+    return S_FALSE;
+  }
+
+  AddRef();
+  PLATFORM_RESULT pr = ThreadPoolSubmit(_CheckAccount, this, WP_NORMAL, NULL, NULL);
+  HRESULT hr = (PR_OK == pr) ? S_OK : (PR_OUT_OF_MEMORY == pr) ? E_OUTOFMEMORY : E_FAIL;
+  if (FAILED(hr))
+  {
+    InterlockedExchange(&_fChecking, FALSE);
+    Release();
+  }
+  return hr;
+}
+
+// If the account has changed since it was loaded, says on the tile that it is being loaded,
+// loads it (from the segment shared between sessions, unless another session has not got to
+// it yet) and clears the status, or says the tile will log on with the account it already
+// has.  Most selections find nothing changed and post nothing.  The check can't be stopped
+// half way, so the token is not looked at.
+long CTileStatusChannel::_CheckAccount(
+  __in void* pvContext,
+  __in const CCancellationToken& rct,
+  __out uintptr_t* pulpResult
+)
+{
+  TRACE_FUNCTION();
+  UNREFERENCED_PARAMETER(rct);
+  UNREFERENCED_PARAMETER(pulpResult);
+  CTileStatusChannel* pChannel = static_cast<CTileStatusChannel*>(pvContext);
+
+  HRESULT hr = S_FALSE;
+  if (AutoLoginCredentialBase::HasAccountChanged())
+  {
+    pChannel->_PostString(IDS_STATUS_LOADING_ACCOUNT);
+
+    BOOL fShared;
+    ULONGLONG ullVersion;
+    hr = AutoLoginCredentialBase::LoadAccount(TRUE, &fShared, &ullVersion);
+    pChannel->_PostString(SUCCEEDED(hr) ? 0 : IDS_STATUS_ACCOUNT_UNAVAILABLE);
+  }
+
+  InterlockedExchange(&pChannel->_fChecking, FALSE);
+  pChannel->Release();
+  return hr;
+}
+
+void CTileStatusChannel::_PostString(__in UINT ids)
+{
+  // With a zero-length buffer LoadString hands back a read-only pointer straight into the
+  // string table, as in ReportResult.
+  PCWSTR pwz = L"";
+  int cch = ids ? LoadStringW(HINST_THISDLL, ids, (PWSTR)&pwz, 0) : 0;
+  if (cch <= 0)
+  {
+    pwz = L"";
+    cch = 0;
+  }
+
+  // Only the post that finds no wake-up pending posts a message; the rest ride along with it.
+  bool fWake;
+  if (_queue.Post(pwz, cch, &fWake) && fWake)
+  {
+    AcquireSRWLockShared(&_srwlWindow);
+    if (_hwnd)
+    {
+      PostMessageW(_hwnd, WM_TILE_STATUS, 0, 0);
+    }
+    ReleaseSRWLockShared(&_srwlWindow);
+  }
+}
+
+void CTileStatusChannel::_Deliver()
+{
+  TRACE_FUNCTION();
+  ALLOC_BUDGET(0, 0);
+  if (_delivery.Deliver(&_queue) && g_fLatencyEnabled)
+  {
+    LatencyRecordNanoseconds(LP_STATUS_DELIVERY, PlatformMonotonicNanoseconds() - _delivery.Status().ullPostedNs);
+  }
+}
+
+LRESULT CALLBACK CTileStatusChannel::_WndProc(
+  __in HWND hwnd,
+  __in UINT uMsg,
+  __in WPARAM wParam,
+  __in LPARAM lParam
+)
+{
+  if (WM_TILE_STATUS == uMsg)
+  {
+    CTileStatusChannel* pChannel = reinterpret_cast<CTileStatusChannel*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    if (pChannel)
+    {
+      pChannel->_Deliver();
+    }
+    return 0;
+  }
+  return DefWindowProcW(hwnd, uMsg, wParam, lParam);
+}
@@ -0,0 +1,98 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// How work on the thread pool gets status text onto the tiles.
+//
+// Each provider has one CTileStatusChannel, which its tiles share.  The channel owns a
+// message-only window, made on LogonUI's thread as the provider is.  Work posts text into
+// the channel's CStatusQueue and, when the queue says nobody has been woken since the last
+// drain, posts the window a message.  LogonUI's thread pumps messages, so the window handles
+// it there: it drains the queue and has each tile pass the latest update on through its own
+// ICredentialProviderCredentialEvents::SetFieldString (see CStatusDelivery).  However many
+// updates are posted before LogonUI's thread gets round to it, the tiles are updated once.
+// Nothing here goes through ICredentialProviderEvents, so LogonUI never enumerates the tiles
+// again on account of a status.  The tiles show the channel's status rather than a copy of
+// their own, so it costs a tile nothing but the pointer.
+//
+// The only work that posts today is the check of the account a tile starts when it is
+// selected.  It loads the account again only if a store, a key, a setting or (with host
+// rules) the minute has changed since it was last loaded, so that a rotation since LogonUI
+// started is the one logged on with, and only then says so on the tile.  Only one check runs
+// at a time, which keeps the queue to the single producer it allows.
+
+#pragma once
+
+#include <credentialprovider.h>
+#include <windows.h>
+#include "StatusQueue.h"
+#include "ThreadPool.h"
+
+class CTileStatusChannel
+{
+public:
+  // From LogonUI's thread, which the channel's window belongs to.
+  static HRESULT CreateInstance(__deref_out CTileStatusChannel** ppChannel);
+
+  ULONG AddRef()
+  {
+    return InterlockedIncrement(&_cRef);
+  }
+
+  ULONG Release()
+  {
+    LONG cRef = InterlockedDecrement(&_cRef);
+    if (!cRef)
+    {
+      delete this;
+    }
+    return cRef;
+  }
+
+  // Destroys the window, after which nothing posted is delivered.  From the provider as it
+  // goes away, on LogonUI's thread; a check still running keeps the rest of the channel.
+  void Close();
+
+  // A tile shows the status from when it is added until it removes itself.  From LogonUI's
+  // thread.
+  void AddTile(__in IStatusSink* pTile);
+  void RemoveTile(__in IStatusSink* pTile);
+
+  // Starts checking the account on the pool, unless a check is already running.  From
+  // LogonUI's thread.
+  HRESULT StartAccountCheck();
+
+  // The status as of the last delivery; empty before the first.  From LogonUI's thread.
+  const STATUS_UPDATE& Status() const
+  {
+    return _delivery.Status();
+  }
+
+private:
+  CTileStatusChannel();
+  ~CTileStatusChannel();
+
+  CTileStatusChannel(const CTileStatusChannel&);
+  CTileStatusChannel& operator=(const CTileStatusChannel&);
+
+  static long _CheckAccount(__in void* pvContext, __in const CCancellationToken& rct, __out uintptr_t* pulpResult);
+  static LRESULT CALLBACK _WndProc(__in HWND hwnd, __in UINT uMsg, __in WPARAM wParam, __in LPARAM lParam);
+
+  // Posts the string resource ids, or an empty status for 0, and wakes LogonUI's thread if
+  // the queue says to.  From the pool thread running the check.
+  void _PostString(__in UINT ids);
+
+  // Hands what has been posted to the tiles.  From the window, on LogonUI's thread.
+  void _Deliver();
+
+  volatile LONG               _cRef;
+  CStatusQueue                _queue;
+  CStatusDelivery             _delivery;          // LogonUI's thread's alone
+  SRWLOCK                     _srwlWindow;        // guards _hwnd; shared to post to it
+  HWND                        _hwnd;              // NULL once closed
+  volatile LONG               _fChecking;         // a check is queued or running
+};
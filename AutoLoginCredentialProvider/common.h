@@ -6,64 +6,37 @@
 //
 // Copyright (c) Microsoft Corporation. All rights reserved.
 //
-// This file contains some global variables that describe what our
-// sample tile looks like.  For example, it defines what fields a tile has 
-// and which fields show in which states of LogonUI.
+// This file contains the settings and file locations shared by the provider and its
+// credentials.  What fields a tile has, and which fields show in which states of LogonUI,
+// is in TileSchema.h.
 
 #pragma once
 #include <helpers.h>
-#include <iostream>
-#include <fstream>
+#include <Trace.h>
+#include <FlightRecorderWin32.h>
+#include <Histogram.h>
+#include <AuditLog.h>
 #include <string>
-#include <locale>
-#include <codecvt>
-
-
-// The indexes of each of the fields in our credential provider's tiles.
-enum SAMPLE_FIELD_ID
-{
-  SFI_TILEIMAGE = 0,
-  SFI_USERNAME = 1,
-  SFI_SUBMIT_BUTTON = 2,
-  SFI_NUM_FIELDS = 3,  // Note: if new fields are added, keep NUM_FIELDS last.  This is used as a count of the number of fields
-};
-
-// The first value indicates when the tile is displayed (selected, not selected)
-// the second indicates things like whether the field is enabled, whether it has key focus, etc.
-struct FIELD_STATE_PAIR
-{
-  CREDENTIAL_PROVIDER_FIELD_STATE cpfs;
-  CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE cpfis;
-};
-
-// These two arrays are seperate because a credential provider might
-// want to set up a credential with various combinations of field state pairs 
-// and field descriptors.
-
-// The field state value indicates whether the field is displayed
-// in the selected tile, the deselected tile, or both.
-// The Field interactive state indicates when 
-static const FIELD_STATE_PAIR s_rgFieldStatePairs[] =
-{
-    { CPFS_DISPLAY_IN_BOTH, CPFIS_NONE },                   // SFI_TILEIMAGE
-    { CPFS_DISPLAY_IN_BOTH, CPFIS_NONE },                   // SFI_USERNAME
-    { CPFS_DISPLAY_IN_SELECTED_TILE, CPFIS_NONE    },       // SFI_SUBMIT_BUTTON   
-};
-
-// Field descriptors for unlock and logon.
-// The first field is the index of the field.
-// The second is the type of the field.
-// The third is the name of the field, NOT the value which will appear in the field.
-static const CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR s_rgCredProvFieldDescriptors[] =
-{
-    { SFI_TILEIMAGE, CPFT_TILE_IMAGE, L"Image" },
-    { SFI_USERNAME, CPFT_LARGE_TEXT, L"Username" },
-    { SFI_SUBMIT_BUTTON, CPFT_SUBMIT_BUTTON, L"Submit" },
-};
-
-struct UserCredentials
-{
-  std::wstring domain;
-  std::wstring username;
-  std::wstring password;
-};
+#include "CredentialStore.h"
+#include "SealedStore.h"
+#include "HostRules.h"
+#include "LogonAttempt.h"
+#include "TileSchema.h"
+
+
+// Where the tile reads the account it logs on as.  See CredentialStore.h for the format.
+#define CREDENTIAL_STORE_PATH L"C:\\password.txt"
+#define CREDENTIAL_SEALED_STORE_PATH L"C:\\password.sealed"   // read instead when SETTINGS_STORE_KEY_FILE is set; see SealedStore.h
+
+// Settings, all optional, under HKEY_LOCAL_MACHINE.
+#define SETTINGS_KEY L"SOFTWARE\\AutoLoginCredentialProvider"
+#define SETTINGS_TRACE_FILE L"TraceFile"            // REG_SZ; turns tracing on and names the Chrome trace written when LogonUI releases us
+#define SETTINGS_HISTOGRAM_FILE L"HistogramFile"    // REG_SZ; turns latency histograms on and names the file they accumulate in
+#define SETTINGS_SHARD_DIRECTORY L"ShardDirectory"  // REG_SZ; where to look for a sharded store when CREDENTIAL_STORE_PATH is missing
+#define SETTINGS_SHARD_COUNT L"ShardCount"          // REG_DWORD; how many shards the sharded store was split into
+#define SETTINGS_STORE_KEY_FILE L"StoreKeyFile"     // REG_SZ; the DPAPI-wrapped key of the sealed stores; plaintext stores are ignored once set
+#define SETTINGS_RULES_FILE L"RulesFile"           // REG_SZ; compiled host rules (see HostRules.h), tried before the stores
+#define SETTINGS_TAGS L"Tags"                      // REG_MULTI_SZ; this machine's tags, for the tag= conditions of host rules
+#define SETTINGS_AUDIT_FILE L"AuditFile"           // REG_SZ; turns the audit log of logon attempts on and names it; see AuditLog.h
+#define SETTINGS_FLIGHT_RECORDER_FILE L"FlightRecorderFile"  // REG_SZ; turns the flight recorder on and names its ring; see FlightRecorderWin32.h
+#define SETTINGS_TILE_LAYOUT L"TileLayout"         // REG_DWORD; which TILE_LAYOUT the tile has (see TileSchema.h); the username only when missing
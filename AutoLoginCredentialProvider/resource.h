@@ -8,3 +8,7 @@
 //
 
 #define IDB_TILE_IMAGE     101
+
+// What the tile's status field shows while background work runs; see TileStatus.h.
+#define IDS_STATUS_LOADING_ACCOUNT        213
+#define IDS_STATUS_ACCOUNT_UNAVAILABLE    214
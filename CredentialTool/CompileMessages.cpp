@@ -0,0 +1,21 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// CompileMessages: CredentialTool compile-messages on its own, for the CMake build, which
+// runs it to compile the message catalog on every platform.  The rest of CredentialTool
+// needs Windows.
+//
+// Usage: CompileMessages -messages file -out file
+
+#include <windows.h>
+#include "CredentialTool.h"
+
+int __cdecl wmain(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  return CompileMessagesCommand(argc - 1, argv + 1);
+}
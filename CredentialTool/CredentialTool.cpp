@@ -0,0 +1,62 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// CredentialTool prepares the files AutoLoginCredentialProvider reads, for one machine or
+// for a whole fleet of them.
+//
+// Usage: CredentialTool command [options]
+//
+// Run a command without options to see the options it takes.
+
+#include <windows.h>
+#include <stdio.h>
+#include "CredentialTool.h"
+
+typedef int (*PFNCOMMAND)(int argc, wchar_t* argv[]);
+
+struct TOOL_COMMAND
+{
+  PCWSTR pwzName;
+  PFNCOMMAND pfnCommand;
+  PCWSTR pwzDescription;
+};
+
+static const TOOL_COMMAND s_rgCommands[] =
+{
+  { L"provision", ProvisionCommand, L"write credential stores for every machine in a manifest" },
+  { L"new-key", NewKeyCommand, L"generate a key to seal credential stores with" },
+  { L"protect-key", ProtectKeyCommand, L"wrap a key so that only this machine can use it" },
+  { L"compile-rules", CompileRulesCommand, L"compile host-to-account rules for the RulesFile setting" },
+  { L"match-rules", MatchRulesCommand, L"show which compiled rule applies to a machine, and how fast" },
+  { L"compile-messages", CompileMessagesCommand, L"compile the messages ReportResult shows into a catalog" },
+  { L"decode-flight-recorder", DecodeFlightRecorderCommand, L"print what the provider recorded before it stopped" },
+  { L"stress-snapshots", StressSnapshotsCommand, L"read and rotate account snapshots from many threads, and how fast" },
+  { L"bench-names", BenchNamesCommand, L"match account names spelled every way SetSerialization might, and how fast" },
+  { L"stress-status", StressStatusCommand, L"push status updates to a stand-in for LogonUI, and how fast they arrive" },
+};
+
+int __cdecl wmain(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  if (argc >= 2)
+  {
+    for (size_t i = 0; i < ARRAYSIZE(s_rgCommands); i++)
+    {
+      if (0 == lstrcmpiW(argv[1], s_rgCommands[i].pwzName))
+      {
+        return s_rgCommands[i].pfnCommand(argc - 2, argv + 2);
+      }
+    }
+  }
+
+  wprintf(L"usage: CredentialTool command [options]\n\n");
+  for (size_t i = 0; i < ARRAYSIZE(s_rgCommands); i++)
+  {
+    wprintf(L"  %-20s %s\n", s_rgCommands[i].pwzName, s_rgCommands[i].pwzDescription);
+  }
+  return 2;
+}
@@ -0,0 +1,30 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The commands CredentialTool dispatches to, and what they share.  Each command takes the arguments that follow its
+// name on the command line and returns the process exit code: 0 on success, 1 on failure
+// and 2 for a usage error.
+
+#pragma once
+
+#include <windows.h>
+#include "SealedStore.h"
+
+int ProvisionCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+int NewKeyCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+int ProtectKeyCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+int CompileRulesCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+int MatchRulesCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+int CompileMessagesCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+int DecodeFlightRecorderCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+int StressSnapshotsCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+int BenchNamesCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+int StressStatusCommand(__in int argc, __in_ecount(argc) wchar_t* argv[]);
+
+// Reads a key as new-key writes it: the key id followed by the key.
+HRESULT ReadKeyFile(__in PCWSTR pwzPath, __out_bcount(SEALED_STORE_KEY_FILE_SIZE) BYTE* pbKeyFile);
@@ -0,0 +1,171 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// decode-flight-recorder: prints the ring the FlightRecorderFile setting names (see
+// FlightRecorder.h).
+//
+// Usage: CredentialTool decode-flight-recorder -in file
+//
+// Events are listed oldest first, timed in milliseconds back from the newest one, and
+// followed by the scopes each thread had entered but not left when the ring was read or
+// its process died.  The file can be read while LogonUI still has it mapped.
+
+#include <windows.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "CredentialTool.h"
+#include "FlightRecorder.h"
+
+#define FLIGHT_RECORDER_MAX_FILE (1024 * 1024 * 1024)
+
+static HRESULT _ReadRing(__in PCWSTR pwzPath, __out std::vector<unsigned char>* prgb)
+{
+  // Shared for writing: the provider may still have the ring mapped.
+  HANDLE hFile = CreateFileW(pwzPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+
+  LARGE_INTEGER liSize;
+  HRESULT hr = GetFileSizeEx(hFile, &liSize) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  if (SUCCEEDED(hr) && liSize.QuadPart > FLIGHT_RECORDER_MAX_FILE)
+  {
+    hr = HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
+  }
+  if (SUCCEEDED(hr))
+  {
+    prgb->resize(static_cast<size_t>(liSize.QuadPart));
+    DWORD cbRead = 0;
+    if (!prgb->empty() && !ReadFile(hFile, &(*prgb)[0], static_cast<DWORD>(prgb->size()), &cbRead, NULL))
+    {
+      hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+    prgb->resize(cbRead);
+  }
+  CloseHandle(hFile);
+  return hr;
+}
+
+static PCWSTR _EventTypeName(__in USHORT usType)
+{
+  switch (usType)
+  {
+  case FE_SESSION:
+    return L"session";
+  case FE_ENTER:
+    return L"enter";
+  case FE_EXIT:
+    return L"exit";
+  case FE_PHASE:
+    return L"phase";
+  case FE_RESULT:
+    return L"result";
+  default:
+    return L"?";
+  }
+}
+
+int DecodeFlightRecorderCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  if (argc != 2 || 0 != lstrcmpiW(argv[0], L"-in"))
+  {
+    wprintf(L"usage: CredentialTool decode-flight-recorder -in file\n");
+    return 2;
+  }
+
+  std::vector<unsigned char> rgb;
+  HRESULT hr = _ReadRing(argv[1], &rgb);
+  if (FAILED(hr))
+  {
+    wprintf(L"could not read %s: 0x%08x\n", argv[1], hr);
+    return 1;
+  }
+
+  FLIGHT_RECORDER_INFO info;
+  std::vector<FLIGHT_EVENT> rgEvents;
+  if (!FlightRecorderDecode(rgb.empty() ? NULL : &rgb[0], rgb.size(), &info, &rgEvents))
+  {
+    wprintf(L"%s is not a flight recorder\n", argv[1]);
+    return 1;
+  }
+
+  wprintf(L"%u slots, %I64u events recorded, %Iu held, %u torn\n\n",
+    info.cEvents, info.ullNext - 1, rgEvents.size(), info.cTorn);
+  if (rgEvents.empty())
+  {
+    return 0;
+  }
+
+  const double dMsPerTick = 1000.0 / static_cast<double>(info.ullFrequency ? info.ullFrequency : 1);
+  const LONGLONG llNewest = rgEvents.back().llTicks;
+
+  // The scopes each thread is inside, outermost first.
+  std::map<DWORD, std::vector<std::string> > mapOpen;
+
+  wprintf(L"%10s %12s %8s  event\n", L"seq", L"ms", L"thread");
+  for (size_t i = 0; i < rgEvents.size(); i++)
+  {
+    const FLIGHT_EVENT& fe = rgEvents[i];
+    wprintf(L"%10I64u %12.3f %8u  %-7s %hs", fe.ullSeq, (fe.llTicks - llNewest) * dMsPerTick, fe.ulThreadId,
+      _EventTypeName(fe.usType), fe.szName);
+
+    std::vector<std::string>& rgOpen = mapOpen[fe.ulThreadId];
+    switch (fe.usType)
+    {
+    case FE_SESSION:
+      wprintf(L" pid %d", fe.lValue);
+      break;
+
+    case FE_ENTER:
+      rgOpen.push_back(fe.szName);
+      break;
+
+    case FE_EXIT:
+      wprintf(L" %.3f ms", fe.llDuration * dMsPerTick);
+      // Scopes that were entered before the oldest event held never show up here.
+      if (!rgOpen.empty() && rgOpen.back() == fe.szName)
+      {
+        rgOpen.pop_back();
+      }
+      break;
+
+    case FE_PHASE:
+      wprintf(L" %.3f ms", fe.llDuration * dMsPerTick);
+      break;
+
+    case FE_RESULT:
+      wprintf(L" 0x%08x", static_cast<unsigned int>(fe.lValue));
+      break;
+    }
+    wprintf(L"\n");
+  }
+
+  bool fFirst = true;
+  for (std::map<DWORD, std::vector<std::string> >::const_iterator it = mapOpen.begin(); it != mapOpen.end(); ++it)
+  {
+    if (!it->second.empty())
+    {
+      if (fFirst)
+      {
+        wprintf(L"\nstill inside:\n");
+        fFirst = false;
+      }
+      wprintf(L"  thread %u:", it->first);
+      for (size_t i = 0; i < it->second.size(); i++)
+      {
+        wprintf(L"%s %hs", i ? L" >" : L"", it->second[i].c_str());
+      }
+      wprintf(L"\n");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,173 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// new-key and protect-key: the keys sealed stores are encrypted with.
+//
+// Usage: CredentialTool new-key -out file
+//        CredentialTool protect-key -key file -out file
+//
+// new-key writes a random key and key id (SEALED_STORE_KEY_FILE_SIZE bytes, unprotected)
+// for provision -key.  Keep it offline.  protect-key wraps a key with machine-scope DPAPI
+// so that only the machine it runs on can unwrap it: run it on each machine and point
+// the StoreKeyFile setting at the result.
+
+#include <windows.h>
+#include <bcrypt.h>
+#include <dpapi.h>
+#include <stdio.h>
+#include "CredentialTool.h"
+
+static HRESULT _WriteNewFile(__in PCWSTR pwzPath, __in_bcount(cb) const BYTE* pb, __in DWORD cb)
+{
+  // Never overwrite a key: a store sealed with the old one could not be opened again.
+  HANDLE hFile = CreateFileW(pwzPath, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+
+  DWORD cbWritten;
+  HRESULT hr = (WriteFile(hFile, pb, cb, &cbWritten, NULL) && cbWritten == cb) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  CloseHandle(hFile);
+  if (FAILED(hr))
+  {
+    DeleteFileW(pwzPath);
+  }
+  return hr;
+}
+
+HRESULT ReadKeyFile(__in PCWSTR pwzPath, __out_bcount(SEALED_STORE_KEY_FILE_SIZE) BYTE* pbKeyFile)
+{
+  HANDLE hFile = CreateFileW(pwzPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+
+  // Read one byte more than a key so that a longer file is caught.
+  BYTE rgb[SEALED_STORE_KEY_FILE_SIZE + 1];
+  DWORD cbRead;
+  HRESULT hr = ReadFile(hFile, rgb, sizeof(rgb), &cbRead, NULL) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  if (SUCCEEDED(hr))
+  {
+    if (cbRead == SEALED_STORE_KEY_FILE_SIZE)
+    {
+      CopyMemory(pbKeyFile, rgb, SEALED_STORE_KEY_FILE_SIZE);
+    }
+    else
+    {
+      hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+  }
+  SecureZeroMemory(rgb, sizeof(rgb));
+  CloseHandle(hFile);
+  return hr;
+}
+
+// Parses "-name value" pairs for the options named in rgpwzNames into rgpwzValues.  Every
+// option is required.
+static bool _ParseOptions(
+  __in int argc,
+  __in_ecount(argc) wchar_t* argv[],
+  __in DWORD cOptions,
+  __in_ecount(cOptions) const PCWSTR* rgpwzNames,
+  __out_ecount(cOptions) PCWSTR* rgpwzValues
+)
+{
+  for (DWORD i = 0; i < cOptions; i++)
+  {
+    rgpwzValues[i] = NULL;
+  }
+
+  for (int i = 0; i + 1 < argc; i += 2)
+  {
+    DWORD iOption = 0;
+    while (iOption < cOptions && 0 != lstrcmpiW(argv[i], rgpwzNames[iOption]))
+    {
+      iOption++;
+    }
+    if (iOption == cOptions)
+    {
+      return false;
+    }
+    rgpwzValues[iOption] = argv[i + 1];
+  }
+
+  for (DWORD i = 0; i < cOptions; i++)
+  {
+    if (!rgpwzValues[i])
+    {
+      return false;
+    }
+  }
+  return 0 == argc % 2;
+}
+
+int NewKeyCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  static const PCWSTR s_rgpwzNames[] = { L"-out" };
+  PCWSTR rgpwzValues[ARRAYSIZE(s_rgpwzNames)];
+  if (!_ParseOptions(argc, argv, ARRAYSIZE(s_rgpwzNames), s_rgpwzNames, rgpwzValues))
+  {
+    wprintf(L"usage: CredentialTool new-key -out file\n");
+    return 2;
+  }
+
+  BYTE rgbKeyFile[SEALED_STORE_KEY_FILE_SIZE];
+  NTSTATUS status = BCryptGenRandom(NULL, rgbKeyFile, sizeof(rgbKeyFile), BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+  HRESULT hr = BCRYPT_SUCCESS(status) ? S_OK : HRESULT_FROM_NT(status);
+  if (SUCCEEDED(hr))
+  {
+    hr = _WriteNewFile(rgpwzValues[0], rgbKeyFile, sizeof(rgbKeyFile));
+  }
+  SecureZeroMemory(rgbKeyFile, sizeof(rgbKeyFile));
+
+  if (FAILED(hr))
+  {
+    wprintf(L"could not write %s: 0x%08x\n", rgpwzValues[0], hr);
+  }
+  return SUCCEEDED(hr) ? 0 : 1;
+}
+
+int ProtectKeyCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  static const PCWSTR s_rgpwzNames[] = { L"-key", L"-out" };
+  PCWSTR rgpwzValues[ARRAYSIZE(s_rgpwzNames)];
+  if (!_ParseOptions(argc, argv, ARRAYSIZE(s_rgpwzNames), s_rgpwzNames, rgpwzValues))
+  {
+    wprintf(L"usage: CredentialTool protect-key -key file -out file\n"
+            L"\n"
+            L"Run on the machine that will use the key; only that machine can unwrap the result.\n");
+    return 2;
+  }
+
+  BYTE rgbKeyFile[SEALED_STORE_KEY_FILE_SIZE];
+  HRESULT hr = ReadKeyFile(rgpwzValues[0], rgbKeyFile);
+  if (SUCCEEDED(hr))
+  {
+    DATA_BLOB dbIn = { sizeof(rgbKeyFile), rgbKeyFile };
+    DATA_BLOB dbOut = { 0, NULL };
+    if (CryptProtectData(&dbIn, L"AutoLoginCredentialProvider store key", NULL, NULL, NULL,
+      CRYPTPROTECT_LOCAL_MACHINE | CRYPTPROTECT_UI_FORBIDDEN, &dbOut))
+    {
+      hr = _WriteNewFile(rgpwzValues[1], dbOut.pbData, dbOut.cbData);
+      LocalFree(dbOut.pbData);
+    }
+    else
+    {
+      hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+    SecureZeroMemory(rgbKeyFile, sizeof(rgbKeyFile));
+  }
+
+  if (FAILED(hr))
+  {
+    wprintf(L"could not protect %s into %s: 0x%08x\n", rgpwzValues[0], rgpwzValues[1], hr);
+  }
+  return SUCCEEDED(hr) ? 0 : 1;
+}
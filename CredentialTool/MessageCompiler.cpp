@@ -0,0 +1,405 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <new>
+#include <string.h>
+#include "MessageCompiler.h"
+
+#define MESSAGE_CATALOG_MIN_SLOTS 8
+
+static const char* const s_rgpszIcons[] = { "none", "error", "warning", "success" };
+
+static void _Split(const char* pch, size_t cch, char chSeparator, std::vector<std::string>* prgFields)
+{
+  prgFields->clear();
+  size_t iStart = 0;
+  for (size_t i = 0; i <= cch; i++)
+  {
+    if (i == cch || pch[i] == chSeparator)
+    {
+      prgFields->push_back(std::string(pch + iStart, i - iStart));
+      iStart = i + 1;
+    }
+  }
+}
+
+// Parses a hexadecimal number of at most eight digits, all of the string, with or without
+// a leading 0x.
+static bool _ParseHex(const std::string& s, unsigned long* pul)
+{
+  size_t i = (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) ? 2 : 0;
+  if (i == s.size() || s.size() - i > 8)
+  {
+    return false;
+  }
+  unsigned long ul = 0;
+  for (; i < s.size(); i++)
+  {
+    char ch = s[i];
+    unsigned long ulDigit;
+    if (ch >= '0' && ch <= '9')
+    {
+      ulDigit = (unsigned long)(ch - '0');
+    }
+    else if (ch >= 'a' && ch <= 'f')
+    {
+      ulDigit = (unsigned long)(ch - 'a' + 10);
+    }
+    else if (ch >= 'A' && ch <= 'F')
+    {
+      ulDigit = (unsigned long)(ch - 'A' + 10);
+    }
+    else
+    {
+      return false;
+    }
+    ul = (ul << 4) | ulDigit;
+  }
+  *pul = ul;
+  return true;
+}
+
+// Converts well-formed UTF-8, refusing overlong forms, surrogates and anything past
+// U+10FFFF, to UTF-16.
+static bool _Utf8ToUtf16(const std::string& s, std::vector<unsigned short>* prgus)
+{
+  prgus->clear();
+  for (size_t i = 0; i < s.size(); )
+  {
+    unsigned char b = (unsigned char)s[i];
+    size_t cbTrail;
+    unsigned long ulMin;
+    unsigned long ulCode;
+    if (b < 0x80)
+    {
+      cbTrail = 0;
+      ulMin = 0;
+      ulCode = b;
+    }
+    else if ((b & 0xE0) == 0xC0)
+    {
+      cbTrail = 1;
+      ulMin = 0x80;
+      ulCode = b & 0x1F;
+    }
+    else if ((b & 0xF0) == 0xE0)
+    {
+      cbTrail = 2;
+      ulMin = 0x800;
+      ulCode = b & 0x0F;
+    }
+    else if ((b & 0xF8) == 0xF0)
+    {
+      cbTrail = 3;
+      ulMin = 0x10000;
+      ulCode = b & 0x07;
+    }
+    else
+    {
+      return false;
+    }
+    if (s.size() - i - 1 < cbTrail)
+    {
+      return false;
+    }
+    for (size_t j = 1; j <= cbTrail; j++)
+    {
+      unsigned char bTrail = (unsigned char)s[i + j];
+      if ((bTrail & 0xC0) != 0x80)
+      {
+        return false;
+      }
+      ulCode = (ulCode << 6) | (bTrail & 0x3F);
+    }
+    if (ulCode < ulMin || ulCode > 0x10FFFF || (ulCode >= 0xD800 && ulCode < 0xE000))
+    {
+      return false;
+    }
+    if (ulCode >= 0x10000)
+    {
+      ulCode -= 0x10000;
+      prgus->push_back((unsigned short)(0xD800 + (ulCode >> 10)));
+      prgus->push_back((unsigned short)(0xDC00 + (ulCode & 0x3FF)));
+    }
+    else
+    {
+      prgus->push_back((unsigned short)ulCode);
+    }
+    i += 1 + cbTrail;
+  }
+  return true;
+}
+
+bool CMessageCatalogCompiler::KEY::operator<(const KEY& other) const
+{
+  if (ulStatus != other.ulStatus)
+  {
+    return ulStatus < other.ulStatus;
+  }
+  if (ulSubstatus != other.ulSubstatus)
+  {
+    return ulSubstatus < other.ulSubstatus;
+  }
+  if (usLangId != other.usLangId)
+  {
+    return usLangId < other.usLangId;
+  }
+  return fAnySubstatus < other.fAnySubstatus;
+}
+
+CMessageCatalogCompiler::CMessageCatalogCompiler() :
+  _usLangId(0),
+  _usDefaultLangId(0),
+  _pwzError(NULL),
+  _ulErrorLine(0)
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+bool CMessageCatalogCompiler::_Fail(const wchar_t* pwzError, unsigned long ulLine)
+{
+  _pwzError = pwzError;
+  _ulErrorLine = ulLine;
+  return false;
+}
+
+bool CMessageCatalogCompiler::AddLine(const char* pch, size_t cch, unsigned long ulLine)
+{
+  if (cch && pch[cch - 1] == '\r')
+  {
+    cch--;
+  }
+  if (cch == 0 || pch[0] == '#')
+  {
+    return true;
+  }
+
+  FIELDS fields;
+  try
+  {
+    _Split(pch, cch, '\t', &fields);
+    if (fields[0] == "language")
+    {
+      return _AddLanguage(fields, ulLine);
+    }
+    if (fields[0] == "message")
+    {
+      return _AddMessage(fields, ulLine);
+    }
+  }
+  catch (const std::bad_alloc&)
+  {
+    return _Fail(L"does not fit in memory", ulLine);
+  }
+  return _Fail(L"is neither a language nor a message", ulLine);
+}
+
+bool CMessageCatalogCompiler::_AddLanguage(const FIELDS& fields, unsigned long ulLine)
+{
+  if (fields.size() < 2 || fields.size() > 3 || (fields.size() == 3 && fields[2] != "default"))
+  {
+    return _Fail(L"needs a LANGID, and default if it is the default language", ulLine);
+  }
+  unsigned long ulLangId;
+  if (!_ParseHex(fields[1], &ulLangId) || 0 == ulLangId || ulLangId > 0xFFFF)
+  {
+    return _Fail(L"has a LANGID that is not a nonzero 16-bit hexadecimal number", ulLine);
+  }
+  for (size_t i = 0; i < _rgLangIds.size(); i++)
+  {
+    if (_rgLangIds[i] == ulLangId)
+    {
+      return _Fail(L"repeats a language", ulLine);
+    }
+  }
+  if (fields.size() == 3)
+  {
+    if (0 != _usDefaultLangId)
+    {
+      return _Fail(L"makes a second language the default", ulLine);
+    }
+    _usDefaultLangId = (unsigned short)ulLangId;
+  }
+  _usLangId = (unsigned short)ulLangId;
+  _rgLangIds.push_back(_usLangId);
+  return true;
+}
+
+bool CMessageCatalogCompiler::_AddMessage(const FIELDS& fields, unsigned long ulLine)
+{
+  if (0 == _usLangId)
+  {
+    return _Fail(L"comes before any language", ulLine);
+  }
+  if (fields.size() != 5)
+  {
+    return _Fail(L"needs a status, a substatus or *, an icon and the text", ulLine);
+  }
+
+  MESSAGE message;
+  message.key.usLangId = _usLangId;
+  message.key.fAnySubstatus = (fields[2] == "*");
+  message.key.ulSubstatus = 0;
+  if (!_ParseHex(fields[1], &message.key.ulStatus) ||
+    (!message.key.fAnySubstatus && !_ParseHex(fields[2], &message.key.ulSubstatus)))
+  {
+    return _Fail(L"has a status or substatus that is not a hexadecimal number of at most eight digits", ulLine);
+  }
+
+  message.bIcon = sizeof(s_rgpszIcons) / sizeof(s_rgpszIcons[0]);
+  for (unsigned char i = 0; i < sizeof(s_rgpszIcons) / sizeof(s_rgpszIcons[0]); i++)
+  {
+    if (fields[3] == s_rgpszIcons[i])
+    {
+      message.bIcon = i;
+    }
+  }
+  if (message.bIcon == sizeof(s_rgpszIcons) / sizeof(s_rgpszIcons[0]))
+  {
+    return _Fail(L"has an icon other than none, error, warning and success", ulLine);
+  }
+
+  std::vector<unsigned short> text;
+  if (!_Utf8ToUtf16(fields[4], &text) || text.empty() || text.size() > MESSAGE_CATALOG_MAX_TEXT)
+  {
+    return _Fail(L"has text that is empty, too long or not UTF-8", ulLine);
+  }
+
+  if (_mapMessages.count(message.key))
+  {
+    return _Fail(L"repeats a status and substatus in its language", ulLine);
+  }
+
+  std::map<std::vector<unsigned short>, unsigned long>::const_iterator itText = _mapTexts.find(text);
+  if (itText == _mapTexts.end())
+  {
+    itText = _mapTexts.insert(std::make_pair(text, (unsigned long)_rgTexts.size())).first;
+    _rgTexts.push_back(text);
+  }
+  message.iText = itText->second;
+
+  _mapMessages[message.key] = (unsigned long)_rgMessages.size();
+  _rgMessages.push_back(message);
+  return true;
+}
+
+bool CMessageCatalogCompiler::Compile(std::vector<unsigned char>* prgbOut)
+{
+  if (0 == _usDefaultLangId)
+  {
+    return _Fail(L"have no default language", 0);
+  }
+
+  try
+  {
+    // File each message under its primary language too, where no message for that
+    // language says otherwise; the language listed first wins.
+    std::vector<MESSAGE> rgSlotted(_rgMessages);
+    std::map<KEY, unsigned long> mapKeys(_mapMessages);
+    for (size_t i = 0; i < _rgMessages.size(); i++)
+    {
+      MESSAGE alias = _rgMessages[i];
+      alias.key.usLangId = MESSAGE_CATALOG_PRIMARY_LANGID(alias.key.usLangId);
+      if (alias.key.usLangId != _rgMessages[i].key.usLangId && !mapKeys.count(alias.key))
+      {
+        mapKeys[alias.key] = (unsigned long)rgSlotted.size();
+        rgSlotted.push_back(alias);
+      }
+    }
+
+    // The text section, each distinct text once.
+    std::vector<unsigned char> rgbText;
+    std::vector<unsigned long> rgulTextOffsets;
+    for (size_t i = 0; i < _rgTexts.size(); i++)
+    {
+      const std::vector<unsigned short>& text = _rgTexts[i];
+      rgulTextOffsets.push_back((unsigned long)rgbText.size());
+      rgbText.push_back((unsigned char)text.size());
+      rgbText.push_back((unsigned char)(text.size() >> 8));
+      for (size_t j = 0; j < text.size(); j++)
+      {
+        rgbText.push_back((unsigned char)text[j]);
+        rgbText.push_back((unsigned char)(text[j] >> 8));
+      }
+    }
+
+    // At most half the slots are used, so that probes stay short.
+    unsigned long cSlots = MESSAGE_CATALOG_MIN_SLOTS;
+    while (cSlots < 2 * rgSlotted.size())
+    {
+      cSlots *= 2;
+    }
+    unsigned long long cbTotal = MESSAGE_CATALOG_HEADER_SIZE + (unsigned long long)cSlots * MESSAGE_CATALOG_SLOT_SIZE + rgbText.size();
+    if (cbTotal > MESSAGE_CATALOG_MAX_SIZE)
+    {
+      return _Fail(L"are too large for a catalog", 0);
+    }
+
+    MESSAGE_CATALOG_HEADER hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.ulMagic = MESSAGE_CATALOG_MAGIC;
+    hdr.ulVersion = MESSAGE_CATALOG_VERSION;
+    hdr.ulDefaultLangId = _usDefaultLangId;
+    hdr.cSlots = cSlots;
+    hdr.cMessages = (unsigned long)rgSlotted.size();
+    hdr.ulSlotsOffset = MESSAGE_CATALOG_HEADER_SIZE;
+    hdr.ulTextOffset = MESSAGE_CATALOG_HEADER_SIZE + cSlots * MESSAGE_CATALOG_SLOT_SIZE;
+    hdr.cbText = (unsigned long)rgbText.size();
+
+    prgbOut->assign((size_t)cbTotal, 0);
+    unsigned char* pb = &(*prgbOut)[0];
+    MessageCatalogEncodeHeader(hdr, pb);
+
+    std::vector<bool> rgfUsed(cSlots, false);
+    unsigned long cMaxProbe = 0;
+    for (size_t i = 0; i < rgSlotted.size(); i++)
+    {
+      const MESSAGE& message = rgSlotted[i];
+      unsigned long iSlot = MessageCatalogHash(message.key.ulStatus, message.key.ulSubstatus, message.key.usLangId, message.key.fAnySubstatus) & (cSlots - 1);
+      unsigned long cProbe = 1;
+      while (rgfUsed[iSlot])
+      {
+        iSlot = (iSlot + 1) & (cSlots - 1);
+        cProbe++;
+      }
+      rgfUsed[iSlot] = true;
+      if (cProbe > cMaxProbe)
+      {
+        cMaxProbe = cProbe;
+      }
+
+      MESSAGE_CATALOG_SLOT slot;
+      slot.ulStatus = message.key.ulStatus;
+      slot.ulSubstatus = message.key.ulSubstatus;
+      slot.usLangId = message.key.usLangId;
+      slot.bFlags = MESSAGE_CATALOG_SLOT_USED | (message.key.fAnySubstatus ? MESSAGE_CATALOG_SLOT_ANY_SUBSTATUS : 0);
+      slot.bIcon = message.bIcon;
+      slot.ulText = rgulTextOffsets[message.iText];
+      MessageCatalogEncodeSlot(slot, pb + hdr.ulSlotsOffset + (size_t)iSlot * MESSAGE_CATALOG_SLOT_SIZE);
+    }
+    if (!rgbText.empty())
+    {
+      memcpy(pb + hdr.ulTextOffset, &rgbText[0], rgbText.size());
+    }
+
+    _stats.cLanguages = (unsigned long)_rgLangIds.size();
+    _stats.cMessages = (unsigned long)_rgMessages.size();
+    _stats.cAliases = (unsigned long)(rgSlotted.size() - _rgMessages.size());
+    _stats.cTexts = (unsigned long)_rgTexts.size();
+    _stats.cSlots = cSlots;
+    _stats.cMaxProbe = cMaxProbe;
+    _stats.cbOutput = prgbOut->size();
+  }
+  catch (const std::bad_alloc&)
+  {
+    return _Fail(L"do not fit in memory", 0);
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Compiles message text into the catalog MessageCatalog.h describes.  Like
+// MessageCatalog.cpp this is platform-neutral.
+//
+// The message text is UTF-8, one entry per line, with tab-separated fields.  Blank lines
+// and lines starting with # are ignored.
+//
+//   language <LANGID> [default]
+//   message <status> <substatus> <icon> <text>
+//
+// A language line says which language the messages after it are in, as a LANGID in
+// hexadecimal (0x0409 for en-US); exactly one language is the default, which lookups fall
+// back to.  Statuses and substatuses are NTSTATUS values in hexadecimal, and a substatus
+// of * matches any substatus; a message for a status and a substatus is found before one
+// for the status and any substatus.  The icon is none, error, warning or success.
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "MessageCatalog.h"
+
+struct MESSAGE_CATALOG_COMPILE_STATS
+{
+  unsigned long cLanguages;
+  unsigned long cMessages;          // as written
+  unsigned long cAliases;           // filed under a primary language as well
+  unsigned long cTexts;             // distinct texts
+  unsigned long cSlots;
+  unsigned long cMaxProbe;          // slots the longest probe for a key visits
+  size_t cbOutput;
+};
+
+class CMessageCatalogCompiler
+{
+public:
+  CMessageCatalogCompiler();
+
+  // Adds one line of message text (without its line break).  Returns false, with Error()
+  // describing why, if the line is not a valid entry.  Errors complete a sentence whose
+  // subject is the entry or, when ErrorLine() is 0, the messages as a whole.
+  bool AddLine(const char* pch, size_t cch, unsigned long ulLine);
+
+  // Builds the catalog from the lines added so far.
+  bool Compile(std::vector<unsigned char>* prgbOut);
+
+  const wchar_t* Error() const { return _pwzError; }
+  unsigned long ErrorLine() const { return _ulErrorLine; }
+  const MESSAGE_CATALOG_COMPILE_STATS& Stats() const { return _stats; }
+
+private:
+  typedef std::vector<std::string> FIELDS;
+
+  struct KEY
+  {
+    unsigned long ulStatus;
+    unsigned long ulSubstatus;
+    unsigned short usLangId;
+    bool fAnySubstatus;
+
+    bool operator<(const KEY& other) const;
+  };
+
+  struct MESSAGE
+  {
+    KEY key;
+    unsigned char bIcon;
+    unsigned long iText;            // in _rgTexts
+  };
+
+  bool _Fail(const wchar_t* pwzError, unsigned long ulLine);
+  bool _AddLanguage(const FIELDS& fields, unsigned long ulLine);
+  bool _AddMessage(const FIELDS& fields, unsigned long ulLine);
+
+  std::vector<MESSAGE> _rgMessages;
+  std::map<KEY, unsigned long> _mapMessages;            // index in _rgMessages
+  std::vector<std::vector<unsigned short> > _rgTexts;   // UTF-16
+  std::map<std::vector<unsigned short>, unsigned long> _mapTexts;
+  std::vector<unsigned short> _rgLangIds;
+
+  unsigned short _usLangId;         // of the messages being added; 0 before any language
+  unsigned short _usDefaultLangId;  // 0 until a language is the default
+
+  const wchar_t* _pwzError;
+  unsigned long _ulErrorLine;
+  MESSAGE_CATALOG_COMPILE_STATS _stats;
+};
@@ -0,0 +1,160 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// compile-messages: the catalog of what ReportResult says (see MessageCompiler.h for the
+// message text and MessageCatalog.h for what the provider does with the result).
+//
+// Usage: CredentialTool compile-messages -messages file -out file
+//
+// The build runs this on AutoLoginCredentialProvider\messages.txt and puts the result next
+// to the DLL as AutoLoginCredentialProvider.messages.  It uses only what the Win32 shims
+// provide, so that CompileMessages.cpp can build it on every platform.
+
+#include <windows.h>
+#include <stdio.h>
+#include <vector>
+#include "CredentialTool.h"
+#include "MessageCompiler.h"
+
+#define MESSAGES_MAX_TEXT (16 * 1024 * 1024)
+
+static HRESULT _HResultFromPlatformResult(__in PLATFORM_RESULT pr)
+{
+  switch (pr)
+  {
+  case PR_OK:
+    return S_OK;
+  case PR_NOT_FOUND:
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  case PR_ACCESS_DENIED:
+    return E_ACCESSDENIED;
+  case PR_OUT_OF_MEMORY:
+    return E_OUTOFMEMORY;
+  case PR_IO_ERROR:
+    return HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+  default:
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+}
+
+static HRESULT _WriteFile(__in PCWSTR pwzPath, __in const std::vector<unsigned char>& rgb)
+{
+  HANDLE hFile = CreateFileW(pwzPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+
+  DWORD cbWritten = 0;
+  HRESULT hr = (rgb.empty() || WriteFile(hFile, &rgb[0], (DWORD)rgb.size(), &cbWritten, NULL)) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  if (SUCCEEDED(hr) && cbWritten != rgb.size())
+  {
+    hr = HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+  }
+  CloseHandle(hFile);
+  if (FAILED(hr))
+  {
+    DeleteFileW(pwzPath);
+  }
+  return hr;
+}
+
+int CompileMessagesCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  PCWSTR pwzMessages = NULL;
+  PCWSTR pwzOut = NULL;
+  bool fUsage = (0 != argc % 2);
+  for (int i = 0; !fUsage && i < argc; i += 2)
+  {
+    if (0 == lstrcmpiW(argv[i], L"-messages"))
+    {
+      pwzMessages = argv[i + 1];
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-out"))
+    {
+      pwzOut = argv[i + 1];
+    }
+    else
+    {
+      fUsage = true;
+    }
+  }
+  if (fUsage || !pwzMessages || !pwzOut)
+  {
+    wprintf(L"usage: CredentialTool compile-messages -messages file -out file\n"
+            L"\n"
+            L"The messages file is UTF-8, one entry per line, fields separated by tabs:\n"
+            L"  language<TAB>LANGID[<TAB>default]\n"
+            L"  message<TAB>status<TAB>substatus or *<TAB>none|error|warning|success<TAB>text\n"
+            L"LANGIDs, statuses and substatuses are hexadecimal.  Messages are in the\n"
+            L"language above them, and exactly one language is the default.\n");
+    return 2;
+  }
+
+  LARGE_INTEGER liFrequency;
+  LARGE_INTEGER liStart;
+  LARGE_INTEGER liEnd;
+  QueryPerformanceFrequency(&liFrequency);
+  QueryPerformanceCounter(&liStart);
+
+  std::vector<unsigned char> rgbText;
+  HRESULT hr = _HResultFromPlatformResult(PlatformReadFile(pwzMessages, MESSAGES_MAX_TEXT, &rgbText));
+  if (FAILED(hr))
+  {
+    wprintf(L"could not read %s: 0x%08x\n", pwzMessages, hr);
+    return 1;
+  }
+
+  // Skip a UTF-8 byte order mark, then hand the compiler a line at a time.
+  CMessageCatalogCompiler compiler;
+  size_t iLine = (rgbText.size() >= 3 && rgbText[0] == 0xEF && rgbText[1] == 0xBB && rgbText[2] == 0xBF) ? 3 : 0;
+  bool fOk = true;
+  for (DWORD dwLine = 1; fOk && iLine < rgbText.size(); dwLine++)
+  {
+    size_t iEnd = iLine;
+    while (iEnd < rgbText.size() && rgbText[iEnd] != '\n')
+    {
+      iEnd++;
+    }
+    fOk = compiler.AddLine(reinterpret_cast<const char*>(&rgbText[iLine]), iEnd - iLine, dwLine);
+    iLine = iEnd + 1;
+  }
+
+  std::vector<unsigned char> rgbOut;
+  if (fOk)
+  {
+    fOk = compiler.Compile(&rgbOut);
+  }
+  if (!fOk)
+  {
+    if (compiler.ErrorLine())
+    {
+      wprintf(L"%s(%u): the entry %s\n", pwzMessages, compiler.ErrorLine(), compiler.Error());
+    }
+    else
+    {
+      wprintf(L"%s: the messages %s\n", pwzMessages, compiler.Error());
+    }
+    return 1;
+  }
+
+  hr = _WriteFile(pwzOut, rgbOut);
+  if (FAILED(hr))
+  {
+    wprintf(L"could not write %s: 0x%08x\n", pwzOut, hr);
+    return 1;
+  }
+
+  QueryPerformanceCounter(&liEnd);
+  const MESSAGE_CATALOG_COMPILE_STATS& stats = compiler.Stats();
+  wprintf(L"%u messages in %u languages compiled in %.2f ms: %u more filed under a primary language,\n"
+          L"%u distinct texts, %u slots, at most %u probes, %Iu bytes\n",
+    stats.cMessages, stats.cLanguages, (double)(liEnd.QuadPart - liStart.QuadPart) * 1000 / liFrequency.QuadPart,
+    stats.cAliases, stats.cTexts, stats.cSlots, stats.cMaxProbe, stats.cbOutput);
+  return 0;
+}
@@ -0,0 +1,243 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// bench-names: parses and interns account names the way the provider does for
+// SetSerialization (see AccountName.h), and reports how long each name takes.
+//
+// Usage: CredentialTool bench-names [-names n] [-accounts n]
+//
+// Each account is spelled every way a serialization might name it: in other cases, with the
+// domain in the user name or apart, a local account as ".", as the machine name or with no
+// domain, and as a UPN.  Every eighth account has a non-ASCII user name, and those are
+// timed apart, since they are the ones folded by PlatformUpcase.  A spelling that doesn't
+// come out as its account's identity, or two accounts that come out as one, counts as a
+// failure and the command exits 1.
+
+#include <windows.h>
+#include <strsafe.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "CredentialTool.h"
+#include "AccountName.h"
+
+#define BENCH_MACHINE L"BENCH-MACHINE"
+#define BENCH_DOMAIN L"CONTOSO"
+#define BENCH_UPN_SUFFIX L"contoso.com"
+
+struct NAME_SPELLING
+{
+  std::wstring strDomain;
+  std::wstring strUsername;
+  size_t iAccount;        // which of the accounts it should come out as
+};
+
+// Adds the spellings of one account.  The first is the one the others have to match.
+static void _AddSpellings(
+  __in const std::wstring& strUsername,
+  __in bool fLocal,
+  __in size_t iAccount,
+  __inout std::vector<NAME_SPELLING>* prgSpellings
+)
+{
+  std::wstring strUpper(strUsername);
+  std::wstring strLower(strUsername);
+  for (size_t i = 0; i < strUsername.size(); i++)
+  {
+    strUpper[i] = (strUsername[i] >= L'a' && strUsername[i] <= L'z') ? (wchar_t)(strUsername[i] - L'a' + L'A') : strUsername[i];
+    strLower[i] = (strUsername[i] >= L'A' && strUsername[i] <= L'Z') ? (wchar_t)(strUsername[i] - L'A' + L'a') : strUsername[i];
+  }
+
+  if (fLocal)
+  {
+    NAME_SPELLING rgLocal[] =
+    {
+      { L"", strUsername, iAccount },
+      { L".", strUpper, iAccount },
+      { L"bench-machine", strLower, iAccount },
+      { L"", L".\\" + strUsername, iAccount },
+      { L"", L"Bench-Machine\\" + strUpper, iAccount },
+      { L"CONTOSO", L".\\" + strLower, iAccount },
+    };
+    prgSpellings->insert(prgSpellings->end(), rgLocal, rgLocal + ARRAYSIZE(rgLocal));
+  }
+  else
+  {
+    NAME_SPELLING rgDomain[] =
+    {
+      { BENCH_DOMAIN, strUsername, iAccount },
+      { L"contoso", strUpper, iAccount },
+      { L"", L"Contoso\\" + strLower, iAccount },
+      { L".", L"CONTOSO\\" + strUsername, iAccount },
+      { BENCH_MACHINE, L"contoso\\" + strUpper, iAccount },
+    };
+    prgSpellings->insert(prgSpellings->end(), rgDomain, rgDomain + ARRAYSIZE(rgDomain));
+  }
+
+  // The account's UPN is an identity of its own, which the next account index stands for.
+  NAME_SPELLING rgUpn[] =
+  {
+    { L"", strUsername + L"@" BENCH_UPN_SUFFIX, iAccount + 1 },
+    { L"", strUpper + L"@CONTOSO.COM", iAccount + 1 },
+    { L"", strLower + L"@Contoso.Com", iAccount + 1 },
+  };
+  prgSpellings->insert(prgSpellings->end(), rgUpn, rgUpn + ARRAYSIZE(rgUpn));
+}
+
+static CREDENTIAL_STORE_RESULT _Intern(__in const NAME_SPELLING& rns, __out const ACCOUNT_IDENTITY** ppIdentity)
+{
+  return AccountNameIntern(rns.strDomain.c_str(), rns.strDomain.size(), rns.strUsername.c_str(), rns.strUsername.size(),
+    BENCH_MACHINE, ARRAYSIZE(BENCH_MACHINE) - 1, ppIdentity);
+}
+
+// Interns cNames names, cycling through rgSpellings, and returns the time they took in
+// nanoseconds.  Counts the names that didn't come out as their account's identity.
+static double _TimeNames(
+  __in const std::vector<NAME_SPELLING>& rgSpellings,
+  __in const std::vector<const ACCOUNT_IDENTITY*>& rgpExpected,
+  __in ULONGLONG cNames,
+  __inout ULONGLONG* pcFailures
+)
+{
+  LARGE_INTEGER liFrequency;
+  LARGE_INTEGER liStart;
+  LARGE_INTEGER liEnd;
+  QueryPerformanceFrequency(&liFrequency);
+  QueryPerformanceCounter(&liStart);
+
+  size_t iSpelling = 0;
+  for (ULONGLONG i = 0; i < cNames; i++)
+  {
+    const NAME_SPELLING& rns = rgSpellings[iSpelling];
+    const ACCOUNT_IDENTITY* pIdentity;
+    if (CSR_OK != _Intern(rns, &pIdentity) || pIdentity != rgpExpected[rns.iAccount])
+    {
+      (*pcFailures)++;
+    }
+    if (++iSpelling == rgSpellings.size())
+    {
+      iSpelling = 0;
+    }
+  }
+
+  QueryPerformanceCounter(&liEnd);
+  return (double)(liEnd.QuadPart - liStart.QuadPart) * 1e9 / liFrequency.QuadPart;
+}
+
+static bool _ParseNamesOptions(
+  __in int argc,
+  __in_ecount(argc) wchar_t* argv[],
+  __out ULONGLONG* pcNames,
+  __out DWORD* pcAccounts
+)
+{
+  *pcNames = 4000000;
+  *pcAccounts = 1000;
+
+  if (0 != argc % 2)
+  {
+    return false;
+  }
+  for (int i = 0; i < argc; i += 2)
+  {
+    if (0 == lstrcmpiW(argv[i], L"-names"))
+    {
+      *pcNames = _wcstoui64(argv[i + 1], NULL, 0);
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-accounts"))
+    {
+      *pcAccounts = wcstoul(argv[i + 1], NULL, 0);
+    }
+    else
+    {
+      return false;
+    }
+  }
+  // Two identities an account, and the table holds ACCOUNT_NAME_MAX_IDENTITIES.
+  return *pcNames > 0 && *pcAccounts >= 8 && *pcAccounts <= ACCOUNT_NAME_MAX_IDENTITIES / 2;
+}
+
+int BenchNamesCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  ULONGLONG cNames;
+  DWORD cAccounts;
+  if (!_ParseNamesOptions(argc, argv, &cNames, &cAccounts))
+  {
+    wprintf(L"usage: CredentialTool bench-names [-names n] [-accounts n]\n"
+            L"\n"
+            L"Interns -names account names, spelled every way SetSerialization might spell\n"
+            L"them, for -accounts accounts (default 4000000 names, 1000 accounts; from 8 to %u\n"
+            L"accounts).\n", ACCOUNT_NAME_MAX_IDENTITIES / 2);
+    return 2;
+  }
+
+  // Even accounts are on the domain and odd ones local; every eighth has a u with an umlaut
+  // in its name.
+  std::vector<NAME_SPELLING> rgAscii;
+  std::vector<NAME_SPELLING> rgNonAscii;
+  for (DWORD i = 0; i < cAccounts; i++)
+  {
+    WCHAR wszUsername[32];
+    StringCchPrintfW(wszUsername, ARRAYSIZE(wszUsername), (0 == i % 8) ? L"J\x00fcrgen%u" : L"User%u", i);
+    _AddSpellings(wszUsername, 0 != i % 2, i * 2, (0 == i % 8) ? &rgNonAscii : &rgAscii);
+  }
+
+  // The first spelling of each identity decides what it is.  None of them may come out as
+  // an identity another account already has.
+  ULONGLONG cFailures = 0;
+  std::vector<const ACCOUNT_IDENTITY*> rgpExpected(cAccounts * 2, NULL);
+  std::vector<NAME_SPELLING>* rgpPools[] = { &rgAscii, &rgNonAscii };
+  for (size_t iPool = 0; iPool < ARRAYSIZE(rgpPools); iPool++)
+  {
+    for (size_t i = 0; i < rgpPools[iPool]->size(); i++)
+    {
+      const NAME_SPELLING& rns = (*rgpPools[iPool])[i];
+      if (!rgpExpected[rns.iAccount])
+      {
+        ACCOUNT_NAME_STATS statsBefore;
+        ACCOUNT_NAME_STATS statsAfter;
+        AccountNameGetStats(&statsBefore);
+        if (CSR_OK != _Intern(rns, &rgpExpected[rns.iAccount]))
+        {
+          wprintf(L"could not intern %s\\%s\n", rns.strDomain.c_str(), rns.strUsername.c_str());
+          AccountNameShutdown();
+          return 1;
+        }
+        AccountNameGetStats(&statsAfter);
+        if (statsAfter.cIdentities != statsBefore.cIdentities + 1)
+        {
+          wprintf(L"%s\\%s is the same identity as another account\n", rns.strDomain.c_str(), rns.strUsername.c_str());
+          cFailures++;
+        }
+      }
+    }
+  }
+
+  // What each pool gets of the names, in proportion to its size.
+  ULONGLONG cNonAsciiNames = cNames * rgNonAscii.size() / (rgAscii.size() + rgNonAscii.size());
+  ULONGLONG cAsciiNames = cNames - cNonAsciiNames;
+  double dAsciiNs = _TimeNames(rgAscii, rgpExpected, cAsciiNames, &cFailures);
+  double dNonAsciiNs = cNonAsciiNames ? _TimeNames(rgNonAscii, rgpExpected, cNonAsciiNames, &cFailures) : 0.0;
+
+  wprintf(L"%u accounts, %Iu spellings\n", cAccounts, rgAscii.size() + rgNonAscii.size());
+  wprintf(L"ASCII: %I64u names, %.1f ns/name\n", cAsciiNames, dAsciiNs / cAsciiNames);
+  wprintf(L"non-ASCII: %I64u names, %.1f ns/name\n", cNonAsciiNames, cNonAsciiNames ? dNonAsciiNs / cNonAsciiNames : 0.0);
+
+  ACCOUNT_NAME_STATS stats;
+  AccountNameGetStats(&stats);
+  wprintf(L"%u identities interned, %I64u bytes (%.1f per identity)\n",
+    stats.cIdentities, stats.cbIdentities, stats.cIdentities ? (double)stats.cbIdentities / stats.cIdentities : 0.0);
+  AccountNameShutdown();
+
+  if (cFailures)
+  {
+    wprintf(L"FAILED: %I64u names came out as the wrong identity\n", cFailures);
+    return 1;
+  }
+  return 0;
+}
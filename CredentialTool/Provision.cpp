@@ -0,0 +1,900 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// provision: turns a manifest of machines, and the account each one logs on as, into the
+// credential stores the provider reads.
+//
+// Usage: CredentialTool provision -manifest file -out directory (-key file | -plaintext)
+//                                  [-shards n] [-threads n]
+//
+// The manifest is UTF-8 text with one machine per line:
+//
+//     machine<TAB>domain<TAB>user<TAB>password
+//
+// Blank lines and lines starting with '#' are skipped.  Each machine should appear once.
+//
+// Without -shards, every machine gets a store of its own, out\<machine>.txt, to be copied
+// to CREDENTIAL_STORE_PATH on that machine.  With -shards n, the records are spread over n
+// sharded stores, out\shard-NNNNN.txt (see CredentialStore.h); those can be pushed to a
+// directory on every machine, with the ShardDirectory and ShardCount settings pointing at
+// it.  Either way out\index.txt lists each machine, the file its record went to and the
+// SHA-256 of the record, so a deployment can be checked without reading passwords back.
+//
+// With -key (a key from new-key), the stores are sealed (see SealedStore.h): every record
+// is encrypted with AES-GCM under the key, and the files are out\<machine>.sealed or
+// out\shard-NNNNN.sealed.  The index then hashes the sealed records, never the plaintext.
+// Stores that leave the passwords readable, out\<machine>.txt or out\shard-NNNNN.txt, are
+// only written when -plaintext asks for them.
+//
+// The manifest is read and the stores are written PROVISION_BATCH_SIZE entries at a time,
+// so memory use does not grow with the size of the fleet.  Within a batch, entries are
+// validated, encoded and hashed by ProvisionEncoder.cpp (and per-machine stores written) on
+// a private thread pool, whose workers take PROVISION_CHUNK_SIZE entries at a time from a
+// shared counter until the batch runs out.  Sharded stores and the index are then appended
+// to in manifest order.  ProviderTests provision-scale times the encoding of a million
+// entries the same way.
+
+#ifndef WIN32_NO_STATUS
+#include <ntstatus.h>
+#define WIN32_NO_STATUS
+#endif
+#include <windows.h>
+#include <bcrypt.h>
+#include <strsafe.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "CredentialTool.h"
+#include "CredentialStore.h"
+#include "SealedStore.h"
+#include "ProvisionEncoder.h"
+
+#define PROVISION_BATCH_SIZE 4096       // manifest entries in memory at once
+#define PROVISION_CHUNK_SIZE 64         // entries a worker takes at a time
+#define PROVISION_MAX_SHARDS 10000      // CREDENTIAL_SHARD_FILE_FORMAT has room for five digits
+
+struct PROVISION_OPTIONS
+{
+  PCWSTR pwzManifest;
+  PCWSTR pwzOut;
+  DWORD cShards;        // 0 for a store per machine
+  DWORD cThreads;
+  PCWSTR pwzKey;        // NULL for plaintext stores
+  bool fPlaintext;      // -plaintext, without which plaintext stores are refused
+};
+
+// A manifest entry in the current batch, and why its own store could not be written.
+struct PROVISION_BATCH_ENTRY : PROVISION_ENTRY
+{
+  HRESULT hrWrite;
+};
+
+static HRESULT _WriteAll(__in HANDLE hFile, __in_bcount(cb) const void* pv, __in size_t cb)
+{
+  const BYTE* pb = static_cast<const BYTE*>(pv);
+  while (cb > 0)
+  {
+    DWORD cbChunk = (DWORD)min(cb, (size_t)(1024 * 1024));
+    DWORD cbWritten;
+    if (!WriteFile(hFile, pb, cbChunk, &cbWritten, NULL))
+    {
+      return HRESULT_FROM_WIN32(GetLastError());
+    }
+    pb += cbWritten;
+    cb -= cbWritten;
+  }
+  return S_OK;
+}
+
+// Converts a wide string with no characters outside ASCII (file names, the shard header).
+static void _AppendAscii(__in PCWSTR pwz, __inout std::string* ps)
+{
+  for (; *pwz; pwz++)
+  {
+    ps->push_back((char)*pwz);
+  }
+}
+
+// Seals records with a key from new-key.  Each work callback has one of its own, with a
+// key object of its own, rather than sharing one across threads.
+class CProvisionSealer : public IProvisionSealer
+{
+public:
+  CProvisionSealer(__in_bcount(SEALED_STORE_KEY_FILE_SIZE) const BYTE* pbKeyFile) :
+    _pbKeyFile(pbKeyFile),
+    _hKey(NULL)
+  {
+  }
+
+  ~CProvisionSealer()
+  {
+    if (_hKey)
+    {
+      BCryptDestroyKey(_hKey);
+    }
+  }
+
+  // Takes a copy of hKey.  If that fails, every record sealed fails too.
+  void Initialize(__in BCRYPT_KEY_HANDLE hKey)
+  {
+    if (!BCRYPT_SUCCESS(BCryptDuplicateKey(hKey, &_hKey, NULL, 0, 0)))
+    {
+      _hKey = NULL;
+    }
+  }
+
+  const unsigned char* KeyId()
+  {
+    return _pbKeyFile;
+  }
+
+  bool Seal(const unsigned char* pbAad, const unsigned char* pb, size_t cb, unsigned char* pbSealed)
+  {
+    // Random nonces: with a 96-bit nonce, one key can seal billions of records before a
+    // repeat becomes a concern.
+    NTSTATUS status = _hKey ? BCryptGenRandom(NULL, pbSealed, SEALED_STORE_NONCE_SIZE, BCRYPT_USE_SYSTEM_PREFERRED_RNG) : STATUS_NO_MEMORY;
+    if (BCRYPT_SUCCESS(status))
+    {
+      BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO acmi;
+      BCRYPT_INIT_AUTH_MODE_INFO(acmi);
+      acmi.pbNonce = pbSealed;
+      acmi.cbNonce = SEALED_STORE_NONCE_SIZE;
+      acmi.pbAuthData = const_cast<PUCHAR>(pbAad);
+      acmi.cbAuthData = SEALED_STORE_AAD_SIZE;
+      acmi.pbTag = pbSealed + SEALED_STORE_NONCE_SIZE + cb;
+      acmi.cbTag = SEALED_STORE_TAG_SIZE;
+
+      ULONG cbCiphertext;
+      status = BCryptEncrypt(_hKey, const_cast<PUCHAR>(pb), (ULONG)cb, &acmi, NULL, 0,
+        pbSealed + SEALED_STORE_NONCE_SIZE, (ULONG)cb, &cbCiphertext, 0);
+    }
+    return BCRYPT_SUCCESS(status);
+  }
+
+private:
+  const BYTE* _pbKeyFile;                           // key id, then key
+  BCRYPT_KEY_HANDLE _hKey;
+};
+
+// Reads the manifest a line at a time through a fixed buffer.
+class CManifestReader
+{
+public:
+  CManifestReader() : _hFile(INVALID_HANDLE_VALUE), _ib(0), _cb(0), _fEnd(false), _fFirstLine(true)
+  {
+  }
+
+  ~CManifestReader()
+  {
+    if (_hFile != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(_hFile);
+    }
+    SecureZeroMemory(_rgb, sizeof(_rgb));
+  }
+
+  HRESULT Open(__in PCWSTR pwzPath)
+  {
+    _hFile = CreateFileW(pwzPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    return (_hFile != INVALID_HANDLE_VALUE) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  }
+
+  // Reads the next line, without its line ending, into *pLine.  Returns S_FALSE at the end
+  // of the file.
+  HRESULT ReadLine(__inout std::string* pLine)
+  {
+    ProvisionWipe(pLine);
+    for (;;)
+    {
+      if (_ib == _cb)
+      {
+        if (_fEnd)
+        {
+          return pLine->empty() ? S_FALSE : _EndLine(pLine);
+        }
+
+        DWORD cbRead;
+        if (!ReadFile(_hFile, _rgb, sizeof(_rgb), &cbRead, NULL))
+        {
+          return HRESULT_FROM_WIN32(GetLastError());
+        }
+        _ib = 0;
+        _cb = cbRead;
+        _fEnd = (0 == cbRead);
+        continue;
+      }
+
+      const BYTE* pbStart = _rgb + _ib;
+      const BYTE* pbNewline = static_cast<const BYTE*>(memchr(pbStart, '\n', _cb - _ib));
+      const BYTE* pbEnd = pbNewline ? pbNewline : _rgb + _cb;
+      if (pLine->size() + (pbEnd - pbStart) > PROVISION_MAX_LINE)
+      {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+      }
+      pLine->append(reinterpret_cast<const char*>(pbStart), pbEnd - pbStart);
+      _ib = (DWORD)(pbEnd - _rgb);
+
+      if (pbNewline)
+      {
+        _ib++;
+        return _EndLine(pLine);
+      }
+    }
+  }
+
+private:
+  HRESULT _EndLine(__inout std::string* pLine)
+  {
+    if (!pLine->empty() && pLine->back() == '\r')
+    {
+      pLine->pop_back();
+    }
+    if (_fFirstLine && 0 == pLine->compare(0, 3, "\xEF\xBB\xBF"))
+    {
+      pLine->erase(0, 3);
+    }
+    _fFirstLine = false;
+    return S_OK;
+  }
+
+  HANDLE _hFile;
+  BYTE _rgb[64 * 1024];
+  DWORD _ib;
+  DWORD _cb;
+  bool _fEnd;
+  bool _fFirstLine;
+};
+
+class CProvisioner
+{
+public:
+  CProvisioner(__in const PROVISION_OPTIONS& opt) :
+    _opt(opt),
+    _hAes(NULL),
+    _hKey(NULL),
+    _pPool(NULL),
+    _pWork(NULL),
+    _hIndex(INVALID_HANDLE_VALUE),
+    _cEntries(0),
+    _iNextChunk(0),
+    _cProvisioned(0),
+    _cRejected(0)
+  {
+    ZeroMemory(_rgbKeyFile, sizeof(_rgbKeyFile));
+    InitializeThreadpoolEnvironment(&_env);
+  }
+
+  ~CProvisioner()
+  {
+    if (_pWork)
+    {
+      CloseThreadpoolWork(_pWork);
+    }
+    if (_pPool)
+    {
+      CloseThreadpool(_pPool);
+    }
+    DestroyThreadpoolEnvironment(&_env);
+
+    for (size_t i = 0; i < _rgEntries.size(); i++)
+    {
+      ProvisionWipe(&_rgEntries[i].line);
+      ProvisionWipe(&_rgEntries[i].record);
+      ProvisionWipe(&_rgEntries[i].sealed);
+    }
+    ProvisionWipe(&_shardRun);
+    SecureZeroMemory(_rgbKeyFile, sizeof(_rgbKeyFile));
+
+    for (size_t i = 0; i < _rghShards.size(); i++)
+    {
+      if (_rghShards[i] != INVALID_HANDLE_VALUE)
+      {
+        CloseHandle(_rghShards[i]);
+      }
+    }
+    if (_hIndex != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(_hIndex);
+    }
+    if (_hKey)
+    {
+      BCryptDestroyKey(_hKey);
+    }
+    if (_hAes)
+    {
+      BCryptCloseAlgorithmProvider(_hAes, 0);
+    }
+  }
+
+  HRESULT Initialize();
+  HRESULT Run();
+  HRESULT Finish();
+
+  DWORD GetProvisionedCount() const { return _cProvisioned; }
+  DWORD GetRejectedCount() const { return _cRejected; }
+
+private:
+  static VOID CALLBACK s_WorkCallback(PTP_CALLBACK_INSTANCE pInstance, PVOID pvContext, PTP_WORK pWork);
+
+  HRESULT _CreateOutputFile(__in PCWSTR pwzName, __out HANDLE* phFile);
+  HRESULT _InitializeKey();
+  void _WriteMachineStore(__inout PROVISION_BATCH_ENTRY* pEntry);
+  HRESULT _WriteBatch();
+
+  const PROVISION_OPTIONS& _opt;
+  BCRYPT_ALG_HANDLE _hAes;                          // AES-GCM, for sealed stores
+  BCRYPT_KEY_HANDLE _hKey;
+  BYTE _rgbKeyFile[SEALED_STORE_KEY_FILE_SIZE];     // key id, then key
+  PTP_POOL _pPool;
+  TP_CALLBACK_ENVIRON _env;
+  PTP_WORK _pWork;
+  std::vector<HANDLE> _rghShards;
+  HANDLE _hIndex;
+
+  // Sealed shards: how much of each has been written, and the index entries for what has.
+  std::vector<unsigned long long> _rgullShardSizes;
+  std::vector<std::vector<SEALED_STORE_INDEX_ENTRY>> _rgShardIndexes;
+
+  // The current batch.  Entries (and the strings in them) are reused from batch to batch.
+  std::vector<PROVISION_BATCH_ENTRY> _rgEntries;
+  DWORD _cEntries;
+  volatile LONG _iNextChunk;
+
+  std::vector<DWORD> _rgiByShard;
+  std::string _shardRun;
+  std::string _indexRun;
+
+  DWORD _cProvisioned;
+  DWORD _cRejected;
+};
+
+HRESULT CProvisioner::_CreateOutputFile(__in PCWSTR pwzName, __out HANDLE* phFile)
+{
+  WCHAR wszPath[MAX_PATH];
+  HRESULT hr = StringCchPrintfW(wszPath, ARRAYSIZE(wszPath), L"%s\\%s", _opt.pwzOut, pwzName);
+  if (SUCCEEDED(hr))
+  {
+    *phFile = CreateFileW(wszPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == *phFile)
+    {
+      hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+  }
+  return hr;
+}
+
+HRESULT CProvisioner::_InitializeKey()
+{
+  HRESULT hr = ReadKeyFile(_opt.pwzKey, _rgbKeyFile);
+  if (SUCCEEDED(hr))
+  {
+    NTSTATUS status = BCryptOpenAlgorithmProvider(&_hAes, BCRYPT_AES_ALGORITHM, NULL, 0);
+    if (BCRYPT_SUCCESS(status))
+    {
+      status = BCryptSetProperty(_hAes, BCRYPT_CHAINING_MODE, (PUCHAR)BCRYPT_CHAIN_MODE_GCM, sizeof(BCRYPT_CHAIN_MODE_GCM), 0);
+    }
+    else
+    {
+      _hAes = NULL;
+    }
+    if (BCRYPT_SUCCESS(status))
+    {
+      status = BCryptGenerateSymmetricKey(_hAes, &_hKey, NULL, 0,
+        _rgbKeyFile + SEALED_STORE_KEY_ID_SIZE, SEALED_STORE_KEY_SIZE, 0);
+    }
+    hr = BCRYPT_SUCCESS(status) ? S_OK : HRESULT_FROM_NT(status);
+  }
+  return hr;
+}
+
+HRESULT CProvisioner::Initialize()
+{
+  HRESULT hr = S_OK;
+  if (!CreateDirectoryW(_opt.pwzOut, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+  {
+    hr = HRESULT_FROM_WIN32(GetLastError());
+  }
+
+  if (SUCCEEDED(hr) && _opt.pwzKey)
+  {
+    hr = _InitializeKey();
+  }
+
+  if (SUCCEEDED(hr))
+  {
+    _pPool = CreateThreadpool(NULL);
+    hr = _pPool ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  }
+  if (SUCCEEDED(hr))
+  {
+    SetThreadpoolThreadMaximum(_pPool, _opt.cThreads);
+    if (!SetThreadpoolThreadMinimum(_pPool, 1))
+    {
+      hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+  }
+  if (SUCCEEDED(hr))
+  {
+    SetThreadpoolCallbackPool(&_env, _pPool);
+    _pWork = CreateThreadpoolWork(s_WorkCallback, this, &_env);
+    hr = _pWork ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  }
+
+  if (SUCCEEDED(hr))
+  {
+    try
+    {
+      _rgEntries.resize(PROVISION_BATCH_SIZE);
+      for (size_t i = 0; i < _rgEntries.size(); i++)
+      {
+        ProvisionReserveEntry(&_rgEntries[i]);
+      }
+      _rgiByShard.reserve(PROVISION_BATCH_SIZE);
+      _rghShards.resize(_opt.cShards, INVALID_HANDLE_VALUE);
+      if (_opt.pwzKey)
+      {
+        _rgullShardSizes.resize(_opt.cShards, SEALED_STORE_HEADER_SIZE);
+        _rgShardIndexes.resize(_opt.cShards);
+      }
+    }
+    catch (const std::bad_alloc&)
+    {
+      hr = E_OUTOFMEMORY;
+    }
+  }
+
+  // Every shard is rewritten, including any that end up with no machines in them, so that
+  // nothing is left over from an earlier run.  A sealed shard's header is only a
+  // placeholder until Finish knows where its index goes.
+  std::string header;
+  if (_opt.pwzKey)
+  {
+    header.assign(SEALED_STORE_HEADER_SIZE, '\0');
+  }
+  else
+  {
+    _AppendAscii(CREDENTIAL_SHARD_HEADER L"\r\n", &header);
+  }
+  for (DWORD i = 0; SUCCEEDED(hr) && i < _opt.cShards; i++)
+  {
+    WCHAR wszShard[MAX_PATH];
+    hr = StringCchPrintfW(wszShard, ARRAYSIZE(wszShard), _opt.pwzKey ? SEALED_SHARD_FILE_FORMAT : CREDENTIAL_SHARD_FILE_FORMAT, (unsigned long)i);
+    if (SUCCEEDED(hr))
+    {
+      hr = _CreateOutputFile(wszShard, &_rghShards[i]);
+    }
+    if (SUCCEEDED(hr))
+    {
+      hr = _WriteAll(_rghShards[i], header.data(), header.size());
+    }
+  }
+
+  if (SUCCEEDED(hr))
+  {
+    hr = _CreateOutputFile(L"index.txt", &_hIndex);
+  }
+  if (SUCCEEDED(hr))
+  {
+    static const char s_szIndexHeader[] = "# machine\tfile\tSHA-256 of record\r\n";
+    hr = _WriteAll(_hIndex, s_szIndexHeader, sizeof(s_szIndexHeader) - 1);
+  }
+  return hr;
+}
+
+VOID CALLBACK CProvisioner::s_WorkCallback(PTP_CALLBACK_INSTANCE pInstance, PVOID pvContext, PTP_WORK pWork)
+{
+  UNREFERENCED_PARAMETER(pInstance);
+  UNREFERENCED_PARAMETER(pWork);
+
+  CProvisioner* pThis = static_cast<CProvisioner*>(pvContext);
+
+  // Each callback seals with a sealer of its own.
+  CProvisionSealer sealer(pThis->_rgbKeyFile);
+  IProvisionSealer* pSealer = NULL;
+  if (pThis->_hKey)
+  {
+    sealer.Initialize(pThis->_hKey);
+    pSealer = &sealer;
+  }
+
+  for (;;)
+  {
+    DWORD iFirst = (DWORD)(InterlockedIncrement(&pThis->_iNextChunk) - 1) * PROVISION_CHUNK_SIZE;
+    if (iFirst >= pThis->_cEntries)
+    {
+      break;
+    }
+
+    DWORD iEnd = min(iFirst + PROVISION_CHUNK_SIZE, pThis->_cEntries);
+    for (DWORD i = iFirst; i < iEnd; i++)
+    {
+      PROVISION_BATCH_ENTRY* pEntry = &pThis->_rgEntries[i];
+      pEntry->hrWrite = S_OK;
+      if (ProvisionEncodeEntry(pThis->_opt.cShards, pSealer, pEntry) && 0 == pThis->_opt.cShards)
+      {
+        pThis->_WriteMachineStore(pEntry);
+      }
+    }
+  }
+}
+
+void CProvisioner::_WriteMachineStore(__inout PROVISION_BATCH_ENTRY* pEntry)
+{
+  WCHAR wszName[MAX_COMPUTERNAME_LENGTH + 8];
+  HANDLE hFile = INVALID_HANDLE_VALUE;
+  HRESULT hr = StringCchPrintfW(wszName, ARRAYSIZE(wszName), _opt.pwzKey ? L"%s.sealed" : L"%s.txt", pEntry->wszMachine);
+  if (SUCCEEDED(hr))
+  {
+    hr = _CreateOutputFile(wszName, &hFile);
+  }
+  if (SUCCEEDED(hr))
+  {
+    if (_opt.pwzKey)
+    {
+      // A sealed store of one record: header, the record, and an index of one entry.
+      SEALED_STORE_HEADER hdr;
+      hdr.ulMagic = SEALED_STORE_MAGIC;
+      hdr.ulVersion = SEALED_STORE_VERSION;
+      CopyMemory(hdr.rgbKeyId, _rgbKeyFile, SEALED_STORE_KEY_ID_SIZE);
+      hdr.cRecords = 1;
+      hdr.ullIndexOffset = SEALED_STORE_HEADER_SIZE + pEntry->record.size();
+
+      SEALED_STORE_INDEX_ENTRY entry;
+      entry.ulMachineHash = pEntry->ulMachineHash;
+      entry.cbRecord = (unsigned long)pEntry->record.size();
+      entry.ullOffset = SEALED_STORE_HEADER_SIZE;
+
+      BYTE rgbHeader[SEALED_STORE_HEADER_SIZE];
+      BYTE rgbEntry[SEALED_STORE_INDEX_ENTRY_SIZE];
+      SealedStoreEncodeHeader(hdr, rgbHeader);
+      SealedStoreEncodeIndexEntry(entry, rgbEntry);
+      hr = _WriteAll(hFile, rgbHeader, sizeof(rgbHeader));
+      if (SUCCEEDED(hr))
+      {
+        hr = _WriteAll(hFile, pEntry->record.data(), pEntry->record.size());
+      }
+      if (SUCCEEDED(hr))
+      {
+        hr = _WriteAll(hFile, rgbEntry, sizeof(rgbEntry));
+      }
+    }
+    else
+    {
+      hr = _WriteAll(hFile, pEntry->record.data(), pEntry->record.size());
+    }
+    CloseHandle(hFile);
+  }
+
+  if (FAILED(hr))
+  {
+    pEntry->pwzError = L"could not be written to its store";
+    pEntry->prError = PR_IO_ERROR;
+    pEntry->hrWrite = hr;
+  }
+}
+
+// Appends the batch to the sharded stores and the index, in manifest order, and reports
+// the entries that were rejected.
+HRESULT CProvisioner::_WriteBatch()
+{
+  HRESULT hr = S_OK;
+
+  if (_opt.cShards > 0)
+  {
+    // One write per shard per batch: order the batch by shard, keeping manifest order
+    // within each.
+    _rgiByShard.resize(_cEntries);
+    for (DWORD i = 0; i < _cEntries; i++)
+    {
+      _rgiByShard[i] = i;
+    }
+    std::stable_sort(_rgiByShard.begin(), _rgiByShard.end(),
+      [this](DWORD i, DWORD j) { return _rgEntries[i].iShard < _rgEntries[j].iShard; });
+
+    for (DWORD i = 0; SUCCEEDED(hr) && i < _cEntries; i++)
+    {
+      const PROVISION_BATCH_ENTRY& entry = _rgEntries[_rgiByShard[i]];
+      if (!entry.pwzError)
+      {
+        if (_opt.pwzKey)
+        {
+          SEALED_STORE_INDEX_ENTRY indexEntry;
+          indexEntry.ulMachineHash = entry.ulMachineHash;
+          indexEntry.cbRecord = (unsigned long)entry.record.size();
+          indexEntry.ullOffset = _rgullShardSizes[entry.iShard] + _shardRun.size();
+          _rgShardIndexes[entry.iShard].push_back(indexEntry);
+        }
+        _shardRun.append(entry.record);
+      }
+
+      bool fLastOfShard = (i + 1 == _cEntries) || (_rgEntries[_rgiByShard[i + 1]].iShard != entry.iShard);
+      if (fLastOfShard && !_shardRun.empty())
+      {
+        hr = _WriteAll(_rghShards[entry.iShard], _shardRun.data(), _shardRun.size());
+        if (_opt.pwzKey)
+        {
+          _rgullShardSizes[entry.iShard] += _shardRun.size();
+        }
+        ProvisionWipe(&_shardRun);
+      }
+    }
+  }
+
+  for (DWORD i = 0; SUCCEEDED(hr) && i < _cEntries; i++)
+  {
+    const PROVISION_BATCH_ENTRY& entry = _rgEntries[i];
+    if (entry.pwzError)
+    {
+      if (SUCCEEDED(entry.hrWrite))
+      {
+        fwprintf(stderr, L"%s(%u): entry %s\n", _opt.pwzManifest, entry.ulLine, entry.pwzError);
+      }
+      else
+      {
+        fwprintf(stderr, L"%s(%u): entry %s: 0x%08x\n", _opt.pwzManifest, entry.ulLine, entry.pwzError, entry.hrWrite);
+      }
+      _cRejected++;
+      continue;
+    }
+
+    static const char s_szHex[] = "0123456789abcdef";
+    size_t cchMachine = entry.line.find('\t');
+    _indexRun.append(entry.line, 0, cchMachine);
+    _indexRun.push_back('\t');
+    if (_opt.cShards > 0)
+    {
+      WCHAR wszShard[MAX_PATH];
+      hr = StringCchPrintfW(wszShard, ARRAYSIZE(wszShard), _opt.pwzKey ? SEALED_SHARD_FILE_FORMAT : CREDENTIAL_SHARD_FILE_FORMAT, entry.iShard);
+      _AppendAscii(wszShard, &_indexRun);
+    }
+    else
+    {
+      // The machine name may be more than ASCII; take it from the manifest as it was.
+      _indexRun.append(entry.line, 0, cchMachine);
+      _indexRun.append(_opt.pwzKey ? ".sealed" : ".txt");
+    }
+    _indexRun.push_back('\t');
+    for (size_t j = 0; j < ARRAYSIZE(entry.rgbHash); j++)
+    {
+      _indexRun.push_back(s_szHex[entry.rgbHash[j] >> 4]);
+      _indexRun.push_back(s_szHex[entry.rgbHash[j] & 0xF]);
+    }
+    _indexRun.append("\r\n");
+    _cProvisioned++;
+  }
+
+  if (SUCCEEDED(hr))
+  {
+    hr = _WriteAll(_hIndex, _indexRun.data(), _indexRun.size());
+  }
+  _indexRun.clear();
+  return hr;
+}
+
+HRESULT CProvisioner::Run()
+{
+  CManifestReader reader;
+  HRESULT hr = reader.Open(_opt.pwzManifest);
+  DWORD dwLine = 0;
+  bool fEnd = false;
+
+  while (SUCCEEDED(hr) && !fEnd)
+  {
+    _cEntries = 0;
+    while (_cEntries < PROVISION_BATCH_SIZE)
+    {
+      PROVISION_BATCH_ENTRY& entry = _rgEntries[_cEntries];
+      hr = reader.ReadLine(&entry.line);
+      if (hr != S_OK)
+      {
+        fEnd = (S_FALSE == hr);
+        break;
+      }
+
+      dwLine++;
+      if (!entry.line.empty() && entry.line[0] != '#')
+      {
+        entry.ulLine = dwLine;
+        _cEntries++;
+      }
+    }
+
+    if (FAILED(hr))
+    {
+      fwprintf(stderr, L"%s(%u): could not read the manifest: 0x%08x\n", _opt.pwzManifest, dwLine + 1, hr);
+    }
+    else if (_cEntries > 0)
+    {
+      DWORD cChunks = (_cEntries + PROVISION_CHUNK_SIZE - 1) / PROVISION_CHUNK_SIZE;
+      DWORD cSubmits = min(cChunks, _opt.cThreads);
+      _iNextChunk = 0;
+      for (DWORD i = 0; i < cSubmits; i++)
+      {
+        SubmitThreadpoolWork(_pWork);
+      }
+      WaitForThreadpoolWorkCallbacks(_pWork, FALSE);
+
+      hr = _WriteBatch();
+      for (DWORD i = 0; i < _cEntries; i++)
+      {
+        ProvisionWipe(&_rgEntries[i].line);
+        ProvisionWipe(&_rgEntries[i].record);
+      }
+    }
+    else
+    {
+      hr = S_OK;
+    }
+  }
+  return hr;
+}
+
+// Completes the sealed shards: each gets its index, sorted by machine hash, and then its
+// real header.  Plaintext stores need nothing more.
+HRESULT CProvisioner::Finish()
+{
+  HRESULT hr = S_OK;
+  for (DWORD i = 0; SUCCEEDED(hr) && _opt.pwzKey && i < _opt.cShards; i++)
+  {
+    std::vector<SEALED_STORE_INDEX_ENTRY>& rgIndex = _rgShardIndexes[i];
+    std::sort(rgIndex.begin(), rgIndex.end(),
+      [](const SEALED_STORE_INDEX_ENTRY& a, const SEALED_STORE_INDEX_ENTRY& b) { return a.ulMachineHash < b.ulMachineHash; });
+
+    try
+    {
+      std::string index;
+      index.resize(rgIndex.size() * SEALED_STORE_INDEX_ENTRY_SIZE);
+      for (size_t j = 0; j < rgIndex.size(); j++)
+      {
+        SealedStoreEncodeIndexEntry(rgIndex[j], reinterpret_cast<unsigned char*>(&index[j * SEALED_STORE_INDEX_ENTRY_SIZE]));
+      }
+      hr = _WriteAll(_rghShards[i], index.data(), index.size());
+    }
+    catch (const std::bad_alloc&)
+    {
+      hr = E_OUTOFMEMORY;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+      SEALED_STORE_HEADER hdr;
+      hdr.ulMagic = SEALED_STORE_MAGIC;
+      hdr.ulVersion = SEALED_STORE_VERSION;
+      CopyMemory(hdr.rgbKeyId, _rgbKeyFile, SEALED_STORE_KEY_ID_SIZE);
+      hdr.cRecords = (unsigned long)rgIndex.size();
+      hdr.ullIndexOffset = _rgullShardSizes[i];
+
+      BYTE rgbHeader[SEALED_STORE_HEADER_SIZE];
+      SealedStoreEncodeHeader(hdr, rgbHeader);
+
+      LARGE_INTEGER liStart = {};
+      hr = SetFilePointerEx(_rghShards[i], liStart, NULL, FILE_BEGIN) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+      if (SUCCEEDED(hr))
+      {
+        hr = _WriteAll(_rghShards[i], rgbHeader, sizeof(rgbHeader));
+      }
+    }
+  }
+  return hr;
+}
+
+static bool _ParseOptions(__in int argc, __in_ecount(argc) wchar_t* argv[], __out PROVISION_OPTIONS* popt)
+{
+  popt->pwzManifest = NULL;
+  popt->pwzOut = NULL;
+  popt->cShards = 0;
+  popt->cThreads = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+  popt->pwzKey = NULL;
+  popt->fPlaintext = false;
+
+  for (int i = 0; i < argc; i++)
+  {
+    if (0 == lstrcmpiW(argv[i], L"-plaintext"))
+    {
+      popt->fPlaintext = true;
+      continue;
+    }
+
+    PCWSTR pwzValue = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (!pwzValue)
+    {
+      return false;
+    }
+
+    if (0 == lstrcmpiW(argv[i], L"-manifest"))
+    {
+      popt->pwzManifest = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-out"))
+    {
+      popt->pwzOut = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-shards"))
+    {
+      popt->cShards = wcstoul(pwzValue, NULL, 0);
+      if (0 == popt->cShards || popt->cShards > PROVISION_MAX_SHARDS)
+      {
+        return false;
+      }
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-key"))
+    {
+      popt->pwzKey = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-threads"))
+    {
+      popt->cThreads = wcstoul(pwzValue, NULL, 0);
+      if (0 == popt->cThreads)
+      {
+        return false;
+      }
+    }
+    else
+    {
+      return false;
+    }
+    i++;
+  }
+
+  // Passwords are only written out readable when that is asked for, and never as well as
+  // sealed.
+  return popt->pwzManifest && popt->pwzOut && (NULL != popt->pwzKey) != popt->fPlaintext;
+}
+
+int ProvisionCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  PROVISION_OPTIONS opt;
+  if (!_ParseOptions(argc, argv, &opt))
+  {
+    wprintf(L"usage: CredentialTool provision -manifest file -out directory (-key file | -plaintext)\n"
+            L"                                 [-shards n] [-threads n]\n"
+            L"\n"
+            L"Each manifest line is machine<TAB>domain<TAB>user<TAB>password, in UTF-8.\n"
+            L"With -key, the stores are sealed with a key from new-key; -plaintext writes\n"
+            L"them with the passwords readable instead.  Without -shards, writes a store\n"
+            L"for each machine; with it, spreads the records over n (at most %u) sharded\n"
+            L"stores.\n", PROVISION_MAX_SHARDS);
+    return 2;
+  }
+
+  LARGE_INTEGER liFrequency;
+  LARGE_INTEGER liStart;
+  LARGE_INTEGER liEnd;
+  QueryPerformanceFrequency(&liFrequency);
+  QueryPerformanceCounter(&liStart);
+
+  CProvisioner* pProvisioner = new CProvisioner(opt);
+  HRESULT hr = pProvisioner->Initialize();
+  if (FAILED(hr))
+  {
+    wprintf(L"could not set up %s: 0x%08x\n", opt.pwzOut, hr);
+  }
+  else
+  {
+    hr = pProvisioner->Run();
+    if (SUCCEEDED(hr))
+    {
+      hr = pProvisioner->Finish();
+    }
+    if (FAILED(hr))
+    {
+      wprintf(L"provisioning stopped: 0x%08x\n", hr);
+    }
+  }
+
+  QueryPerformanceCounter(&liEnd);
+  double dSeconds = (double)(liEnd.QuadPart - liStart.QuadPart) / liFrequency.QuadPart;
+  DWORD cProvisioned = pProvisioner->GetProvisionedCount();
+  DWORD cRejected = pProvisioner->GetRejectedCount();
+  wprintf(L"%u machines provisioned, %u entries rejected, in %.2f s (%.0f machines/s)\n",
+    cProvisioned, cRejected, dSeconds, (dSeconds > 0) ? cProvisioned / dSeconds : 0.0);
+
+  delete pProvisioner;
+  return (SUCCEEDED(hr) && 0 == cRejected) ? 0 : 1;
+}
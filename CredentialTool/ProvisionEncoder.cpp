@@ -0,0 +1,246 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <string.h>
+#include <wchar.h>
+#include "ProvisionEncoder.h"
+#include "CredentialStore.h"
+
+// Decodes the UTF-8 character at pch[*pich], advancing *pich past it.  Returns false for
+// anything MultiByteToWideChar's MB_ERR_INVALID_CHARS refuses: bytes that don't start or
+// continue a character, overlong forms, surrogates and code points past U+10FFFF.
+static bool _DecodeUtf8(const char* pch, size_t cch, size_t* pich, unsigned long* pulCodePoint)
+{
+  unsigned char b = (unsigned char)pch[*pich];
+  size_t cbTrail;
+  unsigned long ulMin;
+  unsigned long ul;
+  if (b < 0x80)
+  {
+    *pulCodePoint = b;
+    (*pich)++;
+    return true;
+  }
+  else if (b >= 0xC2 && b <= 0xDF)
+  {
+    cbTrail = 1;
+    ulMin = 0x80;
+    ul = b & 0x1F;
+  }
+  else if (b >= 0xE0 && b <= 0xEF)
+  {
+    cbTrail = 2;
+    ulMin = 0x800;
+    ul = b & 0x0F;
+  }
+  else if (b >= 0xF0 && b <= 0xF4)
+  {
+    cbTrail = 3;
+    ulMin = 0x10000;
+    ul = b & 0x07;
+  }
+  else
+  {
+    return false;
+  }
+
+  if (cch - *pich <= cbTrail)
+  {
+    return false;
+  }
+  for (size_t i = 1; i <= cbTrail; i++)
+  {
+    unsigned char bTrail = (unsigned char)pch[*pich + i];
+    if ((bTrail & 0xC0) != 0x80)
+    {
+      return false;
+    }
+    ul = (ul << 6) | (bTrail & 0x3F);
+  }
+  if (ul < ulMin || ul > 0x10FFFF || (ul >= 0xD800 && ul <= 0xDFFF))
+  {
+    return false;
+  }
+  *pulCodePoint = ul;
+  *pich += cbTrail + 1;
+  return true;
+}
+
+static bool _IsUtf8(const char* pch, size_t cch)
+{
+  unsigned long ulCodePoint;
+  for (size_t ich = 0; ich < cch; )
+  {
+    if (!_DecodeUtf8(pch, cch, &ich, &ulCodePoint))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool _Fail(PROVISION_ENTRY* pEntry, const wchar_t* pwzError, PLATFORM_RESULT pr)
+{
+  pEntry->pwzError = pwzError;
+  pEntry->prError = pr;
+  return false;
+}
+
+// Converts the machine name to UTF-16, as Windows names the machine, so that its hash and
+// shard come out the same wherever the stores are provisioned.
+static bool _SetMachine(const char* pch, size_t cch, PROVISION_ENTRY* pEntry)
+{
+  if (0 == cch)
+  {
+    return _Fail(pEntry, L"has no machine name", PR_BAD_DATA);
+  }
+
+  size_t cchMachine = 0;
+  for (size_t ich = 0; ich < cch; )
+  {
+    unsigned long ulCodePoint;
+    if (!_DecodeUtf8(pch, cch, &ich, &ulCodePoint))
+    {
+      return _Fail(pEntry, L"is not valid UTF-8", PR_BAD_DATA);
+    }
+    size_t cchCodePoint = (ulCodePoint >= 0x10000) ? 2 : 1;
+    if (cchMachine + cchCodePoint > PROVISION_MAX_MACHINE_CCH)
+    {
+      return _Fail(pEntry, L"has a machine name longer than a NetBIOS computer name", PR_BAD_DATA);
+    }
+    if (2 == cchCodePoint)
+    {
+      pEntry->wszMachine[cchMachine++] = (wchar_t)(0xD800 + ((ulCodePoint - 0x10000) >> 10));
+      pEntry->wszMachine[cchMachine++] = (wchar_t)(0xDC00 + ((ulCodePoint - 0x10000) & 0x3FF));
+    }
+    else
+    {
+      pEntry->wszMachine[cchMachine++] = (wchar_t)ulCodePoint;
+    }
+  }
+  pEntry->wszMachine[cchMachine] = L'\0';
+  pEntry->cchMachine = cchMachine;
+
+  if (wcspbrk(pEntry->wszMachine, L"\\/:*?\"<>| \t"))
+  {
+    return _Fail(pEntry, L"has characters in its machine name that a computer name cannot contain", PR_BAD_DATA);
+  }
+  return true;
+}
+
+// Encrypts pEntry->record in place: nonce, ciphertext, tag.
+static bool _SealRecord(IProvisionSealer* pSealer, PROVISION_ENTRY* pEntry)
+{
+  std::string& sealed = pEntry->sealed;
+  size_t cbPlaintext = pEntry->record.size();
+  sealed.assign(SEALED_STORE_NONCE_SIZE + cbPlaintext + SEALED_STORE_TAG_SIZE, '\0');
+
+  unsigned char rgbAad[SEALED_STORE_AAD_SIZE];
+  SealedStoreRecordAad(pSealer->KeyId(), pEntry->ulMachineHash, rgbAad);
+  bool fSealed = pSealer->Seal(rgbAad, reinterpret_cast<const unsigned char*>(pEntry->record.data()), cbPlaintext,
+    reinterpret_cast<unsigned char*>(&sealed[0]));
+
+  // Both strings were reserved for a sealed record, so swapping moves no bytes around.
+  ProvisionWipe(&pEntry->record);
+  pEntry->record.swap(sealed);
+  return fSealed;
+}
+
+void ProvisionReserveEntry(PROVISION_ENTRY* pEntry)
+{
+  pEntry->line.reserve(PROVISION_MAX_LINE);
+  pEntry->record.reserve(PROVISION_MAX_RECORD);
+  pEntry->sealed.reserve(PROVISION_MAX_RECORD);
+}
+
+void ProvisionWipe(std::string* ps)
+{
+  if (!ps->empty())
+  {
+    PlatformSecureZero(&(*ps)[0], ps->size());
+  }
+  ps->clear();
+}
+
+bool ProvisionEncodeEntry(unsigned long cShards, IProvisionSealer* pSealer, PROVISION_ENTRY* pEntry)
+{
+  pEntry->pwzError = NULL;
+  pEntry->prError = PR_OK;
+  pEntry->cchMachine = 0;
+  pEntry->iShard = 0;
+  ProvisionWipe(&pEntry->record);
+
+  const std::string& line = pEntry->line;
+
+  // Machine, domain and user are tab-separated; the password is the rest of the line.
+  size_t rgich[4];
+  size_t rgcch[4];
+  size_t ich = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    size_t ichTab = line.find('\t', ich);
+    if (std::string::npos == ichTab)
+    {
+      return _Fail(pEntry, L"expected a machine, domain, user and password separated by tabs", PR_BAD_DATA);
+    }
+    rgich[i] = ich;
+    rgcch[i] = ichTab - ich;
+    ich = ichTab + 1;
+  }
+  rgich[3] = ich;
+  rgcch[3] = line.size() - ich;
+
+  if (std::string::npos != line.find('\r'))
+  {
+    return _Fail(pEntry, L"contains a carriage return, which would split the record", PR_BAD_DATA);
+  }
+  for (int i = 1; i < 4; i++)
+  {
+    if (!_IsUtf8(line.data() + rgich[i], rgcch[i]))
+    {
+      return _Fail(pEntry, L"is not valid UTF-8", PR_BAD_DATA);
+    }
+  }
+  if (0 == rgcch[2])
+  {
+    return _Fail(pEntry, L"has no user name", PR_BAD_DATA);
+  }
+  if (!_SetMachine(line.data(), rgcch[0], pEntry))
+  {
+    return false;
+  }
+
+  // Shard and sealed records start with the machine they are for.
+  std::string& record = pEntry->record;
+  pEntry->ulMachineHash = CredentialStoreMachineHash(pEntry->wszMachine, pEntry->cchMachine);
+  if (cShards > 0 || pSealer)
+  {
+    record.append(line, 0, rgcch[0]);
+    record.append("\r\n");
+    pEntry->iShard = CredentialStoreShardOf(pEntry->wszMachine, pEntry->cchMachine, cShards);
+  }
+  for (int i = 1; i < 4; i++)
+  {
+    record.append(line, rgich[i], rgcch[i]);
+    record.append("\r\n");
+  }
+
+  if (pSealer && !_SealRecord(pSealer, pEntry))
+  {
+    return _Fail(pEntry, L"could not be sealed", PR_IO_ERROR);
+  }
+
+  PLATFORM_RESULT pr = PlatformSha256(record.data(), record.size(), pEntry->rgbHash);
+  if (PR_OK != pr)
+  {
+    return _Fail(pEntry, L"could not be hashed", pr);
+  }
+  return true;
+}
@@ -0,0 +1,74 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Turns one line of a provision manifest into the record a credential store holds for its
+// machine.  Like RulesCompiler.cpp this is platform-neutral; sealing the record is left to
+// an IProvisionSealer, and reading the manifest and writing the stores to Provision.cpp.
+//
+// A manifest line is machine<TAB>domain<TAB>user<TAB>password, in UTF-8; the password is
+// the rest of the line, tabs and all.  The record is domain, user and password, each
+// followed by CRLF, with the machine's own line first when it goes into a shard or is
+// sealed.
+
+#pragma once
+
+#include <string>
+#include "Platform.h"
+#include "SealedStore.h"
+
+#define PROVISION_MAX_LINE 4096         // longest manifest line accepted, in bytes
+#define PROVISION_MAX_RECORD (PROVISION_MAX_LINE + 8 + SEALED_STORE_NONCE_SIZE + SEALED_STORE_TAG_SIZE)
+
+// The provider finds its record by its NetBIOS name (MAX_COMPUTERNAME_LENGTH UTF-16
+// characters), so a longer machine name could never be looked up.
+#define PROVISION_MAX_MACHINE_CCH 15
+
+// Encrypts records for sealed stores.  Each thread encoding entries seals with one of its
+// own.
+class IProvisionSealer
+{
+public:
+  virtual ~IProvisionSealer() {}
+
+  // The SEALED_STORE_KEY_ID_SIZE-byte id of the key records are sealed with.
+  virtual const unsigned char* KeyId() = 0;
+
+  // Seals cb bytes at pb, authenticating the SEALED_STORE_AAD_SIZE bytes at pbAad too, into
+  // the SEALED_STORE_NONCE_SIZE + cb + SEALED_STORE_TAG_SIZE bytes at pbSealed as nonce,
+  // ciphertext and tag.
+  virtual bool Seal(const unsigned char* pbAad, const unsigned char* pb, size_t cb, unsigned char* pbSealed) = 0;
+};
+
+// One manifest line on its way to a store.
+struct PROVISION_ENTRY
+{
+  unsigned long ulLine;                             // in the manifest, for messages
+  std::string line;                                 // as read, UTF-8
+  wchar_t wszMachine[PROVISION_MAX_MACHINE_CCH + 1];  // in UTF-16 code units on every platform
+  size_t cchMachine;
+  std::string record;                               // what the store holds for this machine
+  std::string sealed;                               // scratch for sealing the record
+  unsigned long ulMachineHash;
+  unsigned long iShard;
+  unsigned char rgbHash[PLATFORM_SHA256_SIZE];      // of the record, sealed if it was
+  const wchar_t* pwzError;                          // NULL if the entry was provisioned
+  PLATFORM_RESULT prError;                          // PR_BAD_DATA if the line itself is wrong
+};
+
+// Sizes the entry's strings once for the longest line and record, so that a password is
+// never left behind in a buffer a string outgrew.
+void ProvisionReserveEntry(PROVISION_ENTRY* pEntry);
+
+// Overwrites the string's characters and empties it, keeping its buffer.
+void ProvisionWipe(std::string* ps);
+
+// Validates pEntry->line and builds pEntry->record, its machine hash, shard and SHA-256
+// from it.  cShards is 0 for a store per machine; pSealer is NULL for plaintext stores.
+// Returns false with pwzError completing a sentence whose subject is the entry, and
+// prError saying whether the line or the platform was at fault.
+bool ProvisionEncodeEntry(unsigned long cShards, IProvisionSealer* pSealer, PROVISION_ENTRY* pEntry);
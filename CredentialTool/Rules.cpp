@@ -0,0 +1,468 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// compile-rules and match-rules: host rules (see RulesCompiler.h for the rules text and
+// HostRules.h for what the provider does with the result).
+//
+// Usage: CredentialTool compile-rules -rules file -out file [-key file]
+//        CredentialTool match-rules -rules file -machine name [-tags tag,...]
+//                                   [-day day] [-time hh:mm] [-key file] [-iterations n]
+//
+// compile-rules writes the compiled rules, sealing the accounts with -key (a key from
+// new-key); point the RulesFile setting at the result.  match-rules evaluates a compiled
+// file the way the provider would, for a machine name, tags and a time (by default the
+// current one), and reports which rule applies and how long an evaluation takes.
+
+#ifndef WIN32_NO_STATUS
+#include <ntstatus.h>
+#define WIN32_NO_STATUS
+#endif
+#include <windows.h>
+#include <bcrypt.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "CredentialTool.h"
+#include "RulesCompiler.h"
+
+#define RULES_MAX_TEXT (256 * 1024 * 1024)
+
+static const PCWSTR s_rgpwzDays[] = { L"sun", L"mon", L"tue", L"wed", L"thu", L"fri", L"sat" };
+
+// Seals account records with a key from new-key.
+class CRulesSealer : public IHostRulesSealer
+{
+public:
+  CRulesSealer() :
+    _hAes(NULL),
+    _hKey(NULL)
+  {
+  }
+
+  ~CRulesSealer()
+  {
+    if (_hKey)
+    {
+      BCryptDestroyKey(_hKey);
+    }
+    if (_hAes)
+    {
+      BCryptCloseAlgorithmProvider(_hAes, 0);
+    }
+    SecureZeroMemory(_rgbKeyFile, sizeof(_rgbKeyFile));
+  }
+
+  HRESULT Initialize(__in PCWSTR pwzKeyFile)
+  {
+    HRESULT hr = ReadKeyFile(pwzKeyFile, _rgbKeyFile);
+    if (SUCCEEDED(hr))
+    {
+      NTSTATUS status = BCryptOpenAlgorithmProvider(&_hAes, BCRYPT_AES_ALGORITHM, NULL, 0);
+      if (BCRYPT_SUCCESS(status))
+      {
+        status = BCryptSetProperty(_hAes, BCRYPT_CHAINING_MODE, (PUCHAR)BCRYPT_CHAIN_MODE_GCM, sizeof(BCRYPT_CHAIN_MODE_GCM), 0);
+      }
+      else
+      {
+        _hAes = NULL;
+      }
+      if (BCRYPT_SUCCESS(status))
+      {
+        status = BCryptGenerateSymmetricKey(_hAes, &_hKey, NULL, 0,
+          _rgbKeyFile + SEALED_STORE_KEY_ID_SIZE, SEALED_STORE_KEY_SIZE, 0);
+      }
+      hr = BCRYPT_SUCCESS(status) ? S_OK : HRESULT_FROM_NT(status);
+    }
+    return hr;
+  }
+
+  const unsigned char* KeyId()
+  {
+    return _rgbKeyFile;
+  }
+
+  bool Seal(const unsigned char* pbAad, const unsigned char* pb, size_t cb, std::vector<unsigned char>* prgbSealed)
+  {
+    prgbSealed->resize(SEALED_STORE_NONCE_SIZE + cb + SEALED_STORE_TAG_SIZE);
+    PUCHAR pbNonce = &(*prgbSealed)[0];
+    NTSTATUS status = BCryptGenRandom(NULL, pbNonce, SEALED_STORE_NONCE_SIZE, BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+    if (BCRYPT_SUCCESS(status))
+    {
+      BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO acmi;
+      BCRYPT_INIT_AUTH_MODE_INFO(acmi);
+      acmi.pbNonce = pbNonce;
+      acmi.cbNonce = SEALED_STORE_NONCE_SIZE;
+      acmi.pbAuthData = const_cast<PUCHAR>(pbAad);
+      acmi.cbAuthData = SEALED_STORE_AAD_SIZE;
+      acmi.pbTag = pbNonce + SEALED_STORE_NONCE_SIZE + cb;
+      acmi.cbTag = SEALED_STORE_TAG_SIZE;
+
+      ULONG cbCiphertext;
+      status = BCryptEncrypt(_hKey, const_cast<PUCHAR>(pb), (ULONG)cb, &acmi, NULL, 0,
+        pbNonce + SEALED_STORE_NONCE_SIZE, (ULONG)cb, &cbCiphertext, 0);
+    }
+    return BCRYPT_SUCCESS(status);
+  }
+
+private:
+  BCRYPT_ALG_HANDLE _hAes;
+  BCRYPT_KEY_HANDLE _hKey;
+  BYTE _rgbKeyFile[SEALED_STORE_KEY_FILE_SIZE];
+};
+
+// Hands out a key from new-key, for trying sealed rules off the machines they are for.
+class CRawKeyProvider : public ISealedStoreKeyProvider
+{
+public:
+  CRawKeyProvider()
+  {
+    ZeroMemory(_rgbKeyFile, sizeof(_rgbKeyFile));
+  }
+
+  ~CRawKeyProvider()
+  {
+    SecureZeroMemory(_rgbKeyFile, sizeof(_rgbKeyFile));
+  }
+
+  HRESULT Initialize(__in PCWSTR pwzKeyFile)
+  {
+    return ReadKeyFile(pwzKeyFile, _rgbKeyFile);
+  }
+
+  CREDENTIAL_STORE_RESULT GetKey(const unsigned char* pbKeyId, unsigned char* pbKey)
+  {
+    if (0 != memcmp(pbKeyId, _rgbKeyFile, SEALED_STORE_KEY_ID_SIZE))
+    {
+      return CSR_NOT_FOUND;
+    }
+    CopyMemory(pbKey, _rgbKeyFile + SEALED_STORE_KEY_ID_SIZE, SEALED_STORE_KEY_SIZE);
+    return CSR_OK;
+  }
+
+private:
+  BYTE _rgbKeyFile[SEALED_STORE_KEY_FILE_SIZE];
+};
+
+static HRESULT _HResultFromCredentialStoreResult(__in CREDENTIAL_STORE_RESULT csr)
+{
+  switch (csr)
+  {
+  case CSR_OK:
+    return S_OK;
+  case CSR_NOT_FOUND:
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  case CSR_ACCESS_DENIED:
+    return E_ACCESSDENIED;
+  case CSR_OUT_OF_MEMORY:
+    return E_OUTOFMEMORY;
+  case CSR_IO_ERROR:
+    return HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+  default:
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+}
+
+static HRESULT _WriteFile(__in PCWSTR pwzPath, __in const std::vector<unsigned char>& rgb)
+{
+  HANDLE hFile = CreateFileW(pwzPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (INVALID_HANDLE_VALUE == hFile)
+  {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+
+  DWORD cbWritten = 0;
+  HRESULT hr = (rgb.empty() || WriteFile(hFile, &rgb[0], (DWORD)rgb.size(), &cbWritten, NULL)) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  if (SUCCEEDED(hr) && cbWritten != rgb.size())
+  {
+    hr = HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+  }
+  CloseHandle(hFile);
+  if (FAILED(hr))
+  {
+    DeleteFileW(pwzPath);
+  }
+  return hr;
+}
+
+int CompileRulesCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  PCWSTR pwzRules = NULL;
+  PCWSTR pwzOut = NULL;
+  PCWSTR pwzKey = NULL;
+  bool fUsage = (0 != argc % 2);
+  for (int i = 0; !fUsage && i < argc; i += 2)
+  {
+    if (0 == lstrcmpiW(argv[i], L"-rules"))
+    {
+      pwzRules = argv[i + 1];
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-out"))
+    {
+      pwzOut = argv[i + 1];
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-key"))
+    {
+      pwzKey = argv[i + 1];
+    }
+    else
+    {
+      fUsage = true;
+    }
+  }
+  if (fUsage || !pwzRules || !pwzOut)
+  {
+    wprintf(L"usage: CredentialTool compile-rules -rules file -out file [-key file]\n"
+            L"\n"
+            L"The rules file is UTF-8, one entry per line, fields separated by tabs:\n"
+            L"  account<TAB>name<TAB>domain<TAB>user<TAB>password\n"
+            L"  rule<TAB>pattern<TAB>account name[<TAB>condition]...\n"
+            L"Patterns use ? * [a-z] [!0-9] and {lo-hi}; conditions are tag=name,\n"
+            L"days=mon-fri and time=hh:mm-hh:mm.  The first rule that applies wins.\n"
+            L"With -key, the accounts are sealed with a key from new-key.\n");
+    return 2;
+  }
+
+  LARGE_INTEGER liFrequency;
+  LARGE_INTEGER liStart;
+  LARGE_INTEGER liEnd;
+  QueryPerformanceFrequency(&liFrequency);
+  QueryPerformanceCounter(&liStart);
+
+  CRulesSealer sealer;
+  HRESULT hr = pwzKey ? sealer.Initialize(pwzKey) : S_OK;
+  if (FAILED(hr))
+  {
+    wprintf(L"could not use the key in %s: 0x%08x\n", pwzKey, hr);
+    return 1;
+  }
+
+  std::vector<unsigned char> rgbText;
+  hr = _HResultFromCredentialStoreResult(CredentialStoreResultFromPlatform(PlatformReadFile(pwzRules, RULES_MAX_TEXT, &rgbText)));
+  if (FAILED(hr))
+  {
+    wprintf(L"could not read %s: 0x%08x\n", pwzRules, hr);
+    return 1;
+  }
+
+  // Skip a UTF-8 byte order mark, then hand the compiler a line at a time.
+  CHostRulesCompiler compiler;
+  size_t iLine = (rgbText.size() >= 3 && rgbText[0] == 0xEF && rgbText[1] == 0xBB && rgbText[2] == 0xBF) ? 3 : 0;
+  bool fOk = true;
+  for (DWORD dwLine = 1; fOk && iLine < rgbText.size(); dwLine++)
+  {
+    size_t iEnd = iLine;
+    while (iEnd < rgbText.size() && rgbText[iEnd] != '\n')
+    {
+      iEnd++;
+    }
+    fOk = compiler.AddLine(reinterpret_cast<const char*>(&rgbText[iLine]), iEnd - iLine, dwLine);
+    iLine = iEnd + 1;
+  }
+  SecureZeroMemory(rgbText.empty() ? NULL : &rgbText[0], rgbText.size());
+
+  std::vector<unsigned char> rgbOut;
+  if (fOk)
+  {
+    fOk = compiler.Compile(pwzKey ? &sealer : NULL, &rgbOut);
+  }
+  if (!fOk)
+  {
+    if (compiler.ErrorLine())
+    {
+      wprintf(L"%s(%u): the entry %s\n", pwzRules, compiler.ErrorLine(), compiler.Error());
+    }
+    else
+    {
+      wprintf(L"%s: the rules %s\n", pwzRules, compiler.Error());
+    }
+    return 1;
+  }
+
+  hr = _WriteFile(pwzOut, rgbOut);
+  if (FAILED(hr))
+  {
+    wprintf(L"could not write %s: 0x%08x\n", pwzOut, hr);
+    return 1;
+  }
+
+  QueryPerformanceCounter(&liEnd);
+  const HOST_RULES_COMPILE_STATS& stats = compiler.Stats();
+  wprintf(L"%u rules for %u accounts compiled in %.2f s: %u NFA states became %u states with %u edges\n"
+          L"over %u character classes, %Iu bytes\n",
+    stats.cRules, stats.cAccounts, (double)(liEnd.QuadPart - liStart.QuadPart) / liFrequency.QuadPart,
+    stats.cNfaStates, stats.cStates, stats.cEdges, stats.cClasses, stats.cbOutput);
+  return 0;
+}
+
+static bool _ParseMatchOptions(
+  __in int argc,
+  __in_ecount(argc) wchar_t* argv[],
+  __out PCWSTR* ppwzRules,
+  __out PCWSTR* ppwzKey,
+  __out std::vector<std::wstring>* prgTags,
+  __out HOST_RULES_QUERY* pquery,
+  __out DWORD* pcIterations
+)
+{
+  SYSTEMTIME st;
+  GetLocalTime(&st);
+  *ppwzRules = NULL;
+  *ppwzKey = NULL;
+  *pcIterations = 1;
+  ZeroMemory(pquery, sizeof(*pquery));
+  pquery->ulDayOfWeek = st.wDayOfWeek;
+  pquery->ulMinuteOfDay = st.wHour * 60UL + st.wMinute;
+
+  if (0 != argc % 2)
+  {
+    return false;
+  }
+  for (int i = 0; i < argc; i += 2)
+  {
+    PCWSTR pwzValue = argv[i + 1];
+    if (0 == lstrcmpiW(argv[i], L"-rules"))
+    {
+      *ppwzRules = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-machine"))
+    {
+      pquery->pwzMachine = pwzValue;
+      pquery->cchMachine = wcslen(pwzValue);
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-key"))
+    {
+      *ppwzKey = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-tags"))
+    {
+      for (PCWSTR pwz = pwzValue; *pwz; )
+      {
+        PCWSTR pwzEnd = wcschr(pwz, L',');
+        size_t cch = pwzEnd ? (size_t)(pwzEnd - pwz) : wcslen(pwz);
+        prgTags->push_back(std::wstring(pwz, cch));
+        pwz += cch + (pwzEnd ? 1 : 0);
+      }
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-day"))
+    {
+      ULONG iDay = 0;
+      while (iDay < ARRAYSIZE(s_rgpwzDays) && 0 != lstrcmpiW(pwzValue, s_rgpwzDays[iDay]))
+      {
+        iDay++;
+      }
+      if (iDay == ARRAYSIZE(s_rgpwzDays))
+      {
+        return false;
+      }
+      pquery->ulDayOfWeek = iDay;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-time"))
+    {
+      UINT uHour;
+      UINT uMinute;
+      if (2 != swscanf_s(pwzValue, L"%u:%u", &uHour, &uMinute) || uHour > 23 || uMinute > 59)
+      {
+        return false;
+      }
+      pquery->ulMinuteOfDay = uHour * 60UL + uMinute;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-iterations"))
+    {
+      *pcIterations = wcstoul(pwzValue, NULL, 0);
+      if (0 == *pcIterations)
+      {
+        return false;
+      }
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return *ppwzRules && pquery->pwzMachine;
+}
+
+int MatchRulesCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  PCWSTR pwzRules;
+  PCWSTR pwzKey;
+  std::vector<std::wstring> rgTags;
+  HOST_RULES_QUERY query;
+  DWORD cIterations;
+  if (!_ParseMatchOptions(argc, argv, &pwzRules, &pwzKey, &rgTags, &query, &cIterations))
+  {
+    wprintf(L"usage: CredentialTool match-rules -rules file -machine name [-tags tag,...]\n"
+            L"                                  [-day day] [-time hh:mm] [-key file] [-iterations n]\n"
+            L"\n"
+            L"Evaluates compiled rules as the provider would, by default at the current local\n"
+            L"day and time.  Sealed rules need the key from new-key they were compiled with.\n");
+    return 2;
+  }
+
+  std::vector<PCWSTR> rgpwzTags;
+  for (size_t i = 0; i < rgTags.size(); i++)
+  {
+    rgpwzTags.push_back(rgTags[i].c_str());
+  }
+  query.rgpwzTags = rgpwzTags.empty() ? NULL : &rgpwzTags[0];
+  query.cTags = rgpwzTags.size();
+
+  CRawKeyProvider keys;
+  HRESULT hr = pwzKey ? keys.Initialize(pwzKey) : S_OK;
+  if (FAILED(hr))
+  {
+    wprintf(L"could not use the key in %s: 0x%08x\n", pwzKey, hr);
+    return 1;
+  }
+
+  // Every iteration opens and reads the file afresh, as a logon would.
+  LARGE_INTEGER liFrequency;
+  LARGE_INTEGER liStart;
+  LARGE_INTEGER liEnd;
+  QueryPerformanceFrequency(&liFrequency);
+  QueryPerformanceCounter(&liStart);
+
+  CREDENTIAL_STORE_RESULT csr = CSR_OK;
+  UserCredentials uc;
+  unsigned long ulLine = 0;
+  for (DWORD i = 0; (CSR_OK == csr || CSR_NOT_FOUND == csr) && i < cIterations; i++)
+  {
+    csr = HostRulesLoad(pwzRules, pwzKey ? &keys : NULL, query, &uc, &ulLine);
+  }
+
+  QueryPerformanceCounter(&liEnd);
+  double dMicroseconds = (double)(liEnd.QuadPart - liStart.QuadPart) * 1000000.0 / liFrequency.QuadPart / cIterations;
+
+  int iExit = 0;
+  if (CSR_OK == csr)
+  {
+    wprintf(L"%s at %s %02u:%02u: rule on line %u applies, logging on as %s\\%s\n",
+      query.pwzMachine, s_rgpwzDays[query.ulDayOfWeek], query.ulMinuteOfDay / 60, query.ulMinuteOfDay % 60,
+      ulLine, uc.domain.c_str(), uc.username.c_str());
+  }
+  else if (CSR_NOT_FOUND == csr)
+  {
+    wprintf(L"%s at %s %02u:%02u: no rule applies\n",
+      query.pwzMachine, s_rgpwzDays[query.ulDayOfWeek], query.ulMinuteOfDay / 60, query.ulMinuteOfDay % 60);
+  }
+  else
+  {
+    wprintf(L"could not evaluate %s: 0x%08x\n", pwzRules, _HResultFromCredentialStoreResult(csr));
+    iExit = 1;
+  }
+  if (!uc.password.empty())
+  {
+    SecureZeroMemory(&uc.password[0], uc.password.size() * sizeof(wchar_t));
+  }
+
+  if (0 == iExit && cIterations > 1)
+  {
+    wprintf(L"%u evaluations, %.2f us each\n", cIterations, dMicroseconds);
+  }
+  return iExit;
+}
@@ -0,0 +1,892 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform-neutral: include nothing but the standard library and Platform.h here.
+
+#include <algorithm>
+#include <new>
+#include <string.h>
+#include "RulesCompiler.h"
+
+#define HOST_RULES_MAX_DIGITS 9         // so that bounds fit in 32 bits
+
+static const char* const s_rgpszDays[] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+
+static void _PutU32(std::vector<unsigned char>* prgb, unsigned long ul)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    prgb->push_back((unsigned char)(ul >> (8 * i)));
+  }
+}
+
+static void _PutU64(std::vector<unsigned char>* prgb, unsigned long long ull)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    prgb->push_back((unsigned char)(ull >> (8 * i)));
+  }
+}
+
+static char _Fold(char ch)
+{
+  return (ch >= 'a' && ch <= 'z') ? (char)(ch - 'a' + 'A') : ch;
+}
+
+static bool _Split(const char* pch, size_t cch, char chSeparator, std::vector<std::string>* prgFields)
+{
+  prgFields->clear();
+  size_t iStart = 0;
+  for (size_t i = 0; i <= cch; i++)
+  {
+    if (i == cch || pch[i] == chSeparator)
+    {
+      prgFields->push_back(std::string(pch + iStart, i - iStart));
+      iStart = i + 1;
+    }
+  }
+  return true;
+}
+
+// Parses a decimal number of at most cchMax digits, all of the string.
+static bool _ParseNumber(const std::string& s, size_t cchMax, unsigned long* pul)
+{
+  if (s.empty() || s.size() > cchMax)
+  {
+    return false;
+  }
+  unsigned long ul = 0;
+  for (size_t i = 0; i < s.size(); i++)
+  {
+    if (s[i] < '0' || s[i] > '9')
+    {
+      return false;
+    }
+    ul = ul * 10 + (unsigned long)(s[i] - '0');
+  }
+  *pul = ul;
+  return true;
+}
+
+static bool _ParseTime(const std::string& s, unsigned long* pulMinute)
+{
+  unsigned long ulHour;
+  unsigned long ulMinute;
+  if (s.size() != 5 || s[2] != ':'
+    || !_ParseNumber(s.substr(0, 2), 2, &ulHour) || !_ParseNumber(s.substr(3, 2), 2, &ulMinute)
+    || ulHour > 24 || ulMinute > 59 || (ulHour == 24 && ulMinute != 0))
+  {
+    return false;
+  }
+  *pulMinute = (ulHour * 60 + ulMinute) % (24 * 60);
+  return true;
+}
+
+static bool _ParseDay(const std::string& s, unsigned long* piDay)
+{
+  for (unsigned long i = 0; i < 7; i++)
+  {
+    if (s.size() == 3 && _Fold(s[0]) == _Fold(s_rgpszDays[i][0])
+      && _Fold(s[1]) == _Fold(s_rgpszDays[i][1]) && _Fold(s[2]) == _Fold(s_rgpszDays[i][2]))
+    {
+      *piDay = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+CHostRulesCompiler::CHostRulesCompiler() :
+  _cClasses(0),
+  _pwzError(NULL),
+  _ulErrorLine(0)
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+CHostRulesCompiler::~CHostRulesCompiler()
+{
+  for (size_t i = 0; i < _rgAccounts.size(); i++)
+  {
+    std::string& record = _rgAccounts[i].record;
+    if (!record.empty())
+    {
+      PlatformSecureZero(&record[0], record.size());
+    }
+  }
+}
+
+bool CHostRulesCompiler::_Fail(const wchar_t* pwzError, unsigned long ulLine)
+{
+  _pwzError = pwzError;
+  _ulErrorLine = ulLine;
+  return false;
+}
+
+bool CHostRulesCompiler::AddLine(const char* pch, size_t cch, unsigned long ulLine)
+{
+  if (cch && pch[cch - 1] == '\r')
+  {
+    cch--;
+  }
+  if (cch == 0 || pch[0] == '#')
+  {
+    return true;
+  }
+
+  FIELDS fields;
+  try
+  {
+    _Split(pch, cch, '\t', &fields);
+    if (fields[0] == "account")
+    {
+      return _AddAccount(fields, ulLine);
+    }
+    if (fields[0] == "rule")
+    {
+      return _AddRule(fields, ulLine);
+    }
+  }
+  catch (const std::bad_alloc&)
+  {
+    return _Fail(L"does not fit in memory", ulLine);
+  }
+  return _Fail(L"is neither an account nor a rule", ulLine);
+}
+
+bool CHostRulesCompiler::_AddAccount(const FIELDS& fields, unsigned long ulLine)
+{
+  if (fields.size() != 5 || fields[1].empty() || fields[3].empty())
+  {
+    return _Fail(L"needs an account name, a domain, a user name and a password", ulLine);
+  }
+  if (_mapAccounts.find(fields[1]) != _mapAccounts.end())
+  {
+    return _Fail(L"repeats an account name", ulLine);
+  }
+
+  ACCOUNT account;
+  account.record = fields[2] + "\r\n" + fields[3] + "\r\n" + fields[4] + "\r\n";
+  if (account.record.size() > CREDENTIAL_STORE_MAX_SIZE)
+  {
+    return _Fail(L"is too long", ulLine);
+  }
+  _mapAccounts[fields[1]] = (unsigned long)_rgAccounts.size();
+  _rgAccounts.push_back(account);
+  PlatformSecureZero(&account.record[0], account.record.size());
+  return true;
+}
+
+bool CHostRulesCompiler::_AddRule(const FIELDS& fields, unsigned long ulLine)
+{
+  if (fields.size() < 3 || fields[1].empty() || fields[2].empty())
+  {
+    return _Fail(L"needs a pattern and an account name", ulLine);
+  }
+
+  RULE rule;
+  memset(&rule.rule, 0, sizeof(rule.rule));
+  rule.rule.ulLine = ulLine;
+  rule.rule.ulDays = HOST_RULES_ALL_DAYS;
+  rule.account = fields[2];
+  bool fDays = false;
+  bool fTime = false;
+  for (size_t i = 3; i < fields.size(); i++)
+  {
+    const std::string& condition = fields[i];
+    if (condition.compare(0, 5, "days=") == 0)
+    {
+      if (fDays)
+      {
+        return _Fail(L"has more than one days= condition", ulLine);
+      }
+      fDays = true;
+    }
+    else if (condition.compare(0, 5, "time=") == 0)
+    {
+      if (fTime)
+      {
+        return _Fail(L"has more than one time= condition", ulLine);
+      }
+      fTime = true;
+    }
+    if (!_ParseCondition(condition, &rule, ulLine))
+    {
+      return false;
+    }
+  }
+
+  if (!_AddPattern(fields[1], (unsigned long)_rgRules.size(), ulLine))
+  {
+    return false;
+  }
+  _rgRules.push_back(rule);
+  return true;
+}
+
+bool CHostRulesCompiler::_ParseCondition(const std::string& condition, RULE* pRule, unsigned long ulLine)
+{
+  size_t iEquals = condition.find('=');
+  std::string name = condition.substr(0, iEquals);
+  std::string value = (iEquals == std::string::npos) ? std::string() : condition.substr(iEquals + 1);
+
+  if (name == "tag")
+  {
+    if (value.empty() || value.size() > HOST_RULES_MAX_TAG)
+    {
+      return _Fail(L"has a tag that is empty or too long", ulLine);
+    }
+    for (size_t i = 0; i < value.size(); i++)
+    {
+      char ch = _Fold(value[i]);
+      if (!((ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '-' || ch == '_'))
+      {
+        return _Fail(L"has a tag with characters other than letters, digits, - and _", ulLine);
+      }
+    }
+    pRule->tags.push_back(value);
+    return true;
+  }
+
+  if (name == "time")
+  {
+    size_t iDash = value.find('-');
+    if (iDash == std::string::npos
+      || !_ParseTime(value.substr(0, iDash), &pRule->rule.ulMinuteStart)
+      || !_ParseTime(value.substr(iDash + 1), &pRule->rule.ulMinuteEnd))
+    {
+      return _Fail(L"has a time= condition that is not hh:mm-hh:mm", ulLine);
+    }
+    return true;
+  }
+
+  if (name == "days")
+  {
+    std::vector<std::string> items;
+    _Split(value.data(), value.size(), ',', &items);
+    pRule->rule.ulDays = 0;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+      size_t iDash = items[i].find('-');
+      unsigned long iFirst;
+      unsigned long iLast;
+      if (!_ParseDay(items[i].substr(0, iDash), &iFirst)
+        || !_ParseDay((iDash == std::string::npos) ? items[i] : items[i].substr(iDash + 1), &iLast))
+      {
+        return _Fail(L"has a days= condition that is not a list of days (sun, mon, ...) and ranges of days", ulLine);
+      }
+
+      // A range may wrap past Saturday, as in fri-mon.
+      for (unsigned long iDay = iFirst; ; iDay = (iDay + 1) % 7)
+      {
+        pRule->rule.ulDays |= 1UL << iDay;
+        if (iDay == iLast)
+        {
+          break;
+        }
+      }
+    }
+    return true;
+  }
+
+  return _Fail(L"has a condition other than tag=, days= and time=", ulLine);
+}
+
+unsigned long CHostRulesCompiler::_NewState()
+{
+  _rgNfa.push_back(std::vector<NFA_EDGE>());
+  _rgNfaAccept.push_back(HOST_RULES_NONE);
+  return (unsigned long)(_rgNfa.size() - 1);
+}
+
+unsigned long CHostRulesCompiler::_InternSet(const CHAR_SET& set)
+{
+  std::string key = set.to_string();
+  std::map<std::string, unsigned long>::const_iterator it = _mapSets.find(key);
+  if (it != _mapSets.end())
+  {
+    return it->second;
+  }
+  unsigned long iSet = (unsigned long)_rgSets.size();
+  _rgSets.push_back(set);
+  _mapSets[key] = iSet;
+  return iSet;
+}
+
+void CHostRulesCompiler::_AddEdge(unsigned long iFrom, const CHAR_SET& set, unsigned long iTo)
+{
+  NFA_EDGE edge = { _InternSet(set), iTo };
+  _rgNfa[iFrom].push_back(edge);
+}
+
+// Parses [...] starting at the [.  Characters are folded as the machine name will be.
+bool CHostRulesCompiler::_ParseSet(const std::string& pattern, size_t* pi, CHAR_SET* pSet)
+{
+  size_t i = *pi + 1;
+  bool fNegate = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+  if (fNegate)
+  {
+    i++;
+  }
+
+  pSet->reset();
+  bool fEmpty = true;
+  while (i < pattern.size() && pattern[i] != ']')
+  {
+    char chFirst = pattern[i];
+    if (chFirst == '\\' && i + 1 < pattern.size())
+    {
+      chFirst = pattern[++i];
+    }
+    i++;
+
+    char chLast = chFirst;
+    if (i + 1 < pattern.size() && pattern[i] == '-' && pattern[i + 1] != ']')
+    {
+      chLast = pattern[i + 1];
+      i += 2;
+      if (chLast == '\\' && i < pattern.size())
+      {
+        chLast = pattern[i++];
+      }
+    }
+    if ((unsigned char)chFirst >= 0x80 || (unsigned char)chLast >= 0x80 || chFirst > chLast)
+    {
+      return false;
+    }
+    for (int ch = chFirst; ch <= chLast; ch++)
+    {
+      pSet->set((unsigned char)_Fold((char)ch));
+    }
+    fEmpty = false;
+  }
+  if (i == pattern.size() || fEmpty)
+  {
+    return false;
+  }
+
+  if (fNegate)
+  {
+    pSet->flip();
+    for (int ch = 'a'; ch <= 'z'; ch++)
+    {
+      pSet->reset(ch);      // never seen: the name is folded first
+    }
+  }
+  *pi = i + 1;
+  return true;
+}
+
+// Splits [lo, hi], both n digits, into sequences of digit sets; for example 08-23 becomes
+// 0[8-9], 1[0-9] and 2[0-3].
+static void _SplitRange(
+  const std::string& lo,
+  const std::string& hi,
+  std::vector<std::bitset<HOST_RULES_CLASS_MAP_SIZE> >* prgPrefix,
+  std::vector<std::vector<std::bitset<HOST_RULES_CLASS_MAP_SIZE> > >* prgAlternatives
+)
+{
+  typedef std::bitset<HOST_RULES_CLASS_MAP_SIZE> CHAR_SET;
+  if (lo.empty())
+  {
+    prgAlternatives->push_back(*prgPrefix);
+    return;
+  }
+
+  CHAR_SET digit;
+  if (lo[0] == hi[0])
+  {
+    digit.set((unsigned char)lo[0]);
+    prgPrefix->push_back(digit);
+    _SplitRange(lo.substr(1), hi.substr(1), prgPrefix, prgAlternatives);
+    prgPrefix->pop_back();
+    return;
+  }
+
+  std::string zeros(lo.size() - 1, '0');
+  std::string nines(lo.size() - 1, '9');
+  char chFirst = lo[0];
+  char chLast = hi[0];
+
+  // The part of the range below the first full decade of its leading digit...
+  if (lo.compare(1, std::string::npos, zeros) != 0)
+  {
+    digit.set((unsigned char)lo[0]);
+    prgPrefix->push_back(digit);
+    _SplitRange(lo.substr(1), nines, prgPrefix, prgAlternatives);
+    prgPrefix->pop_back();
+    chFirst++;
+  }
+
+  // ...the part above the last full one...
+  bool fHighTail = hi.compare(1, std::string::npos, nines) != 0;
+  if (fHighTail)
+  {
+    chLast--;
+  }
+
+  // ...and the full decades in between, where every trailing digit goes.
+  if (chFirst <= chLast)
+  {
+    std::vector<CHAR_SET> alternative(*prgPrefix);
+    digit.reset();
+    for (char ch = chFirst; ch <= chLast; ch++)
+    {
+      digit.set((unsigned char)ch);
+    }
+    alternative.push_back(digit);
+    CHAR_SET any;
+    for (char ch = '0'; ch <= '9'; ch++)
+    {
+      any.set((unsigned char)ch);
+    }
+    alternative.insert(alternative.end(), lo.size() - 1, any);
+    prgAlternatives->push_back(alternative);
+  }
+
+  if (fHighTail)
+  {
+    digit.reset();
+    digit.set((unsigned char)hi[0]);
+    prgPrefix->push_back(digit);
+    _SplitRange(zeros, hi.substr(1), prgPrefix, prgAlternatives);
+    prgPrefix->pop_back();
+  }
+}
+
+// Parses {lo-hi} starting at the { into the digit sequences that match it.
+bool CHostRulesCompiler::_ParseNumberRange(const std::string& pattern, size_t* pi, std::vector<std::vector<CHAR_SET> >* prgAlternatives)
+{
+  size_t iClose = pattern.find('}', *pi);
+  if (iClose == std::string::npos)
+  {
+    return false;
+  }
+  std::string range = pattern.substr(*pi + 1, iClose - *pi - 1);
+  size_t iDash = range.find('-');
+  std::string lo = range.substr(0, iDash);
+  std::string hi = (iDash == std::string::npos) ? std::string() : range.substr(iDash + 1);
+  unsigned long ulLo;
+  unsigned long ulHi;
+  if (!_ParseNumber(lo, HOST_RULES_MAX_DIGITS, &ulLo) || !_ParseNumber(hi, HOST_RULES_MAX_DIGITS, &ulHi) || ulLo > ulHi)
+  {
+    return false;
+  }
+
+  std::vector<CHAR_SET> prefix;
+  prgAlternatives->clear();
+  if (lo.size() == hi.size() && (lo[0] == '0' || hi[0] == '0') && lo.size() > 1)
+  {
+    // Zero-padded: every number has the width of the bounds.
+    _SplitRange(lo, hi, &prefix, prgAlternatives);
+  }
+  else
+  {
+    // Written without leading zeros: split by number of digits first.
+    std::string loDigits = std::to_string(ulLo);
+    std::string hiDigits = std::to_string(ulHi);
+    for (size_t cDigits = loDigits.size(); cDigits <= hiDigits.size(); cDigits++)
+    {
+      std::string first = (cDigits == loDigits.size()) ? loDigits : "1" + std::string(cDigits - 1, '0');
+      std::string last = (cDigits == hiDigits.size()) ? hiDigits : std::string(cDigits, '9');
+      _SplitRange(first, last, &prefix, prgAlternatives);
+    }
+  }
+  *pi = iClose + 1;
+  return true;
+}
+
+// Adds the states that match pattern to the NFA, with the last one accepting rule iRule.
+// Without alternation or grouping a pattern needs no epsilon moves: * is a loop on the
+// state it follows, and the alternatives of a number range share their first and last
+// states.
+bool CHostRulesCompiler::_AddPattern(const std::string& pattern, unsigned long iRule, unsigned long ulLine)
+{
+  CHAR_SET any;
+  any.set();
+  for (int ch = 'a'; ch <= 'z'; ch++)
+  {
+    any.reset(ch);
+  }
+
+  unsigned long iState = _NewState();
+  _rgStarts.push_back(iState);
+  bool fLooping = false;
+  size_t i = 0;
+  while (i < pattern.size())
+  {
+    char ch = pattern[i];
+    if (ch == '*')
+    {
+      if (!fLooping)
+      {
+        _AddEdge(iState, any, iState);
+        fLooping = true;
+      }
+      i++;
+      continue;
+    }
+
+    unsigned long iNext = _NewState();
+    CHAR_SET set;
+    if (ch == '?')
+    {
+      set = any;
+      i++;
+    }
+    else if (ch == '[')
+    {
+      if (!_ParseSet(pattern, &i, &set))
+      {
+        return _Fail(L"has a pattern with a [...] set that is empty, unterminated or not ASCII", ulLine);
+      }
+    }
+    else if (ch == '{')
+    {
+      std::vector<std::vector<CHAR_SET> > rgAlternatives;
+      if (!_ParseNumberRange(pattern, &i, &rgAlternatives))
+      {
+        return _Fail(L"has a pattern with a {lo-hi} range that is not two numbers of at most nine digits, lowest first", ulLine);
+      }
+      for (size_t iAlternative = 0; iAlternative < rgAlternatives.size(); iAlternative++)
+      {
+        const std::vector<CHAR_SET>& alternative = rgAlternatives[iAlternative];
+        unsigned long iFrom = iState;
+        for (size_t iDigit = 0; iDigit + 1 < alternative.size(); iDigit++)
+        {
+          unsigned long iTo = _NewState();
+          _AddEdge(iFrom, alternative[iDigit], iTo);
+          iFrom = iTo;
+        }
+        _AddEdge(iFrom, alternative.back(), iNext);
+      }
+      iState = iNext;
+      fLooping = false;
+      continue;
+    }
+    else
+    {
+      if (ch == '\\' && i + 1 < pattern.size())
+      {
+        ch = pattern[++i];
+      }
+      if ((unsigned char)ch >= 0x80)
+      {
+        return _Fail(L"has a pattern with a character that is not ASCII", ulLine);
+      }
+      set.set((unsigned char)_Fold(ch));
+      i++;
+    }
+    _AddEdge(iState, set, iNext);
+    iState = iNext;
+    fLooping = false;
+  }
+  _rgNfaAccept[iState] = iRule;
+  return true;
+}
+
+// Partitions the symbols into classes that no set in the patterns tells apart, so the
+// automaton needs one edge per class rather than one per character.
+bool CHostRulesCompiler::_BuildClasses(unsigned char* pbClassMap)
+{
+  std::map<std::vector<bool>, unsigned long> mapClasses;
+  std::vector<unsigned long> rgClassOf(HOST_RULES_CLASS_MAP_SIZE);
+  for (size_t iSymbol = 0; iSymbol < HOST_RULES_CLASS_MAP_SIZE; iSymbol++)
+  {
+    std::vector<bool> signature(_rgSets.size());
+    for (size_t iSet = 0; iSet < _rgSets.size(); iSet++)
+    {
+      signature[iSet] = _rgSets[iSet].test(iSymbol);
+    }
+    std::map<std::vector<bool>, unsigned long>::const_iterator it = mapClasses.find(signature);
+    if (it == mapClasses.end())
+    {
+      it = mapClasses.insert(std::make_pair(signature, (unsigned long)mapClasses.size())).first;
+    }
+    rgClassOf[iSymbol] = it->second;
+    pbClassMap[iSymbol] = (unsigned char)it->second;
+  }
+  _cClasses = (unsigned long)mapClasses.size();
+
+  _rgSetClasses.assign(_rgSets.size(), std::vector<unsigned long>());
+  for (size_t iSet = 0; iSet < _rgSets.size(); iSet++)
+  {
+    std::vector<unsigned long>& classes = _rgSetClasses[iSet];
+    for (size_t iSymbol = 0; iSymbol < HOST_RULES_CLASS_MAP_SIZE; iSymbol++)
+    {
+      if (_rgSets[iSet].test(iSymbol))
+      {
+        classes.push_back(rgClassOf[iSymbol]);
+      }
+    }
+    std::sort(classes.begin(), classes.end());
+    classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+  }
+  return true;
+}
+
+// Subset construction.  Each state of the automaton is the set of NFA states the name
+// could be in; states are numbered in the order they are found, the start state first.
+bool CHostRulesCompiler::_BuildAutomaton(
+  std::vector<unsigned char>* prgbStates,
+  std::vector<unsigned char>* prgbEdges,
+  std::vector<unsigned char>* prgbAccepts
+)
+{
+  typedef std::map<std::vector<unsigned long>, unsigned long> STATE_MAP;
+  STATE_MAP mapStates;
+  std::vector<STATE_MAP::const_iterator> rgStates;
+  std::map<std::vector<unsigned long>, unsigned long> mapAccepts;
+
+  std::vector<unsigned long> start(_rgStarts);
+  std::sort(start.begin(), start.end());
+  rgStates.push_back(mapStates.insert(std::make_pair(start, 0UL)).first);
+
+  std::vector<std::vector<unsigned long> > rgNextSets(_cClasses);
+  std::vector<unsigned long> rgNext(_cClasses);
+  std::vector<unsigned long> rgCounts;
+  unsigned long cEdges = 0;
+  for (size_t iState = 0; iState < rgStates.size(); iState++)
+  {
+    const std::vector<unsigned long>& set = rgStates[iState]->first;
+
+    // Where each class of character leads...
+    for (unsigned long iClass = 0; iClass < _cClasses; iClass++)
+    {
+      rgNextSets[iClass].clear();
+    }
+    std::vector<unsigned long> accept;
+    for (size_t i = 0; i < set.size(); i++)
+    {
+      const std::vector<NFA_EDGE>& edges = _rgNfa[set[i]];
+      for (size_t iEdge = 0; iEdge < edges.size(); iEdge++)
+      {
+        const std::vector<unsigned long>& classes = _rgSetClasses[edges[iEdge].iSet];
+        for (size_t iClass = 0; iClass < classes.size(); iClass++)
+        {
+          rgNextSets[classes[iClass]].push_back(edges[iEdge].iNext);
+        }
+      }
+      if (HOST_RULES_NONE != _rgNfaAccept[set[i]])
+      {
+        accept.push_back(_rgNfaAccept[set[i]]);
+      }
+    }
+
+    for (unsigned long iClass = 0; iClass < _cClasses; iClass++)
+    {
+      std::vector<unsigned long>& next = rgNextSets[iClass];
+      if (next.empty())
+      {
+        rgNext[iClass] = HOST_RULES_NONE;
+        continue;
+      }
+      std::sort(next.begin(), next.end());
+      next.erase(std::unique(next.begin(), next.end()), next.end());
+      STATE_MAP::const_iterator it = mapStates.find(next);
+      if (it == mapStates.end())
+      {
+        if (rgStates.size() == HOST_RULES_MAX_STATES)
+        {
+          return _Fail(L"are too complex to compile: simplify the patterns or split the rules", 0);
+        }
+        it = mapStates.insert(std::make_pair(next, (unsigned long)rgStates.size())).first;
+        rgStates.push_back(it);
+      }
+      rgNext[iClass] = it->second;
+    }
+
+    // ...stored as the most common destination plus an edge for each exception.
+    std::vector<unsigned long> rgSorted(rgNext);
+    std::sort(rgSorted.begin(), rgSorted.end());
+    unsigned long iDefault = rgSorted[0];
+    size_t cBest = 0;
+    for (size_t i = 0; i < rgSorted.size(); )
+    {
+      size_t j = i;
+      while (j < rgSorted.size() && rgSorted[j] == rgSorted[i])
+      {
+        j++;
+      }
+      if (j - i > cBest)
+      {
+        cBest = j - i;
+        iDefault = rgSorted[i];
+      }
+      i = j;
+    }
+
+    unsigned long iFirstEdge = cEdges;
+    for (unsigned long iClass = 0; iClass < _cClasses; iClass++)
+    {
+      if (rgNext[iClass] != iDefault)
+      {
+        _PutU32(prgbEdges, iClass);
+        _PutU32(prgbEdges, rgNext[iClass]);
+        cEdges++;
+      }
+    }
+
+    // Rules apply in the order they were written, so the accept list is sorted.
+    unsigned long oAccept = HOST_RULES_NONE;
+    if (!accept.empty())
+    {
+      std::sort(accept.begin(), accept.end());
+      std::map<std::vector<unsigned long>, unsigned long>::const_iterator it = mapAccepts.find(accept);
+      if (it == mapAccepts.end())
+      {
+        it = mapAccepts.insert(std::make_pair(accept, (unsigned long)prgbAccepts->size())).first;
+        _PutU32(prgbAccepts, (unsigned long)accept.size());
+        for (size_t i = 0; i < accept.size(); i++)
+        {
+          _PutU32(prgbAccepts, accept[i]);
+        }
+      }
+      oAccept = it->second;
+    }
+
+    _PutU32(prgbStates, iDefault);
+    _PutU32(prgbStates, iFirstEdge);
+    _PutU32(prgbStates, cEdges - iFirstEdge);
+    _PutU32(prgbStates, oAccept);
+  }
+
+  _stats.cStates = (unsigned long)rgStates.size();
+  _stats.cEdges = cEdges;
+  return true;
+}
+
+bool CHostRulesCompiler::Compile(IHostRulesSealer* pSealer, std::vector<unsigned char>* prgbOut)
+{
+  try
+  {
+    // Resolve the account each rule logs on as, and the tags it needs.
+    std::vector<unsigned char> rgbRules;
+    std::vector<unsigned char> rgbTagRefs;
+    std::vector<unsigned char> rgbStrings;
+    std::map<std::string, unsigned long> mapStrings;
+    unsigned long cTagRefs = 0;
+    for (size_t i = 0; i < _rgRules.size(); i++)
+    {
+      RULE& rule = _rgRules[i];
+      std::map<std::string, unsigned long>::const_iterator itAccount = _mapAccounts.find(rule.account);
+      if (itAccount == _mapAccounts.end())
+      {
+        return _Fail(L"names an account that is not defined", rule.rule.ulLine);
+      }
+      rule.rule.iAccount = itAccount->second;
+      rule.rule.iFirstTagRef = cTagRefs;
+      rule.rule.cTags = (unsigned long)rule.tags.size();
+      for (size_t iTag = 0; iTag < rule.tags.size(); iTag++)
+      {
+        const std::string& tag = rule.tags[iTag];
+        std::map<std::string, unsigned long>::const_iterator it = mapStrings.find(tag);
+        if (it == mapStrings.end())
+        {
+          it = mapStrings.insert(std::make_pair(tag, (unsigned long)rgbStrings.size())).first;
+          rgbStrings.insert(rgbStrings.end(), tag.begin(), tag.end());
+        }
+        _PutU32(&rgbTagRefs, it->second);
+        _PutU32(&rgbTagRefs, (unsigned long)tag.size());
+        cTagRefs++;
+      }
+
+      unsigned char rgb[HOST_RULES_RULE_SIZE];
+      HostRulesEncodeRule(rule.rule, rgb);
+      rgbRules.insert(rgbRules.end(), rgb, rgb + sizeof(rgb));
+    }
+
+    unsigned char rgbClassMap[HOST_RULES_CLASS_MAP_SIZE];
+    std::vector<unsigned char> rgbStates;
+    std::vector<unsigned char> rgbEdges;
+    std::vector<unsigned char> rgbAccepts;
+    if (!_BuildClasses(rgbClassMap) || !_BuildAutomaton(&rgbStates, &rgbEdges, &rgbAccepts))
+    {
+      return false;
+    }
+
+    HOST_RULES_HEADER hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.ulMagic = HOST_RULES_MAGIC;
+    hdr.ulVersion = HOST_RULES_VERSION;
+    hdr.ulFlags = pSealer ? HOST_RULES_FLAG_SEALED : 0;
+    hdr.cClasses = _cClasses;
+    hdr.cStates = _stats.cStates;
+    hdr.iStartState = 0;
+    hdr.cRules = (unsigned long)_rgRules.size();
+    hdr.cAccounts = (unsigned long)_rgAccounts.size();
+    if (pSealer)
+    {
+      memcpy(hdr.rgbKeyId, pSealer->KeyId(), SEALED_STORE_KEY_ID_SIZE);
+    }
+
+    const std::vector<unsigned char>* rgpSections[HRS_ACCOUNTS - HRS_STATES] =
+    {
+      &rgbStates, &rgbEdges, &rgbAccepts, &rgbRules, &rgbTagRefs, &rgbStrings,
+    };
+    unsigned long long ullOffset = HOST_RULES_HEADER_SIZE;
+    hdr.rgullSections[HRS_CLASS_MAP] = ullOffset;
+    ullOffset += HOST_RULES_CLASS_MAP_SIZE;
+    for (int i = HRS_STATES; i < HRS_ACCOUNTS; i++)
+    {
+      hdr.rgullSections[i] = ullOffset;
+      ullOffset += rgpSections[i - HRS_STATES]->size();
+    }
+    hdr.rgullSections[HRS_ACCOUNTS] = ullOffset;
+
+    prgbOut->assign(HOST_RULES_HEADER_SIZE, 0);
+    HostRulesEncodeHeader(hdr, &(*prgbOut)[0]);
+    prgbOut->insert(prgbOut->end(), rgbClassMap, rgbClassMap + sizeof(rgbClassMap));
+    for (int i = HRS_STATES; i < HRS_ACCOUNTS; i++)
+    {
+      prgbOut->insert(prgbOut->end(), rgpSections[i - HRS_STATES]->begin(), rgpSections[i - HRS_STATES]->end());
+    }
+
+    // The account table, then the records it points at.
+    unsigned long long ullRecord = ullOffset + (unsigned long long)_rgAccounts.size() * HOST_RULES_ACCOUNT_SIZE;
+    std::vector<unsigned char> rgbRecords;
+    std::vector<unsigned char> rgbSealed;
+    for (size_t i = 0; i < _rgAccounts.size(); i++)
+    {
+      const std::string& record = _rgAccounts[i].record;
+      const unsigned char* pbRecord = reinterpret_cast<const unsigned char*>(record.data());
+      size_t cbRecord = record.size();
+      if (pSealer)
+      {
+        unsigned char rgbAad[SEALED_STORE_AAD_SIZE];
+        HostRulesAccountAad(hdr.rgbKeyId, (unsigned long)i, rgbAad);
+        if (!pSealer->Seal(rgbAad, pbRecord, cbRecord, &rgbSealed))
+        {
+          return _Fail(L"could not be sealed", 0);
+        }
+        pbRecord = &rgbSealed[0];
+        cbRecord = rgbSealed.size();
+      }
+      _PutU64(prgbOut, ullRecord + rgbRecords.size());
+      _PutU32(prgbOut, (unsigned long)cbRecord);
+      _PutU32(prgbOut, 0);
+      rgbRecords.insert(rgbRecords.end(), pbRecord, pbRecord + cbRecord);
+    }
+    prgbOut->insert(prgbOut->end(), rgbRecords.begin(), rgbRecords.end());
+    if (!rgbRecords.empty())
+    {
+      PlatformSecureZero(&rgbRecords[0], rgbRecords.size());
+    }
+
+    _stats.cRules = hdr.cRules;
+    _stats.cAccounts = hdr.cAccounts;
+    _stats.cNfaStates = (unsigned long)_rgNfa.size();
+    _stats.cClasses = _cClasses;
+    _stats.cbOutput = prgbOut->size();
+  }
+  catch (const std::bad_alloc&)
+  {
+    return _Fail(L"do not fit in memory", 0);
+  }
+  return true;
+}
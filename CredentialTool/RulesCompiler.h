@@ -0,0 +1,147 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Compiles host rules text into the file HostRules.h describes.  Like HostRules.cpp this
+// is platform-neutral; sealing the accounts is left to an IHostRulesSealer.
+//
+// The rules text is UTF-8, one entry per line, with tab-separated fields.  Blank lines
+// and lines starting with # are ignored.
+//
+//   account <name> <domain> <user> <password>
+//   rule <pattern> <account name> [<condition>...]
+//
+// Rules are tried in the order they appear and the first one that applies wins.  A rule
+// applies when its pattern matches the whole machine name, ignoring ASCII case, and every
+// one of its conditions holds:
+//
+//   tag=<name>              the machine has the tag (letters, digits, - and _)
+//   days=<day>[-<day>],...  the local day of the week is one of these (sun, mon, ...)
+//   time=<hh:mm>-<hh:mm>    the local time is in this window, which may wrap past midnight
+//
+// In a pattern, ? matches any one character and * any run of characters; [...] matches one
+// character of a set of characters and ranges, or not of it if it starts with ! or ^;
+// {<lo>-<hi>} matches a decimal number in that range, zero-padded to the width of the
+// bounds when they are written with the same number of digits and a leading zero.  A
+// backslash makes the next character literal.  Literal characters must be ASCII.
+
+#pragma once
+
+#include <bitset>
+#include <map>
+#include <string>
+#include <vector>
+#include "HostRules.h"
+
+// Subset construction can blow up on adversarial patterns; give up rather than exhaust
+// the machine.
+#define HOST_RULES_MAX_STATES (1UL << 20)
+
+// Encrypts account records for a sealed rules file.
+class IHostRulesSealer
+{
+public:
+  virtual ~IHostRulesSealer() {}
+
+  // The SEALED_STORE_KEY_ID_SIZE-byte id of the key records are sealed with.
+  virtual const unsigned char* KeyId() = 0;
+
+  // Seals cb bytes at pb, authenticating the SEALED_STORE_AAD_SIZE bytes at pbAad too,
+  // into *prgbSealed as nonce, ciphertext and tag.
+  virtual bool Seal(
+    const unsigned char* pbAad,
+    const unsigned char* pb,
+    size_t cb,
+    std::vector<unsigned char>* prgbSealed
+  ) = 0;
+};
+
+struct HOST_RULES_COMPILE_STATS
+{
+  unsigned long cRules;
+  unsigned long cAccounts;
+  unsigned long cNfaStates;
+  unsigned long cClasses;
+  unsigned long cStates;
+  unsigned long cEdges;
+  size_t cbOutput;
+};
+
+class CHostRulesCompiler
+{
+public:
+  CHostRulesCompiler();
+  ~CHostRulesCompiler();
+
+  // Adds one line of rules text (without its line break).  Returns false, with Error()
+  // describing why, if the line is not a valid entry.  Errors complete a sentence whose
+  // subject is the entry or, when ErrorLine() is 0, the rules as a whole.
+  bool AddLine(const char* pch, size_t cch, unsigned long ulLine);
+
+  // Builds the rules file from the lines added so far.  pSealer may be NULL for a
+  // plaintext file.
+  bool Compile(IHostRulesSealer* pSealer, std::vector<unsigned char>* prgbOut);
+
+  const wchar_t* Error() const { return _pwzError; }
+  unsigned long ErrorLine() const { return _ulErrorLine; }
+  const HOST_RULES_COMPILE_STATS& Stats() const { return _stats; }
+
+private:
+  typedef std::bitset<HOST_RULES_CLASS_MAP_SIZE> CHAR_SET;
+  typedef std::vector<std::string> FIELDS;
+
+  struct NFA_EDGE
+  {
+    unsigned long iSet;             // in _rgSets
+    unsigned long iNext;
+  };
+
+  struct RULE
+  {
+    HOST_RULES_RULE rule;
+    std::string account;
+    std::vector<std::string> tags;
+  };
+
+  struct ACCOUNT
+  {
+    std::string record;
+  };
+
+  bool _Fail(const wchar_t* pwzError, unsigned long ulLine);
+  bool _AddAccount(const FIELDS& fields, unsigned long ulLine);
+  bool _AddRule(const FIELDS& fields, unsigned long ulLine);
+  bool _ParseCondition(const std::string& condition, RULE* pRule, unsigned long ulLine);
+  bool _AddPattern(const std::string& pattern, unsigned long iRule, unsigned long ulLine);
+  bool _ParseSet(const std::string& pattern, size_t* pi, CHAR_SET* pSet);
+  bool _ParseNumberRange(const std::string& pattern, size_t* pi, std::vector<std::vector<CHAR_SET> >* prgAlternatives);
+
+  unsigned long _NewState();
+  unsigned long _InternSet(const CHAR_SET& set);
+  void _AddEdge(unsigned long iFrom, const CHAR_SET& set, unsigned long iTo);
+
+  bool _BuildClasses(unsigned char* pbClassMap);
+  bool _BuildAutomaton(std::vector<unsigned char>* prgbStates, std::vector<unsigned char>* prgbEdges, std::vector<unsigned char>* prgbAccepts);
+
+  // The pattern NFA: one start state per rule, and no epsilon moves.
+  std::vector<std::vector<NFA_EDGE> > _rgNfa;
+  std::vector<unsigned long> _rgNfaAccept;      // rule index, or HOST_RULES_NONE
+  std::vector<unsigned long> _rgStarts;
+
+  std::vector<CHAR_SET> _rgSets;
+  std::map<std::string, unsigned long> _mapSets;
+  std::vector<std::vector<unsigned long> > _rgSetClasses;
+  unsigned long _cClasses;
+
+  std::vector<RULE> _rgRules;
+  std::vector<ACCOUNT> _rgAccounts;
+  std::map<std::string, unsigned long> _mapAccounts;
+
+  const wchar_t* _pwzError;
+  unsigned long _ulErrorLine;
+  HOST_RULES_COMPILE_STATS _stats;
+};
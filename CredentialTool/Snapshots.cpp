@@ -0,0 +1,245 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// stress-snapshots: runs the provider's account snapshots (see AccountSnapshot.h) under
+// readers and writers that never pause, and reports how many reads and publishes each
+// second they manage.
+//
+// Usage: CredentialTool stress-snapshots [-readers n] [-writers n] [-seconds n]
+//
+// Every snapshot a writer publishes names the same tag in its user name and password, so a
+// reader that finds them different, or finds the domain gone, is looking at a torn or freed
+// snapshot (freed ones are wiped first).  A reader that sees the version go backwards is
+// looking at a stale one.  Either counts as a failure and the command exits 1.
+
+#include <windows.h>
+#include <strsafe.h>
+#include <stdio.h>
+#include "CredentialTool.h"
+#include "AccountSnapshot.h"
+
+#define STRESS_MAX_THREADS MAXIMUM_WAIT_OBJECTS
+
+#define STRESS_DOMAIN L"STRESS"
+#define STRESS_USER_PREFIX L"user-"
+#define STRESS_PASSWORD_PREFIX L"pass-"
+#define STRESS_PREFIX_CCH 5
+
+struct STRESS_THREAD
+{
+  DWORD iThread;
+  ULONGLONG cOps;       // reads or publishes
+  ULONGLONG cFailures;
+};
+
+static volatile LONG s_fStop = FALSE;
+
+// Publishing can only run out of memory or be handed a string that is too long.
+static HRESULT _HResultFromCredentialStoreResult(__in CREDENTIAL_STORE_RESULT csr)
+{
+  return (CSR_OK == csr) ? S_OK : (CSR_OUT_OF_MEMORY == csr) ? E_OUTOFMEMORY : HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+}
+
+static CREDENTIAL_STORE_RESULT _Publish(__in DWORD iThread, __in ULONGLONG iSnapshot, __inout UserCredentials* puc)
+{
+  WCHAR wszTag[32];
+  StringCchPrintfW(wszTag, ARRAYSIZE(wszTag), L"%u.%I64u", iThread, iSnapshot);
+  puc->username.assign(STRESS_USER_PREFIX).append(wszTag);
+  puc->password.assign(STRESS_PASSWORD_PREFIX).append(wszTag);
+  return AccountSnapshotPublish(*puc, NULL, NULL);
+}
+
+static bool _IsConsistent(__in const CAccountRecord& rar)
+{
+  return 0 == wcscmp(rar.Domain(), STRESS_DOMAIN) &&
+    rar.UsernameLength() == rar.PasswordLength() &&
+    rar.UsernameLength() > STRESS_PREFIX_CCH &&
+    0 == wcsncmp(rar.Username(), STRESS_USER_PREFIX, STRESS_PREFIX_CCH) &&
+    0 == wcsncmp(rar.Password(), STRESS_PASSWORD_PREFIX, STRESS_PREFIX_CCH) &&
+    0 == wcscmp(rar.Username() + STRESS_PREFIX_CCH, rar.Password() + STRESS_PREFIX_CCH);
+}
+
+static DWORD WINAPI _ReaderThread(__in void* pv)
+{
+  STRESS_THREAD* pThread = static_cast<STRESS_THREAD*>(pv);
+  ULONGLONG ullLastVersion = 0;
+  while (!s_fStop)
+  {
+    CAccountSnapshotReader reader;
+    const ACCOUNT_SNAPSHOT* pSnapshot = reader.Get();
+    if (!pSnapshot || pSnapshot->ullVersion < ullLastVersion || !_IsConsistent(pSnapshot->account))
+    {
+      pThread->cFailures++;
+    }
+    else
+    {
+      ullLastVersion = pSnapshot->ullVersion;
+    }
+    pThread->cOps++;
+  }
+  return 0;
+}
+
+static DWORD WINAPI _WriterThread(__in void* pv)
+{
+  STRESS_THREAD* pThread = static_cast<STRESS_THREAD*>(pv);
+  UserCredentials uc;
+  uc.domain = STRESS_DOMAIN;
+  while (!s_fStop)
+  {
+    if (CSR_OK != _Publish(pThread->iThread, pThread->cOps, &uc))
+    {
+      pThread->cFailures++;
+    }
+    pThread->cOps++;
+  }
+  return 0;
+}
+
+static bool _ParseStressOptions(
+  __in int argc,
+  __in_ecount(argc) wchar_t* argv[],
+  __out DWORD* pcReaders,
+  __out DWORD* pcWriters,
+  __out DWORD* pcSeconds
+)
+{
+  *pcReaders = 4;
+  *pcWriters = 1;
+  *pcSeconds = 5;
+
+  if (0 != argc % 2)
+  {
+    return false;
+  }
+  for (int i = 0; i < argc; i += 2)
+  {
+    DWORD dwValue = wcstoul(argv[i + 1], NULL, 0);
+    if (0 == lstrcmpiW(argv[i], L"-readers"))
+    {
+      *pcReaders = dwValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-writers"))
+    {
+      *pcWriters = dwValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-seconds"))
+    {
+      *pcSeconds = dwValue;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return *pcSeconds > 0 && *pcReaders + *pcWriters > 0 && *pcReaders + *pcWriters <= STRESS_MAX_THREADS;
+}
+
+int StressSnapshotsCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  DWORD cReaders;
+  DWORD cWriters;
+  DWORD cSeconds;
+  if (!_ParseStressOptions(argc, argv, &cReaders, &cWriters, &cSeconds))
+  {
+    wprintf(L"usage: CredentialTool stress-snapshots [-readers n] [-writers n] [-seconds n]\n"
+            L"\n"
+            L"Reads and replaces the account snapshot from every thread at once for -seconds\n"
+            L"(default 4 readers, 1 writer, 5 seconds; at most %u threads in all).\n", STRESS_MAX_THREADS);
+    return 2;
+  }
+
+  // Readers fail on finding nothing, so there is a snapshot before any of them starts.
+  UserCredentials uc;
+  uc.domain = STRESS_DOMAIN;
+  HRESULT hr = _HResultFromCredentialStoreResult(_Publish(0, 0, &uc));
+  if (FAILED(hr))
+  {
+    wprintf(L"could not publish a snapshot: 0x%08x\n", hr);
+    return 1;
+  }
+
+  STRESS_THREAD rgThreads[STRESS_MAX_THREADS] = {};
+  HANDLE rghThreads[STRESS_MAX_THREADS];
+  DWORD cThreads = 0;
+
+  LARGE_INTEGER liFrequency;
+  LARGE_INTEGER liStart;
+  LARGE_INTEGER liEnd;
+  QueryPerformanceFrequency(&liFrequency);
+  QueryPerformanceCounter(&liStart);
+
+  for (; cThreads < cReaders + cWriters; cThreads++)
+  {
+    rgThreads[cThreads].iThread = cThreads;
+    rghThreads[cThreads] = CreateThread(NULL, 0, (cThreads < cReaders) ? _ReaderThread : _WriterThread,
+      &rgThreads[cThreads], 0, NULL);
+    if (!rghThreads[cThreads])
+    {
+      hr = HRESULT_FROM_WIN32(GetLastError());
+      break;
+    }
+  }
+  if (SUCCEEDED(hr))
+  {
+    Sleep(cSeconds * 1000);
+  }
+  InterlockedExchange(&s_fStop, TRUE);
+  if (cThreads)
+  {
+    WaitForMultipleObjects(cThreads, rghThreads, TRUE, INFINITE);
+  }
+  QueryPerformanceCounter(&liEnd);
+  for (DWORD i = 0; i < cThreads; i++)
+  {
+    CloseHandle(rghThreads[i]);
+  }
+
+  if (FAILED(hr))
+  {
+    wprintf(L"could not start thread %u: 0x%08x\n", cThreads, hr);
+    AccountSnapshotShutdown();
+    return 1;
+  }
+
+  ULONGLONG cReads = 0;
+  ULONGLONG cPublishes = 0;
+  ULONGLONG cFailedReads = 0;
+  ULONGLONG cFailedPublishes = 0;
+  for (DWORD i = 0; i < cThreads; i++)
+  {
+    if (i < cReaders)
+    {
+      cReads += rgThreads[i].cOps;
+      cFailedReads += rgThreads[i].cFailures;
+    }
+    else
+    {
+      cPublishes += rgThreads[i].cOps;
+      cFailedPublishes += rgThreads[i].cFailures;
+    }
+  }
+
+  double dSeconds = (double)(liEnd.QuadPart - liStart.QuadPart) / liFrequency.QuadPart;
+  wprintf(L"%u readers: %I64u reads, %.0f/s (%.0f/s per reader)\n",
+    cReaders, cReads, cReads / dSeconds, cReaders ? cReads / dSeconds / cReaders : 0.0);
+  wprintf(L"%u writers: %I64u publishes, %.0f/s\n", cWriters, cPublishes, cPublishes / dSeconds);
+
+  ACCOUNT_SNAPSHOT_STATS stats;
+  AccountSnapshotGetStats(&stats);
+  wprintf(L"%I64u snapshots published, %I64u reclaimed, %u still retired, %u reader records\n",
+    stats.cPublished, stats.cReclaimed, stats.cRetired, stats.cReaderSlots);
+  AccountSnapshotShutdown();
+
+  if (cFailedReads || cFailedPublishes)
+  {
+    wprintf(L"FAILED: %I64u inconsistent reads, %I64u failed publishes\n", cFailedReads, cFailedPublishes);
+    return 1;
+  }
+  return 0;
+}
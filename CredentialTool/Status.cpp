@@ -0,0 +1,249 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// stress-status: runs the queue that carries status text to the tiles (see StatusQueue.h
+// and TileStatus.h) between a producer that never pauses and a stand-in for LogonUI, and
+// reports how long updates take to arrive and how many are coalesced on the way.
+//
+// Usage: CredentialTool stress-status [-updates n] [-ui-work-us n]
+//
+// The producer posts numbered updates the way the provider's background work does, setting
+// an event where the provider posts its status window a message, and only when the queue says
+// no wake-up is pending.  The stand-in waits on the event and drains the queue, as the window
+// does on LogonUI's thread, then spends -ui-work-us being LogonUI before it waits again.
+// ProviderTests status-queue runs the same exchange, through CStatusDelivery and fake tiles,
+// on every platform.  An
+// update that arrives out of order or with another update's text, or a last update that
+// never arrives, counts as a failure and the command exits 1.
+
+#include <windows.h>
+#include <strsafe.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "CredentialTool.h"
+#include "StatusQueue.h"
+
+struct STATUS_STRESS
+{
+  CStatusQueue queue;
+  HANDLE hWake;                       // set where the provider posts its window a message
+  volatile LONG fProducerDone;
+  ULONGLONG cUpdates;
+  ULONGLONG ullUiWorkNs;
+
+  // The producer's.
+  ULONGLONG cPosted;
+  ULONGLONG cWakes;
+
+  // The stand-in's.
+  ULONGLONG cDeliveries;
+  ULONGLONG cTaken;
+  ULONGLONG ullLastDelivered;
+  ULONGLONG cFailures;
+  std::vector<ULONGLONG> rgullLatencyNs;
+};
+
+static void _FormatUpdate(__in ULONGLONG ullSequence, __out_ecount(cch) wchar_t* pwz, __in size_t cch)
+{
+  StringCchPrintfW(pwz, cch, L"Status update %I64u", ullSequence);
+}
+
+static DWORD WINAPI _ProducerThread(__in void* pv)
+{
+  STATUS_STRESS* pStress = static_cast<STATUS_STRESS*>(pv);
+  for (ULONGLONG i = 0; i < pStress->cUpdates; i++)
+  {
+    // The queue numbers only the updates it accepts, so the text does too.
+    wchar_t wz[STATUS_TEXT_MAX_CCH + 1];
+    _FormatUpdate(pStress->cPosted + 1, wz, ARRAYSIZE(wz));
+    bool fWake;
+    if (pStress->queue.Post(wz, wcslen(wz), &fWake))
+    {
+      pStress->cPosted++;
+      if (fWake)
+      {
+        pStress->cWakes++;
+        SetEvent(pStress->hWake);
+      }
+    }
+  }
+  InterlockedExchange(&pStress->fProducerDone, TRUE);
+  SetEvent(pStress->hWake);
+  return 0;
+}
+
+static DWORD WINAPI _ConsumerThread(__in void* pv)
+{
+  STATUS_STRESS* pStress = static_cast<STATUS_STRESS*>(pv);
+  for (;;)
+  {
+    WaitForSingleObject(pStress->hWake, INFINITE);
+    bool fDone = 0 != pStress->fProducerDone;
+
+    STATUS_UPDATE update;
+    unsigned long cTaken = pStress->queue.Drain(&update);
+    if (cTaken)
+    {
+      pStress->rgullLatencyNs.push_back(PlatformMonotonicNanoseconds() - update.ullPostedNs);
+      pStress->cDeliveries++;
+      pStress->cTaken += cTaken;
+
+      wchar_t wzExpected[STATUS_TEXT_MAX_CCH + 1];
+      _FormatUpdate(update.ullSequence, wzExpected, ARRAYSIZE(wzExpected));
+      if (update.ullSequence <= pStress->ullLastDelivered || 0 != wcscmp(update.wz, wzExpected))
+      {
+        pStress->cFailures++;
+      }
+      pStress->ullLastDelivered = update.ullSequence;
+
+      ULONGLONG ullStart = PlatformMonotonicNanoseconds();
+      while (PlatformMonotonicNanoseconds() - ullStart < pStress->ullUiWorkNs)
+      {
+        YieldProcessor();
+      }
+    }
+
+    // Seen done before the drain, so the drain took the producer's last update.
+    if (fDone)
+    {
+      break;
+    }
+  }
+  return 0;
+}
+
+static bool _ParseStatusOptions(
+  __in int argc,
+  __in_ecount(argc) wchar_t* argv[],
+  __out ULONGLONG* pcUpdates,
+  __out DWORD* pdwUiWorkUs
+)
+{
+  *pcUpdates = 1000000;
+  *pdwUiWorkUs = 50;
+
+  if (0 != argc % 2)
+  {
+    return false;
+  }
+  for (int i = 0; i < argc; i += 2)
+  {
+    if (0 == lstrcmpiW(argv[i], L"-updates"))
+    {
+      *pcUpdates = _wcstoui64(argv[i + 1], NULL, 0);
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-ui-work-us"))
+    {
+      *pdwUiWorkUs = wcstoul(argv[i + 1], NULL, 0);
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return *pcUpdates > 0;
+}
+
+// The latency at fraction dFraction of the sorted rgull.
+static ULONGLONG _Percentile(__in const std::vector<ULONGLONG>& rgull, __in double dFraction)
+{
+  size_t i = static_cast<size_t>(dFraction * (rgull.size() - 1));
+  return rgull[i];
+}
+
+int StressStatusCommand(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  ULONGLONG cUpdates;
+  DWORD dwUiWorkUs;
+  if (!_ParseStatusOptions(argc, argv, &cUpdates, &dwUiWorkUs))
+  {
+    wprintf(L"usage: CredentialTool stress-status [-updates n] [-ui-work-us n]\n"
+            L"\n"
+            L"Posts -updates status updates as fast as it can to a stand-in for LogonUI that\n"
+            L"spends -ui-work-us on each delivery (default 1000000 updates, 50 us).\n");
+    return 2;
+  }
+
+  // The ring is a few kilobytes; it lives on the heap with the rest.  Everything not set
+  // here starts out zero.
+  STATUS_STRESS* pStress = new STATUS_STRESS();
+  pStress->hWake = CreateEventW(NULL, FALSE, FALSE, NULL);
+  pStress->cUpdates = cUpdates;
+  pStress->ullUiWorkNs = dwUiWorkUs * 1000ULL;
+
+  HRESULT hr = pStress->hWake ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  HANDLE rghThreads[2] = {};
+  if (SUCCEEDED(hr))
+  {
+    rghThreads[0] = CreateThread(NULL, 0, _ConsumerThread, pStress, 0, NULL);
+    hr = rghThreads[0] ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  }
+  if (SUCCEEDED(hr))
+  {
+    rghThreads[1] = CreateThread(NULL, 0, _ProducerThread, pStress, 0, NULL);
+    if (!rghThreads[1])
+    {
+      // Lets the stand-in go.
+      hr = HRESULT_FROM_WIN32(GetLastError());
+      InterlockedExchange(&pStress->fProducerDone, TRUE);
+      SetEvent(pStress->hWake);
+    }
+  }
+  if (rghThreads[0])
+  {
+    WaitForMultipleObjects(rghThreads[1] ? 2 : 1, rghThreads, TRUE, INFINITE);
+  }
+  for (size_t i = 0; i < ARRAYSIZE(rghThreads); i++)
+  {
+    if (rghThreads[i])
+    {
+      CloseHandle(rghThreads[i]);
+    }
+  }
+  if (pStress->hWake)
+  {
+    CloseHandle(pStress->hWake);
+  }
+
+  if (FAILED(hr))
+  {
+    wprintf(L"could not start the test: 0x%08x\n", hr);
+    delete pStress;
+    return 1;
+  }
+
+  wprintf(L"%I64u updates posted, %I64u refused because the queue was full\n",
+    pStress->cPosted, pStress->queue.DroppedCount());
+  wprintf(L"%I64u wake-ups, %I64u deliveries, %I64u updates coalesced into them (%.1f per delivery)\n",
+    pStress->cWakes, pStress->cDeliveries, pStress->cTaken,
+    pStress->cDeliveries ? (double)pStress->cTaken / pStress->cDeliveries : 0.0);
+
+  std::vector<ULONGLONG>& rgullLatencyNs = pStress->rgullLatencyNs;
+  if (!rgullLatencyNs.empty())
+  {
+    std::sort(rgullLatencyNs.begin(), rgullLatencyNs.end());
+    wprintf(L"delivery latency: p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+      _Percentile(rgullLatencyNs, 0.5) / 1000.0, _Percentile(rgullLatencyNs, 0.99) / 1000.0,
+      _Percentile(rgullLatencyNs, 0.999) / 1000.0, rgullLatencyNs.back() / 1000.0);
+  }
+
+  ULONGLONG cFailures = pStress->cFailures;
+  bool fLastArrived = pStress->ullLastDelivered == pStress->cPosted;
+  ULONGLONG ullLastDelivered = pStress->ullLastDelivered;
+  ULONGLONG cPosted = pStress->cPosted;
+  delete pStress;
+
+  if (cFailures || !fLastArrived)
+  {
+    wprintf(L"FAILED: %I64u updates out of order or garbled; last delivered %I64u of %I64u\n",
+      cFailures, ullLastDelivered, cPosted);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,767 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// HelpersBench times the functions in helpers.cpp.  Each case runs for each requested
+// string length (and, where it matters, each usage scenario) until it has taken at least
+// -mintime milliseconds.  It reports ns/op and the allocations and bytes per op charged to
+// an unlimited ALLOC_BUDGET around the batch (see AllocTrack.h): whatever the helpers
+// allocate through the Tracked* allocators, and operator new.  What the thread pool's
+// workers allocate is charged on their own threads and not counted.
+//
+// Usage: HelpersBench [-lengths n,n,...] [-filter text] [-mintime ms]
+//                     [-save file] [-baseline file] [-threshold percent]
+//
+// -save writes the results to a file; -baseline compares against one written earlier and
+// fails (exit code 1) if any case got slower by more than -threshold percent or started
+// allocating more.
+//
+// The audit log cases write to a log in %TEMP% that is deleted afterwards; the writer's
+// counters printed at the end give the throughput it sustained against them.
+//
+// The thread pool cases time scheduling, not work: the items do nothing, so ns/op is the
+// round trip from submitting to a waiter seeing the item finish.  A case fails if an item
+// comes back with the wrong result.
+//
+// The ReportResult cases look messages up in the message catalog next to HelpersBench,
+// AutoLoginCredentialProvider.messages, as the provider does in the one next to it; they
+// are skipped if it isn't there.
+
+#ifndef WIN32_NO_STATUS
+#include <ntstatus.h>
+#define WIN32_NO_STATUS
+#endif
+#include <windows.h>
+#include <objbase.h>
+#include <stdio.h>
+#include <strsafe.h>
+#include <vector>
+#include <helpers.h>
+#include <Trace.h>
+#include <Histogram.h>
+#include <AuditLog.h>
+#include <ThreadPool.h>
+#include <ReportResultMessage.h>
+#include <AllocTrack.h>
+
+#ifndef ALLOC_TRACKING
+#error HelpersBench counts allocations with AllocTrack.h; build it with ALLOC_TRACKING defined.
+#endif
+
+// The inputs a case may use, rebuilt for every length and scenario.
+struct BENCH_CONTEXT
+{
+  DWORD                                 cch;
+  CREDENTIAL_PROVIDER_USAGE_SCENARIO    cpus;
+  std::vector<WCHAR>                    rgchDomain;
+  std::vector<WCHAR>                    rgchUsername;
+  std::vector<WCHAR>                    rgchPassword;
+  CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR  cpfd;
+  KERB_INTERACTIVE_UNLOCK_LOGON         kiul;
+  BYTE*                                 rgbPacked;  // kiul, packed
+  DWORD                                 cbPacked;
+  std::vector<BYTE>                     rgbWork;    // scratch copy of rgbPacked for unpacking
+};
+
+typedef HRESULT (*PFNBENCH)(__inout BENCH_CONTEXT* pctx);
+
+static HRESULT _BenchFieldDescriptorCoAllocCopy(__inout BENCH_CONTEXT* pctx)
+{
+  CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR* pcpfd;
+  HRESULT hr = FieldDescriptorCoAllocCopy(pctx->cpfd, &pcpfd);
+  if (SUCCEEDED(hr))
+  {
+    CoTaskMemFree(pcpfd->pszLabel);
+    CoTaskMemFree(pcpfd);
+  }
+  return hr;
+}
+
+static HRESULT _BenchFieldDescriptorCoAllocCopyN(__inout BENCH_CONTEXT* pctx)
+{
+  CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR* pcpfd;
+  HRESULT hr = FieldDescriptorCoAllocCopyN(pctx->cpfd, pctx->cch, &pcpfd);
+  if (SUCCEEDED(hr))
+  {
+    CoTaskMemFree(pcpfd->pszLabel);
+    CoTaskMemFree(pcpfd);
+  }
+  return hr;
+}
+
+static HRESULT _BenchFieldDescriptorCopy(__inout BENCH_CONTEXT* pctx)
+{
+  CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR cpfd;
+  HRESULT hr = FieldDescriptorCopy(pctx->cpfd, &cpfd);
+  if (SUCCEEDED(hr))
+  {
+    CoTaskMemFree(cpfd.pszLabel);
+  }
+  return hr;
+}
+
+static HRESULT _BenchStringCoAllocCopy(__inout BENCH_CONTEXT* pctx)
+{
+  PWSTR pwz;
+  HRESULT hr = StringCoAllocCopy(&pctx->rgchUsername[0], pctx->cch, &pwz);
+  if (SUCCEEDED(hr))
+  {
+    CoTaskMemFree(pwz);
+  }
+  return hr;
+}
+
+static HRESULT _BenchUnicodeStringInitWithString(__inout BENCH_CONTEXT* pctx)
+{
+  UNICODE_STRING us;
+  return UnicodeStringInitWithString(&pctx->rgchUsername[0], &us);
+}
+
+static HRESULT _BenchKerbInteractiveUnlockLogonInit(__inout BENCH_CONTEXT* pctx)
+{
+  KERB_INTERACTIVE_UNLOCK_LOGON kiul;
+  return KerbInteractiveUnlockLogonInit(&pctx->rgchDomain[0], &pctx->rgchUsername[0], &pctx->rgchPassword[0], pctx->cpus, &kiul);
+}
+
+static HRESULT _BenchKerbInteractiveUnlockLogonPack(__inout BENCH_CONTEXT* pctx)
+{
+  BYTE* rgb;
+  DWORD cb;
+  HRESULT hr = KerbInteractiveUnlockLogonPack(pctx->kiul, &rgb, &cb);
+  if (SUCCEEDED(hr))
+  {
+    CoTaskMemFree(rgb);
+  }
+  return hr;
+}
+
+// Unpacking works in place, so each op starts from a fresh copy of the packed buffer; the
+// copy is part of what is timed.
+static HRESULT _BenchKerbInteractiveUnlockLogonUnpackInPlace(__inout BENCH_CONTEXT* pctx)
+{
+  CopyMemory(&pctx->rgbWork[0], pctx->rgbPacked, pctx->cbPacked);
+  KerbInteractiveUnlockLogonUnpackInPlace(reinterpret_cast<KERB_INTERACTIVE_UNLOCK_LOGON*>(&pctx->rgbWork[0]), pctx->cbPacked);
+  return S_OK;
+}
+
+static HRESULT _BenchProtectIfNecessaryAndCopyPassword(__inout BENCH_CONTEXT* pctx)
+{
+  PWSTR pwzProtected;
+  HRESULT hr = ProtectIfNecessaryAndCopyPassword(&pctx->rgchPassword[0], pctx->cpus, &pwzProtected);
+  if (SUCCEEDED(hr))
+  {
+    CoTaskMemFree(pwzProtected);
+  }
+  return hr;
+}
+
+static HRESULT _BenchDomainUsernameStringAlloc(__inout BENCH_CONTEXT* pctx)
+{
+  PWSTR pwz;
+  HRESULT hr = DomainUsernameStringAlloc(&pctx->rgchDomain[0], &pctx->rgchUsername[0], &pwz);
+  if (SUCCEEDED(hr))
+  {
+    HeapFree(GetProcessHeap(), 0, pwz);
+  }
+  return hr;
+}
+
+static HRESULT _BenchRetrieveNegotiateAuthPackage(__inout BENCH_CONTEXT*)
+{
+  ULONG ulAuthPackage;
+  return RetrieveNegotiateAuthPackage(&ulAuthPackage);
+}
+
+// The cost of instrumentation itself: an empty span with tracing (or latency recording)
+// off, which every instrumented function pays, and with it on.
+static HRESULT _BenchTraceScopeDisabled(__inout BENCH_CONTEXT*)
+{
+  TraceEnable(false);
+  TRACE_SCOPE("bench");
+  return S_OK;
+}
+
+static HRESULT _BenchTraceScopeEnabled(__inout BENCH_CONTEXT*)
+{
+  TraceEnable(true);
+  {
+    TRACE_SCOPE("bench");
+  }
+  TraceEnable(false);
+  return S_OK;
+}
+
+static HRESULT _BenchLatencyScopeDisabled(__inout BENCH_CONTEXT*)
+{
+  LatencyEnable(false);
+  LATENCY_SCOPE(LP_LOGON_PACK);
+  return S_OK;
+}
+
+static HRESULT _BenchLatencyScopeEnabled(__inout BENCH_CONTEXT*)
+{
+  LatencyEnable(true);
+  {
+    LATENCY_SCOPE(LP_LOGON_PACK);
+  }
+  LatencyEnable(false);
+  return S_OK;
+}
+
+// What a credential pays in ReportResult.  The writer drains the queue in the background;
+// when the producer outruns it, the op measured is the drop.
+static HRESULT _BenchAuditLogRecord(__inout BENCH_CONTEXT* pctx)
+{
+  AuditLogRecord(CPUS_LOGON, &pctx->rgchDomain[0], &pctx->rgchUsername[0], STATUS_LOGON_FAILURE, STATUS_WRONG_PASSWORD, 0);
+  return S_OK;
+}
+
+static long _NoOpWorkItem(__in void* pvContext, __in const CCancellationToken&, __out uintptr_t* pulpResult)
+{
+  *pulpResult = reinterpret_cast<uintptr_t>(pvContext);
+  return S_OK;
+}
+
+#define BENCH_FAN_OUT (THREAD_POOL_THREADS * 4)
+
+// Submits BENCH_FAN_OUT items tied to one token and waits for all of them.  With
+// fCancel, the token is canceled first, so none should run.
+static HRESULT _FanOut(__in BOOL fCancel)
+{
+  CCancellationToken ct;
+  if (fCancel)
+  {
+    ct.Cancel();
+  }
+
+  CWorkFuture* rgpFutures[BENCH_FAN_OUT] = {};
+  HRESULT hr = S_OK;
+  for (uintptr_t i = 0; SUCCEEDED(hr) && i < BENCH_FAN_OUT; i++)
+  {
+    hr = (PR_OK == ThreadPoolSubmit(_NoOpWorkItem, reinterpret_cast<void*>(i), WP_NORMAL, &ct, &rgpFutures[i])) ? S_OK : E_FAIL;
+  }
+
+  // Every item submitted is waited for, even after a failure, since they all point at ct.
+  for (uintptr_t i = 0; i < BENCH_FAN_OUT && rgpFutures[i]; i++)
+  {
+    rgpFutures[i]->Wait(THREAD_POOL_INFINITE);
+    if (SUCCEEDED(hr))
+    {
+      long lResult;
+      uintptr_t ulpResult;
+      WORK_STATE ws = rgpFutures[i]->GetResult(&lResult, &ulpResult);
+      if (fCancel ? (WS_CANCELED != ws) : (WS_FINISHED != ws || FAILED(lResult) || ulpResult != i))
+      {
+        hr = E_UNEXPECTED;
+      }
+    }
+    rgpFutures[i]->Release();
+  }
+  return hr;
+}
+
+static HRESULT _BenchThreadPoolSubmitWait(__inout BENCH_CONTEXT*)
+{
+  CWorkFuture* pFuture;
+  HRESULT hr = (PR_OK == ThreadPoolSubmit(_NoOpWorkItem, NULL, WP_HIGH, NULL, &pFuture)) ? S_OK : E_FAIL;
+  if (SUCCEEDED(hr))
+  {
+    long lResult;
+    pFuture->Wait(THREAD_POOL_INFINITE);
+    hr = (WS_FINISHED == pFuture->GetResult(&lResult, NULL)) ? lResult : E_UNEXPECTED;
+    pFuture->Release();
+  }
+  return hr;
+}
+
+static HRESULT _BenchThreadPoolFanOut(__inout BENCH_CONTEXT*)
+{
+  return _FanOut(FALSE);
+}
+
+static HRESULT _BenchThreadPoolFanOutCanceled(__inout BENCH_CONTEXT*)
+{
+  return _FanOut(TRUE);
+}
+
+// The message catalog, for the ReportResult cases, or NULL.
+static const MESSAGE_CATALOG* s_pCatalog = NULL;
+
+// What ReportResult pays for its message: the catalog lookup and the copy for LogonUI.  The
+// matched status is found in the LANGID's own language, with any substatus, after missing
+// with its own; the fallback one goes on through the primary language to the default.  An
+// unmatched status probes all of them and allocates nothing.
+static HRESULT _ReportResultMessage(__in LANGID langid, __in NTSTATUS ntsStatus, __in NTSTATUS ntsSubstatus, __in bool fExpectMessage)
+{
+  PWSTR pwzMessage;
+  CREDENTIAL_PROVIDER_STATUS_ICON cpsi;
+  HRESULT hr = ReportResultMessageLoad(s_pCatalog, langid, ntsStatus, ntsSubstatus, &pwzMessage, &cpsi);
+  if (SUCCEEDED(hr) && (NULL != pwzMessage) != fExpectMessage)
+  {
+    hr = E_UNEXPECTED;
+  }
+  CoTaskMemFree(pwzMessage);
+  return hr;
+}
+
+static HRESULT _BenchReportResultMatched(__inout BENCH_CONTEXT*)
+{
+  return _ReportResultMessage(MAKELANGID(LANG_ENGLISH, SUBLANG_ENGLISH_US), STATUS_TIME_DIFFERENCE_AT_DC, STATUS_SUCCESS, true);
+}
+
+static HRESULT _BenchReportResultFallback(__inout BENCH_CONTEXT*)
+{
+  return _ReportResultMessage(MAKELANGID(0x11, SUBLANG_DEFAULT), STATUS_TIME_DIFFERENCE_AT_DC, STATUS_SUCCESS, true);
+}
+
+static HRESULT _BenchReportResultUnmatched(__inout BENCH_CONTEXT*)
+{
+  return _ReportResultMessage(MAKELANGID(LANG_ENGLISH, SUBLANG_ENGLISH_US), STATUS_ACCESS_DENIED, STATUS_SUCCESS, false);
+}
+
+// How a case varies.
+#define BF_LENGTH   0x1     // once per -lengths entry
+#define BF_SCENARIO 0x2     // once per usage scenario in s_rgScenarios
+#define BF_CATALOG  0x4     // needs s_pCatalog; skipped without it
+
+struct BENCH_CASE
+{
+  PCWSTR    pwzName;
+  PFNBENCH  pfn;
+  DWORD     dwFlags;
+};
+
+static const BENCH_CASE s_rgCases[] =
+{
+  { L"FieldDescriptorCoAllocCopy",              _BenchFieldDescriptorCoAllocCopy,               BF_LENGTH },
+  { L"FieldDescriptorCoAllocCopyN",             _BenchFieldDescriptorCoAllocCopyN,              BF_LENGTH },
+  { L"FieldDescriptorCopy",                     _BenchFieldDescriptorCopy,                      BF_LENGTH },
+  { L"StringCoAllocCopy",                       _BenchStringCoAllocCopy,                        BF_LENGTH },
+  { L"UnicodeStringInitWithString",             _BenchUnicodeStringInitWithString,              BF_LENGTH },
+  { L"KerbInteractiveUnlockLogonInit",          _BenchKerbInteractiveUnlockLogonInit,           BF_LENGTH | BF_SCENARIO },
+  { L"KerbInteractiveUnlockLogonPack",          _BenchKerbInteractiveUnlockLogonPack,           BF_LENGTH },
+  { L"KerbInteractiveUnlockLogonUnpackInPlace", _BenchKerbInteractiveUnlockLogonUnpackInPlace,  BF_LENGTH },
+  { L"ProtectIfNecessaryAndCopyPassword",       _BenchProtectIfNecessaryAndCopyPassword,        BF_LENGTH | BF_SCENARIO },
+  { L"DomainUsernameStringAlloc",               _BenchDomainUsernameStringAlloc,                BF_LENGTH },
+  { L"RetrieveNegotiateAuthPackage",            _BenchRetrieveNegotiateAuthPackage,             0 },
+  { L"TraceScope/disabled",                     _BenchTraceScopeDisabled,                       0 },
+  { L"TraceScope/enabled",                      _BenchTraceScopeEnabled,                        0 },
+  { L"LatencyScope/disabled",                   _BenchLatencyScopeDisabled,                     0 },
+  { L"LatencyScope/enabled",                    _BenchLatencyScopeEnabled,                      0 },
+  { L"AuditLogRecord",                          _BenchAuditLogRecord,                           BF_LENGTH },
+  { L"ThreadPool/submit-wait",                  _BenchThreadPoolSubmitWait,                     0 },
+  { L"ThreadPool/fan-out",                      _BenchThreadPoolFanOut,                         0 },
+  { L"ThreadPool/fan-out-canceled",             _BenchThreadPoolFanOutCanceled,                 0 },
+  { L"ReportResult/matched",                    _BenchReportResultMatched,                      BF_CATALOG },
+  { L"ReportResult/fallback",                   _BenchReportResultFallback,                     BF_CATALOG },
+  { L"ReportResult/unmatched",                  _BenchReportResultUnmatched,                    BF_CATALOG },
+};
+
+static const struct
+{
+  CREDENTIAL_PROVIDER_USAGE_SCENARIO  cpus;
+  PCWSTR                              pwzName;
+}
+s_rgScenarios[] =
+{
+  { CPUS_LOGON,               L"logon" },
+  { CPUS_UNLOCK_WORKSTATION,  L"unlock" },
+  { CPUS_CREDUI,              L"credui" },
+};
+
+struct BENCH_RESULT
+{
+  WCHAR   wszName[128];
+  double  dNanosecondsPerOp;
+  double  dAllocsPerOp;
+  double  dBytesPerOp;
+};
+
+struct BENCH_OPTIONS
+{
+  std::vector<DWORD>  rgcch;
+  PCWSTR              pwzFilter;
+  DWORD               dwMinTimeMs;
+  PCWSTR              pwzSave;
+  PCWSTR              pwzBaseline;
+  double              dThresholdPercent;
+};
+
+static void _FillString(__out std::vector<WCHAR>* prgch, __in DWORD cch, __in WCHAR chFirst)
+{
+  prgch->resize(cch + 1);
+  for (DWORD i = 0; i < cch; i++)
+  {
+    (*prgch)[i] = static_cast<WCHAR>(chFirst + i % 26);
+  }
+  (*prgch)[cch] = L'\0';
+}
+
+static HRESULT _InitContext(__in DWORD cch, __in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus, __out BENCH_CONTEXT* pctx)
+{
+  pctx->cch = cch;
+  pctx->cpus = cpus;
+  _FillString(&pctx->rgchDomain, cch, L'A');
+  _FillString(&pctx->rgchUsername, cch, L'a');
+  _FillString(&pctx->rgchPassword, cch, L'a');
+
+  pctx->cpfd.dwFieldID = 0;
+  pctx->cpfd.cpft = CPFT_LARGE_TEXT;
+  pctx->cpfd.pszLabel = &pctx->rgchUsername[0];
+  pctx->cpfd.guidFieldType = GUID_NULL;
+
+  pctx->rgbPacked = NULL;
+  HRESULT hr = KerbInteractiveUnlockLogonInit(&pctx->rgchDomain[0], &pctx->rgchUsername[0], &pctx->rgchPassword[0], cpus, &pctx->kiul);
+  if (SUCCEEDED(hr))
+  {
+    hr = KerbInteractiveUnlockLogonPack(pctx->kiul, &pctx->rgbPacked, &pctx->cbPacked);
+    if (SUCCEEDED(hr))
+    {
+      pctx->rgbWork.resize(pctx->cbPacked);
+    }
+  }
+  return hr;
+}
+
+// Runs one case until it has taken at least dwMinTimeMs, doubling the batch size each round.
+static HRESULT _RunCase(__in PFNBENCH pfn, __inout BENCH_CONTEXT* pctx, __in DWORD dwMinTimeMs, __out BENCH_RESULT* pbr)
+{
+  LARGE_INTEGER liFrequency;
+  QueryPerformanceFrequency(&liFrequency);
+  const LONGLONG llMinTicks = liFrequency.QuadPart * dwMinTimeMs / 1000;
+
+  // Warm up caches and anything the function initializes lazily.
+  HRESULT hr = S_OK;
+  for (DWORD i = 0; SUCCEEDED(hr) && i < 16; i++)
+  {
+    hr = pfn(pctx);
+  }
+
+  ULONGLONG cOps = 1;
+  while (SUCCEEDED(hr))
+  {
+    LARGE_INTEGER liStart, liEnd;
+    unsigned long cAllocs;
+    size_t cbAllocated;
+    {
+      CAllocScope scope("HelpersBench", ALLOC_BUDGET_UNLIMITED, ALLOC_BUDGET_UNLIMITED);
+      QueryPerformanceCounter(&liStart);
+      for (ULONGLONG i = 0; SUCCEEDED(hr) && i < cOps; i++)
+      {
+        hr = pfn(pctx);
+      }
+      QueryPerformanceCounter(&liEnd);
+      cAllocs = scope.GetAllocs();
+      cbAllocated = scope.GetBytesAllocated();
+    }
+
+    LONGLONG llTicks = liEnd.QuadPart - liStart.QuadPart;
+    if (SUCCEEDED(hr) && llTicks >= llMinTicks)
+    {
+      pbr->dNanosecondsPerOp = static_cast<double>(llTicks) * 1e9 / static_cast<double>(liFrequency.QuadPart) / static_cast<double>(cOps);
+      pbr->dAllocsPerOp = static_cast<double>(cAllocs) / static_cast<double>(cOps);
+      pbr->dBytesPerOp = static_cast<double>(cbAllocated) / static_cast<double>(cOps);
+      break;
+    }
+    cOps *= 2;
+  }
+  return hr;
+}
+
+static HRESULT _RunAll(__in const BENCH_OPTIONS& opt, __out std::vector<BENCH_RESULT>* prgResults)
+{
+  HRESULT hr = S_OK;
+
+  for (size_t iCase = 0; SUCCEEDED(hr) && iCase < ARRAYSIZE(s_rgCases); iCase++)
+  {
+    const BENCH_CASE& bc = s_rgCases[iCase];
+    if (opt.pwzFilter && !StrStrIW(bc.pwzName, opt.pwzFilter))
+    {
+      continue;
+    }
+    if ((bc.dwFlags & BF_CATALOG) && !s_pCatalog)
+    {
+      wprintf(L"%s skipped: %s not found\n", bc.pwzName, MESSAGE_CATALOG_FILE_NAME);
+      continue;
+    }
+
+    size_t cLengths = (bc.dwFlags & BF_LENGTH) ? opt.rgcch.size() : 1;
+    size_t cScenarios = (bc.dwFlags & BF_SCENARIO) ? ARRAYSIZE(s_rgScenarios) : 1;
+    for (size_t iLength = 0; SUCCEEDED(hr) && iLength < cLengths; iLength++)
+    {
+      for (size_t iScenario = 0; SUCCEEDED(hr) && iScenario < cScenarios; iScenario++)
+      {
+        BENCH_RESULT br;
+        if (bc.dwFlags & BF_SCENARIO)
+        {
+          hr = StringCchPrintfW(br.wszName, ARRAYSIZE(br.wszName), L"%s/%u/%s", bc.pwzName, opt.rgcch[iLength], s_rgScenarios[iScenario].pwzName);
+        }
+        else if (bc.dwFlags & BF_LENGTH)
+        {
+          hr = StringCchPrintfW(br.wszName, ARRAYSIZE(br.wszName), L"%s/%u", bc.pwzName, opt.rgcch[iLength]);
+        }
+        else
+        {
+          hr = StringCchCopyW(br.wszName, ARRAYSIZE(br.wszName), bc.pwzName);
+        }
+
+        BENCH_CONTEXT ctx;
+        if (SUCCEEDED(hr))
+        {
+          hr = _InitContext(opt.rgcch[iLength], s_rgScenarios[iScenario].cpus, &ctx);
+          if (SUCCEEDED(hr))
+          {
+            hr = _RunCase(bc.pfn, &ctx, opt.dwMinTimeMs, &br);
+            CoTaskMemFree(ctx.rgbPacked);
+          }
+        }
+
+        if (SUCCEEDED(hr))
+        {
+          prgResults->push_back(br);
+        }
+        else
+        {
+          wprintf(L"%s failed: 0x%08x\n", br.wszName, hr);
+        }
+      }
+    }
+  }
+  return hr;
+}
+
+// The results file is one case per line: name, ns/op, allocs/op, bytes/op, tab-separated.
+static HRESULT _SaveResults(__in PCWSTR pwzPath, __in const std::vector<BENCH_RESULT>& rgResults)
+{
+  FILE* pf;
+  if (_wfopen_s(&pf, pwzPath, L"w") != 0)
+  {
+    return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+  }
+
+  for (size_t i = 0; i < rgResults.size(); i++)
+  {
+    fwprintf(pf, L"%s\t%.2f\t%.2f\t%.2f\n", rgResults[i].wszName, rgResults[i].dNanosecondsPerOp, rgResults[i].dAllocsPerOp, rgResults[i].dBytesPerOp);
+  }
+  return (fclose(pf) == 0) ? S_OK : E_FAIL;
+}
+
+static HRESULT _LoadResults(__in PCWSTR pwzPath, __out std::vector<BENCH_RESULT>* prgResults)
+{
+  FILE* pf;
+  if (_wfopen_s(&pf, pwzPath, L"r") != 0)
+  {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  BENCH_RESULT br;
+  while (fwscanf_s(pf, L"%127s %lf %lf %lf", br.wszName, (unsigned)ARRAYSIZE(br.wszName), &br.dNanosecondsPerOp, &br.dAllocsPerOp, &br.dBytesPerOp) == 4)
+  {
+    prgResults->push_back(br);
+  }
+  fclose(pf);
+  return S_OK;
+}
+
+static const BENCH_RESULT* _FindResult(__in const std::vector<BENCH_RESULT>& rgResults, __in PCWSTR pwzName)
+{
+  for (size_t i = 0; i < rgResults.size(); i++)
+  {
+    if (0 == lstrcmpW(rgResults[i].wszName, pwzName))
+    {
+      return &rgResults[i];
+    }
+  }
+  return NULL;
+}
+
+// Prints the results, compared against rgBaseline if there is one, and returns the number
+// of regressions.
+static DWORD _PrintResults(__in const std::vector<BENCH_RESULT>& rgResults, __in const std::vector<BENCH_RESULT>& rgBaseline, __in double dThresholdPercent)
+{
+  DWORD cRegressions = 0;
+
+  wprintf(L"%-52s %12s %10s %10s %10s\n", L"case", L"ns/op", L"allocs/op", L"bytes/op", L"vs base");
+  for (size_t i = 0; i < rgResults.size(); i++)
+  {
+    const BENCH_RESULT& br = rgResults[i];
+    wprintf(L"%-52s %12.1f %10.2f %10.1f", br.wszName, br.dNanosecondsPerOp, br.dAllocsPerOp, br.dBytesPerOp);
+
+    const BENCH_RESULT* pbrBase = _FindResult(rgBaseline, br.wszName);
+    if (pbrBase)
+    {
+      double dChangePercent = (br.dNanosecondsPerOp - pbrBase->dNanosecondsPerOp) * 100.0 / pbrBase->dNanosecondsPerOp;
+      bool fSlower = dChangePercent > dThresholdPercent;
+      bool fMoreAllocs = br.dAllocsPerOp > pbrBase->dAllocsPerOp + 0.01;
+      wprintf(L" %+9.1f%%%s%s", dChangePercent, fSlower ? L"  SLOWER" : L"", fMoreAllocs ? L"  MORE ALLOCATIONS" : L"");
+      if (fSlower || fMoreAllocs)
+      {
+        cRegressions++;
+      }
+    }
+    wprintf(L"\n");
+  }
+  return cRegressions;
+}
+
+static bool _ParseLengths(__in PCWSTR pwz, __out std::vector<DWORD>* prgcch)
+{
+  prgcch->clear();
+  while (*pwz)
+  {
+    PWSTR pwzEnd;
+    DWORD cch = wcstoul(pwz, &pwzEnd, 10);
+    if (pwzEnd == pwz || cch > 0x10000)
+    {
+      return false;
+    }
+    prgcch->push_back(cch);
+    pwz = (*pwzEnd == L',') ? pwzEnd + 1 : pwzEnd;
+  }
+  return !prgcch->empty();
+}
+
+static bool _ParseOptions(__in int argc, __in_ecount(argc) wchar_t* argv[], __out BENCH_OPTIONS* popt)
+{
+  popt->rgcch.clear();
+  popt->rgcch.push_back(8);
+  popt->rgcch.push_back(64);
+  popt->rgcch.push_back(256);
+  popt->pwzFilter = NULL;
+  popt->dwMinTimeMs = 100;
+  popt->pwzSave = NULL;
+  popt->pwzBaseline = NULL;
+  popt->dThresholdPercent = 10.0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    PCWSTR pwzValue = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (!pwzValue)
+    {
+      return false;
+    }
+
+    if (0 == lstrcmpiW(argv[i], L"-lengths"))
+    {
+      if (!_ParseLengths(pwzValue, &popt->rgcch))
+      {
+        return false;
+      }
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-filter"))
+    {
+      popt->pwzFilter = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-mintime"))
+    {
+      popt->dwMinTimeMs = wcstoul(pwzValue, NULL, 0);
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-save"))
+    {
+      popt->pwzSave = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-baseline"))
+    {
+      popt->pwzBaseline = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-threshold"))
+    {
+      popt->dThresholdPercent = wcstod(pwzValue, NULL);
+    }
+    else
+    {
+      return false;
+    }
+    i++;
+  }
+
+  return true;
+}
+
+int __cdecl wmain(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  BENCH_OPTIONS opt;
+  if (!_ParseOptions(argc, argv, &opt))
+  {
+    wprintf(L"usage: HelpersBench [-lengths n,n,...] [-filter text] [-mintime ms]\n"
+            L"                    [-save file] [-baseline file] [-threshold percent]\n");
+    return 2;
+  }
+
+  HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+  if (FAILED(hr))
+  {
+    wprintf(L"CoInitializeEx failed: 0x%08x\n", hr);
+    return 1;
+  }
+
+  std::vector<BENCH_RESULT> rgBaseline;
+  if (opt.pwzBaseline)
+  {
+    hr = _LoadResults(opt.pwzBaseline, &rgBaseline);
+    if (FAILED(hr))
+    {
+      wprintf(L"could not read %s: 0x%08x\n", opt.pwzBaseline, hr);
+    }
+  }
+
+  DWORD cRegressions = 0;
+  if (SUCCEEDED(hr))
+  {
+    WCHAR wszAuditFile[MAX_PATH];
+    DWORD cchTemp = GetTempPathW(ARRAYSIZE(wszAuditFile), wszAuditFile);
+    bool fAuditLog = cchTemp && cchTemp < ARRAYSIZE(wszAuditFile) &&
+      SUCCEEDED(StringCchCatW(wszAuditFile, ARRAYSIZE(wszAuditFile), L"HelpersBench.audit")) &&
+      PR_OK == AuditLogOpen(wszAuditFile);
+
+    s_pCatalog = ReportResultMessageCatalog(NULL);
+
+    std::vector<BENCH_RESULT> rgResults;
+    ULONGLONG ullStart = GetTickCount64();
+    hr = _RunAll(opt, &rgResults);
+    ThreadPoolShutdown(false);
+    ReportResultMessageShutdown();
+
+    if (fAuditLog)
+    {
+      AuditLogClose();
+      ULONGLONG ullElapsedMs = GetTickCount64() - ullStart;
+      AUDIT_STATS stats;
+      AuditLogGetStats(&stats);
+      wprintf(L"audit log: %I64u recorded, %I64u dropped, %I64u written in %I64u batches (%I64u records/s), %I64u rotations\n",
+        stats.cRecorded, stats.cDropped, stats.cWritten, stats.cBatches,
+        ullElapsedMs ? stats.cWritten * 1000 / ullElapsedMs : 0, stats.cRotations);
+      DeleteFileW(wszAuditFile);
+      for (DWORD i = 1; i <= AUDIT_ROTATE_KEEP; i++)
+      {
+        WCHAR wszRotated[MAX_PATH + 8];
+        if (SUCCEEDED(StringCchPrintfW(wszRotated, ARRAYSIZE(wszRotated), L"%s.%u", wszAuditFile, i)))
+        {
+          DeleteFileW(wszRotated);
+        }
+      }
+    }
+
+    cRegressions = _PrintResults(rgResults, rgBaseline, opt.dThresholdPercent);
+    if (opt.pwzSave && SUCCEEDED(hr))
+    {
+      hr = _SaveResults(opt.pwzSave, rgResults);
+      if (FAILED(hr))
+      {
+        wprintf(L"could not write %s: 0x%08x\n", opt.pwzSave, hr);
+      }
+    }
+  }
+
+  if (cRegressions)
+  {
+    wprintf(L"\n%u regression(s) against %s\n", cRegressions, opt.pwzBaseline);
+  }
+
+  CoUninitialize();
+  return (SUCCEEDED(hr) && cRegressions == 0) ? 0 : 1;
+}
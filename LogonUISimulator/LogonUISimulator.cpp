@@ -0,0 +1,1189 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// LogonUISimulator loads AutoLoginCredentialProvider.dll the way LogonUI does (through
+// DllGetClassObject and IClassFactory), drives a provider through the calls LogonUI makes
+// to show a tile and submit it, and reports how long each call took.  Nothing is actually
+// submitted to LSA; the status passed to ReportResult is whatever -status says.  It then
+// prints the provider's own view of the logon attempts (see LogonAttempt.h): percentiles of
+// the time from SetUsageScenario to each later milestone.
+//
+// Usage: LogonUISimulator [-dll path] [-n logons] [-polls n] [-scenario logon|unlock]
+//                         [-status ntstatus] [-substatus ntstatus] [-password text]
+//        LogonUISimulator -report histogram-file...
+//        LogonUISimulator [-dll path] -footprint n,n,...
+//        LogonUISimulator [-dll path] -sessions n
+//        LogonUISimulator [-dll path] -replay n
+//
+// The second form merges latency histogram files written by the provider (see the
+// HistogramFile setting in readme.txt), from one machine or many, and prints percentiles
+// for each phase.
+//
+// The tile is driven whatever its layout (see the TileLayout setting in readme.txt):
+// -password is typed into any edit or password field a keystroke at a time, as LogonUI would
+// pass it on.
+// Run once per layout to compare what painting each one costs.
+//
+// -footprint makes n tiles of every layout at once, for each n given, and prints what each
+// tile takes: what the provider counts itself and how much the process's private commit
+// grew (see DllGetTileFootprint).  No logons are simulated.
+//
+// -sessions stands in for a Remote Desktop host with n sessions at the logon screen, each
+// with a LogonUI of its own.  It loads the account itself, which publishes it to the segment
+// shared between sessions (see SharedAccountCache.h) and keeps that open, then starts n
+// processes that load the account without the segment, one after another, and n that load
+// it through the segment.  It prints what a load took on average each way, and what the
+// segment saves each session (see DllMeasureAccountLoad).  Creating the segment takes an
+// administrator, as LogonUI runs as SYSTEM.
+//
+// -replay stands in for a Remote Desktop client reconnecting over and over.  It takes the
+// serialization the tile makes of the account and hands it back to one provider n times,
+// each time followed by GetCredentialCount and GetCredentialAt, as LogonUI does; then n times
+// more, alternating with a copy that differs by a byte, so that no call repeats the one
+// before.  It prints the timings of each run, and fails unless the same serialization kept
+// its tile every time after the first and each changed one got a new tile.
+
+#ifndef WIN32_NO_STATUS
+#include <ntstatus.h>
+#define WIN32_NO_STATUS
+#endif
+#include <windows.h>
+#include <unknwn.h>
+#include <credentialprovider.h>
+#include <shlwapi.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <Histogram.h>
+#include <LogonAttempt.h>
+#include <SharedAccountCache.h>
+#include <TileSchema.h>
+
+// {6A9D21B0-D809-4106-8AEA-52783737C41A}
+static const CLSID CLSID_AutoLoginProvider =
+{ 0x6a9d21b0, 0xd809, 0x4106, { 0x8a, 0xea, 0x52, 0x78, 0x37, 0x37, 0xc4, 0x1a } };
+
+typedef HRESULT (STDAPICALLTYPE *PFNDLLGETCLASSOBJECT)(REFCLSID, REFIID, void**);
+typedef HRESULT (STDAPICALLTYPE *PFNDLLCANUNLOADNOW)();
+typedef HRESULT (STDAPICALLTYPE *PFNDLLGETLOGONATTEMPTSTATS)(LOGON_ATTEMPT_STATS*);
+typedef HRESULT (STDAPICALLTYPE *PFNDLLGETTILEFOOTPRINT)(DWORD, DWORD, TILE_FOOTPRINT*);
+typedef HRESULT (STDAPICALLTYPE *PFNDLLMEASUREACCOUNTLOAD)(BOOL, ACCOUNT_LOAD_SAMPLE*);
+
+// SIM_OPTIONS::dwSessionChild of the process the user started.
+#define SIM_NOT_SESSION_CHILD ((DWORD)-1)
+
+static const PCWSTR s_rgpwzLayoutNames[] =
+{
+  L"username",
+  L"username+domain",
+  L"password",
+};
+
+static_assert(ARRAYSIZE(s_rgpwzLayoutNames) == TL_NUM_LAYOUTS, "every TILE_LAYOUT needs a name");
+
+static const PCWSTR s_rgpwzMilestoneNames[] =
+{
+  L"SetUsageScenario",
+  L"GetCredentialAt",
+  L"SetSelected",
+  L"GetSerialization",
+  L"ReportResult",
+};
+
+static_assert(ARRAYSIZE(s_rgpwzMilestoneNames) == LAM_NUM_MILESTONES, "every milestone needs a name");
+
+// The calls we time, in the order LogonUI makes them.
+enum SIM_CALL
+{
+  SC_DLLGETCLASSOBJECT,
+  SC_CREATEINSTANCE,
+  SC_SETUSAGESCENARIO,
+  SC_SETSERIALIZATION,
+  SC_ADVISE,
+  SC_GETFIELDDESCRIPTORCOUNT,
+  SC_GETFIELDDESCRIPTORAT,
+  SC_GETCREDENTIALCOUNT,
+  SC_GETCREDENTIALAT,
+  SC_CREDENTIAL_ADVISE,
+  SC_SETSELECTED,
+  SC_SETSTRINGVALUE,
+  SC_GETFIELDSTATE,
+  SC_GETSTRINGVALUE,
+  SC_GETBITMAPVALUE,
+  SC_GETSUBMITBUTTONVALUE,
+  SC_GETSERIALIZATION,
+  SC_REPORTRESULT,
+  SC_SETDESELECTED,
+  SC_CREDENTIAL_UNADVISE,
+  SC_UNADVISE,
+  SC_RELEASE,
+  SC_TOTAL,
+  SC_NUM_CALLS,
+};
+
+static const PCWSTR s_rgpwzCallNames[] =
+{
+  L"DllGetClassObject",
+  L"CreateInstance",
+  L"SetUsageScenario",
+  L"SetSerialization",
+  L"Advise",
+  L"GetFieldDescriptorCount",
+  L"GetFieldDescriptorAt",
+  L"GetCredentialCount",
+  L"GetCredentialAt",
+  L"Credential::Advise",
+  L"SetSelected",
+  L"SetStringValue",
+  L"GetFieldState",
+  L"GetStringValue",
+  L"GetBitmapValue",
+  L"GetSubmitButtonValue",
+  L"GetSerialization",
+  L"ReportResult",
+  L"SetDeselected",
+  L"Credential::UnAdvise",
+  L"UnAdvise",
+  L"Release",
+  L"(whole logon)",
+};
+
+static_assert(ARRAYSIZE(s_rgpwzCallNames) == SC_NUM_CALLS, "every SIM_CALL needs a name");
+
+struct SIM_OPTIONS
+{
+  PCWSTR                             pwzDll;
+  DWORD                              cLogons;
+  DWORD                              cPolls;   // GetFieldState/GetStringValue rounds per logon, like repaints
+  CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus;
+  NTSTATUS                           ntsStatus;
+  NTSTATUS                           ntsSubstatus;
+  PCWSTR                             pwzPassword;  // typed into edit and password fields
+  std::vector<DWORD>                 rgcFootprintTiles;  // -footprint; empty to simulate logons
+  DWORD                              cSessions;          // -sessions; 0 to simulate logons
+  DWORD                              dwSessionChild;     // -session-child, which -sessions passes the
+                                                         // processes it starts: whether to use the
+                                                         // shared segment
+  DWORD                              cReplays;           // -replay; 0 to simulate logons
+};
+
+// Per-call latency samples, in QueryPerformanceCounter ticks.
+class CCallTimings
+{
+public:
+  CCallTimings()
+  {
+    LARGE_INTEGER li;
+    QueryPerformanceFrequency(&li);
+    _llFrequency = li.QuadPart;
+  }
+
+  static LONGLONG Now()
+  {
+    LARGE_INTEGER li;
+    QueryPerformanceCounter(&li);
+    return li.QuadPart;
+  }
+
+  void Record(__in SIM_CALL sc, __in LONGLONG llStart)
+  {
+    _rgSamples[sc].push_back(Now() - llStart);
+  }
+
+  void Print()
+  {
+    wprintf(L"%-26s %8s %10s %10s %10s %10s %10s\n", L"call (us)", L"count", L"min", L"p50", L"p99", L"max", L"mean");
+    for (DWORD i = 0; i < SC_NUM_CALLS; i++)
+    {
+      std::vector<LONGLONG>& samples = _rgSamples[i];
+      if (samples.empty())
+      {
+        continue;
+      }
+
+      std::sort(samples.begin(), samples.end());
+      LONGLONG llSum = 0;
+      for (size_t j = 0; j < samples.size(); j++)
+      {
+        llSum += samples[j];
+      }
+      wprintf(L"%-26s %8u %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+        s_rgpwzCallNames[i],
+        (UINT)samples.size(),
+        _Micros(samples.front()),
+        _Micros(_Percentile(samples, 50)),
+        _Micros(_Percentile(samples, 99)),
+        _Micros(samples.back()),
+        _Micros(llSum) / (double)samples.size());
+    }
+  }
+
+private:
+  static LONGLONG _Percentile(__in const std::vector<LONGLONG>& sorted, __in DWORD dwPercent)
+  {
+    return sorted[(sorted.size() - 1) * dwPercent / 100];
+  }
+
+  double _Micros(__in LONGLONG llTicks) const
+  {
+    return (double)llTicks * 1000000.0 / (double)_llFrequency;
+  }
+
+  LONGLONG              _llFrequency;
+  std::vector<LONGLONG> _rgSamples[SC_NUM_CALLS];
+};
+
+// Times one call into the provider and bails out of the logon if it fails.
+#define SIM_CALL_CHECKED(sc, expr)                                                  \
+  {                                                                                 \
+    LONGLONG llStart = CCallTimings::Now();                                         \
+    hr = (expr);                                                                    \
+    pTimings->Record(sc, llStart);                                                  \
+    if (FAILED(hr))                                                                 \
+    {                                                                               \
+      wprintf(L"%s failed: 0x%08x\n", s_rgpwzCallNames[sc], hr);                    \
+      goto Cleanup;                                                                 \
+    }                                                                               \
+  }
+
+// Times one call into the provider whose failure LogonUI would shrug off.
+#define SIM_CALL_OPTIONAL(sc, expr)                                                 \
+  {                                                                                 \
+    LONGLONG llStart = CCallTimings::Now();                                         \
+    (void)(expr);                                                                   \
+    pTimings->Record(sc, llStart);                                                  \
+  }
+
+// Stands in for LogonUI's end of ICredentialProviderEvents and
+// ICredentialProviderCredentialEvents.  It accepts every update and counts them.
+class CSimulatorEvents : public ICredentialProviderEvents, public ICredentialProviderCredentialEvents
+{
+public:
+  CSimulatorEvents() : cCredentialsChanged(0), cFieldUpdates(0), _cRef(1)
+  {
+  }
+
+  // IUnknown
+  IFACEMETHODIMP QueryInterface(__in REFIID riid, __deref_out void** ppv)
+  {
+    static const QITAB qit[] =
+    {
+        QITABENT(CSimulatorEvents, ICredentialProviderEvents),
+        QITABENT(CSimulatorEvents, ICredentialProviderCredentialEvents),
+        {0},
+    };
+    return QISearch(this, qit, riid, ppv);
+  }
+
+  IFACEMETHODIMP_(ULONG) AddRef()
+  {
+    return InterlockedIncrement(&_cRef);
+  }
+
+  IFACEMETHODIMP_(ULONG) Release()
+  {
+    LONG cRef = InterlockedDecrement(&_cRef);
+    if (!cRef)
+    {
+      delete this;
+    }
+    return cRef;
+  }
+
+  // ICredentialProviderEvents
+  IFACEMETHODIMP CredentialsChanged(__in UINT_PTR upAdviseContext)
+  {
+    UNREFERENCED_PARAMETER(upAdviseContext);
+    InterlockedIncrement(&cCredentialsChanged);
+    return S_OK;
+  }
+
+  // ICredentialProviderCredentialEvents
+  IFACEMETHODIMP SetFieldState(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID, __in CREDENTIAL_PROVIDER_FIELD_STATE cpfs)
+  {
+    UNREFERENCED_PARAMETER(pcpc);
+    UNREFERENCED_PARAMETER(dwFieldID);
+    UNREFERENCED_PARAMETER(cpfs);
+    return _FieldUpdated();
+  }
+
+  IFACEMETHODIMP SetFieldInteractiveState(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID, __in CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE cpfis)
+  {
+    UNREFERENCED_PARAMETER(pcpc);
+    UNREFERENCED_PARAMETER(dwFieldID);
+    UNREFERENCED_PARAMETER(cpfis);
+    return _FieldUpdated();
+  }
+
+  IFACEMETHODIMP SetFieldString(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID, __in PCWSTR psz)
+  {
+    UNREFERENCED_PARAMETER(pcpc);
+    UNREFERENCED_PARAMETER(dwFieldID);
+    UNREFERENCED_PARAMETER(psz);
+    return _FieldUpdated();
+  }
+
+  IFACEMETHODIMP SetFieldCheckbox(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID, __in BOOL bChecked, __in PCWSTR pszLabel)
+  {
+    UNREFERENCED_PARAMETER(pcpc);
+    UNREFERENCED_PARAMETER(dwFieldID);
+    UNREFERENCED_PARAMETER(bChecked);
+    UNREFERENCED_PARAMETER(pszLabel);
+    return _FieldUpdated();
+  }
+
+  IFACEMETHODIMP SetFieldBitmap(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID, __in HBITMAP hbmp)
+  {
+    UNREFERENCED_PARAMETER(pcpc);
+    UNREFERENCED_PARAMETER(dwFieldID);
+    UNREFERENCED_PARAMETER(hbmp);
+    return _FieldUpdated();
+  }
+
+  IFACEMETHODIMP SetFieldComboBoxSelectedItem(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID, __in DWORD dwSelectedItem)
+  {
+    UNREFERENCED_PARAMETER(pcpc);
+    UNREFERENCED_PARAMETER(dwFieldID);
+    UNREFERENCED_PARAMETER(dwSelectedItem);
+    return _FieldUpdated();
+  }
+
+  IFACEMETHODIMP DeleteFieldComboBoxItem(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID, __in DWORD dwItem)
+  {
+    UNREFERENCED_PARAMETER(pcpc);
+    UNREFERENCED_PARAMETER(dwFieldID);
+    UNREFERENCED_PARAMETER(dwItem);
+    return _FieldUpdated();
+  }
+
+  IFACEMETHODIMP AppendFieldComboBoxItem(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID, __in PCWSTR pszItem)
+  {
+    UNREFERENCED_PARAMETER(pcpc);
+    UNREFERENCED_PARAMETER(dwFieldID);
+    UNREFERENCED_PARAMETER(pszItem);
+    return _FieldUpdated();
+  }
+
+  IFACEMETHODIMP SetFieldSubmitButton(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID, __in DWORD dwAdjacentTo)
+  {
+    UNREFERENCED_PARAMETER(pcpc);
+    UNREFERENCED_PARAMETER(dwFieldID);
+    UNREFERENCED_PARAMETER(dwAdjacentTo);
+    return _FieldUpdated();
+  }
+
+  IFACEMETHODIMP OnCreatingWindow(__out HWND* phwndOwner)
+  {
+    // There is no window; providers must cope with that.
+    *phwndOwner = NULL;
+    return E_NOTIMPL;
+  }
+
+  LONG cCredentialsChanged;
+  LONG cFieldUpdates;
+
+private:
+  ~CSimulatorEvents()
+  {
+  }
+
+  HRESULT _FieldUpdated()
+  {
+    InterlockedIncrement(&cFieldUpdates);
+    return S_OK;
+  }
+
+  LONG _cRef;
+};
+
+// Frees a field descriptor the way LogonUI does: the label, then the descriptor.
+static void _FreeFieldDescriptor(__in CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR* pcpfd)
+{
+  if (pcpfd)
+  {
+    CoTaskMemFree(pcpfd->pszLabel);
+    CoTaskMemFree(pcpfd);
+  }
+}
+
+// Runs one logon against a fresh provider instance.
+static HRESULT _SimulateLogon(
+  __in const SIM_OPTIONS& opt,
+  __in PFNDLLGETCLASSOBJECT pfnDllGetClassObject,
+  __in CSimulatorEvents* pEvents,
+  __inout CCallTimings* pTimings
+)
+{
+  HRESULT hr;
+  IClassFactory* pcf = NULL;
+  ICredentialProvider* pcp = NULL;
+  ICredentialProviderCredential* pcpc = NULL;
+  std::vector<CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR*> rgpcpfd;
+  DWORD cFields = 0;
+  DWORD cCredentials = 0;
+  DWORD dwDefault = CREDENTIAL_PROVIDER_NO_DEFAULT;
+  BOOL bAutoLogonWithDefault = FALSE;
+  BOOL bAutoLogon = FALSE;
+  bool fProviderAdvised = false;
+  bool fCredentialAdvised = false;
+  bool fSelected = false;
+  LONGLONG llLogonStart = CCallTimings::Now();
+
+  SIM_CALL_CHECKED(SC_DLLGETCLASSOBJECT, pfnDllGetClassObject(CLSID_AutoLoginProvider, IID_PPV_ARGS(&pcf)));
+  SIM_CALL_CHECKED(SC_CREATEINSTANCE, pcf->CreateInstance(NULL, IID_PPV_ARGS(&pcp)));
+  SIM_CALL_CHECKED(SC_SETUSAGESCENARIO, pcp->SetUsageScenario(opt.cpus, 0));
+
+  {
+    // Providers may decline Advise; LogonUI carries on regardless.
+    LONGLONG llStart = CCallTimings::Now();
+    fProviderAdvised = SUCCEEDED(pcp->Advise(pEvents, 0));
+    pTimings->Record(SC_ADVISE, llStart);
+  }
+
+  SIM_CALL_CHECKED(SC_GETFIELDDESCRIPTORCOUNT, pcp->GetFieldDescriptorCount(&cFields));
+  rgpcpfd.resize(cFields, NULL);
+  for (DWORD i = 0; i < cFields; i++)
+  {
+    SIM_CALL_CHECKED(SC_GETFIELDDESCRIPTORAT, pcp->GetFieldDescriptorAt(i, &rgpcpfd[i]));
+  }
+
+  SIM_CALL_CHECKED(SC_GETCREDENTIALCOUNT, pcp->GetCredentialCount(&cCredentials, &dwDefault, &bAutoLogonWithDefault));
+  if (cCredentials == 0)
+  {
+    wprintf(L"provider enumerated no tiles\n");
+    hr = E_FAIL;
+    goto Cleanup;
+  }
+
+  // Only the default tile (or the first) is driven; the others would just be painted.
+  SIM_CALL_CHECKED(SC_GETCREDENTIALAT, pcp->GetCredentialAt(dwDefault < cCredentials ? dwDefault : 0, &pcpc));
+  SIM_CALL_CHECKED(SC_CREDENTIAL_ADVISE, pcpc->Advise(pEvents));
+  fCredentialAdvised = true;
+
+  // Paint the tile: LogonUI asks for the state and contents of every field, and keeps
+  // asking as the tile is repainted.
+  for (DWORD dwPoll = 0; dwPoll < opt.cPolls; dwPoll++)
+  {
+    for (DWORD i = 0; i < cFields; i++)
+    {
+      CREDENTIAL_PROVIDER_FIELD_STATE cpfs;
+      CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE cpfis;
+      SIM_CALL_CHECKED(SC_GETFIELDSTATE, pcpc->GetFieldState(i, &cpfs, &cpfis));
+
+      switch (rgpcpfd[i]->cpft)
+      {
+      case CPFT_TILE_IMAGE:
+        if (dwPoll == 0)
+        {
+          HBITMAP hbmp = NULL;
+          SIM_CALL_CHECKED(SC_GETBITMAPVALUE, pcpc->GetBitmapValue(i, &hbmp));
+          DeleteObject(hbmp);
+        }
+        break;
+
+      case CPFT_SUBMIT_BUTTON:
+        if (dwPoll == 0)
+        {
+          DWORD dwAdjacentTo;
+          SIM_CALL_CHECKED(SC_GETSUBMITBUTTONVALUE, pcpc->GetSubmitButtonValue(i, &dwAdjacentTo));
+        }
+        break;
+
+      case CPFT_LARGE_TEXT:
+      case CPFT_SMALL_TEXT:
+      case CPFT_EDIT_TEXT:
+      case CPFT_PASSWORD_TEXT:
+      case CPFT_COMMAND_LINK:
+        {
+          PWSTR pwz = NULL;
+          SIM_CALL_CHECKED(SC_GETSTRINGVALUE, pcpc->GetStringValue(i, &pwz));
+          CoTaskMemFree(pwz);
+        }
+        break;
+
+      default:
+        break;
+      }
+    }
+  }
+
+  SIM_CALL_CHECKED(SC_SETSELECTED, pcpc->SetSelected(&bAutoLogon));
+  fSelected = true;
+
+  // Type into the fields the user would: LogonUI hands over the whole value on every keystroke.
+  for (DWORD i = 0; i < cFields; i++)
+  {
+    if (rgpcpfd[i]->cpft == CPFT_EDIT_TEXT || rgpcpfd[i]->cpft == CPFT_PASSWORD_TEXT)
+    {
+      std::wstring strTyped;
+      for (PCWSTR pwz = opt.pwzPassword; *pwz; pwz++)
+      {
+        strTyped += *pwz;
+        SIM_CALL_CHECKED(SC_SETSTRINGVALUE, pcpc->SetStringValue(i, strTyped.c_str()));
+      }
+    }
+  }
+
+  {
+    CREDENTIAL_PROVIDER_GET_SERIALIZATION_RESPONSE cpgsr;
+    CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION cpcs = {};
+    PWSTR pwzStatus = NULL;
+    CREDENTIAL_PROVIDER_STATUS_ICON cpsi = CPSI_NONE;
+
+    SIM_CALL_CHECKED(SC_GETSERIALIZATION, pcpc->GetSerialization(&cpgsr, &cpcs, &pwzStatus, &cpsi));
+    if (cpcs.rgbSerialization)
+    {
+      SecureZeroMemory(cpcs.rgbSerialization, cpcs.cbSerialization);
+      CoTaskMemFree(cpcs.rgbSerialization);
+    }
+    CoTaskMemFree(pwzStatus);
+  }
+
+  {
+    PWSTR pwzStatus = NULL;
+    CREDENTIAL_PROVIDER_STATUS_ICON cpsi = CPSI_NONE;
+    SIM_CALL_CHECKED(SC_REPORTRESULT, pcpc->ReportResult(opt.ntsStatus, opt.ntsSubstatus, &pwzStatus, &cpsi));
+    CoTaskMemFree(pwzStatus);
+  }
+
+Cleanup:
+  if (pcpc)
+  {
+    if (fSelected)
+    {
+      SIM_CALL_OPTIONAL(SC_SETDESELECTED, pcpc->SetDeselected());
+    }
+    if (fCredentialAdvised)
+    {
+      SIM_CALL_OPTIONAL(SC_CREDENTIAL_UNADVISE, pcpc->UnAdvise());
+    }
+    pcpc->Release();
+  }
+  for (size_t i = 0; i < rgpcpfd.size(); i++)
+  {
+    _FreeFieldDescriptor(rgpcpfd[i]);
+  }
+  if (pcp)
+  {
+    if (fProviderAdvised)
+    {
+      SIM_CALL_OPTIONAL(SC_UNADVISE, pcp->UnAdvise());
+    }
+    SIM_CALL_OPTIONAL(SC_RELEASE, pcp->Release());
+  }
+  if (pcf)
+  {
+    pcf->Release();
+  }
+  if (SUCCEEDED(hr))
+  {
+    pTimings->Record(SC_TOTAL, llLogonStart);
+  }
+  return hr;
+}
+
+// Hands rgbSerialization to pcp cReplays times, alternating with rgbChanged if it is given,
+// and fetches the default tile after each as LogonUI does.  *pcKept counts the replays after
+// which the default tile was the one the replay before left; the tile from the replay before
+// is held meanwhile, so a new tile can't reuse its address.
+static HRESULT _Replay(
+  __in ICredentialProvider* pcp,
+  __in const CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION& cpcs,
+  __in const std::vector<BYTE>& rgbChanged,
+  __in DWORD cReplays,
+  __inout CCallTimings* pTimings,
+  __out DWORD* pcKept
+)
+{
+  HRESULT hr = S_OK;
+  ICredentialProviderCredential* pcpcBefore = NULL;
+  CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION cpcsChanged = cpcs;
+  if (!rgbChanged.empty())
+  {
+    cpcsChanged.rgbSerialization = const_cast<BYTE*>(&rgbChanged[0]);
+    cpcsChanged.cbSerialization = (ULONG)rgbChanged.size();
+  }
+
+  *pcKept = 0;
+  for (DWORD i = 0; i < cReplays; i++)
+  {
+    DWORD cCredentials;
+    DWORD dwDefault;
+    BOOL bAutoLogonWithDefault;
+    ICredentialProviderCredential* pcpc;
+    SIM_CALL_CHECKED(SC_SETSERIALIZATION, pcp->SetSerialization((i & 1) ? &cpcsChanged : &cpcs));
+    SIM_CALL_CHECKED(SC_GETCREDENTIALCOUNT, pcp->GetCredentialCount(&cCredentials, &dwDefault, &bAutoLogonWithDefault));
+    if (dwDefault >= cCredentials)
+    {
+      wprintf(L"the serialization got no default tile\n");
+      hr = E_FAIL;
+      goto Cleanup;
+    }
+    SIM_CALL_CHECKED(SC_GETCREDENTIALAT, pcp->GetCredentialAt(dwDefault, &pcpc));
+    *pcKept += (pcpc == pcpcBefore) ? 1 : 0;
+    if (pcpcBefore)
+    {
+      pcpcBefore->Release();
+    }
+    pcpcBefore = pcpc;
+  }
+
+Cleanup:
+  if (pcpcBefore)
+  {
+    pcpcBefore->Release();
+  }
+  return hr;
+}
+
+static HRESULT _ReplaySerialization(__in const SIM_OPTIONS& opt, __in PFNDLLGETCLASSOBJECT pfnDllGetClassObject)
+{
+  HRESULT hr;
+  CCallTimings timingsSetup;
+  CCallTimings timingsSame;
+  CCallTimings timingsAlternating;
+  CCallTimings* pTimings = &timingsSetup;
+  IClassFactory* pcf = NULL;
+  ICredentialProvider* pcp = NULL;
+  ICredentialProviderCredential* pcpc = NULL;
+  CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION cpcs = {};
+  std::vector<BYTE> rgbChanged;
+  DWORD cCredentials = 0;
+  DWORD dwDefault = CREDENTIAL_PROVIDER_NO_DEFAULT;
+  BOOL bAutoLogonWithDefault = FALSE;
+  DWORD cKeptSame = 0;
+  DWORD cKeptAlternating = 0;
+
+  SIM_CALL_CHECKED(SC_DLLGETCLASSOBJECT, pfnDllGetClassObject(CLSID_AutoLoginProvider, IID_PPV_ARGS(&pcf)));
+  SIM_CALL_CHECKED(SC_CREATEINSTANCE, pcf->CreateInstance(NULL, IID_PPV_ARGS(&pcp)));
+  SIM_CALL_CHECKED(SC_SETUSAGESCENARIO, pcp->SetUsageScenario(opt.cpus, 0));
+  SIM_CALL_CHECKED(SC_GETCREDENTIALCOUNT, pcp->GetCredentialCount(&cCredentials, &dwDefault, &bAutoLogonWithDefault));
+  if (cCredentials == 0)
+  {
+    wprintf(L"provider enumerated no tiles\n");
+    hr = E_FAIL;
+    goto Cleanup;
+  }
+  SIM_CALL_CHECKED(SC_GETCREDENTIALAT, pcp->GetCredentialAt(dwDefault < cCredentials ? dwDefault : 0, &pcpc));
+
+  {
+    // What a client that saved the account would send.
+    CREDENTIAL_PROVIDER_GET_SERIALIZATION_RESPONSE cpgsr;
+    PWSTR pwzStatus = NULL;
+    CREDENTIAL_PROVIDER_STATUS_ICON cpsi = CPSI_NONE;
+    SIM_CALL_CHECKED(SC_GETSERIALIZATION, pcpc->GetSerialization(&cpgsr, &cpcs, &pwzStatus, &cpsi));
+    CoTaskMemFree(pwzStatus);
+  }
+  if (!cpcs.rgbSerialization || !cpcs.cbSerialization)
+  {
+    wprintf(L"the tile made no serialization\n");
+    hr = E_FAIL;
+    goto Cleanup;
+  }
+
+  // The copy has a byte more on the end, which unpacking ignores.
+  rgbChanged.assign(cpcs.rgbSerialization, cpcs.rgbSerialization + cpcs.cbSerialization);
+  rgbChanged.push_back(0);
+
+  hr = _Replay(pcp, cpcs, std::vector<BYTE>(), opt.cReplays, &timingsSame, &cKeptSame);
+  if (SUCCEEDED(hr))
+  {
+    hr = _Replay(pcp, cpcs, rgbChanged, opt.cReplays, &timingsAlternating, &cKeptAlternating);
+  }
+  if (SUCCEEDED(hr))
+  {
+    wprintf(L"%u replays of the same serialization, tile kept %u times\n\n", opt.cReplays, cKeptSame);
+    timingsSame.Print();
+    wprintf(L"\n%u replays alternating between two serializations, tile kept %u times\n\n", opt.cReplays,
+      cKeptAlternating);
+    timingsAlternating.Print();
+
+    // Only the first of the same run makes a tile.  The alternating run starts with the
+    // serialization the same run ended on, and after that every one is new.
+    if (cKeptSame != opt.cReplays - 1 || cKeptAlternating != 1)
+    {
+      wprintf(L"\nexpected the tile kept %u and 1 times\n", opt.cReplays - 1);
+      hr = E_FAIL;
+    }
+  }
+
+Cleanup:
+  if (cpcs.rgbSerialization)
+  {
+    SecureZeroMemory(cpcs.rgbSerialization, cpcs.cbSerialization);
+    CoTaskMemFree(cpcs.rgbSerialization);
+  }
+  if (!rgbChanged.empty())
+  {
+    SecureZeroMemory(&rgbChanged[0], rgbChanged.size());
+  }
+  if (pcpc)
+  {
+    pcpc->Release();
+  }
+  if (pcp)
+  {
+    pcp->Release();
+  }
+  if (pcf)
+  {
+    pcf->Release();
+  }
+  return hr;
+}
+
+static bool _ParseOptions(__in int argc, __in_ecount(argc) wchar_t* argv[], __out SIM_OPTIONS* popt)
+{
+  popt->pwzDll = L"AutoLoginCredentialProvider.dll";
+  popt->cLogons = 1000;
+  popt->cPolls = 10;
+  popt->cpus = CPUS_LOGON;
+  popt->ntsStatus = STATUS_SUCCESS;
+  popt->ntsSubstatus = STATUS_SUCCESS;
+  popt->pwzPassword = L"Passw0rd";
+  popt->cSessions = 0;
+  popt->dwSessionChild = SIM_NOT_SESSION_CHILD;
+  popt->cReplays = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    PCWSTR pwzValue = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (!pwzValue)
+    {
+      return false;
+    }
+
+    if (0 == lstrcmpiW(argv[i], L"-dll"))
+    {
+      popt->pwzDll = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-n"))
+    {
+      popt->cLogons = wcstoul(pwzValue, NULL, 0);
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-polls"))
+    {
+      popt->cPolls = wcstoul(pwzValue, NULL, 0);
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-scenario"))
+    {
+      if (0 == lstrcmpiW(pwzValue, L"logon"))
+      {
+        popt->cpus = CPUS_LOGON;
+      }
+      else if (0 == lstrcmpiW(pwzValue, L"unlock"))
+      {
+        popt->cpus = CPUS_UNLOCK_WORKSTATION;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-status"))
+    {
+      popt->ntsStatus = (NTSTATUS)wcstoul(pwzValue, NULL, 0);
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-substatus"))
+    {
+      popt->ntsSubstatus = (NTSTATUS)wcstoul(pwzValue, NULL, 0);
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-password"))
+    {
+      popt->pwzPassword = pwzValue;
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-footprint"))
+    {
+      for (PCWSTR pwz = pwzValue; *pwz; )
+      {
+        PWSTR pwzEnd;
+        DWORD cTiles = wcstoul(pwz, &pwzEnd, 10);
+        if (pwzEnd == pwz || !cTiles || (*pwzEnd && *pwzEnd != L','))
+        {
+          return false;
+        }
+        popt->rgcFootprintTiles.push_back(cTiles);
+        pwz = *pwzEnd ? pwzEnd + 1 : pwzEnd;
+      }
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-sessions"))
+    {
+      popt->cSessions = wcstoul(pwzValue, NULL, 10);
+      if (!popt->cSessions)
+      {
+        return false;
+      }
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-replay"))
+    {
+      popt->cReplays = wcstoul(pwzValue, NULL, 10);
+      if (!popt->cReplays)
+      {
+        return false;
+      }
+    }
+    else if (0 == lstrcmpiW(argv[i], L"-session-child"))
+    {
+      popt->dwSessionChild = wcstoul(pwzValue, NULL, 10);
+      if (popt->dwSessionChild > 1)
+      {
+        return false;
+      }
+    }
+    else
+    {
+      return false;
+    }
+    i++;
+  }
+
+  return true;
+}
+
+// Prints what the provider measured of the attempts, end to end across the calls.
+static void _PrintLogonAttempts(__in PFNDLLGETLOGONATTEMPTSTATS pfnDllGetLogonAttemptStats)
+{
+  LOGON_ATTEMPT_STATS stats;
+  if (FAILED(pfnDllGetLogonAttemptStats(&stats)))
+  {
+    return;
+  }
+
+  wprintf(L"\n%llu logon attempts, percentiles over the last %u\n", stats.cCompleted, stats.cWindow);
+  wprintf(L"%-26s %8s %10s %10s %10s %10s\n", L"time to (us)", L"count", L"p50", L"p90", L"p99", L"max");
+  for (DWORD lam = 0; lam < LAM_NUM_MILESTONES; lam++)
+  {
+    const LOGON_ATTEMPT_PERCENTILES& lap = stats.rgMilestones[lam];
+    wprintf(L"%-26s %8u %10.1f %10.1f %10.1f %10.1f\n",
+      s_rgpwzMilestoneNames[lam],
+      lap.cSamples,
+      lap.ullP50Ns / 1000.0,
+      lap.ullP90Ns / 1000.0,
+      lap.ullP99Ns / 1000.0,
+      lap.ullMaxNs / 1000.0);
+  }
+}
+
+// Prints the bytes per tile of every layout at each of rgcTiles.
+static HRESULT _PrintFootprint(__in PFNDLLGETTILEFOOTPRINT pfnDllGetTileFootprint, __in const std::vector<DWORD>& rgcTiles)
+{
+  HRESULT hr = S_OK;
+  wprintf(L"%-18s %10s %16s %16s\n", L"layout", L"tiles", L"owned B/tile", L"committed B/tile");
+  for (DWORD tl = 0; SUCCEEDED(hr) && tl < TL_NUM_LAYOUTS; tl++)
+  {
+    for (size_t i = 0; SUCCEEDED(hr) && i < rgcTiles.size(); i++)
+    {
+      TILE_FOOTPRINT tf;
+      hr = pfnDllGetTileFootprint(tl, rgcTiles[i], &tf);
+      if (SUCCEEDED(hr))
+      {
+        wprintf(L"%-18s %10u %16.1f %16.1f\n", s_rgpwzLayoutNames[tl], rgcTiles[i],
+          static_cast<double>(tf.cbTiles) / rgcTiles[i], static_cast<double>(tf.cbCommitted) / rgcTiles[i]);
+      }
+      else
+      {
+        wprintf(L"%-18s %10u failed: 0x%08x\n", s_rgpwzLayoutNames[tl], rgcTiles[i], hr);
+      }
+    }
+  }
+  return hr;
+}
+
+// Runs this program again as one session's LogonUI, for -sessions, and reads back the one
+// load it measures.
+static HRESULT _RunSessionChild(__in PCWSTR pwzExe, __in PCWSTR pwzDll, __in BOOL fUseSharedCache, __out ACCOUNT_LOAD_SAMPLE* pSample)
+{
+  ZeroMemory(pSample, sizeof(*pSample));
+
+  std::wstring strCommandLine = std::wstring(L"\"") + pwzExe + L"\" -dll \"" + pwzDll + L"\" -session-child " +
+    (fUseSharedCache ? L"1" : L"0");
+
+  SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+  HANDLE hRead;
+  HANDLE hWrite;
+  if (!CreatePipe(&hRead, &hWrite, &sa, 0))
+  {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+  SetHandleInformation(hRead, HANDLE_FLAG_INHERIT, 0);
+
+  STARTUPINFOW si = { sizeof(si) };
+  si.dwFlags = STARTF_USESTDHANDLES;
+  si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+  si.hStdOutput = hWrite;
+  si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+  PROCESS_INFORMATION pi;
+  HRESULT hr = CreateProcessW(NULL, &strCommandLine[0], NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi) ?
+    S_OK : HRESULT_FROM_WIN32(GetLastError());
+  CloseHandle(hWrite);
+
+  if (SUCCEEDED(hr))
+  {
+    // The child writes one short line and exits, closing its end of the pipe.
+    char szOutput[256];
+    DWORD cbOutput = 0;
+    DWORD cbRead;
+    while (cbOutput < sizeof(szOutput) - 1 && ReadFile(hRead, szOutput + cbOutput, sizeof(szOutput) - 1 - cbOutput, &cbRead, NULL) && cbRead)
+    {
+      cbOutput += cbRead;
+    }
+    szOutput[cbOutput] = '\0';
+
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    DWORD dwExitCode;
+    if (!GetExitCodeProcess(pi.hProcess, &dwExitCode) || dwExitCode)
+    {
+      hr = E_FAIL;
+    }
+    else if (4 != sscanf_s(szOutput, "%lu %llu %llu %llu", &pSample->fShared, &pSample->ullVersion, &pSample->ullNs, &pSample->cbCommitted))
+    {
+      hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+    CloseHandle(pi.hThread);
+    CloseHandle(pi.hProcess);
+  }
+  CloseHandle(hRead);
+  return hr;
+}
+
+// Measures cSessions account loads each way, one process per session, and prints the
+// averages.  See -sessions above.
+static HRESULT _PrintSessions(__in PFNDLLMEASUREACCOUNTLOAD pfnDllMeasureAccountLoad, __in PCWSTR pwzDll, __in DWORD cSessions)
+{
+  // The segment lives as long as some process has it open, so this one keeps it for the
+  // children: LogonUI in session 0 or any other session would do the same.
+  ACCOUNT_LOAD_SAMPLE sample;
+  HRESULT hr = pfnDllMeasureAccountLoad(TRUE, &sample);
+  if (FAILED(hr))
+  {
+    wprintf(L"could not load the account: 0x%08x\n", hr);
+    return hr;
+  }
+  wprintf(L"first load: %.1f us, %llu B committed, segment version %llu\n\n",
+    sample.ullNs / 1000.0, sample.cbCommitted, sample.ullVersion);
+
+  WCHAR wszExe[MAX_PATH];
+  if (!GetModuleFileNameW(NULL, wszExe, ARRAYSIZE(wszExe)))
+  {
+    return HRESULT_FROM_WIN32(GetLastError());
+  }
+
+  double rgdAverageNs[2] = {};
+  double rgdAverageCommitted[2] = {};
+  wprintf(L"%-14s %10s %10s %16s %16s\n", L"segment", L"sessions", L"shared", L"avg load (us)", L"avg committed B");
+  for (int iUse = 0; SUCCEEDED(hr) && iUse < 2; iUse++)
+  {
+    DWORD cShared = 0;
+    ULONGLONG ullTotalNs = 0;
+    ULONGLONG cbTotalCommitted = 0;
+    for (DWORD i = 0; SUCCEEDED(hr) && i < cSessions; i++)
+    {
+      hr = _RunSessionChild(wszExe, pwzDll, iUse, &sample);
+      if (SUCCEEDED(hr))
+      {
+        cShared += sample.fShared ? 1 : 0;
+        ullTotalNs += sample.ullNs;
+        cbTotalCommitted += sample.cbCommitted;
+      }
+      else
+      {
+        wprintf(L"session %u failed: 0x%08x\n", i, hr);
+      }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+      rgdAverageNs[iUse] = static_cast<double>(ullTotalNs) / cSessions;
+      rgdAverageCommitted[iUse] = static_cast<double>(cbTotalCommitted) / cSessions;
+      wprintf(L"%-14s %10u %10u %16.1f %16.1f\n", iUse ? L"used" : L"not used", cSessions, cShared,
+        rgdAverageNs[iUse] / 1000.0, rgdAverageCommitted[iUse]);
+    }
+  }
+
+  if (SUCCEEDED(hr))
+  {
+    wprintf(L"\nsaved per session: %.1f us, %.1f B committed\n",
+      (rgdAverageNs[0] - rgdAverageNs[1]) / 1000.0, rgdAverageCommitted[0] - rgdAverageCommitted[1]);
+  }
+  return hr;
+}
+
+// Merges the histogram files named in rgpwzFiles and prints each phase.
+static HRESULT _Report(__in int cFiles, __in_ecount(cFiles) wchar_t* rgpwzFiles[])
+{
+  HRESULT hr = S_OK;
+
+  LATENCY_PHASE_HISTOGRAMS* plph = new LATENCY_PHASE_HISTOGRAMS();
+  for (int i = 0; SUCCEEDED(hr) && i < cFiles; i++)
+  {
+    PLATFORM_RESULT pr = HistogramFileRead(rgpwzFiles[i], plph);
+    if (PR_OK != pr)
+    {
+      wprintf(L"could not read %s: PLATFORM_RESULT %d\n", rgpwzFiles[i], pr);
+      hr = (PR_NOT_FOUND == pr) ? HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) : HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+  }
+
+  if (SUCCEEDED(hr))
+  {
+    wprintf(L"%-36s %10s %10s %10s %10s %10s\n", L"phase (us)", L"count", L"p50", L"p99", L"p99.9", L"max");
+    for (DWORD lp = 0; lp < LP_NUM_PHASES; lp++)
+    {
+      const LATENCY_HISTOGRAM& h = plph->rgHistograms[lp];
+      ULONGLONG ullCount = HistogramTotalCount(h);
+      if (ullCount == 0)
+      {
+        continue;
+      }
+
+      wprintf(L"%-36s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+        LatencyPhaseName((LATENCY_PHASE)lp),
+        ullCount,
+        HistogramValueAtPercentile(h, 50.0) / 1000.0,
+        HistogramValueAtPercentile(h, 99.0) / 1000.0,
+        HistogramValueAtPercentile(h, 99.9) / 1000.0,
+        HistogramValueAtPercentile(h, 100.0) / 1000.0);
+    }
+  }
+
+  delete plph;
+  return hr;
+}
+
+int __cdecl wmain(__in int argc, __in_ecount(argc) wchar_t* argv[])
+{
+  if (argc >= 3 && 0 == lstrcmpiW(argv[1], L"-report"))
+  {
+    return SUCCEEDED(_Report(argc - 2, argv + 2)) ? 0 : 1;
+  }
+
+  SIM_OPTIONS opt;
+  if (!_ParseOptions(argc, argv, &opt))
+  {
+    wprintf(L"usage: LogonUISimulator [-dll path] [-n logons] [-polls n] [-scenario logon|unlock]\n"
+            L"                        [-status ntstatus] [-substatus ntstatus] [-password text]\n"
+            L"       LogonUISimulator -report histogram-file...\n"
+            L"       LogonUISimulator [-dll path] -footprint n,n,...\n"
+            L"       LogonUISimulator [-dll path] -sessions n\n"
+            L"       LogonUISimulator [-dll path] -replay n\n");
+    return 2;
+  }
+
+  HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+  if (FAILED(hr))
+  {
+    wprintf(L"CoInitializeEx failed: 0x%08x\n", hr);
+    return 1;
+  }
+
+  HMODULE hmod = LoadLibraryW(opt.pwzDll);
+  if (hmod)
+  {
+    PFNDLLGETCLASSOBJECT pfnDllGetClassObject = (PFNDLLGETCLASSOBJECT)GetProcAddress(hmod, "DllGetClassObject");
+    PFNDLLCANUNLOADNOW pfnDllCanUnloadNow = (PFNDLLCANUNLOADNOW)GetProcAddress(hmod, "DllCanUnloadNow");
+    PFNDLLGETTILEFOOTPRINT pfnDllGetTileFootprint = (PFNDLLGETTILEFOOTPRINT)GetProcAddress(hmod, "DllGetTileFootprint");
+    PFNDLLMEASUREACCOUNTLOAD pfnDllMeasureAccountLoad = (PFNDLLMEASUREACCOUNTLOAD)GetProcAddress(hmod, "DllMeasureAccountLoad");
+    if (SIM_NOT_SESSION_CHILD != opt.dwSessionChild || opt.cSessions)
+    {
+      if (!pfnDllMeasureAccountLoad)
+      {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        wprintf(L"%s does not export DllMeasureAccountLoad\n", opt.pwzDll);
+      }
+      else if (opt.cSessions)
+      {
+        hr = _PrintSessions(pfnDllMeasureAccountLoad, opt.pwzDll, opt.cSessions);
+      }
+      else
+      {
+        // Read back by _RunSessionChild.
+        ACCOUNT_LOAD_SAMPLE sample;
+        hr = pfnDllMeasureAccountLoad(opt.dwSessionChild, &sample);
+        if (SUCCEEDED(hr))
+        {
+          wprintf(L"%lu %llu %llu %llu\n", sample.fShared, sample.ullVersion, sample.ullNs, sample.cbCommitted);
+        }
+      }
+    }
+    else if (!opt.rgcFootprintTiles.empty())
+    {
+      if (pfnDllGetTileFootprint)
+      {
+        hr = _PrintFootprint(pfnDllGetTileFootprint, opt.rgcFootprintTiles);
+      }
+      else
+      {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+        wprintf(L"%s does not export DllGetTileFootprint\n", opt.pwzDll);
+      }
+    }
+    else if (opt.cReplays && pfnDllGetClassObject)
+    {
+      hr = _ReplaySerialization(opt, pfnDllGetClassObject);
+    }
+    else if (pfnDllGetClassObject && pfnDllCanUnloadNow)
+    {
+      CSimulatorEvents* pEvents = new CSimulatorEvents();
+      CCallTimings* pTimings = new CCallTimings();
+      DWORD cSucceeded = 0;
+
+      for (DWORD i = 0; i < opt.cLogons; i++)
+      {
+        hr = _SimulateLogon(opt, pfnDllGetClassObject, pEvents, pTimings);
+        if (FAILED(hr))
+        {
+          break;
+        }
+        cSucceeded++;
+      }
+
+      wprintf(L"%u of %u logons completed, %d field updates, %d credential changes\n\n",
+        cSucceeded, opt.cLogons, pEvents->cFieldUpdates, pEvents->cCredentialsChanged);
+      pTimings->Print();
+
+      // Older builds of the provider do not export it.
+      PFNDLLGETLOGONATTEMPTSTATS pfnDllGetLogonAttemptStats = (PFNDLLGETLOGONATTEMPTSTATS)GetProcAddress(hmod, "DllGetLogonAttemptStats");
+      if (pfnDllGetLogonAttemptStats)
+      {
+        _PrintLogonAttempts(pfnDllGetLogonAttemptStats);
+      }
+
+      // Every object we were handed has been released, so the DLL must be willing to go.
+      if (pfnDllCanUnloadNow() != S_OK)
+      {
+        wprintf(L"\nDllCanUnloadNow: the provider is still holding references\n");
+        hr = SUCCEEDED(hr) ? E_UNEXPECTED : hr;
+      }
+
+      delete pTimings;
+      pEvents->Release();
+    }
+    else
+    {
+      hr = HRESULT_FROM_WIN32(GetLastError());
+      wprintf(L"%s does not export DllGetClassObject/DllCanUnloadNow\n", opt.pwzDll);
+    }
+
+    // COM asks before it unloads a DLL, and that is when the provider closes its thread
+    // pool.  The other modes can leave the auth package lookup running, so give it a moment.
+    for (int i = 0; pfnDllCanUnloadNow && i < 100 && S_OK != pfnDllCanUnloadNow(); i++)
+    {
+      Sleep(10);
+    }
+    FreeLibrary(hmod);
+  }
+  else
+  {
+    hr = HRESULT_FROM_WIN32(GetLastError());
+    wprintf(L"could not load %s: 0x%08x\n", opt.pwzDll, hr);
+  }
+
+  CoUninitialize();
+  return SUCCEEDED(hr) ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// AccountName.h: every spelling of an account, in any case and with or without its domain
+// in the user name, is interned as the one identity; local names all come out as the
+// machine's, and a UPN stays an identity of its own.  The table stops at
+// ACCOUNT_NAME_MAX_IDENTITIES and hands threads interning at once the same identities.
+
+#include <stdio.h>
+#include <wchar.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+#include "AccountName.h"
+
+#define MACHINE L"KIOSK-7"
+#define INTERN_THREADS 4
+#define INTERN_ACCOUNTS 1000
+#define INTERN_NAMES 1000000
+
+static const ACCOUNT_IDENTITY* _Intern(const wchar_t* pwzDomain, const wchar_t* pwzUsername)
+{
+  const ACCOUNT_IDENTITY* pIdentity;
+  return CSR_OK == AccountNameIntern(pwzDomain, wcslen(pwzDomain), pwzUsername, wcslen(pwzUsername), MACHINE, wcslen(MACHINE), &pIdentity)
+    ? pIdentity : NULL;
+}
+
+static CREDENTIAL_STORE_RESULT _InternResult(const wchar_t* pwzDomain, const wchar_t* pwzUsername)
+{
+  const ACCOUNT_IDENTITY* pIdentity;
+  return AccountNameIntern(pwzDomain, wcslen(pwzDomain), pwzUsername, wcslen(pwzUsername), MACHINE, wcslen(MACHINE), &pIdentity);
+}
+
+static bool _Is(const ACCOUNT_IDENTITY* pIdentity, ACCOUNT_NAME_FORM anf, const wchar_t* pwzCanonical, size_t cchDomain)
+{
+  TEST_CHECK(pIdentity && anf == pIdentity->anf && 0 == wcscmp(pwzCanonical, pIdentity->pwzCanonical));
+  TEST_CHECK(cchDomain == pIdentity->cchDomain && wcslen(pwzCanonical) == pIdentity->cchDomain + 1U + pIdentity->cchUsername);
+  return true;
+}
+
+bool AccountNameFormsTest()
+{
+  AccountNameShutdown();
+  ACCOUNT_NAME_STATS stats;
+
+  // A domain account, however it is spelled.
+  const ACCOUNT_IDENTITY* pAlice = _Intern(L"CONTOSO", L"alice");
+  TEST_CHECK(_Is(pAlice, ANF_DOWN_LEVEL, L"CONTOSO\\ALICE", 7));
+  TEST_CHECK(pAlice == _Intern(L"contoso", L"ALICE") && pAlice == _Intern(L"", L"Contoso\\Alice"));
+  TEST_CHECK(pAlice == _Intern(L"FABRIKAM", L"contoso\\alice"));
+  TEST_CHECK(pAlice != _Intern(L"FABRIKAM", L"alice") && pAlice != _Intern(L"CONTOSO", L"alice2"));
+
+  // A local account: no domain, ".", or the machine's own name in any case.
+  const ACCOUNT_IDENTITY* pBob = _Intern(L"", L"bob");
+  TEST_CHECK(_Is(pBob, ANF_LOCAL, MACHINE L"\\BOB", 7));
+  TEST_CHECK(pBob == _Intern(L".", L"Bob") && pBob == _Intern(L"kiosk-7", L"BOB"));
+  TEST_CHECK(pBob == _Intern(L"", L".\\bob") && pBob == _Intern(L"", L"Kiosk-7\\bob"));
+  TEST_CHECK(pBob != _Intern(L"KIOSK-8", L"bob"));
+
+  // A UPN matches only itself, in any case; with a domain given, @ is part of the user name.
+  const ACCOUNT_IDENTITY* pUpn = _Intern(L"", L"alice@contoso.com");
+  TEST_CHECK(_Is(pUpn, ANF_UPN, L"ALICE@CONTOSO.COM", 11));
+  TEST_CHECK(pUpn == _Intern(L"", L"Alice@Contoso.COM") && pUpn != pAlice);
+  TEST_CHECK(_Is(_Intern(L"CONTOSO", L"alice@contoso.com"), ANF_DOWN_LEVEL, L"CONTOSO\\ALICE@CONTOSO.COM", 7));
+
+  // Letters outside ASCII are folded too.
+  const ACCOUNT_IDENTITY* pJurgen = _Intern(L"contoso", L"j\x00fcrgen");
+  TEST_CHECK(_Is(pJurgen, ANF_DOWN_LEVEL, L"CONTOSO\\J\x00dcRGEN", 7));
+  TEST_CHECK(pJurgen == _Intern(L"", L"CONTOSO\\J\x00dcRGEN"));
+
+  // Nothing that isn't a name is interned.
+  AccountNameGetStats(&stats);
+  unsigned long cIdentities = stats.cIdentities;
+  TEST_CHECK(8 == cIdentities);
+  TEST_CHECK(CSR_BAD_FORMAT == _InternResult(L"CONTOSO", L"") && CSR_BAD_FORMAT == _InternResult(L"", L"CONTOSO\\"));
+  TEST_CHECK(CSR_BAD_FORMAT == _InternResult(L"", L"CONTOSO\\alice\\x") && CSR_BAD_FORMAT == _InternResult(L"", L"alice@"));
+  TEST_CHECK(CSR_BAD_FORMAT == _InternResult(L"", L"alice@contoso@com") && CSR_BAD_FORMAT == _InternResult(L"", L"@contoso.com"));
+  std::wstring wstrLong(ACCOUNT_NAME_MAX_CCH, L'a');
+  TEST_CHECK(_Intern(L"CONTOSO", wstrLong.c_str()) && _Intern(wstrLong.c_str(), L"alice"));
+  wstrLong += L'a';
+  TEST_CHECK(CSR_BAD_FORMAT == _InternResult(L"CONTOSO", wstrLong.c_str()) && CSR_BAD_FORMAT == _InternResult(wstrLong.c_str(), L"alice"));
+  AccountNameGetStats(&stats);
+  TEST_CHECK(cIdentities + 2 == stats.cIdentities);
+
+  AccountNameShutdown();
+  AccountNameGetStats(&stats);
+  TEST_CHECK(0 == stats.cIdentities && 0 == stats.cbIdentities);
+  return true;
+}
+
+// The name of account i, as SetSerialization might spell it the jth time.
+static void _Spell(unsigned long i, unsigned long j, std::wstring* pwstrDomain, std::wstring* pwstrUsername)
+{
+  std::wstring wstrUser = ((0 == i % 8) ? L"j\x00fcrgen" : L"user") + std::to_wstring(i);
+  switch (j % 3)
+  {
+  case 0:
+    *pwstrDomain = L"CONTOSO";
+    *pwstrUsername = wstrUser;
+    break;
+
+  case 1:
+    pwstrDomain->clear();
+    *pwstrUsername = L"contoso\\" + wstrUser;
+    break;
+
+  default:
+    *pwstrDomain = L"Contoso";
+    pwstrUsername->clear();
+    for (size_t ich = 0; ich < wstrUser.size(); ich++)
+    {
+      *pwstrUsername += (wstrUser[ich] >= L'a' && wstrUser[ich] <= L'z') ? (wchar_t)(wstrUser[ich] - L'a' + L'A') : wstrUser[ich];
+    }
+    break;
+  }
+}
+
+bool AccountNameTableTest()
+{
+  AccountNameShutdown();
+
+  // Threads interning the same accounts at once, each spelled three ways, all get the
+  // identities the first spelling did.
+  std::vector<const ACCOUNT_IDENTITY*> rgpExpected(INTERN_ACCOUNTS);
+  for (unsigned long i = 0; i < INTERN_ACCOUNTS; i++)
+  {
+    std::wstring wstrDomain;
+    std::wstring wstrUsername;
+    _Spell(i, 0, &wstrDomain, &wstrUsername);
+    rgpExpected[i] = _Intern(wstrDomain.c_str(), wstrUsername.c_str());
+    TEST_CHECK(rgpExpected[i]);
+  }
+  std::vector<std::thread> rgThreads;
+  std::vector<unsigned long> rgcWrong(INTERN_THREADS);
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (int i = 0; i < INTERN_THREADS; i++)
+  {
+    rgThreads.push_back(std::thread([&rgpExpected, &rgcWrong, i]()
+    {
+      std::wstring wstrDomain;
+      std::wstring wstrUsername;
+      for (unsigned long j = 0; j < INTERN_NAMES / INTERN_THREADS; j++)
+      {
+        unsigned long iAccount = (j * 7 + i) % INTERN_ACCOUNTS;
+        _Spell(iAccount, j, &wstrDomain, &wstrUsername);
+        if (rgpExpected[iAccount] != _Intern(wstrDomain.c_str(), wstrUsername.c_str()))
+        {
+          rgcWrong[i]++;
+        }
+      }
+    }));
+  }
+  for (size_t i = 0; i < rgThreads.size(); i++)
+  {
+    rgThreads[i].join();
+  }
+  unsigned long long ullNs = PlatformMonotonicNanoseconds() - ullStart;
+  for (int i = 0; i < INTERN_THREADS; i++)
+  {
+    TEST_CHECK(0 == rgcWrong[i]);
+  }
+  ACCOUNT_NAME_STATS stats;
+  AccountNameGetStats(&stats);
+  TEST_CHECK(INTERN_ACCOUNTS == stats.cIdentities);
+  printf("  %d names from %d threads at once in %.1f ms, %.1f ns per name; %lu identities in %.1f bytes each\n",
+    INTERN_NAMES, INTERN_THREADS, ullNs / 1e6, (double)ullNs * INTERN_THREADS / INTERN_NAMES,
+    stats.cIdentities, (double)stats.cbIdentities / stats.cIdentities);
+
+  // The table stops at ACCOUNT_NAME_MAX_IDENTITIES, and still finds what it holds.
+  for (unsigned long i = stats.cIdentities; i < ACCOUNT_NAME_MAX_IDENTITIES; i++)
+  {
+    TEST_CHECK(_Intern(L"FABRIKAM", (L"user" + std::to_wstring(i)).c_str()));
+  }
+  TEST_CHECK(CSR_OUT_OF_MEMORY == _InternResult(L"FABRIKAM", L"one-too-many"));
+  TEST_CHECK(rgpExpected[1] == _Intern(L"", L"CONTOSO\\USER1"));
+  AccountNameGetStats(&stats);
+  TEST_CHECK(ACCOUNT_NAME_MAX_IDENTITIES == stats.cIdentities);
+
+  AccountNameShutdown();
+  return true;
+}
@@ -0,0 +1,126 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// AccountRecord.h: the domain, user name and password are one block, back to back and each
+// terminated, and the record is no more than the pointer to it and three lengths.  Strings
+// too long for a logon leave the record empty.  A tile's account costs less kept this way
+// than as the UserCredentials it was parsed into.
+
+#include <stdio.h>
+#include <wchar.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ProviderTests.h"
+#include "AccountRecord.h"
+
+#define FOOTPRINT_TILES 100000
+
+static bool _Holds(const CAccountRecord& record, const UserCredentials& uc)
+{
+  TEST_CHECK(uc.domain == record.Domain() && uc.domain.size() == record.DomainLength());
+  TEST_CHECK(uc.username == record.Username() && uc.username.size() == record.UsernameLength());
+  TEST_CHECK(uc.password == record.Password() && uc.password.size() == record.PasswordLength());
+  return true;
+}
+
+static bool _IsEmpty(const CAccountRecord& record)
+{
+  TEST_CHECK(0 == record.HeapBytes() && 0 == record.DomainLength() && 0 == record.UsernameLength() && 0 == record.PasswordLength());
+  TEST_CHECK(L'\0' == record.Domain()[0] && L'\0' == record.Username()[0] && L'\0' == record.Password()[0]);
+  return true;
+}
+
+static UserCredentials _Account(const wchar_t* pwzDomain, const wchar_t* pwzUsername, const wchar_t* pwzPassword)
+{
+  UserCredentials uc;
+  uc.domain = pwzDomain;
+  uc.username = pwzUsername;
+  uc.password = pwzPassword;
+  return uc;
+}
+
+bool AccountRecordLayoutTest()
+{
+  CAccountRecord record;
+  TEST_CHECK(_IsEmpty(record));
+  TEST_CHECK(sizeof(record) <= 2 * sizeof(void*));
+
+  // One block: each string follows the last one's terminator.
+  UserCredentials uc = _Account(L"CONTOSO", L"alice", L"correct horse battery staple");
+  TEST_CHECK(CSR_OK == record.Assign(uc));
+  TEST_CHECK(_Holds(record, uc));
+  TEST_CHECK(record.Username() == record.Domain() + 8 && record.Password() == record.Username() + 6);
+  TEST_CHECK((7 + 5 + 28 + 3) * sizeof(wchar_t) == record.HeapBytes());
+
+  // Assigning again replaces it; empty strings still take their terminators.
+  uc = _Account(L"", L"bob", L"");
+  TEST_CHECK(CSR_OK == record.Assign(uc));
+  TEST_CHECK(_Holds(record, uc) && (3 + 3) * sizeof(wchar_t) == record.HeapBytes());
+
+  // The longest strings a logon can carry fit; one character more and the record is empty.
+  uc = _Account(L"CONTOSO", L"alice", L"");
+  uc.password.assign(CREDENTIAL_ACCOUNT_MAX_CCH, L'p');
+  TEST_CHECK(CSR_OK == record.Assign(uc));
+  TEST_CHECK(_Holds(record, uc));
+  uc.password += L'p';
+  TEST_CHECK(CSR_BAD_FORMAT == record.Assign(uc));
+  TEST_CHECK(_IsEmpty(record));
+  uc = _Account(L"CONTOSO", L"", L"secret");
+  uc.username.assign(CREDENTIAL_ACCOUNT_MAX_CCH + 1, L'u');
+  TEST_CHECK(CSR_BAD_FORMAT == record.Assign(uc));
+  TEST_CHECK(_IsEmpty(record));
+
+  TEST_CHECK(CSR_OK == record.Assign(_Account(L"CONTOSO", L"alice", L"secret")));
+  record.Clear();
+  TEST_CHECK(_IsEmpty(record));
+  return true;
+}
+
+// What a string owns beyond the object itself: its buffer, unless that is inside the object.
+static size_t _HeapBytes(const std::wstring& wstr)
+{
+  const char* pb = reinterpret_cast<const char*>(wstr.c_str());
+  bool fInline = pb >= reinterpret_cast<const char*>(&wstr) && pb < reinterpret_cast<const char*>(&wstr + 1);
+  return fInline ? 0 : (wstr.capacity() + 1) * sizeof(wchar_t);
+}
+
+bool AccountRecordFootprintTest()
+{
+  // FOOTPRINT_TILES tiles, each with its own account as a store would hold it.
+  std::vector<UserCredentials> rgucAccounts(FOOTPRINT_TILES);
+  size_t cbAccounts = 0;
+  for (size_t i = 0; i < rgucAccounts.size(); i++)
+  {
+    std::wstring wstrIndex = std::to_wstring(i);
+    rgucAccounts[i] = _Account(L"CONTOSO", (L"kiosk" + wstrIndex).c_str(), (L"password-" + wstrIndex).c_str());
+    cbAccounts += sizeof(UserCredentials) + _HeapBytes(rgucAccounts[i].domain) +
+      _HeapBytes(rgucAccounts[i].username) + _HeapBytes(rgucAccounts[i].password);
+  }
+
+  std::unique_ptr<CAccountRecord[]> rgRecords(new CAccountRecord[FOOTPRINT_TILES]);
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (size_t i = 0; i < FOOTPRINT_TILES; i++)
+  {
+    TEST_CHECK(CSR_OK == rgRecords[i].Assign(rgucAccounts[i]));
+  }
+  unsigned long long ullNs = PlatformMonotonicNanoseconds() - ullStart;
+  size_t cbRecords = 0;
+  for (size_t i = 0; i < FOOTPRINT_TILES; i++)
+  {
+    TEST_CHECK(_Holds(rgRecords[i], rgucAccounts[i]));
+    cbRecords += sizeof(CAccountRecord) + rgRecords[i].HeapBytes();
+  }
+
+  // Counting only what each owns, not the allocator's overhead on each of its blocks, of
+  // which the record has one and UserCredentials up to three.
+  TEST_CHECK(cbRecords < cbAccounts);
+  printf("  %d accounts: %.1f bytes each as records, %.1f as UserCredentials; %.1f ns to fill a record\n",
+    FOOTPRINT_TILES, (double)cbRecords / FOOTPRINT_TILES, (double)cbAccounts / FOOTPRINT_TILES, (double)ullNs / FOOTPRINT_TILES);
+  return true;
+}
@@ -0,0 +1,213 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// AccountSnapshot.h: snapshots stay whole while they are held, and are freed once they are not.
+//
+// As in CredentialTool stress-snapshots, every snapshot names the same tag in its user name and
+// password, so a reader that finds them different, or finds the domain gone (freed snapshots
+// are wiped first), is looking at a torn or freed one.
+
+#include <stdio.h>
+#include <wchar.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+#include "AccountSnapshot.h"
+
+#define SNAPSHOT_DOMAIN L"SNAPSHOT"
+#define SNAPSHOT_USER_PREFIX L"user-"
+#define SNAPSHOT_PASSWORD_PREFIX L"pass-"
+#define SNAPSHOT_PREFIX_CCH 5
+
+#define SNAPSHOT_READERS 4
+#define SNAPSHOT_PUBLISHES 20000
+#define SNAPSHOT_MIN_READS 1000     // per reader, however the threads get scheduled
+
+static CREDENTIAL_STORE_RESULT _Publish(unsigned long long iSnapshot, unsigned long long* pullVersion)
+{
+  std::wstring tag = std::to_wstring(iSnapshot);
+  UserCredentials uc;
+  uc.domain = SNAPSHOT_DOMAIN;
+  uc.username = SNAPSHOT_USER_PREFIX + tag;
+  uc.password = SNAPSHOT_PASSWORD_PREFIX + tag;
+  return AccountSnapshotPublish(uc, NULL, pullVersion);
+}
+
+static bool _IsConsistent(const CAccountRecord& rar)
+{
+  return 0 == wcscmp(rar.Domain(), SNAPSHOT_DOMAIN) &&
+    rar.UsernameLength() == rar.PasswordLength() &&
+    rar.UsernameLength() > SNAPSHOT_PREFIX_CCH &&
+    0 == wcsncmp(rar.Username(), SNAPSHOT_USER_PREFIX, SNAPSHOT_PREFIX_CCH) &&
+    0 == wcsncmp(rar.Password(), SNAPSHOT_PASSWORD_PREFIX, SNAPSHOT_PREFIX_CCH) &&
+    0 == wcscmp(rar.Username() + SNAPSHOT_PREFIX_CCH, rar.Password() + SNAPSHOT_PREFIX_CCH);
+}
+
+bool AccountSnapshotHoldTest()
+{
+  AccountSnapshotShutdown();
+
+  // A thread can take its record ahead of its first section, which then uses it.
+  TEST_CHECK(AccountSnapshotReserveReader() && AccountSnapshotReserveReader());
+  {
+    CAccountSnapshotReader reader;
+    TEST_CHECK(!reader.Get());
+  }
+
+  // Versions and counts are for the life of the process, so the case goes by where they
+  // start.
+  ACCOUNT_SNAPSHOT_STATS statsStart;
+  AccountSnapshotGetStats(&statsStart);
+  unsigned long long ullFirst = 0;
+  TEST_CHECK(CSR_OK == _Publish(1, &ullFirst));
+  TEST_CHECK(statsStart.cPublished + 1 == ullFirst);
+
+  ACCOUNT_SNAPSHOT_STATS stats;
+  {
+    // Everything replaced while the section is open stays, and the section keeps the
+    // snapshot it started with, whole.
+    CAccountSnapshotReader reader;
+    const ACCOUNT_SNAPSHOT* pHeld = reader.Get();
+    TEST_CHECK(pHeld && ullFirst == pHeld->ullVersion);
+    for (unsigned long long i = 2; i <= 50; i++)
+    {
+      TEST_CHECK(CSR_OK == _Publish(i, NULL));
+    }
+    AccountSnapshotGetStats(&stats);
+    TEST_CHECK(49 == stats.cRetired && statsStart.cReclaimed == stats.cReclaimed);
+    TEST_CHECK(ullFirst == pHeld->ullVersion && _IsConsistent(pHeld->account));
+    TEST_CHECK(0 == wcscmp(pHeld->account.Username(), SNAPSHOT_USER_PREFIX L"1"));
+
+    // An inner section sees the newest, never anything older than the outer one saw.
+    CAccountSnapshotReader inner;
+    TEST_CHECK(inner.Get() && ullFirst + 49 == inner.Get()->ullVersion);
+  }
+
+  // With no section open, the next publish frees everything it replaces.
+  TEST_CHECK(CSR_OK == _Publish(51, NULL));
+  AccountSnapshotGetStats(&stats);
+  TEST_CHECK(ullFirst + 50 == stats.cPublished);
+  TEST_CHECK(statsStart.cReclaimed + 50 == stats.cReclaimed && 0 == stats.cRetired);
+  TEST_CHECK(1 == stats.cReaderSlots);
+
+  AccountSnapshotShutdown();
+  return true;
+}
+
+// What one reader thread saw.
+struct SNAPSHOT_READER_RESULT
+{
+  std::atomic<unsigned long long> cReads;
+  unsigned long long cFailures;
+  unsigned long long ullLastVersion;
+};
+
+static void _ReaderThread(const std::atomic<bool>* pfStop, SNAPSHOT_READER_RESULT* pResult)
+{
+  while (!pfStop->load())
+  {
+    CAccountSnapshotReader reader;
+    const ACCOUNT_SNAPSHOT* pSnapshot = reader.Get();
+    if (!pSnapshot || pSnapshot->ullVersion < pResult->ullLastVersion || !_IsConsistent(pSnapshot->account))
+    {
+      pResult->cFailures++;
+      continue;
+    }
+    pResult->ullLastVersion = pSnapshot->ullVersion;
+
+    // Holding on gives the writer time to replace it, and to try to free it.
+    std::this_thread::yield();
+    if (!_IsConsistent(pSnapshot->account))
+    {
+      pResult->cFailures++;
+    }
+    pResult->cReads++;
+  }
+}
+
+static bool _HaveAllRead(const SNAPSHOT_READER_RESULT* rgResults)
+{
+  for (int i = 0; i < SNAPSHOT_READERS; i++)
+  {
+    if (rgResults[i].cReads.load() < SNAPSHOT_MIN_READS)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AccountSnapshotConcurrentTest()
+{
+  AccountSnapshotShutdown();
+
+  // Readers fail on finding nothing, so there is a snapshot before any of them starts.
+  TEST_CHECK(CSR_OK == _Publish(0, NULL));
+  ACCOUNT_SNAPSHOT_STATS statsStart;
+  AccountSnapshotGetStats(&statsStart);
+
+  std::atomic<bool> fStop(false);
+  SNAPSHOT_READER_RESULT rgResults[SNAPSHOT_READERS];
+  for (int i = 0; i < SNAPSHOT_READERS; i++)
+  {
+    rgResults[i].cReads.store(0);
+    rgResults[i].cFailures = 0;
+    rgResults[i].ullLastVersion = 0;
+  }
+  std::vector<std::thread> rgThreads;
+  for (int i = 0; i < SNAPSHOT_READERS; i++)
+  {
+    rgThreads.push_back(std::thread(_ReaderThread, &fStop, &rgResults[i]));
+  }
+
+  unsigned long cFailedPublishes = 0;
+  unsigned long ulMostRetired = 0;
+  unsigned long long cPublishes = 0;
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (unsigned long long i = 1; i <= SNAPSHOT_PUBLISHES || !_HaveAllRead(rgResults); i++)
+  {
+    cPublishes++;
+    cFailedPublishes += (CSR_OK == _Publish(i, NULL)) ? 0 : 1;
+    if (0 == i % 1000)
+    {
+      ACCOUNT_SNAPSHOT_STATS stats;
+      AccountSnapshotGetStats(&stats);
+      ulMostRetired = (stats.cRetired > ulMostRetired) ? stats.cRetired : ulMostRetired;
+    }
+  }
+  unsigned long long ullNs = PlatformMonotonicNanoseconds() - ullStart;
+  fStop.store(true);
+  for (size_t i = 0; i < rgThreads.size(); i++)
+  {
+    rgThreads[i].join();
+  }
+
+  unsigned long long cReads = 0;
+  unsigned long long cFailedReads = 0;
+  for (int i = 0; i < SNAPSHOT_READERS; i++)
+  {
+    cReads += rgResults[i].cReads;
+    cFailedReads += rgResults[i].cFailures;
+  }
+  printf("  %llu publishes in %.1f ms, %llu reads by %d readers, at most %lu retired at once\n",
+    cPublishes, ullNs / 1e6, cReads, SNAPSHOT_READERS, ulMostRetired);
+  TEST_CHECK(0 == cFailedReads && 0 == cFailedPublishes);
+
+  // The readers are gone, so one more publish drains everything that was waiting on them.
+  TEST_CHECK(CSR_OK == _Publish(cPublishes + 1, NULL));
+  ACCOUNT_SNAPSHOT_STATS stats;
+  AccountSnapshotGetStats(&stats);
+  TEST_CHECK(statsStart.cPublished + cPublishes + 1 == stats.cPublished);
+  TEST_CHECK(0 == stats.cRetired && statsStart.cReclaimed + cPublishes + 1 == stats.cReclaimed);
+  TEST_CHECK(SNAPSHOT_READERS == stats.cReaderSlots);
+
+  AccountSnapshotShutdown();
+  return true;
+}
@@ -0,0 +1,98 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// AllocTrack.h: budgets see operator new as well as the Tracked* wrappers, and one that is
+// exceeded is reported.  The project and the CMake build both build AllocTrack.cpp with
+// ALLOC_TRACKING in every configuration, so these run in Release too.
+
+#include <new>
+#include <string>
+#include "ProviderTests.h"
+#include "AllocTrack.h"
+
+// What the handler was last told.
+static unsigned long s_cExceeded = 0;
+static unsigned long s_cLastAllocs = 0;
+static long s_cLastOutstanding = 0;
+
+static void _OnExceeded(const char*, unsigned long cAllocs, long cOutstanding)
+{
+  s_cExceeded++;
+  s_cLastAllocs = cAllocs;
+  s_cLastOutstanding = cOutstanding;
+}
+
+// Allocates cAllocs ints with new and frees all but cKeep of them, inside a budget.
+static void _Spend(unsigned long cMaxAllocs, unsigned long cMaxOutstanding, unsigned long cAllocs, unsigned long cKeep, int** rgpKept)
+{
+  ALLOC_BUDGET(cMaxAllocs, cMaxOutstanding);
+  for (unsigned long i = 0; i < cAllocs; i++)
+  {
+    int* pi = new int(0);
+    if (i < cKeep)
+    {
+      rgpKept[i] = pi;
+    }
+    else
+    {
+      delete pi;
+    }
+  }
+}
+
+bool AllocTrackBudgetTest()
+{
+  PFN_ALLOC_BUDGET_EXCEEDED pfnPrevious = AllocTrackSetExceededHandler(_OnExceeded);
+  s_cExceeded = 0;
+  int* rgpKept[2] = {};
+
+  // Within its budget, nothing is reported.
+  _Spend(2, 1, 2, 1, rgpKept);
+  TEST_CHECK(0 == s_cExceeded);
+  delete rgpKept[0];
+
+  // One new in a method that claims none is caught, and so is keeping more than it may.
+  _Spend(0, 0, 1, 0, rgpKept);
+  TEST_CHECK(1 == s_cExceeded && 1 == s_cLastAllocs && 0 == s_cLastOutstanding);
+  _Spend(2, 1, 2, 2, rgpKept);
+  TEST_CHECK(2 == s_cExceeded && 2 == s_cLastAllocs && 2 == s_cLastOutstanding);
+  delete rgpKept[0];
+  delete rgpKept[1];
+
+  // The nothrow and array forms are charged too, and a string that outgrows its own buffer
+  // allocates (more than once with checked iterators).
+  {
+    ALLOC_BUDGET(0, 0);
+    int* pi = new (std::nothrow) int(0);
+    delete pi;
+    char* pch = new char[16];
+    delete[] pch;
+    std::wstring text(64, L'x');
+  }
+  TEST_CHECK(3 == s_cExceeded && s_cLastAllocs >= 3 && 0 == s_cLastOutstanding);
+
+  // What an inner scope allocates counts against the outer one as well.
+  {
+    ALLOC_BUDGET(1, 0);
+    _Spend(2, 0, 2, 0, rgpKept);
+    TEST_CHECK(3 == s_cExceeded);
+  }
+  TEST_CHECK(4 == s_cExceeded && 2 == s_cLastAllocs);
+
+  // Outside any scope nothing is charged, and nor is anything under ALLOC_UNCHARGED.
+  delete new int(0);
+  {
+    ALLOC_BUDGET(0, 0);
+    ALLOC_UNCHARGED();
+    delete new int(0);
+  }
+  TEST_CHECK(4 == s_cExceeded);
+
+  AllocTrackSetExceededHandler(pfnPrevious);
+  return true;
+}
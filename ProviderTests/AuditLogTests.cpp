@@ -0,0 +1,211 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// AuditLog.h: what is recorded before AuditLogClose is in the file, in the order each thread
+// recorded it, with the account as domain\user cut to fit.  Many threads recording at once
+// lose nothing they aren't told about: every record is written or counted as dropped, and
+// the file rotates through its generations without a record out of order.
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+#include "AuditLog.h"
+
+#define AUDIT_FILE "audit-log.bin"
+#define AUDIT_THREADS 4
+#define AUDIT_RECORDS_PER_THREAD 50000
+#define AUDIT_SCENARIO 1                    // CPUS_LOGON
+
+// The file, and each generation it rotated to, gone.
+static std::wstring _MissingLog()
+{
+  for (int i = 1; i <= AUDIT_ROTATE_KEEP; i++)
+  {
+    TestMissingPath((std::string(AUDIT_FILE ".") + std::to_string(i)).c_str());
+  }
+  return TestMissingPath(AUDIT_FILE);
+}
+
+// Appends the records of the log file pszName, if there is one, to *prgRecords.
+static bool _ReadLog(const std::string& strName, std::vector<AUDIT_RECORD>* prgRecords)
+{
+  std::wstring wstrPath(strName.begin(), strName.end());
+  std::vector<unsigned char> rgb;
+  PLATFORM_RESULT pr = PlatformReadFile(wstrPath.c_str(), 2 * AUDIT_ROTATE_SIZE, &rgb);
+  if (PR_NOT_FOUND == pr)
+  {
+    return true;
+  }
+  TEST_CHECK(PR_OK == pr && rgb.size() <= AUDIT_ROTATE_SIZE && rgb.size() >= sizeof(AUDIT_FILE_HEADER));
+  AUDIT_FILE_HEADER hdr;
+  memcpy(&hdr, &rgb[0], sizeof(hdr));
+  TEST_CHECK(AUDIT_FILE_MAGIC == hdr.ulMagic && AUDIT_FILE_VERSION == hdr.ulVersion && sizeof(AUDIT_RECORD) == hdr.cbRecord);
+  TEST_CHECK(0 == (rgb.size() - sizeof(hdr)) % sizeof(AUDIT_RECORD));
+  size_t cRecords = (rgb.size() - sizeof(hdr)) / sizeof(AUDIT_RECORD);
+  size_t iFirst = prgRecords->size();
+  prgRecords->resize(iFirst + cRecords);
+  if (cRecords)
+  {
+    memcpy(&(*prgRecords)[iFirst], &rgb[sizeof(hdr)], cRecords * sizeof(AUDIT_RECORD));
+  }
+  return true;
+}
+
+// The record's account, as a wide string; the tests name accounts in the BMP only.
+static std::wstring _Account(const AUDIT_RECORD& record)
+{
+  std::wstring wstr;
+  for (size_t ich = 0; ich < AUDIT_MAX_ACCOUNT && record.wszAccount[ich]; ich++)
+  {
+    wstr += static_cast<wchar_t>(record.wszAccount[ich]);
+  }
+  return wstr;
+}
+
+static AUDIT_STATS _StatsSince(const AUDIT_STATS& statsBefore)
+{
+  AUDIT_STATS stats;
+  AuditLogGetStats(&stats);
+  stats.cRecorded -= statsBefore.cRecorded;
+  stats.cDropped -= statsBefore.cDropped;
+  stats.cWritten -= statsBefore.cWritten;
+  stats.cLost -= statsBefore.cLost;
+  stats.cBatches -= statsBefore.cBatches;
+  stats.cSyncs -= statsBefore.cSyncs;
+  stats.cRotations -= statsBefore.cRotations;
+  return stats;
+}
+
+bool AuditLogRecordTest()
+{
+  std::wstring wstrPath = _MissingLog();
+  AUDIT_STATS statsBefore;
+  AuditLogGetStats(&statsBefore);
+
+  // Closed, nothing is recorded.
+  AuditLogRecord(AUDIT_SCENARIO, L"CONTOSO", L"alice", 0, 0, 0);
+  TEST_CHECK(0 == _StatsSince(statsBefore).cRecorded);
+
+  // A name too long for the record is cut, and one without a domain stands alone.
+  std::wstring wstrLongUser(2 * AUDIT_MAX_ACCOUNT, L'u');
+  TEST_CHECK(PR_OK == AuditLogOpen(wstrPath.c_str()));
+  for (unsigned long long i = 0; i < 100; i++)
+  {
+    AuditLogRecord(AUDIT_SCENARIO, L"CONTOSO", L"alice", (int32_t)0xC000006D, (int32_t)0xC000006A, i);
+  }
+  AuditLogRecord(AUDIT_SCENARIO, L"CONTOSO", wstrLongUser.c_str(), 0, 0, 100);
+  AuditLogRecord(AUDIT_SCENARIO, L"", L"bob", 0, 0, 101);
+  AuditLogRecord(AUDIT_SCENARIO, NULL, L"carol", 0, 0, 102);
+  AuditLogClose();
+
+  AUDIT_STATS stats = _StatsSince(statsBefore);
+  TEST_CHECK(103 == stats.cRecorded && 103 == stats.cWritten && 0 == stats.cDropped && 0 == stats.cLost && stats.cSyncs >= 1);
+  std::vector<AUDIT_RECORD> rgRecords;
+  TEST_CHECK(_ReadLog(AUDIT_FILE, &rgRecords));
+  TEST_CHECK(103 == rgRecords.size());
+  for (size_t i = 0; i < 100; i++)
+  {
+    TEST_CHECK(i == rgRecords[i].ullLatencyNs && AUDIT_SCENARIO == rgRecords[i].ulScenario);
+    TEST_CHECK((int32_t)0xC000006D == rgRecords[i].ntsStatus && (int32_t)0xC000006A == rgRecords[i].ntsSubstatus);
+    TEST_CHECK(PlatformCurrentProcessId() == rgRecords[i].ulProcessId && L"CONTOSO\\alice" == _Account(rgRecords[i]));
+  }
+  TEST_CHECK(L"CONTOSO\\" + wstrLongUser.substr(0, AUDIT_MAX_ACCOUNT - 9) == _Account(rgRecords[100]));
+  TEST_CHECK(L"bob" == _Account(rgRecords[101]) && L"carol" == _Account(rgRecords[102]));
+
+  // Opened again, the log is appended to; opens nest, and only the last close stops it.
+  TEST_CHECK(PR_OK == AuditLogOpen(wstrPath.c_str()));
+  TEST_CHECK(PR_OK == AuditLogOpen(wstrPath.c_str()));
+  AuditLogClose();
+  AuditLogRecord(AUDIT_SCENARIO, L"CONTOSO", L"alice", 0, 0, 103);
+  AuditLogClose();
+  AuditLogRecord(AUDIT_SCENARIO, L"CONTOSO", L"alice", 0, 0, 104);
+  rgRecords.clear();
+  TEST_CHECK(_ReadLog(AUDIT_FILE, &rgRecords));
+  TEST_CHECK(104 == rgRecords.size() && 103 == rgRecords.back().ullLatencyNs);
+
+  // A file that isn't an audit log is moved aside rather than appended to.
+  const char szOther[] = "not an audit log";
+  TEST_CHECK(TestWriteFile(AUDIT_FILE, szOther, sizeof(szOther), &wstrPath));
+  TEST_CHECK(PR_OK == AuditLogOpen(wstrPath.c_str()));
+  AuditLogClose();
+  std::vector<unsigned char> rgb;
+  TEST_CHECK(PR_OK == PlatformReadFile((wstrPath + L".1").c_str(), 1024, &rgb));
+  TEST_CHECK(sizeof(szOther) == rgb.size() && 0 == memcmp(szOther, &rgb[0], rgb.size()));
+  rgRecords.clear();
+  TEST_CHECK(_ReadLog(AUDIT_FILE, &rgRecords) && rgRecords.empty());
+
+  _MissingLog();
+  return true;
+}
+
+bool AuditLogConcurrentTest()
+{
+  std::wstring wstrPath = _MissingLog();
+  AUDIT_STATS statsBefore;
+  AuditLogGetStats(&statsBefore);
+  TEST_CHECK(PR_OK == AuditLogOpen(wstrPath.c_str()));
+
+  // Each record says which thread recorded it, and which of that thread's records it is.
+  std::vector<std::thread> rgThreads;
+  std::vector<unsigned long long> rgullNs(AUDIT_THREADS);
+  for (int i = 0; i < AUDIT_THREADS; i++)
+  {
+    rgThreads.push_back(std::thread([&rgullNs, i]()
+    {
+      unsigned long long ullStart = PlatformMonotonicNanoseconds();
+      for (unsigned long long j = 0; j < AUDIT_RECORDS_PER_THREAD; j++)
+      {
+        AuditLogRecord(AUDIT_SCENARIO, L"CONTOSO", L"alice", 0, 0, ((unsigned long long)i << 32) | j);
+      }
+      rgullNs[i] = PlatformMonotonicNanoseconds() - ullStart;
+    }));
+  }
+  for (size_t i = 0; i < rgThreads.size(); i++)
+  {
+    rgThreads[i].join();
+  }
+  AuditLogClose();
+
+  // Every record was written or dropped, and none written was lost.
+  AUDIT_STATS stats = _StatsSince(statsBefore);
+  TEST_CHECK(AUDIT_THREADS * AUDIT_RECORDS_PER_THREAD == stats.cRecorded + stats.cDropped);
+  TEST_CHECK(stats.cRecorded == stats.cWritten && 0 == stats.cLost);
+
+  // The generations kept, oldest first, hold each thread's records in the order it made them.
+  std::vector<AUDIT_RECORD> rgRecords;
+  for (int i = AUDIT_ROTATE_KEEP; i >= 1; i--)
+  {
+    TEST_CHECK(_ReadLog(std::string(AUDIT_FILE ".") + std::to_string(i), &rgRecords));
+  }
+  TEST_CHECK(_ReadLog(AUDIT_FILE, &rgRecords));
+  TEST_CHECK(rgRecords.size() <= stats.cWritten);
+  TEST_CHECK(stats.cWritten * sizeof(AUDIT_RECORD) <= AUDIT_ROTATE_SIZE || stats.cRotations >= 1);
+  std::vector<unsigned long long> rgullNext(AUDIT_THREADS);
+  for (size_t i = 0; i < rgRecords.size(); i++)
+  {
+    unsigned long long iThread = rgRecords[i].ullLatencyNs >> 32;
+    unsigned long long iRecord = rgRecords[i].ullLatencyNs & 0xFFFFFFFF;
+    TEST_CHECK(iThread < AUDIT_THREADS && iRecord >= rgullNext[(size_t)iThread]);
+    rgullNext[(size_t)iThread] = iRecord + 1;
+  }
+
+  unsigned long long ullNs = 0;
+  for (int i = 0; i < AUDIT_THREADS; i++)
+  {
+    ullNs += rgullNs[i];
+  }
+  printf("  %d threads recorded %llu and dropped %llu, %.1f ns per record; %llu batches, %llu syncs, %llu rotations\n",
+    AUDIT_THREADS, stats.cRecorded, stats.cDropped, (double)ullNs / (AUDIT_THREADS * AUDIT_RECORDS_PER_THREAD),
+    stats.cBatches, stats.cSyncs, stats.cRotations);
+
+  _MissingLog();
+  return true;
+}
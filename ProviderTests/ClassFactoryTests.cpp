@@ -0,0 +1,148 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Dll.cpp: DllGetClassObject hands every caller the one class factory, and every reference to
+// it, or lock on it, keeps DllCanUnloadNow from letting the DLL go.  The cases load the
+// AutoLoginCredentialProvider.dll built next to ProviderTests, the way COM would.
+
+#include <windows.h>
+#include <unknwn.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+
+#define FACTORY_ACQUIRES 1000000
+#define FACTORY_THREADS 4
+
+// {6A9D21B0-D809-4106-8AEA-52783737C41A}
+static const CLSID CLSID_AutoLoginProvider =
+{ 0x6a9d21b0, 0xd809, 0x4106, { 0x8a, 0xea, 0x52, 0x78, 0x37, 0x37, 0xc4, 0x1a } };
+
+// Any interface the factory doesn't have.
+static const IID s_iidOther = { 0x3c1f8a2e, 0x6d0b, 0x4f7a, { 0x9e, 0x44, 0x1b, 0x2d, 0x5c, 0x70, 0x8a, 0x63 } };
+
+typedef HRESULT (STDAPICALLTYPE *PFNDLLGETCLASSOBJECT)(REFCLSID, REFIID, void**);
+typedef HRESULT (STDAPICALLTYPE *PFNDLLCANUNLOADNOW)();
+
+struct PROVIDER_DLL
+{
+  HMODULE hmod;
+  PFNDLLGETCLASSOBJECT pfnDllGetClassObject;
+  PFNDLLCANUNLOADNOW pfnDllCanUnloadNow;
+};
+
+static bool _LoadProvider(__out PROVIDER_DLL* pdll)
+{
+  pdll->hmod = LoadLibraryW(L"AutoLoginCredentialProvider.dll");
+  TEST_CHECK(pdll->hmod);
+  pdll->pfnDllGetClassObject = (PFNDLLGETCLASSOBJECT)GetProcAddress(pdll->hmod, "DllGetClassObject");
+  pdll->pfnDllCanUnloadNow = (PFNDLLCANUNLOADNOW)GetProcAddress(pdll->hmod, "DllCanUnloadNow");
+  TEST_CHECK(pdll->pfnDllGetClassObject && pdll->pfnDllCanUnloadNow);
+  return true;
+}
+
+// Takes the factory through riid and lets it go, cAcquires times.  Returns how many
+// nanoseconds that took, or 0 if any of them failed.
+static unsigned long long _Acquire(__in const PROVIDER_DLL& dll, __in REFIID riid, __in int cAcquires)
+{
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (int i = 0; i < cAcquires; i++)
+  {
+    IUnknown* punk;
+    if (FAILED(dll.pfnDllGetClassObject(CLSID_AutoLoginProvider, riid, (void**)&punk)))
+    {
+      return 0;
+    }
+    punk->Release();
+  }
+  return PlatformMonotonicNanoseconds() - ullStart;
+}
+
+bool ClassFactoryRefsTest()
+{
+  PROVIDER_DLL dll;
+  TEST_CHECK(_LoadProvider(&dll));
+  TEST_CHECK(S_OK == dll.pfnDllCanUnloadNow());
+
+  // Every caller gets the same factory, whichever interface it asks for, and holds the DLL
+  // until it lets go.
+  IClassFactory* pcf1;
+  IClassFactory* pcf2;
+  IUnknown* punk;
+  TEST_CHECK(SUCCEEDED(dll.pfnDllGetClassObject(CLSID_AutoLoginProvider, IID_PPV_ARGS(&pcf1))));
+  TEST_CHECK(SUCCEEDED(dll.pfnDllGetClassObject(CLSID_AutoLoginProvider, IID_PPV_ARGS(&pcf2))));
+  TEST_CHECK(SUCCEEDED(dll.pfnDllGetClassObject(CLSID_AutoLoginProvider, IID_PPV_ARGS(&punk))));
+  TEST_CHECK(pcf1 == pcf2 && static_cast<IUnknown*>(pcf1) == punk);
+  pcf2->Release();
+  punk->Release();
+  TEST_CHECK(S_FALSE == dll.pfnDllCanUnloadNow());
+  pcf1->Release();
+  TEST_CHECK(S_OK == dll.pfnDllCanUnloadNow());
+
+  // So does a lock, after the factory itself is let go.
+  TEST_CHECK(SUCCEEDED(dll.pfnDllGetClassObject(CLSID_AutoLoginProvider, IID_PPV_ARGS(&pcf1))));
+  TEST_CHECK(S_OK == pcf1->LockServer(TRUE));
+  pcf1->Release();
+  TEST_CHECK(S_FALSE == dll.pfnDllCanUnloadNow());
+  TEST_CHECK(SUCCEEDED(dll.pfnDllGetClassObject(CLSID_AutoLoginProvider, IID_PPV_ARGS(&pcf1))));
+  TEST_CHECK(S_OK == pcf1->LockServer(FALSE));
+
+  // The provider can't be aggregated, there is no other class, and the factory has no other
+  // interface.  Each failure clears what it was asked to return.
+  IUnknown* punkOuter = pcf1;
+  punk = punkOuter;
+  TEST_CHECK(CLASS_E_NOAGGREGATION == pcf1->CreateInstance(punkOuter, IID_IUnknown, (void**)&punk) && !punk);
+  punk = punkOuter;
+  TEST_CHECK(CLASS_E_CLASSNOTAVAILABLE == dll.pfnDllGetClassObject(IID_IUnknown, IID_IClassFactory, (void**)&punk) && !punk);
+  punk = punkOuter;
+  TEST_CHECK(E_NOINTERFACE == dll.pfnDllGetClassObject(CLSID_AutoLoginProvider, s_iidOther, (void**)&punk) && !punk);
+  pcf1->Release();
+  TEST_CHECK(S_OK == dll.pfnDllCanUnloadNow());
+
+  FreeLibrary(dll.hmod);
+  return true;
+}
+
+bool ClassFactoryAcquireTest()
+{
+  PROVIDER_DLL dll;
+  TEST_CHECK(_LoadProvider(&dll));
+
+  // IClassFactory, as COM asks for it, skips QueryInterface; IUnknown doesn't.
+  unsigned long long ullFactoryNs = _Acquire(dll, IID_IClassFactory, FACTORY_ACQUIRES);
+  unsigned long long ullUnknownNs = _Acquire(dll, IID_IUnknown, FACTORY_ACQUIRES);
+  TEST_CHECK(ullFactoryNs && ullUnknownNs);
+
+  // LogonUI's threads, and those of other processes' COM, all take the same factory.
+  std::vector<std::thread> rgThreads;
+  std::vector<unsigned long long> rgullNs(FACTORY_THREADS);
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (int i = 0; i < FACTORY_THREADS; i++)
+  {
+    rgThreads.push_back(std::thread([&dll, &rgullNs, i]() { rgullNs[i] = _Acquire(dll, IID_IClassFactory, FACTORY_ACQUIRES); }));
+  }
+  for (size_t i = 0; i < rgThreads.size(); i++)
+  {
+    rgThreads[i].join();
+  }
+  unsigned long long ullThreadsNs = PlatformMonotonicNanoseconds() - ullStart;
+  for (int i = 0; i < FACTORY_THREADS; i++)
+  {
+    TEST_CHECK(rgullNs[i]);
+  }
+
+  printf("  acquire and release: IClassFactory %.1f ns, IUnknown %.1f ns, IClassFactory from %d threads at once %.1f ns\n",
+    (double)ullFactoryNs / FACTORY_ACQUIRES, (double)ullUnknownNs / FACTORY_ACQUIRES,
+    FACTORY_THREADS, (double)ullThreadsNs / FACTORY_ACQUIRES);
+
+  // Every reference taken was given back.
+  TEST_CHECK(S_OK == dll.pfnDllCanUnloadNow());
+  FreeLibrary(dll.hmod);
+  return true;
+}
@@ -0,0 +1,170 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// CredentialStore.h: the plain store in each encoding it is written in, and the sharded
+// stores CredentialTool provisions, each machine looked up in the shard it was put in.
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "ProviderTests.h"
+#include "CredentialStore.h"
+
+static bool _Parse(const void* pv, size_t cb, UserCredentials* puc)
+{
+  return CSR_OK == CredentialStoreParse(static_cast<const unsigned char*>(pv), cb, puc);
+}
+
+bool CredentialStoreParseEncodingsTest()
+{
+  UserCredentials uc;
+
+  // UTF-8 without a byte order mark, with a character outside the BMP.
+  static const char s_szUtf8[] = "CONTOSO\nalice\np\xc3\xa4ss\xf0\x9f\x94\x91";
+  TEST_CHECK(_Parse(s_szUtf8, strlen(s_szUtf8), &uc));
+  TEST_CHECK(uc.domain == L"CONTOSO" && uc.username == L"alice");
+  TEST_CHECK(uc.password == std::wstring(L"p\x00e4ss") + (sizeof(wchar_t) == 2 ? std::wstring(L"\xd83d\xdd11") : std::wstring(1, (wchar_t)0x1F511)));
+
+  // UTF-8 with one.
+  static const char s_szBom[] = "\xef\xbb\xbf" "CONTOSO\nbob\nsecret";
+  TEST_CHECK(_Parse(s_szBom, strlen(s_szBom), &uc));
+  TEST_CHECK(uc.domain == L"CONTOSO" && uc.username == L"bob" && uc.password == L"secret");
+
+  // UTF-16LE, which needs its byte order mark.
+  static const unsigned char s_rgbUtf16[] = { 0xFF, 0xFE, 'D', 0, '\n', 0, 'u', 0, '\r', 0, '\n', 0, 0xE4, 0 };
+  TEST_CHECK(_Parse(s_rgbUtf16, sizeof(s_rgbUtf16), &uc));
+  TEST_CHECK(uc.domain == L"D" && uc.username == L"u" && uc.password == L"\x00e4");
+
+  // Not UTF-8, so Latin-1, the way the store used to be read...
+  static const char s_szLatin1[] = "D\nu\np\xe4ss";
+  TEST_CHECK(_Parse(s_szLatin1, strlen(s_szLatin1), &uc));
+  TEST_CHECK(uc.password == L"p\x00e4ss");
+
+  // ...unless it claims to be UTF-8.
+  static const char s_szBadBom[] = "\xef\xbb\xbf" "D\nu\np\xe4ss";
+  TEST_CHECK(CSR_BAD_FORMAT == CredentialStoreParse(reinterpret_cast<const unsigned char*>(s_szBadBom), strlen(s_szBadBom), &uc));
+
+  // An odd number of UTF-16 bytes.
+  TEST_CHECK(CSR_BAD_FORMAT == CredentialStoreParse(s_rgbUtf16, sizeof(s_rgbUtf16) - 1, &uc));
+  return true;
+}
+
+bool CredentialStoreParseLinesTest()
+{
+  UserCredentials uc;
+
+  static const char s_szCrlf[] = "CONTOSO\r\nalice\r\nsecret\r\n";
+  TEST_CHECK(_Parse(s_szCrlf, strlen(s_szCrlf), &uc));
+  TEST_CHECK(uc.domain == L"CONTOSO" && uc.username == L"alice" && uc.password == L"secret");
+
+  // Missing lines are empty.
+  static const char s_szShort[] = "CONTOSO\nalice";
+  TEST_CHECK(_Parse(s_szShort, strlen(s_szShort), &uc));
+  TEST_CHECK(uc.domain == L"CONTOSO" && uc.username == L"alice" && uc.password.empty());
+
+  TEST_CHECK(_Parse("", 0, &uc));
+  TEST_CHECK(uc.domain.empty() && uc.username.empty() && uc.password.empty());
+  return true;
+}
+
+bool CredentialStoreLoadTest()
+{
+  static const char s_szStore[] = "CONTOSO\nalice\nsecret\n";
+  std::wstring path;
+  TEST_CHECK(TestWriteFile("credential-store.txt", s_szStore, strlen(s_szStore), &path));
+
+  UserCredentials uc;
+  TEST_CHECK(CSR_OK == CredentialStoreLoad(path.c_str(), &uc));
+  TEST_CHECK(uc.domain == L"CONTOSO" && uc.username == L"alice" && uc.password == L"secret");
+  TEST_CHECK(CSR_NOT_FOUND == CredentialStoreLoad(TestMissingPath("credential-store-missing.txt").c_str(), &uc));
+
+  // Anything past CREDENTIAL_STORE_MAX_SIZE is not a store.
+  std::vector<unsigned char> rgbHuge(CREDENTIAL_STORE_MAX_SIZE + 1, 'x');
+  TEST_CHECK(TestWriteFile("credential-store-huge.txt", &rgbHuge[0], rgbHuge.size(), &path));
+  TEST_CHECK(CSR_BAD_FORMAT == CredentialStoreLoad(path.c_str(), &uc));
+  return true;
+}
+
+#define SHARD_RECORDS 1000
+#define FLEET_MACHINES 1000000
+#define FLEET_SHARDS 64
+
+static std::wstring _MachineName(unsigned long i)
+{
+  std::string str = "kiosk-" + std::to_string(i);
+  return std::wstring(str.begin(), str.end());
+}
+
+static CREDENTIAL_STORE_RESULT _ParseShard(const std::string& strShard, const std::wstring& wstrMachine, UserCredentials* puc)
+{
+  return CredentialStoreParseShard(reinterpret_cast<const unsigned char*>(strShard.data()), strShard.size(),
+    wstrMachine.c_str(), wstrMachine.size(), puc);
+}
+
+bool CredentialStoreShardsTest()
+{
+  // The hash is FNV-1a over the folded name: CredentialTool and every provider already
+  // deployed have to agree on it.
+  TEST_CHECK(0x811C9DC5UL == CredentialStoreMachineHash(L"", 0));
+  TEST_CHECK(0xD49A5EA3UL == CredentialStoreMachineHash(L"KIOSK-0042", 10));
+  TEST_CHECK(0xD49A5EA3UL == CredentialStoreMachineHash(L"kiosk-0042", 10));
+  TEST_CHECK(35 == CredentialStoreShardOf(L"Kiosk-0042", 10, 64));
+  TEST_CHECK(0 == CredentialStoreShardOf(L"kiosk-0042", 10, 1) && 0 == CredentialStoreShardOf(L"kiosk-0042", 10, 0));
+
+  // A fleet spreads evenly over its shards.
+  std::vector<unsigned long> rgcPerShard(FLEET_SHARDS);
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (unsigned long i = 0; i < FLEET_MACHINES; i++)
+  {
+    std::wstring wstrMachine = _MachineName(i);
+    rgcPerShard[CredentialStoreShardOf(wstrMachine.c_str(), wstrMachine.size(), FLEET_SHARDS)]++;
+  }
+  unsigned long long ullFleetNs = PlatformMonotonicNanoseconds() - ullStart;
+  const unsigned long cMean = FLEET_MACHINES / FLEET_SHARDS;
+  for (size_t i = 0; i < rgcPerShard.size(); i++)
+  {
+    TEST_CHECK(rgcPerShard[i] > cMean * 9 / 10 && rgcPerShard[i] < cMean * 11 / 10);
+  }
+
+  // One shard's worth of records, as CredentialTool writes them, and each machine finds its
+  // own whatever the case of its name.
+  std::string strShard = "#credential-shard 1\r\n";
+  for (unsigned long i = 0; i < SHARD_RECORDS; i++)
+  {
+    std::string strIndex = std::to_string(i);
+    strShard += "KIOSK-" + strIndex + "\r\nCONTOSO\r\nuser" + strIndex + "\r\npassword" + strIndex + "\r\n";
+  }
+  TEST_CHECK(strShard.size() <= CREDENTIAL_STORE_MAX_SIZE);
+  UserCredentials uc;
+  TEST_CHECK(CSR_OK == _ParseShard(strShard, _MachineName(0), &uc));
+  TEST_CHECK(uc.domain == L"CONTOSO" && uc.username == L"user0" && uc.password == L"password0");
+  TEST_CHECK(CSR_OK == _ParseShard(strShard, _MachineName(SHARD_RECORDS - 1), &uc));
+  TEST_CHECK(uc.username == L"user999" && uc.password == L"password999");
+  TEST_CHECK(CSR_NOT_FOUND == _ParseShard(strShard, _MachineName(SHARD_RECORDS), &uc));
+  TEST_CHECK(CSR_NOT_FOUND == _ParseShard(strShard, L"kiosk-00", &uc) && CSR_NOT_FOUND == _ParseShard(strShard, L"kiosk-", &uc));
+
+  // A record cut short leaves the fields it lacks empty; text without the header is not a
+  // shard at all.
+  TEST_CHECK(CSR_OK == _ParseShard("#credential-shard 1\nkiosk-7\nCONTOSO", L"KIOSK-7", &uc));
+  TEST_CHECK(uc.domain == L"CONTOSO" && uc.username.empty() && uc.password.empty());
+  TEST_CHECK(CSR_BAD_FORMAT == _ParseShard("CONTOSO\nalice\nsecret\n", L"kiosk-7", &uc));
+  TEST_CHECK(CSR_BAD_FORMAT == _ParseShard("#credential-shard 2\nkiosk-7\nCONTOSO\nalice\nsecret\n", L"kiosk-7", &uc));
+
+  // What a logon pays for the lookup: the whole shard decoded, and every record before its
+  // own compared.
+  const int cLookups = 200;
+  ullStart = PlatformMonotonicNanoseconds();
+  for (int i = 0; i < cLookups; i++)
+  {
+    TEST_CHECK(CSR_OK == _ParseShard(strShard, _MachineName(SHARD_RECORDS - 1), &uc));
+  }
+  unsigned long long ullLookupNs = PlatformMonotonicNanoseconds() - ullStart;
+  printf("  %d machines placed in %d shards in %.1f ms; last of %d records found in a %lu-byte shard in %.1f us\n",
+    FLEET_MACHINES, FLEET_SHARDS, ullFleetNs / 1e6, SHARD_RECORDS, (unsigned long)strShard.size(), ullLookupNs / 1e3 / cLookups);
+  return true;
+}
@@ -0,0 +1,129 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// FieldStringBuffer.h: a value typed one keystroke at a time stays inline until it no longer
+// fits, then moves to the heap, which doubles as it fills.  Nothing the buffer stops using
+// keeps a character of the value: not the inline storage after the move, not the tail after a
+// backspace, not the heap after Clear.
+
+#include <stdio.h>
+#include <wchar.h>
+#include "ProviderTests.h"
+#include "FieldStringBuffer.h"
+
+#define KEYSTROKES 10000
+
+// What LogonUI hands SetStringValue after each keystroke from the cchFrom'th to the cchTo'th,
+// counting the times the buffer's heap changed.
+static bool _Type(FieldStringBuffer* pfsb, const wchar_t* pwzValue, size_t cchFrom, size_t cchTo, unsigned long* pcReallocs)
+{
+  for (size_t cch = cchFrom; cch <= cchTo; cch++)
+  {
+    size_t cbHeap = pfsb->HeapBytes();
+    TEST_CHECK(PR_OK == pfsb->Assign(pwzValue, cch));
+    TEST_CHECK(cch == pfsb->Length() && 0 == wcsncmp(pwzValue, pfsb->Get(), cch) && L'\0' == pfsb->Get()[cch]);
+    if (pfsb->HeapBytes() != cbHeap)
+    {
+      ++*pcReallocs;
+    }
+  }
+  return true;
+}
+
+static bool _IsWiped(const wchar_t* pwz, size_t cch)
+{
+  for (size_t i = 0; i < cch; i++)
+  {
+    if (L'\0' != pwz[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FieldStringBufferGrowthTest()
+{
+  wchar_t rgchValue[200];
+  for (size_t i = 0; i < sizeof(rgchValue) / sizeof(rgchValue[0]); i++)
+  {
+    rgchValue[i] = (wchar_t)(L'a' + i % 26);
+  }
+
+  FieldStringBuffer fsb;
+  TEST_CHECK(NULL == fsb.Get() && 0 == fsb.Length() && 0 == fsb.HeapBytes());
+
+  // Up to 31 characters the value lives in the object.
+  unsigned long cReallocs = 0;
+  TEST_CHECK(_Type(&fsb, rgchValue, 0, 31, &cReallocs));
+  TEST_CHECK(0 == cReallocs && 0 == fsb.HeapBytes());
+  const wchar_t* pwzInline = fsb.Get();
+  TEST_CHECK((const char*)pwzInline >= (const char*)&fsb && (const char*)(pwzInline + 32) <= (const char*)(&fsb + 1));
+
+  // The 32nd character moves it to the heap at twice the inline capacity, and leaves nothing
+  // inline.
+  TEST_CHECK(_Type(&fsb, rgchValue, 32, 32, &cReallocs));
+  TEST_CHECK(1 == cReallocs && 64 * sizeof(wchar_t) == fsb.HeapBytes() && pwzInline != fsb.Get());
+  TEST_CHECK(_IsWiped(pwzInline, 32));
+
+  // To 200 characters it grows twice more.
+  TEST_CHECK(_Type(&fsb, rgchValue, 33, 200, &cReallocs));
+  TEST_CHECK(3 == cReallocs && 256 * sizeof(wchar_t) == fsb.HeapBytes());
+
+  // A backspace wipes what followed the value, and the storage stays.
+  const wchar_t* pwzHeap = fsb.Get();
+  TEST_CHECK(PR_OK == fsb.Assign(rgchValue, 120));
+  TEST_CHECK(pwzHeap == fsb.Get() && 120 == fsb.Length() && 256 * sizeof(wchar_t) == fsb.HeapBytes());
+  TEST_CHECK(_IsWiped(pwzHeap + 120, 81));
+
+  // So does a shorter value taken from the buffer itself.
+  TEST_CHECK(PR_OK == fsb.Assign(fsb.Get() + 20, 100));
+  TEST_CHECK(100 == fsb.Length() && 0 == wcsncmp(rgchValue + 20, fsb.Get(), 100) && _IsWiped(pwzHeap + 100, 21));
+
+  // Clear wipes the heap but keeps it for the next value.
+  fsb.Clear();
+  TEST_CHECK(NULL == fsb.Get() && 0 == fsb.Length() && 256 * sizeof(wchar_t) == fsb.HeapBytes());
+  TEST_CHECK(_IsWiped(pwzHeap, 101));
+  TEST_CHECK(_Type(&fsb, rgchValue, 0, 200, &cReallocs));
+  TEST_CHECK(3 == cReallocs && pwzHeap == fsb.Get());
+  return true;
+}
+
+bool FieldStringBufferKeystrokesTest()
+{
+  // KEYSTROKES keystrokes into one field, every eighth of them a backspace, each handing the
+  // buffer the whole value the way SetStringValue does.
+  static wchar_t s_rgchValue[KEYSTROKES];
+  for (size_t i = 0; i < KEYSTROKES; i++)
+  {
+    s_rgchValue[i] = (wchar_t)(L'a' + i % 26);
+  }
+
+  FieldStringBuffer fsb;
+  size_t cch = 0;
+  unsigned long cReallocs = 0;
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (int i = 0; i < KEYSTROKES; i++)
+  {
+    size_t cbHeap = fsb.HeapBytes();
+    cch = (7 == i % 8) ? cch - 1 : cch + 1;
+    TEST_CHECK(PR_OK == fsb.Assign(s_rgchValue, cch));
+    if (fsb.HeapBytes() != cbHeap)
+    {
+      cReallocs++;
+    }
+  }
+  unsigned long long ullNs = PlatformMonotonicNanoseconds() - ullStart;
+  printf("  %d keystrokes to %lu characters in %.2f ms, %lu allocations, %lu bytes of heap\n",
+    KEYSTROKES, (unsigned long)cch, ullNs / 1e6, cReallocs, (unsigned long)fsb.HeapBytes());
+
+  // 7500 characters take a block of 8192, after blocks of 64, 128 and so on.
+  TEST_CHECK(KEYSTROKES / 8 * 6 == cch && 0 == wcsncmp(s_rgchValue, fsb.Get(), cch));
+  TEST_CHECK(8 == cReallocs && 8192 * sizeof(wchar_t) == fsb.HeapBytes());
+  return true;
+}
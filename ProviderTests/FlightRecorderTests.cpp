@@ -0,0 +1,218 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// FlightRecorder.h: the ring keeps the newest events, whole, and what a process had written
+// into the mapped file is still there after it is killed.  The kill case forks, so it only
+// builds off Windows.
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+#include "FlightRecorder.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define FLIGHT_FREQUENCY 1000000000ULL
+
+// Room for cEvents, aligned for the header's atomic.
+static std::vector<uint64_t> _RingBuffer(uint32_t cEvents)
+{
+  return std::vector<uint64_t>(FlightRecorderFileSize(cEvents) / sizeof(uint64_t), 0);
+}
+
+static bool _Decode(const std::vector<uint64_t>& rgullRing, FLIGHT_RECORDER_INFO* pInfo, std::vector<FLIGHT_EVENT>* prgEvents)
+{
+  return FlightRecorderDecode(reinterpret_cast<const unsigned char*>(&rgullRing[0]), rgullRing.size() * sizeof(uint64_t),
+    pInfo, prgEvents);
+}
+
+bool FlightRecorderRingTest()
+{
+  std::vector<uint64_t> rgullRing = _RingBuffer(8);
+  FLIGHT_RECORDER_INFO info;
+  std::vector<FLIGHT_EVENT> rgEvents;
+  TEST_CHECK(!_Decode(rgullRing, &info, &rgEvents));
+
+  // Only the newest cEvents are held, oldest first.
+  FLIGHT_RECORDER_HEADER* pHeader = FlightRecorderAttach(&rgullRing[0], rgullRing.size() * sizeof(uint64_t), FLIGHT_FREQUENCY);
+  TEST_CHECK(pHeader && 8 == pHeader->cEvents);
+  for (int32_t i = 1; i <= 20; i++)
+  {
+    FlightRecorderWrite(pHeader, FE_RESULT, "event", i, 0, i * 10, 0, 7);
+  }
+  TEST_CHECK(_Decode(rgullRing, &info, &rgEvents));
+  TEST_CHECK(8 == info.cEvents && 21 == info.ullNext && 0 == info.cTorn && FLIGHT_FREQUENCY == info.ullFrequency);
+  TEST_CHECK(8 == rgEvents.size());
+  for (size_t i = 0; i < rgEvents.size(); i++)
+  {
+    TEST_CHECK(13 + i == rgEvents[i].ullSeq && (int32_t)(13 + i) == rgEvents[i].lValue);
+    TEST_CHECK(FE_RESULT == rgEvents[i].usType && 7 == rgEvents[i].ulThreadId && 0 == strcmp(rgEvents[i].szName, "event"));
+  }
+
+  // A long name keeps its end, where method names differ.
+  std::string name = std::string(40, 'x') + "::GetSerialization";
+  FlightRecorderWrite(pHeader, FE_ENTER, name.c_str(), 0, 0, 0, 0, 7);
+  TEST_CHECK(_Decode(rgullRing, &info, &rgEvents));
+  TEST_CHECK(name.substr(name.size() - (FLIGHT_EVENT_NAME_CHARS - 1)) == rgEvents.back().szName);
+
+  // A slot claimed and never finished is counted, not returned.
+  pHeader->ullNext.fetch_add(1);
+  TEST_CHECK(_Decode(rgullRing, &info, &rgEvents));
+  TEST_CHECK(1 == info.cTorn && 7 == rgEvents.size() && 21 == rgEvents.back().ullSeq);
+
+  // The next process carries the ring on; anything that is not one is formatted afresh.
+  TEST_CHECK(pHeader == FlightRecorderAttach(&rgullRing[0], rgullRing.size() * sizeof(uint64_t), FLIGHT_FREQUENCY));
+  TEST_CHECK(23 == pHeader->ullNext.load());
+  pHeader->ulMagic = 0;
+  TEST_CHECK(pHeader == FlightRecorderAttach(&rgullRing[0], rgullRing.size() * sizeof(uint64_t), FLIGHT_FREQUENCY));
+  TEST_CHECK(_Decode(rgullRing, &info, &rgEvents));
+  TEST_CHECK(1 == info.ullNext && rgEvents.empty());
+
+  TEST_CHECK(!FlightRecorderAttach(&rgullRing[0], sizeof(FLIGHT_RECORDER_HEADER), FLIGHT_FREQUENCY));
+  return true;
+}
+
+#ifndef _WIN32
+
+#define KILL_FILE "flight-recorder-kill.ring"
+#define KILL_EVENTS 4096
+#define KILL_WRITERS 4
+#define KILL_ROUNDS 20
+#define KILL_WARM_EVENTS 2048   // per writer before the kill, so the last round fills the ring
+
+// A writer in the process about to be killed.  llTicks counts its own events, so the decoder
+// can tell whether one of them went missing.
+static void _KillWriterThread(FLIGHT_RECORDER_HEADER* pHeader, uint32_t ulWriter, int32_t lRound, std::atomic<int>* pcWarm)
+{
+  for (int64_t i = 0;; i++)
+  {
+    FlightRecorderWrite(pHeader, FE_ENTER, "kill-writer", lRound, 0, i, 0, ulWriter);
+    if (KILL_WARM_EVENTS == i)
+    {
+      pcWarm->fetch_add(1);
+    }
+  }
+}
+
+// Maps the ring, says so through fdReady once every writer is well under way, and runs until
+// it is killed.
+static void _RunKilledProcess(int32_t lRound, int fdReady)
+{
+  int fd = open(KILL_FILE, O_RDWR);
+  void* pv = (fd < 0) ? MAP_FAILED : mmap(NULL, FlightRecorderFileSize(KILL_EVENTS), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  FLIGHT_RECORDER_HEADER* pHeader = (MAP_FAILED == pv) ? NULL : FlightRecorderAttach(pv, FlightRecorderFileSize(KILL_EVENTS), FLIGHT_FREQUENCY);
+  if (!pHeader)
+  {
+    _exit(1);
+  }
+  FlightRecorderWrite(pHeader, FE_SESSION, "session", lRound, 0, 0, 0, KILL_WRITERS);
+
+  std::atomic<int> cWarm(0);
+  for (uint32_t i = 0; i < KILL_WRITERS; i++)
+  {
+    std::thread(_KillWriterThread, pHeader, i, lRound, &cWarm).detach();
+  }
+  while (cWarm.load() < KILL_WRITERS)
+  {
+    std::this_thread::yield();
+  }
+  char ch = 0;
+  if (1 != write(fdReady, &ch, 1))
+  {
+    _exit(1);
+  }
+  for (;;)
+  {
+    pause();
+  }
+}
+
+bool FlightRecorderKillTest()
+{
+  remove(KILL_FILE);
+  int fd = open(KILL_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  TEST_CHECK(fd >= 0);
+  bool fSized = 0 == ftruncate(fd, (off_t)FlightRecorderFileSize(KILL_EVENTS));
+  close(fd);
+  TEST_CHECK(fSized);
+
+  // Each round's process is killed at a different point after its writers have started.
+  for (int32_t lRound = 0; lRound < KILL_ROUNDS; lRound++)
+  {
+    int rgfd[2];
+    TEST_CHECK(0 == pipe(rgfd));
+    fflush(stdout);
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+      close(rgfd[0]);
+      _RunKilledProcess(lRound, rgfd[1]);
+    }
+    close(rgfd[1]);
+
+    char ch;
+    bool fReady = pid > 0 && 1 == read(rgfd[0], &ch, 1);
+    close(rgfd[0]);
+    if (pid > 0)
+    {
+      usleep(lRound * 100);
+      kill(pid, SIGKILL);
+    }
+    int iStatus = 0;
+    TEST_CHECK(pid > 0 && pid == waitpid(pid, &iStatus, 0));
+    TEST_CHECK(fReady && WIFSIGNALED(iStatus) && SIGKILL == WTERMSIG(iStatus));
+  }
+
+  std::vector<unsigned char> rgb(FlightRecorderFileSize(KILL_EVENTS));
+  FILE* pFile = fopen(KILL_FILE, "rb");
+  size_t cbRead = pFile ? fread(&rgb[0], 1, rgb.size(), pFile) : 0;
+  if (pFile)
+  {
+    fclose(pFile);
+  }
+  remove(KILL_FILE);
+  TEST_CHECK(rgb.size() == cbRead);
+
+  FLIGHT_RECORDER_INFO info;
+  std::vector<FLIGHT_EVENT> rgEvents;
+  TEST_CHECK(FlightRecorderDecode(&rgb[0], rgb.size(), &info, &rgEvents));
+  printf("  %llu events in %d killed processes, %u held, %u torn\n", (unsigned long long)(info.ullNext - 1), KILL_ROUNDS,
+    (unsigned)rgEvents.size(), info.cTorn);
+
+  // Every round carried on the ring the one before left, rather than starting it over.
+  TEST_CHECK(info.ullNext - 1 >= (uint64_t)KILL_ROUNDS * (KILL_WRITERS * KILL_WARM_EVENTS + 1));
+
+  // At most each writer of the last round was killed inside an event; everything else the
+  // ring holds is whole and comes from that round, and no writer's events go back.
+  TEST_CHECK(info.cTorn <= KILL_WRITERS && rgEvents.size() + info.cTorn == KILL_EVENTS);
+  int64_t rgllLast[KILL_WRITERS];
+  for (int i = 0; i < KILL_WRITERS; i++)
+  {
+    rgllLast[i] = -1;
+  }
+  for (size_t i = 0; i < rgEvents.size(); i++)
+  {
+    const FLIGHT_EVENT& fe = rgEvents[i];
+    TEST_CHECK(FE_ENTER == fe.usType && KILL_ROUNDS - 1 == fe.lValue && 0 == strcmp(fe.szName, "kill-writer"));
+    TEST_CHECK(fe.ulThreadId < KILL_WRITERS && fe.llTicks > rgllLast[fe.ulThreadId]);
+    rgllLast[fe.ulThreadId] = fe.llTicks;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,174 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Histogram.h: a value reads back within 1/32 of itself, and exactly below 64ns; percentiles
+// of a known distribution come out where they should; threads recording at once lose nothing;
+// and histograms written to files and read back, from one file or several, add up.
+
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+#include "Histogram.h"
+
+#define HISTOGRAM_FILE "histogram.bin"
+#define RECORD_THREADS 4
+#define RECORDS_PER_THREAD 1000000
+
+// The value percentile dPercentile reads back as lies at or above ullExpected, and by no
+// more than one bucket's width.
+static bool _IsNear(const LATENCY_HISTOGRAM& h, double dPercentile, unsigned long long ullExpected)
+{
+  unsigned long long ull = HistogramValueAtPercentile(h, dPercentile);
+  return ull >= ullExpected && ull <= ullExpected + ullExpected / HISTOGRAM_SUB_BUCKETS + 1;
+}
+
+static std::unique_ptr<LATENCY_HISTOGRAM> _NewHistogram()
+{
+  return std::unique_ptr<LATENCY_HISTOGRAM>(new LATENCY_HISTOGRAM());
+}
+
+static std::unique_ptr<LATENCY_PHASE_HISTOGRAMS> _NewPhaseHistograms()
+{
+  return std::unique_ptr<LATENCY_PHASE_HISTOGRAMS>(new LATENCY_PHASE_HISTOGRAMS());
+}
+
+bool HistogramPercentileTest()
+{
+  std::unique_ptr<LATENCY_HISTOGRAM> ph = _NewHistogram();
+  TEST_CHECK(0 == HistogramTotalCount(*ph) && 0 == HistogramValueAtPercentile(*ph, 50.0));
+
+  // One value at a time, from nanoseconds to minutes.
+  for (unsigned long long ull = 0; ull < (1ULL << 41); ull = ull * 9 / 8 + 1)
+  {
+    std::unique_ptr<LATENCY_HISTOGRAM> phOne = _NewHistogram();
+    HistogramRecord(phOne.get(), ull);
+    TEST_CHECK(1 == HistogramTotalCount(*phOne));
+    TEST_CHECK(ull < 2 * HISTOGRAM_SUB_BUCKETS ? ull == HistogramValueAtPercentile(*phOne, 100.0) : _IsNear(*phOne, 100.0, ull));
+  }
+
+  // Anything longer shares the last bucket.
+  HistogramRecord(ph.get(), (1ULL << 41) - 1);
+  unsigned long long ullLast = HistogramValueAtPercentile(*ph, 100.0);
+  HistogramRecord(ph.get(), 1ULL << 45);
+  HistogramRecord(ph.get(), ~0ULL);
+  TEST_CHECK(3 == HistogramTotalCount(*ph) && ullLast == HistogramValueAtPercentile(*ph, 0.0));
+
+  // 1us to 100ms uniformly, and the percentiles of that.
+  ph = _NewHistogram();
+  for (unsigned long long ull = 1; ull <= 100000; ull++)
+  {
+    HistogramRecord(ph.get(), ull * 1000);
+  }
+  TEST_CHECK(100000 == HistogramTotalCount(*ph));
+  TEST_CHECK(_IsNear(*ph, 0.0, 1000) && _IsNear(*ph, 50.0, 50000000));
+  TEST_CHECK(_IsNear(*ph, 99.0, 99000000) && _IsNear(*ph, 99.9, 99900000) && _IsNear(*ph, 100.0, 100000000));
+
+  // Merging adds the counts, wherever they are.
+  std::unique_ptr<LATENCY_HISTOGRAM> phSum = _NewHistogram();
+  HistogramMerge(phSum.get(), *ph);
+  HistogramMerge(phSum.get(), *ph);
+  TEST_CHECK(200000 == HistogramTotalCount(*phSum) && _IsNear(*phSum, 50.0, 50000000));
+  for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    TEST_CHECK(2 * ph->rgulCounts[i] == phSum->rgulCounts[i]);
+  }
+  return true;
+}
+
+bool HistogramRecordTest()
+{
+  // Threads recording into one histogram at once, each its own spread of values.
+  std::unique_ptr<LATENCY_HISTOGRAM> ph = _NewHistogram();
+  std::vector<std::thread> rgThreads;
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (int i = 0; i < RECORD_THREADS; i++)
+  {
+    LATENCY_HISTOGRAM* pHistogram = ph.get();
+    rgThreads.push_back(std::thread([pHistogram, i]()
+    {
+      for (unsigned long long j = 0; j < RECORDS_PER_THREAD; j++)
+      {
+        HistogramRecord(pHistogram, (j * 7919 + i) % 10000000);
+      }
+    }));
+  }
+  for (size_t i = 0; i < rgThreads.size(); i++)
+  {
+    rgThreads[i].join();
+  }
+  unsigned long long ullNs = PlatformMonotonicNanoseconds() - ullStart;
+  printf("  %d records from %d threads at once in %.1f ms, %.1f ns per record on each\n",
+    RECORD_THREADS * RECORDS_PER_THREAD, RECORD_THREADS, ullNs / 1e6, (double)ullNs / RECORDS_PER_THREAD);
+  TEST_CHECK(RECORD_THREADS * RECORDS_PER_THREAD == HistogramTotalCount(*ph));
+
+  // Taking the process-wide histograms empties them.
+  std::unique_ptr<LATENCY_PHASE_HISTOGRAMS> plph = _NewPhaseHistograms();
+  LatencyTake(plph.get());
+  LatencyRecordNanoseconds(LP_HOST_RULES, 5000);
+  LatencyRecordNanoseconds(LP_HOST_RULES, 7000);
+  LatencyTake(plph.get());
+  TEST_CHECK(2 == HistogramTotalCount(plph->rgHistograms[LP_HOST_RULES]) && _IsNear(plph->rgHistograms[LP_HOST_RULES], 100.0, 7000));
+  LatencyTake(plph.get());
+  TEST_CHECK(0 == HistogramTotalCount(plph->rgHistograms[LP_HOST_RULES]));
+  return true;
+}
+
+bool HistogramFileTest()
+{
+  std::wstring wstrPath = TestMissingPath(HISTOGRAM_FILE);
+  std::unique_ptr<LATENCY_PHASE_HISTOGRAMS> plph = _NewPhaseHistograms();
+
+  // A missing file adds nothing.
+  TEST_CHECK(PR_NOT_FOUND == HistogramFileRead(wstrPath.c_str(), plph.get()));
+  for (uint32_t lp = 0; lp < LP_NUM_PHASES; lp++)
+  {
+    TEST_CHECK(0 == HistogramTotalCount(plph->rgHistograms[lp]));
+  }
+
+  // What is written reads back bucket for bucket, and reading two files adds them up.
+  std::unique_ptr<LATENCY_PHASE_HISTOGRAMS> plphWritten = _NewPhaseHistograms();
+  for (unsigned long long ull = 1; ull <= 1000; ull++)
+  {
+    HistogramRecord(&plphWritten->rgHistograms[LP_LOGON_PACK], ull * 100);
+    HistogramRecord(&plphWritten->rgHistograms[LP_STATUS_DELIVERY], ull * ull);
+  }
+  TEST_CHECK(PR_OK == HistogramFileWrite(wstrPath.c_str(), *plphWritten));
+  TEST_CHECK(PR_OK == HistogramFileRead(wstrPath.c_str(), plph.get()));
+  TEST_CHECK(0 == memcmp((const void*)plph.get(), (const void*)plphWritten.get(), sizeof(*plph)));
+  TEST_CHECK(PR_OK == HistogramFileRead(wstrPath.c_str(), plph.get()));
+  TEST_CHECK(2000 == HistogramTotalCount(plph->rgHistograms[LP_LOGON_PACK]) && _IsNear(plph->rgHistograms[LP_LOGON_PACK], 50.0, 50000));
+  TEST_CHECK(0 == HistogramTotalCount(plph->rgHistograms[LP_CREDENTIAL_LOAD]));
+
+  // Accumulating adds to what the file holds, which is only the buckets in use.
+  TEST_CHECK(PR_OK == HistogramFileAccumulate(wstrPath.c_str(), *plphWritten));
+  std::unique_ptr<LATENCY_PHASE_HISTOGRAMS> plphRead = _NewPhaseHistograms();
+  TEST_CHECK(PR_OK == HistogramFileRead(wstrPath.c_str(), plphRead.get()));
+  TEST_CHECK(0 == memcmp((const void*)plphRead.get(), (const void*)plph.get(), sizeof(*plph)));
+  std::vector<unsigned char> rgb;
+  TEST_CHECK(PR_OK == PlatformReadFile(wstrPath.c_str(), 1024 * 1024, &rgb));
+  printf("  %lu bytes for 2000 values in each of 2 phases\n", (unsigned long)rgb.size());
+
+  // A truncated file, or one with the wrong magic, adds nothing.
+  std::unique_ptr<LATENCY_PHASE_HISTOGRAMS> plphBad = _NewPhaseHistograms();
+  std::wstring wstrBadPath;
+  TEST_CHECK(TestWriteFile(HISTOGRAM_FILE, &rgb[0], rgb.size() - 1, &wstrBadPath));
+  TEST_CHECK(PR_BAD_DATA == HistogramFileRead(wstrBadPath.c_str(), plphBad.get()));
+  rgb[0] ^= 1;
+  TEST_CHECK(TestWriteFile(HISTOGRAM_FILE, &rgb[0], rgb.size(), &wstrBadPath));
+  TEST_CHECK(PR_BAD_DATA == HistogramFileRead(wstrBadPath.c_str(), plphBad.get()));
+  for (uint32_t lp = 0; lp < LP_NUM_PHASES; lp++)
+  {
+    TEST_CHECK(0 == HistogramTotalCount(plphBad->rgHistograms[lp]));
+  }
+
+  remove(HISTOGRAM_FILE);
+  return true;
+}
@@ -0,0 +1,261 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// HostRules.h, through CredentialTool's RulesCompiler.h: the automaton finds every rule whose
+// pattern matches the name, whatever its case, and the first of them whose tags, days and
+// time window hold picks the account, including windows that wrap past midnight.  Sealed
+// rules open only with their key, and a changed account record doesn't open at all.
+
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "ProviderTests.h"
+#include "TestStores.h"
+#include "RulesCompiler.h"
+
+#define HOST_RULES_FILE "host-rules.bin"
+#define FLEET_SITES 10000
+#define FLEET_ACCOUNTS 100
+
+#define WEDNESDAY 3
+#define SATURDAY 6
+#define MINUTE(h, m) ((h) * 60 + (m))
+
+static const char s_szRules[] =
+  "# The lobby kiosks, and the night shift on weekdays.\n"
+  "account\tfront\tCONTOSO\tfrontdesk\tpw-front\n"
+  "account\tlobby\tCONTOSO\tlobby\tpw-lobby\n"
+  "account\tnight\tCONTOSO\tnight\tpw-night\n"
+  "account\tany\tCONTOSO\tkiosk\tpw-any\n"
+  "\n"
+  "rule\tKIOSK-{001-100}\tfront\n"
+  "rule\tKIOSK-[A-C]*\tlobby\ttag=lobby\n"
+  "rule\tKIOSK-*\tnight\tdays=mon-fri\ttime=22:00-06:00\n"
+  "rule\t*\tany\n";
+
+// Seals with CTestKeyProvider's key, the way CredentialTool's sealer does with one from
+// new-key.
+class CTestRulesSealer : public IHostRulesSealer
+{
+public:
+  const unsigned char* KeyId()
+  {
+    return _keys.KeyId();
+  }
+
+  bool Seal(const unsigned char* pbAad, const unsigned char* pb, size_t cb, std::vector<unsigned char>* prgbSealed)
+  {
+    prgbSealed->clear();
+    return TestSeal(_keys, pbAad, pb, cb, prgbSealed);
+  }
+
+private:
+  CTestKeyProvider _keys;
+};
+
+// Compiles the rules text a line at a time, and writes the result to the rules file.
+static bool _Compile(const std::string& strRules, IHostRulesSealer* pSealer, std::vector<unsigned char>* prgb, std::wstring* pPath)
+{
+  CHostRulesCompiler compiler;
+  unsigned long ulLine = 1;
+  for (size_t i = 0; i < strRules.size(); ulLine++)
+  {
+    size_t iEnd = strRules.find('\n', i);
+    if (std::string::npos == iEnd)
+    {
+      iEnd = strRules.size();
+    }
+    TEST_CHECK(compiler.AddLine(strRules.data() + i, iEnd - i, ulLine));
+    i = iEnd + 1;
+  }
+  TEST_CHECK(compiler.Compile(pSealer, prgb));
+  TEST_CHECK(compiler.Stats().cbOutput == prgb->size());
+  return TestWriteFile(HOST_RULES_FILE, &(*prgb)[0], prgb->size(), pPath);
+}
+
+// Evaluates the rules file for a machine, and on a match returns the password of the account
+// it chose and the line of the rule that chose it.
+static CREDENTIAL_STORE_RESULT _Match(
+  const std::wstring& wstrPath,
+  ISealedStoreKeyProvider* pKeys,
+  const wchar_t* pwzMachine,
+  const wchar_t* pwzTag,
+  unsigned long ulDayOfWeek,
+  unsigned long ulMinuteOfDay,
+  std::wstring* pwstrPassword,
+  unsigned long* pulLine
+)
+{
+  HOST_RULES_QUERY query = { pwzMachine, wcslen(pwzMachine), &pwzTag, pwzTag ? 1UL : 0UL, ulDayOfWeek, ulMinuteOfDay };
+  UserCredentials uc;
+  *pulLine = 0;
+  CREDENTIAL_STORE_RESULT csr = HostRulesLoad(wstrPath.c_str(), pKeys, query, &uc, pulLine);
+  *pwstrPassword = uc.password;
+  return csr;
+}
+
+// Whether the machine, at that time, gets the account of the rule on line ulLine.
+static bool _Picks(
+  const std::wstring& wstrPath,
+  const wchar_t* pwzMachine,
+  const wchar_t* pwzTag,
+  unsigned long ulDayOfWeek,
+  unsigned long ulMinuteOfDay,
+  unsigned long ulLine,
+  const wchar_t* pwzPassword
+)
+{
+  std::wstring wstrPassword;
+  unsigned long ulLineMatched;
+  return CSR_OK == _Match(wstrPath, NULL, pwzMachine, pwzTag, ulDayOfWeek, ulMinuteOfDay, &wstrPassword, &ulLineMatched) &&
+    ulLine == ulLineMatched && wstrPassword == pwzPassword;
+}
+
+bool HostRulesMatchTest()
+{
+  std::vector<unsigned char> rgb;
+  std::wstring wstrPath;
+  TEST_CHECK(_Compile(s_szRules, NULL, &rgb, &wstrPath));
+
+  // Numeric ranges keep their zero padding, and names match whatever their case.
+  TEST_CHECK(_Picks(wstrPath, L"KIOSK-001", NULL, WEDNESDAY, MINUTE(12, 0), 7, L"pw-front"));
+  TEST_CHECK(_Picks(wstrPath, L"kiosk-050", NULL, WEDNESDAY, MINUTE(12, 0), 7, L"pw-front"));
+  TEST_CHECK(_Picks(wstrPath, L"KIOSK-100", NULL, WEDNESDAY, MINUTE(12, 0), 7, L"pw-front"));
+  TEST_CHECK(_Picks(wstrPath, L"KIOSK-101", NULL, WEDNESDAY, MINUTE(12, 0), 10, L"pw-any"));
+  TEST_CHECK(_Picks(wstrPath, L"KIOSK-50", NULL, WEDNESDAY, MINUTE(12, 0), 10, L"pw-any"));
+  TEST_CHECK(_Picks(wstrPath, L"KIOSK-0500", NULL, WEDNESDAY, MINUTE(12, 0), 10, L"pw-any"));
+
+  // A tag condition needs the tag, in any case.
+  TEST_CHECK(_Picks(wstrPath, L"KIOSK-B12", L"lobby", WEDNESDAY, MINUTE(12, 0), 8, L"pw-lobby"));
+  TEST_CHECK(_Picks(wstrPath, L"kiosk-c", L"LOBBY", WEDNESDAY, MINUTE(12, 0), 8, L"pw-lobby"));
+  TEST_CHECK(_Picks(wstrPath, L"KIOSK-B12", L"lobby-2", WEDNESDAY, MINUTE(12, 0), 10, L"pw-any"));
+  TEST_CHECK(_Picks(wstrPath, L"KIOSK-D12", L"lobby", WEDNESDAY, MINUTE(12, 0), 10, L"pw-any"));
+
+  // 22:00-06:00 holds from 22:00 up to midnight and from midnight up to 06:00, on the days
+  // it is for; an earlier rule still wins inside it.
+  const unsigned long rgulNight[] = { MINUTE(22, 0), MINUTE(23, 59), MINUTE(0, 0), MINUTE(5, 59) };
+  const unsigned long rgulDay[] = { MINUTE(6, 0), MINUTE(12, 0), MINUTE(21, 59) };
+  for (size_t i = 0; i < sizeof(rgulNight) / sizeof(rgulNight[0]); i++)
+  {
+    TEST_CHECK(_Picks(wstrPath, L"KIOSK-101", NULL, WEDNESDAY, rgulNight[i], 9, L"pw-night"));
+    TEST_CHECK(_Picks(wstrPath, L"KIOSK-101", NULL, SATURDAY, rgulNight[i], 10, L"pw-any"));
+    TEST_CHECK(_Picks(wstrPath, L"KIOSK-050", NULL, WEDNESDAY, rgulNight[i], 7, L"pw-front"));
+  }
+  for (size_t i = 0; i < sizeof(rgulDay) / sizeof(rgulDay[0]); i++)
+  {
+    TEST_CHECK(_Picks(wstrPath, L"KIOSK-101", NULL, WEDNESDAY, rgulDay[i], 10, L"pw-any"));
+  }
+
+  // Without a catch-all, a name no pattern matches finds nothing; a window that starts and
+  // ends at the same time is all day.
+  std::string strRules = "account\tany\tCONTOSO\tkiosk\tpw-any\nrule\tKIOSK-*\tany\ttime=08:00-08:00\n";
+  TEST_CHECK(_Compile(strRules, NULL, &rgb, &wstrPath));
+  TEST_CHECK(_Picks(wstrPath, L"KIOSK-1", NULL, SATURDAY, MINUTE(3, 0), 2, L"pw-any"));
+  std::wstring wstrPassword;
+  unsigned long ulLine;
+  TEST_CHECK(CSR_NOT_FOUND == _Match(wstrPath, NULL, L"SERVER-1", NULL, WEDNESDAY, MINUTE(12, 0), &wstrPassword, &ulLine));
+  TEST_CHECK(CSR_NOT_FOUND == _Match(wstrPath, NULL, L"KIOSK", NULL, WEDNESDAY, MINUTE(12, 0), &wstrPassword, &ulLine));
+
+  // Entries that aren't valid are reported on their line; a rule for an account nobody
+  // defined, when the rules are compiled.
+  CHostRulesCompiler compiler;
+  const char szBadSet[] = "rule\tKIOSK-[A-C\tany";
+  const char szBadTime[] = "rule\tKIOSK-*\tany\ttime=2200-0600";
+  const char szNoAccount[] = "rule\tKIOSK-*\tnobody";
+  TEST_CHECK(!compiler.AddLine(szBadSet, strlen(szBadSet), 3) && 3 == compiler.ErrorLine());
+  TEST_CHECK(!compiler.AddLine(szBadTime, strlen(szBadTime), 4) && 4 == compiler.ErrorLine());
+  TEST_CHECK(compiler.AddLine(szNoAccount, strlen(szNoAccount), 5));
+  TEST_CHECK(!compiler.Compile(NULL, &rgb) && 5 == compiler.ErrorLine());
+
+  remove(HOST_RULES_FILE);
+  return true;
+}
+
+bool HostRulesSealedTest()
+{
+  CTestRulesSealer sealer;
+  CTestKeyProvider keys;
+  std::vector<unsigned char> rgbPlain;
+  std::vector<unsigned char> rgbSealed;
+  std::wstring wstrPath;
+  std::wstring wstrPassword;
+  unsigned long ulLine;
+
+  // Plaintext rules aren't taken where sealed ones are expected, nor the other way around.
+  TEST_CHECK(_Compile(s_szRules, NULL, &rgbPlain, &wstrPath));
+  TEST_CHECK(CSR_BAD_FORMAT == _Match(wstrPath, &keys, L"KIOSK-050", NULL, WEDNESDAY, MINUTE(12, 0), &wstrPassword, &ulLine));
+  TEST_CHECK(_Compile(s_szRules, &sealer, &rgbSealed, &wstrPath));
+  TEST_CHECK(CSR_BAD_FORMAT == _Match(wstrPath, NULL, L"KIOSK-050", NULL, WEDNESDAY, MINUTE(12, 0), &wstrPassword, &ulLine));
+
+  // No password is in the sealed file as it is in the plaintext one.
+  const char szPassword[] = "pw-front";
+  TEST_CHECK(rgbPlain.end() != std::search(rgbPlain.begin(), rgbPlain.end(), szPassword, szPassword + strlen(szPassword)));
+  TEST_CHECK(rgbSealed.end() == std::search(rgbSealed.begin(), rgbSealed.end(), szPassword, szPassword + strlen(szPassword)));
+
+  // With the key, only the one account chosen is opened.
+  TEST_CHECK(CSR_OK == _Match(wstrPath, &keys, L"KIOSK-050", NULL, WEDNESDAY, MINUTE(23, 0), &wstrPassword, &ulLine));
+  TEST_CHECK(7 == ulLine && L"pw-front" == wstrPassword && 1 == keys.GetKeyCount());
+  TEST_CHECK(CSR_OK == _Match(wstrPath, &keys, L"KIOSK-101", NULL, WEDNESDAY, MINUTE(23, 0), &wstrPassword, &ulLine));
+  TEST_CHECK(9 == ulLine && L"pw-night" == wstrPassword);
+
+  // The last account's record ends the file; with its tag changed, it fails and the others
+  // still open.
+  rgbSealed.back() ^= 0x01;
+  TEST_CHECK(TestWriteFile(HOST_RULES_FILE, &rgbSealed[0], rgbSealed.size(), &wstrPath));
+  TEST_CHECK(CSR_BAD_FORMAT == _Match(wstrPath, &keys, L"SERVER-1", NULL, WEDNESDAY, MINUTE(12, 0), &wstrPassword, &ulLine));
+  TEST_CHECK(CSR_OK == _Match(wstrPath, &keys, L"KIOSK-050", NULL, WEDNESDAY, MINUTE(12, 0), &wstrPassword, &ulLine));
+
+  remove(HOST_RULES_FILE);
+  return true;
+}
+
+bool HostRulesScaleTest()
+{
+  // A rule for each of FLEET_SITES sites, the accounts shared among them, and a catch-all.
+  std::string strRules;
+  for (int i = 0; i < FLEET_ACCOUNTS; i++)
+  {
+    strRules += "account\tsite" + std::to_string(i) + "\tCONTOSO\tsite" + std::to_string(i) + "\tpw" + std::to_string(i) + "\n";
+  }
+  for (int i = 0; i < FLEET_SITES; i++)
+  {
+    strRules += "rule\tSITE" + std::to_string(i) + "-KIOSK-*\tsite" + std::to_string(i % FLEET_ACCOUNTS) + "\n";
+  }
+  strRules += "rule\t*\tsite0\n";
+
+  std::vector<unsigned char> rgb;
+  std::wstring wstrPath;
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  TEST_CHECK(_Compile(strRules, NULL, &rgb, &wstrPath));
+  unsigned long long ullCompileNs = PlatformMonotonicNanoseconds() - ullStart;
+
+  // Each site's machines get its account; how long that takes hardly depends on the number
+  // of rules, since the name is walked once.
+  std::wstring wstrPassword;
+  unsigned long ulLine;
+  ullStart = PlatformMonotonicNanoseconds();
+  for (int i = 0; i < FLEET_SITES; i++)
+  {
+    std::string strMachine = "site" + std::to_string(i) + "-kiosk-" + std::to_string(i % 7);
+    std::wstring wstrMachine(strMachine.begin(), strMachine.end());
+    TEST_CHECK(CSR_OK == _Match(wstrPath, NULL, wstrMachine.c_str(), NULL, WEDNESDAY, MINUTE(12, 0), &wstrPassword, &ulLine));
+    TEST_CHECK(wstrPassword == L"pw" + std::to_wstring(i % FLEET_ACCOUNTS));
+  }
+  unsigned long long ullMatchNs = PlatformMonotonicNanoseconds() - ullStart;
+  TEST_CHECK(CSR_OK == _Match(wstrPath, NULL, L"SITE10000-KIOSK-1", NULL, WEDNESDAY, MINUTE(12, 0), &wstrPassword, &ulLine));
+  TEST_CHECK(L"pw0" == wstrPassword && (unsigned long)(FLEET_ACCOUNTS + FLEET_SITES + 1) == ulLine);
+
+  printf("  %d rules compiled in %.1f ms to %lu bytes; a machine's account found in %.1f us\n",
+    FLEET_SITES + 1, ullCompileNs / 1e6, (unsigned long)rgb.size(), ullMatchNs / 1e3 / FLEET_SITES);
+
+  remove(HOST_RULES_FILE);
+  return true;
+}
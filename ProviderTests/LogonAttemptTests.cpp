@@ -0,0 +1,125 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// LogonAttempt.h: the calls LogonUI makes, replayed against the tracker with made-up times,
+// come out as the time to submit and to the result that LogonUI's user saw.  Every milestone,
+// ReportResult's included, is stamped before Complete, so nothing depends on the clock.
+
+#include "ProviderTests.h"
+#include "LogonAttempt.h"
+
+#define MS 1000000ULL
+
+// One call LogonUI makes, at ullNs.
+struct LOGON_CALL
+{
+  LOGON_ATTEMPT_MILESTONE lam;
+  unsigned long long ullNs;
+};
+
+// Replays rgCalls on pAttempt and ends the attempt.
+static void _Replay(CLogonAttempt* pAttempt, const LOGON_CALL* rgCalls, size_t cCalls,
+  unsigned long long* pullSubmitNs, unsigned long long* pullResultNs)
+{
+  for (size_t i = 0; i < cCalls; i++)
+  {
+    pAttempt->Stamp(rgCalls[i].lam, rgCalls[i].ullNs);
+  }
+  pAttempt->Complete(pullSubmitNs, pullResultNs);
+}
+
+bool LogonAttemptReplayTest()
+{
+  LOGON_ATTEMPT_STATS statsStart;
+  LogonAttemptGetStats(&statsStart);
+  CLogonAttempt attempt;
+  unsigned long long ullSubmitNs;
+  unsigned long long ullResultNs;
+
+  // A logon as LogonUI makes it, with the calls it repeats while it paints: each milestone
+  // keeps the first time it was reached.
+  const LOGON_CALL rgLogon[] =
+  {
+    { LAM_SET_USAGE_SCENARIO, 1000 * MS },
+    { LAM_GET_CREDENTIAL_AT, 1002 * MS },
+    { LAM_GET_CREDENTIAL_AT, 1009 * MS },
+    { LAM_SET_SELECTED, 1010 * MS },
+    { LAM_SET_SELECTED, 1400 * MS },
+    { LAM_GET_SERIALIZATION, 1450 * MS },
+    { LAM_REPORT_RESULT, 1700 * MS },
+  };
+  _Replay(&attempt, rgLogon, sizeof(rgLogon) / sizeof(rgLogon[0]), &ullSubmitNs, &ullResultNs);
+  TEST_CHECK(450 * MS == ullSubmitNs && 700 * MS == ullResultNs);
+
+  // The password was wrong, and the user tries again on the same tile: LogonUI doesn't ask
+  // for tiles again, so the retry starts when the tile is selected.
+  const LOGON_CALL rgRetry[] =
+  {
+    { LAM_SET_SELECTED, 5000 * MS },
+    { LAM_GET_SERIALIZATION, 5200 * MS },
+    { LAM_REPORT_RESULT, 5300 * MS },
+  };
+  _Replay(&attempt, rgRetry, sizeof(rgRetry) / sizeof(rgRetry[0]), &ullSubmitNs, &ullResultNs);
+  TEST_CHECK(200 * MS == ullSubmitNs && 300 * MS == ullResultNs);
+
+  // A result with nothing submitted (the serialization came from SetSerialization) has no
+  // time to submit.
+  const LOGON_CALL rgNoSubmit[] =
+  {
+    { LAM_SET_USAGE_SCENARIO, 9000 * MS },
+    { LAM_REPORT_RESULT, 9100 * MS },
+  };
+  _Replay(&attempt, rgNoSubmit, sizeof(rgNoSubmit) / sizeof(rgNoSubmit[0]), &ullSubmitNs, &ullResultNs);
+  TEST_CHECK(LOGON_ATTEMPT_NOT_REACHED == ullSubmitNs && 100 * MS == ullResultNs);
+
+  LOGON_ATTEMPT_STATS stats;
+  LogonAttemptGetStats(&stats);
+  TEST_CHECK(statsStart.cCompleted + 3 == stats.cCompleted);
+  return true;
+}
+
+bool LogonAttemptWindowTest()
+{
+  // More attempts than the window holds, attempt k submitting after k ms and getting its
+  // result half a millisecond later, so the window ends up with the last
+  // LOGON_ATTEMPT_WINDOW of them whatever ran before.
+  const unsigned long cAttempts = LOGON_ATTEMPT_WINDOW + 44;
+  LOGON_ATTEMPT_STATS statsStart;
+  LogonAttemptGetStats(&statsStart);
+  CLogonAttempt attempt;
+  for (unsigned long k = 1; k <= cAttempts; k++)
+  {
+    unsigned long long ullStart = k * 10000 * MS;
+    const LOGON_CALL rgCalls[] =
+    {
+      { LAM_SET_USAGE_SCENARIO, ullStart },
+      { LAM_GET_SERIALIZATION, ullStart + k * MS },
+      { LAM_REPORT_RESULT, ullStart + k * MS + MS / 2 },
+    };
+    _Replay(&attempt, rgCalls, sizeof(rgCalls) / sizeof(rgCalls[0]), NULL, NULL);
+  }
+
+  LOGON_ATTEMPT_STATS stats;
+  LogonAttemptGetStats(&stats);
+  TEST_CHECK(statsStart.cCompleted + cAttempts == stats.cCompleted && LOGON_ATTEMPT_WINDOW == stats.cWindow);
+
+  // The window holds attempts 45 to 300.  Nearest rank: p50 is the 128th of them, p90 the
+  // 231st and p99 the 254th.
+  const LOGON_ATTEMPT_PERCENTILES& lapSubmit = stats.rgMilestones[LAM_GET_SERIALIZATION];
+  TEST_CHECK(LOGON_ATTEMPT_WINDOW == lapSubmit.cSamples);
+  TEST_CHECK(172 * MS == lapSubmit.ullP50Ns && 275 * MS == lapSubmit.ullP90Ns);
+  TEST_CHECK(298 * MS == lapSubmit.ullP99Ns && 300 * MS == lapSubmit.ullMaxNs);
+  const LOGON_ATTEMPT_PERCENTILES& lapResult = stats.rgMilestones[LAM_REPORT_RESULT];
+  TEST_CHECK(172 * MS + MS / 2 == lapResult.ullP50Ns && 300 * MS + MS / 2 == lapResult.ullMaxNs);
+
+  // Every attempt starts at SetUsageScenario, and none reached the milestones it skipped.
+  TEST_CHECK(LOGON_ATTEMPT_WINDOW == stats.rgMilestones[LAM_SET_USAGE_SCENARIO].cSamples);
+  TEST_CHECK(0 == stats.rgMilestones[LAM_SET_USAGE_SCENARIO].ullMaxNs);
+  TEST_CHECK(0 == stats.rgMilestones[LAM_GET_CREDENTIAL_AT].cSamples && 0 == stats.rgMilestones[LAM_SET_SELECTED].cSamples);
+  return true;
+}
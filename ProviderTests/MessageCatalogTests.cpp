@@ -0,0 +1,349 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// MessageCatalog.h, through CredentialTool's MessageCompiler.h: the compiler refuses what
+// is not a message and says on which line, a lookup finds the message for the status and
+// substatus before the one for any substatus and falls back from the LANGID to its primary
+// language and then to the default, and a catalog that has been cut short or altered is
+// refused before anything is looked up in it.  How long a lookup takes does not grow with
+// the catalog.
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "ProviderTests.h"
+#include "MessageCompiler.h"
+
+#define MESSAGE_CATALOG_FILE "message-catalog.bin"
+#define BENCH_STATUSES 2000
+#define BENCH_LOOKUPS 1000000
+
+#define LANGID_EN_US 0x0409
+#define LANGID_EN_GB 0x0809
+#define LANGID_DE_DE 0x0407
+#define LANGID_DE_AT 0x0C07
+#define LANGID_JA_JP 0x0411
+
+#define STATUS_LOGON_FAILURE 0xC000006DUL
+#define STATUS_WRONG_PASSWORD 0xC000006AUL
+#define STATUS_ACCOUNT_RESTRICTION 0xC000006EUL
+#define STATUS_ACCOUNT_DISABLED 0xC0000072UL
+#define STATUS_PASSWORD_EXPIRED 0xC0000071UL
+#define STATUS_ACCESS_DENIED 0xC0000022UL
+
+static const char s_szMessages[] =
+  "# English first, and the default.\n"
+  "language\t0x0409\tdefault\n"
+  "message\tC000006D\t0xC000006A\terror\tWrong password.\n"
+  "message\t0xC000006D\t*\terror\tIncorrect password or username.\n"
+  "message\t0xC000006E\t0xC0000072\twarning\tThe account is disabled.\n"
+  "message\t0xC0000071\t*\twarning\tThe password has expired \xF0\x9F\x98\x80\n"
+  "\r\n"
+  "language\t0x0407\n"
+  "message\t0xC000006D\t*\terror\tFalscher Benutzername oder falsches Kennwort.\n"
+  "message\t0xC000006E\t0xC0000072\twarning\tDas Konto ist deaktiviert.\n";
+
+// Compiles the message text a line at a time.
+static bool _Compile(const std::string& strMessages, std::vector<unsigned char>* prgb, CMessageCatalogCompiler* pCompiler)
+{
+  unsigned long ulLine = 1;
+  for (size_t i = 0; i < strMessages.size(); ulLine++)
+  {
+    size_t iEnd = strMessages.find('\n', i);
+    if (std::string::npos == iEnd)
+    {
+      iEnd = strMessages.size();
+    }
+    if (!pCompiler->AddLine(strMessages.data() + i, iEnd - i, ulLine))
+    {
+      return false;
+    }
+    i = iEnd + 1;
+  }
+  return pCompiler->Compile(prgb);
+}
+
+// The line the compiler refuses strMessages at, or 0 if it compiles.
+static unsigned long _ErrorLine(const std::string& strMessages)
+{
+  CMessageCatalogCompiler compiler;
+  std::vector<unsigned char> rgb;
+  return _Compile(strMessages, &rgb, &compiler) ? 0 : (compiler.ErrorLine() ? compiler.ErrorLine() : (unsigned long)-1);
+}
+
+// Looks a message up and compares its text, as ASCII, and its icon.
+static bool _Lookup(
+  const MESSAGE_CATALOG& catalog,
+  unsigned long ulStatus,
+  unsigned long ulSubstatus,
+  unsigned short usLangId,
+  const char* pszExpected,
+  MESSAGE_CATALOG_ICON mciExpected
+)
+{
+  MESSAGE_CATALOG_ENTRY entry;
+  TEST_CHECK(MessageCatalogLookup(catalog, ulStatus, ulSubstatus, usLangId, &entry));
+  std::vector<wchar_t> rgwch(entry.cchText + 1);
+  size_t cch = MessageCatalogCopyText(entry, &rgwch[0]);
+  TEST_CHECK(cch == strlen(pszExpected) && L'\0' == rgwch[cch]);
+  for (size_t i = 0; i < cch; i++)
+  {
+    TEST_CHECK((wchar_t)pszExpected[i] == rgwch[i]);
+  }
+  TEST_CHECK(mciExpected == entry.mci);
+  return true;
+}
+
+static unsigned long _GetU32(const std::vector<unsigned char>& rgb, size_t ib)
+{
+  return rgb[ib] | (rgb[ib + 1] << 8) | (rgb[ib + 2] << 16) | ((unsigned long)rgb[ib + 3] << 24);
+}
+
+static void _PutU32(std::vector<unsigned char>* prgb, size_t ib, unsigned long ul)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    (*prgb)[ib + i] = (unsigned char)(ul >> (8 * i));
+  }
+}
+
+static bool _Refused(const std::vector<unsigned char>& rgb)
+{
+  MESSAGE_CATALOG catalog;
+  return PR_BAD_DATA == MessageCatalogAttach(rgb.empty() ? NULL : &rgb[0], rgb.size(), &catalog) && NULL == catalog.pb;
+}
+
+bool MessageCatalogCompilerTest()
+{
+  std::vector<unsigned char> rgb;
+  CMessageCatalogCompiler compiler;
+  TEST_CHECK(_Compile(s_szMessages, &rgb, &compiler));
+
+  // Four English messages and two German ones; English and German are filed under en and
+  // de as well.  "Wrong password." and the rest are one text each.
+  const MESSAGE_CATALOG_COMPILE_STATS& stats = compiler.Stats();
+  TEST_CHECK(2 == stats.cLanguages && 6 == stats.cMessages && 6 == stats.cAliases && 6 == stats.cTexts);
+  TEST_CHECK(32 == stats.cSlots && stats.cMaxProbe >= 1 && stats.cbOutput == rgb.size());
+  TEST_CHECK(MESSAGE_CATALOG_HEADER_SIZE + 32 * MESSAGE_CATALOG_SLOT_SIZE < rgb.size());
+
+  // The same text twice is stored once.
+  CMessageCatalogCompiler compilerShared;
+  TEST_CHECK(_Compile("language\t409\tdefault\n"
+    "message\t1\t*\tnone\tsame\n"
+    "message\t2\t*\tnone\tsame\n", &rgb, &compilerShared));
+  TEST_CHECK(2 == compilerShared.Stats().cMessages && 1 == compilerShared.Stats().cTexts);
+
+  // What is not an entry, and where.
+  TEST_CHECK(0 == _ErrorLine("language\t0x0409\tdefault\n"));
+  TEST_CHECK(1 == _ErrorLine("messages\t1\t*\tnone\ttext\n"));
+  TEST_CHECK(1 == _ErrorLine("message\t1\t*\tnone\ttext\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nlanguage\t409\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nlanguage\t407\tdefault\n"));
+  TEST_CHECK(1 == _ErrorLine("language\t10000\tdefault\n"));
+  TEST_CHECK(1 == _ErrorLine("language\t0\tdefault\n"));
+  TEST_CHECK(1 == _ErrorLine("language\t409\tfirst\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\ttext\textra\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t0x\t*\tnone\ttext\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t123456789\t*\tnone\ttext\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t1\tg\tnone\ttext\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tinfo\ttext\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\t\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\t\xC0\xAF\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\t\xED\xA0\x80\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\t\xE2\x82\n"));
+  TEST_CHECK(3 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\ta\nmessage\t1\t*\tnone\tb\n"));
+  TEST_CHECK(0 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\ta\nmessage\t1\t0\tnone\tb\n"));
+  TEST_CHECK(0 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\t" + std::string(MESSAGE_CATALOG_MAX_TEXT, 'x') + "\n"));
+  TEST_CHECK(2 == _ErrorLine("language\t409\tdefault\nmessage\t1\t*\tnone\t" + std::string(MESSAGE_CATALOG_MAX_TEXT + 1, 'x') + "\n"));
+
+  // Without a default language the catalog as a whole is refused.
+  TEST_CHECK((unsigned long)-1 == _ErrorLine("language\t409\nmessage\t1\t*\tnone\ttext\n"));
+  return true;
+}
+
+bool MessageCatalogLookupTest()
+{
+  std::vector<unsigned char> rgb;
+  CMessageCatalogCompiler compiler;
+  TEST_CHECK(_Compile(s_szMessages, &rgb, &compiler));
+  std::wstring path;
+  TEST_CHECK(TestWriteFile(MESSAGE_CATALOG_FILE, &rgb[0], rgb.size(), &path));
+
+  MESSAGE_CATALOG catalog;
+  TEST_CHECK(PR_OK == MessageCatalogOpen(path.c_str(), &catalog));
+  TEST_CHECK(LANGID_EN_US == catalog.hdr.ulDefaultLangId && rgb.size() == catalog.cb);
+
+  // The substatus is matched before any substatus.
+  bool fOk = _Lookup(catalog, STATUS_LOGON_FAILURE, STATUS_WRONG_PASSWORD, LANGID_EN_US, "Wrong password.", MCI_ERROR) &&
+    _Lookup(catalog, STATUS_LOGON_FAILURE, 0, LANGID_EN_US, "Incorrect password or username.", MCI_ERROR) &&
+    _Lookup(catalog, STATUS_ACCOUNT_RESTRICTION, STATUS_ACCOUNT_DISABLED, LANGID_EN_US, "The account is disabled.", MCI_WARNING);
+
+  // de-AT has no messages of its own and finds de-DE's through de; what German lacks comes
+  // from English, as does every message in Japanese.
+  fOk = fOk && _Lookup(catalog, STATUS_LOGON_FAILURE, STATUS_WRONG_PASSWORD, LANGID_DE_DE, "Falscher Benutzername oder falsches Kennwort.", MCI_ERROR) &&
+    _Lookup(catalog, STATUS_ACCOUNT_RESTRICTION, STATUS_ACCOUNT_DISABLED, LANGID_DE_AT, "Das Konto ist deaktiviert.", MCI_WARNING) &&
+    _Lookup(catalog, STATUS_LOGON_FAILURE, 0, LANGID_DE_AT, "Falscher Benutzername oder falsches Kennwort.", MCI_ERROR) &&
+    _Lookup(catalog, STATUS_ACCOUNT_RESTRICTION, STATUS_ACCOUNT_DISABLED, LANGID_EN_GB, "The account is disabled.", MCI_WARNING) &&
+    _Lookup(catalog, STATUS_LOGON_FAILURE, STATUS_WRONG_PASSWORD, LANGID_JA_JP, "Wrong password.", MCI_ERROR);
+
+  // A substatus with no message of its own and no message for any substatus, and a status
+  // with none at all.
+  MESSAGE_CATALOG_ENTRY entry;
+  fOk = fOk && !MessageCatalogLookup(catalog, STATUS_ACCOUNT_RESTRICTION, STATUS_PASSWORD_EXPIRED, LANGID_EN_US, &entry) &&
+    !MessageCatalogLookup(catalog, STATUS_ACCESS_DENIED, 0, LANGID_DE_DE, &entry) &&
+    !MessageCatalogLookup(catalog, STATUS_WRONG_PASSWORD, STATUS_LOGON_FAILURE, LANGID_EN_US, &entry);
+
+  // Text outside the Basic Multilingual Plane is one character where wchar_t holds it.
+  wchar_t rgwch[64];
+  fOk = fOk && MessageCatalogLookup(catalog, STATUS_PASSWORD_EXPIRED, 0, LANGID_DE_DE, &entry) &&
+    MessageCatalogCopyText(entry, rgwch) == (sizeof(wchar_t) == 2 ? entry.cchText : entry.cchText - 1) &&
+    (sizeof(wchar_t) == 2 ? (0xD83D == rgwch[25] && 0xDE00 == rgwch[26]) : 0x1F600 == (unsigned long)rgwch[25]);
+  MessageCatalogClose(&catalog);
+  TEST_CHECK(fOk);
+  TEST_CHECK(NULL == catalog.pb && NULL == catalog.pView);
+
+  // Nothing is found in a catalog that failed to open.
+  TEST_CHECK(PR_NOT_FOUND == MessageCatalogOpen(TestMissingPath("message-catalog-missing.bin").c_str(), &catalog));
+  TEST_CHECK(!MessageCatalogLookup(catalog, STATUS_LOGON_FAILURE, 0, LANGID_EN_US, &entry));
+  remove(MESSAGE_CATALOG_FILE);
+  TEST_CHECK(TestWriteFile(MESSAGE_CATALOG_FILE, "ALMC", 4, &path));
+  TEST_CHECK(PR_BAD_DATA == MessageCatalogOpen(path.c_str(), &catalog));
+  remove(MESSAGE_CATALOG_FILE);
+  return true;
+}
+
+bool MessageCatalogCorruptTest()
+{
+  std::vector<unsigned char> rgb;
+  CMessageCatalogCompiler compiler;
+  TEST_CHECK(_Compile(s_szMessages, &rgb, &compiler));
+  MESSAGE_CATALOG catalog;
+  TEST_CHECK(PR_OK == MessageCatalogAttach(&rgb[0], rgb.size(), &catalog));
+
+  // Cut short anywhere.
+  for (size_t cb = 0; cb < rgb.size(); cb++)
+  {
+    TEST_CHECK(_Refused(std::vector<unsigned char>(rgb.begin(), rgb.begin() + cb)));
+  }
+
+  // The header: magic, version, a slot count that is not a power of two or leaves no slot
+  // empty, a message count that does not match the slots, and sections out of bounds.
+  static const struct
+  {
+    size_t ib;
+    unsigned long ul;
+  } s_rgHeaderChanges[] =
+  {
+    { 0, 0x434D4C42 },
+    { 4, MESSAGE_CATALOG_VERSION + 1 },
+    { 12, 24 },
+    { 12, 0 },
+    { 16, 11 },
+    { 16, 13 },
+    { 16, 32 },
+    { 20, 16 },
+    { 20, 0x7FFFFFFF },
+    { 24, 0x7FFFFFFF },
+    { 28, 0xFFFFFFFF },
+  };
+  for (size_t i = 0; i < sizeof(s_rgHeaderChanges) / sizeof(s_rgHeaderChanges[0]); i++)
+  {
+    std::vector<unsigned char> rgbChanged(rgb);
+    _PutU32(&rgbChanged, s_rgHeaderChanges[i].ib, s_rgHeaderChanges[i].ul);
+    TEST_CHECK(_Refused(rgbChanged));
+  }
+
+  // A used slot whose icon is not one, or whose text runs past the text section.
+  size_t ibSlot = MESSAGE_CATALOG_HEADER_SIZE;
+  while (0 == (rgb[ibSlot + 10] & MESSAGE_CATALOG_SLOT_USED))
+  {
+    ibSlot += MESSAGE_CATALOG_SLOT_SIZE;
+  }
+  unsigned long cbText = _GetU32(rgb, 28);
+  std::vector<unsigned char> rgbChanged(rgb);
+  rgbChanged[ibSlot + 11] = MCI_SUCCESS + 1;
+  TEST_CHECK(_Refused(rgbChanged));
+  rgbChanged = rgb;
+  _PutU32(&rgbChanged, ibSlot + 12, cbText - 1);
+  TEST_CHECK(_Refused(rgbChanged));
+  rgbChanged = rgb;
+  size_t ibText = _GetU32(rgb, 24) + _GetU32(rgb, ibSlot + 12);
+  rgbChanged[ibText] = 0xFF;
+  rgbChanged[ibText + 1] = 0xFF;
+  TEST_CHECK(_Refused(rgbChanged));
+
+  // A slot marked empty leaves the message count wrong.
+  rgbChanged = rgb;
+  rgbChanged[ibSlot + 10] = 0;
+  TEST_CHECK(_Refused(rgbChanged));
+  return true;
+}
+
+bool MessageCatalogBenchTest()
+{
+  // A catalog of the size of the shipped one, and one a hundred times its size: four
+  // languages, each with a message for every status and any substatus and for every status
+  // and one substatus.
+  static const unsigned short s_rgusLangIds[] = { LANGID_EN_US, LANGID_DE_DE, 0x040C, 0x0C0A };
+  double rgdLookupNs[2];
+  for (int iSize = 0; iSize < 2; iSize++)
+  {
+    unsigned long cStatuses = iSize ? BENCH_STATUSES : BENCH_STATUSES / 100;
+    std::string strMessages;
+    for (size_t iLang = 0; iLang < sizeof(s_rgusLangIds) / sizeof(s_rgusLangIds[0]); iLang++)
+    {
+      char szLine[128];
+      snprintf(szLine, sizeof(szLine), "language\t%x%s\n", s_rgusLangIds[iLang], iLang ? "" : "\tdefault");
+      strMessages += szLine;
+      for (unsigned long ulStatus = 0; ulStatus < cStatuses; ulStatus++)
+      {
+        snprintf(szLine, sizeof(szLine), "message\t%lx\t*\terror\tStatus %lu in %x\n", 0xC0000000UL + ulStatus, ulStatus, s_rgusLangIds[iLang]);
+        strMessages += szLine;
+        snprintf(szLine, sizeof(szLine), "message\t%lx\t%lx\twarning\tStatus %lu, substatus in %x\n", 0xC0000000UL + ulStatus, ulStatus, ulStatus, s_rgusLangIds[iLang]);
+        strMessages += szLine;
+      }
+    }
+
+    std::vector<unsigned char> rgb;
+    CMessageCatalogCompiler compiler;
+    unsigned long long ullStart = PlatformMonotonicNanoseconds();
+    TEST_CHECK(_Compile(strMessages, &rgb, &compiler));
+    unsigned long long ullCompileNs = PlatformMonotonicNanoseconds() - ullStart;
+    MESSAGE_CATALOG catalog;
+    TEST_CHECK(PR_OK == MessageCatalogAttach(&rgb[0], rgb.size(), &catalog));
+
+    // Hits in the LANGID itself, through the primary language and through the default,
+    // with and without the substatus, and misses.
+    static const unsigned short s_rgusQueryLangIds[] = { LANGID_EN_US, LANGID_DE_AT, LANGID_JA_JP, 0x0C0A };
+    size_t cFound = 0;
+    wchar_t rgwch[64];
+    ullStart = PlatformMonotonicNanoseconds();
+    for (unsigned long i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      unsigned long ulStatus = 0xC0000000UL + (i * 7919) % (cStatuses + cStatuses / 8);
+      MESSAGE_CATALOG_ENTRY entry;
+      if (MessageCatalogLookup(catalog, ulStatus, (i & 1) ? ulStatus - 0xC0000000UL : 1, s_rgusQueryLangIds[i & 3], &entry))
+      {
+        cFound++;
+        MessageCatalogCopyText(entry, rgwch);
+      }
+    }
+    unsigned long long ullLookupNs = PlatformMonotonicNanoseconds() - ullStart;
+    TEST_CHECK(cFound > BENCH_LOOKUPS / 2 && cFound < BENCH_LOOKUPS);
+    rgdLookupNs[iSize] = (double)ullLookupNs / BENCH_LOOKUPS;
+
+    const MESSAGE_CATALOG_COMPILE_STATS& stats = compiler.Stats();
+    printf("  %lu messages (%lu more under a primary language) compiled in %.1f ms to %lu bytes, %lu slots,\n"
+      "  at most %lu probes; a lookup and copy in %.1f ns\n",
+      stats.cMessages, stats.cAliases, ullCompileNs / 1e6, (unsigned long)rgb.size(), stats.cSlots, stats.cMaxProbe, rgdLookupNs[iSize]);
+  }
+  printf("  a catalog %d times as large: %.2fx the time per lookup\n", 100, rgdLookupNs[1] / rgdLookupNs[0]);
+  return true;
+}
@@ -0,0 +1,243 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Platform.h: what the platform-neutral files rely on, whichever implementation is linked.
+// The protect-key case checks how PlatformPosix.cpp keeps its key, so it only builds off
+// Windows.
+
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#include <vector>
+#include "ProviderTests.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// How PlatformPosix.cpp names and sizes this account's PlatformProtectMemory key.
+#define PROTECT_KEY_NAME_FORMAT "/AutoLoginCredentialProvider.MemoryKey.%lu"
+#define PROTECT_KEY_SIZE 32
+#endif
+
+bool PlatformReadTest()
+{
+  static const char s_szContents[] = "0123456789";
+  std::wstring path;
+  TEST_CHECK(TestWriteFile("platform-read.txt", s_szContents, 10, &path));
+
+  std::vector<unsigned char> rgb;
+  TEST_CHECK(PR_OK == PlatformReadFile(path.c_str(), 10, &rgb));
+  TEST_CHECK(10 == rgb.size() && 0 == memcmp(&rgb[0], s_szContents, 10));
+  TEST_CHECK(PR_TOO_LARGE == PlatformReadFile(path.c_str(), 9, &rgb));
+  TEST_CHECK(PR_NOT_FOUND == PlatformReadFile(TestMissingPath("platform-missing.txt").c_str(), 10, &rgb));
+
+  PLATFORM_FILE* pFile;
+  TEST_CHECK(PR_OK == PlatformOpenFile(path.c_str(), &pFile));
+  char rgch[4];
+  PLATFORM_RESULT prInside = PlatformReadFileAt(pFile, 6, rgch, 4);
+  PLATFORM_RESULT prPastEnd = PlatformReadFileAt(pFile, 7, rgch, 4);
+  PlatformCloseFile(pFile);
+  TEST_CHECK(PR_OK == prInside);
+  TEST_CHECK(PR_END_OF_FILE == prPastEnd);
+
+  // Mapped, the file reads the same; too large and missing are refused as they are read.
+  PLATFORM_FILE_VIEW* pView;
+  const void* pv;
+  size_t cb;
+  TEST_CHECK(PR_OK == PlatformMapFile(path.c_str(), 10, &pView, &pv, &cb));
+  bool fMapped = (10 == cb && 0 == memcmp(pv, s_szContents, 10));
+  PlatformUnmapFile(pView);
+  TEST_CHECK(fMapped);
+  TEST_CHECK(PR_TOO_LARGE == PlatformMapFile(path.c_str(), 9, &pView, &pv, &cb) && NULL == pView);
+  TEST_CHECK(PR_NOT_FOUND == PlatformMapFile(TestMissingPath("platform-missing.txt").c_str(), 10, &pView, &pv, &cb));
+  TEST_CHECK(TestWriteFile("platform-read.txt", "", 0, &path));
+  TEST_CHECK(PR_END_OF_FILE == PlatformMapFile(path.c_str(), 10, &pView, &pv, &cb));
+  return true;
+}
+
+bool PlatformAesGcmTest()
+{
+  // Test case 2 of the GCM specification: a zero key, nonce and block.
+  static const unsigned char s_rgbCiphertext[16] = { 0x03, 0x88, 0xda, 0xce, 0x60, 0xb6, 0xa3, 0x92, 0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78 };
+  static const unsigned char s_rgbTag[16] = { 0xab, 0x6e, 0x47, 0xd4, 0x2c, 0xec, 0x13, 0xbd, 0xf5, 0x3a, 0x67, 0xb2, 0x12, 0x57, 0xbd, 0xdf };
+  unsigned char rgbKey[16] = {};
+  unsigned char rgbNonce[12] = {};
+  unsigned char rgbPlaintext[16] = {};
+  unsigned char rgbCiphertext[16];
+  unsigned char rgbTag[16];
+  TEST_CHECK(PR_OK == PlatformAesGcmEncrypt(rgbKey, sizeof(rgbKey), rgbNonce, sizeof(rgbNonce), NULL, 0,
+    rgbPlaintext, sizeof(rgbPlaintext), rgbCiphertext, rgbTag, sizeof(rgbTag)));
+  TEST_CHECK(0 == memcmp(rgbCiphertext, s_rgbCiphertext, 16));
+  TEST_CHECK(0 == memcmp(rgbTag, s_rgbTag, 16));
+
+  // A round trip with a 256-bit key and additional data, then every part altered in turn.
+  unsigned char rgbKey256[32];
+  unsigned char rgbAad[28];
+  static const char s_szSecret[] = "machine\ndomain\nuser\npassword";
+  for (size_t i = 0; i < sizeof(rgbKey256); i++)
+  {
+    rgbKey256[i] = (unsigned char)(i * 7 + 1);
+  }
+  memset(rgbAad, 0xA5, sizeof(rgbAad));
+  std::vector<unsigned char> rgbSealed(sizeof(s_szSecret));
+  std::vector<unsigned char> rgbOpened(sizeof(s_szSecret));
+  TEST_CHECK(PR_OK == PlatformAesGcmEncrypt(rgbKey256, sizeof(rgbKey256), rgbNonce, sizeof(rgbNonce), rgbAad, sizeof(rgbAad),
+    reinterpret_cast<const unsigned char*>(s_szSecret), sizeof(s_szSecret), &rgbSealed[0], rgbTag, sizeof(rgbTag)));
+  TEST_CHECK(PR_OK == PlatformAesGcmDecrypt(rgbKey256, sizeof(rgbKey256), rgbNonce, sizeof(rgbNonce), rgbAad, sizeof(rgbAad),
+    &rgbSealed[0], rgbSealed.size(), rgbTag, sizeof(rgbTag), &rgbOpened[0]));
+  TEST_CHECK(0 == memcmp(&rgbOpened[0], s_szSecret, sizeof(s_szSecret)));
+
+  rgbSealed[3] ^= 1;
+  TEST_CHECK(PR_BAD_DATA == PlatformAesGcmDecrypt(rgbKey256, sizeof(rgbKey256), rgbNonce, sizeof(rgbNonce), rgbAad, sizeof(rgbAad),
+    &rgbSealed[0], rgbSealed.size(), rgbTag, sizeof(rgbTag), &rgbOpened[0]));
+  rgbSealed[3] ^= 1;
+  rgbAad[27] ^= 1;
+  TEST_CHECK(PR_BAD_DATA == PlatformAesGcmDecrypt(rgbKey256, sizeof(rgbKey256), rgbNonce, sizeof(rgbNonce), rgbAad, sizeof(rgbAad),
+    &rgbSealed[0], rgbSealed.size(), rgbTag, sizeof(rgbTag), &rgbOpened[0]));
+  rgbAad[27] ^= 1;
+  rgbTag[0] ^= 1;
+  TEST_CHECK(PR_BAD_DATA == PlatformAesGcmDecrypt(rgbKey256, sizeof(rgbKey256), rgbNonce, sizeof(rgbNonce), rgbAad, sizeof(rgbAad),
+    &rgbSealed[0], rgbSealed.size(), rgbTag, sizeof(rgbTag), &rgbOpened[0]));
+  return true;
+}
+
+bool PlatformProtectMemoryTest()
+{
+  unsigned char rgb[4 * PLATFORM_PROTECT_BLOCK_SIZE];
+  unsigned char rgbOriginal[sizeof(rgb)];
+  for (size_t i = 0; i < sizeof(rgb); i++)
+  {
+    rgb[i] = (unsigned char)i;
+  }
+  memcpy(rgbOriginal, rgb, sizeof(rgb));
+
+  TEST_CHECK(PR_OK == PlatformProtectMemory(rgb, sizeof(rgb)));
+  TEST_CHECK(0 != memcmp(rgb, rgbOriginal, sizeof(rgb)));
+  TEST_CHECK(PR_OK == PlatformUnprotectMemory(rgb, sizeof(rgb)));
+  TEST_CHECK(0 == memcmp(rgb, rgbOriginal, sizeof(rgb)));
+  TEST_CHECK(PR_OK != PlatformProtectMemory(rgb, PLATFORM_PROTECT_BLOCK_SIZE + 1));
+  return true;
+}
+
+#ifndef _WIN32
+// Protects a zero block in a new process and returns the result in *ppr and what the block
+// became in pbProtected.  If fDeniedFirst, the first attempt has to be refused, and the key
+// object fdKey is then made the account's alone before the second.
+static bool _ProtectInChild(bool fDeniedFirst, int fdKey, PLATFORM_RESULT* ppr, unsigned char* pbProtected)
+{
+  int rgfd[2];
+  TEST_CHECK(0 == pipe(rgfd));
+  fflush(stdout);
+  pid_t pid = fork();
+  if (0 == pid)
+  {
+    close(rgfd[0]);
+    struct
+    {
+      PLATFORM_RESULT pr;
+      unsigned char rgb[PLATFORM_PROTECT_BLOCK_SIZE];
+    } result = {};
+    result.pr = PlatformProtectMemory(result.rgb, sizeof(result.rgb));
+    if (fDeniedFirst)
+    {
+      result.pr = (PR_ACCESS_DENIED == result.pr && 0 == fchmod(fdKey, 0600)) ?
+        PlatformProtectMemory(result.rgb, sizeof(result.rgb)) : PR_IO_ERROR;
+    }
+    _exit((ssize_t)sizeof(result) == write(rgfd[1], &result, sizeof(result)) ? 0 : 1);
+  }
+  close(rgfd[1]);
+  PLATFORM_RESULT pr = PR_IO_ERROR;
+  bool fRead = pid > 0 && (ssize_t)sizeof(pr) == read(rgfd[0], &pr, sizeof(pr)) &&
+    PLATFORM_PROTECT_BLOCK_SIZE == read(rgfd[0], pbProtected, PLATFORM_PROTECT_BLOCK_SIZE);
+  close(rgfd[0]);
+  int iStatus = 0;
+  TEST_CHECK(pid > 0 && pid == waitpid(pid, &iStatus, 0));
+  TEST_CHECK(fRead && WIFEXITED(iStatus) && 0 == WEXITSTATUS(iStatus));
+  *ppr = pr;
+  return true;
+}
+
+static bool _KeySize(int fd, off_t cb)
+{
+  struct stat st;
+  TEST_CHECK(0 == fstat(fd, &st) && cb == st.st_size);
+  return true;
+}
+
+// Replaces this account's key object with a new one that anyone can read, and returns it.
+static int _OpenKeyForTest(const char* pszName)
+{
+  shm_unlink(pszName);
+  mode_t mask = umask(0);
+  int fd = shm_open(pszName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  umask(mask);
+  return fd;
+}
+
+// The children are forked, so this runs before anything else in the process has loaded the
+// key; ProviderTests.cpp lists it ahead of platform-protect-memory.
+bool PlatformProtectKeyTest()
+{
+  char szName[64];
+  snprintf(szName, sizeof(szName), PROTECT_KEY_NAME_FORMAT, (unsigned long)geteuid());
+  int fd = _OpenKeyForTest(szName);
+  TEST_CHECK(fd >= 0);
+
+  // A key object others can read is refused, but only until it is put right: the process
+  // doesn't go on refusing once it is.  It was empty, so it gets a key.
+  PLATFORM_RESULT prFirst = PR_IO_ERROR;
+  unsigned char rgbFirst[PLATFORM_PROTECT_BLOCK_SIZE];
+  bool fOk = _ProtectInChild(true, fd, &prFirst, rgbFirst) && PR_OK == prFirst && _KeySize(fd, PROTECT_KEY_SIZE);
+
+  // One cut short, as if whoever was writing it died, gets a new key, which every process
+  // then shares.
+  PLATFORM_RESULT prSecond = PR_IO_ERROR;
+  PLATFORM_RESULT prThird = PR_IO_ERROR;
+  unsigned char rgbSecond[PLATFORM_PROTECT_BLOCK_SIZE];
+  unsigned char rgbThird[PLATFORM_PROTECT_BLOCK_SIZE];
+  fOk = fOk && 0 == ftruncate(fd, PROTECT_KEY_SIZE / 2) &&
+    _ProtectInChild(false, fd, &prSecond, rgbSecond) && PR_OK == prSecond && _KeySize(fd, PROTECT_KEY_SIZE) &&
+    _ProtectInChild(false, fd, &prThird, rgbThird) && PR_OK == prThird;
+  fOk = fOk && 0 != memcmp(rgbFirst, rgbSecond, sizeof(rgbFirst)) && 0 == memcmp(rgbSecond, rgbThird, sizeof(rgbSecond));
+
+  // One too long isn't one of ours.
+  PLATFORM_RESULT prLong = PR_OK;
+  fOk = fOk && 0 == ftruncate(fd, PROTECT_KEY_SIZE + 1) &&
+    _ProtectInChild(false, fd, &prLong, rgbThird) && PR_ACCESS_DENIED == prLong;
+
+  close(fd);
+  shm_unlink(szName);
+  TEST_CHECK(fOk);
+  return true;
+}
+#endif
+
+bool PlatformSha256Test()
+{
+  static const unsigned char s_rgbAbc[PLATFORM_SHA256_SIZE] =
+  {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+  };
+  unsigned char rgbDigest[PLATFORM_SHA256_SIZE];
+  TEST_CHECK(PR_OK == PlatformSha256("abc", 3, rgbDigest));
+  TEST_CHECK(0 == memcmp(rgbDigest, s_rgbAbc, sizeof(rgbDigest)));
+  return true;
+}
+
+bool PlatformUpcaseTest()
+{
+  wchar_t wz[] = L"alice.Contoso-01 \x00e9\x00f1";
+  PlatformUpcase(wz, wcslen(wz));
+  TEST_CHECK(0 == wcscmp(wz, L"ALICE.CONTOSO-01 \x00c9\x00d1"));
+  return true;
+}
@@ -0,0 +1,165 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// ProviderTests runs the provider's tests.
+//
+// Usage: ProviderTests [prefix...]
+//
+// With no arguments every case runs; otherwise the cases whose names start with one of the
+// prefixes do.  Cases write their files to the current directory.  Exits 1 if a case fails
+// and 2 if no case matched.
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include "ProviderTests.h"
+
+typedef bool (*PFNTEST)();
+
+struct PROVIDER_TEST
+{
+  const char* pszName;
+  PFNTEST pfnTest;
+};
+
+static const PROVIDER_TEST s_rgTests[] =
+{
+  { "platform-read", PlatformReadTest },
+  { "platform-aes-gcm", PlatformAesGcmTest },
+#ifndef _WIN32
+  { "platform-protect-key", PlatformProtectKeyTest },
+#endif
+  { "platform-protect-memory", PlatformProtectMemoryTest },
+  { "platform-sha256", PlatformSha256Test },
+  { "platform-upcase", PlatformUpcaseTest },
+  { "credential-store-parse-encodings", CredentialStoreParseEncodingsTest },
+  { "credential-store-parse-lines", CredentialStoreParseLinesTest },
+  { "credential-store-load", CredentialStoreLoadTest },
+  { "credential-store-shards", CredentialStoreShardsTest },
+  { "sealed-store-lookup", SealedStoreLookupTest },
+  { "sealed-store-tamper", SealedStoreTamperTest },
+  { "host-rules-match", HostRulesMatchTest },
+  { "host-rules-sealed", HostRulesSealedTest },
+  { "host-rules-scale", HostRulesScaleTest },
+  { "account-record-layout", AccountRecordLayoutTest },
+  { "account-record-footprint", AccountRecordFootprintTest },
+  { "account-name-forms", AccountNameFormsTest },
+  { "account-name-table", AccountNameTableTest },
+  { "account-snapshot-hold", AccountSnapshotHoldTest },
+  { "account-snapshot-concurrent", AccountSnapshotConcurrentTest },
+  { "status-queue-coalesce", StatusQueueCoalesceTest },
+  { "status-queue-delivery", StatusQueueDeliveryTest },
+  { "shared-account-cache-round-trip", SharedAccountCacheRoundTripTest },
+#ifndef _WIN32
+  { "shared-account-cache-sessions", SharedAccountCacheSessionsTest },
+#endif
+  { "logon-attempt-replay", LogonAttemptReplayTest },
+  { "logon-attempt-window", LogonAttemptWindowTest },
+  { "flight-recorder-ring", FlightRecorderRingTest },
+#ifndef _WIN32
+  { "flight-recorder-kill", FlightRecorderKillTest },
+#endif
+  { "field-string-buffer-growth", FieldStringBufferGrowthTest },
+  { "field-string-buffer-keystrokes", FieldStringBufferKeystrokesTest },
+  { "trace-export", TraceExportTest },
+  { "histogram-percentile", HistogramPercentileTest },
+  { "histogram-record", HistogramRecordTest },
+  { "histogram-file", HistogramFileTest },
+  { "audit-log-record", AuditLogRecordTest },
+  { "audit-log-concurrent", AuditLogConcurrentTest },
+  { "alloc-track-budget", AllocTrackBudgetTest },
+  { "thread-pool-cancel", ThreadPoolCancelTest },
+  { "thread-pool-stress", ThreadPoolStressTest },
+  { "thread-pool-latency", ThreadPoolLatencyTest },
+  { "provision-entry", ProvisionEntryTest },
+  { "provision-scale", ProvisionScaleTest },
+  { "message-catalog-compiler", MessageCatalogCompilerTest },
+  { "message-catalog-lookup", MessageCatalogLookupTest },
+  { "message-catalog-corrupt", MessageCatalogCorruptTest },
+  { "message-catalog-bench", MessageCatalogBenchTest },
+  { "tile-schema-strings", TileSchemaStringsTest },
+  { "tile-schema-tables", TileSchemaTablesTest },
+  { "report-result-message-shipped", ReportResultMessageShippedTest },
+  { "class-factory-refs", ClassFactoryRefsTest },
+  { "class-factory-acquire", ClassFactoryAcquireTest },
+};
+
+void TestFail(const char* pszFile, int iLine, const char* pszExpression)
+{
+  const char* pszLeaf = strrchr(pszFile, '/');
+  const char* pszLeafWin = strrchr(pszFile, '\\');
+  if (!pszLeaf || (pszLeafWin && pszLeafWin > pszLeaf))
+  {
+    pszLeaf = pszLeafWin;
+  }
+  printf("  %s(%d): %s\n", pszLeaf ? pszLeaf + 1 : pszFile, iLine, pszExpression);
+}
+
+bool TestWriteFile(const char* pszName, const void* pv, size_t cb, std::wstring* pPath)
+{
+  std::ofstream file(pszName, std::ios::binary | std::ios::trunc);
+  file.write(static_cast<const char*>(pv), static_cast<std::streamsize>(cb));
+  file.close();
+  if (!file)
+  {
+    return false;
+  }
+
+  // The names are all ASCII.
+  pPath->assign(pszName, pszName + strlen(pszName));
+  return true;
+}
+
+std::wstring TestMissingPath(const char* pszName)
+{
+  remove(pszName);
+  return std::wstring(pszName, pszName + strlen(pszName));
+}
+
+static bool _IsSelected(const char* pszName, int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    return true;
+  }
+  for (int i = 1; i < argc; i++)
+  {
+    if (0 == strncmp(pszName, argv[i], strlen(argv[i])))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned long cRun = 0;
+  unsigned long cFailed = 0;
+  for (size_t i = 0; i < sizeof(s_rgTests) / sizeof(s_rgTests[0]); i++)
+  {
+    if (_IsSelected(s_rgTests[i].pszName, argc, argv))
+    {
+      unsigned long long ullStart = PlatformMonotonicNanoseconds();
+      bool fPassed = s_rgTests[i].pfnTest();
+      printf("%s %s (%.1f ms)\n", fPassed ? "PASS" : "FAIL", s_rgTests[i].pszName,
+        (PlatformMonotonicNanoseconds() - ullStart) / 1e6);
+      fflush(stdout);
+      cRun++;
+      cFailed += fPassed ? 0 : 1;
+    }
+  }
+
+  if (!cRun)
+  {
+    printf("usage: ProviderTests [prefix...]\n\nNo case matched.\n");
+    return 2;
+  }
+  printf("%lu of %lu cases passed\n", cRun - cFailed, cRun);
+  return cFailed ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The test cases ProviderTests runs, and what they share.  Each case returns true if it
+// passed; TEST_CHECK reports the first thing that went wrong and fails the case.
+//
+// The cases for the platform-neutral files use nothing but the standard library and
+// Platform.h.  Those for the helpers and the provider DLL use the Win32 API, which off
+// Windows the CMake build takes from the Win32 shims (see Win32Shims/CMakeLists.txt).
+
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include "Platform.h"
+
+#define TEST_CHECK(f)                               \
+  do                                                \
+  {                                                 \
+    if (!(f))                                       \
+    {                                               \
+      TestFail(__FILE__, __LINE__, #f);             \
+      return false;                                 \
+    }                                               \
+  } while (0)
+
+// Prints where a case failed.
+void TestFail(const char* pszFile, int iLine, const char* pszExpression);
+
+// Writes cb bytes at pv to a file named pszName in the current directory, replacing it,
+// and returns its path in *pPath.
+bool TestWriteFile(const char* pszName, const void* pv, size_t cb, std::wstring* pPath);
+
+// A path in the current directory for a file that does not exist.
+std::wstring TestMissingPath(const char* pszName);
+
+// Platform.h, through PlatformPosix.cpp or PlatformWin32.cpp.
+bool PlatformReadTest();
+bool PlatformAesGcmTest();
+#ifndef _WIN32
+bool PlatformProtectKeyTest();
+#endif
+bool PlatformProtectMemoryTest();
+bool PlatformSha256Test();
+bool PlatformUpcaseTest();
+
+// CredentialStore.h.
+bool CredentialStoreParseEncodingsTest();
+bool CredentialStoreParseLinesTest();
+bool CredentialStoreLoadTest();
+bool CredentialStoreShardsTest();
+
+// SealedStore.h.
+bool SealedStoreLookupTest();
+bool SealedStoreTamperTest();
+
+// HostRules.h, with CredentialTool's RulesCompiler.h.
+bool HostRulesMatchTest();
+bool HostRulesSealedTest();
+bool HostRulesScaleTest();
+
+// AccountRecord.h.
+bool AccountRecordLayoutTest();
+bool AccountRecordFootprintTest();
+
+// AccountName.h.
+bool AccountNameFormsTest();
+bool AccountNameTableTest();
+
+// AccountSnapshot.h.
+bool AccountSnapshotHoldTest();
+bool AccountSnapshotConcurrentTest();
+
+// StatusQueue.h.
+bool StatusQueueCoalesceTest();
+bool StatusQueueDeliveryTest();
+
+// SharedAccountCache.h.
+bool SharedAccountCacheRoundTripTest();
+#ifndef _WIN32
+bool SharedAccountCacheSessionsTest();
+#endif
+
+// LogonAttempt.h.
+bool LogonAttemptReplayTest();
+bool LogonAttemptWindowTest();
+
+// FlightRecorder.h.
+bool FlightRecorderRingTest();
+#ifndef _WIN32
+bool FlightRecorderKillTest();
+#endif
+
+// FieldStringBuffer.h.
+bool FieldStringBufferGrowthTest();
+bool FieldStringBufferKeystrokesTest();
+
+// Trace.h.
+bool TraceExportTest();
+
+// Histogram.h.
+bool HistogramPercentileTest();
+bool HistogramRecordTest();
+bool HistogramFileTest();
+
+// AuditLog.h.
+bool AuditLogRecordTest();
+bool AuditLogConcurrentTest();
+
+// AllocTrack.h.
+bool AllocTrackBudgetTest();
+
+// ThreadPool.h.
+bool ThreadPoolCancelTest();
+bool ThreadPoolStressTest();
+bool ThreadPoolLatencyTest();
+
+// CredentialTool's ProvisionEncoder.h.
+bool ProvisionEntryTest();
+bool ProvisionScaleTest();
+
+// MessageCatalog.h, with CredentialTool's MessageCompiler.h.
+bool MessageCatalogCompilerTest();
+bool MessageCatalogLookupTest();
+bool MessageCatalogCorruptTest();
+bool MessageCatalogBenchTest();
+
+// TileSchema.h.
+bool TileSchemaStringsTest();
+bool TileSchemaTablesTest();
+
+// ReportResultMessage.h, with the shipped message catalog.
+bool ReportResultMessageShippedTest();
+
+// Dll.cpp, through AutoLoginCredentialProvider.dll.
+bool ClassFactoryRefsTest();
+bool ClassFactoryAcquireTest();
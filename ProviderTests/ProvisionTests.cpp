@@ -0,0 +1,267 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// CredentialTool's ProvisionEncoder.h: a manifest line becomes the record its store holds,
+// with the machine's line first in shards and sealed stores, and a sealed record opens
+// only under its key and machine.  Lines that could never be looked up or would split
+// their record are refused, and leave nothing of their password behind.  A million
+// entries, encoded on several threads the way provision does, are timed.
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+#include "TestStores.h"
+#include "ProvisionEncoder.h"
+#include "CredentialStore.h"
+
+#define SCALE_ENTRIES 1000000
+#define SCALE_THREADS 4
+#define SCALE_CHUNK_SIZE 64             // as PROVISION_CHUNK_SIZE
+#define SCALE_SHARDS 64
+
+// Seals with CTestKeyProvider's key, the way CredentialTool's sealer does with one from
+// new-key.  Nonces count up from the sealer's own starting point, so that sealers on
+// different threads never repeat one another's.
+class CTestProvisionSealer : public IProvisionSealer
+{
+public:
+  CTestProvisionSealer(unsigned long ulNonceHigh) :
+    _ulNonceHigh(ulNonceHigh),
+    _ulNonce(0),
+    _fFail(false)
+  {
+  }
+
+  const unsigned char* KeyId()
+  {
+    return _keys.KeyId();
+  }
+
+  bool Seal(const unsigned char* pbAad, const unsigned char* pb, size_t cb, unsigned char* pbSealed)
+  {
+    _ulNonce++;
+    memset(pbSealed, 0, SEALED_STORE_NONCE_SIZE);
+    for (int i = 0; i < 4; i++)
+    {
+      pbSealed[i] = (unsigned char)(_ulNonce >> (8 * i));
+      pbSealed[4 + i] = (unsigned char)(_ulNonceHigh >> (8 * i));
+    }
+    return !_fFail && PR_OK == PlatformAesGcmEncrypt(_keys.Key(), SEALED_STORE_KEY_SIZE, pbSealed, SEALED_STORE_NONCE_SIZE,
+      pbAad, SEALED_STORE_AAD_SIZE, pb, cb, pbSealed + SEALED_STORE_NONCE_SIZE,
+      pbSealed + SEALED_STORE_NONCE_SIZE + cb, SEALED_STORE_TAG_SIZE);
+  }
+
+  const CTestKeyProvider& Keys() const { return _keys; }
+  void SetFail(bool fFail) { _fFail = fFail; }
+
+private:
+  CTestKeyProvider _keys;
+  unsigned long _ulNonceHigh;
+  unsigned long _ulNonce;
+  bool _fFail;
+};
+
+static bool _Encode(const char* pszLine, unsigned long cShards, IProvisionSealer* pSealer, PROVISION_ENTRY* pEntry)
+{
+  pEntry->line = pszLine;
+  return ProvisionEncodeEntry(cShards, pSealer, pEntry);
+}
+
+// Whether the line is refused as bad, leaving no record.
+static bool _Refused(const char* pszLine, PROVISION_ENTRY* pEntry)
+{
+  TEST_CHECK(!_Encode(pszLine, 0, NULL, pEntry));
+  TEST_CHECK(pEntry->pwzError && PR_BAD_DATA == pEntry->prError && pEntry->record.empty());
+  return true;
+}
+
+static bool _HashIs(const PROVISION_ENTRY& entry)
+{
+  unsigned char rgbHash[PLATFORM_SHA256_SIZE];
+  TEST_CHECK(PR_OK == PlatformSha256(entry.record.data(), entry.record.size(), rgbHash));
+  TEST_CHECK(0 == memcmp(rgbHash, entry.rgbHash, sizeof(rgbHash)));
+  return true;
+}
+
+bool ProvisionEntryTest()
+{
+  PROVISION_ENTRY entry;
+  ProvisionReserveEntry(&entry);
+
+  // A store of its own holds just the account; the password is the rest of the line.
+  TEST_CHECK(_Encode("kiosk-7\tCONTOSO\talice\tcorrect\thorse", 0, NULL, &entry));
+  TEST_CHECK(!entry.pwzError && PR_OK == entry.prError);
+  TEST_CHECK("CONTOSO\r\nalice\r\ncorrect\thorse\r\n" == entry.record && _HashIs(entry));
+  TEST_CHECK(0 == wcscmp(L"kiosk-7", entry.wszMachine) && 7 == entry.cchMachine && 0 == entry.iShard);
+  TEST_CHECK(CredentialStoreMachineHash(L"KIOSK-7", 7) == entry.ulMachineHash);
+
+  // In a shard, the machine's line comes first, and the shard is the one the provider
+  // looks in.  An empty domain or password is still a line.
+  TEST_CHECK(_Encode("kiosk-7\t\talice\t", SCALE_SHARDS, NULL, &entry));
+  TEST_CHECK("kiosk-7\r\n\r\nalice\r\n\r\n" == entry.record && _HashIs(entry));
+  TEST_CHECK(CredentialStoreShardOf(L"KIOSK-7", 7, SCALE_SHARDS) == entry.iShard);
+
+  // Sealed, the record opens under the key, for that machine only, and the hash is of what
+  // was sealed.
+  CTestProvisionSealer sealer(1);
+  TEST_CHECK(_Encode("kiosk-7\tCONTOSO\talice\tsecret", 0, &sealer, &entry));
+  const std::string strPlaintext = "kiosk-7\r\nCONTOSO\r\nalice\r\nsecret\r\n";
+  TEST_CHECK(SEALED_STORE_NONCE_SIZE + strPlaintext.size() + SEALED_STORE_TAG_SIZE == entry.record.size() && _HashIs(entry));
+  const unsigned char* pbSealed = reinterpret_cast<const unsigned char*>(entry.record.data());
+  std::vector<unsigned char> rgbOpened(strPlaintext.size());
+  unsigned char rgbAad[SEALED_STORE_AAD_SIZE];
+  SealedStoreRecordAad(sealer.KeyId(), entry.ulMachineHash, rgbAad);
+  TEST_CHECK(PR_OK == PlatformAesGcmDecrypt(sealer.Keys().Key(), SEALED_STORE_KEY_SIZE, pbSealed, SEALED_STORE_NONCE_SIZE,
+    rgbAad, sizeof(rgbAad), pbSealed + SEALED_STORE_NONCE_SIZE, strPlaintext.size(),
+    pbSealed + SEALED_STORE_NONCE_SIZE + strPlaintext.size(), SEALED_STORE_TAG_SIZE, &rgbOpened[0]));
+  TEST_CHECK(0 == memcmp(strPlaintext.data(), &rgbOpened[0], strPlaintext.size()));
+  SealedStoreRecordAad(sealer.KeyId(), entry.ulMachineHash + 1, rgbAad);
+  TEST_CHECK(PR_BAD_DATA == PlatformAesGcmDecrypt(sealer.Keys().Key(), SEALED_STORE_KEY_SIZE, pbSealed, SEALED_STORE_NONCE_SIZE,
+    rgbAad, sizeof(rgbAad), pbSealed + SEALED_STORE_NONCE_SIZE, strPlaintext.size(),
+    pbSealed + SEALED_STORE_NONCE_SIZE + strPlaintext.size(), SEALED_STORE_TAG_SIZE, &rgbOpened[0]));
+
+  // A record that can't be sealed is the platform's failure, not the line's, and nothing
+  // of it is kept.
+  sealer.SetFail(true);
+  TEST_CHECK(!_Encode("kiosk-7\tCONTOSO\talice\tsecret", 0, &sealer, &entry));
+  TEST_CHECK(entry.pwzError && PR_IO_ERROR == entry.prError && std::string::npos == entry.record.find("secret"));
+
+  // Machine names are counted in UTF-16, as NetBIOS names are: fifteen characters fit, a
+  // character outside the BMP counts twice, and sixteen never would be looked up.
+  TEST_CHECK(_Encode("KIOSK-ABCDEFGHI\tCONTOSO\talice\tpw", 0, NULL, &entry) && 15 == entry.cchMachine);
+  TEST_CHECK(_Encode("KIOSK-ABCDEFG\xF0\x9F\x98\x80\tCONTOSO\talice\tpw", 0, NULL, &entry) && 15 == entry.cchMachine);
+  TEST_CHECK(0xD83D == entry.wszMachine[13] && 0xDE00 == entry.wszMachine[14]);
+  TEST_CHECK(_Encode("K\xC3\x9CSK-1\tCONTOSO\t\xC3\xBC\x62\x65r\tpw", 0, NULL, &entry) && 0x00DC == entry.wszMachine[1]);
+  TEST_CHECK(_Refused("KIOSK-ABCDEFGHIJ\tCONTOSO\talice\tpw", &entry));
+  TEST_CHECK(_Refused("KIOSK-ABCDEFGH\xF0\x9F\x98\x80\tCONTOSO\talice\tpw", &entry));
+
+  // Lines that aren't four fields, would split their record, have no machine or user, or
+  // name a machine no computer could have.
+  TEST_CHECK(_Refused("kiosk-7\tCONTOSO\talice", &entry));
+  TEST_CHECK(_Refused("kiosk-7\tCONTOSO\talice\tpass\rword", &entry));
+  TEST_CHECK(_Refused("\tCONTOSO\talice\tpw", &entry));
+  TEST_CHECK(_Refused("kiosk-7\tCONTOSO\t\tpw", &entry));
+  TEST_CHECK(_Refused("kiosk 7\tCONTOSO\talice\tpw", &entry));
+  TEST_CHECK(_Refused("kiosk\\7\tCONTOSO\talice\tpw", &entry));
+
+  // Nor anything that isn't UTF-8: a stray continuation byte, an overlong form, a
+  // surrogate, a code point past U+10FFFF and a character cut short.
+  TEST_CHECK(_Refused("kiosk-7\tCONTOSO\talice\tp\x80w", &entry));
+  TEST_CHECK(_Refused("kiosk-7\tCONTOSO\t\xC0\xAF\tpw", &entry));
+  TEST_CHECK(_Refused("kiosk-7\t\xED\xA0\x80\talice\tpw", &entry));
+  TEST_CHECK(_Refused("kiosk-\xF4\x90\x80\x80\tCONTOSO\talice\tpw", &entry));
+  TEST_CHECK(_Refused("kiosk-7\tCONTOSO\talice\tpw\xE2\x82", &entry));
+
+  ProvisionWipe(&entry.line);
+  ProvisionWipe(&entry.record);
+  return true;
+}
+
+// Encodes every line of the manifest on SCALE_THREADS threads, each taking SCALE_CHUNK_SIZE
+// lines at a time from a shared counter and sealing with a sealer of its own if fSealed, and
+// counts the records that went to each shard.  Returns the nanoseconds that took, or 0 if
+// any line was refused.
+static unsigned long long _EncodeAll(const std::string& strManifest, const std::vector<size_t>& rgichLines, bool fSealed,
+  std::vector<unsigned long>* prgcByShard)
+{
+  std::atomic<size_t> iNextChunk(0);
+  std::vector<std::vector<unsigned long> > rgrgcByShard(SCALE_THREADS, std::vector<unsigned long>(SCALE_SHARDS));
+  std::vector<unsigned long> rgcRefused(SCALE_THREADS);
+  std::vector<std::thread> rgThreads;
+  size_t cLines = rgichLines.size() - 1;
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (int i = 0; i < SCALE_THREADS; i++)
+  {
+    rgThreads.push_back(std::thread([&, i]()
+    {
+      CTestProvisionSealer sealer((unsigned long)i);
+      PROVISION_ENTRY entry;
+      ProvisionReserveEntry(&entry);
+      for (;;)
+      {
+        size_t iFirst = (iNextChunk++) * SCALE_CHUNK_SIZE;
+        if (iFirst >= cLines)
+        {
+          break;
+        }
+        for (size_t iLine = iFirst; iLine < iFirst + SCALE_CHUNK_SIZE && iLine < cLines; iLine++)
+        {
+          entry.line.assign(strManifest, rgichLines[iLine], rgichLines[iLine + 1] - 1 - rgichLines[iLine]);
+          if (ProvisionEncodeEntry(SCALE_SHARDS, fSealed ? &sealer : NULL, &entry))
+          {
+            rgrgcByShard[i][entry.iShard]++;
+          }
+          else
+          {
+            rgcRefused[i]++;
+          }
+        }
+      }
+      ProvisionWipe(&entry.line);
+      ProvisionWipe(&entry.record);
+    }));
+  }
+  for (size_t i = 0; i < rgThreads.size(); i++)
+  {
+    rgThreads[i].join();
+  }
+  unsigned long long ullNs = PlatformMonotonicNanoseconds() - ullStart;
+
+  prgcByShard->assign(SCALE_SHARDS, 0);
+  for (int i = 0; i < SCALE_THREADS; i++)
+  {
+    if (rgcRefused[i])
+    {
+      return 0;
+    }
+    for (int j = 0; j < SCALE_SHARDS; j++)
+    {
+      (*prgcByShard)[j] += rgrgcByShard[i][j];
+    }
+  }
+  return ullNs;
+}
+
+bool ProvisionScaleTest()
+{
+  // A manifest of SCALE_ENTRIES machines, as a fleet's would look.
+  std::string strManifest;
+  std::vector<size_t> rgichLines;
+  strManifest.reserve((size_t)SCALE_ENTRIES * 48);
+  for (unsigned long i = 0; i < SCALE_ENTRIES; i++)
+  {
+    rgichLines.push_back(strManifest.size());
+    std::string strIndex = std::to_string(i);
+    strManifest += "SITE" + std::to_string(i / 1000) + "-K" + strIndex + "\tCONTOSO\tkiosk" + strIndex + "\tpw-" + strIndex + "-x7Q!\n";
+  }
+  rgichLines.push_back(strManifest.size());
+
+  // Every entry is encoded, plaintext and sealed, into the shards the provider will look
+  // them up in, spread evenly enough.
+  std::vector<unsigned long> rgcByShard;
+  unsigned long long ullPlaintextNs = _EncodeAll(strManifest, rgichLines, false, &rgcByShard);
+  TEST_CHECK(ullPlaintextNs);
+  unsigned long long ullSealedNs = _EncodeAll(strManifest, rgichLines, true, &rgcByShard);
+  TEST_CHECK(ullSealedNs);
+  unsigned long cTotal = 0;
+  for (int i = 0; i < SCALE_SHARDS; i++)
+  {
+    TEST_CHECK(rgcByShard[i] > SCALE_ENTRIES / SCALE_SHARDS * 9 / 10 && rgcByShard[i] < SCALE_ENTRIES / SCALE_SHARDS * 11 / 10);
+    cTotal += rgcByShard[i];
+  }
+  TEST_CHECK(SCALE_ENTRIES == cTotal);
+
+  printf("  %d entries on %d threads: plaintext in %.1f ms, %.0f entries/s; sealed in %.1f ms, %.0f entries/s\n",
+    SCALE_ENTRIES, SCALE_THREADS, ullPlaintextNs / 1e6, SCALE_ENTRIES * 1e9 / ullPlaintextNs,
+    ullSealedNs / 1e6, SCALE_ENTRIES * 1e9 / ullSealedNs);
+  return true;
+}
@@ -0,0 +1,129 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// ReportResultMessage.h, with the catalog the build compiles from messages.txt copied next
+// to ProviderTests: every failure ReportResult has a message for has one in each shipped
+// language, with the icon it had, languages without messages of their own get English,
+// and handing the message to LogonUI is the one allocation ReportResult's budget allows.
+
+#ifndef WIN32_NO_STATUS
+#include <ntstatus.h>
+#define WIN32_NO_STATUS
+#endif
+#include <windows.h>
+#include <wchar.h>
+#include "ProviderTests.h"
+#include "ReportResultMessage.h"
+
+struct REPORT_RESULT_CASE
+{
+  NTSTATUS ntsStatus;
+  NTSTATUS ntsSubstatus;
+  CREDENTIAL_PROVIDER_STATUS_ICON cpsi;
+};
+
+static const REPORT_RESULT_CASE s_rgCases[] =
+{
+  { STATUS_LOGON_FAILURE, STATUS_SUCCESS, CPSI_ERROR },
+  { STATUS_LOGON_FAILURE, STATUS_WRONG_PASSWORD, CPSI_ERROR },
+  { STATUS_LOGON_FAILURE, STATUS_NO_SUCH_USER, CPSI_ERROR },
+  { STATUS_ACCOUNT_RESTRICTION, STATUS_ACCOUNT_DISABLED, CPSI_WARNING },
+  { STATUS_ACCOUNT_RESTRICTION, STATUS_ACCOUNT_EXPIRED, CPSI_WARNING },
+  { STATUS_ACCOUNT_RESTRICTION, STATUS_PASSWORD_EXPIRED, CPSI_WARNING },
+  { STATUS_ACCOUNT_RESTRICTION, STATUS_INVALID_LOGON_HOURS, CPSI_WARNING },
+  { STATUS_ACCOUNT_RESTRICTION, STATUS_INVALID_WORKSTATION, CPSI_WARNING },
+  { STATUS_ACCOUNT_DISABLED, STATUS_WRONG_PASSWORD, CPSI_WARNING },
+  { STATUS_ACCOUNT_EXPIRED, STATUS_SUCCESS, CPSI_WARNING },
+  { STATUS_ACCOUNT_LOCKED_OUT, STATUS_SUCCESS, CPSI_WARNING },
+  { STATUS_PASSWORD_EXPIRED, STATUS_SUCCESS, CPSI_WARNING },
+  { STATUS_PASSWORD_MUST_CHANGE, STATUS_SUCCESS, CPSI_WARNING },
+  { STATUS_INVALID_LOGON_HOURS, STATUS_SUCCESS, CPSI_WARNING },
+  { STATUS_INVALID_WORKSTATION, STATUS_SUCCESS, CPSI_WARNING },
+  { STATUS_LOGON_TYPE_NOT_GRANTED, STATUS_SUCCESS, CPSI_WARNING },
+  { STATUS_NO_LOGON_SERVERS, STATUS_SUCCESS, CPSI_ERROR },
+  { STATUS_TRUSTED_RELATIONSHIP_FAILURE, STATUS_SUCCESS, CPSI_ERROR },
+  { STATUS_TIME_DIFFERENCE_AT_DC, STATUS_SUCCESS, CPSI_ERROR },
+};
+
+// Loads a message the way ReportResult does, counting what it allocates.
+static HRESULT _Load(
+  const MESSAGE_CATALOG* pCatalog,
+  LANGID langid,
+  NTSTATUS ntsStatus,
+  NTSTATUS ntsSubstatus,
+  std::wstring* pMessage,
+  CREDENTIAL_PROVIDER_STATUS_ICON* pcpsi,
+  unsigned long* pcAllocs
+)
+{
+  PWSTR pwzMessage;
+  HRESULT hr;
+  {
+    CAllocScope scope("ReportResultMessageLoad", ALLOC_BUDGET_UNLIMITED, ALLOC_BUDGET_UNLIMITED);
+    hr = ReportResultMessageLoad(pCatalog, langid, ntsStatus, ntsSubstatus, &pwzMessage, pcpsi);
+    *pcAllocs = scope.GetAllocs();
+  }
+  pMessage->assign(pwzMessage ? pwzMessage : L"");
+  CoTaskMemFree(pwzMessage);
+  return hr;
+}
+
+bool ReportResultMessageShippedTest()
+{
+  const MESSAGE_CATALOG* pCatalog = ReportResultMessageCatalog(NULL);
+  TEST_CHECK(pCatalog);
+  TEST_CHECK(pCatalog == ReportResultMessageCatalog(NULL));
+
+  static const LANGID s_rgLangIds[] =
+  {
+    MAKELANGID(LANG_ENGLISH, SUBLANG_ENGLISH_US),
+    MAKELANGID(LANG_GERMAN, SUBLANG_GERMAN),
+    MAKELANGID(LANG_FRENCH, SUBLANG_FRENCH),
+    MAKELANGID(LANG_SPANISH, SUBLANG_SPANISH_MODERN),
+  };
+  std::wstring rgEnglish[ARRAYSIZE(s_rgCases)];
+  for (size_t iLang = 0; iLang < ARRAYSIZE(s_rgLangIds); iLang++)
+  {
+    for (size_t i = 0; i < ARRAYSIZE(s_rgCases); i++)
+    {
+      std::wstring message;
+      CREDENTIAL_PROVIDER_STATUS_ICON cpsi;
+      unsigned long cAllocs;
+      TEST_CHECK(S_OK == _Load(pCatalog, s_rgLangIds[iLang], s_rgCases[i].ntsStatus, s_rgCases[i].ntsSubstatus, &message, &cpsi, &cAllocs));
+      TEST_CHECK(!message.empty() && s_rgCases[i].cpsi == cpsi && 1 == cAllocs);
+      if (0 == iLang)
+      {
+        rgEnglish[i] = message;
+      }
+      else
+      {
+        TEST_CHECK(message != rgEnglish[i]);
+      }
+    }
+  }
+  TEST_CHECK(rgEnglish[0] == L"Incorrect password or username.");
+  TEST_CHECK(rgEnglish[ARRAYSIZE(s_rgCases) - 1] == L"The clock on this computer differs too much from the domain controller.");
+
+  // Swiss German finds German through LANG_GERMAN; Japanese has no messages and gets the
+  // default, English.
+  std::wstring message;
+  CREDENTIAL_PROVIDER_STATUS_ICON cpsi;
+  unsigned long cAllocs;
+  TEST_CHECK(S_OK == _Load(pCatalog, MAKELANGID(LANG_GERMAN, 0x02), STATUS_ACCOUNT_LOCKED_OUT, STATUS_SUCCESS, &message, &cpsi, &cAllocs));
+  TEST_CHECK(message == L"Das Konto ist gesperrt." && CPSI_WARNING == cpsi);
+  TEST_CHECK(S_OK == _Load(pCatalog, MAKELANGID(0x11, 0x01), STATUS_ACCOUNT_LOCKED_OUT, STATUS_SUCCESS, &message, &cpsi, &cAllocs));
+  TEST_CHECK(message == L"The account is locked out.");
+
+  // No message, and no catalog: nothing is allocated.
+  TEST_CHECK(S_FALSE == _Load(pCatalog, s_rgLangIds[0], STATUS_ACCESS_DENIED, STATUS_SUCCESS, &message, &cpsi, &cAllocs));
+  TEST_CHECK(message.empty() && CPSI_NONE == cpsi && 0 == cAllocs);
+  TEST_CHECK(S_FALSE == _Load(pCatalog, s_rgLangIds[0], STATUS_ACCOUNT_RESTRICTION, STATUS_SUCCESS, &message, &cpsi, &cAllocs));
+  TEST_CHECK(S_FALSE == _Load(NULL, s_rgLangIds[0], STATUS_LOGON_FAILURE, STATUS_SUCCESS, &message, &cpsi, &cAllocs));
+  TEST_CHECK(message.empty() && CPSI_NONE == cpsi && 0 == cAllocs);
+  return true;
+}
@@ -0,0 +1,201 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// SealedStore.h: a machine finds its own record by binary search, walking past records whose
+// machines share its hash, and decrypts nothing else.  A record that was changed, or moved
+// under another machine's index entry, fails authentication, and so does the whole store if
+// its header is wrong.
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "ProviderTests.h"
+#include "TestStores.h"
+
+#define SEALED_STORE_FILE "sealed-store.sealed"
+#define FLEET_RECORDS 1000
+#define SMALL_RECORDS 10
+
+// Three machines whose names have the same CredentialStoreMachineHash, 0xDC7B1F5A.
+static const char* const s_rgpszColliding[] = { "KIOSK-3233600", "KIOSK-4828584", "KIOSK-5912888" };
+
+// The records for machines KIOSK-0 to KIOSK-(cRecords-1), each with its own password.
+// rgstr holds the strings the records point to.
+static std::vector<TEST_RECORD> _FleetRecords(size_t cRecords, std::vector<std::string>* prgstr)
+{
+  prgstr->resize(2 * cRecords);
+  std::vector<TEST_RECORD> rgRecords;
+  for (size_t i = 0; i < cRecords; i++)
+  {
+    (*prgstr)[2 * i] = "KIOSK-" + std::to_string(i);
+    (*prgstr)[2 * i + 1] = "password" + std::to_string(i);
+    TEST_RECORD record = { (*prgstr)[2 * i].c_str(), "CONTOSO", "kiosk", (*prgstr)[2 * i + 1].c_str() };
+    rgRecords.push_back(record);
+  }
+  return rgRecords;
+}
+
+static CREDENTIAL_STORE_RESULT _Load(const std::wstring& wstrPath, const char* pszMachine, UserCredentials* puc)
+{
+  CTestKeyProvider keys;
+  std::wstring wstrMachine = TestWide(pszMachine);
+  return SealedStoreLoad(wstrPath.c_str(), &keys, wstrMachine.c_str(), wstrMachine.size(), puc);
+}
+
+// How long, on average, each machine of the store takes to load its own record.
+static bool _TimeLoads(const std::wstring& wstrPath, const std::vector<TEST_RECORD>& rgRecords, double* pdUs)
+{
+  UserCredentials uc;
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  for (size_t i = 0; i < rgRecords.size(); i++)
+  {
+    TEST_CHECK(CSR_OK == _Load(wstrPath, rgRecords[i].pszMachine, &uc));
+  }
+  *pdUs = (PlatformMonotonicNanoseconds() - ullStart) / 1e3 / rgRecords.size();
+  return true;
+}
+
+bool SealedStoreLookupTest()
+{
+  // A fleet's store, with two machines whose hashes collide added at the end.
+  for (size_t i = 1; i < sizeof(s_rgpszColliding) / sizeof(s_rgpszColliding[0]); i++)
+  {
+    TEST_CHECK(CredentialStoreMachineHash(TestWide(s_rgpszColliding[0]).c_str(), strlen(s_rgpszColliding[0])) ==
+      CredentialStoreMachineHash(TestWide(s_rgpszColliding[i]).c_str(), strlen(s_rgpszColliding[i])));
+  }
+  std::vector<std::string> rgstr;
+  std::vector<TEST_RECORD> rgRecords = _FleetRecords(FLEET_RECORDS, &rgstr);
+  TEST_RECORD recordFirst = { s_rgpszColliding[0], "FABRIKAM", "first", "first password" };
+  TEST_RECORD recordSecond = { s_rgpszColliding[1], "FABRIKAM", "second", "second password" };
+  rgRecords.push_back(recordFirst);
+  rgRecords.push_back(recordSecond);
+  std::wstring wstrPath;
+  TEST_CHECK(TestWriteSealedStore(SEALED_STORE_FILE, CTestKeyProvider(), &rgRecords[0], rgRecords.size(), &wstrPath));
+
+  // Every machine finds its own record, whatever the case of its name, after asking for the
+  // key once.
+  UserCredentials uc;
+  for (size_t i = 0; i < FLEET_RECORDS; i++)
+  {
+    TEST_CHECK(CSR_OK == _Load(wstrPath, rgRecords[i].pszMachine, &uc));
+    TEST_CHECK(uc.domain == L"CONTOSO" && uc.password == TestWide(rgRecords[i].pszPassword));
+  }
+  CTestKeyProvider keys;
+  TEST_CHECK(CSR_OK == SealedStoreLoad(wstrPath.c_str(), &keys, L"kiosk-7", 7, &uc) && uc.password == L"password7");
+  TEST_CHECK(1 == keys.GetKeyCount());
+  TEST_CHECK(CSR_NOT_FOUND == _Load(wstrPath, "KIOSK-1000", &uc));
+
+  // Machines that share a hash walk past each other's records to their own, and a third
+  // with the same hash walks past both to find nothing.
+  TEST_CHECK(CSR_OK == _Load(wstrPath, s_rgpszColliding[0], &uc) && uc.username == L"first" && uc.password == L"first password");
+  TEST_CHECK(CSR_OK == _Load(wstrPath, s_rgpszColliding[1], &uc) && uc.username == L"second" && uc.password == L"second password");
+  TEST_CHECK(CSR_NOT_FOUND == _Load(wstrPath, s_rgpszColliding[2], &uc));
+
+  // Logon decrypts one record however many the store holds, so a store a hundred times the
+  // size costs only the few more index entries the search reads.
+  double dFleetUs;
+  TEST_CHECK(_TimeLoads(wstrPath, rgRecords, &dFleetUs));
+  std::vector<std::string> rgstrSmall;
+  std::vector<TEST_RECORD> rgSmallRecords = _FleetRecords(SMALL_RECORDS, &rgstrSmall);
+  TEST_CHECK(TestWriteSealedStore(SEALED_STORE_FILE, CTestKeyProvider(), &rgSmallRecords[0], rgSmallRecords.size(), &wstrPath));
+  double dSmallUs;
+  TEST_CHECK(_TimeLoads(wstrPath, rgSmallRecords, &dSmallUs));
+  printf("  load from a store of %d records %.1f us, of %d records %.1f us\n",
+    (int)rgRecords.size(), dFleetUs, SMALL_RECORDS, dSmallUs);
+
+  remove(SEALED_STORE_FILE);
+  return true;
+}
+
+// Writes rgb as the store and loads pszMachine from it.
+static CREDENTIAL_STORE_RESULT _LoadBytes(const std::vector<unsigned char>& rgb, const char* pszMachine, UserCredentials* puc)
+{
+  std::wstring wstrPath;
+  if (!TestWriteFile(SEALED_STORE_FILE, &rgb[0], rgb.size(), &wstrPath))
+  {
+    return CSR_IO_ERROR;
+  }
+  return _Load(wstrPath, pszMachine, puc);
+}
+
+static unsigned long _GetU32(const unsigned char* pb)
+{
+  return pb[0] | (pb[1] << 8) | (pb[2] << 16) | ((unsigned long)pb[3] << 24);
+}
+
+bool SealedStoreTamperTest()
+{
+  std::vector<std::string> rgstr;
+  std::vector<TEST_RECORD> rgRecords = _FleetRecords(3, &rgstr);
+  std::wstring wstrPath;
+  TEST_CHECK(TestWriteSealedStore(SEALED_STORE_FILE, CTestKeyProvider(), &rgRecords[0], rgRecords.size(), &wstrPath));
+  std::vector<unsigned char> rgbStore;
+  TEST_CHECK(PR_OK == PlatformReadFile(wstrPath.c_str(), 1024 * 1024, &rgbStore));
+
+  // KIOSK-0's record is the first after the header; find its index entry, and another's.
+  const size_t ibIndex = rgbStore.size() - rgRecords.size() * SEALED_STORE_INDEX_ENTRY_SIZE;
+  size_t ibEntry = 0;
+  size_t ibOtherEntry = 0;
+  for (size_t ib = ibIndex; ib < rgbStore.size(); ib += SEALED_STORE_INDEX_ENTRY_SIZE)
+  {
+    if (SEALED_STORE_HEADER_SIZE == _GetU32(&rgbStore[ib + 8]))
+    {
+      ibEntry = ib;
+    }
+    else
+    {
+      ibOtherEntry = ib;
+    }
+  }
+  TEST_CHECK(ibEntry && ibOtherEntry);
+  const size_t cbRecord = _GetU32(&rgbStore[ibEntry + 4]);
+
+  UserCredentials uc;
+  TEST_CHECK(CSR_OK == _LoadBytes(rgbStore, "KIOSK-0", &uc) && uc.password == L"password0");
+
+  // A single bit changed in the nonce, the ciphertext or the tag, and the record fails; the
+  // other machines' records still open.
+  const size_t rgibFlip[] =
+  {
+    SEALED_STORE_HEADER_SIZE,
+    SEALED_STORE_HEADER_SIZE + SEALED_STORE_NONCE_SIZE,
+    SEALED_STORE_HEADER_SIZE + cbRecord - SEALED_STORE_TAG_SIZE - 1,
+    SEALED_STORE_HEADER_SIZE + cbRecord - 1,
+  };
+  for (size_t i = 0; i < sizeof(rgibFlip) / sizeof(rgibFlip[0]); i++)
+  {
+    std::vector<unsigned char> rgb = rgbStore;
+    rgb[rgibFlip[i]] ^= 0x01;
+    TEST_CHECK(CSR_BAD_FORMAT == _LoadBytes(rgb, "KIOSK-0", &uc));
+    TEST_CHECK(CSR_OK == _LoadBytes(rgb, "KIOSK-1", &uc) && uc.password == L"password1");
+  }
+
+  // Another machine's record put under KIOSK-0's index entry was sealed with the other hash.
+  std::vector<unsigned char> rgb = rgbStore;
+  memcpy(&rgb[ibEntry + 4], &rgbStore[ibOtherEntry + 4], SEALED_STORE_INDEX_ENTRY_SIZE - 4);
+  TEST_CHECK(CSR_BAD_FORMAT == _LoadBytes(rgb, "KIOSK-0", &uc));
+
+  // A store whose header isn't one, or whose index is cut short, fails as a whole.
+  rgb = rgbStore;
+  rgb[0] ^= 0x01;
+  TEST_CHECK(CSR_BAD_FORMAT == _LoadBytes(rgb, "KIOSK-1", &uc));
+  rgb = rgbStore;
+  rgb[4] = SEALED_STORE_VERSION + 1;
+  TEST_CHECK(CSR_BAD_FORMAT == _LoadBytes(rgb, "KIOSK-1", &uc));
+  rgb.assign(rgbStore.begin(), rgbStore.begin() + ibIndex + 1);
+  TEST_CHECK(CSR_BAD_FORMAT == _LoadBytes(rgb, "KIOSK-1", &uc));
+
+  // A key id nobody holds is the key provider's to report.
+  rgb = rgbStore;
+  rgb[8] ^= 0x01;
+  TEST_CHECK(CSR_NOT_FOUND == _LoadBytes(rgb, "KIOSK-1", &uc));
+
+  remove(SEALED_STORE_FILE);
+  return true;
+}
@@ -0,0 +1,271 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// SharedAccountCache.h: the account shared between processes, and what that saves each one.
+// The sessions case forks, so it only builds off Windows; there LogonUISimulator -sessions
+// measures the same thing through the DLL.
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "ProviderTests.h"
+#include "SharedAccountCache.h"
+#include "TestStores.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Closes this process's views and, where the segment outlives them, removes it, so the case
+// starts from an empty one.
+static void _ResetSegment()
+{
+  SharedAccountCacheShutdown();
+#ifndef _WIN32
+  std::wstring name(SHARED_ACCOUNT_SEGMENT_NAME);
+  shm_unlink(("/" + std::string(name.begin(), name.end())).c_str());
+#endif
+}
+
+static bool _SameAccount(const UserCredentials& uc1, const UserCredentials& uc2)
+{
+  return uc1.domain == uc2.domain && uc1.username == uc2.username && uc1.password == uc2.password;
+}
+
+// Whether cb bytes at pv appear anywhere in the segment.
+static bool _SegmentContains(const void* pv, size_t cb)
+{
+  PLATFORM_SHARED_SEGMENT* pSegment;
+  const void* pvRead;
+  if (PR_OK != PlatformOpenSharedSegment(SHARED_ACCOUNT_SEGMENT_NAME, SHARED_ACCOUNT_SEGMENT_SIZE, &pSegment, &pvRead))
+  {
+    return false;
+  }
+  const unsigned char* pb = static_cast<const unsigned char*>(pvRead);
+  bool fFound = false;
+  for (size_t i = 0; !fFound && i + cb <= SHARED_ACCOUNT_SEGMENT_SIZE; i++)
+  {
+    fFound = 0 == memcmp(pb + i, pv, cb);
+  }
+  PlatformCloseSharedSegment(pSegment);
+  return fFound;
+}
+
+bool SharedAccountCacheRoundTripTest()
+{
+  _ResetSegment();
+  const unsigned long long ullKey = SharedAccountKeyAdd(SHARED_ACCOUNT_KEY_EMPTY, "round-trip", 10);
+
+  UserCredentials uc;
+  unsigned long long ullVersion = 0;
+  TEST_CHECK(CSR_NOT_FOUND == SharedAccountCacheRead(ullKey, &uc, &ullVersion));
+
+  UserCredentials ucAlice;
+  ucAlice.domain = L"CONTOSO";
+  ucAlice.username = L"alice";
+  ucAlice.password = L"correct horse battery staple";
+  TEST_CHECK(CSR_OK == SharedAccountCacheWrite(ullKey, ucAlice));
+  TEST_CHECK(CSR_OK == SharedAccountCacheRead(ullKey, &uc, &ullVersion));
+  TEST_CHECK(_SameAccount(uc, ucAlice) && 1 == ullVersion);
+
+  // Published under another key, which is as good as not at all.
+  TEST_CHECK(CSR_NOT_FOUND == SharedAccountCacheRead(ullKey + 1, &uc, &ullVersion));
+
+  // The password is only ever in the segment protected.
+  TEST_CHECK(!_SegmentContains(ucAlice.password.c_str(), ucAlice.password.size() * sizeof(wchar_t)));
+  TEST_CHECK(_SegmentContains(ucAlice.username.c_str(), ucAlice.username.size() * sizeof(wchar_t)));
+
+  // The longest account there can be fits, whatever the size of wchar_t.
+  UserCredentials ucLongest;
+  ucLongest.domain.assign(CREDENTIAL_ACCOUNT_MAX_CCH, L'D');
+  ucLongest.username.assign(CREDENTIAL_ACCOUNT_MAX_CCH, L'U');
+  ucLongest.password.assign(CREDENTIAL_ACCOUNT_MAX_CCH, L'P');
+  TEST_CHECK(CSR_OK == SharedAccountCacheWrite(ullKey, ucLongest));
+  TEST_CHECK(CSR_OK == SharedAccountCacheRead(ullKey, &uc, &ullVersion));
+  TEST_CHECK(_SameAccount(uc, ucLongest) && 2 == ullVersion);
+
+  ucLongest.password += L'P';
+  TEST_CHECK(CSR_BAD_FORMAT == SharedAccountCacheWrite(ullKey, ucLongest));
+
+  _ResetSegment();
+  return true;
+}
+
+#ifndef _WIN32
+
+#define SESSION_COUNT 20
+
+// The resident set of this process, in bytes, or 0 if /proc is not there to say.
+static unsigned long long _ResidentBytes()
+{
+  unsigned long long ullPages = 0;
+  FILE* pFile = fopen("/proc/self/statm", "r");
+  if (pFile)
+  {
+    unsigned long long ullSize;
+    if (2 != fscanf(pFile, "%llu %llu", &ullSize, &ullPages))
+    {
+      ullPages = 0;
+    }
+    fclose(pFile);
+  }
+  return ullPages * (unsigned long long)sysconf(_SC_PAGESIZE);
+}
+
+// What one session's load reports back through the pipe.
+struct SESSION_SAMPLE
+{
+  unsigned long fShared;
+  unsigned long fCorrect;
+  unsigned long long ullNs;
+  unsigned long long cbResident;
+};
+
+#define SESSION_MACHINE "MACHINE-0007"
+
+// A new session's load: through the segment if fUseCache, and from the sealed store if that
+// misses or without it.
+static void _RunSession(const std::wstring& storePath, unsigned long long ullKey, bool fUseCache, const UserCredentials& ucExpected, int fdResult)
+{
+  SESSION_SAMPLE sample = {};
+  unsigned long long cbBefore = _ResidentBytes();
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+
+  UserCredentials uc;
+  CREDENTIAL_STORE_RESULT csr = CSR_NOT_FOUND;
+  if (fUseCache)
+  {
+    csr = SharedAccountCacheRead(ullKey, &uc, NULL);
+    sample.fShared = (CSR_OK == csr);
+  }
+  if (CSR_OK != csr)
+  {
+    CTestKeyProvider keys;
+    std::wstring machine = TestWide(SESSION_MACHINE);
+    csr = SealedStoreLoad(storePath.c_str(), &keys, machine.c_str(), machine.size(), &uc);
+    if (CSR_OK == csr && fUseCache)
+    {
+      SharedAccountCacheWrite(ullKey, uc);
+    }
+  }
+
+  sample.ullNs = PlatformMonotonicNanoseconds() - ullStart;
+  unsigned long long cbAfter = _ResidentBytes();
+  sample.cbResident = (cbAfter > cbBefore) ? cbAfter - cbBefore : 0;
+  sample.fCorrect = (CSR_OK == csr) && _SameAccount(uc, ucExpected);
+  ssize_t cbWritten = write(fdResult, &sample, sizeof(sample));
+  _exit((ssize_t)sizeof(sample) == cbWritten ? 0 : 1);
+}
+
+// Starts SESSION_COUNT processes one after another, as sessions reach the logon screen, and
+// collects what each reports.
+static bool _RunSessions(const std::wstring& storePath, unsigned long long ullKey, bool fUseCache, const UserCredentials& ucExpected, std::vector<SESSION_SAMPLE>* prgSamples)
+{
+  for (int i = 0; i < SESSION_COUNT; i++)
+  {
+    int rgfd[2];
+    if (0 != pipe(rgfd))
+    {
+      return false;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+      close(rgfd[0]);
+      _RunSession(storePath, ullKey, fUseCache, ucExpected, rgfd[1]);
+    }
+    close(rgfd[1]);
+
+    SESSION_SAMPLE sample;
+    bool fRead = pid > 0 && (ssize_t)sizeof(sample) == read(rgfd[0], &sample, sizeof(sample));
+    close(rgfd[0]);
+    int iStatus = 0;
+    if (pid > 0)
+    {
+      waitpid(pid, &iStatus, 0);
+    }
+    if (!fRead || !WIFEXITED(iStatus) || 0 != WEXITSTATUS(iStatus))
+    {
+      return false;
+    }
+    prgSamples->push_back(sample);
+  }
+  return true;
+}
+
+static void _PrintSessions(const char* pszHow, const std::vector<SESSION_SAMPLE>& rgSamples)
+{
+  unsigned long long ullNs = 0;
+  unsigned long long cbResident = 0;
+  unsigned long cShared = 0;
+  for (size_t i = 0; i < rgSamples.size(); i++)
+  {
+    ullNs += rgSamples[i].ullNs;
+    cbResident += rgSamples[i].cbResident;
+    cShared += rgSamples[i].fShared;
+  }
+  printf("  %-20s %8.1f us/load  %8.1f KB resident/load  %2lu of %2lu from the segment\n", pszHow,
+    ullNs / 1000.0 / rgSamples.size(), cbResident / 1024.0 / rgSamples.size(), cShared, (unsigned long)rgSamples.size());
+}
+
+bool SharedAccountCacheSessionsTest()
+{
+  // The parent must not hand its views down to the sessions.
+  _ResetSegment();
+
+  // A store for a fleet, of which this machine is one.
+  CTestKeyProvider keys;
+  std::vector<std::string> rgMachines;
+  std::vector<TEST_RECORD> rgRecords;
+  for (int i = 0; i < 64; i++)
+  {
+    char szMachine[32];
+    snprintf(szMachine, sizeof(szMachine), "MACHINE-%04d", i);
+    rgMachines.push_back(szMachine);
+  }
+  for (size_t i = 0; i < rgMachines.size(); i++)
+  {
+    TEST_RECORD record = { rgMachines[i].c_str(), "CONTOSO", "alice", "correct horse battery staple" };
+    rgRecords.push_back(record);
+  }
+  std::wstring path;
+  TEST_CHECK(TestWriteSealedStore("shared-account-store.sealed", keys, &rgRecords[0], rgRecords.size(), &path));
+  UserCredentials ucExpected;
+  ucExpected.domain = L"CONTOSO";
+  ucExpected.username = L"alice";
+  ucExpected.password = L"correct horse battery staple";
+
+  // The provider hashes the settings and the stores' sizes and times; this one only has
+  // the store's path and the machine.
+  unsigned long long ullKey = SharedAccountKeyAdd(SHARED_ACCOUNT_KEY_EMPTY, path.c_str(), path.size() * sizeof(wchar_t));
+  ullKey = SharedAccountKeyAdd(ullKey, SESSION_MACHINE, strlen(SESSION_MACHINE));
+
+  std::vector<SESSION_SAMPLE> rgWithout;
+  std::vector<SESSION_SAMPLE> rgWith;
+  TEST_CHECK(_RunSessions(path, ullKey, false, ucExpected, &rgWithout));
+  TEST_CHECK(_RunSessions(path, ullKey, true, ucExpected, &rgWith));
+  _ResetSegment();
+
+  _PrintSessions("without the segment", rgWithout);
+  _PrintSessions("through the segment", rgWith);
+
+  // Every session got the account; the first through the segment published it and all the
+  // others read it back.
+  for (size_t i = 0; i < SESSION_COUNT; i++)
+  {
+    TEST_CHECK(rgWithout[i].fCorrect && !rgWithout[i].fShared);
+    TEST_CHECK(rgWith[i].fCorrect && rgWith[i].fShared == (i > 0));
+  }
+  return true;
+}
+
+#endif
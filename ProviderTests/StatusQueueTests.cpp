@@ -0,0 +1,224 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// StatusQueue.h: status updates reach every tile, in order, once per wake-up.
+//
+// The tiles are fake sinks that check what they are handed, and the provider's window is a
+// condition variable: the producer signals it where CTileStatusChannel posts its message, and
+// the stand-in for LogonUI's thread delivers when it is signalled.
+
+#include <stdio.h>
+#include <wchar.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+#include "StatusQueue.h"
+
+#define STATUS_UPDATES 200000
+#define STATUS_UI_WORK_NS 2000      // what LogonUI does with each delivery, give or take
+
+static std::wstring _FormatUpdate(unsigned long long ullSequence)
+{
+  return L"Status update " + std::to_wstring(ullSequence);
+}
+
+// A tile, which checks every update it is handed comes after the last and carries its own
+// text.
+class CFakeTile : public IStatusSink
+{
+public:
+  CFakeTile() :
+    cDeliveries(0),
+    cFailures(0),
+    ullLastSequence(0)
+  {
+  }
+
+  void OnStatusChanged(const STATUS_UPDATE& update)
+  {
+    cDeliveries++;
+    if (update.ullSequence <= ullLastSequence || update.cch != wcslen(update.wz) ||
+      _FormatUpdate(update.ullSequence) != update.wz)
+    {
+      cFailures++;
+    }
+    ullLastSequence = update.ullSequence;
+    text = update.wz;
+  }
+
+  unsigned long long cDeliveries;
+  unsigned long long cFailures;
+  unsigned long long ullLastSequence;
+  std::wstring text;
+};
+
+static bool _Post(CStatusQueue* pQueue, unsigned long long ullSequence, bool* pfWake)
+{
+  std::wstring text = _FormatUpdate(ullSequence);
+  return pQueue->Post(text.c_str(), text.size(), pfWake);
+}
+
+bool StatusQueueCoalesceTest()
+{
+  CStatusQueue queue;
+  CStatusDelivery delivery;
+  CFakeTile tile1;
+  CFakeTile tile2;
+  TEST_CHECK(delivery.AddSink(&tile1) && delivery.AddSink(&tile2));
+  TEST_CHECK(0 == delivery.Status().cch && 0 == delivery.Deliver(&queue) && 0 == tile1.cDeliveries);
+
+  // Only the first post since the last drain wakes the consumer, and the drain hands the
+  // tiles the latest update once.
+  bool fWake;
+  TEST_CHECK(_Post(&queue, 1, &fWake) && fWake);
+  TEST_CHECK(_Post(&queue, 2, &fWake) && !fWake);
+  TEST_CHECK(_Post(&queue, 3, &fWake) && !fWake);
+  TEST_CHECK(3 == delivery.Deliver(&queue));
+  TEST_CHECK(1 == tile1.cDeliveries && 1 == tile2.cDeliveries);
+  TEST_CHECK(3 == tile1.ullLastSequence && tile2.text == L"Status update 3");
+  TEST_CHECK(3 == delivery.Status().ullSequence);
+  TEST_CHECK(0 == delivery.Deliver(&queue) && 1 == tile1.cDeliveries);
+  TEST_CHECK(_Post(&queue, 4, &fWake) && fWake);
+
+  // A full ring refuses the post, and asks for no wake-up: one is already pending.
+  for (unsigned long long i = 5; i < 4 + STATUS_QUEUE_CAPACITY; i++)
+  {
+    TEST_CHECK(_Post(&queue, i, &fWake) && !fWake);
+  }
+  TEST_CHECK(!_Post(&queue, 4 + STATUS_QUEUE_CAPACITY, &fWake) && !fWake);
+  TEST_CHECK(1 == queue.DroppedCount());
+  TEST_CHECK(STATUS_QUEUE_CAPACITY == delivery.Deliver(&queue));
+  TEST_CHECK(3 + STATUS_QUEUE_CAPACITY == tile1.ullLastSequence);
+
+  // A tile that has gone is handed nothing more.
+  delivery.RemoveSink(&tile1);
+  TEST_CHECK(_Post(&queue, 4 + STATUS_QUEUE_CAPACITY, &fWake) && fWake);
+  TEST_CHECK(1 == delivery.Deliver(&queue));
+  TEST_CHECK(2 == tile1.cDeliveries && 3 == tile2.cDeliveries);
+  TEST_CHECK(0 == tile1.cFailures && 0 == tile2.cFailures);
+
+  // Text past STATUS_TEXT_MAX_CCH is cut.
+  std::wstring longText(STATUS_TEXT_MAX_CCH + 10, L'x');
+  TEST_CHECK(queue.Post(longText.c_str(), longText.size(), &fWake) && fWake);
+  TEST_CHECK(1 == delivery.Deliver(&queue));
+  TEST_CHECK(STATUS_TEXT_MAX_CCH == delivery.Status().cch && STATUS_TEXT_MAX_CCH == wcslen(delivery.Status().wz));
+
+  CFakeTile rgTiles[STATUS_MAX_SINKS];
+  CStatusDelivery full;
+  for (size_t i = 0; i < STATUS_MAX_SINKS; i++)
+  {
+    TEST_CHECK(full.AddSink(&rgTiles[i]));
+  }
+  TEST_CHECK(!full.AddSink(&tile1));
+  return true;
+}
+
+// The provider's window: set by the producer, waited on by the stand-in for LogonUI's thread.
+struct STATUS_WAKE
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool fSignalled;
+  bool fProducerDone;
+};
+
+static void _Signal(STATUS_WAKE* pWake, bool fDone)
+{
+  std::lock_guard<std::mutex> lock(pWake->mutex);
+  pWake->fSignalled = true;
+  pWake->fProducerDone = pWake->fProducerDone || fDone;
+  pWake->cv.notify_one();
+}
+
+static void _ProducerThread(CStatusQueue* pQueue, STATUS_WAKE* pWake, unsigned long long* pcPosted, unsigned long long* pcWakes)
+{
+  for (unsigned long long i = 0; i < STATUS_UPDATES; i++)
+  {
+    // The queue numbers only the updates it accepts, so the text does too.
+    bool fWake;
+    if (_Post(pQueue, *pcPosted + 1, &fWake))
+    {
+      ++*pcPosted;
+      if (fWake)
+      {
+        ++*pcWakes;
+        _Signal(pWake, false);
+      }
+    }
+  }
+  _Signal(pWake, true);
+}
+
+bool StatusQueueDeliveryTest()
+{
+  CStatusQueue queue;
+  CStatusDelivery delivery;
+  CFakeTile tile1;
+  CFakeTile tile2;
+  TEST_CHECK(delivery.AddSink(&tile1) && delivery.AddSink(&tile2));
+
+  STATUS_WAKE wake;
+  wake.fSignalled = false;
+  wake.fProducerDone = false;
+  unsigned long long cPosted = 0;
+  unsigned long long cWakes = 0;
+  std::thread producer(_ProducerThread, &queue, &wake, &cPosted, &cWakes);
+
+  unsigned long long cTaken = 0;
+  std::vector<unsigned long long> rgullLatencyNs;
+  for (;;)
+  {
+    bool fDone;
+    {
+      std::unique_lock<std::mutex> lock(wake.mutex);
+      wake.cv.wait(lock, [&wake] { return wake.fSignalled; });
+      wake.fSignalled = false;
+      fDone = wake.fProducerDone;
+    }
+
+    unsigned long cDelivered = delivery.Deliver(&queue);
+    if (cDelivered)
+    {
+      rgullLatencyNs.push_back(PlatformMonotonicNanoseconds() - delivery.Status().ullPostedNs);
+      cTaken += cDelivered;
+
+      unsigned long long ullStart = PlatformMonotonicNanoseconds();
+      while (PlatformMonotonicNanoseconds() - ullStart < STATUS_UI_WORK_NS)
+      {
+      }
+    }
+
+    // Seen done before the drain, so the drain took the producer's last update.
+    if (fDone)
+    {
+      break;
+    }
+  }
+  producer.join();
+
+  std::sort(rgullLatencyNs.begin(), rgullLatencyNs.end());
+  TEST_CHECK(!rgullLatencyNs.empty());
+  printf("  %llu posted, %llu refused, %llu wake-ups, %llu deliveries (%.1f updates each)\n",
+    cPosted, queue.DroppedCount(), cWakes, tile1.cDeliveries, (double)cTaken / tile1.cDeliveries);
+  printf("  delivery latency: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+    rgullLatencyNs[rgullLatencyNs.size() / 2] / 1000.0, rgullLatencyNs[rgullLatencyNs.size() * 99 / 100] / 1000.0,
+    rgullLatencyNs.back() / 1000.0);
+
+  // Every update was taken, the last reached both tiles, and nothing arrived out of order or
+  // with another update's text.  Each wake-up delivered at most once.
+  TEST_CHECK(cPosted + queue.DroppedCount() == STATUS_UPDATES);
+  TEST_CHECK(cTaken == cPosted);
+  TEST_CHECK(tile1.ullLastSequence == cPosted && tile2.ullLastSequence == cPosted);
+  TEST_CHECK(0 == tile1.cFailures && 0 == tile2.cFailures);
+  TEST_CHECK(tile1.cDeliveries == tile2.cDeliveries && tile1.cDeliveries <= cWakes);
+  return true;
+}
@@ -0,0 +1,117 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "ProviderTests.h"
+#include "TestStores.h"
+
+CTestKeyProvider::CTestKeyProvider() :
+  _cGetKey(0)
+{
+  for (size_t i = 0; i < sizeof(_rgbKeyId); i++)
+  {
+    _rgbKeyId[i] = (unsigned char)(0xA0 + i);
+  }
+  for (size_t i = 0; i < sizeof(_rgbKey); i++)
+  {
+    _rgbKey[i] = (unsigned char)(i * 13 + 5);
+  }
+}
+
+CREDENTIAL_STORE_RESULT CTestKeyProvider::GetKey(const unsigned char* pbKeyId, unsigned char* pbKey)
+{
+  _cGetKey++;
+  if (0 != memcmp(pbKeyId, _rgbKeyId, sizeof(_rgbKeyId)))
+  {
+    return CSR_NOT_FOUND;
+  }
+  memcpy(pbKey, _rgbKey, sizeof(_rgbKey));
+  return CSR_OK;
+}
+
+bool TestSeal(
+  const CTestKeyProvider& keys,
+  const unsigned char* pbAad,
+  const unsigned char* pb,
+  size_t cb,
+  std::vector<unsigned char>* prgbSealed
+)
+{
+  static unsigned long s_ulNonce = 0;
+  s_ulNonce++;
+
+  size_t ibStart = prgbSealed->size();
+  prgbSealed->resize(ibStart + SEALED_STORE_NONCE_SIZE + cb + SEALED_STORE_TAG_SIZE);
+  unsigned char* pbNonce = &(*prgbSealed)[ibStart];
+  for (int i = 0; i < 4; i++)
+  {
+    pbNonce[i] = (unsigned char)(s_ulNonce >> (8 * i));
+  }
+  return PR_OK == PlatformAesGcmEncrypt(keys.Key(), SEALED_STORE_KEY_SIZE, pbNonce, SEALED_STORE_NONCE_SIZE,
+    pbAad, SEALED_STORE_AAD_SIZE, pb, cb, pbNonce + SEALED_STORE_NONCE_SIZE,
+    pbNonce + SEALED_STORE_NONCE_SIZE + cb, SEALED_STORE_TAG_SIZE);
+}
+
+bool TestWriteSealedStore(
+  const char* pszName,
+  const CTestKeyProvider& keys,
+  const TEST_RECORD* rgRecords,
+  size_t cRecords,
+  std::wstring* pPath
+)
+{
+  std::vector<unsigned char> rgb(SEALED_STORE_HEADER_SIZE);
+  std::vector<SEALED_STORE_INDEX_ENTRY> rgIndex;
+  for (size_t i = 0; i < cRecords; i++)
+  {
+    const TEST_RECORD& record = rgRecords[i];
+    std::string text = std::string(record.pszMachine) + "\n" + record.pszDomain + "\n" + record.pszUsername + "\n" + record.pszPassword;
+    std::wstring machine = TestWide(record.pszMachine);
+
+    SEALED_STORE_INDEX_ENTRY entry;
+    entry.ulMachineHash = CredentialStoreMachineHash(machine.c_str(), machine.size());
+    entry.ullOffset = rgb.size();
+    entry.cbRecord = (unsigned long)(SEALED_STORE_NONCE_SIZE + text.size() + SEALED_STORE_TAG_SIZE);
+
+    unsigned char rgbAad[SEALED_STORE_AAD_SIZE];
+    SealedStoreRecordAad(keys.KeyId(), entry.ulMachineHash, rgbAad);
+    if (!TestSeal(keys, rgbAad, reinterpret_cast<const unsigned char*>(text.c_str()), text.size(), &rgb))
+    {
+      return false;
+    }
+    rgIndex.push_back(entry);
+  }
+
+  // Records with the same hash keep the order they were given in.
+  std::stable_sort(rgIndex.begin(), rgIndex.end(),
+    [](const SEALED_STORE_INDEX_ENTRY& e1, const SEALED_STORE_INDEX_ENTRY& e2) { return e1.ulMachineHash < e2.ulMachineHash; });
+
+  SEALED_STORE_HEADER hdr;
+  hdr.ulMagic = SEALED_STORE_MAGIC;
+  hdr.ulVersion = SEALED_STORE_VERSION;
+  memcpy(hdr.rgbKeyId, keys.KeyId(), SEALED_STORE_KEY_ID_SIZE);
+  hdr.cRecords = (unsigned long)cRecords;
+  hdr.ullIndexOffset = rgb.size();
+  SealedStoreEncodeHeader(hdr, &rgb[0]);
+  for (size_t i = 0; i < rgIndex.size(); i++)
+  {
+    unsigned char rgbEntry[SEALED_STORE_INDEX_ENTRY_SIZE];
+    SealedStoreEncodeIndexEntry(rgIndex[i], rgbEntry);
+    rgb.insert(rgb.end(), rgbEntry, rgbEntry + sizeof(rgbEntry));
+  }
+
+  return TestWriteFile(pszName, &rgb[0], rgb.size(), pPath);
+}
+
+std::wstring TestWide(const char* psz)
+{
+  return std::wstring(psz, psz + strlen(psz));
+}
@@ -0,0 +1,67 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Sealed stores for the tests, written the way CredentialTool provision -key writes them but
+// under a fixed key and through Platform.h, so that they can be written off Windows too.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "SealedStore.h"
+
+// One machine's record.  The tests only need ASCII.
+struct TEST_RECORD
+{
+  const char* pszMachine;
+  const char* pszDomain;
+  const char* pszUsername;
+  const char* pszPassword;
+};
+
+// Holds one key, with a fixed id, and counts how often it was asked for.
+class CTestKeyProvider : public ISealedStoreKeyProvider
+{
+public:
+  CTestKeyProvider();
+
+  CREDENTIAL_STORE_RESULT GetKey(const unsigned char* pbKeyId, unsigned char* pbKey);
+
+  const unsigned char* KeyId() const { return _rgbKeyId; }
+  const unsigned char* Key() const { return _rgbKey; }
+  unsigned long GetKeyCount() const { return _cGetKey; }
+
+private:
+  unsigned char _rgbKeyId[SEALED_STORE_KEY_ID_SIZE];
+  unsigned char _rgbKey[SEALED_STORE_KEY_SIZE];
+  unsigned long _cGetKey;
+};
+
+// Seals cb bytes at pb under keys' key with the additional data at pbAad, and appends the
+// nonce, the ciphertext and the tag to *prgbSealed.  Nonces count up from 1, which is fine
+// for a test and nothing else.
+bool TestSeal(
+  const CTestKeyProvider& keys,
+  const unsigned char* pbAad,
+  const unsigned char* pb,
+  size_t cb,
+  std::vector<unsigned char>* prgbSealed
+);
+
+// Writes a sealed store of cRecords records to a file named pszName in the current
+// directory, and returns its path in *pPath.
+bool TestWriteSealedStore(
+  const char* pszName,
+  const CTestKeyProvider& keys,
+  const TEST_RECORD* rgRecords,
+  size_t cRecords,
+  std::wstring* pPath
+);
+
+// A wide copy of an ASCII string.
+std::wstring TestWide(const char* psz);
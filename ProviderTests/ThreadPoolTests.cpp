@@ -0,0 +1,410 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// ThreadPool.h: canceled items never run, a running item stops when asked, shutting down
+// cancels what is queued, and nothing is lost or run twice while many threads submit and the
+// pool is closed and started again under them.  How long an item waits for a worker is timed
+// with the pool idle and with every worker busy.
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+#include "ThreadPool.h"
+
+#define POOL_WAIT_MS 10000
+#define STRESS_SUBMITTERS 8
+#define STRESS_ITEMS 2000       // per submitter
+#define LATENCY_ITEMS 2000
+#define LATENCY_BUSY_US 200     // how long each item keeping the workers busy runs
+
+// Holds items until it is opened.
+struct POOL_GATE
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool fOpen;
+  std::atomic<long> cWaiting;
+};
+
+static void _SetGate(POOL_GATE* pGate, bool fOpen)
+{
+  {
+    std::lock_guard<std::mutex> lock(pGate->mutex);
+    pGate->fOpen = fOpen;
+  }
+  pGate->cv.notify_all();
+}
+
+static void _SleepMs(unsigned long ulMilliseconds)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ulMilliseconds));
+}
+
+static long _WaitAtGate(void* pvContext, const CCancellationToken&, uintptr_t*)
+{
+  POOL_GATE* pGate = static_cast<POOL_GATE*>(pvContext);
+  pGate->cWaiting++;
+  std::unique_lock<std::mutex> lock(pGate->mutex);
+  pGate->cv.wait(lock, [pGate]() { return pGate->fOpen; });
+  return 0;
+}
+
+// Counts itself, and returns the count it made.
+static long _Count(void* pvContext, const CCancellationToken&, uintptr_t* pulpResult)
+{
+  *pulpResult = static_cast<uintptr_t>(++*static_cast<std::atomic<long>*>(pvContext));
+  return 0;
+}
+
+#define RESULT_ABORTED (-1)
+
+static long _RunUntilCanceled(void* pvContext, const CCancellationToken& rct, uintptr_t*)
+{
+  ++*static_cast<std::atomic<long>*>(pvContext);
+  while (!rct.IsCanceled())
+  {
+    _SleepMs(1);
+  }
+  return RESULT_ABORTED;
+}
+
+// Puts an item at the gate on every worker, so whatever comes next queues.
+static bool _FillPool(POOL_GATE* pGate, std::vector<CWorkFuture*>* prgpFutures)
+{
+  pGate->cWaiting = 0;
+  for (int i = 0; i < THREAD_POOL_THREADS; i++)
+  {
+    CWorkFuture* pFuture;
+    if (PR_OK != ThreadPoolSubmit(_WaitAtGate, pGate, WP_NORMAL, NULL, &pFuture))
+    {
+      return false;
+    }
+    prgpFutures->push_back(pFuture);
+  }
+  while (pGate->cWaiting.load() < THREAD_POOL_THREADS)
+  {
+    _SleepMs(1);
+  }
+  return true;
+}
+
+static bool _IsFinished(CWorkFuture* pFuture, WORK_STATE wsExpected, long lExpected)
+{
+  long lResult;
+  return pFuture->Wait(POOL_WAIT_MS) && wsExpected == pFuture->GetResult(&lResult, NULL) && lExpected == lResult;
+}
+
+static void _ReleaseAll(std::vector<CWorkFuture*>* prgpFutures)
+{
+  for (size_t i = 0; i < prgpFutures->size(); i++)
+  {
+    (*prgpFutures)[i]->Release();
+  }
+  prgpFutures->clear();
+}
+
+bool ThreadPoolCancelTest()
+{
+  POOL_GATE gate;
+  gate.fOpen = false;
+  std::vector<CWorkFuture*> rgpBlockers;
+  std::vector<CWorkFuture*> rgpQueued;
+  TEST_CHECK(_FillPool(&gate, &rgpBlockers));
+
+  // Behind them: one item canceled through its future, a batch through the token they
+  // share, and one left alone.
+  std::atomic<long> cRan(0);
+  CCancellationToken ctBatch;
+  CWorkFuture* pFuture;
+  TEST_CHECK(PR_OK == ThreadPoolSubmit(_Count, &cRan, WP_HIGH, NULL, &pFuture));
+  rgpQueued.push_back(pFuture);
+  for (int i = 0; i < 3; i++)
+  {
+    TEST_CHECK(PR_OK == ThreadPoolSubmit(_Count, &cRan, WP_LOW, &ctBatch, &pFuture));
+    rgpQueued.push_back(pFuture);
+  }
+  TEST_CHECK(PR_OK == ThreadPoolSubmit(_Count, &cRan, WP_NORMAL, NULL, &pFuture));
+  rgpQueued.push_back(pFuture);
+  TEST_CHECK(!pFuture->Wait(0) && WS_PENDING == pFuture->GetResult(NULL, NULL));
+  TEST_CHECK(ThreadPoolIsBusy() && !ThreadPoolShutdownIfIdle());
+  TEST_CHECK(PR_INVALID_ARGUMENT == ThreadPoolSubmit(_Count, &cRan, WP_NUM_PRIORITIES, NULL, &pFuture) && !pFuture);
+
+  rgpQueued[0]->Cancel();
+  ctBatch.Cancel();
+  _SetGate(&gate, true);
+  for (size_t i = 0; i < rgpQueued.size() - 1; i++)
+  {
+    TEST_CHECK(_IsFinished(rgpQueued[i], WS_CANCELED, 0));
+  }
+  pFuture = rgpQueued.back();
+  uintptr_t ulpCount;
+  TEST_CHECK(_IsFinished(pFuture, WS_FINISHED, 0) && WS_FINISHED == pFuture->GetResult(NULL, &ulpCount) && 1 == ulpCount);
+  TEST_CHECK(1 == cRan.load());
+  _ReleaseAll(&rgpQueued);
+
+  // A running item stops when asked.
+  std::atomic<long> cStarted(0);
+  TEST_CHECK(PR_OK == ThreadPoolSubmit(_RunUntilCanceled, &cStarted, WP_NORMAL, NULL, &pFuture));
+  while (!cStarted.load())
+  {
+    _SleepMs(1);
+  }
+  TEST_CHECK(!pFuture->Wait(20));
+  pFuture->Cancel();
+  TEST_CHECK(_IsFinished(pFuture, WS_FINISHED, RESULT_ABORTED));
+  pFuture->Release();
+
+  // Shutting down with fCancelPending cancels what is queued and waits for what is running,
+  // here until the gate opens.
+  _ReleaseAll(&rgpBlockers);
+  _SetGate(&gate, false);
+  TEST_CHECK(_FillPool(&gate, &rgpBlockers));
+  for (int i = 0; i < 8; i++)
+  {
+    TEST_CHECK(PR_OK == ThreadPoolSubmit(_Count, &cRan, (WORK_PRIORITY)(i % WP_NUM_PRIORITIES), NULL, &pFuture));
+    rgpQueued.push_back(pFuture);
+  }
+  std::thread opener([&gate]() { _SleepMs(50); _SetGate(&gate, true); });
+  ThreadPoolShutdown(true);
+  opener.join();
+  TEST_CHECK(!ThreadPoolIsBusy());
+  for (size_t i = 0; i < rgpBlockers.size(); i++)
+  {
+    TEST_CHECK(WS_FINISHED == rgpBlockers[i]->GetResult(NULL, NULL));
+  }
+  for (size_t i = 0; i < rgpQueued.size(); i++)
+  {
+    TEST_CHECK(WS_CANCELED == rgpQueued[i]->GetResult(NULL, NULL));
+  }
+  TEST_CHECK(1 == cRan.load());
+  _ReleaseAll(&rgpBlockers);
+  _ReleaseAll(&rgpQueued);
+
+  // The next submit starts another pool, and once it is idle it can be closed.
+  TEST_CHECK(PR_OK == ThreadPoolSubmit(_Count, &cRan, WP_NORMAL, NULL, &pFuture));
+  TEST_CHECK(_IsFinished(pFuture, WS_FINISHED, 0) && 2 == cRan.load());
+  pFuture->Release();
+  while (ThreadPoolIsBusy())
+  {
+    _SleepMs(1);
+  }
+  TEST_CHECK(ThreadPoolShutdownIfIdle());
+  return true;
+}
+
+struct POOL_STRESS
+{
+  std::atomic<long> cRan;
+  std::atomic<long> cCanceled;      // items whose future says they never ran
+  std::atomic<long> cFailed;        // submits that failed, and futures that said anything else
+};
+
+// Counts itself and, now and then, submits another item from the worker, which goes on
+// that worker's own queue.
+static long _CountAndSpawn(void* pvContext, const CCancellationToken&, uintptr_t*)
+{
+  POOL_STRESS* pStress = static_cast<POOL_STRESS*>(pvContext);
+  if (0 == ++pStress->cRan % 16)
+  {
+    pStress->cRan--;
+    if (PR_OK != ThreadPoolSubmit(_Count, &pStress->cRan, WP_LOW, NULL, NULL))
+    {
+      pStress->cFailed++;
+    }
+  }
+  return 0;
+}
+
+// Submits STRESS_ITEMS at every priority, keeping a future for some and canceling some of
+// those, then waits for every future it kept.
+static void _StressSubmitter(POOL_STRESS* pStress, unsigned long ulSeed)
+{
+  std::vector<CWorkFuture*> rgpFutures;
+  for (int i = 0; i < STRESS_ITEMS; i++)
+  {
+    ulSeed = ulSeed * 1103515245 + 12345;
+    WORK_PRIORITY wp = (WORK_PRIORITY)((ulSeed >> 16) % WP_NUM_PRIORITIES);
+    bool fFuture = 0 != ((ulSeed >> 20) & 1);
+    CWorkFuture* pFuture = NULL;
+    if (PR_OK != ThreadPoolSubmit(_CountAndSpawn, pStress, wp, NULL, fFuture ? &pFuture : NULL))
+    {
+      pStress->cFailed++;
+    }
+    else if (pFuture)
+    {
+      if ((ulSeed >> 21) & 1)
+      {
+        pFuture->Cancel();
+      }
+      rgpFutures.push_back(pFuture);
+    }
+  }
+
+  for (size_t i = 0; i < rgpFutures.size(); i++)
+  {
+    WORK_STATE ws = rgpFutures[i]->Wait(POOL_WAIT_MS) ? rgpFutures[i]->GetResult(NULL, NULL) : WS_PENDING;
+    if (WS_CANCELED == ws)
+    {
+      pStress->cCanceled++;
+    }
+    else if (WS_FINISHED != ws)
+    {
+      pStress->cFailed++;
+    }
+  }
+  _ReleaseAll(&rgpFutures);
+}
+
+bool ThreadPoolStressTest()
+{
+  POOL_STRESS stress;
+  stress.cRan = 0;
+  stress.cCanceled = 0;
+  stress.cFailed = 0;
+
+  // The way DllCanUnloadNow would, if it were called over and over while LogonUI worked,
+  // with a blunter shutdown now and then.
+  std::atomic<bool> fStop(false);
+  unsigned long cShutdowns = 0;
+  std::thread closer([&fStop, &cShutdowns]()
+  {
+    while (!fStop.load())
+    {
+      if (0 == cShutdowns % 8)
+      {
+        ThreadPoolShutdown(false);
+      }
+      else
+      {
+        ThreadPoolShutdownIfIdle();
+      }
+      cShutdowns++;
+      _SleepMs(1);
+    }
+  });
+
+  unsigned long long ullStart = PlatformMonotonicNanoseconds();
+  std::vector<std::thread> rgSubmitters;
+  for (unsigned long i = 0; i < STRESS_SUBMITTERS; i++)
+  {
+    rgSubmitters.push_back(std::thread(_StressSubmitter, &stress, i + 1));
+  }
+  for (size_t i = 0; i < rgSubmitters.size(); i++)
+  {
+    rgSubmitters[i].join();
+  }
+  fStop.store(true);
+  closer.join();
+
+  // Items nobody kept a future for may still be running.
+  for (int i = 0; i < POOL_WAIT_MS && ThreadPoolIsBusy(); i++)
+  {
+    _SleepMs(1);
+  }
+  unsigned long long ullNs = PlatformMonotonicNanoseconds() - ullStart;
+  TEST_CHECK(!ThreadPoolIsBusy());
+  TEST_CHECK(ThreadPoolShutdownIfIdle());
+
+  long cSubmitted = STRESS_SUBMITTERS * STRESS_ITEMS;
+  printf("  %ld items from %d threads in %.1f ms, %ld canceled, pool closed %lu times meanwhile\n",
+    cSubmitted, STRESS_SUBMITTERS, ullNs / 1e6, stress.cCanceled.load(), cShutdowns);
+
+  // Each item either ran once or was canceled before it started, and each item that spawned
+  // another counted that one instead of itself.
+  TEST_CHECK(0 == stress.cFailed.load());
+  TEST_CHECK(cSubmitted == stress.cRan.load() + stress.cCanceled.load());
+  return true;
+}
+
+// Records how long after it was submitted it started.
+struct LATENCY_ITEM
+{
+  unsigned long long ullSubmitted;
+  unsigned long long ullWaited;
+};
+
+static long _RecordStart(void* pvContext, const CCancellationToken&, uintptr_t*)
+{
+  LATENCY_ITEM* pItem = static_cast<LATENCY_ITEM*>(pvContext);
+  pItem->ullWaited = PlatformMonotonicNanoseconds() - pItem->ullSubmitted;
+  return 0;
+}
+
+// Runs for LATENCY_BUSY_US, then queues another like it, until the token is canceled.
+static long _KeepBusy(void* pvContext, const CCancellationToken& rct, uintptr_t*)
+{
+  unsigned long long ullEnd = PlatformMonotonicNanoseconds() + LATENCY_BUSY_US * 1000ULL;
+  while (!rct.IsCanceled() && PlatformMonotonicNanoseconds() < ullEnd)
+  {
+  }
+  const CCancellationToken* pctBusy = static_cast<const CCancellationToken*>(pvContext);
+  if (!rct.IsCanceled())
+  {
+    ThreadPoolSubmit(_KeepBusy, pvContext, WP_LOW, pctBusy, NULL);
+  }
+  return 0;
+}
+
+// Submits LATENCY_ITEMS at wp one after another, each some time up to LATENCY_BUSY_US after
+// the last has finished, so the worker that ran it has moved on, and reports the median and
+// 99th percentile of their waits.
+static bool _TimeWaits(WORK_PRIORITY wp, const char* pszWhat)
+{
+  std::vector<LATENCY_ITEM> rgItems(LATENCY_ITEMS);
+  unsigned long ulSeed = 1;
+  for (size_t i = 0; i < rgItems.size(); i++)
+  {
+    ulSeed = ulSeed * 1103515245 + 12345;
+    std::this_thread::sleep_for(std::chrono::microseconds((ulSeed >> 16) % LATENCY_BUSY_US));
+    CWorkFuture* pFuture;
+    rgItems[i].ullSubmitted = PlatformMonotonicNanoseconds();
+    TEST_CHECK(PR_OK == ThreadPoolSubmit(_RecordStart, &rgItems[i], wp, NULL, &pFuture));
+    TEST_CHECK(_IsFinished(pFuture, WS_FINISHED, 0));
+    pFuture->Release();
+  }
+
+  std::vector<unsigned long long> rgullWaits;
+  for (size_t i = 0; i < rgItems.size(); i++)
+  {
+    rgullWaits.push_back(rgItems[i].ullWaited);
+  }
+  std::sort(rgullWaits.begin(), rgullWaits.end());
+  printf("  %s: median wait %.1f us, 99th percentile %.1f us\n", pszWhat,
+    rgullWaits[rgullWaits.size() / 2] / 1e3, rgullWaits[rgullWaits.size() * 99 / 100] / 1e3);
+  return true;
+}
+
+bool ThreadPoolLatencyTest()
+{
+  // Idle: the wait is a worker waking.
+  TEST_CHECK(_TimeWaits(WP_HIGH, "idle"));
+
+  // Every worker busy with a backlog of low-priority items: a high-priority item waits for
+  // the first worker to finish what it is running, not for the backlog.
+  CCancellationToken ctBusy;
+  for (int i = 0; i < THREAD_POOL_THREADS * 4; i++)
+  {
+    TEST_CHECK(PR_OK == ThreadPoolSubmit(_KeepBusy, &ctBusy, WP_LOW, &ctBusy, NULL));
+  }
+  bool fTimed = _TimeWaits(WP_HIGH, "busy, high priority");
+  ctBusy.Cancel();
+  for (int i = 0; i < POOL_WAIT_MS && ThreadPoolIsBusy(); i++)
+  {
+    _SleepMs(1);
+  }
+  TEST_CHECK(fTimed && !ThreadPoolIsBusy());
+
+  ThreadPoolShutdown(false);
+  return true;
+}
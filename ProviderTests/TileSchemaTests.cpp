@@ -0,0 +1,99 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// TileSchema.h: every label and static value of each layout carries its own length, and
+// what GetStringValue hands LogonUI is a copy of exactly that many characters.  The tables
+// generated from each schema agree with it, and GetFieldDescriptorAt's copy of a descriptor
+// comes apart the way LogonUI frees it.
+
+#include <windows.h>
+#include <wchar.h>
+#include "ProviderTests.h"
+#include "TileSchema.h"
+
+template <size_t cFields>
+static bool _LengthsMatch(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse)
+{
+  for (size_t i = 0; i < cFields; i++)
+  {
+    TEST_CHECK(rgfse[i].pwzLabel && wcslen(rgfse[i].pwzLabel) == rgfse[i].cchLabel);
+    TEST_CHECK(!rgfse[i].fsStatic.pwz || wcslen(rgfse[i].fsStatic.pwz) == rgfse[i].fsStatic.cch);
+  }
+  return true;
+}
+
+bool TileSchemaStringsTest()
+{
+  TEST_CHECK(_LengthsMatch(USERNAME_TILE_SCHEMA::Fields()));
+  TEST_CHECK(_LengthsMatch(USERNAME_DOMAIN_TILE_SCHEMA::Fields()));
+  TEST_CHECK(_LengthsMatch(PASSWORD_TILE_SCHEMA::Fields()));
+
+  // The copy stops at cch, whatever follows, and is terminated.
+  const WCHAR rgch[] = { L'S', L'u', L'b', L'm', L'i', L't', L'X', L'X' };
+  PWSTR pwz;
+  TEST_CHECK(SUCCEEDED(StringCoAllocCopy(rgch, 6, &pwz)));
+  bool fCopied = 0 == wcscmp(pwz, L"Submit");
+  CoTaskMemFree(pwz);
+  TEST_CHECK(fCopied);
+
+  TEST_CHECK(SUCCEEDED(StringCoAllocCopy(L"", 0, &pwz)));
+  fCopied = L'\0' == pwz[0];
+  CoTaskMemFree(pwz);
+  TEST_CHECK(fCopied);
+  return true;
+}
+
+// Any field type GUID will do; the copy has to carry it along.
+static const GUID s_guidFieldType = { 0x6f45dc1e, 0x5384, 0x457a, { 0xbc, 0x13, 0x2c, 0xd8, 0x1b, 0x0d, 0x28, 0xed } };
+
+template <size_t cFields>
+static bool _TablesMatch(const std::array<FIELD_SCHEMA_ENTRY, cFields>& rgfse)
+{
+  const std::array<CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR, cFields> rgcpfd =
+    MakeFieldDescriptors(rgfse, std::make_index_sequence<cFields>());
+  const std::array<FIELD_STATE_PAIR, cFields> rgfsp = MakeFieldStatePairs(rgfse, std::make_index_sequence<cFields>());
+  const std::array<DWORD, cFields> rgiSlots = MakeFieldEditSlots(rgfse, std::make_index_sequence<cFields>());
+  DWORD cEditable = 0;
+  for (size_t i = 0; i < cFields; i++)
+  {
+    TEST_CHECK(i == rgcpfd[i].dwFieldID && rgfse[i].cpft == rgcpfd[i].cpft && rgfse[i].pwzLabel == rgcpfd[i].pszLabel);
+    TEST_CHECK(rgfse[i].cpfs == rgfsp[i].cpfs && rgfse[i].cpfis == rgfsp[i].cpfis);
+
+    // Editable fields get consecutive slots in field order, and no others get one.
+    bool fEditable = CPFT_EDIT_TEXT == rgfse[i].cpft || CPFT_PASSWORD_TEXT == rgfse[i].cpft;
+    TEST_CHECK(fEditable ? cEditable++ == rgiSlots[i] : FIELD_NOT_PRESENT == rgiSlots[i]);
+  }
+  TEST_CHECK(FieldSchemaCountEditable(rgfse) == cEditable);
+  return true;
+}
+
+bool TileSchemaTablesTest()
+{
+  TEST_CHECK(_TablesMatch(USERNAME_TILE_SCHEMA::Fields()));
+  TEST_CHECK(_TablesMatch(USERNAME_DOMAIN_TILE_SCHEMA::Fields()));
+  TEST_CHECK(_TablesMatch(PASSWORD_TILE_SCHEMA::Fields()));
+
+  // The label is copied by its length, into a block of its own: LogonUI frees it before
+  // the descriptor.
+  const WCHAR rgchLabel[] = { L'D', L'o', L'm', L'a', L'i', L'n', L'X' };
+  CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR cpfd = { 2, CPFT_SMALL_TEXT, const_cast<PWSTR>(rgchLabel), s_guidFieldType };
+  CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR* pcpfd;
+  TEST_CHECK(SUCCEEDED(FieldDescriptorCoAllocCopyN(cpfd, 6, &pcpfd)));
+  bool fCopied = 2 == pcpfd->dwFieldID && CPFT_SMALL_TEXT == pcpfd->cpft && IsEqualGUID(s_guidFieldType, pcpfd->guidFieldType) &&
+    rgchLabel != pcpfd->pszLabel && 0 == wcscmp(pcpfd->pszLabel, L"Domain");
+  CoTaskMemFree(pcpfd->pszLabel);
+  CoTaskMemFree(pcpfd);
+  TEST_CHECK(fCopied);
+
+  cpfd.pszLabel = NULL;
+  TEST_CHECK(SUCCEEDED(FieldDescriptorCoAllocCopyN(cpfd, 0, &pcpfd)));
+  fCopied = NULL == pcpfd->pszLabel;
+  CoTaskMemFree(pcpfd);
+  TEST_CHECK(fCopied);
+  return true;
+}
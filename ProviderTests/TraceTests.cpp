@@ -0,0 +1,133 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Trace.h: spans are recorded only while tracing is on, each thread keeps its last
+// TRACE_BUFFER_EVENTS of them, and the export is Chrome trace-event JSON with one complete
+// event per span held, under the thread that recorded it and with its name escaped.  With
+// a flight recorder ring started, a scope's entry and exit go into it whether or not
+// tracing is on.
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProviderTests.h"
+#include "Trace.h"
+
+#define TRACE_FILE "trace-export.json"
+
+// Names from the test, so that spans other code records can't be mistaken for them.
+static const char c_szOld[] = "trace-test-old";
+static const char c_szNew[] = "trace-test-new";
+static const char c_szScope[] = "trace-test-scope";
+static const char c_szWorker[] = "trace-test-worker";
+static const char c_szEscaped[] = "trace-test \"quoted\" back\\slash\ttab";
+
+static size_t _CountOf(const std::string& strText, const std::string& strFind)
+{
+  size_t c = 0;
+  for (size_t i = strText.find(strFind); std::string::npos != i; i = strText.find(strFind, i + strFind.size()))
+  {
+    c++;
+  }
+  return c;
+}
+
+// The name as it appears in an exported event.
+static std::string _NameField(const char* pszEscapedName)
+{
+  return std::string("\"name\":\"") + pszEscapedName + "\"}";
+}
+
+static bool _Export(std::string* pstrJson)
+{
+  std::wstring wstrPath = TestMissingPath(TRACE_FILE);
+  TEST_CHECK(PR_OK == TraceWriteChromeJson(wstrPath.c_str()));
+  std::vector<unsigned char> rgb;
+  PLATFORM_RESULT pr = PlatformReadFile(wstrPath.c_str(), 64 * 1024 * 1024, &rgb);
+  remove(TRACE_FILE);
+  TEST_CHECK(PR_OK == pr);
+  pstrJson->assign(rgb.begin(), rgb.end());
+  return true;
+}
+
+bool TraceExportTest()
+{
+  TraceShutdown();
+
+  // Off, a scope records nothing.
+  {
+    TRACE_SCOPE(c_szScope);
+  }
+  std::string strJson;
+  TEST_CHECK(_Export(&strJson));
+  TEST_CHECK(0 == _CountOf(strJson, _NameField(c_szScope)));
+
+  // On, it records one span, and so does each call to TraceRecordSpan.  Two more spans than
+  // the buffer holds push out the two oldest: the scope's, and the first old one.
+  TraceEnable(true);
+  {
+    TRACE_SCOPE(c_szScope);
+  }
+  for (int i = 0; i < 10; i++)
+  {
+    TraceRecordSpan(c_szOld, i, i + 1);
+  }
+  for (int i = 0; i < TRACE_BUFFER_EVENTS - 10; i++)
+  {
+    TraceRecordSpan(c_szNew, i, i + 1);
+  }
+  TraceRecordSpan(c_szEscaped, 0, 1);
+
+  // Another thread's spans are its own.
+  unsigned long ulWorkerThreadId = 0;
+  std::thread worker([&ulWorkerThreadId]()
+  {
+    ulWorkerThreadId = PlatformCurrentThreadId();
+    for (int i = 0; i < 3; i++)
+    {
+      TRACE_SCOPE(c_szWorker);
+    }
+  });
+  worker.join();
+  TraceEnable(false);
+  TEST_CHECK(_Export(&strJson));
+
+  TEST_CHECK(0 == strJson.find("{\"traceEvents\":[\n") && std::string::npos != strJson.find("\n],\"displayTimeUnit\":\"ms\"}\n"));
+  TEST_CHECK(0 == _CountOf(strJson, _NameField(c_szScope)));
+  TEST_CHECK(9 == _CountOf(strJson, _NameField(c_szOld)));
+  TEST_CHECK(TRACE_BUFFER_EVENTS - 10 == _CountOf(strJson, _NameField(c_szNew)));
+  TEST_CHECK(1 == _CountOf(strJson, _NameField("trace-test \\\"quoted\\\" back\\\\slash\\u0009tab")));
+  TEST_CHECK(3 == _CountOf(strJson, _NameField(c_szWorker)));
+  TEST_CHECK(3 == _CountOf(strJson, "\"tid\":" + std::to_string(ulWorkerThreadId) + ","));
+  TEST_CHECK(TRACE_BUFFER_EVENTS + 3 == _CountOf(strJson, "{\"ph\":\"X\","));
+
+  // Into the ring, tracing off, the scope is an entry and an exit on this thread.
+  std::vector<uint64_t> rgullRing(FlightRecorderFileSize(8) / sizeof(uint64_t), 0);
+  FLIGHT_RECORDER_HEADER* pHeader = FlightRecorderAttach(&rgullRing[0], rgullRing.size() * sizeof(uint64_t), FLIGHT_RECORDER_FREQUENCY);
+  TEST_CHECK(pHeader && FlightRecorderStart(pHeader));
+  TEST_CHECK(!FlightRecorderStart(pHeader));
+  {
+    TRACE_SCOPE(c_szScope);
+  }
+  TEST_CHECK(pHeader == FlightRecorderStop());
+  {
+    TRACE_SCOPE(c_szScope);
+  }
+  FLIGHT_RECORDER_INFO info;
+  std::vector<FLIGHT_EVENT> rgEvents;
+  TEST_CHECK(FlightRecorderDecode(reinterpret_cast<const unsigned char*>(&rgullRing[0]), rgullRing.size() * sizeof(uint64_t), &info, &rgEvents));
+  TEST_CHECK(2 == rgEvents.size() && FE_ENTER == rgEvents[0].usType && FE_EXIT == rgEvents[1].usType);
+  TEST_CHECK(PlatformCurrentThreadId() == rgEvents[1].ulThreadId && 0 == strcmp(c_szScope, rgEvents[1].szName));
+  TEST_CHECK(rgEvents[1].llTicks >= rgEvents[0].llTicks && rgEvents[1].llTicks - rgEvents[0].llTicks == rgEvents[1].llDuration);
+  TEST_CHECK(_Export(&strJson) && 0 == _CountOf(strJson, _NameField(c_szScope)));
+
+  TraceShutdown();
+  return true;
+}
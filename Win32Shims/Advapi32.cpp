@@ -0,0 +1,228 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// advapi32's registry and CredProtect calls on POSIX.  The registry is a map in the
+// process, and CredProtectW encodes rather than encrypts; see wincred.h.
+
+#include <windows.h>
+#include <wincred.h>
+#include "Win32Shims.h"
+
+struct SHIM_VALUE
+{
+    DWORD dwType;
+    std::vector<BYTE> data;
+};
+
+static std::mutex s_mutexRegistry;
+static std::map<std::wstring, SHIM_VALUE> s_mapRegistry;
+
+// Keys and value names are case-insensitive, so both are upper-cased into the map's key.
+static std::wstring _ValueKey(HKEY hkey, LPCWSTR lpSubKey, LPCWSTR lpValue)
+{
+    wchar_t wszRoot[24];
+    swprintf(wszRoot, ARRAYSIZE(wszRoot), L"%p\\", static_cast<void*>(hkey));
+    std::wstring key(wszRoot);
+    key += lpSubKey ? lpSubKey : L"";
+    key += L'\n';
+    key += lpValue ? lpValue : L"";
+    for (size_t i = 0; i < key.size(); i++)
+    {
+        key[i] = (wchar_t)towupper(key[i]);
+    }
+    return key;
+}
+
+static DWORD _RestrictionOf(DWORD dwType)
+{
+    switch (dwType)
+    {
+    case REG_NONE:
+        return RRF_RT_REG_NONE;
+    case REG_SZ:
+        return RRF_RT_REG_SZ;
+    case REG_EXPAND_SZ:
+        return RRF_RT_REG_EXPAND_SZ;
+    case REG_BINARY:
+        return RRF_RT_REG_BINARY;
+    case REG_DWORD:
+        return RRF_RT_REG_DWORD;
+    case REG_MULTI_SZ:
+        return RRF_RT_REG_MULTI_SZ;
+    case REG_QWORD:
+        return RRF_RT_REG_QWORD;
+    }
+    return 0;
+}
+
+LSTATUS WINAPI RegGetValueW(__in HKEY hkey, __in_opt LPCWSTR lpSubKey, __in_opt LPCWSTR lpValue,
+    __in DWORD dwFlags, __out_opt LPDWORD pdwType, __out_bcount(*pcbData) PVOID pvData, __inout_opt LPDWORD pcbData)
+{
+    if (pvData && NULL == pcbData)
+    {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutexRegistry);
+    std::map<std::wstring, SHIM_VALUE>::const_iterator it = s_mapRegistry.find(_ValueKey(hkey, lpSubKey, lpValue));
+    if (s_mapRegistry.end() == it)
+    {
+        return ERROR_FILE_NOT_FOUND;
+    }
+    const SHIM_VALUE& value = it->second;
+    if (!(_RestrictionOf(value.dwType) & dwFlags))
+    {
+        return ERROR_UNSUPPORTED_TYPE;
+    }
+
+    if (pdwType)
+    {
+        *pdwType = value.dwType;
+    }
+    if (pcbData)
+    {
+        DWORD cbData = (DWORD)value.data.size();
+        DWORD cbBuffer = *pcbData;
+        *pcbData = cbData;
+        if (pvData)
+        {
+            if (cbBuffer < cbData)
+            {
+                return ERROR_MORE_DATA;
+            }
+            memcpy(pvData, value.data.data(), cbData);
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+LSTATUS WINAPI RegSetKeyValueW(__in HKEY hKey, __in_opt LPCWSTR lpSubKey, __in_opt LPCWSTR lpValueName,
+    __in DWORD dwType, __in_bcount(cbData) LPCVOID lpData, __in DWORD cbData)
+{
+    SHIM_VALUE value;
+    value.dwType = dwType;
+    const BYTE* pb = static_cast<const BYTE*>(lpData);
+    value.data.assign(pb, pb + cbData);
+
+    // RegGetValueW guarantees a string it returns is terminated, whatever was stored.
+    if ((REG_SZ == dwType || REG_EXPAND_SZ == dwType) &&
+        (value.data.size() < sizeof(WCHAR) ||
+         0 != *reinterpret_cast<const WCHAR*>(&value.data[value.data.size() - sizeof(WCHAR)])))
+    {
+        value.data.resize(value.data.size() - value.data.size() % sizeof(WCHAR) + sizeof(WCHAR), 0);
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutexRegistry);
+    s_mapRegistry[_ValueKey(hKey, lpSubKey, lpValueName)] = value;
+    return ERROR_SUCCESS;
+}
+
+LSTATUS WINAPI RegDeleteKeyValueW(__in HKEY hKey, __in_opt LPCWSTR lpSubKey, __in_opt LPCWSTR lpValueName)
+{
+    std::lock_guard<std::mutex> lock(s_mutexRegistry);
+    return s_mapRegistry.erase(_ValueKey(hKey, lpSubKey, lpValueName)) ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND;
+}
+
+//
+// CredProtect.  A protected string is the prefix followed by each character as eight hex
+// digits.
+//
+
+static const wchar_t c_wszProtectedPrefix[] = L"@@D";
+#define PROTECTED_PREFIX_CCH (ARRAYSIZE(c_wszProtectedPrefix) - 1)
+#define PROTECTED_CCH_PER_CHAR 8
+
+static bool _IsProtected(LPCWSTR pwz, size_t cch)
+{
+    if (cch < PROTECTED_PREFIX_CCH || 0 != wcsncmp(pwz, c_wszProtectedPrefix, PROTECTED_PREFIX_CCH) ||
+        0 != (cch - PROTECTED_PREFIX_CCH) % PROTECTED_CCH_PER_CHAR)
+    {
+        return false;
+    }
+    for (size_t i = PROTECTED_PREFIX_CCH; i < cch; i++)
+    {
+        if (!iswxdigit(pwz[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+BOOL WINAPI CredProtectW(__in BOOL /*fAsSelf*/, __in_ecount(cchCredentials) LPWSTR pszCredentials,
+    __in DWORD cchCredentials, __out_ecount(*pcchMaxChars) LPWSTR pszProtectedCredentials, __inout DWORD* pcchMaxChars,
+    __out_opt CRED_PROTECTION_TYPE* ProtectionType)
+{
+    // cchCredentials counts the terminator, as it does on Windows.
+    size_t cch = cchCredentials;
+    if (cch > 0 && L'\0' == pszCredentials[cch - 1])
+    {
+        cch--;
+    }
+    size_t cchNeeded = PROTECTED_PREFIX_CCH + cch * PROTECTED_CCH_PER_CHAR + 1;
+    if (NULL == pszProtectedCredentials || *pcchMaxChars < cchNeeded)
+    {
+        *pcchMaxChars = (DWORD)cchNeeded;
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return FALSE;
+    }
+
+    wcscpy(pszProtectedCredentials, c_wszProtectedPrefix);
+    for (size_t i = 0; i < cch; i++)
+    {
+        swprintf(pszProtectedCredentials + PROTECTED_PREFIX_CCH + i * PROTECTED_CCH_PER_CHAR, PROTECTED_CCH_PER_CHAR + 1,
+            L"%08x", (unsigned int)pszCredentials[i]);
+    }
+    pszProtectedCredentials[cchNeeded - 1] = L'\0';
+    *pcchMaxChars = (DWORD)cchNeeded;
+    if (ProtectionType)
+    {
+        *ProtectionType = CredUserProtection;
+    }
+    return TRUE;
+}
+
+BOOL WINAPI CredUnprotectW(__in BOOL /*fAsSelf*/, __in_ecount(cchProtectedCredentials) LPWSTR pszProtectedCredentials,
+    __in DWORD cchProtectedCredentials, __out_ecount_opt(*pcchMaxChars) LPWSTR pszCredentials, __inout DWORD* pcchMaxChars)
+{
+    size_t cchProtected = cchProtectedCredentials;
+    if (cchProtected > 0 && L'\0' == pszProtectedCredentials[cchProtected - 1])
+    {
+        cchProtected--;
+    }
+    if (!_IsProtected(pszProtectedCredentials, cchProtected))
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    size_t cch = (cchProtected - PROTECTED_PREFIX_CCH) / PROTECTED_CCH_PER_CHAR;
+    if (NULL == pszCredentials || *pcchMaxChars < cch + 1)
+    {
+        *pcchMaxChars = (DWORD)(cch + 1);
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return FALSE;
+    }
+    for (size_t i = 0; i < cch; i++)
+    {
+        wchar_t wszDigits[PROTECTED_CCH_PER_CHAR + 1];
+        wmemcpy(wszDigits, pszProtectedCredentials + PROTECTED_PREFIX_CCH + i * PROTECTED_CCH_PER_CHAR, PROTECTED_CCH_PER_CHAR);
+        wszDigits[PROTECTED_CCH_PER_CHAR] = L'\0';
+        pszCredentials[i] = (wchar_t)wcstoul(wszDigits, NULL, 16);
+    }
+    pszCredentials[cch] = L'\0';
+    *pcchMaxChars = (DWORD)(cch + 1);
+    return TRUE;
+}
+
+BOOL WINAPI CredIsProtectedW(__in LPWSTR pszProtectedCredentials, __out CRED_PROTECTION_TYPE* pProtectionType)
+{
+    *pProtectionType = _IsProtected(pszProtectedCredentials, wcslen(pszProtectedCredentials)) ?
+        CredUserProtection : CredUnprotected;
+    return TRUE;
+}
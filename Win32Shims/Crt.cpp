@@ -0,0 +1,465 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The C runtime's wide formatted output on the C library's.  Format strings are rewritten
+// from the runtime's conventions to the C library's, then formatted with vswprintf; output
+// to a stream is written as UTF-8 bytes, so a stream never takes a wide orientation.
+//
+// fwscanf_s cannot be rewritten that way, since its buffer sizes are arguments the C
+// library's would not skip, so it is a scanner of its own.  It reads with fgetwc, so a stream
+// it reads takes a wide orientation, as one read with the C library's fwscanf does.
+
+#include <errno.h>
+#include <windows.h>
+#include "Win32Shims.h"
+
+// Enough for every format string the provider and its tools use; longer ones go to the heap.
+#define FORMAT_STACK_CCH 512
+
+// Rewrites one of the runtime's format strings for the C library: %s and %c are wide and
+// %S and %C narrow, h and l make either explicit, w is l, and an l on an integer is 32 bits,
+// as long is on Windows.  pwzOut holds 2 * wcslen(pwzFormat) + 1 characters, the most the
+// rewrite can grow to.
+static void _TranslateFormat(const wchar_t* pwzFormat, wchar_t* pwzOut)
+{
+    const wchar_t* pwch = pwzFormat;
+    wchar_t* pwchOut = pwzOut;
+    while (*pwch)
+    {
+        if (L'%' != *pwch)
+        {
+            *pwchOut++ = *pwch++;
+            continue;
+        }
+        *pwchOut++ = *pwch++;
+        if (L'%' == *pwch)
+        {
+            *pwchOut++ = *pwch++;
+            continue;
+        }
+
+        // Flags, width and precision pass through.
+        while (*pwch && wcschr(L"-+ #0123456789.*", *pwch))
+        {
+            *pwchOut++ = *pwch++;
+        }
+
+        wchar_t chSize = 0;
+        bool fSize64 = false;
+        if (L'h' == *pwch || L'l' == *pwch || L'w' == *pwch)
+        {
+            chSize = (L'h' == *pwch) ? L'h' : L'l';
+            pwch++;
+            if (L'l' == chSize && L'l' == *pwch)
+            {
+                fSize64 = true;
+                pwch++;
+            }
+        }
+        else if (L'I' == *pwch)
+        {
+            pwch++;
+            if (L'6' == pwch[0] && L'4' == pwch[1])
+            {
+                fSize64 = true;
+                pwch += 2;
+            }
+            else if (L'3' == pwch[0] && L'2' == pwch[1])
+            {
+                pwch += 2;
+            }
+            else
+            {
+                chSize = L'z';
+            }
+        }
+        else if (L'z' == *pwch || L'j' == *pwch || L't' == *pwch || L'L' == *pwch)
+        {
+            chSize = *pwch++;
+        }
+
+        wchar_t chConversion = *pwch;
+        switch (chConversion)
+        {
+        case L's':
+        case L'c':
+            if (L'h' != chSize)
+            {
+                *pwchOut++ = L'l';
+            }
+            break;
+        case L'S':
+        case L'C':
+            if (L'l' == chSize)
+            {
+                *pwchOut++ = L'l';
+            }
+            chConversion = (L'S' == chConversion) ? L's' : L'c';
+            break;
+        default:
+            if (fSize64)
+            {
+                *pwchOut++ = L'l';
+                *pwchOut++ = L'l';
+            }
+            else if (chSize && L'l' != chSize)
+            {
+                *pwchOut++ = chSize;
+            }
+            break;
+        }
+        if (chConversion)
+        {
+            *pwchOut++ = chConversion;
+            pwch++;
+        }
+    }
+    *pwchOut = L'\0';
+}
+
+// Formats into pwz, which is always terminated; returns -1 if the output was cut short.
+static int _Format(wchar_t* pwz, size_t cch, const wchar_t* pwzFormat, va_list va)
+{
+    size_t cchFormat = 2 * wcslen(pwzFormat) + 1;
+    wchar_t wszFormat[FORMAT_STACK_CCH];
+    std::vector<wchar_t> heapFormat;
+    wchar_t* pwzTranslated = wszFormat;
+    if (cchFormat > ARRAYSIZE(wszFormat))
+    {
+        heapFormat.resize(cchFormat);
+        pwzTranslated = &heapFormat[0];
+    }
+    _TranslateFormat(pwzFormat, pwzTranslated);
+
+    int cchWritten = vswprintf(pwz, cch, pwzTranslated, va);
+    if (cchWritten < 0 && cch > 0)
+    {
+        pwz[cch - 1] = L'\0';
+    }
+    return cchWritten;
+}
+
+int Win32ShimVsnwprintf(__out_ecount(cch) wchar_t* pwz, __in size_t cch, __in const wchar_t* pwzFormat,
+    __in va_list va)
+{
+    return _Format(pwz, cch, pwzFormat, va);
+}
+
+int Win32ShimVfwprintf(__in FILE* pf, __in const wchar_t* pwzFormat, __in va_list va)
+{
+    // vswprintf cannot say how long its output would have been, so the buffer doubles until
+    // the output fits.
+    wchar_t wszStack[FORMAT_STACK_CCH];
+    std::vector<wchar_t> heap;
+    wchar_t* pwz = wszStack;
+    size_t cch = ARRAYSIZE(wszStack);
+    int cchWritten;
+    for (;;)
+    {
+        va_list vaCopy;
+        va_copy(vaCopy, va);
+        cchWritten = _Format(pwz, cch, pwzFormat, vaCopy);
+        va_end(vaCopy);
+        if (cchWritten >= 0 || cch >= (1u << 20))
+        {
+            break;
+        }
+        cch *= 2;
+        heap.resize(cch);
+        pwz = &heap[0];
+    }
+    if (cchWritten < 0)
+    {
+        return -1;
+    }
+
+    std::string s = Win32ShimNarrow(pwz, (size_t)cchWritten);
+    return (fwrite(s.data(), 1, s.size(), pf) == s.size()) ? cchWritten : -1;
+}
+
+int Win32ShimFwprintf(__in FILE* pf, __in const wchar_t* pwzFormat, ...)
+{
+    va_list va;
+    va_start(va, pwzFormat);
+    int cch = Win32ShimVfwprintf(pf, pwzFormat, va);
+    va_end(va);
+    return cch;
+}
+
+int Win32ShimWprintf(__in const wchar_t* pwzFormat, ...)
+{
+    va_list va;
+    va_start(va, pwzFormat);
+    int cch = Win32ShimVfwprintf(stdout, pwzFormat, va);
+    va_end(va);
+    return cch;
+}
+
+errno_t Win32ShimWfopenS(__out FILE** ppf, __in const wchar_t* pwzPath, __in const wchar_t* pwzMode)
+{
+    if (NULL == ppf || NULL == pwzPath || NULL == pwzMode)
+    {
+        return EINVAL;
+    }
+    *ppf = fopen(Win32ShimNarrow(pwzPath).c_str(), Win32ShimNarrow(pwzMode).c_str());
+    return *ppf ? 0 : errno;
+}
+
+// Whether wch can be part of a field of the given conversion.
+static bool _InField(__in wchar_t chConversion, __in wint_t wch)
+{
+    switch (chConversion)
+    {
+    case L's':
+    case L'S':
+        return !iswspace(wch);
+    case L'c':
+    case L'C':
+        return true;
+    case L'd':
+    case L'u':
+        return wcschr(L"+-0123456789", wch) != NULL;
+    case L'x':
+    case L'X':
+        return wcschr(L"+-0123456789abcdefABCDEFxX", wch) != NULL;
+    default:
+        return wcschr(L"+-.0123456789eEinfINFaAnN", wch) != NULL;
+    }
+}
+
+// Stores a field in the buffer and size the next arguments give, in characters of the
+// buffer's width.  A buffer too small for the field and, for %s, its terminator fails the
+// conversion, as the runtime's does.
+template <typename T>
+static bool _StoreString(__in const std::basic_string<T>& field, __in bool fTerminate, __inout va_list* pva)
+{
+    T* pch = va_arg(*pva, T*);
+    unsigned int cch = va_arg(*pva, unsigned int);
+    if (field.size() + (fTerminate ? 1 : 0) > cch)
+    {
+        if (cch)
+        {
+            pch[0] = 0;
+        }
+        return false;
+    }
+    memcpy(pch, field.data(), field.size() * sizeof(T));
+    if (fTerminate)
+    {
+        pch[field.size()] = 0;
+    }
+    return true;
+}
+
+// Enough of the runtime's fwscanf_s for the tools' results and state files: white space,
+// literal characters, and %s, %c, %d, %u, %x and the floating-point conversions, with *,
+// widths and the size prefixes _TranslateFormat knows.  Scanning stops at a conversion it
+// does not know, as at one that fails.
+int Win32ShimVfwscanfS(__in FILE* pf, __in const wchar_t* pwzFormat, __in va_list va)
+{
+    va_list vaArgs;
+    va_copy(vaArgs, va);
+    int cAssigned = 0;
+    bool fInputFailure = false;
+    const wchar_t* pwch = pwzFormat;
+    while (*pwch && !fInputFailure)
+    {
+        wint_t wch;
+        if (iswspace(*pwch))
+        {
+            while (WEOF != (wch = fgetwc(pf)) && iswspace(wch))
+            {
+            }
+            if (WEOF != wch)
+            {
+                ungetwc(wch, pf);
+            }
+            pwch++;
+            continue;
+        }
+
+        if (L'%' != *pwch || L'%' == pwch[1])
+        {
+            wch = fgetwc(pf);
+            if (WEOF == wch)
+            {
+                fInputFailure = true;
+                break;
+            }
+            if ((wchar_t)wch != *pwch)
+            {
+                ungetwc(wch, pf);
+                break;
+            }
+            pwch += (L'%' == *pwch) ? 2 : 1;
+            continue;
+        }
+        pwch++;
+
+        bool fSuppress = (L'*' == *pwch);
+        if (fSuppress)
+        {
+            pwch++;
+        }
+        size_t cchWidth = 0;
+        while (iswdigit(*pwch))
+        {
+            cchWidth = cchWidth * 10 + (*pwch++ - L'0');
+        }
+
+        wchar_t chSize = 0;
+        bool fSize64 = false;
+        if (L'h' == *pwch || L'l' == *pwch || L'w' == *pwch || L'L' == *pwch)
+        {
+            chSize = (L'w' == *pwch) ? L'l' : *pwch;
+            pwch++;
+            if (L'l' == chSize && L'l' == *pwch)
+            {
+                fSize64 = true;
+                pwch++;
+            }
+        }
+        else if (L'I' == pwch[0] && L'6' == pwch[1] && L'4' == pwch[2])
+        {
+            fSize64 = true;
+            pwch += 3;
+        }
+        wchar_t chConversion = *pwch;
+        if (!wcschr(L"sScCduxXeEfgG", chConversion))
+        {
+            break;
+        }
+        pwch++;
+
+        bool fChars = (L'c' == chConversion || L'C' == chConversion);
+        if (!fChars)
+        {
+            while (WEOF != (wch = fgetwc(pf)) && iswspace(wch))
+            {
+            }
+            if (WEOF != wch)
+            {
+                ungetwc(wch, pf);
+            }
+        }
+
+        // The field: as many characters as can be part of it, up to the width.
+        size_t cchMax = cchWidth ? cchWidth : (fChars ? 1 : (size_t)-1);
+        std::wstring field;
+        wch = 0;
+        while (field.size() < cchMax)
+        {
+            wch = fgetwc(pf);
+            if (WEOF == wch)
+            {
+                break;
+            }
+            if (!_InField(chConversion, wch))
+            {
+                ungetwc(wch, pf);
+                break;
+            }
+            field.push_back((wchar_t)wch);
+        }
+        if (field.empty() || (fChars && field.size() < cchMax))
+        {
+            fInputFailure = (WEOF == wch);
+            break;
+        }
+        if (fSuppress)
+        {
+            continue;
+        }
+
+        // %s and %c are wide and %S and %C narrow, unless h or l says otherwise.
+        bool fStored;
+        wchar_t* pwchEnd = NULL;
+        switch (chConversion)
+        {
+        case L's':
+        case L'c':
+        case L'S':
+        case L'C':
+            if ((L'h' == chSize) || (iswupper(chConversion) && L'l' != chSize))
+            {
+                fStored = _StoreString(Win32ShimNarrow(field.c_str(), field.size()), !fChars, &vaArgs);
+            }
+            else
+            {
+                fStored = _StoreString(field, !fChars, &vaArgs);
+            }
+            break;
+        case L'd':
+        case L'u':
+        case L'x':
+        case L'X':
+        {
+            // An l is 32 bits, as long is on Windows.
+            int nBase = (L'd' == chConversion || L'u' == chConversion) ? 10 : 16;
+            long long ll = (L'd' == chConversion) ? wcstoll(field.c_str(), &pwchEnd, nBase)
+                                                  : (long long)wcstoull(field.c_str(), &pwchEnd, nBase);
+            fStored = (L'\0' == *pwchEnd);
+            if (!fStored)
+            {
+                break;
+            }
+            if (fSize64)
+            {
+                *va_arg(vaArgs, long long*) = ll;
+            }
+            else if (L'h' == chSize)
+            {
+                *va_arg(vaArgs, short*) = (short)ll;
+            }
+            else
+            {
+                *va_arg(vaArgs, int*) = (int)ll;
+            }
+            break;
+        }
+        default:
+        {
+            long double ld = wcstold(field.c_str(), &pwchEnd);
+            fStored = (L'\0' == *pwchEnd);
+            if (!fStored)
+            {
+                break;
+            }
+            if (L'L' == chSize)
+            {
+                *va_arg(vaArgs, long double*) = ld;
+            }
+            else if (L'l' == chSize)
+            {
+                *va_arg(vaArgs, double*) = (double)ld;
+            }
+            else
+            {
+                *va_arg(vaArgs, float*) = (float)ld;
+            }
+            break;
+        }
+        }
+        if (!fStored)
+        {
+            break;
+        }
+        cAssigned++;
+    }
+    va_end(vaArgs);
+    return (fInputFailure && 0 == cAssigned) ? EOF : cAssigned;
+}
+
+int Win32ShimFwscanfS(__in FILE* pf, __in const wchar_t* pwzFormat, ...)
+{
+    va_list va;
+    va_start(va, pwzFormat);
+    int cAssigned = Win32ShimVfwscanfS(pf, pwzFormat, va);
+    va_end(va);
+    return cAssigned;
+}
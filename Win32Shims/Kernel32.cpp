@@ -0,0 +1,1261 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// kernel32, and psapi's GetProcessMemoryInfo, on POSIX: files, pipes and mappings are file
+// descriptors, processes are posix_spawn's, and modules are dlopen's.
+
+// The system's headers go first: the kernel's name fields __reserved, which windows.h's
+// annotations would erase.
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#include <windows.h>
+#include <psapi.h>
+#include "Win32Shims.h"
+
+extern char** environ;
+
+static thread_local DWORD s_dwLastError = ERROR_SUCCESS;
+static thread_local LANGID s_langidThreadUI = MAKELANGID(LANG_ENGLISH, SUBLANG_ENGLISH_US);
+
+//
+// Strings and errors.
+//
+
+std::string Win32ShimNarrow(const wchar_t* pwz, size_t cch)
+{
+    std::string s;
+    s.reserve(cch);
+    for (size_t ich = 0; ich < cch; ich++)
+    {
+        uint32_t ch = (uint32_t)pwz[ich];
+        if (ch > 0x10FFFF || (ch >= 0xD800 && ch <= 0xDFFF))
+        {
+            ch = 0xFFFD;
+        }
+        if (ch < 0x80)
+        {
+            s += (char)ch;
+        }
+        else if (ch < 0x800)
+        {
+            s += (char)(0xC0 | (ch >> 6));
+            s += (char)(0x80 | (ch & 0x3F));
+        }
+        else if (ch < 0x10000)
+        {
+            s += (char)(0xE0 | (ch >> 12));
+            s += (char)(0x80 | ((ch >> 6) & 0x3F));
+            s += (char)(0x80 | (ch & 0x3F));
+        }
+        else
+        {
+            s += (char)(0xF0 | (ch >> 18));
+            s += (char)(0x80 | ((ch >> 12) & 0x3F));
+            s += (char)(0x80 | ((ch >> 6) & 0x3F));
+            s += (char)(0x80 | (ch & 0x3F));
+        }
+    }
+    return s;
+}
+
+std::wstring Win32ShimWiden(const char* psz, size_t cb)
+{
+    std::wstring ws;
+    ws.reserve(cb);
+    for (size_t ib = 0; ib < cb; )
+    {
+        unsigned char b = (unsigned char)psz[ib];
+        size_t cbTrail;
+        uint32_t ch;
+        uint32_t chMin;
+        if (b < 0x80)
+        {
+            ws += (wchar_t)b;
+            ib++;
+            continue;
+        }
+        else if (b >= 0xC2 && b <= 0xDF)
+        {
+            cbTrail = 1;
+            chMin = 0x80;
+            ch = b & 0x1F;
+        }
+        else if (b >= 0xE0 && b <= 0xEF)
+        {
+            cbTrail = 2;
+            chMin = 0x800;
+            ch = b & 0x0F;
+        }
+        else if (b >= 0xF0 && b <= 0xF4)
+        {
+            cbTrail = 3;
+            chMin = 0x10000;
+            ch = b & 0x07;
+        }
+        else
+        {
+            ws += (wchar_t)0xFFFD;
+            ib++;
+            continue;
+        }
+
+        size_t i = 1;
+        for (; i <= cbTrail && ib + i < cb && (((unsigned char)psz[ib + i]) & 0xC0) == 0x80; i++)
+        {
+            ch = (ch << 6) | (((unsigned char)psz[ib + i]) & 0x3F);
+        }
+        if (i <= cbTrail || ch < chMin || ch > 0x10FFFF || (ch >= 0xD800 && ch <= 0xDFFF))
+        {
+            ws += (wchar_t)0xFFFD;
+        }
+        else
+        {
+            ws += (wchar_t)ch;
+        }
+        ib += i;
+    }
+    return ws;
+}
+
+DWORD Win32ShimErrorFromErrno(int err)
+{
+    switch (err)
+    {
+    case 0:
+        return ERROR_SUCCESS;
+    case ENOENT:
+        return ERROR_FILE_NOT_FOUND;
+    case ENOTDIR:
+        return ERROR_PATH_NOT_FOUND;
+    case EACCES:
+    case EPERM:
+    case EISDIR:
+        return ERROR_ACCESS_DENIED;
+    case EEXIST:
+        return ERROR_FILE_EXISTS;
+    case ENOMEM:
+        return ERROR_NOT_ENOUGH_MEMORY;
+    case ENOSPC:
+        return ERROR_DISK_FULL;
+    case EBADF:
+        return ERROR_INVALID_HANDLE;
+    case EINVAL:
+        return ERROR_INVALID_PARAMETER;
+    case EPIPE:
+        return ERROR_BROKEN_PIPE;
+    default:
+        return ERROR_GEN_FAILURE;
+    }
+}
+
+static BOOL _FailWithErrno()
+{
+    SetLastError(Win32ShimErrorFromErrno(errno));
+    return FALSE;
+}
+
+template <class T> static T* _ObjectOf(HANDLE h)
+{
+    if (NULL == h || INVALID_HANDLE_VALUE == h)
+    {
+        return NULL;
+    }
+    return dynamic_cast<T*>(static_cast<CShimObject*>(h));
+}
+
+static int _FdOf(HANDLE h)
+{
+    CShimFile* pFile = _ObjectOf<CShimFile>(h);
+    return pFile ? pFile->Fd() : -1;
+}
+
+DWORD WINAPI GetLastError()
+{
+    return s_dwLastError;
+}
+
+void WINAPI SetLastError(__in DWORD dwErrCode)
+{
+    s_dwLastError = dwErrCode;
+}
+
+//
+// Memory.
+//
+
+PVOID WINAPI SecureZeroMemory(__in PVOID ptr, __in SIZE_T cnt)
+{
+    explicit_bzero(ptr, cnt);
+    return ptr;
+}
+
+HANDLE WINAPI GetProcessHeap()
+{
+    static char s_chHeap;
+    return &s_chHeap;
+}
+
+LPVOID WINAPI HeapAlloc(__in HANDLE /*hHeap*/, __in DWORD dwFlags, __in SIZE_T dwBytes)
+{
+    // malloc(0) may return NULL, which HeapAlloc never does for a zero-byte block.
+    size_t cb = dwBytes ? dwBytes : 1;
+    return (dwFlags & HEAP_ZERO_MEMORY) ? calloc(1, cb) : malloc(cb);
+}
+
+BOOL WINAPI HeapFree(__in HANDLE /*hHeap*/, __in DWORD /*dwFlags*/, __in_opt LPVOID lpMem)
+{
+    free(lpMem);
+    return TRUE;
+}
+
+HLOCAL WINAPI LocalAlloc(__in UINT uFlags, __in SIZE_T uBytes)
+{
+    size_t cb = uBytes ? uBytes : 1;
+    HLOCAL h = (uFlags & LMEM_ZEROINIT) ? calloc(1, cb) : malloc(cb);
+    if (NULL == h)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+    }
+    return h;
+}
+
+HLOCAL WINAPI LocalFree(__in_opt HLOCAL hMem)
+{
+    free(hMem);
+    return NULL;
+}
+
+//
+// Files and pipes.
+//
+
+HANDLE WINAPI CreateFileW(__in LPCWSTR lpFileName, __in DWORD dwDesiredAccess, __in DWORD /*dwShareMode*/,
+    __in_opt LPSECURITY_ATTRIBUTES lpSecurityAttributes, __in DWORD dwCreationDisposition,
+    __in DWORD /*dwFlagsAndAttributes*/, __in_opt HANDLE /*hTemplateFile*/)
+{
+    int oflag = O_CLOEXEC;
+    if ((dwDesiredAccess & GENERIC_READ) && (dwDesiredAccess & GENERIC_WRITE))
+    {
+        oflag |= O_RDWR;
+    }
+    else if (dwDesiredAccess & GENERIC_WRITE)
+    {
+        oflag |= O_WRONLY;
+    }
+    else
+    {
+        oflag |= O_RDONLY;
+    }
+
+    switch (dwCreationDisposition)
+    {
+    case CREATE_NEW:
+        oflag |= O_CREAT | O_EXCL;
+        break;
+    case CREATE_ALWAYS:
+        oflag |= O_CREAT | O_TRUNC;
+        break;
+    case OPEN_EXISTING:
+        break;
+    case OPEN_ALWAYS:
+        oflag |= O_CREAT;
+        break;
+    case TRUNCATE_EXISTING:
+        oflag |= O_TRUNC;
+        break;
+    default:
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    // The name is used as it is: a backslash is just another character in a POSIX name.
+    std::string path = Win32ShimNarrow(lpFileName);
+    bool fExisted = (0 == access(path.c_str(), F_OK));
+    int fd = open(path.c_str(), oflag, 0666);
+    if (fd < 0)
+    {
+        _FailWithErrno();
+        return INVALID_HANDLE_VALUE;
+    }
+
+    // Windows opens a directory only with FILE_FLAG_BACKUP_SEMANTICS, which nothing here uses.
+    struct stat st;
+    if (0 == fstat(fd, &st) && S_ISDIR(st.st_mode))
+    {
+        close(fd);
+        SetLastError(ERROR_ACCESS_DENIED);
+        return INVALID_HANDLE_VALUE;
+    }
+    if (lpSecurityAttributes && lpSecurityAttributes->bInheritHandle)
+    {
+        fcntl(fd, F_SETFD, 0);
+    }
+
+    bool fReportExisted = fExisted && (CREATE_ALWAYS == dwCreationDisposition || OPEN_ALWAYS == dwCreationDisposition);
+    SetLastError(fReportExisted ? ERROR_ALREADY_EXISTS : ERROR_SUCCESS);
+    return new CShimFile(fd);
+}
+
+BOOL WINAPI ReadFile(__in HANDLE hFile, __out_bcount(nNumberOfBytesToRead) LPVOID lpBuffer,
+    __in DWORD nNumberOfBytesToRead, __out_opt LPDWORD lpNumberOfBytesRead, __inout_opt LPOVERLAPPED lpOverlapped)
+{
+    if (lpNumberOfBytesRead)
+    {
+        *lpNumberOfBytesRead = 0;
+    }
+    int fd = _FdOf(hFile);
+    if (fd < 0 || lpOverlapped)
+    {
+        SetLastError(fd < 0 ? ERROR_INVALID_HANDLE : ERROR_NOT_SUPPORTED);
+        return FALSE;
+    }
+
+    // A pipe's read returns what has been written so far, as on Windows, and fails once the
+    // other end is closed; a file's fills the buffer unless it reaches the end.
+    struct stat st;
+    bool fPipe = (0 == fstat(fd, &st)) && (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode));
+    BYTE* pb = static_cast<BYTE*>(lpBuffer);
+    DWORD cbRead = 0;
+    while (cbRead < nNumberOfBytesToRead)
+    {
+        ssize_t cb = read(fd, pb + cbRead, nNumberOfBytesToRead - cbRead);
+        if (cb < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return _FailWithErrno();
+        }
+        if (0 == cb)
+        {
+            if (fPipe && 0 == cbRead && nNumberOfBytesToRead > 0)
+            {
+                SetLastError(ERROR_BROKEN_PIPE);
+                return FALSE;
+            }
+            break;
+        }
+        cbRead += (DWORD)cb;
+        if (fPipe)
+        {
+            break;
+        }
+    }
+    if (lpNumberOfBytesRead)
+    {
+        *lpNumberOfBytesRead = cbRead;
+    }
+    return TRUE;
+}
+
+BOOL WINAPI WriteFile(__in HANDLE hFile, __in_bcount(nNumberOfBytesToWrite) LPCVOID lpBuffer,
+    __in DWORD nNumberOfBytesToWrite, __out_opt LPDWORD lpNumberOfBytesWritten, __inout_opt LPOVERLAPPED lpOverlapped)
+{
+    if (lpNumberOfBytesWritten)
+    {
+        *lpNumberOfBytesWritten = 0;
+    }
+    int fd = _FdOf(hFile);
+    if (fd < 0 || lpOverlapped)
+    {
+        SetLastError(fd < 0 ? ERROR_INVALID_HANDLE : ERROR_NOT_SUPPORTED);
+        return FALSE;
+    }
+
+    const BYTE* pb = static_cast<const BYTE*>(lpBuffer);
+    DWORD cbWritten = 0;
+    while (cbWritten < nNumberOfBytesToWrite)
+    {
+        ssize_t cb = write(fd, pb + cbWritten, nNumberOfBytesToWrite - cbWritten);
+        if (cb < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return _FailWithErrno();
+        }
+        cbWritten += (DWORD)cb;
+        if (lpNumberOfBytesWritten)
+        {
+            *lpNumberOfBytesWritten = cbWritten;
+        }
+    }
+    return TRUE;
+}
+
+BOOL WINAPI GetFileSizeEx(__in HANDLE hFile, __out PLARGE_INTEGER lpFileSize)
+{
+    struct stat st;
+    int fd = _FdOf(hFile);
+    if (fd < 0)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+    if (0 != fstat(fd, &st))
+    {
+        return _FailWithErrno();
+    }
+    lpFileSize->QuadPart = st.st_size;
+    return TRUE;
+}
+
+// FILETIMEs count 100ns intervals from 1601, 11644473600 seconds before the POSIX epoch.
+static FILETIME _FileTimeOf(const struct timespec& ts)
+{
+    ULARGE_INTEGER uli;
+    uli.QuadPart = ((ULONGLONG)ts.tv_sec + 11644473600ULL) * 10000000ULL + (ULONGLONG)ts.tv_nsec / 100;
+    FILETIME ft = { uli.LowPart, uli.HighPart };
+    return ft;
+}
+
+BOOL WINAPI GetFileAttributesExW(__in LPCWSTR lpFileName, __in GET_FILEEX_INFO_LEVELS fInfoLevelId,
+    __out LPVOID lpFileInformation)
+{
+    if (GetFileExInfoStandard != fInfoLevelId)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+    struct stat st;
+    if (0 != stat(Win32ShimNarrow(lpFileName).c_str(), &st))
+    {
+        return _FailWithErrno();
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA* pfad = static_cast<WIN32_FILE_ATTRIBUTE_DATA*>(lpFileInformation);
+    pfad->dwFileAttributes = S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+    if (!(st.st_mode & S_IWUSR))
+    {
+        pfad->dwFileAttributes = (pfad->dwFileAttributes & ~FILE_ATTRIBUTE_NORMAL) | FILE_ATTRIBUTE_READONLY;
+    }
+    pfad->ftCreationTime = _FileTimeOf(st.st_ctim);
+    pfad->ftLastAccessTime = _FileTimeOf(st.st_atim);
+    pfad->ftLastWriteTime = _FileTimeOf(st.st_mtim);
+    pfad->nFileSizeHigh = (DWORD)((ULONGLONG)st.st_size >> 32);
+    pfad->nFileSizeLow = (DWORD)st.st_size;
+    return TRUE;
+}
+
+BOOL WINAPI DeleteFileW(__in LPCWSTR lpFileName)
+{
+    return (0 == unlink(Win32ShimNarrow(lpFileName).c_str())) ? TRUE : _FailWithErrno();
+}
+
+DWORD WINAPI GetTempPathW(__in DWORD nBufferLength, __out_ecount(nBufferLength) LPWSTR lpBuffer)
+{
+    const char* pszTmp = getenv("TMPDIR");
+    std::wstring path = Win32ShimWiden((pszTmp && *pszTmp) ? pszTmp : "/tmp");
+    if (L'/' != path.back())
+    {
+        path += L'/';
+    }
+    if (path.size() >= nBufferLength)
+    {
+        return (DWORD)path.size() + 1;
+    }
+    wcscpy(lpBuffer, path.c_str());
+    return (DWORD)path.size();
+}
+
+static CShimFile* _StdFile(int fd)
+{
+    static CShimFile* s_rgpFile[3] = { new CShimFile(0), new CShimFile(1), new CShimFile(2) };
+    return (fd >= 0 && fd < 3) ? s_rgpFile[fd] : NULL;
+}
+
+BOOL WINAPI CloseHandle(__in HANDLE hObject)
+{
+    if (NULL == hObject || INVALID_HANDLE_VALUE == hObject)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+    // The standard handles are the process's for as long as it runs.
+    CShimObject* pObject = static_cast<CShimObject*>(hObject);
+    for (int fd = 0; fd < 3; fd++)
+    {
+        if (pObject == _StdFile(fd))
+        {
+            return TRUE;
+        }
+    }
+    delete pObject;
+    return TRUE;
+}
+
+BOOL WINAPI SetHandleInformation(__in HANDLE hObject, __in DWORD dwMask, __in DWORD dwFlags)
+{
+    int fd = _FdOf(hObject);
+    if (fd < 0)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+    if (dwMask & HANDLE_FLAG_INHERIT)
+    {
+        if (0 != fcntl(fd, F_SETFD, (dwFlags & HANDLE_FLAG_INHERIT) ? 0 : FD_CLOEXEC))
+        {
+            return _FailWithErrno();
+        }
+    }
+    return TRUE;
+}
+
+HANDLE WINAPI GetStdHandle(__in DWORD nStdHandle)
+{
+    switch (nStdHandle)
+    {
+    case STD_INPUT_HANDLE:
+        return _StdFile(0);
+    case STD_OUTPUT_HANDLE:
+        return _StdFile(1);
+    case STD_ERROR_HANDLE:
+        return _StdFile(2);
+    }
+    SetLastError(ERROR_INVALID_HANDLE);
+    return INVALID_HANDLE_VALUE;
+}
+
+BOOL WINAPI CreatePipe(__out PHANDLE hReadPipe, __out PHANDLE hWritePipe,
+    __in_opt LPSECURITY_ATTRIBUTES lpPipeAttributes, __in DWORD /*nSize*/)
+{
+    int rgfd[2];
+    if (0 != pipe2(rgfd, O_CLOEXEC))
+    {
+        return _FailWithErrno();
+    }
+    if (lpPipeAttributes && lpPipeAttributes->bInheritHandle)
+    {
+        fcntl(rgfd[0], F_SETFD, 0);
+        fcntl(rgfd[1], F_SETFD, 0);
+    }
+    *hReadPipe = new CShimFile(rgfd[0]);
+    *hWritePipe = new CShimFile(rgfd[1]);
+    return TRUE;
+}
+
+//
+// Mappings.
+//
+
+static std::mutex s_mutexViews;
+static std::map<LPCVOID, size_t> s_mapViews;
+
+HANDLE WINAPI CreateFileMappingW(__in HANDLE hFile, __in_opt LPSECURITY_ATTRIBUTES /*lpFileMappingAttributes*/,
+    __in DWORD flProtect, __in DWORD dwMaximumSizeHigh, __in DWORD dwMaximumSizeLow, __in_opt LPCWSTR lpName)
+{
+    // A named mapping is shared between processes by name, which nothing here needs.
+    if (lpName)
+    {
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return NULL;
+    }
+
+    bool fWritable = (PAGE_READWRITE == flProtect);
+    ULARGE_INTEGER uliSize;
+    uliSize.HighPart = dwMaximumSizeHigh;
+    uliSize.LowPart = dwMaximumSizeLow;
+
+    int fd;
+    if (INVALID_HANDLE_VALUE == hFile)
+    {
+        if (0 == uliSize.QuadPart)
+        {
+            SetLastError(ERROR_INVALID_PARAMETER);
+            return NULL;
+        }
+        fd = memfd_create("Win32ShimMapping", MFD_CLOEXEC);
+        if (fd < 0 || 0 != ftruncate(fd, (off_t)uliSize.QuadPart))
+        {
+            _FailWithErrno();
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return NULL;
+        }
+        return new CShimMapping(fd, (size_t)uliSize.QuadPart, true);
+    }
+
+    int fdFile = _FdOf(hFile);
+    struct stat st;
+    if (fdFile < 0)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return NULL;
+    }
+    if (0 != fstat(fdFile, &st))
+    {
+        _FailWithErrno();
+        return NULL;
+    }
+
+    // As on Windows, a writable mapping larger than its file grows the file to its size, and
+    // a mapping of an empty file needs a size.
+    if (0 == uliSize.QuadPart)
+    {
+        uliSize.QuadPart = (ULONGLONG)st.st_size;
+        if (0 == uliSize.QuadPart)
+        {
+            SetLastError(ERROR_FILE_INVALID);
+            return NULL;
+        }
+    }
+    else if (uliSize.QuadPart > (ULONGLONG)st.st_size)
+    {
+        if (!fWritable)
+        {
+            SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+            return NULL;
+        }
+        if (0 != ftruncate(fdFile, (off_t)uliSize.QuadPart))
+        {
+            _FailWithErrno();
+            return NULL;
+        }
+    }
+
+    fd = fcntl(fdFile, F_DUPFD_CLOEXEC, 3);
+    if (fd < 0)
+    {
+        _FailWithErrno();
+        return NULL;
+    }
+    return new CShimMapping(fd, (size_t)uliSize.QuadPart, fWritable);
+}
+
+LPVOID WINAPI MapViewOfFile(__in HANDLE hFileMappingObject, __in DWORD dwDesiredAccess,
+    __in DWORD dwFileOffsetHigh, __in DWORD dwFileOffsetLow, __in SIZE_T dwNumberOfBytesToMap)
+{
+    CShimMapping* pMapping = _ObjectOf<CShimMapping>(hFileMappingObject);
+    if (NULL == pMapping)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return NULL;
+    }
+
+    ULARGE_INTEGER uliOffset;
+    uliOffset.HighPart = dwFileOffsetHigh;
+    uliOffset.LowPart = dwFileOffsetLow;
+    bool fWrite = (0 != (dwDesiredAccess & FILE_MAP_WRITE));
+    if ((fWrite && !pMapping->Writable()) || uliOffset.QuadPart > pMapping->Size())
+    {
+        SetLastError(fWrite && !pMapping->Writable() ? ERROR_ACCESS_DENIED : ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+    size_t cb = dwNumberOfBytesToMap ? dwNumberOfBytesToMap : pMapping->Size() - (size_t)uliOffset.QuadPart;
+
+    void* pv = mmap(NULL, cb, fWrite ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, pMapping->Fd(),
+        (off_t)uliOffset.QuadPart);
+    if (MAP_FAILED == pv)
+    {
+        _FailWithErrno();
+        return NULL;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutexViews);
+    s_mapViews[pv] = cb;
+    return pv;
+}
+
+BOOL WINAPI UnmapViewOfFile(__in LPCVOID lpBaseAddress)
+{
+    size_t cb;
+    {
+        std::lock_guard<std::mutex> lock(s_mutexViews);
+        std::map<LPCVOID, size_t>::iterator it = s_mapViews.find(lpBaseAddress);
+        if (s_mapViews.end() == it)
+        {
+            SetLastError(ERROR_INVALID_PARAMETER);
+            return FALSE;
+        }
+        cb = it->second;
+        s_mapViews.erase(it);
+    }
+    return (0 == munmap(const_cast<LPVOID>(lpBaseAddress), cb)) ? TRUE : _FailWithErrno();
+}
+
+//
+// Processes.
+//
+
+bool CShimProcess::Reap(bool fWait)
+{
+    while (!_fExited)
+    {
+        int status;
+        pid_t pid = waitpid(_pid, &status, fWait ? 0 : WNOHANG);
+        if (pid == _pid)
+        {
+            _fExited = true;
+            _status = status;
+        }
+        else if (0 == pid || EINTR != errno)
+        {
+            break;
+        }
+    }
+    return _fExited;
+}
+
+DWORD WINAPI WaitForSingleObject(__in HANDLE hHandle, __in DWORD dwMilliseconds)
+{
+    CShimProcess* pProcess = _ObjectOf<CShimProcess>(hHandle);
+    if (NULL == pProcess)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return WAIT_FAILED;
+    }
+    if (INFINITE == dwMilliseconds)
+    {
+        return pProcess->Reap(true) ? WAIT_OBJECT_0 : WAIT_FAILED;
+    }
+
+    ULONGLONG ullDeadline = GetTickCount64() + dwMilliseconds;
+    while (!pProcess->Reap(false))
+    {
+        if (GetTickCount64() >= ullDeadline)
+        {
+            return WAIT_TIMEOUT;
+        }
+        Sleep(1);
+    }
+    return WAIT_OBJECT_0;
+}
+
+void WINAPI Sleep(__in DWORD dwMilliseconds)
+{
+    struct timespec ts = { (time_t)(dwMilliseconds / 1000), (long)(dwMilliseconds % 1000) * 1000000L };
+    while (0 != nanosleep(&ts, &ts) && EINTR == errno)
+    {
+    }
+}
+
+// Splits a command line as CommandLineToArgvW does: the program name ends at the first
+// space unless it is quoted, and in the arguments after it 2n backslashes before a quote
+// are n backslashes and the quote delimits, 2n + 1 are n and a literal quote.
+static std::vector<std::string> _SplitCommandLine(const wchar_t* pwz)
+{
+    std::vector<std::string> rgArg;
+    std::wstring arg;
+    const wchar_t* pwch = pwz;
+
+    if (L'"' == *pwch)
+    {
+        for (pwch++; *pwch && L'"' != *pwch; pwch++)
+        {
+            arg += *pwch;
+        }
+        if (*pwch)
+        {
+            pwch++;
+        }
+    }
+    else
+    {
+        for (; *pwch && L' ' != *pwch && L'\t' != *pwch; pwch++)
+        {
+            arg += *pwch;
+        }
+    }
+    rgArg.push_back(Win32ShimNarrow(arg.c_str(), arg.size()));
+
+    for (;;)
+    {
+        while (L' ' == *pwch || L'\t' == *pwch)
+        {
+            pwch++;
+        }
+        if (!*pwch)
+        {
+            break;
+        }
+
+        arg.clear();
+        bool fQuoted = false;
+        for (; *pwch && (fQuoted || (L' ' != *pwch && L'\t' != *pwch)); )
+        {
+            size_t cBackslash = 0;
+            while (L'\\' == *pwch)
+            {
+                cBackslash++;
+                pwch++;
+            }
+            if (L'"' == *pwch)
+            {
+                arg.append(cBackslash / 2, L'\\');
+                if (cBackslash % 2)
+                {
+                    arg += L'"';
+                }
+                else if (fQuoted && L'"' == pwch[1])
+                {
+                    arg += L'"';
+                    pwch++;
+                }
+                else
+                {
+                    fQuoted = !fQuoted;
+                }
+                pwch++;
+            }
+            else
+            {
+                arg.append(cBackslash, L'\\');
+                if (*pwch && (fQuoted || (L' ' != *pwch && L'\t' != *pwch)))
+                {
+                    arg += *pwch++;
+                }
+            }
+        }
+        rgArg.push_back(Win32ShimNarrow(arg.c_str(), arg.size()));
+    }
+    return rgArg;
+}
+
+BOOL WINAPI CreateProcessW(__in_opt LPCWSTR lpApplicationName, __inout_opt LPWSTR lpCommandLine,
+    __in_opt LPSECURITY_ATTRIBUTES /*lpProcessAttributes*/, __in_opt LPSECURITY_ATTRIBUTES /*lpThreadAttributes*/,
+    __in BOOL /*bInheritHandles*/, __in DWORD /*dwCreationFlags*/, __in_opt LPVOID lpEnvironment,
+    __in_opt LPCWSTR lpCurrentDirectory, __in LPSTARTUPINFOW lpStartupInfo,
+    __out LPPROCESS_INFORMATION lpProcessInformation)
+{
+    if (lpEnvironment || lpCurrentDirectory || (NULL == lpApplicationName && NULL == lpCommandLine))
+    {
+        SetLastError((lpEnvironment || lpCurrentDirectory) ? ERROR_NOT_SUPPORTED : ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    std::vector<std::string> rgArg = _SplitCommandLine(lpCommandLine ? lpCommandLine : lpApplicationName);
+    std::vector<char*> rgpszArg;
+    for (size_t i = 0; i < rgArg.size(); i++)
+    {
+        rgpszArg.push_back(&rgArg[i][0]);
+    }
+    rgpszArg.push_back(NULL);
+
+    // Handles are inherited when they are not close-on-exec, which only an inheritable
+    // handle's file descriptor is not.
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    if (lpStartupInfo->dwFlags & STARTF_USESTDHANDLES)
+    {
+        HANDLE rgh[3] = { lpStartupInfo->hStdInput, lpStartupInfo->hStdOutput, lpStartupInfo->hStdError };
+        for (int fdStd = 0; fdStd < 3; fdStd++)
+        {
+            int fd = _FdOf(rgh[fdStd]);
+            if (fd >= 0)
+            {
+                posix_spawn_file_actions_adddup2(&fa, fd, fdStd);
+            }
+        }
+    }
+
+    pid_t pid;
+    int err;
+    if (lpApplicationName)
+    {
+        std::string path = Win32ShimNarrow(lpApplicationName);
+        err = posix_spawn(&pid, path.c_str(), &fa, NULL, &rgpszArg[0], environ);
+    }
+    else
+    {
+        err = posix_spawnp(&pid, rgpszArg[0], &fa, NULL, &rgpszArg[0], environ);
+    }
+    posix_spawn_file_actions_destroy(&fa);
+    if (0 != err)
+    {
+        SetLastError(Win32ShimErrorFromErrno(err));
+        return FALSE;
+    }
+
+    lpProcessInformation->hProcess = new CShimProcess(pid);
+    lpProcessInformation->hThread = new CShimObject();
+    lpProcessInformation->dwProcessId = (DWORD)pid;
+    lpProcessInformation->dwThreadId = (DWORD)pid;
+    return TRUE;
+}
+
+BOOL WINAPI GetExitCodeProcess(__in HANDLE hProcess, __out LPDWORD lpExitCode)
+{
+    CShimProcess* pProcess = _ObjectOf<CShimProcess>(hProcess);
+    if (NULL == pProcess)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+    if (!pProcess->Reap(false))
+    {
+        *lpExitCode = STILL_ACTIVE;
+    }
+    else if (WIFSIGNALED(pProcess->Status()))
+    {
+        // As a POSIX shell reports a process a signal ended.
+        *lpExitCode = 128 + WTERMSIG(pProcess->Status());
+    }
+    else
+    {
+        *lpExitCode = WEXITSTATUS(pProcess->Status());
+    }
+    return TRUE;
+}
+
+HANDLE WINAPI GetCurrentProcess()
+{
+    return (HANDLE)(LONG_PTR)-1;
+}
+
+DWORD WINAPI GetCurrentProcessId()
+{
+    return (DWORD)getpid();
+}
+
+DWORD WINAPI GetCurrentThreadId()
+{
+    return (DWORD)syscall(SYS_gettid);
+}
+
+//
+// Modules.
+//
+
+typedef BOOL (WINAPI *PFNDLLMAIN)(HINSTANCE, DWORD, LPVOID);
+
+static std::mutex s_mutexModules;
+static std::map<void*, int> s_mapAttached;
+
+static std::string _ExecutableDirectory()
+{
+    char szPath[PATH_MAX];
+    ssize_t cch = readlink("/proc/self/exe", szPath, sizeof(szPath) - 1);
+    if (cch <= 0)
+    {
+        return std::string();
+    }
+    std::string path(szPath, (size_t)cch);
+    return path.substr(0, path.rfind('/') + 1);
+}
+
+// dlopens the module, next to the executable first if its name has no directory in it.
+static void* _OpenModule(LPCWSTR lpLibFileName, int flags)
+{
+    std::string name = Win32ShimNarrow(lpLibFileName);
+    std::string path = name;
+    if (std::string::npos == name.find('/'))
+    {
+        std::string local = _ExecutableDirectory() + name;
+        if (0 == access(local.c_str(), F_OK))
+        {
+            path = local;
+        }
+    }
+
+    void* h = dlopen(path.c_str(), flags);
+    if (NULL == h)
+    {
+        if (0 == access(path.c_str(), F_OK))
+        {
+            // It is there but will not load; say why, as the Windows loader's event would.
+            fprintf(stderr, "%s\n", dlerror());
+            SetLastError(ERROR_BAD_EXE_FORMAT);
+        }
+        else
+        {
+            SetLastError(ERROR_MOD_NOT_FOUND);
+        }
+    }
+    return h;
+}
+
+HMODULE WINAPI LoadLibraryW(__in LPCWSTR lpLibFileName)
+{
+    std::lock_guard<std::mutex> lock(s_mutexModules);
+    void* h = _OpenModule(lpLibFileName, RTLD_NOW | RTLD_LOCAL);
+    if (NULL == h)
+    {
+        return NULL;
+    }
+
+    // Like the Windows loader, call DllMain once, when the module is first loaded.
+    if (1 == ++s_mapAttached[h])
+    {
+        PFNDLLMAIN pfnDllMain = reinterpret_cast<PFNDLLMAIN>(dlsym(h, "DllMain"));
+        if (pfnDllMain && !pfnDllMain(static_cast<HINSTANCE>(h), DLL_PROCESS_ATTACH, NULL))
+        {
+            s_mapAttached.erase(h);
+            dlclose(h);
+            SetLastError(ERROR_DLL_INIT_FAILED);
+            return NULL;
+        }
+    }
+    return static_cast<HMODULE>(h);
+}
+
+HMODULE WINAPI LoadLibraryExW(__in LPCWSTR lpLibFileName, __reserved HANDLE hFile, __in DWORD dwFlags)
+{
+    if (hFile || (dwFlags & ~(LOAD_LIBRARY_AS_DATAFILE | LOAD_LIBRARY_AS_IMAGE_RESOURCE)))
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+    if (0 == dwFlags)
+    {
+        return LoadLibraryW(lpLibFileName);
+    }
+
+    // Loaded only for its resources: no DllMain, and a handle FreeLibrary can tell apart.
+    void* h = _OpenModule(lpLibFileName, RTLD_LAZY | RTLD_LOCAL);
+    if (NULL == h)
+    {
+        return NULL;
+    }
+    return reinterpret_cast<HMODULE>(reinterpret_cast<ULONG_PTR>(h) | WIN32_SHIM_DATAFILE_TAG);
+}
+
+BOOL WINAPI FreeLibrary(__in HMODULE hLibModule)
+{
+    void* h = Win32ShimModuleHandle(hLibModule);
+    if (NULL == h)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+    if (h == static_cast<void*>(hLibModule))
+    {
+        std::lock_guard<std::mutex> lock(s_mutexModules);
+        std::map<void*, int>::iterator it = s_mapAttached.find(h);
+        if (s_mapAttached.end() != it && 0 == --it->second)
+        {
+            s_mapAttached.erase(it);
+            PFNDLLMAIN pfnDllMain = reinterpret_cast<PFNDLLMAIN>(dlsym(h, "DllMain"));
+            if (pfnDllMain)
+            {
+                pfnDllMain(static_cast<HINSTANCE>(h), DLL_PROCESS_DETACH, NULL);
+            }
+        }
+    }
+    return (0 == dlclose(h)) ? TRUE : (SetLastError(ERROR_INVALID_HANDLE), FALSE);
+}
+
+FARPROC WINAPI GetProcAddress(__in HMODULE hModule, __in LPCSTR lpProcName)
+{
+    void* pv = dlsym(Win32ShimModuleHandle(hModule), lpProcName);
+    if (NULL == pv)
+    {
+        SetLastError(ERROR_PROC_NOT_FOUND);
+    }
+    return reinterpret_cast<FARPROC>(pv);
+}
+
+DWORD WINAPI GetModuleFileNameW(__in_opt HMODULE hModule, __out_ecount(nSize) LPWSTR lpFilename, __in DWORD nSize)
+{
+    std::string path;
+    struct link_map* plm = NULL;
+    if (hModule && 0 == dlinfo(Win32ShimModuleHandle(hModule), RTLD_DI_LINKMAP, &plm) && plm->l_name[0])
+    {
+        path = plm->l_name;
+    }
+    else
+    {
+        char szPath[PATH_MAX];
+        ssize_t cch = readlink("/proc/self/exe", szPath, sizeof(szPath) - 1);
+        if (cch <= 0)
+        {
+            _FailWithErrno();
+            return 0;
+        }
+        path.assign(szPath, (size_t)cch);
+    }
+
+    std::wstring wpath = Win32ShimWiden(path.c_str(), path.size());
+    if (0 == nSize)
+    {
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return 0;
+    }
+    if (wpath.size() >= nSize)
+    {
+        // Cut short and terminated, as Windows does since Vista.
+        wmemcpy(lpFilename, wpath.c_str(), nSize - 1);
+        lpFilename[nSize - 1] = L'\0';
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return nSize;
+    }
+    wcscpy(lpFilename, wpath.c_str());
+    return (DWORD)wpath.size();
+}
+
+BOOL WINAPI DisableThreadLibraryCalls(__in HMODULE /*hLibModule*/)
+{
+    // No thread attach and detach calls are ever made.
+    return TRUE;
+}
+
+//
+// Time.
+//
+
+BOOL WINAPI QueryPerformanceCounter(__out LARGE_INTEGER* lpPerformanceCount)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    lpPerformanceCount->QuadPart = (LONGLONG)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    return TRUE;
+}
+
+BOOL WINAPI QueryPerformanceFrequency(__out LARGE_INTEGER* lpFrequency)
+{
+    lpFrequency->QuadPart = 1000000000LL;
+    return TRUE;
+}
+
+ULONGLONG WINAPI GetTickCount64()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ULONGLONG)ts.tv_sec * 1000ULL + (ULONGLONG)ts.tv_nsec / 1000000ULL;
+}
+
+void WINAPI GetLocalTime(__out LPSYSTEMTIME lpSystemTime)
+{
+    struct timespec ts;
+    struct tm tm;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    localtime_r(&ts.tv_sec, &tm);
+    lpSystemTime->wYear = (WORD)(tm.tm_year + 1900);
+    lpSystemTime->wMonth = (WORD)(tm.tm_mon + 1);
+    lpSystemTime->wDayOfWeek = (WORD)tm.tm_wday;
+    lpSystemTime->wDay = (WORD)tm.tm_mday;
+    lpSystemTime->wHour = (WORD)tm.tm_hour;
+    lpSystemTime->wMinute = (WORD)tm.tm_min;
+    lpSystemTime->wSecond = (WORD)tm.tm_sec;
+    lpSystemTime->wMilliseconds = (WORD)(ts.tv_nsec / 1000000);
+}
+
+//
+// The machine, languages and strings.
+//
+
+BOOL WINAPI GetComputerNameW(__out_ecount(*nSize) LPWSTR lpBuffer, __inout LPDWORD nSize)
+{
+    // The NetBIOS name: the host name up to its first dot, upper-cased and at most
+    // MAX_COMPUTERNAME_LENGTH characters.
+    char szHost[256];
+    if (0 != gethostname(szHost, sizeof(szHost)))
+    {
+        return _FailWithErrno();
+    }
+    szHost[sizeof(szHost) - 1] = '\0';
+    std::wstring name = Win32ShimWiden(szHost, strcspn(szHost, "."));
+    if (name.size() > MAX_COMPUTERNAME_LENGTH)
+    {
+        name.resize(MAX_COMPUTERNAME_LENGTH);
+    }
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        name[i] = (wchar_t)towupper(name[i]);
+    }
+
+    if (*nSize <= name.size())
+    {
+        *nSize = (DWORD)name.size() + 1;
+        SetLastError(ERROR_BUFFER_OVERFLOW);
+        return FALSE;
+    }
+    wcscpy(lpBuffer, name.c_str());
+    *nSize = (DWORD)name.size();
+    return TRUE;
+}
+
+LANGID WINAPI GetThreadUILanguage()
+{
+    return s_langidThreadUI;
+}
+
+LANGID WINAPI SetThreadUILanguage(__in LANGID LangId)
+{
+    if (0 != LangId)
+    {
+        s_langidThreadUI = LangId;
+    }
+    return s_langidThreadUI;
+}
+
+int WINAPI lstrlenA(__in_opt LPCSTR lpString)
+{
+    return lpString ? (int)strlen(lpString) : 0;
+}
+
+int WINAPI lstrlenW(__in_opt LPCWSTR lpString)
+{
+    return lpString ? (int)wcslen(lpString) : 0;
+}
+
+int WINAPI lstrcmpW(__in LPCWSTR lpString1, __in LPCWSTR lpString2)
+{
+    int n = wcscmp(lpString1, lpString2);
+    return (n > 0) - (n < 0);
+}
+
+int WINAPI lstrcmpiW(__in LPCWSTR lpString1, __in LPCWSTR lpString2)
+{
+    int n = wcscasecmp(lpString1, lpString2);
+    return (n > 0) - (n < 0);
+}
+
+//
+// psapi.
+//
+
+BOOL WINAPI GetProcessMemoryInfo(__in HANDLE Process, __out_bcount(cb) PPROCESS_MEMORY_COUNTERS ppsmemCounters,
+    __in DWORD cb)
+{
+    if (GetCurrentProcess() != Process || cb < sizeof(PROCESS_MEMORY_COUNTERS))
+    {
+        SetLastError(GetCurrentProcess() != Process ? ERROR_NOT_SUPPORTED : ERROR_INSUFFICIENT_BUFFER);
+        return FALSE;
+    }
+    memset(ppsmemCounters, 0, cb);
+    ppsmemCounters->cb = cb;
+    if (cb < sizeof(PROCESS_MEMORY_COUNTERS_EX))
+    {
+        return TRUE;
+    }
+
+    // A process's private bytes are its anonymous memory, which /proc counts in kB.
+    FILE* pf = fopen("/proc/self/status", "re");
+    if (NULL == pf)
+    {
+        return _FailWithErrno();
+    }
+    char szLine[256];
+    unsigned long ulKb;
+    while (fgets(szLine, sizeof(szLine), pf))
+    {
+        if (1 == sscanf(szLine, "RssAnon: %lu kB", &ulKb))
+        {
+            reinterpret_cast<PROCESS_MEMORY_COUNTERS_EX*>(ppsmemCounters)->PrivateUsage = (SIZE_T)ulKb * 1024;
+            break;
+        }
+    }
+    fclose(pf);
+    return TRUE;
+}
@@ -0,0 +1,35 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The entry point of a program built against the Win32 shims: calls its wmain with the
+// command line widened from UTF-8, as the C runtime calls it on Windows.
+
+#include <windows.h>
+#include <locale.h>
+#include "Win32Shims.h"
+
+int wmain(int argc, wchar_t** argv);
+
+int main(int argc, char** argv)
+{
+    // Narrow strings the program formats with %S are UTF-8, as its arguments are.
+    setlocale(LC_CTYPE, "C.UTF-8");
+
+    std::vector<std::wstring> rgArg;
+    std::vector<wchar_t*> rgpwzArg;
+    for (int i = 0; i < argc; i++)
+    {
+        rgArg.push_back(Win32ShimWiden(argv[i]));
+    }
+    for (int i = 0; i < argc; i++)
+    {
+        rgpwzArg.push_back(&rgArg[i][0]);
+    }
+    rgpwzArg.push_back(NULL);
+    return wmain(argc, &rgpwzArg[0]);
+}
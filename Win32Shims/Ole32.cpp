@@ -0,0 +1,104 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// ole32's COM library, and shlwapi's QISearch and string helpers, on POSIX, with the IIDs
+// of the interfaces the shim headers declare.  Task memory is the C library's heap.
+
+#include <windows.h>
+#include <unknwn.h>
+#include <objbase.h>
+#include <shlwapi.h>
+#include <credentialprovider.h>
+
+EXTERN_C const GUID GUID_NULL = { 0x00000000, 0x0000, 0x0000, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } };
+EXTERN_C const IID IID_IUnknown = { 0x00000000, 0x0000, 0x0000, { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 } };
+EXTERN_C const IID IID_IClassFactory = { 0x00000001, 0x0000, 0x0000, { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 } };
+EXTERN_C const IID IID_ICredentialProviderCredentialEvents =
+    { 0xfa6fa76b, 0x66b7, 0x4b11, { 0x95, 0xf1, 0x86, 0x17, 0x11, 0x18, 0xe8, 0x16 } };
+EXTERN_C const IID IID_ICredentialProviderCredential =
+    { 0x63913a93, 0x40c1, 0x481a, { 0x81, 0x8d, 0x40, 0x72, 0xff, 0x8c, 0x70, 0xcc } };
+EXTERN_C const IID IID_ICredentialProviderEvents =
+    { 0x34201e5a, 0xa787, 0x41a3, { 0xa5, 0xa4, 0xbd, 0x6d, 0xcf, 0x2a, 0x85, 0x4e } };
+EXTERN_C const IID IID_ICredentialProvider =
+    { 0xd27c3481, 0x5a1c, 0x45b2, { 0x8a, 0xaa, 0xc2, 0x0e, 0xbb, 0xe8, 0x22, 0x9e } };
+
+// How many times this thread has initialized COM without uninitializing it.
+static thread_local ULONG s_cInitialized = 0;
+
+HRESULT STDAPICALLTYPE CoInitializeEx(__in_opt LPVOID /*pvReserved*/, __in DWORD /*dwCoInit*/)
+{
+    return (0 == s_cInitialized++) ? S_OK : S_FALSE;
+}
+
+void STDAPICALLTYPE CoUninitialize()
+{
+    if (s_cInitialized > 0)
+    {
+        s_cInitialized--;
+    }
+}
+
+LPVOID STDAPICALLTYPE CoTaskMemAlloc(__in SIZE_T cb)
+{
+    return malloc(cb ? cb : 1);
+}
+
+LPVOID STDAPICALLTYPE CoTaskMemRealloc(__in_opt LPVOID pv, __in SIZE_T cb)
+{
+    return realloc(pv, cb ? cb : 1);
+}
+
+void STDAPICALLTYPE CoTaskMemFree(__in_opt LPVOID pv)
+{
+    free(pv);
+}
+
+STDAPI QISearch(__in void* that, __in LPCQITAB pqit, __in REFIID riid, __deref_out void** ppv)
+{
+    if (NULL == ppv)
+    {
+        return E_POINTER;
+    }
+    *ppv = NULL;
+    for (LPCQITAB pqitEntry = pqit; pqitEntry->piid; pqitEntry++)
+    {
+        if (IsEqualIID(riid, *pqitEntry->piid) || (pqitEntry == pqit && IsEqualIID(riid, IID_IUnknown)))
+        {
+            IUnknown* punk = reinterpret_cast<IUnknown*>(static_cast<BYTE*>(that) + pqitEntry->dwOffset);
+            punk->AddRef();
+            *ppv = punk;
+            return S_OK;
+        }
+    }
+    return E_NOINTERFACE;
+}
+
+STDAPI SHStrDupW(__in LPCWSTR psz, __deref_out LPWSTR* ppwsz)
+{
+    size_t cb = (wcslen(psz) + 1) * sizeof(WCHAR);
+    *ppwsz = static_cast<LPWSTR>(CoTaskMemAlloc(cb));
+    if (NULL == *ppwsz)
+    {
+        return E_OUTOFMEMORY;
+    }
+    memcpy(*ppwsz, psz, cb);
+    return S_OK;
+}
+
+PCWSTR STDAPICALLTYPE StrStrIW(__in PCWSTR pszFirst, __in PCWSTR pszSrch)
+{
+    size_t cchSrch = wcslen(pszSrch);
+    for (PCWSTR pwch = pszFirst; *pwch; pwch++)
+    {
+        if (0 == wcsncasecmp(pwch, pszSrch, cchSrch))
+        {
+            return pwch;
+        }
+    }
+    return NULL;
+}
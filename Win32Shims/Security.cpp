@@ -0,0 +1,90 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// secur32's LSA calls, crypt32's DPAPI and credui's packing calls on POSIX, where there is
+// no LSA, no DPAPI key and no credential UI: packages are looked up by name from the ones
+// every Windows machine has, and the rest fail with ERROR_NOT_SUPPORTED.
+
+#include <ntstatus.h>
+#define WIN32_NO_STATUS
+#include <windows.h>
+#undef WIN32_NO_STATUS
+#include <ntsecapi.h>
+#include <security.h>
+#include <dpapi.h>
+#include <wincred.h>
+
+static char s_chLsa;
+
+NTSTATUS NTAPI LsaConnectUntrusted(__out PHANDLE LsaHandle)
+{
+    *LsaHandle = &s_chLsa;
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS NTAPI LsaLookupAuthenticationPackage(__in HANDLE LsaHandle, __in PLSA_STRING PackageName,
+    __out PULONG AuthenticationPackage)
+{
+    static const char* const c_rgpszPackage[] =
+    {
+        NEGOSSP_NAME_A,
+        MSV1_0_PACKAGE_NAME,
+        MICROSOFT_KERBEROS_NAME_A,
+    };
+
+    if (&s_chLsa != LsaHandle)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+    for (ULONG i = 0; i < ARRAYSIZE(c_rgpszPackage); i++)
+    {
+        if (strlen(c_rgpszPackage[i]) == PackageName->Length &&
+            0 == strncmp(c_rgpszPackage[i], PackageName->Buffer, PackageName->Length))
+        {
+            *AuthenticationPackage = i;
+            return STATUS_SUCCESS;
+        }
+    }
+    return STATUS_NO_SUCH_PACKAGE;
+}
+
+NTSTATUS NTAPI LsaDeregisterLogonProcess(__in HANDLE LsaHandle)
+{
+    return (&s_chLsa == LsaHandle) ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER;
+}
+
+BOOL WINAPI CryptUnprotectData(__in DATA_BLOB* /*pDataIn*/, __deref_out_opt LPWSTR* ppszDataDescr,
+    __in_opt DATA_BLOB* /*pOptionalEntropy*/, __reserved PVOID /*pvReserved*/,
+    __in_opt CRYPTPROTECT_PROMPTSTRUCT* /*pPromptStruct*/, __in DWORD /*dwFlags*/, __out DATA_BLOB* pDataOut)
+{
+    if (ppszDataDescr)
+    {
+        *ppszDataDescr = NULL;
+    }
+    pDataOut->cbData = 0;
+    pDataOut->pbData = NULL;
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return FALSE;
+}
+
+BOOL WINAPI CredPackAuthenticationBufferW(__in DWORD /*dwFlags*/, __in LPWSTR /*pszUserName*/, __in LPWSTR /*pszPassword*/,
+    __out_bcount_opt(*pcbPackedCredentials) PBYTE /*pPackedCredentials*/, __inout DWORD* /*pcbPackedCredentials*/)
+{
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return FALSE;
+}
+
+BOOL WINAPI CredUnPackAuthenticationBufferW(__in DWORD /*dwFlags*/, __in_bcount(cbAuthBuffer) PVOID /*pAuthBuffer*/,
+    __in DWORD /*cbAuthBuffer*/, __out_ecount_opt(*pcchMaxUserName) LPWSTR /*pszUserName*/,
+    __inout DWORD* /*pcchMaxUserName*/, __out_ecount_opt(*pcchMaxDomainName) LPWSTR /*pszDomainName*/,
+    __inout_opt DWORD* /*pcchMaxDomainName*/, __out_ecount_opt(*pcchMaxPassword) LPWSTR /*pszPassword*/,
+    __inout DWORD* /*pcchMaxPassword*/)
+{
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return FALSE;
+}
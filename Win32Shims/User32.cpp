@@ -0,0 +1,356 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// user32, and gdi32's DeleteObject, on POSIX: message-only windows with a message queue
+// per thread, and the string tables and bitmaps a module's Win32ShimResources holds.
+
+#include <windows.h>
+#include <Win32ShimResources.h>
+#include "Win32Shims.h"
+
+#include <dlfcn.h>
+#include <deque>
+#include <set>
+
+struct SHIM_WINDOW
+{
+    WNDPROC pfnWndProc;
+    LONG_PTR lUserData;
+    DWORD dwThreadId;
+    std::wstring className;
+    HINSTANCE hinst;
+};
+
+struct SHIM_CLASS
+{
+    WNDPROC pfnWndProc;
+    ATOM atom;
+};
+
+// Classes, windows and queues share one lock, which is never held while a window procedure
+// runs.
+static std::mutex s_mutex;
+static std::map<std::pair<HINSTANCE, std::wstring>, SHIM_CLASS> s_mapClasses;
+static std::set<SHIM_WINDOW*> s_setWindows;
+static std::map<DWORD, std::deque<MSG> > s_mapQueues;
+static std::set<HBITMAP> s_setBitmaps;
+static ATOM s_atomLast = 0xC000;
+
+static std::wstring _ClassKey(LPCWSTR pwzClassName)
+{
+    std::wstring key(pwzClassName);
+    for (size_t i = 0; i < key.size(); i++)
+    {
+        key[i] = (wchar_t)towupper(key[i]);
+    }
+    return key;
+}
+
+// Returns the window, which must be checked for under s_mutex.
+static SHIM_WINDOW* _WindowOf(HWND hwnd)
+{
+    SHIM_WINDOW* pWindow = reinterpret_cast<SHIM_WINDOW*>(hwnd);
+    return s_setWindows.count(pWindow) ? pWindow : NULL;
+}
+
+ATOM WINAPI RegisterClassExW(__in const WNDCLASSEXW* lpwcx)
+{
+    if (NULL == lpwcx || sizeof(WNDCLASSEXW) != lpwcx->cbSize || NULL == lpwcx->lpszClassName ||
+        IS_INTRESOURCE(lpwcx->lpszClassName))
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::pair<HINSTANCE, std::wstring> key(lpwcx->hInstance, _ClassKey(lpwcx->lpszClassName));
+    if (s_mapClasses.count(key))
+    {
+        SetLastError(ERROR_CLASS_ALREADY_EXISTS);
+        return 0;
+    }
+    SHIM_CLASS cls = { lpwcx->lpfnWndProc, ++s_atomLast };
+    s_mapClasses[key] = cls;
+    return cls.atom;
+}
+
+BOOL WINAPI UnregisterClassW(__in LPCWSTR lpClassName, __in_opt HINSTANCE hInstance)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::pair<HINSTANCE, std::wstring> key(hInstance, _ClassKey(lpClassName));
+    if (!s_mapClasses.count(key))
+    {
+        SetLastError(ERROR_CLASS_DOES_NOT_EXIST);
+        return FALSE;
+    }
+    for (std::set<SHIM_WINDOW*>::iterator it = s_setWindows.begin(); it != s_setWindows.end(); ++it)
+    {
+        if ((*it)->hinst == hInstance && (*it)->className == key.second)
+        {
+            SetLastError(ERROR_CLASS_HAS_WINDOWS);
+            return FALSE;
+        }
+    }
+    s_mapClasses.erase(key);
+    return TRUE;
+}
+
+HWND WINAPI CreateWindowExW(__in DWORD /*dwExStyle*/, __in_opt LPCWSTR lpClassName, __in_opt LPCWSTR /*lpWindowName*/,
+    __in DWORD /*dwStyle*/, __in int /*X*/, __in int /*Y*/, __in int /*nWidth*/, __in int /*nHeight*/,
+    __in_opt HWND hWndParent, __in_opt HMENU /*hMenu*/, __in_opt HINSTANCE hInstance, __in_opt LPVOID /*lpParam*/)
+{
+    // Only message-only windows: there is nothing to draw on.
+    if (HWND_MESSAGE != hWndParent || NULL == lpClassName || IS_INTRESOURCE(lpClassName))
+    {
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return NULL;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::pair<HINSTANCE, std::wstring> key(hInstance, _ClassKey(lpClassName));
+    std::map<std::pair<HINSTANCE, std::wstring>, SHIM_CLASS>::iterator it = s_mapClasses.find(key);
+    if (s_mapClasses.end() == it)
+    {
+        SetLastError(ERROR_CLASS_DOES_NOT_EXIST);
+        return NULL;
+    }
+
+    SHIM_WINDOW* pWindow = new SHIM_WINDOW();
+    pWindow->pfnWndProc = it->second.pfnWndProc;
+    pWindow->lUserData = 0;
+    pWindow->dwThreadId = GetCurrentThreadId();
+    pWindow->className = key.second;
+    pWindow->hinst = hInstance;
+    s_setWindows.insert(pWindow);
+    return reinterpret_cast<HWND>(pWindow);
+}
+
+BOOL WINAPI DestroyWindow(__in HWND hWnd)
+{
+    WNDPROC pfnWndProc;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        SHIM_WINDOW* pWindow = _WindowOf(hWnd);
+        if (NULL == pWindow)
+        {
+            SetLastError(ERROR_INVALID_WINDOW_HANDLE);
+            return FALSE;
+        }
+        pfnWndProc = pWindow->pfnWndProc;
+    }
+
+    pfnWndProc(hWnd, WM_DESTROY, 0, 0);
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    SHIM_WINDOW* pWindow = _WindowOf(hWnd);
+    if (pWindow)
+    {
+        // Messages still posted to it are dropped with it, as Windows drops them.
+        std::deque<MSG>& queue = s_mapQueues[pWindow->dwThreadId];
+        for (std::deque<MSG>::iterator it = queue.begin(); it != queue.end(); )
+        {
+            it = (it->hwnd == hWnd) ? queue.erase(it) : it + 1;
+        }
+        s_setWindows.erase(pWindow);
+        delete pWindow;
+    }
+    return TRUE;
+}
+
+LONG_PTR WINAPI SetWindowLongPtrW(__in HWND hWnd, __in int nIndex, __in LONG_PTR dwNewLong)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    SHIM_WINDOW* pWindow = _WindowOf(hWnd);
+    if (NULL == pWindow || GWLP_USERDATA != nIndex)
+    {
+        SetLastError(pWindow ? ERROR_INVALID_PARAMETER : ERROR_INVALID_WINDOW_HANDLE);
+        return 0;
+    }
+    LONG_PTR lOld = pWindow->lUserData;
+    pWindow->lUserData = dwNewLong;
+    SetLastError(ERROR_SUCCESS);
+    return lOld;
+}
+
+LONG_PTR WINAPI GetWindowLongPtrW(__in HWND hWnd, __in int nIndex)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    SHIM_WINDOW* pWindow = _WindowOf(hWnd);
+    if (NULL == pWindow || GWLP_USERDATA != nIndex)
+    {
+        SetLastError(pWindow ? ERROR_INVALID_PARAMETER : ERROR_INVALID_WINDOW_HANDLE);
+        return 0;
+    }
+    return pWindow->lUserData;
+}
+
+LRESULT WINAPI DefWindowProcW(__in HWND /*hWnd*/, __in UINT /*Msg*/, __in WPARAM /*wParam*/, __in LPARAM /*lParam*/)
+{
+    return 0;
+}
+
+BOOL WINAPI PostMessageW(__in_opt HWND hWnd, __in UINT Msg, __in WPARAM wParam, __in LPARAM lParam)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    DWORD dwThreadId = GetCurrentThreadId();
+    if (hWnd)
+    {
+        SHIM_WINDOW* pWindow = _WindowOf(hWnd);
+        if (NULL == pWindow)
+        {
+            SetLastError(ERROR_INVALID_WINDOW_HANDLE);
+            return FALSE;
+        }
+        dwThreadId = pWindow->dwThreadId;
+    }
+    MSG msg = { hWnd, Msg, wParam, lParam, (DWORD)GetTickCount64(), { 0, 0 } };
+    s_mapQueues[dwThreadId].push_back(msg);
+    return TRUE;
+}
+
+BOOL WINAPI PeekMessageW(__out LPMSG lpMsg, __in_opt HWND hWnd, __in UINT wMsgFilterMin,
+    __in UINT wMsgFilterMax, __in UINT wRemoveMsg)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::deque<MSG>& queue = s_mapQueues[GetCurrentThreadId()];
+    for (std::deque<MSG>::iterator it = queue.begin(); it != queue.end(); ++it)
+    {
+        bool fInRange = (0 == wMsgFilterMin && 0 == wMsgFilterMax) ||
+            (it->message >= wMsgFilterMin && it->message <= wMsgFilterMax);
+        if (fInRange && (NULL == hWnd || it->hwnd == hWnd))
+        {
+            *lpMsg = *it;
+            if (wRemoveMsg & PM_REMOVE)
+            {
+                queue.erase(it);
+            }
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+LRESULT WINAPI DispatchMessageW(__in const MSG* lpMsg)
+{
+    WNDPROC pfnWndProc;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        SHIM_WINDOW* pWindow = _WindowOf(lpMsg->hwnd);
+        if (NULL == pWindow)
+        {
+            return 0;
+        }
+        pfnWndProc = pWindow->pfnWndProc;
+    }
+    return pfnWndProc(lpMsg->hwnd, lpMsg->message, lpMsg->wParam, lpMsg->lParam);
+}
+
+//
+// Resources.
+//
+
+static const WIN32_SHIM_RESOURCES* _ResourcesOf(HINSTANCE hInstance)
+{
+    void* h = hInstance ? Win32ShimModuleHandle(hInstance) : dlopen(NULL, RTLD_LAZY);
+    return h ? static_cast<const WIN32_SHIM_RESOURCES*>(dlsym(h, WIN32_SHIM_RESOURCES_SYMBOL)) : NULL;
+}
+
+// The string in the thread's UI language, else in another of its primary language, else in
+// English (United States), as the loader falls back.
+static const WIN32_SHIM_STRING* _FindString(const WIN32_SHIM_RESOURCES* pResources, UINT uID)
+{
+    LANGID langid = GetThreadUILanguage();
+    const WIN32_SHIM_STRING* pExact = NULL;
+    const WIN32_SHIM_STRING* pPrimary = NULL;
+    const WIN32_SHIM_STRING* pEnglish = NULL;
+    for (size_t i = 0; i < pResources->cString; i++)
+    {
+        const WIN32_SHIM_STRING* pString = &pResources->rgString[i];
+        if (pString->id != uID)
+        {
+            continue;
+        }
+        if (pString->langid == langid)
+        {
+            pExact = pString;
+            break;
+        }
+        if (!pPrimary && PRIMARYLANGID(pString->langid) == PRIMARYLANGID(langid))
+        {
+            pPrimary = pString;
+        }
+        if (!pEnglish && MAKELANGID(LANG_ENGLISH, SUBLANG_ENGLISH_US) == pString->langid)
+        {
+            pEnglish = pString;
+        }
+    }
+    return pExact ? pExact : (pPrimary ? pPrimary : pEnglish);
+}
+
+int WINAPI LoadStringW(__in_opt HINSTANCE hInstance, __in UINT uID, __out_ecount(cchBufferMax) LPWSTR lpBuffer,
+    __in int cchBufferMax)
+{
+    const WIN32_SHIM_RESOURCES* pResources = _ResourcesOf(hInstance);
+    const WIN32_SHIM_STRING* pString = pResources ? _FindString(pResources, uID) : NULL;
+    if (NULL == pString)
+    {
+        SetLastError(pResources ? ERROR_RESOURCE_NAME_NOT_FOUND : ERROR_RESOURCE_DATA_NOT_FOUND);
+        if (cchBufferMax > 0)
+        {
+            lpBuffer[0] = L'\0';
+        }
+        return 0;
+    }
+
+    // With no buffer, a read-only pointer to the string, which is not terminated on Windows.
+    if (0 == cchBufferMax)
+    {
+        *reinterpret_cast<const wchar_t**>(lpBuffer) = pString->pwz;
+        return pString->cch;
+    }
+    int cch = std::min(pString->cch, cchBufferMax - 1);
+    wmemcpy(lpBuffer, pString->pwz, (size_t)cch);
+    lpBuffer[cch] = L'\0';
+    return cch;
+}
+
+HBITMAP WINAPI LoadBitmapW(__in_opt HINSTANCE hInstance, __in LPCWSTR lpBitmapName)
+{
+    const WIN32_SHIM_RESOURCES* pResources = _ResourcesOf(hInstance);
+    if (pResources && IS_INTRESOURCE(lpBitmapName))
+    {
+        UINT id = (UINT)reinterpret_cast<ULONG_PTR>(lpBitmapName);
+        for (size_t i = 0; i < pResources->cBitmap; i++)
+        {
+            if (pResources->rgidBitmap[i] == id)
+            {
+                // Nothing draws here, so the handle only needs to be one DeleteObject frees.
+                HBITMAP hbmp = reinterpret_cast<HBITMAP>(new char[1]);
+                std::lock_guard<std::mutex> lock(s_mutex);
+                s_setBitmaps.insert(hbmp);
+                return hbmp;
+            }
+        }
+    }
+    SetLastError(ERROR_RESOURCE_NAME_NOT_FOUND);
+    return NULL;
+}
+
+BOOL WINAPI DeleteObject(__in HGDIOBJ ho)
+{
+    HBITMAP hbmp = static_cast<HBITMAP>(ho);
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!s_setBitmaps.erase(hbmp))
+        {
+            return FALSE;
+        }
+    }
+    delete[] reinterpret_cast<char*>(hbmp);
+    return TRUE;
+}
@@ -0,0 +1,134 @@
+#
+# win32_shim_module(<target> DEF <file> RC <file> RESOURCE_HEADER <file>)
+#
+# Makes a shared library target the module Windows would build from the same sources: it
+# exports what the .def file's EXPORTS names, and DllMain, and nothing else, and carries the
+# string tables and bitmap ids of the .rc file as Win32ShimResources (see
+# include/Win32ShimResources.h) for LoadStringW and LoadBitmapW.  The .rc file is read, not
+# compiled: LANGUAGE statements, STRINGTABLE blocks whose entries are on one line each, and
+# BITMAP statements, with ids #defined as numbers in the resource header.  Both are generated
+# when CMake configures, and again whenever the inputs change.
+#
+
+function(_win32_shim_langid primary sublang outvar)
+  set(LANG_NEUTRAL 0x00)
+  set(LANG_GERMAN 0x07)
+  set(LANG_ENGLISH 0x09)
+  set(LANG_SPANISH 0x0a)
+  set(LANG_FRENCH 0x0c)
+  set(SUBLANG_NEUTRAL 0)
+  set(SUBLANG_DEFAULT 1)
+  set(SUBLANG_ENGLISH_US 1)
+  set(SUBLANG_GERMAN 1)
+  set(SUBLANG_FRENCH 1)
+  set(SUBLANG_SPANISH_MODERN 3)
+  if(NOT DEFINED ${primary} OR NOT DEFINED ${sublang})
+    message(FATAL_ERROR "win32_shim_module: no LANGID for LANGUAGE ${primary}, ${sublang}")
+  endif()
+  math(EXPR langid "(${${sublang}} << 10) | ${${primary}}")
+  set(${outvar} ${langid} PARENT_SCOPE)
+endfunction()
+
+function(win32_shim_module target)
+  cmake_parse_arguments(ARG "" "DEF;RC;RESOURCE_HEADER" "" ${ARGN})
+  set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${ARG_DEF} ${ARG_RC} ${ARG_RESOURCE_HEADER})
+  set(outdir ${CMAKE_CURRENT_BINARY_DIR}/${target}.shim)
+
+  # The exports.
+  file(STRINGS ${ARG_DEF} deflines)
+  set(symbols "DllMain;Win32ShimResources")
+  set(inexports FALSE)
+  foreach(line IN LISTS deflines)
+    if(line MATCHES "^EXPORTS")
+      set(inexports TRUE)
+    elseif(inexports AND line MATCHES "^[ \t]+([A-Za-z_][A-Za-z0-9_]*)")
+      list(APPEND symbols ${CMAKE_MATCH_1})
+    elseif(line MATCHES "^[A-Z]")
+      set(inexports FALSE)
+    endif()
+  endforeach()
+  set(script "{\n  global:\n")
+  foreach(symbol IN LISTS symbols)
+    string(APPEND script "    ${symbol};\n")
+  endforeach()
+  string(APPEND script "  local: *;\n};\n")
+  file(WRITE ${outdir}/exports.map "${script}")
+
+  # The resource ids.
+  file(STRINGS ${ARG_RESOURCE_HEADER} headerlines REGEX "^#define")
+  foreach(line IN LISTS headerlines)
+    if(line MATCHES "^#define[ \t]+([A-Za-z_][A-Za-z0-9_]*)[ \t]+([0-9]+)")
+      set(id_${CMAKE_MATCH_1} ${CMAKE_MATCH_2})
+    endif()
+  endforeach()
+
+  # The resources, a line at a time.  Semicolons would split CMake's lists, and brackets keep
+  # them from splitting, so all three stand in as control characters until they are written.
+  file(READ ${ARG_RC} rc)
+  string(ASCII 1 semicolon)
+  string(ASCII 2 lbracket)
+  string(ASCII 3 rbracket)
+  string(REPLACE ";" "${semicolon}" rc "${rc}")
+  string(REPLACE "[" "${lbracket}" rc "${rc}")
+  string(REPLACE "]" "${rbracket}" rc "${rc}")
+  string(REPLACE "\r" "" rc "${rc}")
+  string(REPLACE "\n" ";" rclines "${rc}")
+
+  set(strings "")
+  set(bitmaps "")
+  set(langid 0)
+  set(instringtable FALSE)
+  foreach(line IN LISTS rclines)
+    if(line MATCHES "^LANGUAGE[ \t]+([A-Z_]+)[ \t]*,[ \t]*([A-Z_]+)")
+      _win32_shim_langid(${CMAKE_MATCH_1} ${CMAKE_MATCH_2} langid)
+    elseif(line MATCHES "^STRINGTABLE")
+      set(instringtable TRUE)
+    elseif(instringtable AND line MATCHES "^END")
+      set(instringtable FALSE)
+    elseif(instringtable AND line MATCHES "^[ \t]*([A-Za-z_][A-Za-z0-9_]*)[ \t]+\"(.*)\"[ \t]*$")
+      set(name ${CMAKE_MATCH_1})
+      set(text "${CMAKE_MATCH_2}")
+      if(NOT DEFINED id_${name})
+        message(FATAL_ERROR "win32_shim_module: ${name} is not #defined in ${ARG_RESOURCE_HEADER}")
+      endif()
+      # A quote is doubled in an .rc string and escaped in C++; a semicolon is written as an
+      # octal escape, which no digit after it can extend.
+      string(REPLACE "\"\"" "\\\"" text "${text}")
+      string(REPLACE "${semicolon}" "\\073" text "${text}")
+      string(REPLACE "${lbracket}" "[" text "${text}")
+      string(REPLACE "${rbracket}" "]" text "${text}")
+      string(APPEND strings "    { ${langid}, ${id_${name}}, L\"${text}\", (int)(sizeof(L\"${text}\") / sizeof(wchar_t)) - 1 },\n")
+    elseif(line MATCHES "^([A-Za-z_][A-Za-z0-9_]*)[ \t]+BITMAP")
+      if(NOT DEFINED id_${CMAKE_MATCH_1})
+        message(FATAL_ERROR "win32_shim_module: ${CMAKE_MATCH_1} is not #defined in ${ARG_RESOURCE_HEADER}")
+      endif()
+      string(APPEND bitmaps "    ${id_${CMAKE_MATCH_1}},\n")
+    endif()
+  endforeach()
+
+  set(source "// Generated by Win32ShimModule.cmake from ${ARG_RC}; do not edit.\n\n")
+  string(APPEND source "#include <Win32ShimResources.h>\n\n")
+  if(strings)
+    string(APPEND source "static const WIN32_SHIM_STRING c_rgString[] =\n{\n${strings}};\n\n")
+    set(stringtable "c_rgString, ARRAYSIZE(c_rgString)")
+  else()
+    set(stringtable "NULL, 0")
+  endif()
+  if(bitmaps)
+    string(APPEND source "static const UINT c_rgidBitmap[] =\n{\n${bitmaps}};\n\n")
+    set(bitmaptable "c_rgidBitmap, ARRAYSIZE(c_rgidBitmap)")
+  else()
+    set(bitmaptable "NULL, 0")
+  endif()
+  string(APPEND source "EXTERN_C const WIN32_SHIM_RESOURCES Win32ShimResources = { ${stringtable}, ${bitmaptable} };\n")
+  file(WRITE ${outdir}/resources.cpp.tmp "${source}")
+  configure_file(${outdir}/resources.cpp.tmp ${outdir}/resources.cpp COPYONLY)
+
+  target_sources(${target} PRIVATE ${outdir}/resources.cpp)
+  set_target_properties(${target} PROPERTIES
+    PREFIX ""
+    SUFFIX ".dll"
+    LINK_DEPENDS ${outdir}/exports.map
+  )
+  target_link_libraries(${target} PRIVATE -Wl,--version-script=${outdir}/exports.map -Wl,--no-undefined)
+endfunction()
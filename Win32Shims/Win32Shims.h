@@ -0,0 +1,108 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// What the Win32 shims' sources share and nothing outside them sees: the objects a HANDLE
+// points at, and conversions between the wide strings the Win32 API takes and the UTF-8
+// ones POSIX does.
+
+#pragma once
+
+#include <windows.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Every HANDLE the shims hand out, but for GetCurrentProcess's, points at one of these, and
+// CloseHandle deletes it.
+class CShimObject
+{
+public:
+    virtual ~CShimObject() {}
+};
+
+class CShimFile : public CShimObject
+{
+public:
+    explicit CShimFile(int fd) : _fd(fd) {}
+    ~CShimFile()
+    {
+        if (_fd > 2)
+        {
+            close(_fd);
+        }
+    }
+
+    int Fd() const { return _fd; }
+
+private:
+    int _fd;
+};
+
+class CShimProcess : public CShimObject
+{
+public:
+    explicit CShimProcess(pid_t pid) : _pid(pid), _fExited(false), _status(0) {}
+
+    pid_t Pid() const { return _pid; }
+
+    // Reaps the child if it has exited, waiting for it if fWait.  Returns false if it is still
+    // running or cannot be waited for.
+    bool Reap(bool fWait);
+
+    bool Exited() const { return _fExited; }
+    int Status() const { return _status; }
+
+private:
+    pid_t _pid;
+    bool _fExited;
+    int _status;
+};
+
+class CShimMapping : public CShimObject
+{
+public:
+    CShimMapping(int fd, size_t cb, bool fWritable) : _fd(fd), _cb(cb), _fWritable(fWritable) {}
+    ~CShimMapping()
+    {
+        close(_fd);
+    }
+
+    int Fd() const { return _fd; }
+    size_t Size() const { return _cb; }
+    bool Writable() const { return _fWritable; }
+
+private:
+    int _fd;
+    size_t _cb;
+    bool _fWritable;
+};
+
+// UTF-32 to UTF-8; anything that is not a Unicode scalar value comes out as U+FFFD.
+std::string Win32ShimNarrow(const wchar_t* pwz, size_t cch);
+inline std::string Win32ShimNarrow(const wchar_t* pwz)
+{
+    return Win32ShimNarrow(pwz, wcslen(pwz));
+}
+
+// UTF-8 to UTF-32; bytes that do not decode come out as U+FFFD.
+std::wstring Win32ShimWiden(const char* psz, size_t cb);
+inline std::wstring Win32ShimWiden(const char* psz)
+{
+    return Win32ShimWiden(psz, strlen(psz));
+}
+
+// The Win32 error code nearest to an errno value.
+DWORD Win32ShimErrorFromErrno(int err);
+
+// LoadLibraryExW marks a module loaded only for its resources by setting the low bit above
+// the alignment dlopen's handles have, as Windows marks a data file's HMODULE.
+#define WIN32_SHIM_DATAFILE_TAG ((ULONG_PTR)2)
+
+inline void* Win32ShimModuleHandle(HMODULE hmod)
+{
+    return reinterpret_cast<void*>(reinterpret_cast<ULONG_PTR>(hmod) & ~WIN32_SHIM_DATAFILE_TAG);
+}
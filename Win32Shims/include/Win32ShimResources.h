@@ -0,0 +1,33 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// A module's resources, as Win32ShimModule.cmake compiles them from its resources.rc: its
+// string tables, one entry per string and language, and the ids of its bitmaps.  The
+// module exports them as Win32ShimResources, where LoadStringW and LoadBitmapW look.
+
+#pragma once
+
+#include <windows.h>
+
+struct WIN32_SHIM_STRING
+{
+    LANGID langid;
+    UINT id;
+    const wchar_t* pwz;
+    int cch;
+};
+
+struct WIN32_SHIM_RESOURCES
+{
+    const WIN32_SHIM_STRING* rgString;
+    size_t cString;
+    const UINT* rgidBitmap;
+    size_t cBitmap;
+};
+
+#define WIN32_SHIM_RESOURCES_SYMBOL "Win32ShimResources"
@@ -0,0 +1,173 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The credential provider interfaces, for building the provider and the simulator that
+// hosts it against the Win32 shims.  The enumerations keep the Windows SDK's values, and
+// each interface its methods in the SDK's order.
+
+#pragma once
+
+#include <windows.h>
+#include <unknwn.h>
+#include <objbase.h>
+
+typedef enum _CREDENTIAL_PROVIDER_USAGE_SCENARIO
+{
+    CPUS_INVALID = 0,
+    CPUS_LOGON,
+    CPUS_UNLOCK_WORKSTATION,
+    CPUS_CHANGE_PASSWORD,
+    CPUS_CREDUI,
+    CPUS_PLAP,
+} CREDENTIAL_PROVIDER_USAGE_SCENARIO;
+
+typedef enum _CREDENTIAL_PROVIDER_FIELD_TYPE
+{
+    CPFT_INVALID = 0,
+    CPFT_LARGE_TEXT,
+    CPFT_SMALL_TEXT,
+    CPFT_COMMAND_LINK,
+    CPFT_EDIT_TEXT,
+    CPFT_PASSWORD_TEXT,
+    CPFT_TILE_IMAGE,
+    CPFT_CHECKBOX,
+    CPFT_COMBOBOX,
+    CPFT_SUBMIT_BUTTON,
+} CREDENTIAL_PROVIDER_FIELD_TYPE;
+
+typedef enum _CREDENTIAL_PROVIDER_FIELD_STATE
+{
+    CPFS_HIDDEN = 0,
+    CPFS_DISPLAY_IN_SELECTED_TILE,
+    CPFS_DISPLAY_IN_DESELECTED_TILE,
+    CPFS_DISPLAY_IN_BOTH,
+} CREDENTIAL_PROVIDER_FIELD_STATE;
+
+typedef enum _CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE
+{
+    CPFIS_NONE = 0,
+    CPFIS_READONLY,
+    CPFIS_DISABLED,
+    CPFIS_FOCUSED,
+} CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE;
+
+typedef struct _CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR
+{
+    DWORD dwFieldID;
+    CREDENTIAL_PROVIDER_FIELD_TYPE cpft;
+    LPWSTR pszLabel;
+    GUID guidFieldType;
+} CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR;
+
+typedef enum _CREDENTIAL_PROVIDER_GET_SERIALIZATION_RESPONSE
+{
+    CPGSR_NO_CREDENTIAL_NOT_FINISHED,
+    CPGSR_NO_CREDENTIAL_FINISHED,
+    CPGSR_RETURN_CREDENTIAL_FINISHED,
+    CPGSR_RETURN_NO_CREDENTIAL_FINISHED,
+} CREDENTIAL_PROVIDER_GET_SERIALIZATION_RESPONSE;
+
+typedef struct _CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION
+{
+    ULONG ulAuthenticationPackage;
+    GUID clsidCredentialProvider;
+    ULONG cbSerialization;
+    BYTE* rgbSerialization;
+} CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION;
+
+typedef enum _CREDENTIAL_PROVIDER_STATUS_ICON
+{
+    CPSI_NONE = 0,
+    CPSI_ERROR,
+    CPSI_WARNING,
+    CPSI_SUCCESS,
+} CREDENTIAL_PROVIDER_STATUS_ICON;
+
+#define CREDENTIAL_PROVIDER_NO_DEFAULT ((DWORD)-1)
+
+EXTERN_C const IID IID_ICredentialProviderCredentialEvents;
+EXTERN_C const IID IID_ICredentialProviderCredential;
+EXTERN_C const IID IID_ICredentialProviderEvents;
+EXTERN_C const IID IID_ICredentialProvider;
+
+struct ICredentialProviderCredential;
+
+struct ICredentialProviderCredentialEvents : public IUnknown
+{
+    virtual HRESULT STDMETHODCALLTYPE SetFieldState(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID,
+        __in CREDENTIAL_PROVIDER_FIELD_STATE cpfs) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetFieldInteractiveState(__in ICredentialProviderCredential* pcpc,
+        __in DWORD dwFieldID, __in CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE cpfis) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetFieldString(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID,
+        __in LPCWSTR psz) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetFieldCheckbox(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID,
+        __in BOOL bChecked, __in LPCWSTR pszLabel) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetFieldBitmap(__in ICredentialProviderCredential* pcpc, __in DWORD dwFieldID,
+        __in HBITMAP hbmp) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetFieldComboBoxSelectedItem(__in ICredentialProviderCredential* pcpc,
+        __in DWORD dwFieldID, __in DWORD dwSelectedItem) = 0;
+    virtual HRESULT STDMETHODCALLTYPE DeleteFieldComboBoxItem(__in ICredentialProviderCredential* pcpc,
+        __in DWORD dwFieldID, __in DWORD dwItem) = 0;
+    virtual HRESULT STDMETHODCALLTYPE AppendFieldComboBoxItem(__in ICredentialProviderCredential* pcpc,
+        __in DWORD dwFieldID, __in LPCWSTR pszItem) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetFieldSubmitButton(__in ICredentialProviderCredential* pcpc,
+        __in DWORD dwFieldID, __in DWORD dwAdjacentTo) = 0;
+    virtual HRESULT STDMETHODCALLTYPE OnCreatingWindow(__out HWND* phwndOwner) = 0;
+};
+
+struct ICredentialProviderCredential : public IUnknown
+{
+    virtual HRESULT STDMETHODCALLTYPE Advise(__in ICredentialProviderCredentialEvents* pcpce) = 0;
+    virtual HRESULT STDMETHODCALLTYPE UnAdvise() = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetSelected(__out BOOL* pbAutoLogon) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetDeselected() = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetFieldState(__in DWORD dwFieldID, __out CREDENTIAL_PROVIDER_FIELD_STATE* pcpfs,
+        __out CREDENTIAL_PROVIDER_FIELD_INTERACTIVE_STATE* pcpfis) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetStringValue(__in DWORD dwFieldID, __deref_out LPWSTR* ppsz) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetBitmapValue(__in DWORD dwFieldID, __out HBITMAP* phbmp) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetCheckboxValue(__in DWORD dwFieldID, __out BOOL* pbChecked,
+        __deref_out LPWSTR* ppszLabel) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetSubmitButtonValue(__in DWORD dwFieldID, __out DWORD* pdwAdjacentTo) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetComboBoxValueCount(__in DWORD dwFieldID, __out DWORD* pcItems,
+        __out DWORD* pdwSelectedItem) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetComboBoxValueAt(__in DWORD dwFieldID, __in DWORD dwItem,
+        __deref_out LPWSTR* ppszItem) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetStringValue(__in DWORD dwFieldID, __in LPCWSTR psz) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetCheckboxValue(__in DWORD dwFieldID, __in BOOL bChecked) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetComboBoxSelectedValue(__in DWORD dwFieldID, __in DWORD dwSelectedItem) = 0;
+    virtual HRESULT STDMETHODCALLTYPE CommandLinkClicked(__in DWORD dwFieldID) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetSerialization(__out CREDENTIAL_PROVIDER_GET_SERIALIZATION_RESPONSE* pcpgsr,
+        __out CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs, __deref_out_opt LPWSTR* ppszOptionalStatusText,
+        __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsiOptionalStatusIcon) = 0;
+    virtual HRESULT STDMETHODCALLTYPE ReportResult(__in NTSTATUS ntsStatus, __in NTSTATUS ntsSubstatus,
+        __deref_out_opt LPWSTR* ppszOptionalStatusText, __out CREDENTIAL_PROVIDER_STATUS_ICON* pcpsiOptionalStatusIcon) = 0;
+};
+
+struct ICredentialProviderEvents : public IUnknown
+{
+    virtual HRESULT STDMETHODCALLTYPE CredentialsChanged(__in UINT_PTR upAdviseContext) = 0;
+};
+
+struct ICredentialProvider : public IUnknown
+{
+    virtual HRESULT STDMETHODCALLTYPE SetUsageScenario(__in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus, __in DWORD dwFlags) = 0;
+    virtual HRESULT STDMETHODCALLTYPE SetSerialization(__in const CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs) = 0;
+    virtual HRESULT STDMETHODCALLTYPE Advise(__in ICredentialProviderEvents* pcpe, __in UINT_PTR upAdviseContext) = 0;
+    virtual HRESULT STDMETHODCALLTYPE UnAdvise() = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetFieldDescriptorCount(__out DWORD* pdwCount) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetFieldDescriptorAt(__in DWORD dwIndex,
+        __deref_out CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR** ppcpfd) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetCredentialCount(__out DWORD* pdwCount, __out DWORD* pdwDefault,
+        __out BOOL* pbAutoLogonWithDefault) = 0;
+    virtual HRESULT STDMETHODCALLTYPE GetCredentialAt(__in DWORD dwIndex, __deref_out ICredentialProviderCredential** ppcpc) = 0;
+};
+
+WIN32_SHIM_IID_OF(ICredentialProviderCredentialEvents)
+WIN32_SHIM_IID_OF(ICredentialProviderCredential)
+WIN32_SHIM_IID_OF(ICredentialProviderEvents)
+WIN32_SHIM_IID_OF(ICredentialProvider)
@@ -0,0 +1,30 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// DPAPI, for building against the Win32 shims.  There is no machine or user key to unwrap
+// with here, so CryptUnprotectData fails with ERROR_NOT_SUPPORTED: a sealed store's key
+// file can only be opened on Windows.
+
+#pragma once
+
+#include <windows.h>
+
+typedef struct _CRYPTOAPI_BLOB
+{
+    DWORD cbData;
+    BYTE* pbData;
+} DATA_BLOB, *PDATA_BLOB;
+
+typedef struct _CRYPTPROTECT_PROMPTSTRUCT CRYPTPROTECT_PROMPTSTRUCT, *PCRYPTPROTECT_PROMPTSTRUCT;
+
+#define CRYPTPROTECT_UI_FORBIDDEN 0x1
+#define CRYPTPROTECT_LOCAL_MACHINE 0x4
+
+EXTERN_C BOOL WINAPI CryptUnprotectData(__in DATA_BLOB* pDataIn, __deref_out_opt LPWSTR* ppszDataDescr,
+    __in_opt DATA_BLOB* pOptionalEntropy, __reserved PVOID pvReserved, __in_opt CRYPTPROTECT_PROMPTSTRUCT* pPromptStruct,
+    __in DWORD dwFlags, __out DATA_BLOB* pDataOut);
@@ -0,0 +1,80 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The overflow-checked conversions and arithmetic the helpers use, for building against the
+// Win32 shims.  Each fails with INTSAFE_E_ARITHMETIC_OVERFLOW and sets its result to the
+// type's error value, as on Windows.
+
+#pragma once
+
+#include <windows.h>
+
+#define INTSAFE_E_ARITHMETIC_OVERFLOW ((HRESULT)0x80070216L)
+
+#define USHORT_ERROR ((USHORT)0xffff)
+#define DWORD_ERROR ((DWORD)0xffffffff)
+#define SIZET_ERROR ((size_t)-1)
+
+inline HRESULT SizeTToUShort(__in size_t cbSource, __out USHORT* pusResult)
+{
+    if (cbSource > 0xffff)
+    {
+        *pusResult = USHORT_ERROR;
+        return INTSAFE_E_ARITHMETIC_OVERFLOW;
+    }
+    *pusResult = (USHORT)cbSource;
+    return S_OK;
+}
+
+inline HRESULT SizeTToDWord(__in size_t cbSource, __out DWORD* pdwResult)
+{
+    if (cbSource > 0xffffffff)
+    {
+        *pdwResult = DWORD_ERROR;
+        return INTSAFE_E_ARITHMETIC_OVERFLOW;
+    }
+    *pdwResult = (DWORD)cbSource;
+    return S_OK;
+}
+
+inline HRESULT UShortMult(__in USHORT usMultiplicand, __in USHORT usMultiplier, __out USHORT* pusResult)
+{
+    return SizeTToUShort((size_t)usMultiplicand * usMultiplier, pusResult);
+}
+
+inline HRESULT SizeTAdd(__in size_t Augend, __in size_t Addend, __out size_t* pResult)
+{
+    if (Augend + Addend < Augend)
+    {
+        *pResult = SIZET_ERROR;
+        return INTSAFE_E_ARITHMETIC_OVERFLOW;
+    }
+    *pResult = Augend + Addend;
+    return S_OK;
+}
+
+inline HRESULT SizeTMult(__in size_t Multiplicand, __in size_t Multiplier, __out size_t* pResult)
+{
+    if (Multiplicand && Multiplier > SIZET_ERROR / Multiplicand)
+    {
+        *pResult = SIZET_ERROR;
+        return INTSAFE_E_ARITHMETIC_OVERFLOW;
+    }
+    *pResult = Multiplicand * Multiplier;
+    return S_OK;
+}
+
+inline HRESULT DWordAdd(__in DWORD dwAugend, __in DWORD dwAddend, __out DWORD* pdwResult)
+{
+    return SizeTToDWord((size_t)dwAugend + dwAddend, pdwResult);
+}
+
+inline HRESULT DWordMult(__in DWORD dwMultiplicand, __in DWORD dwMultiplier, __out DWORD* pdwResult)
+{
+    return SizeTToDWord((size_t)dwMultiplicand * dwMultiplier, pdwResult);
+}
@@ -0,0 +1,64 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The LSA structures and calls the helpers use to build and submit a logon, for building
+// against the Win32 shims.
+
+#pragma once
+
+#include <windows.h>
+
+typedef struct _STRING
+{
+    USHORT Length;
+    USHORT MaximumLength;
+    PCHAR Buffer;
+} STRING, *PSTRING, LSA_STRING, *PLSA_STRING;
+
+typedef struct _UNICODE_STRING
+{
+    USHORT Length;
+    USHORT MaximumLength;
+    PWSTR Buffer;
+} UNICODE_STRING, *PUNICODE_STRING, LSA_UNICODE_STRING, *PLSA_UNICODE_STRING;
+
+typedef enum _KERB_LOGON_SUBMIT_TYPE
+{
+    KerbInteractiveLogon = 2,
+    KerbSmartCardLogon = 6,
+    KerbWorkstationUnlockLogon = 7,
+    KerbSmartCardUnlockLogon = 8,
+    KerbProxyLogon = 9,
+    KerbTicketLogon = 10,
+    KerbTicketUnlockLogon = 11,
+    KerbS4ULogon = 12,
+    KerbCertificateLogon = 13,
+    KerbCertificateS4ULogon = 14,
+    KerbCertificateUnlockLogon = 15,
+} KERB_LOGON_SUBMIT_TYPE, *PKERB_LOGON_SUBMIT_TYPE;
+
+typedef struct _KERB_INTERACTIVE_LOGON
+{
+    KERB_LOGON_SUBMIT_TYPE MessageType;
+    UNICODE_STRING LogonDomainName;
+    UNICODE_STRING UserName;
+    UNICODE_STRING Password;
+} KERB_INTERACTIVE_LOGON, *PKERB_INTERACTIVE_LOGON;
+
+typedef struct _KERB_INTERACTIVE_UNLOCK_LOGON
+{
+    KERB_INTERACTIVE_LOGON Logon;
+    LUID LogonId;
+} KERB_INTERACTIVE_UNLOCK_LOGON, *PKERB_INTERACTIVE_UNLOCK_LOGON;
+
+// There is no LSA to connect to here; the handle only stands for the connection, and the
+// packages looked up are those every Windows machine has, numbered as LSA numbers them.
+EXTERN_C NTSTATUS NTAPI LsaConnectUntrusted(__out PHANDLE LsaHandle);
+EXTERN_C NTSTATUS NTAPI LsaLookupAuthenticationPackage(__in HANDLE LsaHandle, __in PLSA_STRING PackageName,
+    __out PULONG AuthenticationPackage);
+EXTERN_C NTSTATUS NTAPI LsaDeregisterLogonProcess(__in HANDLE LsaHandle);
@@ -0,0 +1,30 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The COM library calls the provider and its hosts make, for building against the Win32
+// shims.  There is no apartment here: CoInitializeEx only counts, and every object is
+// called on the thread that calls it.
+
+#pragma once
+
+#include <windows.h>
+#include <unknwn.h>
+
+typedef enum tagCOINIT
+{
+    COINIT_MULTITHREADED = 0x0,
+    COINIT_APARTMENTTHREADED = 0x2,
+    COINIT_DISABLE_OLE1DDE = 0x4,
+    COINIT_SPEED_OVER_MEMORY = 0x8,
+} COINIT;
+
+EXTERN_C HRESULT STDAPICALLTYPE CoInitializeEx(__in_opt LPVOID pvReserved, __in DWORD dwCoInit);
+EXTERN_C void STDAPICALLTYPE CoUninitialize();
+EXTERN_C LPVOID STDAPICALLTYPE CoTaskMemAlloc(__in SIZE_T cb);
+EXTERN_C LPVOID STDAPICALLTYPE CoTaskMemRealloc(__in_opt LPVOID pv, __in SIZE_T cb);
+EXTERN_C void STDAPICALLTYPE CoTaskMemFree(__in_opt LPVOID pv);
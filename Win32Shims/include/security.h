@@ -0,0 +1,19 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The names of the security packages, for building against the Win32 shims.
+
+#pragma once
+
+#include <windows.h>
+
+#define NEGOSSP_NAME_W L"Negotiate"
+#define NEGOSSP_NAME_A "Negotiate"
+#define MICROSOFT_KERBEROS_NAME_W L"Kerberos"
+#define MICROSOFT_KERBEROS_NAME_A "Kerberos"
+#define MSV1_0_PACKAGE_NAME "MICROSOFT_AUTHENTICATION_PACKAGE_V1_0"
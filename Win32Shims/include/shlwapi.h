@@ -0,0 +1,34 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The shell's COM and string helpers the provider and its hosts use, for building against
+// the Win32 shims.
+
+#pragma once
+
+#include <windows.h>
+#include <objbase.h>
+
+typedef struct
+{
+    const IID* piid;
+    int dwOffset;
+} QITAB, *LPQITAB;
+typedef const QITAB* LPCQITAB;
+
+#define OFFSETOFCLASS(base, derived) \
+    ((DWORD)(DWORD_PTR)(static_cast<base*>((derived*)8)) - 8)
+#define QITABENTMULTI(Cthis, Ifoo, Iimpl) { &IID_##Ifoo, (int)OFFSETOFCLASS(Iimpl, Cthis) }
+#define QITABENT(Cthis, Ifoo) QITABENTMULTI(Cthis, Ifoo, Ifoo)
+
+// Finds riid in the table, which ends with an entry whose piid is NULL; IID_IUnknown is
+// the first entry's interface.  AddRefs what it returns.
+STDAPI QISearch(__in void* that, __in LPCQITAB pqit, __in REFIID riid, __deref_out void** ppv);
+
+STDAPI SHStrDupW(__in LPCWSTR psz, __deref_out LPWSTR* ppwsz);
+EXTERN_C PCWSTR STDAPICALLTYPE StrStrIW(__in PCWSTR pszFirst, __in PCWSTR pszSrch);
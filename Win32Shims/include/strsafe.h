@@ -0,0 +1,100 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The bounded string functions the provider and its hosts use, for building against the
+// Win32 shims.  Each always terminates the destination, and fails with
+// STRSAFE_E_INSUFFICIENT_BUFFER when it had to cut what it was writing short.  The format
+// strings are the C runtime's, so %s is a wide string.
+
+#pragma once
+
+#include <windows.h>
+
+#define STRSAFE_MAX_CCH 2147483647
+#define STRSAFE_E_INSUFFICIENT_BUFFER ((HRESULT)0x8007007AL)
+#define STRSAFE_E_INVALID_PARAMETER ((HRESULT)0x80070057L)
+
+inline HRESULT StringCchVPrintfW(__out_ecount(cchDest) PWSTR pszDest, __in size_t cchDest, __in PCWSTR pszFormat,
+    __in va_list argList)
+{
+    if (0 == cchDest || cchDest > STRSAFE_MAX_CCH)
+    {
+        return STRSAFE_E_INVALID_PARAMETER;
+    }
+    return Win32ShimVsnwprintf(pszDest, cchDest, pszFormat, argList) < 0 ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+inline HRESULT StringCchPrintfW(__out_ecount(cchDest) PWSTR pszDest, __in size_t cchDest, __in PCWSTR pszFormat, ...)
+{
+    va_list argList;
+    va_start(argList, pszFormat);
+    HRESULT hr = StringCchVPrintfW(pszDest, cchDest, pszFormat, argList);
+    va_end(argList);
+    return hr;
+}
+
+inline HRESULT StringCbPrintfW(__out_bcount(cbDest) PWSTR pszDest, __in size_t cbDest, __in PCWSTR pszFormat, ...)
+{
+    va_list argList;
+    va_start(argList, pszFormat);
+    HRESULT hr = StringCchVPrintfW(pszDest, cbDest / sizeof(WCHAR), pszFormat, argList);
+    va_end(argList);
+    return hr;
+}
+
+inline HRESULT StringCchLengthW(__in PCWSTR psz, __in size_t cchMax, __out_opt size_t* pcchLength)
+{
+    size_t cch = 0;
+    HRESULT hr = (psz && cchMax <= STRSAFE_MAX_CCH) ? S_OK : STRSAFE_E_INVALID_PARAMETER;
+    if (SUCCEEDED(hr))
+    {
+        while (cch < cchMax && psz[cch])
+        {
+            cch++;
+        }
+        hr = (cch < cchMax) ? S_OK : STRSAFE_E_INVALID_PARAMETER;
+    }
+    if (pcchLength)
+    {
+        *pcchLength = SUCCEEDED(hr) ? cch : 0;
+    }
+    return hr;
+}
+
+inline HRESULT StringCchCopyW(__out_ecount(cchDest) PWSTR pszDest, __in size_t cchDest, __in PCWSTR pszSrc)
+{
+    if (0 == cchDest || cchDest > STRSAFE_MAX_CCH)
+    {
+        return STRSAFE_E_INVALID_PARAMETER;
+    }
+    size_t ich = 0;
+    while (ich < cchDest - 1 && pszSrc[ich])
+    {
+        pszDest[ich] = pszSrc[ich];
+        ich++;
+    }
+    pszDest[ich] = L'\0';
+    return pszSrc[ich] ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+inline HRESULT StringCchCatW(__inout_ecount(cchDest) PWSTR pszDest, __in size_t cchDest, __in PCWSTR pszSrc)
+{
+    size_t cchExisting;
+    HRESULT hr = StringCchLengthW(pszDest, cchDest, &cchExisting);
+    if (SUCCEEDED(hr))
+    {
+        hr = StringCchCopyW(pszDest + cchExisting, cchDest - cchExisting, pszSrc);
+    }
+    return hr;
+}
+
+#define StringCchPrintf StringCchPrintfW
+#define StringCbPrintf StringCbPrintfW
+#define StringCchCopy StringCchCopyW
+#define StringCchCat StringCchCatW
+#define StringCchLength StringCchLengthW
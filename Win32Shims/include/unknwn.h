@@ -0,0 +1,44 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// IUnknown and IClassFactory, for building against the Win32 shims.  Interfaces are
+// abstract classes, as they are to the Windows SDK's C++ headers, so their vtables are the
+// compiler's; nothing here crosses into code another compiler built.
+
+#pragma once
+
+#include <windows.h>
+
+EXTERN_C const IID IID_IUnknown;
+EXTERN_C const IID IID_IClassFactory;
+
+struct IUnknown
+{
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(__in REFIID riid, __deref_out void** ppvObject) = 0;
+    virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+    virtual ULONG STDMETHODCALLTYPE Release() = 0;
+};
+
+typedef IUnknown* LPUNKNOWN;
+
+struct IClassFactory : public IUnknown
+{
+    virtual HRESULT STDMETHODCALLTYPE CreateInstance(__in_opt IUnknown* pUnkOuter, __in REFIID riid,
+        __deref_out void** ppvObject) = 0;
+    virtual HRESULT STDMETHODCALLTYPE LockServer(__in BOOL fLock) = 0;
+};
+
+// IID_PPV_ARGS finds an interface's IID by the type of the pointer it is given, as
+// __uuidof does on Windows; each interface declares its own overload.
+#define WIN32_SHIM_IID_OF(I) \
+    inline REFIID Win32ShimIidOf(I**) { return IID_##I; }
+
+WIN32_SHIM_IID_OF(IUnknown)
+WIN32_SHIM_IID_OF(IClassFactory)
+
+#define IID_PPV_ARGS(ppType) Win32ShimIidOf(ppType), reinterpret_cast<void**>(ppType)
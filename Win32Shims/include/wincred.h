@@ -0,0 +1,43 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// CredProtect and the authentication buffer packing calls, for building against the Win32
+// shims.
+//
+// CredProtectW here only marks a string as protected, in a form CredIsProtectedW and
+// CredUnprotectW recognize: it encodes, it does not encrypt, and nothing but these shims
+// will take what it returns.  The packing calls need the credential UI's buffer format and
+// fail with ERROR_NOT_SUPPORTED.
+
+#pragma once
+
+#include <windows.h>
+
+typedef enum _CRED_PROTECTION_TYPE
+{
+    CredUnprotected,
+    CredUserProtection,
+    CredTrustedProtection,
+} CRED_PROTECTION_TYPE, *PCRED_PROTECTION_TYPE;
+
+#define CRED_PACK_PROTECTED_CREDENTIALS 0x1
+#define CRED_PACK_WOW_BUFFER 0x2
+#define CRED_PACK_GENERIC_CREDENTIALS 0x4
+
+EXTERN_C BOOL WINAPI CredProtectW(__in BOOL fAsSelf, __in_ecount(cchCredentials) LPWSTR pszCredentials,
+    __in DWORD cchCredentials, __out_ecount(*pcchMaxChars) LPWSTR pszProtectedCredentials, __inout DWORD* pcchMaxChars,
+    __out_opt CRED_PROTECTION_TYPE* ProtectionType);
+EXTERN_C BOOL WINAPI CredUnprotectW(__in BOOL fAsSelf, __in_ecount(cchProtectedCredentials) LPWSTR pszProtectedCredentials,
+    __in DWORD cchProtectedCredentials, __out_ecount_opt(*pcchMaxChars) LPWSTR pszCredentials, __inout DWORD* pcchMaxChars);
+EXTERN_C BOOL WINAPI CredIsProtectedW(__in LPWSTR pszProtectedCredentials, __out CRED_PROTECTION_TYPE* pProtectionType);
+EXTERN_C BOOL WINAPI CredPackAuthenticationBufferW(__in DWORD dwFlags, __in LPWSTR pszUserName, __in LPWSTR pszPassword,
+    __out_bcount_opt(*pcbPackedCredentials) PBYTE pPackedCredentials, __inout DWORD* pcbPackedCredentials);
+EXTERN_C BOOL WINAPI CredUnPackAuthenticationBufferW(__in DWORD dwFlags, __in_bcount(cbAuthBuffer) PVOID pAuthBuffer,
+    __in DWORD cbAuthBuffer, __out_ecount_opt(*pcchMaxUserName) LPWSTR pszUserName, __inout DWORD* pcchMaxUserName,
+    __out_ecount_opt(*pcchMaxDomainName) LPWSTR pszDomainName, __inout_opt DWORD* pcchMaxDomainName,
+    __out_ecount_opt(*pcchMaxPassword) LPWSTR pszPassword, __inout DWORD* pcchMaxPassword);
@@ -0,0 +1,788 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The part of the Windows SDK's windows.h that the provider, the helpers and the tools that
+// host them use, for building them off Windows against the Win32 shims.  Types keep their
+// Windows sizes, so WCHAR is wchar_t, four bytes here, and DWORD, ULONG and LONG are 32
+// bits.  The functions are the Win32Shims library's; Win32Shims/CMakeLists.txt says which
+// of its sources implements what.
+
+#pragma once
+
+// The C and C++ library go first: libstdc++ names parameters __in and __out, which the
+// annotations below would otherwise erase.
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <pthread.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+// Source annotations; only the compiler that checks them reads them.
+#define __in
+#define __in_opt
+#define __out
+#define __out_opt
+#define __inout
+#define __inout_opt
+#define __deref_out
+#define __deref_out_opt
+#define __override
+#define __reserved
+#define __in_bcount(cb)
+#define __in_ecount(cch)
+#define __out_bcount(cb)
+#define __out_ecount(cch)
+#define __inout_bcount(cb)
+#define __inout_ecount(cch)
+#define __deref_out_bcount(cb)
+#define __deref_out_ecount(cch)
+#define __out_ecount_opt(cch)
+#define __out_bcount_opt(cb)
+#define __out_range(lb, ub)
+
+// Calling conventions; there is one here.
+#define __cdecl
+#define __stdcall
+#define WINAPI
+#define APIENTRY
+#define CALLBACK
+#define STDMETHODCALLTYPE
+#define STDAPICALLTYPE
+#define NTAPI
+
+#define EXTERN_C extern "C"
+#define STDAPI EXTERN_C HRESULT STDAPICALLTYPE
+#define STDAPI_(type) EXTERN_C type STDAPICALLTYPE
+#define STDMETHODIMP HRESULT STDMETHODCALLTYPE
+#define STDMETHODIMP_(type) type STDMETHODCALLTYPE
+#define IFACEMETHODIMP STDMETHODIMP
+#define IFACEMETHODIMP_(type) STDMETHODIMP_(type)
+
+#define UNREFERENCED_PARAMETER(P) (void)(P)
+#define ARRAYSIZE(A) (sizeof(A) / sizeof((A)[0]))
+#define _countof(A) ARRAYSIZE(A)
+
+#define TRUE 1
+#define FALSE 0
+
+typedef int BOOL;
+typedef unsigned char BOOLEAN;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned short USHORT;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef uint32_t DWORD;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef long long LONG64;
+typedef unsigned long long ULONG64;
+typedef unsigned long long DWORD64;
+typedef intptr_t INT_PTR;
+typedef uintptr_t UINT_PTR;
+typedef intptr_t LONG_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef uintptr_t DWORD_PTR;
+typedef size_t SIZE_T;
+typedef char CHAR;
+typedef wchar_t WCHAR;
+typedef WCHAR TCHAR;
+typedef float FLOAT;
+
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef BOOL* PBOOL;
+typedef BOOL* LPBOOL;
+typedef BYTE* PBYTE;
+typedef BYTE* LPBYTE;
+typedef WORD* PWORD;
+typedef USHORT* PUSHORT;
+typedef LONG* PLONG;
+typedef ULONG* PULONG;
+typedef DWORD* PDWORD;
+typedef DWORD* LPDWORD;
+typedef ULONG_PTR* PULONG_PTR;
+typedef SIZE_T* PSIZE_T;
+typedef CHAR* PCHAR;
+typedef CHAR* PSTR;
+typedef CHAR* LPSTR;
+typedef const CHAR* PCSTR;
+typedef const CHAR* LPCSTR;
+typedef WCHAR* PWCHAR;
+typedef WCHAR* PWSTR;
+typedef WCHAR* LPWSTR;
+typedef const WCHAR* PCWSTR;
+typedef const WCHAR* LPCWSTR;
+typedef WCHAR* LPTSTR;
+typedef const WCHAR* LPCTSTR;
+
+typedef LONG HRESULT;
+typedef LONG NTSTATUS;
+typedef LONG LSTATUS;
+typedef WORD LANGID;
+typedef WORD ATOM;
+
+#define MAXDWORD 0xffffffff
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+
+typedef void* HANDLE;
+typedef HANDLE* PHANDLE;
+typedef HANDLE HLOCAL;
+typedef HANDLE HGLOBAL;
+typedef void* HGDIOBJ;
+
+#define DECLARE_HANDLE(name) struct name##__ { int unused; }; typedef struct name##__* name
+DECLARE_HANDLE(HWND);
+DECLARE_HANDLE(HINSTANCE);
+DECLARE_HANDLE(HKEY);
+DECLARE_HANDLE(HBITMAP);
+DECLARE_HANDLE(HICON);
+DECLARE_HANDLE(HBRUSH);
+DECLARE_HANDLE(HMENU);
+typedef HICON HCURSOR;
+typedef HINSTANCE HMODULE;
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+
+typedef union _LARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef union _ULARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+        DWORD HighPart;
+    };
+    ULONGLONG QuadPart;
+} ULARGE_INTEGER, *PULARGE_INTEGER;
+
+typedef struct _LUID
+{
+    DWORD LowPart;
+    LONG HighPart;
+} LUID, *PLUID;
+
+typedef struct _FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME, *PFILETIME;
+
+typedef struct _SYSTEMTIME
+{
+    WORD wYear;
+    WORD wMonth;
+    WORD wDayOfWeek;
+    WORD wDay;
+    WORD wHour;
+    WORD wMinute;
+    WORD wSecond;
+    WORD wMilliseconds;
+} SYSTEMTIME, *PSYSTEMTIME, *LPSYSTEMTIME;
+
+//
+// GUIDs.  DEFINE_GUID declares one; after initguid.h it defines it.
+//
+
+typedef struct _GUID
+{
+    ULONG Data1;
+    USHORT Data2;
+    USHORT Data3;
+    BYTE Data4[8];
+} GUID;
+
+typedef GUID IID;
+typedef GUID CLSID;
+typedef GUID* LPGUID;
+typedef const GUID& REFGUID;
+typedef const IID& REFIID;
+typedef const CLSID& REFCLSID;
+
+inline bool IsEqualGUID(REFGUID rguid1, REFGUID rguid2)
+{
+    return 0 == memcmp(&rguid1, &rguid2, sizeof(GUID));
+}
+#define IsEqualIID(riid1, riid2) IsEqualGUID(riid1, riid2)
+#define IsEqualCLSID(rclsid1, rclsid2) IsEqualGUID(rclsid1, rclsid2)
+
+inline bool operator==(REFGUID guidOne, REFGUID guidOther)
+{
+    return IsEqualGUID(guidOne, guidOther);
+}
+
+inline bool operator!=(REFGUID guidOne, REFGUID guidOther)
+{
+    return !(guidOne == guidOther);
+}
+
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+    EXTERN_C const GUID name
+
+EXTERN_C const GUID GUID_NULL;
+
+//
+// HRESULTs and Win32 error codes.
+//
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define HRESULT_CODE(hr) ((hr) & 0xFFFF)
+#define HRESULT_FACILITY(hr) (((hr) >> 16) & 0x1fff)
+#define MAKE_HRESULT(sev, fac, code) \
+    ((HRESULT)(((unsigned long)(sev) << 31) | ((unsigned long)(fac) << 16) | ((unsigned long)(code))))
+
+#define FACILITY_WIN32 7
+#define FACILITY_NT_BIT 0x10000000
+
+inline HRESULT HRESULT_FROM_WIN32(unsigned long x)
+{
+    return (HRESULT)(x) <= 0 ? (HRESULT)(x) : (HRESULT)(((x) & 0x0000FFFF) | (FACILITY_WIN32 << 16) | 0x80000000);
+}
+
+#define HRESULT_FROM_NT(x) ((HRESULT)((x) | FACILITY_NT_BIT))
+
+#define S_OK ((HRESULT)0L)
+#define S_FALSE ((HRESULT)1L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define E_ABORT ((HRESULT)0x80004004L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_UNEXPECTED ((HRESULT)0x8000FFFFL)
+#define E_PENDING ((HRESULT)0x8000000AL)
+#define E_ACCESSDENIED ((HRESULT)0x80070005L)
+#define E_HANDLE ((HRESULT)0x80070006L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define CLASS_E_NOAGGREGATION ((HRESULT)0x80040110L)
+#define CLASS_E_CLASSNOTAVAILABLE ((HRESULT)0x80040111L)
+#define CO_E_NOTINITIALIZED ((HRESULT)0x800401F0L)
+#define RPC_E_CHANGED_MODE ((HRESULT)0x80010106L)
+
+#define ERROR_SUCCESS 0L
+#define NO_ERROR 0L
+#define ERROR_INVALID_FUNCTION 1L
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_PATH_NOT_FOUND 3L
+#define ERROR_ACCESS_DENIED 5L
+#define ERROR_INVALID_HANDLE 6L
+#define ERROR_NOT_ENOUGH_MEMORY 8L
+#define ERROR_INVALID_DATA 13L
+#define ERROR_OUTOFMEMORY 14L
+#define ERROR_WRITE_FAULT 29L
+#define ERROR_READ_FAULT 30L
+#define ERROR_GEN_FAILURE 31L
+#define ERROR_SHARING_VIOLATION 32L
+#define ERROR_HANDLE_EOF 38L
+#define ERROR_NOT_SUPPORTED 50L
+#define ERROR_FILE_EXISTS 80L
+#define ERROR_CANNOT_MAKE 82L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_BROKEN_PIPE 109L
+#define ERROR_BUFFER_OVERFLOW 111L
+#define ERROR_DISK_FULL 112L
+#define ERROR_INSUFFICIENT_BUFFER 122L
+#define ERROR_MOD_NOT_FOUND 126L
+#define ERROR_PROC_NOT_FOUND 127L
+#define ERROR_ALREADY_EXISTS 183L
+#define ERROR_BAD_EXE_FORMAT 193L
+#define ERROR_MORE_DATA 234L
+#define ERROR_NO_MORE_ITEMS 259L
+#define ERROR_ARITHMETIC_OVERFLOW 534L
+#define ERROR_FILE_INVALID 1006L
+#define ERROR_DLL_INIT_FAILED 1114L
+#define ERROR_INVALID_WINDOW_HANDLE 1400L
+#define ERROR_CLASS_ALREADY_EXISTS 1410L
+#define ERROR_CLASS_DOES_NOT_EXIST 1411L
+#define ERROR_CLASS_HAS_WINDOWS 1412L
+#define ERROR_NO_SUCH_USER 1317L
+#define ERROR_UNSUPPORTED_TYPE 1630L
+#define ERROR_RESOURCE_DATA_NOT_FOUND 1812L
+#define ERROR_RESOURCE_TYPE_NOT_FOUND 1813L
+#define ERROR_RESOURCE_NAME_NOT_FOUND 1814L
+
+//
+// kernel32: errors, memory, interlocked operations, slim reader/writer locks, files and
+// mappings, processes, modules and time.
+//
+
+EXTERN_C DWORD WINAPI GetLastError();
+EXTERN_C void WINAPI SetLastError(__in DWORD dwErrCode);
+
+#define CopyMemory(Destination, Source, Length) memcpy((Destination), (Source), (Length))
+#define MoveMemory(Destination, Source, Length) memmove((Destination), (Source), (Length))
+#define FillMemory(Destination, Length, Fill) memset((Destination), (Fill), (Length))
+#define ZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+EXTERN_C PVOID WINAPI SecureZeroMemory(__in PVOID ptr, __in SIZE_T cnt);
+
+#define HEAP_ZERO_MEMORY 0x00000008
+EXTERN_C HANDLE WINAPI GetProcessHeap();
+EXTERN_C LPVOID WINAPI HeapAlloc(__in HANDLE hHeap, __in DWORD dwFlags, __in SIZE_T dwBytes);
+EXTERN_C BOOL WINAPI HeapFree(__in HANDLE hHeap, __in DWORD dwFlags, __in_opt LPVOID lpMem);
+
+#define LMEM_FIXED 0x0000
+#define LMEM_ZEROINIT 0x0040
+#define LPTR (LMEM_FIXED | LMEM_ZEROINIT)
+EXTERN_C HLOCAL WINAPI LocalAlloc(__in UINT uFlags, __in SIZE_T uBytes);
+EXTERN_C HLOCAL WINAPI LocalFree(__in_opt HLOCAL hMem);
+
+// Each is a full barrier, as on Windows.
+inline LONG InterlockedIncrement(__inout LONG volatile* Addend)
+{
+    return __atomic_add_fetch(Addend, 1, __ATOMIC_SEQ_CST);
+}
+
+inline LONG InterlockedDecrement(__inout LONG volatile* Addend)
+{
+    return __atomic_sub_fetch(Addend, 1, __ATOMIC_SEQ_CST);
+}
+
+inline LONG InterlockedExchange(__inout LONG volatile* Target, __in LONG Value)
+{
+    return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST);
+}
+
+inline LONG InterlockedExchangeAdd(__inout LONG volatile* Addend, __in LONG Value)
+{
+    return __atomic_fetch_add(Addend, Value, __ATOMIC_SEQ_CST);
+}
+
+inline LONG InterlockedCompareExchange(__inout LONG volatile* Destination, __in LONG ExChange, __in LONG Comperand)
+{
+    __atomic_compare_exchange_n(Destination, &Comperand, ExChange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return Comperand;
+}
+
+inline LONG64 InterlockedIncrement64(__inout LONG64 volatile* Addend)
+{
+    return __atomic_add_fetch(Addend, 1, __ATOMIC_SEQ_CST);
+}
+
+inline LONG64 InterlockedExchange64(__inout LONG64 volatile* Target, __in LONG64 Value)
+{
+    return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST);
+}
+
+inline LONG64 InterlockedCompareExchange64(__inout LONG64 volatile* Destination, __in LONG64 ExChange, __in LONG64 Comperand)
+{
+    __atomic_compare_exchange_n(Destination, &Comperand, ExChange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return Comperand;
+}
+
+inline PVOID InterlockedExchangePointer(__inout PVOID volatile* Target, __in_opt PVOID Value)
+{
+    return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST);
+}
+
+inline PVOID InterlockedCompareExchangePointer(__inout PVOID volatile* Destination, __in_opt PVOID ExChange, __in_opt PVOID Comperand)
+{
+    __atomic_compare_exchange_n(Destination, &Comperand, ExChange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return Comperand;
+}
+
+// A slim reader/writer lock needs no cleanup on Windows, and a pthread one that is never
+// destroyed holds nothing either.
+typedef struct _SRWLOCK
+{
+    pthread_rwlock_t rwl;
+} SRWLOCK, *PSRWLOCK;
+
+#define SRWLOCK_INIT { PTHREAD_RWLOCK_INITIALIZER }
+
+inline void InitializeSRWLock(__out PSRWLOCK SRWLock)
+{
+    pthread_rwlock_init(&SRWLock->rwl, NULL);
+}
+
+inline void AcquireSRWLockExclusive(__inout PSRWLOCK SRWLock)
+{
+    pthread_rwlock_wrlock(&SRWLock->rwl);
+}
+
+inline void ReleaseSRWLockExclusive(__inout PSRWLOCK SRWLock)
+{
+    pthread_rwlock_unlock(&SRWLock->rwl);
+}
+
+inline void AcquireSRWLockShared(__inout PSRWLOCK SRWLock)
+{
+    pthread_rwlock_rdlock(&SRWLock->rwl);
+}
+
+inline void ReleaseSRWLockShared(__inout PSRWLOCK SRWLock)
+{
+    pthread_rwlock_unlock(&SRWLock->rwl);
+}
+
+typedef struct _SECURITY_ATTRIBUTES
+{
+    DWORD nLength;
+    LPVOID lpSecurityDescriptor;
+    BOOL bInheritHandle;
+} SECURITY_ATTRIBUTES, *PSECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+
+typedef struct _OVERLAPPED OVERLAPPED, *LPOVERLAPPED;
+
+#define GENERIC_READ 0x80000000L
+#define GENERIC_WRITE 0x40000000L
+#define FILE_SHARE_READ 0x00000001
+#define FILE_SHARE_WRITE 0x00000002
+#define FILE_SHARE_DELETE 0x00000004
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define TRUNCATE_EXISTING 5
+#define FILE_ATTRIBUTE_READONLY 0x00000001
+#define FILE_ATTRIBUTE_DIRECTORY 0x00000010
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define INVALID_FILE_ATTRIBUTES ((DWORD)-1)
+
+typedef enum _GET_FILEEX_INFO_LEVELS
+{
+    GetFileExInfoStandard,
+    GetFileExMaxInfoLevel
+} GET_FILEEX_INFO_LEVELS;
+
+typedef struct _WIN32_FILE_ATTRIBUTE_DATA
+{
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+} WIN32_FILE_ATTRIBUTE_DATA, *LPWIN32_FILE_ATTRIBUTE_DATA;
+
+EXTERN_C HANDLE WINAPI CreateFileW(__in LPCWSTR lpFileName, __in DWORD dwDesiredAccess, __in DWORD dwShareMode,
+    __in_opt LPSECURITY_ATTRIBUTES lpSecurityAttributes, __in DWORD dwCreationDisposition,
+    __in DWORD dwFlagsAndAttributes, __in_opt HANDLE hTemplateFile);
+EXTERN_C BOOL WINAPI ReadFile(__in HANDLE hFile, __out_bcount(nNumberOfBytesToRead) LPVOID lpBuffer,
+    __in DWORD nNumberOfBytesToRead, __out_opt LPDWORD lpNumberOfBytesRead, __inout_opt LPOVERLAPPED lpOverlapped);
+EXTERN_C BOOL WINAPI WriteFile(__in HANDLE hFile, __in_bcount(nNumberOfBytesToWrite) LPCVOID lpBuffer,
+    __in DWORD nNumberOfBytesToWrite, __out_opt LPDWORD lpNumberOfBytesWritten, __inout_opt LPOVERLAPPED lpOverlapped);
+EXTERN_C BOOL WINAPI GetFileSizeEx(__in HANDLE hFile, __out PLARGE_INTEGER lpFileSize);
+EXTERN_C BOOL WINAPI GetFileAttributesExW(__in LPCWSTR lpFileName, __in GET_FILEEX_INFO_LEVELS fInfoLevelId,
+    __out LPVOID lpFileInformation);
+EXTERN_C BOOL WINAPI DeleteFileW(__in LPCWSTR lpFileName);
+EXTERN_C DWORD WINAPI GetTempPathW(__in DWORD nBufferLength, __out_ecount(nBufferLength) LPWSTR lpBuffer);
+EXTERN_C BOOL WINAPI CloseHandle(__in HANDLE hObject);
+
+#define HANDLE_FLAG_INHERIT 0x00000001
+EXTERN_C BOOL WINAPI SetHandleInformation(__in HANDLE hObject, __in DWORD dwMask, __in DWORD dwFlags);
+
+#define STD_INPUT_HANDLE ((DWORD)-10)
+#define STD_OUTPUT_HANDLE ((DWORD)-11)
+#define STD_ERROR_HANDLE ((DWORD)-12)
+EXTERN_C HANDLE WINAPI GetStdHandle(__in DWORD nStdHandle);
+
+EXTERN_C BOOL WINAPI CreatePipe(__out PHANDLE hReadPipe, __out PHANDLE hWritePipe,
+    __in_opt LPSECURITY_ATTRIBUTES lpPipeAttributes, __in DWORD nSize);
+
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+#define FILE_MAP_WRITE 0x0002
+#define FILE_MAP_READ 0x0004
+#define FILE_MAP_ALL_ACCESS 0x000f001f
+EXTERN_C HANDLE WINAPI CreateFileMappingW(__in HANDLE hFile, __in_opt LPSECURITY_ATTRIBUTES lpFileMappingAttributes,
+    __in DWORD flProtect, __in DWORD dwMaximumSizeHigh, __in DWORD dwMaximumSizeLow, __in_opt LPCWSTR lpName);
+EXTERN_C LPVOID WINAPI MapViewOfFile(__in HANDLE hFileMappingObject, __in DWORD dwDesiredAccess,
+    __in DWORD dwFileOffsetHigh, __in DWORD dwFileOffsetLow, __in SIZE_T dwNumberOfBytesToMap);
+EXTERN_C BOOL WINAPI UnmapViewOfFile(__in LPCVOID lpBaseAddress);
+
+#define WAIT_OBJECT_0 ((DWORD)0x00000000L)
+#define WAIT_TIMEOUT 258L
+#define WAIT_FAILED ((DWORD)0xFFFFFFFF)
+#define STILL_ACTIVE 259L
+EXTERN_C DWORD WINAPI WaitForSingleObject(__in HANDLE hHandle, __in DWORD dwMilliseconds);
+EXTERN_C void WINAPI Sleep(__in DWORD dwMilliseconds);
+
+#define STARTF_USESTDHANDLES 0x00000100
+
+typedef struct _STARTUPINFOW
+{
+    DWORD cb;
+    LPWSTR lpReserved;
+    LPWSTR lpDesktop;
+    LPWSTR lpTitle;
+    DWORD dwX;
+    DWORD dwY;
+    DWORD dwXSize;
+    DWORD dwYSize;
+    DWORD dwXCountChars;
+    DWORD dwYCountChars;
+    DWORD dwFillAttribute;
+    DWORD dwFlags;
+    WORD wShowWindow;
+    WORD cbReserved2;
+    LPBYTE lpReserved2;
+    HANDLE hStdInput;
+    HANDLE hStdOutput;
+    HANDLE hStdError;
+} STARTUPINFOW, *LPSTARTUPINFOW;
+
+typedef struct _PROCESS_INFORMATION
+{
+    HANDLE hProcess;
+    HANDLE hThread;
+    DWORD dwProcessId;
+    DWORD dwThreadId;
+} PROCESS_INFORMATION, *PPROCESS_INFORMATION, *LPPROCESS_INFORMATION;
+
+// The command line is split as CommandLineToArgvW would, and the first argument is the
+// program, found as posix_spawnp finds it when lpApplicationName is NULL.
+EXTERN_C BOOL WINAPI CreateProcessW(__in_opt LPCWSTR lpApplicationName, __inout_opt LPWSTR lpCommandLine,
+    __in_opt LPSECURITY_ATTRIBUTES lpProcessAttributes, __in_opt LPSECURITY_ATTRIBUTES lpThreadAttributes,
+    __in BOOL bInheritHandles, __in DWORD dwCreationFlags, __in_opt LPVOID lpEnvironment,
+    __in_opt LPCWSTR lpCurrentDirectory, __in LPSTARTUPINFOW lpStartupInfo,
+    __out LPPROCESS_INFORMATION lpProcessInformation);
+EXTERN_C BOOL WINAPI GetExitCodeProcess(__in HANDLE hProcess, __out LPDWORD lpExitCode);
+EXTERN_C HANDLE WINAPI GetCurrentProcess();
+EXTERN_C DWORD WINAPI GetCurrentProcessId();
+EXTERN_C DWORD WINAPI GetCurrentThreadId();
+
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+#define DLL_THREAD_ATTACH 2
+#define DLL_THREAD_DETACH 3
+
+#define LOAD_LIBRARY_AS_DATAFILE 0x00000002
+#define LOAD_LIBRARY_AS_IMAGE_RESOURCE 0x00000020
+
+// void (*)(void) rather than the SDK's INT_PTR (*)(): it is the type GCC lets a caller cast
+// to the export's real one without a warning.
+typedef void (WINAPI *FARPROC)(void);
+
+// A name without a directory is looked for next to the executable first, as Windows does,
+// and DllMain is called as the loader would call it.
+EXTERN_C HMODULE WINAPI LoadLibraryW(__in LPCWSTR lpLibFileName);
+EXTERN_C HMODULE WINAPI LoadLibraryExW(__in LPCWSTR lpLibFileName, __reserved HANDLE hFile, __in DWORD dwFlags);
+EXTERN_C BOOL WINAPI FreeLibrary(__in HMODULE hLibModule);
+EXTERN_C FARPROC WINAPI GetProcAddress(__in HMODULE hModule, __in LPCSTR lpProcName);
+EXTERN_C DWORD WINAPI GetModuleFileNameW(__in_opt HMODULE hModule, __out_ecount(nSize) LPWSTR lpFilename, __in DWORD nSize);
+EXTERN_C BOOL WINAPI DisableThreadLibraryCalls(__in HMODULE hLibModule);
+
+EXTERN_C BOOL WINAPI QueryPerformanceCounter(__out LARGE_INTEGER* lpPerformanceCount);
+EXTERN_C BOOL WINAPI QueryPerformanceFrequency(__out LARGE_INTEGER* lpFrequency);
+EXTERN_C ULONGLONG WINAPI GetTickCount64();
+EXTERN_C void WINAPI GetLocalTime(__out LPSYSTEMTIME lpSystemTime);
+
+#define MAX_COMPUTERNAME_LENGTH 15
+EXTERN_C BOOL WINAPI GetComputerNameW(__out_ecount(*nSize) LPWSTR lpBuffer, __inout LPDWORD nSize);
+
+#define MAKELANGID(p, s) ((((WORD)(s)) << 10) | (WORD)(p))
+#define PRIMARYLANGID(lgid) ((WORD)(lgid) & 0x3ff)
+#define LANG_NEUTRAL 0x00
+#define LANG_GERMAN 0x07
+#define LANG_ENGLISH 0x09
+#define LANG_SPANISH 0x0a
+#define LANG_FRENCH 0x0c
+#define SUBLANG_NEUTRAL 0x00
+#define SUBLANG_DEFAULT 0x01
+#define SUBLANG_ENGLISH_US 0x01
+#define SUBLANG_GERMAN 0x01
+#define SUBLANG_FRENCH 0x01
+#define SUBLANG_SPANISH_MODERN 0x03
+
+// The thread's UI language picks the string table LoadStringW reads; it starts out as
+// English (United States).
+EXTERN_C LANGID WINAPI GetThreadUILanguage();
+EXTERN_C LANGID WINAPI SetThreadUILanguage(__in LANGID LangId);
+
+EXTERN_C int WINAPI lstrlenA(__in_opt LPCSTR lpString);
+EXTERN_C int WINAPI lstrlenW(__in_opt LPCWSTR lpString);
+EXTERN_C int WINAPI lstrcmpW(__in LPCWSTR lpString1, __in LPCWSTR lpString2);
+EXTERN_C int WINAPI lstrcmpiW(__in LPCWSTR lpString1, __in LPCWSTR lpString2);
+#define lstrlen lstrlenW
+#define lstrcmp lstrcmpW
+#define lstrcmpi lstrcmpiW
+
+//
+// advapi32: the registry.
+//
+
+#define HKEY_CLASSES_ROOT ((HKEY)(ULONG_PTR)((LONG)0x80000000))
+#define HKEY_CURRENT_USER ((HKEY)(ULONG_PTR)((LONG)0x80000001))
+#define HKEY_LOCAL_MACHINE ((HKEY)(ULONG_PTR)((LONG)0x80000002))
+
+#define REG_NONE 0
+#define REG_SZ 1
+#define REG_EXPAND_SZ 2
+#define REG_BINARY 3
+#define REG_DWORD 4
+#define REG_MULTI_SZ 7
+#define REG_QWORD 11
+
+#define RRF_RT_REG_NONE 0x00000001
+#define RRF_RT_REG_SZ 0x00000002
+#define RRF_RT_REG_EXPAND_SZ 0x00000004
+#define RRF_RT_REG_BINARY 0x00000008
+#define RRF_RT_REG_DWORD 0x00000010
+#define RRF_RT_REG_MULTI_SZ 0x00000020
+#define RRF_RT_REG_QWORD 0x00000040
+#define RRF_RT_ANY 0x0000ffff
+
+// The registry is one per process and starts out empty; RegSetKeyValueW fills it in.
+EXTERN_C LSTATUS WINAPI RegGetValueW(__in HKEY hkey, __in_opt LPCWSTR lpSubKey, __in_opt LPCWSTR lpValue,
+    __in DWORD dwFlags, __out_opt LPDWORD pdwType, __out_bcount(*pcbData) PVOID pvData, __inout_opt LPDWORD pcbData);
+EXTERN_C LSTATUS WINAPI RegSetKeyValueW(__in HKEY hKey, __in_opt LPCWSTR lpSubKey, __in_opt LPCWSTR lpValueName,
+    __in DWORD dwType, __in_bcount(cbData) LPCVOID lpData, __in DWORD cbData);
+EXTERN_C LSTATUS WINAPI RegDeleteKeyValueW(__in HKEY hKey, __in_opt LPCWSTR lpSubKey, __in_opt LPCWSTR lpValueName);
+
+//
+// user32: window classes, message-only windows and their queues, and string resources.
+//
+
+typedef UINT_PTR WPARAM;
+typedef LONG_PTR LPARAM;
+typedef LONG_PTR LRESULT;
+
+typedef LRESULT (CALLBACK *WNDPROC)(HWND, UINT, WPARAM, LPARAM);
+
+typedef struct tagWNDCLASSEXW
+{
+    UINT cbSize;
+    UINT style;
+    WNDPROC lpfnWndProc;
+    int cbClsExtra;
+    int cbWndExtra;
+    HINSTANCE hInstance;
+    HICON hIcon;
+    HCURSOR hCursor;
+    HBRUSH hbrBackground;
+    LPCWSTR lpszMenuName;
+    LPCWSTR lpszClassName;
+    HICON hIconSm;
+} WNDCLASSEXW, *PWNDCLASSEXW;
+
+typedef struct tagPOINT
+{
+    LONG x;
+    LONG y;
+} POINT;
+
+typedef struct tagMSG
+{
+    HWND hwnd;
+    UINT message;
+    WPARAM wParam;
+    LPARAM lParam;
+    DWORD time;
+    POINT pt;
+} MSG, *PMSG, *LPMSG;
+
+#define HWND_MESSAGE ((HWND)-3)
+#define GWLP_USERDATA (-21)
+#define WM_NULL 0x0000
+#define WM_DESTROY 0x0002
+#define WM_QUIT 0x0012
+#define WM_USER 0x0400
+#define WM_APP 0x8000
+#define PM_NOREMOVE 0x0000
+#define PM_REMOVE 0x0001
+
+EXTERN_C ATOM WINAPI RegisterClassExW(__in const WNDCLASSEXW* lpwcx);
+EXTERN_C BOOL WINAPI UnregisterClassW(__in LPCWSTR lpClassName, __in_opt HINSTANCE hInstance);
+EXTERN_C HWND WINAPI CreateWindowExW(__in DWORD dwExStyle, __in_opt LPCWSTR lpClassName, __in_opt LPCWSTR lpWindowName,
+    __in DWORD dwStyle, __in int X, __in int Y, __in int nWidth, __in int nHeight, __in_opt HWND hWndParent,
+    __in_opt HMENU hMenu, __in_opt HINSTANCE hInstance, __in_opt LPVOID lpParam);
+EXTERN_C BOOL WINAPI DestroyWindow(__in HWND hWnd);
+EXTERN_C LONG_PTR WINAPI SetWindowLongPtrW(__in HWND hWnd, __in int nIndex, __in LONG_PTR dwNewLong);
+EXTERN_C LONG_PTR WINAPI GetWindowLongPtrW(__in HWND hWnd, __in int nIndex);
+EXTERN_C LRESULT WINAPI DefWindowProcW(__in HWND hWnd, __in UINT Msg, __in WPARAM wParam, __in LPARAM lParam);
+
+// Posted messages wait in the queue of the thread that created the window until that thread
+// pumps them, as on Windows.
+EXTERN_C BOOL WINAPI PostMessageW(__in_opt HWND hWnd, __in UINT Msg, __in WPARAM wParam, __in LPARAM lParam);
+EXTERN_C BOOL WINAPI PeekMessageW(__out LPMSG lpMsg, __in_opt HWND hWnd, __in UINT wMsgFilterMin,
+    __in UINT wMsgFilterMax, __in UINT wRemoveMsg);
+EXTERN_C LRESULT WINAPI DispatchMessageW(__in const MSG* lpMsg);
+
+#define MAKEINTRESOURCEW(i) ((LPWSTR)((ULONG_PTR)((WORD)(i))))
+#define MAKEINTRESOURCE MAKEINTRESOURCEW
+#define IS_INTRESOURCE(r) ((((ULONG_PTR)(r)) >> 16) == 0)
+
+// The string tables and bitmaps come from the module's resources.rc, compiled into it by
+// Win32Shims/Win32ShimModule.cmake.
+EXTERN_C int WINAPI LoadStringW(__in_opt HINSTANCE hInstance, __in UINT uID, __out_ecount(cchBufferMax) LPWSTR lpBuffer,
+    __in int cchBufferMax);
+EXTERN_C HBITMAP WINAPI LoadBitmapW(__in_opt HINSTANCE hInstance, __in LPCWSTR lpBitmapName);
+#define LoadString LoadStringW
+#define LoadBitmap LoadBitmapW
+
+//
+// gdi32.
+//
+
+EXTERN_C BOOL WINAPI DeleteObject(__in HGDIOBJ ho);
+
+//
+// The C runtime's wide formatted output, which, unlike the C library's, takes %s and %c for
+// wide strings and characters and %S and %C for narrow ones.
+//
+
+EXTERN_C int Win32ShimVfwprintf(__in FILE* pf, __in const wchar_t* pwzFormat, __in va_list va);
+EXTERN_C int Win32ShimFwprintf(__in FILE* pf, __in const wchar_t* pwzFormat, ...);
+EXTERN_C int Win32ShimWprintf(__in const wchar_t* pwzFormat, ...);
+EXTERN_C int Win32ShimVsnwprintf(__out_ecount(cch) wchar_t* pwz, __in size_t cch, __in const wchar_t* pwzFormat,
+    __in va_list va);
+#define vfwprintf Win32ShimVfwprintf
+#define fwprintf Win32ShimFwprintf
+#define wprintf Win32ShimWprintf
+
+// Neither the tools nor the provider scan strings with these, so the C library's own do.
+#define sscanf_s sscanf
+
+//
+// The C runtime's checked stream functions.  _wfopen_s takes a wide path; fwscanf_s takes
+// the runtime's format conventions, and a buffer size in characters after the buffer of each
+// %s and %c.
+//
+
+typedef int errno_t;
+
+EXTERN_C errno_t Win32ShimWfopenS(__out FILE** ppf, __in const wchar_t* pwzPath, __in const wchar_t* pwzMode);
+EXTERN_C int Win32ShimVfwscanfS(__in FILE* pf, __in const wchar_t* pwzFormat, __in va_list va);
+EXTERN_C int Win32ShimFwscanfS(__in FILE* pf, __in const wchar_t* pwzFormat, ...);
+#define _wfopen_s Win32ShimWfopenS
+#define vfwscanf_s Win32ShimVfwscanfS
+#define fwscanf_s Win32ShimFwscanfS
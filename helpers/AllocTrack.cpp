@@ -0,0 +1,148 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Per-thread allocation budgets.
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include "Platform.h"
+#include "AllocTrack.h"
+
+#ifdef ALLOC_TRACKING
+
+static thread_local CAllocScope* t_pScope = NULL;
+static std::atomic<PFN_ALLOC_BUDGET_EXCEEDED> s_pfnExceeded(NULL);
+
+void AllocTrackAlloc(size_t cb)
+{
+    CAllocScope* pScope = t_pScope;
+    if (pScope)
+    {
+        pScope->OnAlloc(cb);
+    }
+}
+
+void AllocTrackFree()
+{
+    CAllocScope* pScope = t_pScope;
+    if (pScope)
+    {
+        pScope->OnFree();
+    }
+}
+
+PFN_ALLOC_BUDGET_EXCEEDED AllocTrackSetExceededHandler(PFN_ALLOC_BUDGET_EXCEEDED pfnExceeded)
+{
+    return s_pfnExceeded.exchange(pfnExceeded);
+}
+
+// Everything the module allocates with new is charged, the standard library's strings and
+// containers included.  The array and the remaining nothrow forms call these.
+static void* _TrackedMalloc(size_t cb)
+{
+    void* pv = malloc(cb ? cb : 1);
+    if (pv)
+    {
+        AllocTrackAlloc(cb);
+    }
+    return pv;
+}
+
+static void _TrackedFree(void* pv)
+{
+    if (pv)
+    {
+        AllocTrackFree();
+        free(pv);
+    }
+}
+
+void* operator new(size_t cb)
+{
+    void* pv = _TrackedMalloc(cb);
+    if (!pv)
+    {
+        throw std::bad_alloc();
+    }
+    return pv;
+}
+
+void* operator new(size_t cb, const std::nothrow_t&) noexcept
+{
+    return _TrackedMalloc(cb);
+}
+
+void operator delete(void* pv) noexcept
+{
+    _TrackedFree(pv);
+}
+
+void operator delete(void* pv, size_t) noexcept
+{
+    _TrackedFree(pv);
+}
+
+CAllocScope::CAllocScope(const char* pszName, unsigned long cMaxAllocs, unsigned long cMaxOutstanding) :
+    _pszName(pszName),
+    _cMaxAllocs(cMaxAllocs),
+    _cMaxOutstanding(cMaxOutstanding),
+    _cAllocs(0),
+    _cFrees(0),
+    _cbAllocated(0),
+    _pOuter(t_pScope)
+{
+    t_pScope = this;
+}
+
+CAllocScope::~CAllocScope()
+{
+    t_pScope = _pOuter;
+
+    // Frees of memory that came in from outside the scope can outnumber its own allocations.
+    long cOutstanding = static_cast<long>(_cAllocs) - static_cast<long>(_cFrees);
+    bool fOverAllocs = (_cMaxAllocs != ALLOC_BUDGET_UNLIMITED) && (_cAllocs > _cMaxAllocs);
+    bool fOverOutstanding = (_cMaxOutstanding != ALLOC_BUDGET_UNLIMITED) && (cOutstanding > static_cast<long>(_cMaxOutstanding));
+    PFN_ALLOC_BUDGET_EXCEEDED pfnExceeded = s_pfnExceeded.load();
+    if ((fOverAllocs || fOverOutstanding) && pfnExceeded)
+    {
+        pfnExceeded(_pszName, _cAllocs, cOutstanding);
+    }
+    else if (fOverAllocs || fOverOutstanding)
+    {
+        char szMessage[256];
+        snprintf(szMessage, sizeof(szMessage),
+            "%s: %lu allocations (%lu bytes), %ld still live; budget is %lu allocations, %lu live\n",
+            _pszName, _cAllocs, static_cast<unsigned long>(_cbAllocated), cOutstanding, _cMaxAllocs, _cMaxOutstanding);
+        PlatformDebugOutput(szMessage);
+        assert(!"allocation budget exceeded");
+    }
+
+    // Everything this scope saw also happened inside the scope around it.
+    if (_pOuter)
+    {
+        _pOuter->_cAllocs += _cAllocs;
+        _pOuter->_cFrees += _cFrees;
+        _pOuter->_cbAllocated += _cbAllocated;
+    }
+}
+
+CAllocUncharged::CAllocUncharged() :
+    _pHidden(t_pScope)
+{
+    t_pScope = NULL;
+}
+
+CAllocUncharged::~CAllocUncharged()
+{
+    t_pScope = _pHidden;
+}
+
+#endif
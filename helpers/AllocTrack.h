@@ -0,0 +1,113 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Allocation accounting.  With ALLOC_TRACKING defined (the default in Debug builds) every
+// allocation and free is charged to the innermost ALLOC_BUDGET on the calling thread: every
+// operator new and delete in the module, which AllocTrack.cpp replaces, and on Windows every
+// allocation through the Tracked* wrappers in AllocTrackWin32.h, which the provider and the
+// helpers call instead of CoTaskMemAlloc, SHStrDupW, HeapAlloc or LocalAlloc.  A budget that
+// is exceeded is reported with PlatformDebugOutput and asserts, unless a handler has been
+// set.  Without ALLOC_TRACKING ALLOC_BUDGET expands to nothing.
+//
+// What the system allocates for itself (BCrypt, the LSA) goes through none of these and is
+// not charged, and nor is what is allocated under ALLOC_UNCHARGED, for objects that belong to
+// no caller, such as the thread pool's own.
+//
+// An ALLOC_BUDGET(cMaxAllocs, cMaxOutstanding) at the top of a method says how many
+// allocations the method may make in total, including in everything it calls, and how many
+// of them may still be live when it returns (its outputs).
+//
+// Platform-neutral: this uses only the C++ standard library and Platform.h, and builds into
+// CredentialCore.
+
+#pragma once
+#include <stddef.h>
+
+#if defined(_DEBUG) && !defined(ALLOC_TRACKING)
+#define ALLOC_TRACKING
+#endif
+
+#define ALLOC_BUDGET_UNLIMITED ((unsigned long)-1)
+
+#ifdef ALLOC_TRACKING
+
+void AllocTrackAlloc(size_t cb);
+void AllocTrackFree();
+
+// Called, instead of the report and the assert, when a scope ends over its budget.
+typedef void (*PFN_ALLOC_BUDGET_EXCEEDED)(const char* pszName, unsigned long cAllocs, long cOutstanding);
+
+// Sets the handler for every thread and returns the one it replaces.  NULL restores the
+// report and the assert.
+PFN_ALLOC_BUDGET_EXCEEDED AllocTrackSetExceededHandler(PFN_ALLOC_BUDGET_EXCEEDED pfnExceeded);
+
+class CAllocScope
+{
+public:
+    CAllocScope(const char* pszName, unsigned long cMaxAllocs, unsigned long cMaxOutstanding);
+    ~CAllocScope();
+
+    void OnAlloc(size_t cb)
+    {
+        _cAllocs++;
+        _cbAllocated += cb;
+    }
+
+    void OnFree()
+    {
+        _cFrees++;
+    }
+
+    // What the scope has been charged so far, including what inner scopes that have ended
+    // were charged.  A scope with unlimited budgets is a counter.
+    unsigned long GetAllocs() const
+    {
+        return _cAllocs;
+    }
+
+    size_t GetBytesAllocated() const
+    {
+        return _cbAllocated;
+    }
+
+private:
+    CAllocScope(const CAllocScope&);
+    CAllocScope& operator=(const CAllocScope&);
+
+    const char*     _pszName;
+    unsigned long   _cMaxAllocs;
+    unsigned long   _cMaxOutstanding;
+    unsigned long   _cAllocs;
+    unsigned long   _cFrees;
+    size_t          _cbAllocated;
+    CAllocScope*    _pOuter;        // the scope that was innermost when this one was entered
+};
+
+// Hides every budget on the thread for as long as it lives.
+class CAllocUncharged
+{
+public:
+    CAllocUncharged();
+    ~CAllocUncharged();
+
+private:
+    CAllocUncharged(const CAllocUncharged&);
+    CAllocUncharged& operator=(const CAllocUncharged&);
+
+    CAllocScope*    _pHidden;       // the innermost scope, until this ends
+};
+
+#define ALLOC_BUDGET(cMaxAllocs, cMaxOutstanding) CAllocScope _allocScope(__FUNCTION__, cMaxAllocs, cMaxOutstanding)
+#define ALLOC_UNCHARGED() CAllocUncharged _allocUncharged
+
+#else
+
+#define ALLOC_BUDGET(cMaxAllocs, cMaxOutstanding) ((void)0)
+#define ALLOC_UNCHARGED() ((void)0)
+
+#endif
@@ -0,0 +1,101 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The Tracked* allocators: CoTaskMemAlloc, SHStrDupW, HeapAlloc and LocalAlloc, and their
+// frees, charged to the innermost ALLOC_BUDGET when ALLOC_TRACKING is defined (see
+// AllocTrack.h).  Without it they are the plain allocators.
+
+#pragma once
+#include <windows.h>
+#include <objbase.h>
+#pragma warning(push)
+#pragma warning(disable : 4995)
+#include <shlwapi.h>
+#pragma warning(pop)
+#include "AllocTrack.h"
+
+inline void* TrackedCoTaskMemAlloc(__in SIZE_T cb)
+{
+    void* pv = CoTaskMemAlloc(cb);
+#ifdef ALLOC_TRACKING
+    if (pv)
+    {
+        AllocTrackAlloc(cb);
+    }
+#endif
+    return pv;
+}
+
+inline void TrackedCoTaskMemFree(__in_opt void* pv)
+{
+#ifdef ALLOC_TRACKING
+    if (pv)
+    {
+        AllocTrackFree();
+    }
+#endif
+    CoTaskMemFree(pv);
+}
+
+inline HRESULT TrackedSHStrDupW(__in PCWSTR pwz, __deref_out PWSTR* ppwz)
+{
+    HRESULT hr = SHStrDupW(pwz, ppwz);
+#ifdef ALLOC_TRACKING
+    if (SUCCEEDED(hr))
+    {
+        AllocTrackAlloc((lstrlenW(pwz) + 1) * sizeof(WCHAR));
+    }
+#endif
+    return hr;
+}
+
+inline void* TrackedHeapAlloc(__in HANDLE hHeap, __in DWORD dwFlags, __in SIZE_T cb)
+{
+    void* pv = HeapAlloc(hHeap, dwFlags, cb);
+#ifdef ALLOC_TRACKING
+    if (pv)
+    {
+        AllocTrackAlloc(cb);
+    }
+#endif
+    return pv;
+}
+
+inline BOOL TrackedHeapFree(__in HANDLE hHeap, __in DWORD dwFlags, __in_opt void* pv)
+{
+#ifdef ALLOC_TRACKING
+    if (pv)
+    {
+        AllocTrackFree();
+    }
+#endif
+    return HeapFree(hHeap, dwFlags, pv);
+}
+
+inline HLOCAL TrackedLocalAlloc(__in UINT uFlags, __in SIZE_T cb)
+{
+    HLOCAL hl = LocalAlloc(uFlags, cb);
+#ifdef ALLOC_TRACKING
+    if (hl)
+    {
+        AllocTrackAlloc(cb);
+    }
+#endif
+    return hl;
+}
+
+inline HLOCAL TrackedLocalFree(__in_opt HLOCAL hl)
+{
+#ifdef ALLOC_TRACKING
+    if (hl)
+    {
+        AllocTrackFree();
+    }
+#endif
+    return LocalFree(hl);
+}
@@ -0,0 +1,462 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The audit log: a fixed pool of records, a lock-free list of the ones waiting, and a
+// writer thread.
+
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+#include <system_error>
+#include <thread>
+#include "AuditLog.h"
+
+// A list of pool nodes as one word, so that it can be swapped atomically.  The low half is
+// the index of the first node plus one (0 for an empty list); the high half counts every
+// change, so that a pop which read a node that was popped, reused and pushed back in the
+// meantime fails its compare-exchange rather than corrupting the list.
+typedef uint64_t AUDIT_LIST;
+
+struct AUDIT_NODE
+{
+    std::atomic<uint32_t>   iNext;      // the index of the next node plus one
+    AUDIT_RECORD            record;
+};
+
+static AUDIT_NODE s_rgNodes[AUDIT_QUEUE_DEPTH];
+static std::atomic<AUDIT_LIST> s_listFree(0);
+static std::atomic<AUDIT_LIST> s_listPending(0);   // newest first
+
+// Set by a producer that pushed onto an empty list, and by AuditLogClose.  Never destroyed
+// before the process exits, so a producer racing AuditLogClose can still wake it safely.
+static std::mutex s_mutexWake;
+static std::condition_variable s_cvWake;
+static bool s_fWake = false;
+
+static std::atomic<bool> s_fOpen(false);    // read by producers
+
+// Everything below belongs to AuditLogOpen and AuditLogClose, under s_mutexOpen, and to the
+// writer thread while it runs.
+static std::mutex s_mutexOpen;
+static bool s_fPoolReady = false;
+static unsigned long s_cOpens = 0;
+static std::thread s_thread;
+static std::atomic<bool> s_fStop(false);
+static PLATFORM_FILE* s_pFile = NULL;
+static unsigned long long s_cbFile = 0;
+static std::wstring s_wstrPath;
+static AUDIT_RECORD* s_prgBatch = NULL;
+
+static std::atomic<uint64_t> s_cRecorded(0);
+static std::atomic<uint64_t> s_cDropped(0);
+static std::atomic<uint64_t> s_cWritten(0);
+static std::atomic<uint64_t> s_cLost(0);
+static std::atomic<uint64_t> s_cBatches(0);
+static std::atomic<uint64_t> s_cSyncs(0);
+static std::atomic<uint64_t> s_cRotations(0);
+
+static uint32_t _AuditListFirst(AUDIT_LIST list)
+{
+    return static_cast<uint32_t>(list);
+}
+
+// The list that replaces listWas, starting at iFirst.
+static AUDIT_LIST _AuditListNext(AUDIT_LIST listWas, uint32_t iFirst)
+{
+    return (((listWas >> 32) + 1) << 32) | iFirst;
+}
+
+// Pushes node iNode, its index plus one.  Returns whether the list was empty.
+static bool _AuditPush(std::atomic<AUDIT_LIST>* plist, uint32_t iNode)
+{
+    AUDIT_LIST list = plist->load(std::memory_order_relaxed);
+    do
+    {
+        s_rgNodes[iNode - 1].iNext.store(_AuditListFirst(list), std::memory_order_relaxed);
+    }
+    while (!plist->compare_exchange_weak(list, _AuditListNext(list, iNode), std::memory_order_release, std::memory_order_relaxed));
+    return 0 == _AuditListFirst(list);
+}
+
+// Pops the first node.  Returns its index plus one, or 0 if the list is empty.
+static uint32_t _AuditPop(std::atomic<AUDIT_LIST>* plist)
+{
+    AUDIT_LIST list = plist->load(std::memory_order_acquire);
+    while (_AuditListFirst(list))
+    {
+        uint32_t iNext = s_rgNodes[_AuditListFirst(list) - 1].iNext.load(std::memory_order_relaxed);
+        if (plist->compare_exchange_weak(list, _AuditListNext(list, iNext), std::memory_order_acquire, std::memory_order_acquire))
+        {
+            break;
+        }
+    }
+    return _AuditListFirst(list);
+}
+
+// Takes the whole list.  Returns its first node's index plus one, or 0 if it was empty.
+static uint32_t _AuditTakeAll(std::atomic<AUDIT_LIST>* plist)
+{
+    AUDIT_LIST list = plist->load(std::memory_order_relaxed);
+    while (!plist->compare_exchange_weak(list, _AuditListNext(list, 0), std::memory_order_acquire, std::memory_order_relaxed))
+    {
+    }
+    return _AuditListFirst(list);
+}
+
+static void _AuditWake()
+{
+    std::lock_guard<std::mutex> lock(s_mutexWake);
+    s_fWake = true;
+    s_cvWake.notify_one();
+}
+
+// Appends pwz, in UTF-16, to the account at ich, as far as it fits with the NUL after it.
+// Returns where the account now ends.
+static size_t _AuditAppendAccount(char16_t* pwsz, size_t ich, const wchar_t* pwz)
+{
+    for (; pwz && *pwz; pwz++)
+    {
+        unsigned long ulCode = static_cast<unsigned long>(*pwz);
+        if (ulCode >= 0x10000)
+        {
+            // Only where wchar_t is UTF-32: a surrogate pair, or nothing.
+            if (ich + 2 > AUDIT_MAX_ACCOUNT - 1)
+            {
+                break;
+            }
+            ulCode -= 0x10000;
+            pwsz[ich++] = static_cast<char16_t>(0xD800 + ((ulCode >> 10) & 0x3FF));
+            pwsz[ich++] = static_cast<char16_t>(0xDC00 + (ulCode & 0x3FF));
+        }
+        else
+        {
+            if (ich + 1 > AUDIT_MAX_ACCOUNT - 1)
+            {
+                break;
+            }
+            pwsz[ich++] = static_cast<char16_t>(ulCode);
+        }
+    }
+    return ich;
+}
+
+void AuditLogRecord(
+    uint32_t ulScenario,
+    const wchar_t* pwzDomain,
+    const wchar_t* pwzUser,
+    int32_t ntsStatus,
+    int32_t ntsSubstatus,
+    unsigned long long ullLatencyNs
+)
+{
+    if (!s_fOpen.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    uint32_t iNode = _AuditPop(&s_listFree);
+    if (!iNode)
+    {
+        s_cDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    AUDIT_RECORD* pRecord = &s_rgNodes[iNode - 1].record;
+    memset(pRecord, 0, sizeof(*pRecord));
+    pRecord->ullTime = PlatformSystemTime();
+    pRecord->ulProcessId = static_cast<uint32_t>(PlatformCurrentProcessId());
+    pRecord->ulScenario = ulScenario;
+    pRecord->ntsStatus = ntsStatus;
+    pRecord->ntsSubstatus = ntsSubstatus;
+    pRecord->ullLatencyNs = ullLatencyNs;
+
+    // Truncation is fine: the name is for people reading the log.
+    size_t ich = 0;
+    if (pwzDomain && *pwzDomain)
+    {
+        ich = _AuditAppendAccount(pRecord->wszAccount, ich, pwzDomain);
+        ich = _AuditAppendAccount(pRecord->wszAccount, ich, L"\\");
+    }
+    _AuditAppendAccount(pRecord->wszAccount, ich, pwzUser);
+
+    // Only the push onto an empty list needs to wake the writer; it takes the whole list.
+    s_cRecorded.fetch_add(1, std::memory_order_relaxed);
+    if (_AuditPush(&s_listPending, iNode))
+    {
+        _AuditWake();
+    }
+}
+
+static PLATFORM_RESULT _AuditWrite(const void* pv, size_t cb)
+{
+    PLATFORM_RESULT pr = PlatformWriteFileAt(s_pFile, s_cbFile, pv, cb);
+    if (PR_OK == pr)
+    {
+        s_cbFile += cb;
+    }
+    return pr;
+}
+
+static void _AuditCloseFile()
+{
+    PlatformCloseFile(s_pFile);
+    s_pFile = NULL;
+}
+
+// Opens the log for appending, starting it with a header if it is new.  Fails with
+// PR_BAD_DATA if the file holds something other than our records.
+static PLATFORM_RESULT _AuditOpenFile()
+{
+    PLATFORM_RESULT pr = PlatformCreateFile(s_wstrPath.c_str(), PC_KEEP, &s_pFile);
+    if (PR_OK != pr)
+    {
+        return pr;
+    }
+
+    pr = PlatformGetFileSize(s_pFile, &s_cbFile);
+    if (PR_OK == pr)
+    {
+        if (0 == s_cbFile)
+        {
+            AUDIT_FILE_HEADER hdr = { AUDIT_FILE_MAGIC, AUDIT_FILE_VERSION, sizeof(AUDIT_RECORD), 0 };
+            pr = _AuditWrite(&hdr, sizeof(hdr));
+        }
+        else
+        {
+            AUDIT_FILE_HEADER hdr;
+            pr = PlatformReadFileAt(s_pFile, 0, &hdr, sizeof(hdr));
+            if (PR_END_OF_FILE == pr || (PR_OK == pr &&
+                (hdr.ulMagic != AUDIT_FILE_MAGIC || hdr.ulVersion != AUDIT_FILE_VERSION || hdr.cbRecord != sizeof(AUDIT_RECORD))))
+            {
+                pr = PR_BAD_DATA;
+            }
+        }
+    }
+
+    if (PR_OK != pr)
+    {
+        _AuditCloseFile();
+    }
+    return pr;
+}
+
+// Renames <path> to <path>.1, <path>.1 to <path>.2 and so on, dropping the oldest.
+static void _AuditShiftGenerations()
+{
+    try
+    {
+        for (unsigned long i = AUDIT_ROTATE_KEEP; i > 1; i--)
+        {
+            PlatformRenameFile((s_wstrPath + L"." + std::to_wstring(i - 1)).c_str(), (s_wstrPath + L"." + std::to_wstring(i)).c_str());
+        }
+        PlatformRenameFile(s_wstrPath.c_str(), (s_wstrPath + L".1").c_str());
+    }
+    catch (const std::bad_alloc&)
+    {
+        // The log carries on in the file it has.
+    }
+}
+
+static void _AuditRotate()
+{
+    PlatformFlushFile(s_pFile);
+    _AuditCloseFile();
+    _AuditShiftGenerations();
+    if (PR_OK == _AuditOpenFile())
+    {
+        s_cRotations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Takes everything waiting and appends it.  Returns the number of records written.
+static uint32_t _AuditWriteBatch()
+{
+    uint32_t iNode = _AuditTakeAll(&s_listPending);
+    if (!iNode)
+    {
+        return 0;
+    }
+
+    // The list comes out newest first; copy it out oldest first and hand the nodes back
+    // before touching the disk, so producers are not starved while we write.
+    uint32_t cRecords = 0;
+    for (uint32_t i = iNode; i; i = s_rgNodes[i - 1].iNext.load(std::memory_order_relaxed))
+    {
+        cRecords++;
+    }
+    uint32_t iRecord = cRecords;
+    while (iNode)
+    {
+        uint32_t iNext = s_rgNodes[iNode - 1].iNext.load(std::memory_order_relaxed);
+        s_prgBatch[--iRecord] = s_rgNodes[iNode - 1].record;
+        _AuditPush(&s_listFree, iNode);
+        iNode = iNext;
+    }
+
+    size_t cb = cRecords * sizeof(AUDIT_RECORD);
+    if (s_pFile && s_cbFile + cb > AUDIT_ROTATE_SIZE && s_cbFile > sizeof(AUDIT_FILE_HEADER))
+    {
+        _AuditRotate();
+    }
+
+    s_cBatches.fetch_add(1, std::memory_order_relaxed);
+    if (s_pFile && PR_OK == _AuditWrite(s_prgBatch, cb))
+    {
+        s_cWritten.fetch_add(cRecords, std::memory_order_relaxed);
+        return cRecords;
+    }
+    s_cLost.fetch_add(cRecords, std::memory_order_relaxed);
+    return 0;
+}
+
+static void _AuditWriterThreadProc()
+{
+    unsigned long long ullLastSync = PlatformMonotonicNanoseconds();
+    bool fDirty = false;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(s_mutexWake);
+            s_cvWake.wait_for(lock, std::chrono::milliseconds(AUDIT_FLUSH_INTERVAL_MS), []() { return s_fWake; });
+            s_fWake = false;
+        }
+
+        // Read the flag before draining, so everything recorded before AuditLogClose set
+        // it is written.
+        bool fStop = s_fStop.load();
+        if (_AuditWriteBatch())
+        {
+            fDirty = true;
+        }
+
+        unsigned long long ullNow = PlatformMonotonicNanoseconds();
+        if (fDirty && (fStop || ullNow - ullLastSync >= AUDIT_SYNC_INTERVAL_MS * 1000000ULL))
+        {
+            if (s_pFile)
+            {
+                PlatformFlushFile(s_pFile);
+            }
+            s_cSyncs.fetch_add(1, std::memory_order_relaxed);
+            fDirty = false;
+            ullLastSync = ullNow;
+        }
+
+        if (fStop)
+        {
+            return;
+        }
+    }
+}
+
+PLATFORM_RESULT AuditLogOpen(const wchar_t* pwzPath)
+{
+    PLATFORM_RESULT pr = PR_OK;
+    std::lock_guard<std::mutex> lock(s_mutexOpen);
+    if (0 == s_cOpens)
+    {
+        if (!s_fPoolReady)
+        {
+            for (uint32_t i = 1; i <= AUDIT_QUEUE_DEPTH; i++)
+            {
+                _AuditPush(&s_listFree, i);
+            }
+            s_fPoolReady = true;
+        }
+
+        try
+        {
+            s_wstrPath = pwzPath;
+        }
+        catch (const std::bad_alloc&)
+        {
+            pr = PR_OUT_OF_MEMORY;
+        }
+        if (PR_OK == pr)
+        {
+            s_prgBatch = new (std::nothrow) AUDIT_RECORD[AUDIT_QUEUE_DEPTH];
+            pr = s_prgBatch ? PR_OK : PR_OUT_OF_MEMORY;
+        }
+        if (PR_OK == pr)
+        {
+            // A log in some other format is moved aside rather than appended to.
+            pr = _AuditOpenFile();
+            if (PR_BAD_DATA == pr)
+            {
+                _AuditShiftGenerations();
+                pr = _AuditOpenFile();
+            }
+        }
+        if (PR_OK == pr)
+        {
+            s_fStop.store(false);
+            try
+            {
+                s_thread = std::thread(_AuditWriterThreadProc);
+            }
+            catch (const std::system_error&)
+            {
+                pr = PR_IO_ERROR;
+            }
+        }
+
+        if (PR_OK == pr)
+        {
+            s_fOpen.store(true, std::memory_order_release);
+        }
+        else
+        {
+            if (s_pFile)
+            {
+                _AuditCloseFile();
+            }
+            delete[] s_prgBatch;
+            s_prgBatch = NULL;
+        }
+    }
+    if (PR_OK == pr)
+    {
+        s_cOpens++;
+    }
+    return pr;
+}
+
+void AuditLogClose()
+{
+    std::lock_guard<std::mutex> lock(s_mutexOpen);
+    if (s_cOpens > 0 && 0 == --s_cOpens)
+    {
+        // A producer that read s_fOpen just before this may still push a record after the
+        // writer's last batch; it waits in the list for the next open.
+        s_fOpen.store(false);
+        s_fStop.store(true);
+        _AuditWake();
+        s_thread.join();
+
+        if (s_pFile)
+        {
+            _AuditCloseFile();
+        }
+        delete[] s_prgBatch;
+        s_prgBatch = NULL;
+    }
+}
+
+void AuditLogGetStats(AUDIT_STATS* pstats)
+{
+    pstats->cRecorded = s_cRecorded.load();
+    pstats->cDropped = s_cDropped.load();
+    pstats->cWritten = s_cWritten.load();
+    pstats->cLost = s_cLost.load();
+    pstats->cBatches = s_cBatches.load();
+    pstats->cSyncs = s_cSyncs.load();
+    pstats->cRotations = s_cRotations.load();
+}
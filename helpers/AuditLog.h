@@ -0,0 +1,93 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// An append-only binary audit trail of logon attempts, written without ever making the
+// caller wait on the disk.
+//
+// AuditLogRecord takes a free record from a fixed pool, fills it in and pushes it onto a
+// lock-free list: no allocation, and a lock only to wake the writer when the list was
+// empty.  A background writer takes the whole list at once, puts it back in arrival order
+// and appends it to the file in one write.  It forces the file to disk at most every
+// AUDIT_SYNC_INTERVAL_MS, and when the file would grow past AUDIT_ROTATE_SIZE it is
+// renamed to <path>.1 (and older generations shifted up to <path>.AUDIT_ROTATE_KEEP)
+// before a new one is started.
+//
+// When the writer falls so far behind that the pool runs dry, records are dropped and
+// counted rather than blocking LogonUI.
+//
+// The file is an AUDIT_FILE_HEADER followed by AUDIT_RECORDs, little-endian, with the
+// account in UTF-16 whatever the platform.
+//
+// Platform-neutral: this uses only the C++ standard library and Platform.h, and builds into
+// CredentialCore.
+
+#pragma once
+#include <stdint.h>
+#include "Platform.h"
+
+#define AUDIT_FILE_MAGIC 0x55414C41         // 'ALAU'
+#define AUDIT_FILE_VERSION 1
+#define AUDIT_QUEUE_DEPTH 1024              // records that can wait for the writer at once
+#define AUDIT_MAX_ACCOUNT 64                // UTF-16 code units of domain\user kept, with the NUL
+#define AUDIT_FLUSH_INTERVAL_MS 1000        // the writer wakes at least this often
+#define AUDIT_SYNC_INTERVAL_MS 5000         // PlatformFlushFile at most this often
+#define AUDIT_ROTATE_SIZE (4 * 1024 * 1024)
+#define AUDIT_ROTATE_KEEP 3
+
+struct AUDIT_FILE_HEADER
+{
+    uint32_t ulMagic;
+    uint32_t ulVersion;
+    uint32_t cbRecord;      // sizeof(AUDIT_RECORD), so readers can skip fields they don't know
+    uint32_t ulReserved;
+};
+
+struct AUDIT_RECORD
+{
+    uint64_t    ullTime;                        // FILETIME, UTC
+    uint32_t    ulProcessId;
+    uint32_t    ulScenario;                     // CREDENTIAL_PROVIDER_USAGE_SCENARIO
+    int32_t     ntsStatus;
+    int32_t     ntsSubstatus;
+    uint64_t    ullLatencyNs;                   // from serialization to the logon result
+    char16_t    wszAccount[AUDIT_MAX_ACCOUNT];  // domain\user, truncated
+};
+
+static_assert(sizeof(AUDIT_RECORD) == 160, "an audit record is the same on disk everywhere");
+
+struct AUDIT_STATS
+{
+    unsigned long long cRecorded;
+    unsigned long long cDropped;    // the pool was empty
+    unsigned long long cWritten;
+    unsigned long long cLost;       // written but failed
+    unsigned long long cBatches;
+    unsigned long long cSyncs;
+    unsigned long long cRotations;
+};
+
+// Starts the writer on the log at pwzPath, creating it if needed.  Calls nest: each
+// successful open needs an AuditLogClose, and the path of the first open is kept.
+PLATFORM_RESULT AuditLogOpen(const wchar_t* pwzPath);
+
+// Stops the writer once the last open is closed, after writing and flushing whatever was
+// recorded before the call.
+void AuditLogClose();
+
+// Records one logon attempt.  Does nothing unless the log is open.  Never waits on the
+// writer.
+void AuditLogRecord(
+    uint32_t ulScenario,
+    const wchar_t* pwzDomain,
+    const wchar_t* pwzUser,
+    int32_t ntsStatus,
+    int32_t ntsSubstatus,
+    unsigned long long ullLatencyNs
+);
+
+void AuditLogGetStats(AUDIT_STATS* pstats);
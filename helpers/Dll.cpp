@@ -12,20 +12,26 @@
 #include <unknwn.h>
 #include "Dll.h"
 #include "helpers.h"
+#include "Trace.h"
+#include "FlightRecorderWin32.h"
+#include "ThreadPool.h"
 
 static LONG g_cRef = 0;   // global dll reference count
 HINSTANCE g_hinst = NULL; // global dll hinstance
 
 extern HRESULT CSample_CreateInstance(__in REFIID riid, __deref_out void** ppv);
+extern void AccountSnapshotShutdown();
+extern void AccountNameShutdown();
+extern void SharedAccountCacheShutdown();
+extern void ReportResultMessageShutdown();
 EXTERN_C GUID CLSID_CSample;
 
+// There is exactly one class factory and it is never freed.  It carries no state, so
+// handing the same instance to every caller on every thread is safe, and each outstanding
+// reference to it holds a reference on the DLL so DllCanUnloadNow still sees it.
 class CClassFactory : public IClassFactory
 {
 public:
-    CClassFactory() : _cRef(1) 
-    {
-    }
-
     // IUnknown
     IFACEMETHODIMP QueryInterface(__in REFIID riid, __deref_out void **ppv)
     {
@@ -39,15 +45,14 @@ public:
 
     IFACEMETHODIMP_(ULONG) AddRef()
     {
-        return InterlockedIncrement(&_cRef);
+        DllAddRef();
+        return 2;
     }
 
     IFACEMETHODIMP_(ULONG) Release()
     {
-        LONG cRef = InterlockedDecrement(&_cRef);
-        if (!cRef)
-            delete this;
-        return cRef;
+        DllRelease();
+        return 1;
     }
 
     // IClassFactory
@@ -78,14 +83,10 @@ public:
         }
         return S_OK;
     }
-
-private:
-    ~CClassFactory()
-    {
-    }
-    long _cRef;
 };
 
+static CClassFactory s_classFactory;
+
 HRESULT CClassFactory_CreateInstance(__in REFCLSID rclsid, __in REFIID riid, __deref_out void **ppv)
 {
     *ppv = NULL;
@@ -94,15 +95,16 @@ HRESULT CClassFactory_CreateInstance(__in REFCLSID rclsid, __in REFIID riid, __d
 
     if (CLSID_CSample == rclsid)
     {
-        CClassFactory* pcf = new CClassFactory();
-        if (pcf)
+        // COM asks for IClassFactory nearly every time, so skip the QITAB walk for it.
+        if (IID_IClassFactory == riid)
         {
-            hr = pcf->QueryInterface(riid, ppv);
-            pcf->Release();
+            s_classFactory.AddRef();
+            *ppv = static_cast<IClassFactory*>(&s_classFactory);
+            hr = S_OK;
         }
         else
         {
-            hr = E_OUTOFMEMORY;
+            hr = s_classFactory.QueryInterface(riid, ppv);
         }
     }
     else
@@ -122,9 +124,18 @@ void DllRelease()
     InterlockedDecrement(&g_cRef);
 }
 
+// Work still queued or running on the thread pool keeps the DLL loaded just as an
+// outstanding object does.  The pool decides whether it is idle under the lock submits take,
+// so no item can slip in between that and closing it, which waits at most for the workers to
+// return from the last item.
 STDAPI DllCanUnloadNow()
 {
-    return (g_cRef > 0) ? S_FALSE : S_OK;
+    HRESULT hr = S_FALSE;
+    if (g_cRef <= 0 && ThreadPoolShutdownIfIdle())
+    {
+        hr = S_OK;
+    }
+    return hr;
 }
 
 STDAPI DllGetClassObject(__in REFCLSID rclsid, __in REFIID riid, __deref_out void** ppv)
@@ -132,7 +143,7 @@ STDAPI DllGetClassObject(__in REFCLSID rclsid, __in REFIID riid, __deref_out voi
     return CClassFactory_CreateInstance(rclsid, riid, ppv);
 }
 
-STDAPI_(BOOL) DllMain(__in HINSTANCE hinstDll, __in DWORD dwReason, __in void *)
+STDAPI_(BOOL) DllMain(__in HINSTANCE hinstDll, __in DWORD dwReason, __in void *pvReserved)
 {
     switch (dwReason)
     {
@@ -140,6 +151,20 @@ STDAPI_(BOOL) DllMain(__in HINSTANCE hinstDll, __in DWORD dwReason, __in void *)
         DisableThreadLibraryCalls(hinstDll);
         break;
     case DLL_PROCESS_DETACH:
+        // On process exit the heap is about to go away anyway, and other threads may have
+        // been stopped mid-span; only clean up when we are being unloaded.
+        if (!pvReserved)
+        {
+            // The thread pool was closed by DllCanUnloadNow, which COM calls before it
+            // unloads us.  Closing it here would wait on its threads under the loader lock.
+            TraceShutdown();
+            FlightRecorderShutdown();
+            AccountSnapshotShutdown();
+            AccountNameShutdown();
+            SharedAccountCacheShutdown();
+            ReportResultMessageShutdown();
+        }
+        break;
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
         break;
@@ -0,0 +1,185 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The platform-neutral flight recorder ring; see FlightRecorder.h.
+
+#include <string.h>
+#include <algorithm>
+#include "FlightRecorder.h"
+
+// Sequence numbers in the mapping are published through atomics laid over plain fields.
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "the sequence number must be a plain 64-bit word");
+
+static FLIGHT_EVENT* _FlightRecorderEvents(FLIGHT_RECORDER_HEADER* pHeader)
+{
+    return reinterpret_cast<FLIGHT_EVENT*>(pHeader + 1);
+}
+
+FLIGHT_RECORDER_HEADER* FlightRecorderAttach(void* pv, size_t cb, uint64_t ullFrequency)
+{
+    if (cb < FlightRecorderFileSize(1))
+    {
+        return NULL;
+    }
+
+    // The largest power of two that fits, so a slot is a mask away from its sequence number.
+    size_t cFit = (cb - sizeof(FLIGHT_RECORDER_HEADER)) / sizeof(FLIGHT_EVENT);
+    uint32_t cEvents = 1;
+    while (cEvents <= 0x40000000UL && static_cast<size_t>(cEvents) * 2 <= cFit)
+    {
+        cEvents *= 2;
+    }
+
+    FLIGHT_RECORDER_HEADER* pHeader = static_cast<FLIGHT_RECORDER_HEADER*>(pv);
+    if (pHeader->ulMagic != FLIGHT_RECORDER_MAGIC || pHeader->ulVersion != FLIGHT_RECORDER_VERSION ||
+        pHeader->cbEvent != sizeof(FLIGHT_EVENT) || pHeader->cEvents != cEvents ||
+        pHeader->ullNext.load(std::memory_order_relaxed) == 0)
+    {
+        memset(pv, 0, FlightRecorderFileSize(cEvents));
+        pHeader->ullNext.store(1, std::memory_order_relaxed);
+        pHeader->cEvents = cEvents;
+        pHeader->cbEvent = sizeof(FLIGHT_EVENT);
+        pHeader->ulVersion = FLIGHT_RECORDER_VERSION;
+        std::atomic_thread_fence(std::memory_order_release);
+        pHeader->ulMagic = FLIGHT_RECORDER_MAGIC;
+    }
+    pHeader->ullFrequency = ullFrequency;
+    return pHeader;
+}
+
+void FlightRecorderWrite(
+    FLIGHT_RECORDER_HEADER* pHeader,
+    FLIGHT_EVENT_TYPE fet,
+    const char* pszName,
+    int32_t lValue,
+    uint16_t usPhase,
+    int64_t llTicks,
+    int64_t llDuration,
+    uint32_t ulThreadId
+)
+{
+    uint64_t ullSeq = pHeader->ullNext.fetch_add(1, std::memory_order_relaxed);
+    FLIGHT_EVENT* pEvent = &_FlightRecorderEvents(pHeader)[(ullSeq - 1) & (pHeader->cEvents - 1)];
+    std::atomic<uint64_t>* pullSeq = reinterpret_cast<std::atomic<uint64_t>*>(&pEvent->ullSeq);
+
+    // Mark the slot torn until the event is complete.
+    pullSeq->store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    pEvent->llTicks = llTicks;
+    pEvent->llDuration = llDuration;
+    pEvent->ulThreadId = ulThreadId;
+    pEvent->usType = static_cast<uint16_t>(fet);
+    pEvent->usPhase = usPhase;
+    pEvent->lValue = lValue;
+
+    // Method names differ at the end, so that is the part kept.
+    size_t cch = pszName ? strlen(pszName) : 0;
+    if (cch > FLIGHT_EVENT_NAME_CHARS - 1)
+    {
+        pszName += cch - (FLIGHT_EVENT_NAME_CHARS - 1);
+        cch = FLIGHT_EVENT_NAME_CHARS - 1;
+    }
+    memcpy(pEvent->szName, pszName ? pszName : "", cch);
+    memset(pEvent->szName + cch, 0, FLIGHT_EVENT_NAME_CHARS - cch);
+
+    pullSeq->store(ullSeq, std::memory_order_release);
+}
+
+std::atomic<bool> g_fFlightRecorderEnabled(false);
+
+static std::atomic<FLIGHT_RECORDER_HEADER*> s_pProcessRing(nullptr);
+
+bool FlightRecorderStart(FLIGHT_RECORDER_HEADER* pHeader)
+{
+    FLIGHT_RECORDER_HEADER* pNone = NULL;
+    if (!s_pProcessRing.compare_exchange_strong(pNone, pHeader))
+    {
+        return false;
+    }
+    g_fFlightRecorderEnabled.store(true);
+    return true;
+}
+
+FLIGHT_RECORDER_HEADER* FlightRecorderStop()
+{
+    g_fFlightRecorderEnabled.store(false);
+    return s_pProcessRing.exchange(NULL);
+}
+
+void FlightRecord(
+    FLIGHT_EVENT_TYPE fet,
+    const char* pszName,
+    int32_t lValue,
+    uint16_t usPhase,
+    int64_t llTicks,
+    int64_t llDuration
+)
+{
+    FLIGHT_RECORDER_HEADER* pHeader = s_pProcessRing.load(std::memory_order_acquire);
+    if (pHeader)
+    {
+        FlightRecorderWrite(pHeader, fet, pszName, lValue, usPhase, llTicks, llDuration,
+            static_cast<uint32_t>(PlatformCurrentThreadId()));
+    }
+}
+
+bool FlightRecorderDecode(
+    const unsigned char* pb,
+    size_t cb,
+    FLIGHT_RECORDER_INFO* pInfo,
+    std::vector<FLIGHT_EVENT>* prgEvents
+)
+{
+    prgEvents->clear();
+    if (cb < sizeof(FLIGHT_RECORDER_HEADER))
+    {
+        return false;
+    }
+
+    // The header holds an atomic, so its fields are read out one by one.
+    uint32_t ulMagic, ulVersion, cbEvent;
+    memcpy(&ulMagic, pb + offsetof(FLIGHT_RECORDER_HEADER, ulMagic), sizeof(ulMagic));
+    memcpy(&ulVersion, pb + offsetof(FLIGHT_RECORDER_HEADER, ulVersion), sizeof(ulVersion));
+    memcpy(&cbEvent, pb + offsetof(FLIGHT_RECORDER_HEADER, cbEvent), sizeof(cbEvent));
+    memcpy(&pInfo->cEvents, pb + offsetof(FLIGHT_RECORDER_HEADER, cEvents), sizeof(pInfo->cEvents));
+    memcpy(&pInfo->ullFrequency, pb + offsetof(FLIGHT_RECORDER_HEADER, ullFrequency), sizeof(pInfo->ullFrequency));
+    memcpy(&pInfo->ullNext, pb + offsetof(FLIGHT_RECORDER_HEADER, ullNext), sizeof(pInfo->ullNext));
+    pInfo->cTorn = 0;
+
+    if (ulMagic != FLIGHT_RECORDER_MAGIC || ulVersion != FLIGHT_RECORDER_VERSION || cbEvent != sizeof(FLIGHT_EVENT) ||
+        pInfo->cEvents == 0 || (pInfo->cEvents & (pInfo->cEvents - 1)) != 0 ||
+        cb < FlightRecorderFileSize(pInfo->cEvents) || pInfo->ullNext == 0)
+    {
+        return false;
+    }
+
+    // The ring holds at most the last cEvents sequence numbers claimed; every one of those
+    // that is not in its slot was torn.
+    uint64_t cClaimed = pInfo->ullNext - 1;
+    uint64_t cHeld = std::min<uint64_t>(cClaimed, pInfo->cEvents);
+    uint64_t ullOldest = pInfo->ullNext - cHeld;
+
+    prgEvents->reserve(static_cast<size_t>(cHeld));
+    const unsigned char* pbEvents = pb + sizeof(FLIGHT_RECORDER_HEADER);
+    for (uint64_t ullSeq = ullOldest; ullSeq < pInfo->ullNext; ullSeq++)
+    {
+        FLIGHT_EVENT fe;
+        memcpy(&fe, pbEvents + static_cast<size_t>((ullSeq - 1) & (pInfo->cEvents - 1)) * sizeof(FLIGHT_EVENT), sizeof(fe));
+        if (fe.ullSeq == ullSeq)
+        {
+            fe.szName[FLIGHT_EVENT_NAME_CHARS - 1] = '\0';
+            prgEvents->push_back(fe);
+        }
+        else
+        {
+            pInfo->cTorn++;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,156 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The flight recorder: a ring of fixed-size binary events kept in a memory-mapped file, so
+// that whatever the provider was doing when LogonUI died is still on disk afterwards.  The
+// pages belong to the file rather than to the process, so a crash, an abort() or a kill
+// loses nothing that was already written; only a power failure can.
+//
+// This is the platform-neutral part: the layout, writing an event into a mapped ring,
+// recording into the process-wide ring, and decoding a ring read back from disk.  It uses
+// only the C++ standard library and Platform.h, so the decoder builds into CredentialTool
+// and the whole thing can be exercised off Windows.  FlightRecorderWin32.h maps the file.
+//
+// Once a ring is started, every TRACE_SCOPE records its entry and exit into it and every
+// LATENCY_SCOPE its duration, whether or not tracing or latency histograms are on;
+// FlightRecordResult adds the result of an operation.  The process-wide ring counts time
+// in PlatformMonotonicNanoseconds, so its frequency is 1e9.
+//
+// Writing an event is one atomic increment to claim a slot and a 64-byte copy into the
+// mapping: no lock, no allocation and no system call.  Each event fills a cache line of
+// its own, so threads recording at once do not share lines.  An event's sequence number
+// is cleared before the rest of it is written and stored last, so a writer that dies
+// midway leaves a slot the decoder recognizes as torn and skips.
+//
+// Layout, native byte order (the file is decoded on the kind of machine that wrote it):
+//
+//   header        64 bytes: FLIGHT_RECORDER_HEADER
+//   events        cEvents (a power of two) FLIGHT_EVENTs; event n lives in slot
+//                 (n - 1) % cEvents
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "Platform.h"
+
+#define FLIGHT_RECORDER_MAGIC 0x52464C41UL          // 'ALFR'
+#define FLIGHT_RECORDER_VERSION 1
+#define FLIGHT_RECORDER_DEFAULT_EVENTS 16384        // a 1 MB file
+#define FLIGHT_EVENT_NAME_CHARS 28                  // the tail of longer names is kept, with the NUL
+#define FLIGHT_RECORDER_FREQUENCY 1000000000ULL    // the process-wide ring's ticks are nanoseconds
+
+enum FLIGHT_EVENT_TYPE
+{
+    FE_SESSION = 1,     // a process attached to the ring; lValue is its id
+    FE_ENTER,           // a traced scope began
+    FE_EXIT,            // a traced scope ended after llDuration ticks
+    FE_PHASE,           // a latency phase (usPhase) took llDuration ticks
+    FE_RESULT,          // szName reported lValue, an HRESULT or NTSTATUS
+};
+
+// The fields are fixed-width because the file is the mapped structures themselves.
+struct FLIGHT_EVENT
+{
+    uint64_t    ullSeq;         // 1 for the first event ever written to the file; 0 while being written
+    int64_t     llTicks;        // when, in the recorder's ticks
+    int64_t     llDuration;     // FE_EXIT and FE_PHASE
+    uint32_t    ulThreadId;
+    uint16_t    usType;         // FLIGHT_EVENT_TYPE
+    uint16_t    usPhase;        // FE_PHASE
+    int32_t     lValue;
+    char        szName[FLIGHT_EVENT_NAME_CHARS];
+};
+
+struct FLIGHT_RECORDER_HEADER
+{
+    uint32_t                ulMagic;
+    uint32_t                ulVersion;
+    uint32_t                cbEvent;        // sizeof(FLIGHT_EVENT)
+    uint32_t                cEvents;
+    uint64_t                ullFrequency;   // ticks per second
+    std::atomic<uint64_t>   ullNext;        // the sequence number the next event will take
+    uint8_t                 rgbReserved[32];
+};
+
+static_assert(sizeof(FLIGHT_EVENT) == 64, "a flight recorder event is one cache line");
+static_assert(sizeof(FLIGHT_RECORDER_HEADER) == 64, "the flight recorder header is one cache line");
+
+// The size of a file holding cEvents events.
+inline size_t FlightRecorderFileSize(uint32_t cEvents)
+{
+    return sizeof(FLIGHT_RECORDER_HEADER) + static_cast<size_t>(cEvents) * sizeof(FLIGHT_EVENT);
+}
+
+// Prepares cb bytes of mapped file at pv for recording.  A ring left by an earlier process
+// is kept and carried on, so the events leading up to a crash survive until they are
+// overwritten in turn; anything else is formatted afresh.  Returns NULL if cb is too
+// small for even one event.
+FLIGHT_RECORDER_HEADER* FlightRecorderAttach(void* pv, size_t cb, uint64_t ullFrequency);
+
+void FlightRecorderWrite(
+    FLIGHT_RECORDER_HEADER* pHeader,
+    FLIGHT_EVENT_TYPE fet,
+    const char* pszName,
+    int32_t lValue,
+    uint16_t usPhase,
+    int64_t llTicks,
+    int64_t llDuration,
+    uint32_t ulThreadId
+);
+
+// Read inline by CTraceScope, CLatencyScope and FlightRecordResult; set by
+// FlightRecorderStart.
+extern std::atomic<bool> g_fFlightRecorderEnabled;
+
+// Makes pHeader, attached with FLIGHT_RECORDER_FREQUENCY, the ring the process records
+// into.  Returns false, and changes nothing, if another ring already is.
+bool FlightRecorderStart(FLIGHT_RECORDER_HEADER* pHeader);
+
+// Stops recording and returns the ring that was being recorded into, or NULL.  Only call
+// this when no other thread can be recording, since one may still be writing into it.
+FLIGHT_RECORDER_HEADER* FlightRecorderStop();
+
+// Records one event into the process-wide ring, if there is one, stamped with the calling
+// thread.  llTicks and llDuration are PlatformMonotonicNanoseconds.
+void FlightRecord(
+    FLIGHT_EVENT_TYPE fet,
+    const char* pszName,
+    int32_t lValue,
+    uint16_t usPhase,
+    int64_t llTicks,
+    int64_t llDuration
+);
+
+// Records what pszName returned.  Costs a load and a branch while the recorder is off.
+inline void FlightRecordResult(const char* pszName, int32_t lResult)
+{
+    if (g_fFlightRecorderEnabled.load(std::memory_order_relaxed))
+    {
+        FlightRecord(FE_RESULT, pszName, lResult, 0, static_cast<int64_t>(PlatformMonotonicNanoseconds()), 0);
+    }
+}
+
+struct FLIGHT_RECORDER_INFO
+{
+    uint32_t cEvents;           // slots in the ring
+    uint64_t ullFrequency;
+    uint64_t ullNext;           // events ever claimed, plus one
+    uint32_t cTorn;             // slots claimed but never finished, or overwritten while read
+};
+
+// Decodes a ring read back from disk into the events it still holds, oldest first.
+// Returns false if pb does not hold a flight recorder.
+bool FlightRecorderDecode(
+    const unsigned char* pb,
+    size_t cb,
+    FLIGHT_RECORDER_INFO* pInfo,
+    std::vector<FLIGHT_EVENT>* prgEvents
+);
@@ -0,0 +1,95 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Maps the flight recorder ring.
+
+#include <windows.h>
+#include "FlightRecorderWin32.h"
+
+static SRWLOCK s_srwOpen = SRWLOCK_INIT;
+static FLIGHT_RECORDER_HEADER* s_pHeader = NULL;
+
+HRESULT FlightRecorderOpen(__in PCWSTR pwzPath, __in DWORD cEvents)
+{
+    HRESULT hr = S_OK;
+    AcquireSRWLockExclusive(&s_srwOpen);
+    if (!s_pHeader)
+    {
+        // Shared for writing so the ring can be decoded, or another process attach to it,
+        // while it is mapped here.
+        HANDLE hFile = CreateFileW(pwzPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (INVALID_HANDLE_VALUE != hFile)
+        {
+            LARGE_INTEGER liSize;
+            hr = GetFileSizeEx(hFile, &liSize) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+            if (SUCCEEDED(hr))
+            {
+                ULONGLONG cbFile = static_cast<ULONGLONG>(liSize.QuadPart);
+                if (cbFile < FlightRecorderFileSize(1) || cbFile > FlightRecorderFileSize(1UL << 24))
+                {
+                    cbFile = FlightRecorderFileSize(cEvents);
+                }
+
+                // Mapping more than the file holds extends it.
+                HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READWRITE,
+                    static_cast<DWORD>(cbFile >> 32), static_cast<DWORD>(cbFile), NULL);
+                if (hMapping)
+                {
+                    void* pv = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(cbFile));
+                    if (pv)
+                    {
+                        s_pHeader = FlightRecorderAttach(pv, static_cast<size_t>(cbFile), FLIGHT_RECORDER_FREQUENCY);
+                        if (!s_pHeader)
+                        {
+                            UnmapViewOfFile(pv);
+                            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                        }
+                    }
+                    else
+                    {
+                        hr = HRESULT_FROM_WIN32(GetLastError());
+                    }
+
+                    // The view keeps the section, and the section the file, open.
+                    CloseHandle(hMapping);
+                }
+                else
+                {
+                    hr = HRESULT_FROM_WIN32(GetLastError());
+                }
+            }
+            CloseHandle(hFile);
+        }
+        else
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            FlightRecorderWrite(s_pHeader, FE_SESSION, "session", static_cast<int32_t>(GetCurrentProcessId()), 0,
+                static_cast<int64_t>(PlatformMonotonicNanoseconds()), 0, GetCurrentThreadId());
+            FlightRecorderStart(s_pHeader);
+        }
+    }
+    ReleaseSRWLockExclusive(&s_srwOpen);
+    return hr;
+}
+
+void FlightRecorderShutdown()
+{
+    AcquireSRWLockExclusive(&s_srwOpen);
+    FlightRecorderStop();
+    if (s_pHeader)
+    {
+        UnmapViewOfFile(s_pHeader);
+        s_pHeader = NULL;
+    }
+    ReleaseSRWLockExclusive(&s_srwOpen);
+}
@@ -0,0 +1,24 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Maps the process-wide flight recorder ring (see FlightRecorder.h) from a file.  Decode
+// the file with CredentialTool decode-flight-recorder, even while it is still mapped.
+
+#pragma once
+#include <windows.h>
+#include "FlightRecorder.h"
+
+// Maps the ring at pwzPath, creating it with room for cEvents if it does not exist (an
+// existing file keeps its size), and starts recording.  The first successful open wins.
+// The view then stays mapped until FlightRecorderShutdown, so no thread can be left
+// writing into memory that has gone away.
+HRESULT FlightRecorderOpen(__in PCWSTR pwzPath, __in DWORD cEvents);
+
+// Unmaps the ring.  Only call this when no other thread can be recording, which in
+// practice means DLL_PROCESS_DETACH.
+void FlightRecorderShutdown();
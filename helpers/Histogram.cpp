@@ -0,0 +1,336 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Log-linear latency histograms and their file format.
+
+#include <string.h>
+#include <memory>
+#include <new>
+#include <vector>
+#include "Histogram.h"
+
+std::atomic<bool> g_fLatencyEnabled(false);
+
+static LATENCY_PHASE_HISTOGRAMS s_lph;
+
+static const wchar_t* const s_rgpwzPhaseNames[] =
+{
+    L"credential load",
+    L"UTF conversion",
+    L"ProtectIfNecessaryAndCopyPassword",
+    L"KerbInteractiveUnlockLogonPack",
+    L"RetrieveNegotiateAuthPackage",
+    L"GetSerialization",
+    L"SetUsageScenario",
+    L"sealed store decrypt",
+    L"host rules match",
+    L"logon attempt: time to submit",
+    L"logon attempt: time to result",
+    L"status delivery",
+};
+
+static_assert(sizeof(s_rgpwzPhaseNames) / sizeof(s_rgpwzPhaseNames[0]) == LP_NUM_PHASES, "every phase needs a name");
+
+// On disk, in native byte order, which is little-endian everywhere the provider runs.
+struct HISTOGRAM_FILE_HEADER
+{
+    uint32_t ulMagic;
+    uint32_t ulVersion;
+    uint32_t cPhases;
+    uint32_t cBuckets;
+    // Followed, for each phase, by a uint32_t count of non-empty buckets and that many
+    // HISTOGRAM_FILE_BUCKETs.
+};
+
+struct HISTOGRAM_FILE_BUCKET
+{
+    uint32_t iBucket;
+    uint32_t cCount;
+};
+
+// A file bigger than every bucket of every phase being non-empty is not one of ours.
+#define HISTOGRAM_FILE_MAX_SIZE (sizeof(HISTOGRAM_FILE_HEADER) + 64 * (sizeof(uint32_t) + HISTOGRAM_BUCKETS * sizeof(HISTOGRAM_FILE_BUCKET)))
+
+void LatencyEnable(bool fEnable)
+{
+    g_fLatencyEnabled.store(fEnable);
+}
+
+const wchar_t* LatencyPhaseName(LATENCY_PHASE lp)
+{
+    return (lp < LP_NUM_PHASES) ? s_rgpwzPhaseNames[lp] : L"?";
+}
+
+static uint32_t _HistogramBucketIndex(unsigned long long ull)
+{
+    uint32_t iBucket;
+    if (ull < 2 * HISTOGRAM_SUB_BUCKETS)
+    {
+        iBucket = static_cast<uint32_t>(ull);
+    }
+    else if (ull >> (HISTOGRAM_MAX_EXPONENT + 1))
+    {
+        iBucket = HISTOGRAM_BUCKETS - 1;
+    }
+    else
+    {
+        uint32_t ulExponent = 0;
+        for (unsigned long long ullRest = ull >> 1; ullRest; ullRest >>= 1)
+        {
+            ulExponent++;
+        }
+        uint32_t ulShift = ulExponent - HISTOGRAM_SUB_BUCKET_BITS;
+        uint32_t ulSub = static_cast<uint32_t>(ull >> ulShift) - HISTOGRAM_SUB_BUCKETS;
+        iBucket = 2 * HISTOGRAM_SUB_BUCKETS + (ulExponent - HISTOGRAM_SUB_BUCKET_BITS - 1) * HISTOGRAM_SUB_BUCKETS + ulSub;
+    }
+    return iBucket;
+}
+
+// The largest value that lands in bucket iBucket.
+static unsigned long long _HistogramBucketHighValue(uint32_t iBucket)
+{
+    unsigned long long ull;
+    if (iBucket < 2 * HISTOGRAM_SUB_BUCKETS)
+    {
+        ull = iBucket;
+    }
+    else
+    {
+        uint32_t k = iBucket - 2 * HISTOGRAM_SUB_BUCKETS;
+        uint32_t ulShift = k / HISTOGRAM_SUB_BUCKETS + 1;
+        unsigned long long ullSub = k % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+        ull = (ullSub << ulShift) + (1ULL << ulShift) - 1;
+    }
+    return ull;
+}
+
+void HistogramRecord(LATENCY_HISTOGRAM* ph, unsigned long long ullNanoseconds)
+{
+    ph->rgulCounts[_HistogramBucketIndex(ullNanoseconds)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void HistogramMerge(LATENCY_HISTOGRAM* phDst, const LATENCY_HISTOGRAM& hSrc)
+{
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        uint32_t cCount = hSrc.rgulCounts[i].load(std::memory_order_relaxed);
+        if (cCount)
+        {
+            phDst->rgulCounts[i].fetch_add(cCount, std::memory_order_relaxed);
+        }
+    }
+}
+
+unsigned long long HistogramTotalCount(const LATENCY_HISTOGRAM& h)
+{
+    unsigned long long ullTotal = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        ullTotal += h.rgulCounts[i].load(std::memory_order_relaxed);
+    }
+    return ullTotal;
+}
+
+unsigned long long HistogramValueAtPercentile(const LATENCY_HISTOGRAM& h, double dPercentile)
+{
+    unsigned long long ullValue = 0;
+    unsigned long long ullTotal = HistogramTotalCount(h);
+    if (ullTotal > 0)
+    {
+        // The rank of the value we want, counting from 1.
+        unsigned long long ullRank = static_cast<unsigned long long>(dPercentile / 100.0 * ullTotal + 0.5);
+        if (ullRank < 1)
+        {
+            ullRank = 1;
+        }
+
+        unsigned long long ullSeen = 0;
+        for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        {
+            ullSeen += h.rgulCounts[i].load(std::memory_order_relaxed);
+            if (ullSeen >= ullRank)
+            {
+                ullValue = _HistogramBucketHighValue(i);
+                break;
+            }
+        }
+    }
+    return ullValue;
+}
+
+void LatencyRecordNanoseconds(LATENCY_PHASE lp, unsigned long long ullNanoseconds)
+{
+    HistogramRecord(&s_lph.rgHistograms[lp], ullNanoseconds);
+}
+
+void LatencyTake(LATENCY_PHASE_HISTOGRAMS* plph)
+{
+    for (uint32_t lp = 0; lp < LP_NUM_PHASES; lp++)
+    {
+        for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        {
+            plph->rgHistograms[lp].rgulCounts[i].store(s_lph.rgHistograms[lp].rgulCounts[i].exchange(0), std::memory_order_relaxed);
+        }
+    }
+}
+
+// Adds the histograms in the cb bytes at pb, a whole file, into *plphFile.
+static PLATFORM_RESULT _HistogramFileParse(const unsigned char* pb, size_t cb, LATENCY_PHASE_HISTOGRAMS* plphFile)
+{
+    HISTOGRAM_FILE_HEADER hdr;
+    if (cb < sizeof(hdr))
+    {
+        return PR_BAD_DATA;
+    }
+    memcpy(&hdr, pb, sizeof(hdr));
+    if (hdr.ulMagic != HISTOGRAM_FILE_MAGIC || hdr.ulVersion != HISTOGRAM_FILE_VERSION || hdr.cBuckets != HISTOGRAM_BUCKETS)
+    {
+        return PR_BAD_DATA;
+    }
+
+    size_t ib = sizeof(hdr);
+    for (uint32_t lp = 0; lp < hdr.cPhases; lp++)
+    {
+        uint32_t cNonEmpty;
+        if (cb - ib < sizeof(cNonEmpty))
+        {
+            return PR_BAD_DATA;
+        }
+        memcpy(&cNonEmpty, pb + ib, sizeof(cNonEmpty));
+        ib += sizeof(cNonEmpty);
+
+        if (cNonEmpty > HISTOGRAM_BUCKETS || (cb - ib) / sizeof(HISTOGRAM_FILE_BUCKET) < cNonEmpty)
+        {
+            return PR_BAD_DATA;
+        }
+
+        for (uint32_t j = 0; j < cNonEmpty; j++)
+        {
+            HISTOGRAM_FILE_BUCKET hfb;
+            memcpy(&hfb, pb + ib, sizeof(hfb));
+            ib += sizeof(hfb);
+
+            if (hfb.iBucket >= HISTOGRAM_BUCKETS)
+            {
+                return PR_BAD_DATA;
+            }
+
+            // Phases newer than this build are skipped, not rejected.
+            if (lp < LP_NUM_PHASES)
+            {
+                plphFile->rgHistograms[lp].rgulCounts[hfb.iBucket].fetch_add(hfb.cCount, std::memory_order_relaxed);
+            }
+        }
+    }
+    return PR_OK;
+}
+
+PLATFORM_RESULT HistogramFileRead(const wchar_t* pwzPath, LATENCY_PHASE_HISTOGRAMS* plph)
+{
+    std::vector<unsigned char> rgb;
+    PLATFORM_RESULT pr = PlatformReadFile(pwzPath, HISTOGRAM_FILE_MAX_SIZE, &rgb);
+    if (PR_TOO_LARGE == pr)
+    {
+        pr = PR_BAD_DATA;
+    }
+
+    if (PR_OK == pr)
+    {
+        // Parse into a scratch copy first so a truncated file adds nothing.
+        std::unique_ptr<LATENCY_PHASE_HISTOGRAMS> plphFile(new (std::nothrow) LATENCY_PHASE_HISTOGRAMS());
+        if (plphFile)
+        {
+            pr = rgb.empty() ? PR_BAD_DATA : _HistogramFileParse(&rgb[0], rgb.size(), plphFile.get());
+            if (PR_OK == pr)
+            {
+                for (uint32_t lp = 0; lp < LP_NUM_PHASES; lp++)
+                {
+                    HistogramMerge(&plph->rgHistograms[lp], plphFile->rgHistograms[lp]);
+                }
+            }
+        }
+        else
+        {
+            pr = PR_OUT_OF_MEMORY;
+        }
+    }
+
+    return pr;
+}
+
+PLATFORM_RESULT HistogramFileWrite(const wchar_t* pwzPath, const LATENCY_PHASE_HISTOGRAMS& lph)
+{
+    PLATFORM_FILE* pFile;
+    PLATFORM_RESULT pr = PlatformCreateFile(pwzPath, PC_TRUNCATE, &pFile);
+    if (PR_OK == pr)
+    {
+        HISTOGRAM_FILE_HEADER hdr = { HISTOGRAM_FILE_MAGIC, HISTOGRAM_FILE_VERSION, LP_NUM_PHASES, HISTOGRAM_BUCKETS };
+        unsigned long long ullOffset = 0;
+        pr = PlatformWriteFileAt(pFile, ullOffset, &hdr, sizeof(hdr));
+        ullOffset += sizeof(hdr);
+
+        // Large enough for one phase with every bucket in use.
+        std::unique_ptr<HISTOGRAM_FILE_BUCKET[]> rghfb(new (std::nothrow) HISTOGRAM_FILE_BUCKET[HISTOGRAM_BUCKETS]);
+        if (!rghfb && PR_OK == pr)
+        {
+            pr = PR_OUT_OF_MEMORY;
+        }
+
+        for (uint32_t lp = 0; PR_OK == pr && lp < LP_NUM_PHASES; lp++)
+        {
+            uint32_t cNonEmpty = 0;
+            for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+            {
+                uint32_t cCount = lph.rgHistograms[lp].rgulCounts[i].load(std::memory_order_relaxed);
+                if (cCount)
+                {
+                    rghfb[cNonEmpty].iBucket = i;
+                    rghfb[cNonEmpty].cCount = cCount;
+                    cNonEmpty++;
+                }
+            }
+
+            pr = PlatformWriteFileAt(pFile, ullOffset, &cNonEmpty, sizeof(cNonEmpty));
+            ullOffset += sizeof(cNonEmpty);
+            if (PR_OK == pr && cNonEmpty)
+            {
+                pr = PlatformWriteFileAt(pFile, ullOffset, rghfb.get(), cNonEmpty * sizeof(HISTOGRAM_FILE_BUCKET));
+                ullOffset += cNonEmpty * sizeof(HISTOGRAM_FILE_BUCKET);
+            }
+        }
+
+        PlatformCloseFile(pFile);
+    }
+
+    return pr;
+}
+
+PLATFORM_RESULT HistogramFileAccumulate(const wchar_t* pwzPath, const LATENCY_PHASE_HISTOGRAMS& lph)
+{
+    PLATFORM_RESULT pr;
+
+    std::unique_ptr<LATENCY_PHASE_HISTOGRAMS> plphTotal(new (std::nothrow) LATENCY_PHASE_HISTOGRAMS());
+    if (plphTotal)
+    {
+        // A file we cannot make sense of is replaced rather than left to block every later
+        // write.
+        HistogramFileRead(pwzPath, plphTotal.get());
+
+        for (uint32_t lp = 0; lp < LP_NUM_PHASES; lp++)
+        {
+            HistogramMerge(&plphTotal->rgHistograms[lp], lph.rgHistograms[lp]);
+        }
+        pr = HistogramFileWrite(pwzPath, *plphTotal);
+    }
+    else
+    {
+        pr = PR_OUT_OF_MEMORY;
+    }
+
+    return pr;
+}
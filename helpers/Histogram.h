@@ -0,0 +1,144 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Latency histograms for the named phases of a logon.
+//
+// Each histogram is log-linear in the style of HdrHistogram.  Values below 64ns get their
+// own bucket, and every power of two above that is split into 32 buckets, so any reported
+// value is within about 3% of the true one.  Values are nanoseconds and anything past
+// 2^40ns (about 18 minutes) lands in the last bucket.  The memory is fixed.  Recording is
+// one atomic increment, so any thread can record without a lock.  Two histograms merge by
+// adding their buckets, which is what lets files from different machines be combined.
+//
+// Platform-neutral: this uses only the C++ standard library and Platform.h, and builds into
+// CredentialCore.
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include "Platform.h"
+#include "FlightRecorder.h"
+
+#define HISTOGRAM_SUB_BUCKET_BITS   5
+#define HISTOGRAM_SUB_BUCKETS       (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_MAX_EXPONENT      40
+#define HISTOGRAM_BUCKETS           (2 * HISTOGRAM_SUB_BUCKETS + (HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_SUB_BUCKETS)
+
+// Value-initialize one (new LATENCY_HISTOGRAM()) to start it empty.
+struct LATENCY_HISTOGRAM
+{
+    std::atomic<uint32_t> rgulCounts[HISTOGRAM_BUCKETS];
+};
+
+// The phases we measure.  The order is part of the file format: add new phases at the end
+// and bump HISTOGRAM_FILE_VERSION if one is ever removed.
+enum LATENCY_PHASE
+{
+    LP_CREDENTIAL_LOAD,         // reading the credential store from disk
+    LP_UTF_CONVERSION,          // decoding it into UTF-16
+    LP_PROTECT_PASSWORD,        // ProtectIfNecessaryAndCopyPassword
+    LP_LOGON_PACK,              // KerbInteractiveUnlockLogonPack
+    LP_NEGOTIATE_LOOKUP,        // RetrieveNegotiateAuthPackage
+    LP_GET_SERIALIZATION,       // ICredentialProviderCredential::GetSerialization, end to end
+    LP_SET_USAGE_SCENARIO,      // ICredentialProvider::SetUsageScenario, end to end
+    LP_STORE_DECRYPT,           // finding and decrypting this machine's record in a sealed store
+    LP_HOST_RULES,              // evaluating the compiled host rules for this machine
+    LP_TIME_TO_SUBMIT,          // a logon attempt, from SetUsageScenario to GetSerialization returning
+    LP_TIME_TO_RESULT,          // a logon attempt, from SetUsageScenario to ReportResult
+    LP_STATUS_DELIVERY,         // a tile status update, from being posted to reaching LogonUI
+    LP_NUM_PHASES,
+};
+
+// The process-wide histograms, one per phase.
+struct LATENCY_PHASE_HISTOGRAMS
+{
+    LATENCY_HISTOGRAM rgHistograms[LP_NUM_PHASES];
+};
+
+// Read inline by CLatencyScope; change it with LatencyEnable.
+extern std::atomic<bool> g_fLatencyEnabled;
+
+void LatencyEnable(bool fEnable);
+
+const wchar_t* LatencyPhaseName(LATENCY_PHASE lp);
+
+void HistogramRecord(LATENCY_HISTOGRAM* ph, unsigned long long ullNanoseconds);
+
+// Adds every bucket of hSrc into *phDst.
+void HistogramMerge(LATENCY_HISTOGRAM* phDst, const LATENCY_HISTOGRAM& hSrc);
+
+unsigned long long HistogramTotalCount(const LATENCY_HISTOGRAM& h);
+
+// Returns the value, in nanoseconds, at or below which dPercentile percent of the recorded
+// values fall.  Returns 0 for an empty histogram.
+unsigned long long HistogramValueAtPercentile(const LATENCY_HISTOGRAM& h, double dPercentile);
+
+// Records a duration measured in nanoseconds against a phase of the process-wide histograms.
+void LatencyRecordNanoseconds(LATENCY_PHASE lp, unsigned long long ullNanoseconds);
+
+// Moves the process-wide histograms into *plph, leaving them empty.  Each bucket is taken
+// atomically, so values recorded concurrently land either in *plph or in the next take.
+void LatencyTake(LATENCY_PHASE_HISTOGRAMS* plph);
+
+// Persistence.  The file holds, for each phase, only the buckets that are not empty.
+// HistogramFileRead adds what it reads into *plph, so calling it on several files
+// aggregates them; a missing file adds nothing and returns PR_NOT_FOUND, and one that is
+// not a histogram file adds nothing and returns PR_BAD_DATA.  HistogramFileAccumulate adds
+// lph to whatever the file already holds.
+#define HISTOGRAM_FILE_MAGIC    0x47484C41  // 'ALHG'
+#define HISTOGRAM_FILE_VERSION  1
+
+PLATFORM_RESULT HistogramFileRead(const wchar_t* pwzPath, LATENCY_PHASE_HISTOGRAMS* plph);
+PLATFORM_RESULT HistogramFileWrite(const wchar_t* pwzPath, const LATENCY_PHASE_HISTOGRAMS& lph);
+PLATFORM_RESULT HistogramFileAccumulate(const wchar_t* pwzPath, const LATENCY_PHASE_HISTOGRAMS& lph);
+
+class CLatencyScope
+{
+public:
+    // pszName is the phase's name for the flight recorder; LATENCY_SCOPE passes the
+    // enumerator's.
+    CLatencyScope(LATENCY_PHASE lp, const char* pszName) : _lp(lp), _pszName(pszName), _fActive(false), _ullBegin(0)
+    {
+        if (g_fLatencyEnabled.load(std::memory_order_relaxed) | g_fFlightRecorderEnabled.load(std::memory_order_relaxed))
+        {
+            _fActive = true;
+            _ullBegin = PlatformMonotonicNanoseconds();
+        }
+    }
+
+    ~CLatencyScope()
+    {
+        if (_fActive)
+        {
+            unsigned long long ullEnd = PlatformMonotonicNanoseconds();
+            if (g_fLatencyEnabled.load(std::memory_order_relaxed))
+            {
+                LatencyRecordNanoseconds(_lp, ullEnd - _ullBegin);
+            }
+            if (g_fFlightRecorderEnabled.load(std::memory_order_relaxed))
+            {
+                FlightRecord(FE_PHASE, _pszName, 0, static_cast<uint16_t>(_lp), static_cast<int64_t>(ullEnd),
+                    static_cast<int64_t>(ullEnd - _ullBegin));
+            }
+        }
+    }
+
+private:
+    CLatencyScope(const CLatencyScope&);
+    CLatencyScope& operator=(const CLatencyScope&);
+
+    LATENCY_PHASE       _lp;
+    const char*         _pszName;
+    bool                _fActive;
+    unsigned long long  _ullBegin;
+};
+
+#define LATENCY_CONCAT_(a, b) a##b
+#define LATENCY_CONCAT(a, b) LATENCY_CONCAT_(a, b)
+
+#define LATENCY_SCOPE(lp) CLatencyScope LATENCY_CONCAT(_latencyScope, __LINE__)(lp, #lp)
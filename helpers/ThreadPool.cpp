@@ -0,0 +1,465 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The DLL's private thread pool; see ThreadPool.h.
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include "AllocTrack.h"
+#include "ThreadPool.h"
+
+class CThreadPool;
+
+// One priority of one worker's queue, newest first, under its own lock.  The count lets a
+// worker pass over an empty queue without taking the lock.
+struct WORK_QUEUE
+{
+    std::mutex mutex;
+    CWorkFuture* pNewest = NULL;
+    CWorkFuture* pOldest = NULL;
+    std::atomic<unsigned long> cItems{0};
+};
+
+struct POOL_WORKER
+{
+    CThreadPool* pPool = NULL;
+    WORK_QUEUE rgQueues[WP_NUM_PRIORITIES];
+    std::thread thread;
+};
+
+class CThreadPool
+{
+public:
+    static CWorkFuture* CreateFuture(PFN_WORK_ITEM pfnWork, void* pvContext, const CCancellationToken* pctParent)
+    {
+        return new (std::nothrow) CWorkFuture(pfnWork, pvContext, pctParent);
+    }
+
+    // Called with s_mutexPool held.
+    static PLATFORM_RESULT Start(CThreadPool** ppPool);
+    void Queue(CWorkFuture* pFuture, WORK_PRIORITY wp);
+
+    // Stops and joins the workers and frees the pool.  Called once the pool is out of
+    // service, without s_mutexPool.
+    void Stop(bool fCancelPending);
+
+private:
+    CThreadPool() :
+        _iNextWorker(0), _cQueued(0), _cSleeping(0), _fStop(false)
+    {
+    }
+
+    static CWorkFuture* _PopNewest(WORK_QUEUE* pQueue);
+    static CWorkFuture* _PopOldest(WORK_QUEUE* pQueue);
+    static void _Unlink(WORK_QUEUE* pQueue, CWorkFuture* pFuture);
+    static void _Complete(CWorkFuture* pFuture, WORK_STATE ws, long lResult, uintptr_t ulpResult);
+    CWorkFuture* _Take(POOL_WORKER* pWorker);
+    void _Run(POOL_WORKER* pWorker);
+
+    POOL_WORKER _rgWorkers[THREAD_POOL_THREADS];
+    std::atomic<unsigned long> _iNextWorker;    // the worker the next item from outside goes to
+    std::atomic<long> _cQueued;                 // items on all the queues; briefly -1 as one is taken before it is counted
+
+    // Workers with nothing to take sleep on _cvIdle.
+    std::mutex _mutexIdle;
+    std::condition_variable _cvIdle;
+    std::atomic<long> _cSleeping;
+    bool _fStop;                                // under _mutexIdle
+};
+
+// Guards starting and closing the pool, and counting items in, so that
+// ThreadPoolShutdownIfIdle can't close it between a submit's count and its queueing.
+static std::mutex s_mutexPool;
+static CThreadPool* s_pPool = NULL;
+
+// Items submitted and not yet finished, in every pool.
+static std::atomic<long> s_cPending(0);
+
+// Every future waits on the same condition; items finish rarely enough that waking all
+// waiters costs nothing.
+static std::mutex s_mutexDone;
+static std::condition_variable s_cvDone;
+
+// The worker the calling thread is, if it is one.
+static thread_local POOL_WORKER* t_pWorker = NULL;
+
+unsigned long CWorkFuture::AddRef()
+{
+    return ++_cRef;
+}
+
+unsigned long CWorkFuture::Release()
+{
+    unsigned long cRef = --_cRef;
+    if (!cRef)
+    {
+        delete this;
+    }
+    return cRef;
+}
+
+void CWorkFuture::Cancel()
+{
+    _ct.Cancel();
+}
+
+bool CWorkFuture::Wait(unsigned long ulMilliseconds)
+{
+    std::unique_lock<std::mutex> lock(s_mutexDone);
+    auto fnDone = [this]() { return WS_PENDING != _ws.load(); };
+    if (THREAD_POOL_INFINITE == ulMilliseconds)
+    {
+        s_cvDone.wait(lock, fnDone);
+        return true;
+    }
+    return s_cvDone.wait_for(lock, std::chrono::milliseconds(ulMilliseconds), fnDone);
+}
+
+WORK_STATE CWorkFuture::GetResult(long* plResult, uintptr_t* pulpResult) const
+{
+    WORK_STATE ws = _ws.load();
+    if (plResult)
+    {
+        *plResult = (WS_FINISHED == ws) ? _lResult : 0;
+    }
+    if (pulpResult)
+    {
+        *pulpResult = (WS_FINISHED == ws) ? _ulpResult : 0;
+    }
+    return ws;
+}
+
+PLATFORM_RESULT CThreadPool::Start(CThreadPool** ppPool)
+{
+    // The pool and its threads belong to no caller's budget.
+    ALLOC_UNCHARGED();
+    CThreadPool* pPool = new (std::nothrow) CThreadPool();
+    if (!pPool)
+    {
+        return PR_OUT_OF_MEMORY;
+    }
+
+    PLATFORM_RESULT pr = PR_OK;
+    try
+    {
+        for (int i = 0; i < THREAD_POOL_THREADS; i++)
+        {
+            POOL_WORKER* pWorker = &pPool->_rgWorkers[i];
+            pWorker->pPool = pPool;
+            pWorker->thread = std::thread(&CThreadPool::_Run, pPool, pWorker);
+        }
+    }
+    catch (const std::system_error&)
+    {
+        pr = PR_IO_ERROR;
+    }
+    catch (const std::bad_alloc&)
+    {
+        pr = PR_OUT_OF_MEMORY;
+    }
+
+    if (PR_OK == pr)
+    {
+        *ppPool = pPool;
+    }
+    else
+    {
+        pPool->Stop(false);
+    }
+    return pr;
+}
+
+void CThreadPool::_Unlink(WORK_QUEUE* pQueue, CWorkFuture* pFuture)
+{
+    (pFuture->_pNewer ? pFuture->_pNewer->_pOlder : pQueue->pNewest) = pFuture->_pOlder;
+    (pFuture->_pOlder ? pFuture->_pOlder->_pNewer : pQueue->pOldest) = pFuture->_pNewer;
+    pFuture->_pNewer = NULL;
+    pFuture->_pOlder = NULL;
+    pQueue->cItems--;
+}
+
+CWorkFuture* CThreadPool::_PopNewest(WORK_QUEUE* pQueue)
+{
+    CWorkFuture* pFuture = NULL;
+    if (pQueue->cItems.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(pQueue->mutex);
+        pFuture = pQueue->pNewest;
+        if (pFuture)
+        {
+            _Unlink(pQueue, pFuture);
+        }
+    }
+    return pFuture;
+}
+
+CWorkFuture* CThreadPool::_PopOldest(WORK_QUEUE* pQueue)
+{
+    CWorkFuture* pFuture = NULL;
+    if (pQueue->cItems.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(pQueue->mutex);
+        pFuture = pQueue->pOldest;
+        if (pFuture)
+        {
+            _Unlink(pQueue, pFuture);
+        }
+    }
+    return pFuture;
+}
+
+// Called with s_mutexPool held, so the pool can't be stopped under it.
+void CThreadPool::Queue(CWorkFuture* pFuture, WORK_PRIORITY wp)
+{
+    // An item submitted from one of our workers stays with it; the rest are dealt round.
+    POOL_WORKER* pWorker = t_pWorker;
+    if (!pWorker || pWorker->pPool != this)
+    {
+        pWorker = &_rgWorkers[_iNextWorker.fetch_add(1, std::memory_order_relaxed) % THREAD_POOL_THREADS];
+    }
+
+    WORK_QUEUE* pQueue = &pWorker->rgQueues[wp];
+    {
+        std::lock_guard<std::mutex> lock(pQueue->mutex);
+        pFuture->_pOlder = pQueue->pNewest;
+        (pQueue->pNewest ? pQueue->pNewest->_pNewer : pQueue->pOldest) = pFuture;
+        pQueue->pNewest = pFuture;
+        pQueue->cItems++;
+    }
+
+    // A worker counts itself sleeping before it looks at _cQueued, and this counts the item
+    // before it looks at _cSleeping, so one of the two sees the other.  Taking the lock
+    // makes sure a worker that saw nothing is waiting before it is woken.
+    _cQueued++;
+    if (_cSleeping.load() > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutexIdle);
+        }
+        _cvIdle.notify_one();
+    }
+}
+
+// The newest item of the highest priority on this worker's own queue, while it is still
+// warm in the cache; failing that, the oldest of that priority on another worker's, the one
+// its owner would have run last.
+CWorkFuture* CThreadPool::_Take(POOL_WORKER* pWorker)
+{
+    size_t iWorker = pWorker - _rgWorkers;
+    for (int wp = 0; wp < WP_NUM_PRIORITIES; wp++)
+    {
+        CWorkFuture* pFuture = _PopNewest(&pWorker->rgQueues[wp]);
+        for (size_t i = 1; !pFuture && i < THREAD_POOL_THREADS; i++)
+        {
+            pFuture = _PopOldest(&_rgWorkers[(iWorker + i) % THREAD_POOL_THREADS].rgQueues[wp]);
+        }
+        if (pFuture)
+        {
+            _cQueued--;
+            return pFuture;
+        }
+    }
+    return NULL;
+}
+
+void CThreadPool::_Complete(CWorkFuture* pFuture, WORK_STATE ws, long lResult, uintptr_t ulpResult)
+{
+    pFuture->_lResult = lResult;
+    pFuture->_ulpResult = ulpResult;
+    {
+        std::lock_guard<std::mutex> lock(s_mutexDone);
+        pFuture->_ws.store(ws);
+    }
+    s_cvDone.notify_all();
+
+    s_cPending--;
+
+    // The pool's reference.
+    pFuture->Release();
+}
+
+void CThreadPool::_Run(POOL_WORKER* pWorker)
+{
+    t_pWorker = pWorker;
+    for (;;)
+    {
+        CWorkFuture* pFuture = _Take(pWorker);
+        if (pFuture)
+        {
+            if (pFuture->_ct.IsCanceled())
+            {
+                _Complete(pFuture, WS_CANCELED, 0, 0);
+            }
+            else
+            {
+                uintptr_t ulpResult = 0;
+                long lResult = pFuture->_pfnWork(pFuture->_pvContext, pFuture->_ct, &ulpResult);
+                _Complete(pFuture, WS_FINISHED, lResult, ulpResult);
+            }
+            continue;
+        }
+
+        // Nothing is queued after Stop starts, so once the queues are empty they stay so.
+        std::unique_lock<std::mutex> lock(_mutexIdle);
+        if (_fStop && _cQueued.load() <= 0)
+        {
+            break;
+        }
+        _cSleeping++;
+        while (!_fStop && _cQueued.load() <= 0)
+        {
+            _cvIdle.wait(lock);
+        }
+        _cSleeping--;
+    }
+    t_pWorker = NULL;
+}
+
+void CThreadPool::Stop(bool fCancelPending)
+{
+    ALLOC_UNCHARGED();
+    if (fCancelPending)
+    {
+        for (int i = 0; i < THREAD_POOL_THREADS; i++)
+        {
+            for (int wp = 0; wp < WP_NUM_PRIORITIES; wp++)
+            {
+                CWorkFuture* pFuture;
+                while (NULL != (pFuture = _PopOldest(&_rgWorkers[i].rgQueues[wp])))
+                {
+                    _cQueued--;
+                    _Complete(pFuture, WS_CANCELED, 0, 0);
+                }
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutexIdle);
+        _fStop = true;
+    }
+    _cvIdle.notify_all();
+    for (int i = 0; i < THREAD_POOL_THREADS; i++)
+    {
+        if (_rgWorkers[i].thread.joinable())
+        {
+            _rgWorkers[i].thread.join();
+        }
+    }
+    delete this;
+}
+
+PLATFORM_RESULT ThreadPoolSubmit(
+    PFN_WORK_ITEM pfnWork,
+    void* pvContext,
+    WORK_PRIORITY wp,
+    const CCancellationToken* pctParent,
+    CWorkFuture** ppFuture
+    )
+{
+    if (ppFuture)
+    {
+        *ppFuture = NULL;
+    }
+    if (wp < 0 || wp >= WP_NUM_PRIORITIES)
+    {
+        return PR_INVALID_ARGUMENT;
+    }
+
+    CWorkFuture* pFuture = CThreadPool::CreateFuture(pfnWork, pvContext, pctParent);
+    if (!pFuture)
+    {
+        return PR_OUT_OF_MEMORY;
+    }
+
+    // The caller's reference, taken before the pool can run the item and drop its own.
+    if (ppFuture)
+    {
+        pFuture->AddRef();
+    }
+
+    PLATFORM_RESULT pr = PR_OK;
+    {
+        std::lock_guard<std::mutex> lock(s_mutexPool);
+        if (!s_pPool)
+        {
+            pr = CThreadPool::Start(&s_pPool);
+        }
+        if (PR_OK == pr)
+        {
+            // Counted with the lock held, so the DLL never looks idle while the item exists.
+            s_cPending++;
+            s_pPool->Queue(pFuture, wp);
+        }
+    }
+
+    if (PR_OK == pr)
+    {
+        if (ppFuture)
+        {
+            *ppFuture = pFuture;
+        }
+    }
+    else
+    {
+        if (ppFuture)
+        {
+            pFuture->Release();
+        }
+        pFuture->Release();
+    }
+    return pr;
+}
+
+bool ThreadPoolIsBusy()
+{
+    return s_cPending.load() > 0;
+}
+
+void ThreadPoolShutdown(bool fCancelPending)
+{
+    // Take the pool out of service first, so items that submit more while this waits get a
+    // new pool instead of waiting on the lock.
+    CThreadPool* pPool;
+    {
+        std::lock_guard<std::mutex> lock(s_mutexPool);
+        pPool = s_pPool;
+        s_pPool = NULL;
+    }
+
+    if (pPool)
+    {
+        pPool->Stop(fCancelPending);
+    }
+}
+
+bool ThreadPoolShutdownIfIdle()
+{
+    CThreadPool* pPool = NULL;
+    bool fIdle;
+    {
+        std::lock_guard<std::mutex> lock(s_mutexPool);
+        fIdle = (0 == s_cPending.load());
+        if (fIdle)
+        {
+            pPool = s_pPool;
+            s_pPool = NULL;
+        }
+    }
+
+    // Idle, its workers are only finishing what they did for the last item, or asleep.
+    if (pPool)
+    {
+        pPool->Stop(false);
+    }
+    return fIdle;
+}
@@ -0,0 +1,154 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// The one place the provider runs background work.  Nothing should start threads of its own
+// inside LogonUI.
+//
+// Work items run on THREAD_POOL_THREADS worker threads that belong to this DLL, started by
+// the first ThreadPoolSubmit.  Each worker keeps its own queue per priority: an item
+// submitted from a worker goes on that worker's queue, and any other item on the next
+// worker's in turn.  A worker takes the newest item from its own queue, and when that is
+// empty steals the oldest from another's; it always takes the highest priority any queue
+// has.  Workers with nothing to take sleep until an item is queued.  DllCanUnloadNow closes
+// the pool with ThreadPoolShutdownIfIdle, which joins the workers, so none is left running
+// this DLL's code once it reports that it can unload.  The next submit starts it again.
+// Nothing stops the pool as the DLL is unloaded: that would wait on its threads under the
+// loader lock.
+//
+// Each item gets a CCancellationToken, which it should check between steps of any long
+// work.  Cancelling an item that has not started yet means it never runs.  An item can also
+// be tied to a caller's token, so that one Cancel stops a whole batch.  The caller can keep a
+// CWorkFuture to wait for the item and read what it returned.  Queuing an item allocates
+// only its future.
+//
+// Platform-neutral: this uses only the C++ standard library and Platform.h, and builds into
+// CredentialCore.
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include "Platform.h"
+
+#define THREAD_POOL_THREADS 4
+
+// For CWorkFuture::Wait, to wait however long the item takes.
+#define THREAD_POOL_INFINITE ((unsigned long)-1)
+
+enum WORK_PRIORITY
+{
+    WP_HIGH,        // the user is waiting on it
+    WP_NORMAL,
+    WP_LOW,         // housekeeping: flushing, trimming
+    WP_NUM_PRIORITIES,
+};
+
+enum WORK_STATE
+{
+    WS_PENDING,     // queued or running
+    WS_FINISHED,    // it ran, and returned what GetResult reports
+    WS_CANCELED,    // it was canceled before it started, and never ran
+};
+
+class CCancellationToken
+{
+public:
+    // A token tied to pctParent is also canceled whenever pctParent is.  pctParent must
+    // outlive this token.
+    explicit CCancellationToken(const CCancellationToken* pctParent = NULL) :
+        _fCanceled(false), _pctParent(pctParent)
+    {
+    }
+
+    void Cancel()
+    {
+        _fCanceled.store(true);
+    }
+
+    bool IsCanceled() const
+    {
+        return _fCanceled.load() || (_pctParent && _pctParent->IsCanceled());
+    }
+
+private:
+    std::atomic<bool> _fCanceled;
+    const CCancellationToken* _pctParent;
+};
+
+// Runs on a pool thread.  What it returns (on Windows, an HRESULT), and whatever *pulpResult
+// holds then, are kept for CWorkFuture::GetResult; *pulpResult starts out 0.
+typedef long (*PFN_WORK_ITEM)(
+    void* pvContext,
+    const CCancellationToken& rct,
+    uintptr_t* pulpResult
+    );
+
+class CWorkFuture
+{
+public:
+    unsigned long AddRef();
+    unsigned long Release();
+
+    // Keeps the item from starting, or, if it is already running, asks it to stop through
+    // its token.
+    void Cancel();
+
+    // Waits up to ulMilliseconds, or THREAD_POOL_INFINITE, for the item to finish or be
+    // canceled.  Returns whether it has.
+    bool Wait(unsigned long ulMilliseconds);
+
+    // Where the item is.  Once it is WS_FINISHED, *plResult and *pulpResult, if asked for,
+    // are what it returned; until then they are 0.
+    WORK_STATE GetResult(long* plResult, uintptr_t* pulpResult) const;
+
+private:
+    friend class CThreadPool;
+
+    CWorkFuture(PFN_WORK_ITEM pfnWork, void* pvContext, const CCancellationToken* pctParent) :
+        _cRef(1), _pfnWork(pfnWork), _pvContext(pvContext), _ws(WS_PENDING), _lResult(0), _ulpResult(0),
+        _ct(pctParent), _pNewer(NULL), _pOlder(NULL)
+    {
+    }
+
+    std::atomic<unsigned long> _cRef;
+    PFN_WORK_ITEM _pfnWork;
+    void* _pvContext;
+    std::atomic<WORK_STATE> _ws;
+    long _lResult;
+    uintptr_t _ulpResult;
+    CCancellationToken _ct;
+
+    // The items on either side of this one in a worker's queue, while it is queued.
+    CWorkFuture* _pNewer;
+    CWorkFuture* _pOlder;
+};
+
+// Queues pfnWork(pvContext) at wp.  If pctParent is given, canceling it cancels the item,
+// and it must stay alive until the item has finished.  *ppFuture, if asked for, holds a
+// reference the caller must Release.  Fails with PR_OUT_OF_MEMORY if the future can't be
+// allocated, and PR_IO_ERROR if the workers can't be started.
+PLATFORM_RESULT ThreadPoolSubmit(
+    PFN_WORK_ITEM pfnWork,
+    void* pvContext,
+    WORK_PRIORITY wp,
+    const CCancellationToken* pctParent,
+    CWorkFuture** ppFuture
+    );
+
+// Whether any item submitted has yet to finish.
+bool ThreadPoolIsBusy();
+
+// Waits for the items still queued or running to finish, then stops the workers.  With
+// fCancelPending, items that have not started are canceled instead.  Submitting from inside
+// an item while this runs starts a new pool.  Never call it from a pool thread or under the
+// loader lock while items are running.
+void ThreadPoolShutdown(bool fCancelPending);
+
+// Stops the workers if, and only if, no item is queued or running, deciding that under the
+// same lock as ThreadPoolSubmit, so no item can be submitted in between.  Returns whether
+// the pool was idle.  Never call it from a pool thread.
+bool ThreadPoolShutdownIfIdle();
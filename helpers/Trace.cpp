@@ -0,0 +1,236 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Per-thread span buffers and the Chrome trace-event exporter.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "Trace.h"
+
+static_assert((TRACE_BUFFER_EVENTS & (TRACE_BUFFER_EVENTS - 1)) == 0, "TRACE_BUFFER_EVENTS must be a power of two");
+
+struct TRACE_EVENT
+{
+    const char*         pszName;
+    unsigned long long  ullBegin;
+    unsigned long long  ullEnd;
+};
+
+// One per thread that has recorded a span.  Only the owning thread writes rgEvents and
+// cEvents; the exporter reads them from whichever thread it runs on.
+struct TRACE_THREAD_BUFFER
+{
+    TRACE_THREAD_BUFFER*    pNext;
+    unsigned long           ulThreadId;
+    std::atomic<uint32_t>   cEvents;    // spans ever recorded, wrapping; the newest is at cEvents - 1
+    TRACE_EVENT             rgEvents[TRACE_BUFFER_EVENTS];
+};
+
+std::atomic<bool> g_fTraceEnabled(false);
+
+// Every buffer ever handed out, newest first.  Buffers are only pushed, never unlinked,
+// until TraceShutdown.
+static std::atomic<TRACE_THREAD_BUFFER*> s_pBufferList(nullptr);
+
+static thread_local TRACE_THREAD_BUFFER* t_pBuffer = NULL;
+
+void TraceEnable(bool fEnable)
+{
+    g_fTraceEnabled.store(fEnable);
+}
+
+static TRACE_THREAD_BUFFER* _TraceAllocThreadBuffer()
+{
+    // malloc rather than new, so that the first span on a thread is not charged to whatever
+    // ALLOC_BUDGET happens to enclose it.
+    TRACE_THREAD_BUFFER* pBuffer = static_cast<TRACE_THREAD_BUFFER*>(malloc(sizeof(*pBuffer)));
+    if (pBuffer)
+    {
+        pBuffer->ulThreadId = PlatformCurrentThreadId();
+        new (&pBuffer->cEvents) std::atomic<uint32_t>(0);
+
+        TRACE_THREAD_BUFFER* pHead = s_pBufferList.load(std::memory_order_relaxed);
+        do
+        {
+            pBuffer->pNext = pHead;
+        }
+        while (!s_pBufferList.compare_exchange_weak(pHead, pBuffer, std::memory_order_release, std::memory_order_relaxed));
+
+        t_pBuffer = pBuffer;
+    }
+    return pBuffer;
+}
+
+void TraceRecordSpan(
+    const char* pszName,
+    unsigned long long ullBegin,
+    unsigned long long ullEnd
+)
+{
+    TRACE_THREAD_BUFFER* pBuffer = t_pBuffer;
+    if (!pBuffer)
+    {
+        // If this fails the span is dropped; tracing never fails the caller.
+        pBuffer = _TraceAllocThreadBuffer();
+    }
+
+    if (pBuffer)
+    {
+        uint32_t iEvent = pBuffer->cEvents.load(std::memory_order_relaxed);
+        TRACE_EVENT* pEvent = &pBuffer->rgEvents[iEvent & (TRACE_BUFFER_EVENTS - 1)];
+        pEvent->pszName = pszName;
+        pEvent->ullBegin = ullBegin;
+        pEvent->ullEnd = ullEnd;
+
+        // Publish the count only after the event is complete.
+        pBuffer->cEvents.store(iEvent + 1, std::memory_order_release);
+    }
+}
+
+// Accumulates the JSON text and writes it to the file in large pieces.
+class CTraceFileWriter
+{
+public:
+    CTraceFileWriter(PLATFORM_FILE* pFile) : _pFile(pFile), _ullOffset(0), _cch(0), _pr(PR_OK)
+    {
+    }
+
+    void Append(const char* psz, size_t cch)
+    {
+        while (PR_OK == _pr && cch > 0)
+        {
+            size_t cchCopy = sizeof(_rgch) - _cch;
+            if (cchCopy > cch)
+            {
+                cchCopy = cch;
+            }
+            memcpy(_rgch + _cch, psz, cchCopy);
+            _cch += cchCopy;
+            psz += cchCopy;
+            cch -= cchCopy;
+
+            if (_cch == sizeof(_rgch))
+            {
+                Flush();
+            }
+        }
+    }
+
+    void Append(const char* psz)
+    {
+        Append(psz, strlen(psz));
+    }
+
+    // Appends psz as the body of a JSON string.
+    void AppendEscaped(const char* psz)
+    {
+        for (; *psz; psz++)
+        {
+            unsigned char ch = static_cast<unsigned char>(*psz);
+            if (ch == '"' || ch == '\\')
+            {
+                char rgch[2] = { '\\', static_cast<char>(ch) };
+                Append(rgch, sizeof(rgch));
+            }
+            else if (ch < 0x20)
+            {
+                char rgch[8];
+                snprintf(rgch, sizeof(rgch), "\\u%04x", ch);
+                Append(rgch);
+            }
+            else
+            {
+                Append(psz, 1);
+            }
+        }
+    }
+
+    PLATFORM_RESULT Flush()
+    {
+        if (PR_OK == _pr && _cch > 0)
+        {
+            _pr = PlatformWriteFileAt(_pFile, _ullOffset, _rgch, _cch);
+            _ullOffset += _cch;
+            _cch = 0;
+        }
+        return _pr;
+    }
+
+private:
+    PLATFORM_FILE*      _pFile;
+    unsigned long long  _ullOffset;
+    char                _rgch[4096];
+    size_t              _cch;
+    PLATFORM_RESULT     _pr;    // the first write failure, after which everything is dropped
+};
+
+PLATFORM_RESULT TraceWriteChromeJson(const wchar_t* pwzPath)
+{
+    const unsigned long ulProcessId = PlatformCurrentProcessId();
+
+    PLATFORM_FILE* pFile;
+    PLATFORM_RESULT pr = PlatformCreateFile(pwzPath, PC_TRUNCATE, &pFile);
+    if (PR_OK == pr)
+    {
+        CTraceFileWriter writer(pFile);
+        writer.Append("{\"traceEvents\":[\n");
+
+        bool fFirst = true;
+        for (TRACE_THREAD_BUFFER* pBuffer = s_pBufferList.load(std::memory_order_acquire); pBuffer; pBuffer = pBuffer->pNext)
+        {
+            uint32_t cEvents = pBuffer->cEvents.load(std::memory_order_acquire);
+            uint32_t cHeld = (cEvents < TRACE_BUFFER_EVENTS) ? cEvents : TRACE_BUFFER_EVENTS;
+
+            // Oldest first.  If the owner wraps around while we read, a few of the oldest
+            // slots may already hold newer spans; the viewer copes with that.
+            for (uint32_t i = cEvents - cHeld; i != cEvents; i++)
+            {
+                const TRACE_EVENT* pEvent = &pBuffer->rgEvents[i & (TRACE_BUFFER_EVENTS - 1)];
+
+                // Chrome wants microseconds.
+                char rgch[160];
+                int cch = snprintf(rgch, sizeof(rgch),
+                    "%s{\"ph\":\"X\",\"pid\":%lu,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"",
+                    fFirst ? "" : ",\n",
+                    ulProcessId,
+                    pBuffer->ulThreadId,
+                    pEvent->ullBegin / 1000.0,
+                    (pEvent->ullEnd - pEvent->ullBegin) / 1000.0);
+                if (cch > 0 && static_cast<size_t>(cch) < sizeof(rgch))
+                {
+                    writer.Append(rgch, static_cast<size_t>(cch));
+                    writer.AppendEscaped(pEvent->pszName);
+                    writer.Append("\"}");
+                    fFirst = false;
+                }
+            }
+        }
+
+        writer.Append("\n],\"displayTimeUnit\":\"ms\"}\n");
+        pr = writer.Flush();
+        PlatformCloseFile(pFile);
+    }
+
+    return pr;
+}
+
+void TraceShutdown()
+{
+    g_fTraceEnabled.store(false);
+
+    TRACE_THREAD_BUFFER* pBuffer = s_pBufferList.exchange(NULL);
+    while (pBuffer)
+    {
+        TRACE_THREAD_BUFFER* pNext = pBuffer->pNext;
+        free(pBuffer);
+        pBuffer = pNext;
+    }
+    t_pBuffer = NULL;
+}
@@ -0,0 +1,96 @@
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// Scoped trace spans recorded into a per-thread ring buffer and exported as Chrome
+// trace-event JSON (load the file in chrome://tracing or ui.perfetto.dev).
+//
+// Put TRACE_FUNCTION() or TRACE_SCOPE("name") at the top of a block.  While tracing and
+// the flight recorder are off a span costs loads of g_fTraceEnabled and
+// g_fFlightRecorderEnabled and a branch that is always predicted.  While tracing is on, a
+// span costs two PlatformMonotonicNanoseconds calls and one release store into a buffer
+// only the calling thread writes to.  Each thread keeps its last TRACE_BUFFER_EVENTS spans.
+// While the flight recorder is on, the span's entry and exit also go into its ring.
+//
+// Platform-neutral: this uses only the C++ standard library and Platform.h, and builds into
+// CredentialCore.
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include "Platform.h"
+#include "FlightRecorder.h"
+
+#define TRACE_BUFFER_EVENTS 4096    // per thread; must be a power of two
+
+// Read inline by CTraceScope; change it with TraceEnable.
+extern std::atomic<bool> g_fTraceEnabled;
+
+void TraceEnable(bool fEnable);
+
+// Records one completed span on the calling thread, in PlatformMonotonicNanoseconds.  Use
+// CTraceScope rather than calling this directly.  pszName must stay valid for as long as
+// the module is loaded.
+void TraceRecordSpan(
+    const char* pszName,
+    unsigned long long ullBegin,
+    unsigned long long ullEnd
+);
+
+// Writes every span still held in the per-thread buffers to pwzPath as Chrome trace-event
+// JSON.  Spans recorded while the export runs may or may not be included.
+PLATFORM_RESULT TraceWriteChromeJson(const wchar_t* pwzPath);
+
+// Frees the per-thread buffers.  Only call this when no other thread can be tracing, which
+// in practice means DLL_PROCESS_DETACH.
+void TraceShutdown();
+
+class CTraceScope
+{
+public:
+    explicit CTraceScope(const char* pszName) : _pszName(NULL), _ullBegin(0)
+    {
+        if (g_fTraceEnabled.load(std::memory_order_relaxed) | g_fFlightRecorderEnabled.load(std::memory_order_relaxed))
+        {
+            _pszName = pszName;
+            _ullBegin = PlatformMonotonicNanoseconds();
+            if (g_fFlightRecorderEnabled.load(std::memory_order_relaxed))
+            {
+                FlightRecord(FE_ENTER, pszName, 0, 0, static_cast<int64_t>(_ullBegin), 0);
+            }
+        }
+    }
+
+    ~CTraceScope()
+    {
+        if (_pszName)
+        {
+            unsigned long long ullEnd = PlatformMonotonicNanoseconds();
+            if (g_fTraceEnabled.load(std::memory_order_relaxed))
+            {
+                TraceRecordSpan(_pszName, _ullBegin, ullEnd);
+            }
+            if (g_fFlightRecorderEnabled.load(std::memory_order_relaxed))
+            {
+                FlightRecord(FE_EXIT, _pszName, 0, 0, static_cast<int64_t>(ullEnd), static_cast<int64_t>(ullEnd - _ullBegin));
+            }
+        }
+    }
+
+private:
+    CTraceScope(const CTraceScope&);
+    CTraceScope& operator=(const CTraceScope&);
+
+    const char*         _pszName;   // NULL if tracing and the flight recorder were off when the scope was entered
+    unsigned long long  _ullBegin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_SCOPE(pszName) CTraceScope TRACE_CONCAT(_traceScope, __LINE__)(pszName)
+#define TRACE_FUNCTION() TRACE_SCOPE(__FUNCTION__)
@@ -11,6 +11,9 @@
 
 
 #include "helpers.h"
+#include "Trace.h"
+#include "Histogram.h"
+#include "ThreadPool.h"
 #include <intsafe.h>
 #include <wincred.h>
 
@@ -22,19 +25,36 @@ HRESULT FieldDescriptorCoAllocCopy(
     __in const CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR& rcpfd,
     __deref_out CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR** ppcpfd
     )
+{
+    return FieldDescriptorCoAllocCopyN(rcpfd, rcpfd.pszLabel ? lstrlen(rcpfd.pszLabel) : 0, ppcpfd);
+}
+
+//
+// Same as FieldDescriptorCoAllocCopy, for callers that already know the length of
+// rcpfd.pszLabel (cchLabel characters, not counting the NULL terminator).
+//
+// The descriptor and its label are deliberately two separate allocations: LogonUI frees
+// pszLabel and then the descriptor itself with CoTaskMemFree, so the label cannot live
+// inside the descriptor's block.
+//
+HRESULT FieldDescriptorCoAllocCopyN(
+    __in const CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR& rcpfd,
+    __in size_t cchLabel,
+    __deref_out CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR** ppcpfd
+    )
 {
     HRESULT hr;
     DWORD cbStruct = sizeof(**ppcpfd);
 
-    CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR* pcpfd = (CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR*)CoTaskMemAlloc(cbStruct);
+    CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR* pcpfd = (CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR*)TrackedCoTaskMemAlloc(cbStruct);
     if (pcpfd)
     {
-        pcpfd->dwFieldID = rcpfd.dwFieldID;
-        pcpfd->cpft = rcpfd.cpft;
+        // Start from a flat copy so that any members we don't know about come along too.
+        *pcpfd = rcpfd;
 
         if (rcpfd.pszLabel)
         {
-            hr = SHStrDupW(rcpfd.pszLabel, &pcpfd->pszLabel);
+            hr = StringCoAllocCopy(rcpfd.pszLabel, cchLabel, &pcpfd->pszLabel);
         }
         else
         {
@@ -53,13 +73,47 @@ HRESULT FieldDescriptorCoAllocCopy(
     }
     else
     {
-        CoTaskMemFree(pcpfd);  
+        TrackedCoTaskMemFree(pcpfd);  
         *ppcpfd = NULL;
     }
 
     return hr;
 }
 
+//
+// Copies the cch characters at pwz plus a NULL terminator into a buffer allocated with
+// CoTaskMemAlloc. Unlike SHStrDupW this never walks the source string, so callers that
+// already know the length (such as the field strings the credential hands back to LogonUI
+// on every repaint) pay for exactly one allocation and one copy.
+//
+HRESULT StringCoAllocCopy(
+    __in_ecount(cch) PCWSTR pwz,
+    __in size_t cch,
+    __deref_out PWSTR* ppwz
+    )
+{
+    *ppwz = NULL;
+
+    size_t cb;
+    HRESULT hr = SizeTMult(cch + 1, sizeof(WCHAR), &cb);
+    if (SUCCEEDED(hr))
+    {
+        PWSTR pwzCopy = (PWSTR)TrackedCoTaskMemAlloc(cb);
+        if (pwzCopy)
+        {
+            CopyMemory(pwzCopy, pwz, cch * sizeof(WCHAR));
+            pwzCopy[cch] = L'\0';
+            *ppwz = pwzCopy;
+        }
+        else
+        {
+            hr = E_OUTOFMEMORY;
+        }
+    }
+
+    return hr;
+}
+
 //
 // Coppies rcpfd into the buffer pointed to by pcpfd. The caller is responsible for
 // allocating pcpfd. This function uses CoTaskMemAlloc to allocate memory for 
@@ -78,7 +132,7 @@ HRESULT FieldDescriptorCopy(
 
     if (rcpfd.pszLabel)
     {
-        hr = SHStrDupW(rcpfd.pszLabel, &cpfd.pszLabel);
+        hr = TrackedSHStrDupW(rcpfd.pszLabel, &cpfd.pszLabel);
     }
     else
     {
@@ -263,6 +317,8 @@ HRESULT KerbInteractiveUnlockLogonPack(
     __out DWORD* pcb
     )
 {
+    TRACE_FUNCTION();
+    LATENCY_SCOPE(LP_LOGON_PACK);
     HRESULT hr;
 
     const KERB_INTERACTIVE_LOGON* pkilIn = &rkiulIn.Logon;
@@ -273,7 +329,7 @@ HRESULT KerbInteractiveUnlockLogonPack(
         pkilIn->UserName.Length +
         pkilIn->Password.Length;
 
-    KERB_INTERACTIVE_UNLOCK_LOGON* pkiulOut = (KERB_INTERACTIVE_UNLOCK_LOGON*)CoTaskMemAlloc(cb);
+    KERB_INTERACTIVE_UNLOCK_LOGON* pkiulOut = (KERB_INTERACTIVE_UNLOCK_LOGON*)TrackedCoTaskMemAlloc(cb);
     if (pkiulOut)
     {
         ZeroMemory(&pkiulOut->LogonId, sizeof(pkiulOut->LogonId));
@@ -342,12 +398,13 @@ static HRESULT _LsaInitString(
 }
 
 //
-// Retrieves the 'negotiate' AuthPackage from the LSA. In this case, Kerberos
+// Looks the 'negotiate' AuthPackage up in the LSA. In this case, Kerberos
 // For more information on auth packages see this msdn page:
 // http://msdn.microsoft.com/library/default.asp?url=/library/en-us/secauthn/security/msv1_0_lm20_logon.asp
 //
-HRESULT RetrieveNegotiateAuthPackage(__out ULONG *pulAuthPackage)
+static HRESULT _LookupNegotiateAuthPackage(__out ULONG *pulAuthPackage)
 {
+    TRACE_FUNCTION();
     HRESULT hr;
     HANDLE hLsa;
 
@@ -378,66 +435,143 @@ HRESULT RetrieveNegotiateAuthPackage(__out ULONG *pulAuthPackage)
     return hr;
 }
 
+// The lookup PrefetchNegotiateAuthPackage started, until RetrieveNegotiateAuthPackage takes it.
+static CWorkFuture* volatile s_pNegotiatePrefetch = NULL;
+
+#define NEGOTIATE_PREFETCH_WAIT_MS 100
+
+static long _PrefetchNegotiateAuthPackage(
+    __in void* pvContext,
+    __in const CCancellationToken& rct,
+    __out uintptr_t* pulpResult
+    )
+{
+    UNREFERENCED_PARAMETER(pvContext);
+    UNREFERENCED_PARAMETER(rct);
+    ULONG ulAuthPackage;
+    HRESULT hr = _LookupNegotiateAuthPackage(&ulAuthPackage);
+    if (SUCCEEDED(hr))
+    {
+        *pulpResult = ulAuthPackage;
+    }
+    return hr;
+}
+
+//
+// Starts looking the 'negotiate' AuthPackage up on the thread pool, so that the next
+// RetrieveNegotiateAuthPackage finds the answer waiting.  A prefetch nobody has used yet is
+// replaced.
+//
+void PrefetchNegotiateAuthPackage()
+{
+    CWorkFuture* pFuture;
+    if (PR_OK == ThreadPoolSubmit(_PrefetchNegotiateAuthPackage, NULL, WP_HIGH, NULL, &pFuture))
+    {
+        CWorkFuture* pStale = static_cast<CWorkFuture*>(InterlockedExchangePointer(
+            reinterpret_cast<PVOID volatile*>(&s_pNegotiatePrefetch), pFuture));
+        if (pStale)
+        {
+            pStale->Release();
+        }
+    }
+}
+
+//
+// Retrieves the 'negotiate' AuthPackage from the LSA, using the prefetched answer if there is
+// one.  A prefetch still in flight is usually nearly done, so it is waited for, but only for
+// NEGOTIATE_PREFETCH_WAIT_MS: one stuck behind a slow LSA or a busy pool is left to finish on
+// its own and the lookup is made here instead.
+//
+HRESULT RetrieveNegotiateAuthPackage(__out ULONG *pulAuthPackage)
+{
+    TRACE_FUNCTION();
+    LATENCY_SCOPE(LP_NEGOTIATE_LOOKUP);
+    HRESULT hr = E_PENDING;
+
+    CWorkFuture* pFuture = static_cast<CWorkFuture*>(InterlockedExchangePointer(
+        reinterpret_cast<PVOID volatile*>(&s_pNegotiatePrefetch), NULL));
+    if (pFuture)
+    {
+        long lResult;
+        uintptr_t ulpAuthPackage;
+        if (pFuture->Wait(NEGOTIATE_PREFETCH_WAIT_MS) && WS_FINISHED == pFuture->GetResult(&lResult, &ulpAuthPackage))
+        {
+            hr = lResult;
+        }
+        if (SUCCEEDED(hr))
+        {
+            *pulAuthPackage = static_cast<ULONG>(ulpAuthPackage);
+        }
+        pFuture->Release();
+    }
+
+    if (FAILED(hr))
+    {
+        hr = _LookupNegotiateAuthPackage(pulAuthPackage);
+    }
+    return hr;
+}
+
 //
 // Return a copy of pwzToProtect encrypted with the CredProtect API.
 //
-// pwzToProtect must not be NULL or the empty string.
+// pwzToProtect must not be NULL or the empty string.  CredProtect takes a non-const
+// string, so the caller passes a copy of its own rather than us making another.
 //
 static HRESULT _ProtectAndCopyString(
-    __in PCWSTR pwzToProtect, 
+    __in PWSTR pwzToProtect, 
     __deref_out PWSTR* ppwzProtected
     )
 {
     *ppwzProtected = NULL;
 
-    // pwzToProtect is const, but CredProtect takes a non-const string.
-    // So, ake a copy that we know isn't const.
-    PWSTR pwzToProtectCopy;
-    HRESULT hr = SHStrDupW(pwzToProtect, &pwzToProtectCopy);
-    if (SUCCEEDED(hr))
+    HRESULT hr;
+
+    // The first call to CredProtect determines the length of the encrypted string.
+    // Because we pass a NULL output buffer, we expect the call to fail.
+    //
+    // Note that the third parameter to CredProtect, the number of characters of pwzToProtect
+    // to encrypt, must include the NULL terminator!
+    DWORD cchToProtect = (DWORD)wcslen(pwzToProtect) + 1;
+    DWORD cchProtected = 0;
+    if (!CredProtectW(FALSE, pwzToProtect, cchToProtect, NULL, &cchProtected, NULL))
     {
-        // The first call to CredProtect determines the length of the encrypted string.
-        // Because we pass a NULL output buffer, we expect the call to fail.
-        //
-        // Note that the third parameter to CredProtect, the number of characters of pwzToProtectCopy
-        // to encrypt, must include the NULL terminator!
-        DWORD cchProtected = 0;
-        if (!CredProtectW(FALSE, pwzToProtectCopy, (DWORD)wcslen(pwzToProtectCopy)+1, NULL, &cchProtected, NULL))
-        {
-            DWORD dwErr = GetLastError();
+        DWORD dwErr = GetLastError();
 
-            if ((ERROR_INSUFFICIENT_BUFFER == dwErr) && (0 < cchProtected))
+        if ((ERROR_INSUFFICIENT_BUFFER == dwErr) && (0 < cchProtected))
+        {
+            // Allocate a buffer long enough for the encrypted string.
+            PWSTR pwzProtected = (PWSTR)TrackedCoTaskMemAlloc(cchProtected * sizeof(WCHAR));
+            if (pwzProtected)
             {
-                // Allocate a buffer long enough for the encrypted string.
-                PWSTR pwzProtected = (PWSTR)CoTaskMemAlloc(cchProtected * sizeof(WCHAR));
-                if (pwzProtected)
+                // The second call to CredProtect actually encrypts the string.
+                if (CredProtectW(FALSE, pwzToProtect, cchToProtect, pwzProtected, &cchProtected, NULL))
                 {
-                    // The second call to CredProtect actually encrypts the string.
-                    if (CredProtectW(FALSE, pwzToProtectCopy, (DWORD)wcslen(pwzToProtectCopy)+1, pwzProtected, &cchProtected, NULL))
-                    {
-                        *ppwzProtected = pwzProtected;
-                        hr = S_OK;
-                    }
-                    else
-                    {
-                        CoTaskMemFree(pwzProtected);
-
-                        dwErr = GetLastError();
-                        hr = HRESULT_FROM_WIN32(dwErr);
-                    }
+                    *ppwzProtected = pwzProtected;
+                    hr = S_OK;
                 }
                 else
                 {
-                    hr = E_OUTOFMEMORY;
+                    TrackedCoTaskMemFree(pwzProtected);
+
+                    dwErr = GetLastError();
+                    hr = HRESULT_FROM_WIN32(dwErr);
                 }
             }
             else
             {
-                hr = HRESULT_FROM_WIN32(dwErr);
+                hr = E_OUTOFMEMORY;
             }
         }
-
-        CoTaskMemFree(pwzToProtectCopy);
+        else
+        {
+            hr = HRESULT_FROM_WIN32(dwErr);
+        }
+    }
+    else
+    {
+        // Succeeding with no output buffer should not happen.
+        hr = E_UNEXPECTED;
     }
 
     return hr;
@@ -454,6 +588,8 @@ HRESULT ProtectIfNecessaryAndCopyPassword(
     __deref_out PWSTR* ppwzProtectedPassword
     )
 {
+    TRACE_FUNCTION();
+    LATENCY_SCOPE(LP_PROTECT_PASSWORD);
     *ppwzProtectedPassword = NULL;
 
     HRESULT hr;
@@ -465,7 +601,7 @@ HRESULT ProtectIfNecessaryAndCopyPassword(
         // pwzPassword is const, but CredIsProtected takes a non-const string.
         // So, ake a copy that we know isn't const.
         PWSTR pwzPasswordCopy;
-        hr = SHStrDupW(pwzPassword, &pwzPasswordCopy);
+        hr = TrackedSHStrDupW(pwzPassword, &pwzPasswordCopy);
         if (SUCCEEDED(hr))
         {
             bool bCredAlreadyEncrypted = false;
@@ -486,19 +622,74 @@ HRESULT ProtectIfNecessaryAndCopyPassword(
             // cannot know if our caller expects or can handle an encryped password.
             if (CPUS_CREDUI == cpus || bCredAlreadyEncrypted)
             {
-                hr = SHStrDupW(pwzPasswordCopy, ppwzProtectedPassword);
+                // The copy is exactly what the caller wants; hand it over.
+                *ppwzProtectedPassword = pwzPasswordCopy;
+                pwzPasswordCopy = NULL;
             }
             else
             {
                 hr = _ProtectAndCopyString(pwzPasswordCopy, ppwzProtectedPassword);
             }
             
-            CoTaskMemFree(pwzPasswordCopy);
+            if (pwzPasswordCopy)
+            {
+                SecureZeroMemory(pwzPasswordCopy, wcslen(pwzPasswordCopy) * sizeof(WCHAR));
+                TrackedCoTaskMemFree(pwzPasswordCopy);
+            }
         }
     }
     else
     {
-        hr = SHStrDupW(L"", ppwzProtectedPassword);
+        hr = TrackedSHStrDupW(L"", ppwzProtectedPassword);
+    }
+
+    return hr;
+}
+
+//
+// Like ProtectIfNecessaryAndCopyPassword, but into the caller's buffer of *pcchProtected
+// characters, so nothing is allocated.  If the buffer is too small, fails with
+// HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER) and sets *pcchProtected to the length
+// it needs.
+//
+HRESULT ProtectIfNecessaryIntoBuffer(
+    __in PCWSTR pwzPassword,
+    __in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus,
+    __out_ecount(*pcchProtected) PWSTR pwzProtected,
+    __inout DWORD* pcchProtected
+    )
+{
+    TRACE_FUNCTION();
+    LATENCY_SCOPE(LP_PROTECT_PASSWORD);
+
+    // CredIsProtected and CredProtect only read the string, although they are declared to
+    // take a non-const one; the copy ProtectIfNecessaryAndCopyPassword makes is only for
+    // that.
+    PWSTR pwzToProtect = const_cast<PWSTR>(pwzPassword ? pwzPassword : L"");
+    DWORD cchToProtect = (DWORD)wcslen(pwzToProtect) + 1;
+
+    // The same choice as ProtectIfNecessaryAndCopyPassword: not an empty password, not one
+    // already encrypted, and nothing in the CPUS_CREDUI scenario.
+    CRED_PROTECTION_TYPE protectionType;
+    bool fProtect = *pwzToProtect && CPUS_CREDUI != cpus &&
+        !(CredIsProtectedW(pwzToProtect, &protectionType) && CredUnprotected != protectionType);
+
+    HRESULT hr;
+    if (fProtect)
+    {
+        // On ERROR_INSUFFICIENT_BUFFER this also sets the length needed.
+        hr = CredProtectW(FALSE, pwzToProtect, cchToProtect, pwzProtected, pcchProtected, NULL) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+    }
+    else if (cchToProtect > *pcchProtected)
+    {
+        *pcchProtected = cchToProtect;
+        hr = HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+    }
+    else
+    {
+        CopyMemory(pwzProtected, pwzToProtect, cchToProtect * sizeof(WCHAR));
+        *pcchProtected = cchToProtect;
+        hr = S_OK;
     }
 
     return hr;
@@ -514,6 +705,7 @@ void KerbInteractiveUnlockLogonUnpackInPlace(
     __in DWORD cb
     )
 {
+    TRACE_FUNCTION();
     if (sizeof(*pkiul) <= cb)
     {
         KERB_INTERACTIVE_LOGON* pkil = &pkiul->Logon;
@@ -549,6 +741,7 @@ HRESULT KerbInteractiveUnlockLogonRepackNative(
     __deref_out_bcount(*pcbNative) BYTE** prgbNative,
     __out DWORD* pcbNative)
 {
+    TRACE_FUNCTION();
     HRESULT hr = E_OUTOFMEMORY;
     PWSTR pszDomainUsername = NULL;
     DWORD cchDomainUsername = 0;
@@ -562,10 +755,10 @@ HRESULT KerbInteractiveUnlockLogonRepackNative(
     CredUnPackAuthenticationBufferW(CRED_PACK_WOW_BUFFER, rgbWow, cbWow, pszDomainUsername, &cchDomainUsername, NULL, NULL, pszPassword, &cchPassword);
     if (ERROR_INSUFFICIENT_BUFFER == GetLastError())
     {
-        pszDomainUsername = (PWSTR) LocalAlloc(0, cchDomainUsername * sizeof(WCHAR));
+        pszDomainUsername = (PWSTR) TrackedLocalAlloc(0, cchDomainUsername * sizeof(WCHAR));
         if (pszDomainUsername)
         {
-            pszPassword = (PWSTR) LocalAlloc(0, cchPassword * sizeof(WCHAR));
+            pszPassword = (PWSTR) TrackedLocalAlloc(0, cchPassword * sizeof(WCHAR));
             if (pszPassword)
             {
                 if (CredUnPackAuthenticationBufferW(CRED_PACK_WOW_BUFFER, rgbWow, cbWow, pszDomainUsername, &cchDomainUsername, NULL, NULL, pszPassword, &cchPassword))
@@ -587,7 +780,7 @@ HRESULT KerbInteractiveUnlockLogonRepackNative(
         CredPackAuthenticationBufferW(0, pszDomainUsername, pszPassword, *prgbNative, pcbNative);
         if (ERROR_INSUFFICIENT_BUFFER == GetLastError())
         {
-            *prgbNative = (BYTE*) LocalAlloc(LMEM_ZEROINIT, *pcbNative);
+            *prgbNative = (BYTE*) TrackedLocalAlloc(LMEM_ZEROINIT, *pcbNative);
             if (*prgbNative)
             {
                 if (CredPackAuthenticationBufferW(0, pszDomainUsername, pszPassword, *prgbNative, pcbNative))
@@ -596,17 +789,17 @@ HRESULT KerbInteractiveUnlockLogonRepackNative(
                 }
                 else
                 {
-                    LocalFree(*prgbNative);
+                    TrackedLocalFree(*prgbNative);
                 }
             }
         }
     }
 
-    LocalFree(pszDomainUsername);
+    TrackedLocalFree(pszDomainUsername);
     if (pszPassword)
     {
         SecureZeroMemory(pszPassword, cchPassword * sizeof(WCHAR));
-        LocalFree(pszPassword);
+        TrackedLocalFree(pszPassword);
     }
     return hr;
 }
@@ -623,7 +816,7 @@ HRESULT DomainUsernameStringAlloc(
     size_t cchUsername = lstrlen(pwszUsername);
     // Length of domain, 1 character for '\', length of Username, plus null terminator. 
     size_t cbLen = sizeof(WCHAR) * (cchDomain + 1 + cchUsername +1);
-    PWSTR pwszDest = (PWSTR)HeapAlloc(GetProcessHeap(), 0, cbLen);
+    PWSTR pwszDest = (PWSTR)TrackedHeapAlloc(GetProcessHeap(), 0, cbLen);
     if (pwszDest)
     {
         hr = StringCbPrintfW(pwszDest, cbLen, L"%s\\%s", pwszDomain, pwszUsername);
@@ -633,7 +826,7 @@ HRESULT DomainUsernameStringAlloc(
         }
         else
         {
-            HeapFree(GetProcessHeap(), 0, pwszDest);
+            TrackedHeapFree(GetProcessHeap(), 0, pwszDest);
         }
     }
     else
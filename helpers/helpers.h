@@ -24,12 +24,28 @@
 #include <shlwapi.h>
 #pragma warning(pop)
 
+#include "AllocTrackWin32.h"
+
 //makes a copy of a field descriptor using CoTaskMemAlloc
 HRESULT FieldDescriptorCoAllocCopy(
     __in const CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR& rcpfd,
     __deref_out CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR** ppcpfd
     );
 
+//makes a copy of a field descriptor using CoTaskMemAlloc, given the length of its label
+HRESULT FieldDescriptorCoAllocCopyN(
+    __in const CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR& rcpfd,
+    __in size_t cchLabel,
+    __deref_out CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR** ppcpfd
+    );
+
+//makes a CoTaskMemAlloc'd copy of a string whose length is already known
+HRESULT StringCoAllocCopy(
+    __in_ecount(cch) PCWSTR pwz,
+    __in size_t cch,
+    __deref_out PWSTR* ppwz
+    );
+
 //makes a copy of a field descriptor on the normal heap
 HRESULT FieldDescriptorCopy(
     __in const CREDENTIAL_PROVIDER_FIELD_DESCRIPTOR& rcpfd,
@@ -58,6 +74,9 @@ HRESULT KerbInteractiveUnlockLogonPack(
     __out DWORD* pcb
     );
 
+//start looking up the authentication package on the thread pool, ahead of the logon attempt
+void PrefetchNegotiateAuthPackage();
+
 //get the authentication package that will be used for our logon attempt
 HRESULT RetrieveNegotiateAuthPackage(
     __out ULONG * pulAuthPackage
@@ -70,6 +89,17 @@ HRESULT ProtectIfNecessaryAndCopyPassword(
     __deref_out PWSTR* ppwzProtectedPassword
     );
 
+//room for what CredProtect makes of a password of up to about 300 characters
+#define PROTECTED_PASSWORD_STACK_CCH 1024
+
+//the same, into the caller's buffer; fails with ERROR_INSUFFICIENT_BUFFER and the length it needs if that is too small
+HRESULT ProtectIfNecessaryIntoBuffer(
+    __in PCWSTR pwzPassword,
+    __in CREDENTIAL_PROVIDER_USAGE_SCENARIO cpus,
+    __out_ecount(*pcchProtected) PWSTR pwzProtected,
+    __inout DWORD* pcchProtected
+    );
+
 HRESULT KerbInteractiveUnlockLogonRepackNative(
     __in_bcount(cbWow) BYTE* rgbWow,
     __in DWORD cbWow,